@@ -0,0 +1,53 @@
+#include "api_client.h"
+#include <string.h>
+#include "backoff.h"
+
+ApiRetryPolicy defaultApiRetryPolicy(void (*sleepMs)(uint32_t)) {
+    ApiRetryPolicy policy;
+    policy.retryDelayMs = 2000;
+    policy.maxRetryDelayMs = 2000;
+    policy.sleepMs = sleepMs;
+    policy.randomMs = NULL;
+    return policy;
+}
+
+ApiClient::ApiClient(HttpSessionPool& pool, const char* headers, const ApiRetryPolicy& policy)
+    : pool_(pool), headers_(headers), policy_(policy), attemptFn_(NULL), attemptCtx_(NULL) {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+int ApiClient::request(const char* method, const char* url, const uint8_t* body, size_t len, uint8_t attempts,
+                       HttpResponse* resp, CircuitBreaker* breaker) {
+    if (attempts == 0) attempts = 1;
+    stats_.requests++;
+    HttpResponse local;
+    if (!resp) resp = &local;
+    int code = -1;
+    for (uint8_t attempt = 1; attempt <= attempts; attempt++) {
+        if (attempt > 1) {
+            if (breaker && !breaker->allowRetry()) break;
+            uint32_t delay = fullJitterBackoffMs(policy_.retryDelayMs, policy_.maxRetryDelayMs, attempt - 1,
+                                                 policy_.randomMs);
+            stats_.retries++;
+            stats_.backoffMs += delay;
+            if (policy_.sleepMs) policy_.sleepMs(delay);
+        }
+        if (breaker && !breaker->allow()) {
+            stats_.rejected++;
+            code = API_ERR_CIRCUIT_OPEN;
+            break;
+        }
+        stats_.attempts++;
+        resp->retryAfterS = 0;
+        // Reuses the open connection to this origin, reconnecting if the server dropped it
+        code = pool_.request(method, url, headers_, body, len, resp);
+        stats_.lastStatus = code;
+        if (breaker) breaker->record(code, code > 0 ? resp->retryAfterS : 0);
+        if (attemptFn_) attemptFn_(method, url, attempt, attempts, code, attemptCtx_);
+        if (succeeded(code)) return code;
+        // The server said when to come back; retrying sooner only adds load
+        if (code == 429 || (code > 0 && resp->retryAfterS > 0)) break;
+    }
+    stats_.failures++;
+    return code;
+}
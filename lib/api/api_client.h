@@ -0,0 +1,73 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "circuit_breaker.h"
+#include "http_session_pool.h"
+
+// Returned instead of a status when the endpoint's circuit breaker refused
+// the request; follows the HttpPoolError codes.
+#define API_ERR_CIRCUIT_OPEN -16
+
+// Pause between attempts: retryDelayMs, doubled after each failure up to
+// maxRetryDelayMs. Equal values give a fixed delay. With randomMs the pause
+// is drawn from [0, that delay] (full jitter).
+struct ApiRetryPolicy {
+    uint32_t retryDelayMs;
+    uint32_t maxRetryDelayMs;
+    void (*sleepMs)(uint32_t);
+    uint32_t (*randomMs)(uint32_t bound); // may be NULL
+};
+
+// A fixed 2 s pause, what the firmware has always used.
+ApiRetryPolicy defaultApiRetryPolicy(void (*sleepMs)(uint32_t));
+
+struct ApiStats {
+    uint32_t requests;
+    uint32_t attempts;
+    uint32_t retries;
+    uint32_t failures;   // requests that ran out of attempts, rejected ones included
+    uint32_t rejected;   // refused by a circuit breaker before or between attempts
+    uint32_t backoffMs;  // time spent sleeping between attempts
+    int lastStatus;
+};
+
+// Called after every attempt with its result, e.g. for serial logging.
+typedef void (*ApiAttemptFn)(const char* method, const char* url, uint8_t attempt, uint8_t attempts, int code,
+                             void* ctx);
+
+// JSON API requests over the shared HTTP pool, retried on network errors
+// and error statuses. A request may name the CircuitBreaker of its endpoint:
+// it is then refused while the circuit is open, retries come out of the
+// breaker's budget, and a 429 or Retry-After ends it at once instead of
+// retrying against a server that asked for a pause. Not thread safe, like
+// the pool.
+class ApiClient {
+public:
+    // headers: "Name: value\r\n" lines sent with every request, may be NULL.
+    ApiClient(HttpSessionPool& pool, const char* headers, const ApiRetryPolicy& policy);
+
+    void setHeaders(const char* headers) { headers_ = headers; }
+    void onAttempt(ApiAttemptFn fn, void* ctx) {
+        attemptFn_ = fn;
+        attemptCtx_ = ctx;
+    }
+
+    // Returns the last HTTP status, a negative HttpPoolError, or
+    // API_ERR_CIRCUIT_OPEN. breaker may be NULL.
+    int request(const char* method, const char* url, const uint8_t* body, size_t len, uint8_t attempts,
+                HttpResponse* resp = NULL, CircuitBreaker* breaker = NULL);
+    int post(const char* url, const char* body, size_t len, uint8_t attempts, CircuitBreaker* breaker = NULL) {
+        return request("POST", url, (const uint8_t*)body, len, attempts, NULL, breaker);
+    }
+
+    static bool succeeded(int code) { return code > 0 && code < 400; }
+    const ApiStats& stats() const { return stats_; }
+
+private:
+    HttpSessionPool& pool_;
+    const char* headers_;
+    ApiRetryPolicy policy_;
+    ApiAttemptFn attemptFn_;
+    void* attemptCtx_;
+    ApiStats stats_;
+};
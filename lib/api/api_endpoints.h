@@ -0,0 +1,133 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "http_session_pool.h"
+
+// The API settings in config.h are string literals, so the firmware joins
+// its URLs, its header block and the device_id member of its bodies with
+// the preprocessor, and checks the inputs with static_assert on the
+// functions below: no URL or header is formatted per request, and a bad
+// config.h fails the build instead of the first request after flashing.
+// The session pool still parses each URL into host, port and path when it
+// sends the request (parseUrl); only the strings are built at compile time.
+
+// Paths below OTA_SERVER
+#define API_PATH_HEARTBEAT "/api/heartbeat"
+#define API_PATH_LOG "/api/log"
+#define API_PATH_SENSOR_BATCH "/api/sensor/batch"
+#define API_PATH_FIRMWARE_VERSION "/api/firmware/version?device=esp32&current=" // + FIRMWARE_VERSION
+
+// Longest URL the session pool takes
+#define API_URL_MAX (HTTP_POOL_HOST_LEN + HTTP_POOL_PATH_LEN)
+
+// Headers of every API request, around the bearer token. API_HEADERS joins
+// them for a literal token; the simulator, whose token comes at run time,
+// puts the same pieces together itself.
+#define API_HEADERS_HEAD "Content-Type: application/json\r\nAuthorization: Bearer "
+#define API_HEADERS_TAIL "\r\nAccept: application/json\r\nUser-Agent: ESP32-OTA-Client/1.0\r\n"
+#define API_HEADERS(token) API_HEADERS_HEAD token API_HEADERS_TAIL
+
+// "device_id":"<id>", the first member of every body; the payload builders
+// copy it as is (JsonWriter::beginObject(members)), so the id must be
+// apiIdValid().
+#define API_DEVICE_MEMBER(id) "\"device_id\":\"" id "\""
+
+// --- compile-time checks ---
+// C++11 constexpr: one return statement each. Loops over a literal split
+// it in halves, so long tokens stay far from the compiler's recursion limit.
+
+constexpr bool apiDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Letters, digits, '-', '_', '.': needs no escaping in JSON, a URL query or an MQTT topic
+constexpr bool apiIdChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || apiDigit(c) || c == '-' || c == '_' || c == '.';
+}
+
+constexpr bool apiHostChar(char c) {
+    return apiIdChar(c) && c != '_';
+}
+
+// RFC 6750 b64token
+constexpr bool apiTokenChar(char c) {
+    return apiIdChar(c) || c == '~' || c == '+' || c == '/' || c == '=';
+}
+
+// Visible ASCII without the characters a URL must not carry unescaped
+constexpr bool apiUrlChar(char c) {
+    return c > ' ' && c < 0x7f && c != '"' && c != '<' && c != '>' && c != '\\' && c != '#';
+}
+
+constexpr bool apiAllOf(bool (*pred)(char), const char* s, size_t n) {
+    return n == 0 ? true
+         : n == 1 ? pred(s[0])
+                  : apiAllOf(pred, s, n / 2) && apiAllOf(pred, s + n / 2, n - n / 2);
+}
+
+// Length of the run of pred characters at s, at most max
+constexpr size_t apiSpan(bool (*pred)(char), const char* s, size_t max) {
+    return max > 0 && pred(*s) ? 1 + apiSpan(pred, s + 1, max - 1) : 0;
+}
+
+constexpr uint32_t apiNumber(const char* s, size_t n) {
+    return n == 0 ? 0 : apiNumber(s, n - 1) * 10 + (uint32_t)(s[n - 1] - '0');
+}
+
+constexpr bool apiStartsWith(const char* s, const char* prefix) {
+    return *prefix == '\0' || (*s == *prefix && apiStartsWith(s + 1, prefix + 1));
+}
+
+// 8 for https://, 7 for http://, 0 for anything else (lower case only)
+constexpr size_t apiSchemeLen(const char* url) {
+    return apiStartsWith(url, "https://") ? 8 : apiStartsWith(url, "http://") ? 7 : 0;
+}
+
+constexpr size_t apiHostLen(const char* url) {
+    return apiSpan(apiHostChar, url + apiSchemeLen(url), HTTP_POOL_HOST_LEN);
+}
+
+constexpr size_t apiPortStart(const char* url) {
+    return apiSchemeLen(url) + apiHostLen(url);
+}
+
+// ":<digits>" after the host, 0 without a port; six digits at most so an
+// overlong port still parses and fails the range check
+constexpr size_t apiPortLen(const char* url) {
+    return url[apiPortStart(url)] == ':' ? 1 + apiSpan(apiDigit, url + apiPortStart(url) + 1, 6) : 0;
+}
+
+constexpr uint32_t apiPort(const char* url) {
+    return apiPortLen(url) ? apiNumber(url + apiPortStart(url) + 1, apiPortLen(url) - 1)
+                           : (apiSchemeLen(url) == 8 ? 443 : 80);
+}
+
+constexpr size_t apiPathStart(const char* url) {
+    return apiPortStart(url) + apiPortLen(url);
+}
+
+// http(s)://host[:port][/path] that fits the session pool
+template <size_t N>
+constexpr bool apiUrlValid(const char (&url)[N]) {
+    return N > 1 && N - 1 < API_URL_MAX && apiSchemeLen(url) != 0 && apiHostLen(url) > 0 &&
+           apiHostLen(url) < HTTP_POOL_HOST_LEN &&
+           (apiPortLen(url) == 0 || (apiPortLen(url) > 1 && apiPort(url) > 0 && apiPort(url) <= 65535)) &&
+           (url[apiPathStart(url)] == '\0' || url[apiPathStart(url)] == '/') && apiAllOf(apiUrlChar, url, N - 1);
+}
+
+// A base URL the API paths are appended to: no trailing slash
+template <size_t N>
+constexpr bool apiServerValid(const char (&url)[N]) {
+    return apiUrlValid(url) && url[N - 2] != '/';
+}
+
+// Device ids and firmware versions: non-empty, apiIdChar only
+template <size_t N>
+constexpr bool apiIdValid(const char (&id)[N]) {
+    return N > 1 && apiAllOf(apiIdChar, id, N - 1);
+}
+
+template <size_t N>
+constexpr bool apiTokenValid(const char (&token)[N]) {
+    return N > 1 && apiAllOf(apiTokenChar, token, N - 1);
+}
@@ -0,0 +1,96 @@
+#include "api_payloads.h"
+#include <stdio.h>
+#include "json_writer.h"
+
+static size_t finish(const JsonWriter& json) {
+    return json.ok() ? json.length() : 0;
+}
+
+static JsonWriter& beginDeviceObject(JsonWriter& json, const char* deviceId, const char* deviceMember) {
+    if (deviceMember) return json.beginObject(deviceMember);
+    return json.beginObject().key("device_id").value(deviceId);
+}
+
+size_t buildHeartbeat(const HeartbeatInfo& info, char* out, size_t cap) {
+    JsonWriter json(out, cap);
+    beginDeviceObject(json, info.deviceId, info.deviceMember)
+        .key("status").value("online")
+        .key("firmware_version").value(info.firmwareVersion)
+        .key("boot_to_wifi_ms").value(info.bootToWifiMs)
+        .key("boot_to_ntp_ms").value(info.bootToNtpMs)
+        .key("boot_to_first_publish_ms").value(info.bootToFirstPublishMs)
+        .key("wifi_fast_hits").value(info.wifiFastHits)
+        .key("wifi_drops").value(info.wifiDrops)
+        .key("sample_overflows").value(info.sampleOverflows);
+    if (info.metrics) json.key("metrics").raw(info.metrics);
+    json.endObject();
+    return finish(json);
+}
+
+size_t buildDiagnostics(const DiagnosticsInfo& info, char* out, size_t cap) {
+    JsonWriter json(out, cap);
+    beginDeviceObject(json, info.deviceId, info.deviceMember)
+        .key("firmware_version").value(info.firmwareVersion)
+        .key("uptime_ms").value(info.uptimeMs)
+        .key("free_heap").value(info.freeHeap)
+        .key("min_free_heap").value(info.minFreeHeap)
+        .key("rssi").value(info.rssi)
+        .key("sample_interval_ms").value(info.sampleIntervalMs)
+        .key("buffered_samples").value(info.bufferedSamples)
+        .key("queued_records").value(info.queuedRecords)
+        .key("api_requests").value(info.apiRequests)
+        .key("api_failures").value(info.apiFailures)
+        .key("telemetry_frames").value(info.telemetryFrames)
+        .key("telemetry_dropped").value(info.telemetryDropped)
+        .key("commands").value(info.commands)
+        .endObject();
+    return finish(json);
+}
+
+size_t buildOtaLog(const OtaLogInfo& info, char* out, size_t cap) {
+    JsonWriter json(out, cap);
+    beginDeviceObject(json, info.deviceId, info.deviceMember)
+        .key("status").value(info.status)
+        .key("version").value(info.version)
+        .key("error_message").value(info.errorMessage)
+        .key("latency_ms").value(info.latencyMs);
+    if (info.count > 1) json.key("count").value((uint32_t)info.count);
+    if (info.transfer) {
+        const OtaStats* t = info.transfer;
+        json.key("bytes").value(t->bytes)
+            .key("throughput_mbps").value(t->bytesPerSec() * 8.0 / 1e6, 3) // megabits per second
+            .key("stall_ms").value(t->stallMs)
+            .key("attempts").value((uint32_t)t->attempts)
+            .key("http_code").value((int32_t)t->lastHttpCode);
+    }
+    if (info.health) {
+        const HealthReport* h = info.health;
+        char failed[48];
+        healthCheckList(h->failed, failed, sizeof(failed));
+        json.key("health").beginObject()
+            .key("healthy").value(h->verdict == HEALTH_PASSED)
+            .key("elapsed_ms").value(h->elapsedMs)
+            .key("failed").value(failed);
+        // Time each connectivity check took to pass, null if it never did
+        for (int i = 0; i < 3; i++) {
+            HealthCheck check = (HealthCheck)(1 << i);
+            char name[16];
+            snprintf(name, sizeof(name), "%s_ms", healthCheckName(check));
+            json.key(name);
+            if (h->passed & check) {
+                json.value(h->passedAtMs[i]);
+            } else {
+                json.null();
+            }
+        }
+        json.key("min_free_heap").value(h->minFreeHeap).endObject();
+    }
+    json.endObject();
+    return finish(json);
+}
+
+size_t buildSlackMessage(const char* text, size_t len, char* out, size_t cap) {
+    JsonWriter json(out, cap);
+    json.beginObject().key("text").value(text, len).endObject();
+    return finish(json);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "health_gate.h"
+#include "ota_downloader.h"
+
+// JSON bodies sent by the firmware, built into caller buffers. Each builder
+// returns the payload length, or 0 if it did not fit in cap.
+//
+// The info structs name the device twice: deviceId is escaped into the body
+// on every call, deviceMember, when set, is the whole "device_id" member
+// serialized at build time (API_DEVICE_MEMBER in api_endpoints.h) and is
+// copied instead. The firmware sets both, the simulator only deviceId.
+
+struct HeartbeatInfo {
+    const char* deviceId;
+    const char* firmwareVersion;
+    // Boot timeline (ms since boot, 0 = not yet)
+    uint32_t bootToWifiMs;
+    uint32_t bootToNtpMs;
+    uint32_t bootToFirstPublishMs;
+    uint32_t wifiFastHits;
+    uint32_t wifiDrops;
+    uint32_t sampleOverflows;
+    const char* metrics; // MetricsRegistry::encode() output, NULL to leave it out
+    const char* deviceMember; // see below
+};
+
+size_t buildHeartbeat(const HeartbeatInfo& info, char* out, size_t cap);
+
+struct OtaLogInfo {
+    const char* deviceId;
+    const char* status;
+    const char* version;
+    const char* errorMessage;
+    int32_t latencyMs;
+    const OtaStats* transfer; // download telemetry, NULL if there was none
+    const HealthReport* health; // post-update health gate, NULL if it did not run
+    const char* deviceMember;
+    uint16_t count;             // occurrences merged by the event outbox; sent when above 1
+};
+
+size_t buildOtaLog(const OtaLogInfo& info, char* out, size_t cap);
+
+// Snapshot published in answer to a "diag" command.
+struct DiagnosticsInfo {
+    const char* deviceId;
+    const char* firmwareVersion;
+    uint32_t uptimeMs;
+    uint32_t freeHeap;
+    uint32_t minFreeHeap;
+    int32_t rssi;
+    uint32_t sampleIntervalMs;
+    uint32_t bufferedSamples;  // HTTP ring
+    uint32_t queuedRecords;    // flash queue
+    uint32_t apiRequests;
+    uint32_t apiFailures;
+    uint32_t telemetryFrames;
+    uint32_t telemetryDropped;
+    uint32_t commands;
+    const char* deviceMember;
+};
+
+size_t buildDiagnostics(const DiagnosticsInfo& info, char* out, size_t cap);
+
+// {"text": ...} for a Slack incoming webhook.
+size_t buildSlackMessage(const char* text, size_t len, char* out, size_t cap);
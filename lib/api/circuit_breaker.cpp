@@ -0,0 +1,123 @@
+#include "circuit_breaker.h"
+#include <string.h>
+#include "backoff.h"
+
+// Wrap-safe "a is at or before b" for millisecond timestamps.
+static inline bool reached(uint32_t a, uint32_t b) {
+    return (int32_t)(b - a) >= 0;
+}
+
+const char* circuitStateName(CircuitState state) {
+    switch (state) {
+        case CIRCUIT_CLOSED: return "closed";
+        case CIRCUIT_OPEN: return "open";
+        case CIRCUIT_HALF_OPEN: return "half-open";
+    }
+    return "?";
+}
+
+CircuitBreakerConfig defaultCircuitBreakerConfig() {
+    CircuitBreakerConfig config;
+    config.failureThreshold = 3;
+    config.openMs = 10000;
+    config.maxOpenMs = 300000;
+    config.maxRetryAfterMs = 600000;
+    config.retryBudget = 5;
+    config.retryPercent = 10;
+    return config;
+}
+
+CircuitBreaker::CircuitBreaker(const CircuitBreakerConfig& config, uint32_t (*nowMs)(),
+                               uint32_t (*randomMs)(uint32_t))
+    : config_(config),
+      nowMs_(nowMs),
+      randomMs_(randomMs),
+      state_(CIRCUIT_CLOSED),
+      failures_(0),
+      trips_(0),
+      openUntil_(0),
+      probeAt_(0),
+      retryCents_((uint32_t)config.retryBudget * 100) {
+    if (config_.failureThreshold == 0) config_.failureThreshold = 1;
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+bool CircuitBreaker::allow() {
+    uint32_t now = nowMs_();
+    switch (state_) {
+        case CIRCUIT_CLOSED:
+            return true;
+        case CIRCUIT_OPEN:
+            if (!reached(openUntil_, now)) break;
+            state_ = CIRCUIT_HALF_OPEN;
+            probeAt_ = now;
+            stats_.probes++;
+            return true;
+        case CIRCUIT_HALF_OPEN:
+            // A probe whose result never came back does not hold the circuit forever
+            if (!reached(probeAt_ + config_.openMs, now)) break;
+            probeAt_ = now;
+            stats_.probes++;
+            return true;
+    }
+    stats_.rejected++;
+    return false;
+}
+
+void CircuitBreaker::record(int code, uint32_t retryAfterS) {
+    uint32_t now = nowMs_();
+    if (code == 429 || retryAfterS > 0) {
+        stats_.throttled++;
+        uint32_t askedMs = retryAfterS > config_.maxRetryAfterMs / 1000 ? config_.maxRetryAfterMs : retryAfterS * 1000;
+        open(now, askedMs);
+        return;
+    }
+    if (!isFailure(code)) {
+        state_ = CIRCUIT_CLOSED;
+        failures_ = 0;
+        trips_ = 0;
+        uint32_t cap = (uint32_t)config_.retryBudget * 100;
+        retryCents_ = retryCents_ + config_.retryPercent > cap ? cap : retryCents_ + config_.retryPercent;
+        return;
+    }
+    if (failures_ < 255) failures_++;
+    // A failed probe reopens at once; closed needs failureThreshold in a row
+    if (state_ == CIRCUIT_HALF_OPEN || (state_ == CIRCUIT_CLOSED && failures_ >= config_.failureThreshold)) {
+        open(now, 0);
+    }
+}
+
+bool CircuitBreaker::allowRetry() {
+    if (state_ == CIRCUIT_CLOSED && retryCents_ >= 100) {
+        retryCents_ -= 100;
+        return true;
+    }
+    stats_.retriesDenied++;
+    return false;
+}
+
+uint32_t CircuitBreaker::msUntilAllowed() const {
+    uint32_t now = nowMs_();
+    uint32_t until;
+    if (state_ == CIRCUIT_OPEN) until = openUntil_;
+    else if (state_ == CIRCUIT_HALF_OPEN) until = probeAt_ + config_.openMs;
+    else return 0;
+    return reached(until, now) ? 0 : until - now;
+}
+
+// The cool-down is drawn from [ceiling/2, ceiling] rather than full jitter:
+// the circuit always stays open a while, yet devices that tripped together
+// probe at different times. A Retry-After is a floor, spread by up to a
+// quarter on top for the same reason.
+void CircuitBreaker::open(uint32_t now, uint32_t minMs) {
+    if (state_ != CIRCUIT_OPEN) stats_.opened++;
+    if (trips_ < 255) trips_++;
+    uint32_t ceiling = backoffCeilingMs(config_.openMs, config_.maxOpenMs, trips_);
+    uint32_t coolMs = ceiling - (randomMs_ && ceiling > 1 ? randomMs_(ceiling / 2 + 1) : 0);
+    if (minMs > 0) {
+        uint32_t asked = minMs + (randomMs_ && minMs >= 4 ? randomMs_(minMs / 4 + 1) : 0);
+        if (asked > coolMs) coolMs = asked;
+    }
+    state_ = CIRCUIT_OPEN;
+    openUntil_ = now + coolMs;
+}
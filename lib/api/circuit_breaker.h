@@ -0,0 +1,81 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+enum CircuitState {
+    CIRCUIT_CLOSED = 0, // requests go out
+    CIRCUIT_OPEN,       // refused until the cool-down ends
+    CIRCUIT_HALF_OPEN   // one probe is out; its result closes or reopens the circuit
+};
+
+const char* circuitStateName(CircuitState state);
+
+struct CircuitBreakerConfig {
+    uint8_t failureThreshold;  // consecutive failures that open the circuit
+    uint32_t openMs;           // first cool-down, doubled each time a probe fails
+    uint32_t maxOpenMs;
+    uint32_t maxRetryAfterMs;  // longest Retry-After honoured; longer ones are cut to this
+    // Retry budget: a bucket of retryBudget retries, refilled by retryPercent
+    // of a retry per successful request. Once it is empty only first
+    // attempts go out, so retries cannot multiply the load of an outage.
+    uint8_t retryBudget;
+    uint8_t retryPercent;
+};
+
+// 3 failures open the circuit for 10 s to 5 min; Retry-After up to 10 min;
+// 5 retries banked, one more per 10 successes.
+CircuitBreakerConfig defaultCircuitBreakerConfig();
+
+struct CircuitStats {
+    uint32_t opened;        // closed or half-open to open
+    uint32_t rejected;      // allow() calls refused
+    uint32_t probes;        // requests let through half-open
+    uint32_t throttled;     // 429 and Retry-After answers
+    uint32_t retriesDenied; // allowRetry() calls refused
+};
+
+// Per-endpoint guard in front of the API client. While the server fails,
+// devices stop sending after a few failures and come back one probe at a
+// time, after a cool-down that is randomised so a fleet that failed
+// together does not return together. 429 and Retry-After open the circuit
+// for as long as the server asked. Never blocks; the caller reschedules
+// with msUntilAllowed(). Not thread safe, like the API client.
+class CircuitBreaker {
+public:
+    // randomMs(bound) returns [0, bound); may be NULL to disable jitter.
+    CircuitBreaker(const CircuitBreakerConfig& config, uint32_t (*nowMs)(), uint32_t (*randomMs)(uint32_t bound));
+
+    // True if a request may go out now. Once the cool-down is over the first
+    // call turns the circuit half-open and lets one probe through.
+    bool allow();
+    // Result of a request allow() let through: an HTTP status or a negative
+    // error, and the Retry-After the server sent (0 if none).
+    void record(int code, uint32_t retryAfterS = 0);
+    // True if a failed request may be retried now; takes one from the budget.
+    bool allowRetry();
+
+    CircuitState state() const { return state_; }
+    // 0 when allow() would let a request through.
+    uint32_t msUntilAllowed() const;
+    uint8_t failures() const { return failures_; }
+    uint32_t retryTokens() const { return retryCents_ / 100; }
+    const CircuitStats& stats() const { return stats_; }
+
+    // Network errors, 5xx and 429 count against the endpoint; other 4xx
+    // mean the server is up and answered.
+    static bool isFailure(int code) { return code <= 0 || code == 429 || code >= 500; }
+
+private:
+    void open(uint32_t now, uint32_t minMs);
+
+    CircuitBreakerConfig config_;
+    uint32_t (*nowMs_)();
+    uint32_t (*randomMs_)(uint32_t);
+    CircuitState state_;
+    uint8_t failures_;
+    uint8_t trips_;        // consecutive openings without a successful probe
+    uint32_t openUntil_;
+    uint32_t probeAt_;     // when the half-open probe went out
+    uint32_t retryCents_;  // retry budget in hundredths of a retry
+    CircuitStats stats_;
+};
@@ -0,0 +1,103 @@
+#include "command_channel.h"
+#include <stdio.h>
+#include <string.h>
+#include "json_fields.h"
+#include "json_writer.h"
+
+const char* commandStatusName(int status) {
+    switch (status) {
+    case CMD_SKIPPED: return "skipped";
+    case CMD_OK: return "ok";
+    case CMD_ERR_UNKNOWN: return "unknown_command";
+    case CMD_ERR_MALFORMED: return "malformed";
+    case CMD_ERR_ARGS: return "bad_arguments";
+    case CMD_ERR_BUSY: return "busy";
+    default: return "error";
+    }
+}
+
+CommandChannel::CommandChannel(MqttClient& mqtt, const CommandSpec* table, size_t count)
+    : mqtt_(mqtt), table_(table), count_(count), lastStatus_(CMD_OK) {
+    cmdTopic_[0] = fleetTopic_[0] = ackTopic_[0] = lastId_[0] = '\0';
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+static bool formatTopic(char* out, const char* prefix, const char* device, const char* leaf) {
+    int n = snprintf(out, CMD_TOPIC_LEN, "%s/%s/%s", prefix, device, leaf);
+    return n > 0 && n < CMD_TOPIC_LEN;
+}
+
+bool CommandChannel::begin(const char* prefix, const char* deviceId) {
+    mqtt_.onMessage(messageThunk, this);
+    return formatTopic(cmdTopic_, prefix, deviceId, "cmd") && formatTopic(fleetTopic_, prefix, "all", "cmd") &&
+           formatTopic(ackTopic_, prefix, deviceId, "ack");
+}
+
+bool CommandChannel::subscribe() {
+    // QoS 1 so a command published while the device was reconnecting is not lost
+    bool own = mqtt_.subscribe(cmdTopic_, 1);
+    bool fleet = mqtt_.subscribe(fleetTopic_, 1);
+    return own && fleet;
+}
+
+void CommandChannel::messageThunk(const char* topic, const uint8_t* payload, size_t len, void* ctx) {
+    static_cast<CommandChannel*>(ctx)->handle(topic, payload, len);
+}
+
+void CommandChannel::handle(const char* topic, const uint8_t* payload, size_t len) {
+    if (strcmp(topic, cmdTopic_) != 0 && strcmp(topic, fleetTopic_) != 0) return;
+    stats_.received++;
+    char name[CMD_NAME_LEN];
+    char id[CMD_ID_LEN];
+    JsonField fields[] = {
+        {"cmd", name, sizeof(name), false},
+        {"id", id, sizeof(id), false},
+    };
+    JsonFieldExtractor extractor(fields, 2);
+    const char* json = (const char*)payload;
+    bool valid = extractor.feed(json, len) && extractor.finish() && fields[0].found;
+    if (!valid) {
+        stats_.failed++;
+        ack(id, fields[1].found, fields[0].found ? name : "", CMD_ERR_MALFORMED);
+        return;
+    }
+    if (fields[1].found && id[0] && strcmp(id, lastId_) == 0) {
+        stats_.duplicates++;
+        ack(id, true, name, lastStatus_);
+        return;
+    }
+    int status = dispatch(name, json, len);
+    if (status >= CMD_OK) {
+        stats_.executed++;
+    } else {
+        stats_.failed++;
+    }
+    if (fields[1].found) {
+        snprintf(lastId_, sizeof(lastId_), "%s", id);
+        lastStatus_ = status;
+    }
+    ack(id, fields[1].found, name, status);
+}
+
+int CommandChannel::dispatch(const char* name, const char* json, size_t len) {
+    for (size_t i = 0; i < count_; i++) {
+        if (strcmp(table_[i].name, name) == 0) return table_[i].fn(json, len, table_[i].ctx);
+    }
+    return CMD_ERR_UNKNOWN;
+}
+
+void CommandChannel::ack(const char* id, bool hasId, const char* name, int status) {
+    char body[128];
+    JsonWriter json(body, sizeof(body));
+    json.beginObject().key("id");
+    if (hasId) {
+        json.value(id);
+    } else {
+        json.null();
+    }
+    json.key("cmd").value(name)
+        .key("ok").value(status >= CMD_OK)
+        .key("status").value(commandStatusName(status))
+        .endObject();
+    if (json.ok()) mqtt_.publish(ackTopic_, (const uint8_t*)body, json.length(), 1, false);
+}
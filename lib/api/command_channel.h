@@ -0,0 +1,74 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "mqtt_client.h"
+
+#define CMD_TOPIC_LEN 64
+#define CMD_NAME_LEN 16
+#define CMD_ID_LEN 32
+
+enum CommandStatus {
+    CMD_SKIPPED = 1,        // valid, but nothing to do (e.g. already on that version)
+    CMD_OK = 0,
+    CMD_ERR_UNKNOWN = -1,   // no handler with that name
+    CMD_ERR_MALFORMED = -2, // not a JSON object with a "cmd" string
+    CMD_ERR_ARGS = -3,      // the handler rejected the arguments
+    CMD_ERR_BUSY = -4       // the handler cannot take it right now
+};
+
+const char* commandStatusName(int status);
+
+// Receives the whole command object, e.g. {"cmd":"config","id":"7","sample_interval_ms":10000},
+// and parses its own arguments. It runs inside MqttClient::loop(), so slow
+// work should be handed to a job. Returns a CommandStatus.
+typedef int (*CommandHandler)(const char* json, size_t len, void* ctx);
+
+struct CommandSpec {
+    const char* name;
+    CommandHandler fn;
+    void* ctx;
+};
+
+struct CommandStats {
+    uint32_t received;
+    uint32_t executed;   // handler returned CMD_OK or CMD_SKIPPED
+    uint32_t failed;     // an error status
+    uint32_t duplicates; // redelivered ids acked again without running
+};
+
+// Per-device command topic with a dispatch table. Commands arrive on
+// <prefix>/<device id>/cmd or the fleet-wide <prefix>/all/cmd, and each
+// result is acked on <prefix>/<device id>/ack as
+//   {"id":"7","cmd":"config","ok":true,"status":"ok"}
+// ok is true for CMD_OK and CMD_SKIPPED.
+class CommandChannel {
+public:
+    CommandChannel(MqttClient& mqtt, const CommandSpec* table, size_t count);
+
+    // Builds the topics and installs the message callback. Returns false if
+    // a topic does not fit CMD_TOPIC_LEN.
+    bool begin(const char* prefix, const char* deviceId);
+    // Subscriptions are lost with the connection: call after every connect.
+    bool subscribe();
+
+    void handle(const char* topic, const uint8_t* payload, size_t len);
+
+    const char* commandTopic() const { return cmdTopic_; }
+    const char* ackTopic() const { return ackTopic_; }
+    const CommandStats& stats() const { return stats_; }
+
+private:
+    static void messageThunk(const char* topic, const uint8_t* payload, size_t len, void* ctx);
+    int dispatch(const char* name, const char* json, size_t len);
+    void ack(const char* id, bool hasId, const char* name, int status);
+
+    MqttClient& mqtt_;
+    const CommandSpec* table_;
+    size_t count_;
+    char cmdTopic_[CMD_TOPIC_LEN];
+    char fleetTopic_[CMD_TOPIC_LEN];
+    char ackTopic_[CMD_TOPIC_LEN];
+    char lastId_[CMD_ID_LEN]; // QoS 1 may deliver a command twice
+    int lastStatus_;
+    CommandStats stats_;
+};
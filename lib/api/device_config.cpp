@@ -0,0 +1,42 @@
+#include "device_config.h"
+#include <string.h>
+#include "command_channel.h"
+#include "json_fields.h"
+
+bool parseUint32(const char* text, uint32_t* out) {
+    if (!*text) return false;
+    uint64_t v = 0;
+    for (const char* p = text; *p; p++) {
+        if (*p < '0' || *p > '9') return false;
+        v = v * 10 + (uint64_t)(*p - '0');
+        if (v > 0xffffffffu) return false;
+    }
+    *out = (uint32_t)v;
+    return true;
+}
+
+int parseConfigCommand(const char* json, size_t len, uint32_t maxBatchSamples, ConfigUpdate* out) {
+    memset(out, 0, sizeof(*out));
+    char interval[12];
+    char batch[12];
+    JsonField fields[] = {
+        {"sample_interval_ms", interval, sizeof(interval), false},
+        {"batch_samples", batch, sizeof(batch), false},
+    };
+    JsonFieldExtractor extractor(fields, 2);
+    if (!extractor.feed(json, len) || !extractor.finish()) return CMD_ERR_ARGS;
+    if (fields[0].found) {
+        if (!parseUint32(interval, &out->sampleIntervalMs) || out->sampleIntervalMs < CONFIG_SAMPLE_MIN_MS ||
+            out->sampleIntervalMs > CONFIG_SAMPLE_MAX_MS) {
+            return CMD_ERR_ARGS;
+        }
+        out->hasSampleInterval = true;
+    }
+    if (fields[1].found) {
+        if (!parseUint32(batch, &out->batchSamples) || out->batchSamples == 0 || out->batchSamples > maxBatchSamples) {
+            return CMD_ERR_ARGS;
+        }
+        out->hasBatchSamples = true;
+    }
+    return out->hasSampleInterval || out->hasBatchSamples ? CMD_OK : CMD_ERR_ARGS;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define CONFIG_SAMPLE_MIN_MS 1000
+#define CONFIG_SAMPLE_MAX_MS 3600000
+
+// Settings a "config" command may change; a field is applied only when its
+// has* flag is set.
+struct ConfigUpdate {
+    bool hasSampleInterval;
+    uint32_t sampleIntervalMs; // "sample_interval_ms"
+    bool hasBatchSamples;
+    uint32_t batchSamples;     // "batch_samples", 1..maxBatchSamples
+};
+
+// Parses and range-checks a config command. Returns CMD_OK, or
+// CMD_ERR_ARGS if a value is out of range, not a number or none was given.
+int parseConfigCommand(const char* json, size_t len, uint32_t maxBatchSamples, ConfigUpdate* out);
+
+// Reads an unsigned decimal field value; false if it is anything else.
+bool parseUint32(const char* text, uint32_t* out);
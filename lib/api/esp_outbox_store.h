@@ -0,0 +1,31 @@
+#pragma once
+#ifdef ARDUINO
+#include <Preferences.h>
+#include "event_outbox.h"
+
+#define OUTBOX_NAMESPACE "outbox"
+
+// The event outbox as one NVS blob (about 2 KB). NVS keeps the old value
+// until the new one is complete, so a restart during a save loses at most
+// that save.
+class EspOutboxStore : public OutboxStore {
+public:
+    size_t load(void* buf, size_t cap) {
+        Preferences prefs;
+        if (!prefs.begin(OUTBOX_NAMESPACE, true)) return 0;
+        size_t n = prefs.getBytesLength("events");
+        if (n > cap) n = 0;
+        if (n) n = prefs.getBytes("events", buf, n);
+        prefs.end();
+        return n;
+    }
+
+    bool save(const void* data, size_t len) {
+        Preferences prefs;
+        if (!prefs.begin(OUTBOX_NAMESPACE, false)) return false;
+        size_t n = prefs.putBytes("events", data, len);
+        prefs.end();
+        return n == len;
+    }
+};
+#endif
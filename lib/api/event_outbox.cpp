@@ -0,0 +1,194 @@
+#include "event_outbox.h"
+#include <stdio.h>
+#include <string.h>
+
+// FNV-1a, like the RTC state: the blob only has to tell a clean save from
+// a torn or foreign one
+static uint32_t fnv1a(const void* data, size_t len) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void copyText(char* dst, size_t cap, const char* src) {
+    snprintf(dst, cap, "%s", src ? src : "");
+}
+
+static bool sameEvent(const OutboxEvent& a, const OutboxEvent& b) {
+    return a.kind == b.kind && strcmp(a.status, b.status) == 0 && strcmp(a.version, b.version) == 0 &&
+           strcmp(a.text, b.text) == 0;
+}
+
+size_t outboxSlackLine(const OutboxEvent& event, char* out, size_t cap) {
+    if (cap == 0) return 0;
+    int n = event.count > 1 ? snprintf(out, cap, "%s (x%u)", event.text, (unsigned)event.count)
+                            : snprintf(out, cap, "%s", event.text);
+    if (n < 0) return 0;
+    return (size_t)n < cap ? (size_t)n : cap - 1;
+}
+
+EventOutbox::EventOutbox(OutboxStore& store) : store_(store) {
+    memset(&stats_, 0, sizeof(stats_));
+    reset();
+}
+
+void EventOutbox::reset() {
+    memset(&blob_, 0, sizeof(blob_));
+    blob_.magic = OUTBOX_MAGIC;
+    blob_.eventSize = sizeof(OutboxEvent);
+}
+
+size_t EventOutbox::restore() {
+    size_t len = store_.load(&blob_, sizeof(blob_));
+    // An image built with another OutboxEvent layout starts over
+    if (len != sizeof(blob_) || blob_.magic != OUTBOX_MAGIC || blob_.eventSize != sizeof(OutboxEvent) ||
+        blob_.count > OUTBOX_CAPACITY || blob_.checksum != fnv1a(&blob_, offsetof(Blob, checksum))) {
+        reset();
+    }
+    return blob_.count;
+}
+
+bool EventOutbox::save() {
+    blob_.checksum = fnv1a(&blob_, offsetof(Blob, checksum));
+    if (store_.save(&blob_, sizeof(blob_))) return true;
+    stats_.saveErrors++;
+    return false;
+}
+
+bool EventOutbox::queue(OutboxEvent& event) {
+    for (size_t i = 0; i < blob_.count; i++) {
+        OutboxEvent& pending = blob_.events[i];
+        if (!sameEvent(pending, event)) continue;
+        // Keeps its place in line; the details are the latest occurrence's
+        if (pending.count < UINT16_MAX) pending.count++;
+        pending.latencyMs = event.latencyMs;
+        pending.hasTransfer = event.hasTransfer;
+        pending.transfer = event.transfer;
+        pending.hasHealth = event.hasHealth;
+        pending.health = event.health;
+        stats_.merged++;
+        return save();
+    }
+    if (blob_.count == OUTBOX_CAPACITY) {
+        remove(0);
+        stats_.dropped++;
+    }
+    event.count = 1;
+    event.seq = blob_.nextSeq++;
+    blob_.events[blob_.count++] = event;
+    stats_.queued++;
+    return save();
+}
+
+void EventOutbox::remove(size_t i) {
+    memmove(&blob_.events[i], &blob_.events[i + 1], (blob_.count - i - 1) * sizeof(OutboxEvent));
+    blob_.count--;
+    memset(&blob_.events[blob_.count], 0, sizeof(OutboxEvent));
+}
+
+bool EventOutbox::otaLog(const char* status, const char* version, const char* error, int32_t latencyMs,
+                         const OtaStats* transfer, const HealthReport* health) {
+    OutboxEvent event;
+    memset(&event, 0, sizeof(event));
+    event.kind = OUTBOX_OTA_LOG;
+    copyText(event.status, sizeof(event.status), status);
+    copyText(event.version, sizeof(event.version), version);
+    copyText(event.text, sizeof(event.text), error);
+    event.latencyMs = latencyMs;
+    if (transfer) {
+        event.hasTransfer = true;
+        event.transfer = *transfer;
+    }
+    if (health) {
+        event.hasHealth = true;
+        event.health = *health;
+    }
+    return queue(event);
+}
+
+bool EventOutbox::slack(const char* text) {
+    OutboxEvent event;
+    memset(&event, 0, sizeof(event));
+    event.kind = OUTBOX_SLACK;
+    copyText(event.text, sizeof(event.text), text);
+    return queue(event);
+}
+
+OutboxDelivery EventOutbox::deliver(OutboxSender& sender, size_t maxEvents) {
+    OutboxDelivery d = {0, 0, false, 0};
+    size_t budget = maxEvents;
+    bool changed = false;
+
+    // OTA logs, one request each; the first failure ends the round so the
+    // server never sees them out of order
+    for (size_t i = 0; i < blob_.count && budget > 0;) {
+        OutboxEvent& event = blob_.events[i];
+        if (event.kind != OUTBOX_OTA_LOG) {
+            i++;
+            continue;
+        }
+        budget--;
+        changed = true;
+        OutboxSendResult r = sender.sendOtaLog(event);
+        if (r == OUTBOX_RETRY) {
+            if (event.attempts < UINT8_MAX) event.attempts++;
+            d.failed = true;
+            break;
+        }
+        if (r == OUTBOX_SENT) {
+            d.sent++;
+        } else {
+            d.rejected++;
+        }
+        remove(i);
+    }
+
+    // Slack lines, oldest first, joined into a single message
+    char text[OUTBOX_SLACK_MAX];
+    size_t len = 0;
+    size_t batch[OUTBOX_CAPACITY];
+    size_t lines = 0;
+    for (size_t i = 0; i < blob_.count && budget > 0; i++) {
+        const OutboxEvent& event = blob_.events[i];
+        if (event.kind != OUTBOX_SLACK) continue;
+        char line[OUTBOX_TEXT_LEN + 16];
+        size_t n = outboxSlackLine(event, line, sizeof(line));
+        size_t sep = lines ? 1 : 0;
+        if (len + sep + n >= sizeof(text)) break;
+        if (sep) text[len++] = '\n';
+        memcpy(text + len, line, n);
+        len += n;
+        text[len] = '\0';
+        batch[lines++] = i;
+        budget--;
+    }
+    if (lines > 0) {
+        changed = true;
+        OutboxSendResult r = sender.sendSlack(text, len);
+        if (r == OUTBOX_RETRY) {
+            for (size_t k = 0; k < lines; k++) {
+                OutboxEvent& event = blob_.events[batch[k]];
+                if (event.attempts < UINT8_MAX) event.attempts++;
+            }
+            d.failed = true;
+        } else {
+            // Back to front, so the earlier indices stay valid
+            for (size_t k = lines; k-- > 0;) remove(batch[k]);
+            if (r == OUTBOX_SENT) {
+                d.sent += lines;
+            } else {
+                d.rejected += lines;
+            }
+        }
+    }
+
+    stats_.delivered += d.sent;
+    stats_.rejected += d.rejected;
+    if (changed) save();
+    d.pending = blob_.count;
+    return d;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "health_gate.h"
+#include "ota_downloader.h"
+
+#define OUTBOX_MAGIC 0x4f425831 // "OBX1"
+#define OUTBOX_CAPACITY 8
+#define OUTBOX_STATUS_LEN 24
+#define OUTBOX_VERSION_LEN 32
+#define OUTBOX_TEXT_LEN 112
+#define OUTBOX_SLACK_MAX 512    // text of one batched Slack message
+
+enum OutboxKind {
+    OUTBOX_OTA_LOG = 1, // POST to the OTA log endpoint
+    OUTBOX_SLACK        // line of a Slack webhook message
+};
+
+// One report waiting to go out. Plain data: the outbox is saved as one blob.
+struct OutboxEvent {
+    uint8_t kind;
+    bool hasTransfer;
+    bool hasHealth;
+    uint8_t attempts;                 // deliveries that failed so far
+    uint16_t count;                   // occurrences merged into this event
+    uint32_t seq;                     // order of the first occurrence
+    int32_t latencyMs;                // OTA log, of the latest occurrence
+    char status[OUTBOX_STATUS_LEN];   // OTA log
+    char version[OUTBOX_VERSION_LEN]; // OTA log
+    char text[OUTBOX_TEXT_LEN];       // OTA log error message, or the Slack text
+    OtaStats transfer;
+    HealthReport health;
+};
+
+// Where the outbox survives a restart: NVS on the ESP32 (esp_outbox_store.h),
+// memory in tests.
+class OutboxStore {
+public:
+    virtual ~OutboxStore() {}
+    // Copies the saved blob into buf; returns its length, 0 if there is none.
+    virtual size_t load(void* buf, size_t cap) = 0;
+    virtual bool save(const void* data, size_t len) = 0;
+};
+
+enum OutboxSendResult {
+    OUTBOX_SENT = 0,
+    OUTBOX_RETRY,   // network or server error; the event stays and is tried again
+    OUTBOX_REJECTED // refused for good (4xx, too large); the event is dropped
+};
+
+// Delivers events. Each call makes one request and returns at once on failure,
+// without retrying or sleeping: the outbox's owner reschedules.
+class OutboxSender {
+public:
+    virtual ~OutboxSender() {}
+    virtual OutboxSendResult sendOtaLog(const OutboxEvent& event) = 0;
+    // One Slack message carrying several events, one per line.
+    virtual OutboxSendResult sendSlack(const char* text, size_t len) = 0;
+};
+
+struct OutboxStats {
+    uint32_t queued;
+    uint32_t merged;     // duplicates folded into a pending event
+    uint32_t delivered;
+    uint32_t rejected;
+    uint32_t dropped;    // oldest events overwritten while full
+    uint32_t saveErrors;
+};
+
+struct OutboxDelivery {
+    size_t sent;
+    size_t rejected;
+    bool failed;         // a request failed; the rest waits for the next round
+    size_t pending;
+};
+
+// OTA log and Slack events reported off the update path. Queueing one only
+// saves the outbox, so it is on flash before the ESP.restart() that follows
+// an update; a job delivers it later over the pooled API connection. An
+// event equal to a pending one (same kind, status, version and text) is
+// merged into it and counted instead of queued again. Delivery is in order
+// of first occurrence; an OTA log that fails holds back the logs after it.
+// Not thread safe: the HTTP worker owns it.
+class EventOutbox {
+public:
+    explicit EventOutbox(OutboxStore& store);
+
+    // Takes over what the previous boot left. A blob with another magic,
+    // event layout or a bad checksum is discarded. Returns the pending count.
+    size_t restore();
+
+    // Queue an event and save the outbox; false if it could not be saved.
+    bool otaLog(const char* status, const char* version, const char* error, int32_t latencyMs,
+                const OtaStats* transfer = NULL, const HealthReport* health = NULL);
+    bool slack(const char* text);
+
+    // Sends up to maxEvents pending events: OTA logs one request each, the
+    // Slack lines joined into one message. Saves what is left.
+    OutboxDelivery deliver(OutboxSender& sender, size_t maxEvents);
+
+    size_t size() const { return blob_.count; }
+    bool empty() const { return blob_.count == 0; }
+    // Pending events in delivery order.
+    const OutboxEvent& at(size_t i) const { return blob_.events[i]; }
+    const OutboxStats& stats() const { return stats_; }
+
+private:
+    // The saved form; kept as is so a save needs no copy on the stack
+    struct Blob {
+        uint32_t magic;
+        uint32_t eventSize;
+        uint32_t count;
+        uint32_t nextSeq;
+        OutboxEvent events[OUTBOX_CAPACITY];
+        uint32_t checksum; // FNV-1a over everything before it
+    };
+
+    void reset();
+    bool queue(OutboxEvent& event);
+    void remove(size_t i);
+    bool save();
+
+    OutboxStore& store_;
+    Blob blob_;
+    OutboxStats stats_;
+};
+
+// The Slack text of an event, with " (x3)" appended once it was merged.
+// Returns the length; the text is cut short if it does not fit.
+size_t outboxSlackLine(const OutboxEvent& event, char* out, size_t cap);
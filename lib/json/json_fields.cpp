@@ -0,0 +1,79 @@
+#include "json_fields.h"
+#include <string.h>
+
+JsonFieldExtractor::JsonFieldExtractor(JsonField* fields, size_t count)
+    : fields_(fields), count_(count), parser_(text_, sizeof(text_)), pending_(-1), object_(false), ok_(true) {
+    for (size_t i = 0; i < count_; i++) {
+        fields_[i].found = false;
+        if (fields_[i].cap) fields_[i].out[0] = '\0';
+    }
+}
+
+bool JsonFieldExtractor::feed(const char* data, size_t len) {
+    if (!ok_) return false;
+    parser_.feed(data, len);
+    return drain();
+}
+
+bool JsonFieldExtractor::finish() {
+    if (!ok_) return false;
+    parser_.finish();
+    return drain() && object_;
+}
+
+bool JsonFieldExtractor::drain() {
+    for (;;) {
+        JsonToken t = parser_.next();
+        switch (t) {
+        case JSON_NEED_MORE:
+        case JSON_DONE:
+            return true;
+        case JSON_ERROR:
+            ok_ = false;
+            return false;
+        case JSON_BEGIN_OBJECT:
+            if (parser_.depth() == 1) {
+                object_ = true;
+                break;
+            }
+            pending_ = -1; // nested values are not captured
+            break;
+        case JSON_BEGIN_ARRAY:
+            if (parser_.depth() == 1) {
+                // The document must be an object.
+                ok_ = false;
+                return false;
+            }
+            pending_ = -1;
+            break;
+        case JSON_KEY:
+            pending_ = -1;
+            if (parser_.depth() != 1) break;
+            for (size_t i = 0; i < count_; i++) {
+                if (strcmp(parser_.text(), fields_[i].key) == 0) {
+                    pending_ = (int)i;
+                    break;
+                }
+            }
+            break;
+        case JSON_STRING:
+        case JSON_NUMBER:
+        case JSON_TRUE:
+        case JSON_FALSE:
+            if (pending_ >= 0 && parser_.depth() == 1) {
+                JsonField& f = fields_[pending_];
+                const char* v = t == JSON_TRUE ? "true" : t == JSON_FALSE ? "false" : parser_.text();
+                size_t len = strlen(v);
+                if (!parser_.truncated() && len < f.cap) {
+                    memcpy(f.out, v, len + 1);
+                    f.found = true;
+                }
+            }
+            pending_ = -1;
+            break;
+        default:
+            pending_ = -1;
+            break;
+        }
+    }
+}
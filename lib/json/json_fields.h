@@ -0,0 +1,36 @@
+#pragma once
+#include <stddef.h>
+#include "json_pull_parser.h"
+
+#define JSON_FIELDS_TEXT_LEN 256
+
+// A top-level scalar to capture, e.g. {"version", buf, sizeof(buf)}.
+struct JsonField {
+    const char* key;
+    char* out;
+    size_t cap;
+    bool found; // false if missing, not a scalar, or longer than cap - 1
+};
+
+// Streams a JSON object through JsonPullParser and copies the requested
+// top-level fields as they go by, so the body never has to be buffered.
+class JsonFieldExtractor {
+public:
+    JsonFieldExtractor(JsonField* fields, size_t count);
+
+    // Returns false once the document is known to be malformed.
+    bool feed(const char* data, size_t len);
+    // Returns true if the document was a complete, valid JSON object.
+    bool finish();
+
+private:
+    bool drain();
+
+    JsonField* fields_;
+    size_t count_;
+    char text_[JSON_FIELDS_TEXT_LEN];
+    JsonPullParser parser_;
+    int pending_; // field whose value comes next, -1 if none
+    bool object_;
+    bool ok_;
+};
@@ -0,0 +1,306 @@
+#include "json_pull_parser.h"
+#include <stdlib.h>
+
+JsonPullParser::JsonPullParser(char* textBuf, size_t textCap) : text_(textBuf), cap_(textCap) {
+    reset();
+}
+
+void JsonPullParser::reset() {
+    textLen_ = 0;
+    truncated_ = false;
+    if (cap_) text_[0] = '\0';
+    data_ = NULL;
+    len_ = pos_ = 0;
+    eof_ = false;
+    error_ = false;
+    lex_ = LEX_IDLE;
+    expect_ = EXPECT_START;
+    isKey_ = false;
+    depth_ = 0;
+    objects_ = 0;
+    literal_ = NULL;
+    literalPos_ = 0;
+    hexCount_ = 0;
+    hexValue_ = 0;
+    highSurrogate_ = 0;
+}
+
+void JsonPullParser::feed(const char* data, size_t len) {
+    data_ = data;
+    len_ = len;
+    pos_ = 0;
+}
+
+void JsonPullParser::finish() {
+    eof_ = true;
+}
+
+int32_t JsonPullParser::intValue() const {
+    return (int32_t)strtol(text_, NULL, 10);
+}
+
+double JsonPullParser::doubleValue() const {
+    return strtod(text_, NULL);
+}
+
+JsonToken JsonPullParser::fail() {
+    error_ = true;
+    return JSON_ERROR;
+}
+
+void JsonPullParser::append(char c) {
+    if (textLen_ + 1 < cap_) {
+        text_[textLen_++] = c;
+        text_[textLen_] = '\0';
+    } else {
+        truncated_ = true;
+    }
+}
+
+void JsonPullParser::appendCodepoint(uint32_t cp) {
+    if (cp < 0x80) {
+        append((char)cp);
+    } else if (cp < 0x800) {
+        append((char)(0xC0 | (cp >> 6)));
+        append((char)(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        append((char)(0xE0 | (cp >> 12)));
+        append((char)(0x80 | ((cp >> 6) & 0x3F)));
+        append((char)(0x80 | (cp & 0x3F)));
+    } else {
+        append((char)(0xF0 | (cp >> 18)));
+        append((char)(0x80 | ((cp >> 12) & 0x3F)));
+        append((char)(0x80 | ((cp >> 6) & 0x3F)));
+        append((char)(0x80 | (cp & 0x3F)));
+    }
+}
+
+bool JsonPullParser::canTakeValue() const {
+    return expect_ == EXPECT_START || expect_ == EXPECT_VALUE || expect_ == EXPECT_VALUE_OR_END;
+}
+
+JsonToken JsonPullParser::emitValue(JsonToken token) {
+    expect_ = depth_ == 0 ? EXPECT_DONE : EXPECT_COMMA_OR_END;
+    return token;
+}
+
+// -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool validNumber(const char* s) {
+    if (*s == '-') s++;
+    if (*s == '0') {
+        s++;
+    } else if (*s >= '1' && *s <= '9') {
+        while (*s >= '0' && *s <= '9') s++;
+    } else {
+        return false;
+    }
+    if (*s == '.') {
+        s++;
+        if (!(*s >= '0' && *s <= '9')) return false;
+        while (*s >= '0' && *s <= '9') s++;
+    }
+    if (*s == 'e' || *s == 'E') {
+        s++;
+        if (*s == '+' || *s == '-') s++;
+        if (!(*s >= '0' && *s <= '9')) return false;
+        while (*s >= '0' && *s <= '9') s++;
+    }
+    return *s == '\0';
+}
+
+JsonToken JsonPullParser::emitNumber() {
+    lex_ = LEX_IDLE;
+    if (truncated_ || !validNumber(text_)) return fail();
+    return emitValue(JSON_NUMBER);
+}
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+JsonToken JsonPullParser::next() {
+    if (error_) return JSON_ERROR;
+    for (;;) {
+        if (pos_ >= len_) {
+            if (!eof_) return JSON_NEED_MORE;
+            if (lex_ == LEX_NUMBER) return emitNumber();
+            if (lex_ != LEX_IDLE || expect_ != EXPECT_DONE) return fail();
+            return JSON_DONE;
+        }
+        char c = data_[pos_];
+
+        switch (lex_) {
+        case LEX_STRING:
+            pos_++;
+            if (c == '"') {
+                if (highSurrogate_) {
+                    appendCodepoint(0xFFFD);
+                    highSurrogate_ = 0;
+                }
+                lex_ = LEX_IDLE;
+                if (isKey_) {
+                    expect_ = EXPECT_COLON;
+                    return JSON_KEY;
+                }
+                return emitValue(JSON_STRING);
+            }
+            if (c == '\\') {
+                lex_ = LEX_ESCAPE;
+            } else if ((unsigned char)c < 0x20) {
+                return fail();
+            } else {
+                if (highSurrogate_) {
+                    appendCodepoint(0xFFFD);
+                    highSurrogate_ = 0;
+                }
+                append(c);
+            }
+            continue;
+
+        case LEX_ESCAPE: {
+            pos_++;
+            lex_ = LEX_STRING;
+            char out;
+            switch (c) {
+                case '"': out = '"'; break;
+                case '\\': out = '\\'; break;
+                case '/': out = '/'; break;
+                case 'b': out = '\b'; break;
+                case 'f': out = '\f'; break;
+                case 'n': out = '\n'; break;
+                case 'r': out = '\r'; break;
+                case 't': out = '\t'; break;
+                case 'u':
+                    lex_ = LEX_UNICODE;
+                    hexCount_ = 0;
+                    hexValue_ = 0;
+                    continue;
+                default:
+                    return fail();
+            }
+            if (highSurrogate_) {
+                appendCodepoint(0xFFFD);
+                highSurrogate_ = 0;
+            }
+            append(out);
+            continue;
+        }
+
+        case LEX_UNICODE: {
+            pos_++;
+            int h = hexDigit(c);
+            if (h < 0) return fail();
+            hexValue_ = (hexValue_ << 4) | (uint32_t)h;
+            if (++hexCount_ < 4) continue;
+            lex_ = LEX_STRING;
+            if (hexValue_ >= 0xD800 && hexValue_ < 0xDC00) {
+                if (highSurrogate_) appendCodepoint(0xFFFD);
+                highSurrogate_ = hexValue_;
+            } else if (hexValue_ >= 0xDC00 && hexValue_ < 0xE000) {
+                if (highSurrogate_) {
+                    appendCodepoint(0x10000 + ((highSurrogate_ - 0xD800) << 10) + (hexValue_ - 0xDC00));
+                    highSurrogate_ = 0;
+                } else {
+                    appendCodepoint(0xFFFD);
+                }
+            } else {
+                if (highSurrogate_) {
+                    appendCodepoint(0xFFFD);
+                    highSurrogate_ = 0;
+                }
+                appendCodepoint(hexValue_);
+            }
+            continue;
+        }
+
+        case LEX_NUMBER:
+            if ((c >= '0' && c <= '9') || c == '.' || c == 'e' || c == 'E' || c == '+' || c == '-') {
+                pos_++;
+                append(c);
+                continue;
+            }
+            return emitNumber();
+
+        case LEX_LITERAL:
+            pos_++;
+            if (c != literal_[literalPos_]) return fail();
+            if (literal_[++literalPos_] == '\0') {
+                lex_ = LEX_IDLE;
+                return emitValue(literalToken_);
+            }
+            continue;
+
+        case LEX_IDLE:
+            break;
+        }
+
+        pos_++;
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r') continue;
+        if (expect_ == EXPECT_DONE) return fail();
+
+        switch (c) {
+        case '{':
+        case '[':
+            if (!canTakeValue() || depth_ >= JSON_PARSER_MAX_DEPTH) return fail();
+            if (c == '{') objects_ |= 1u << depth_;
+            else objects_ &= ~(1u << depth_);
+            depth_++;
+            expect_ = c == '{' ? EXPECT_KEY_OR_END : EXPECT_VALUE_OR_END;
+            return c == '{' ? JSON_BEGIN_OBJECT : JSON_BEGIN_ARRAY;
+        case '}':
+            if (!inObject() || (expect_ != EXPECT_KEY_OR_END && expect_ != EXPECT_COMMA_OR_END)) return fail();
+            depth_--;
+            return emitValue(JSON_END_OBJECT);
+        case ']':
+            if (depth_ == 0 || inObject() || (expect_ != EXPECT_VALUE_OR_END && expect_ != EXPECT_COMMA_OR_END)) {
+                return fail();
+            }
+            depth_--;
+            return emitValue(JSON_END_ARRAY);
+        case ',':
+            if (expect_ != EXPECT_COMMA_OR_END) return fail();
+            expect_ = inObject() ? EXPECT_KEY : EXPECT_VALUE;
+            continue;
+        case ':':
+            if (expect_ != EXPECT_COLON) return fail();
+            expect_ = EXPECT_VALUE;
+            continue;
+        case '"':
+            if (expect_ == EXPECT_KEY || expect_ == EXPECT_KEY_OR_END) {
+                isKey_ = true;
+            } else if (canTakeValue()) {
+                isKey_ = false;
+            } else {
+                return fail();
+            }
+            lex_ = LEX_STRING;
+            textLen_ = 0;
+            truncated_ = false;
+            text_[0] = '\0';
+            highSurrogate_ = 0;
+            continue;
+        case 't':
+        case 'f':
+        case 'n':
+            if (!canTakeValue()) return fail();
+            literal_ = c == 't' ? "true" : c == 'f' ? "false" : "null";
+            literalToken_ = c == 't' ? JSON_TRUE : c == 'f' ? JSON_FALSE : JSON_NULL;
+            literalPos_ = 1;
+            lex_ = LEX_LITERAL;
+            continue;
+        default:
+            if (c == '-' || (c >= '0' && c <= '9')) {
+                if (!canTakeValue()) return fail();
+                lex_ = LEX_NUMBER;
+                textLen_ = 0;
+                truncated_ = false;
+                append(c);
+                continue;
+            }
+            return fail();
+        }
+    }
+}
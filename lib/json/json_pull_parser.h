@@ -0,0 +1,90 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_PARSER_MAX_DEPTH 32
+
+enum JsonToken {
+    JSON_NEED_MORE,     // chunk exhausted; feed() more input or finish()
+    JSON_BEGIN_OBJECT,
+    JSON_END_OBJECT,
+    JSON_BEGIN_ARRAY,
+    JSON_END_ARRAY,
+    JSON_KEY,
+    JSON_STRING,
+    JSON_NUMBER,
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL,
+    JSON_DONE,          // finish() was called and the document is complete
+    JSON_ERROR
+};
+
+// Incremental pull parser. Input arrives in chunks of any size (down to a
+// single byte) and is never buffered as a whole; only the text of the current
+// key/string/number is kept, in a caller-provided buffer. Longer values are
+// truncated and flagged by truncated().
+class JsonPullParser {
+public:
+    JsonPullParser(char* textBuf, size_t textCap);
+
+    void reset();
+    // The chunk must stay valid until next() returns JSON_NEED_MORE.
+    void feed(const char* data, size_t len);
+    // Marks the end of input, e.g. once the HTTP body is complete.
+    void finish();
+    JsonToken next();
+
+    const char* text() const { return text_; }
+    size_t textLength() const { return textLen_; }
+    bool truncated() const { return truncated_; }
+    uint8_t depth() const { return depth_; }
+    bool done() const { return expect_ == EXPECT_DONE; }
+    int32_t intValue() const;
+    double doubleValue() const;
+
+private:
+    enum Lex { LEX_IDLE, LEX_STRING, LEX_ESCAPE, LEX_UNICODE, LEX_NUMBER, LEX_LITERAL };
+    enum Expect {
+        EXPECT_START,
+        EXPECT_VALUE,
+        EXPECT_VALUE_OR_END,
+        EXPECT_KEY,
+        EXPECT_KEY_OR_END,
+        EXPECT_COLON,
+        EXPECT_COMMA_OR_END,
+        EXPECT_DONE
+    };
+
+    JsonToken fail();
+    JsonToken emitValue(JsonToken token);
+    JsonToken emitNumber();
+    bool canTakeValue() const;
+    bool inObject() const { return depth_ > 0 && (objects_ >> (depth_ - 1)) & 1u; }
+    void append(char c);
+    void appendCodepoint(uint32_t cp);
+
+    char* text_;
+    size_t cap_;
+    size_t textLen_;
+    bool truncated_;
+
+    const char* data_;
+    size_t len_;
+    size_t pos_;
+    bool eof_;
+    bool error_;
+
+    Lex lex_;
+    Expect expect_;
+    bool isKey_;
+    uint8_t depth_;
+    uint32_t objects_; // bit per level: 1 = object, 0 = array
+
+    const char* literal_;
+    uint8_t literalPos_;
+    JsonToken literalToken_;
+    uint8_t hexCount_;
+    uint32_t hexValue_;
+    uint32_t highSurrogate_;
+};
@@ -0,0 +1,196 @@
+#include "json_writer.h"
+#include <math.h>
+#include <string.h>
+
+JsonWriter::JsonWriter(char* buf, size_t cap)
+    : buf_(buf), cap_(cap), len_(0), ok_(cap > 0), depth_(0), hasItems_(0), afterKey_(false) {
+    if (cap_) buf_[0] = '\0';
+}
+
+void JsonWriter::put(char c) {
+    if (!ok_) return;
+    if (len_ + 1 >= cap_) {
+        ok_ = false;
+        return;
+    }
+    buf_[len_++] = c;
+    buf_[len_] = '\0';
+}
+
+void JsonWriter::put(const char* s, size_t n) {
+    if (!ok_) return;
+    if (len_ + n >= cap_) {
+        ok_ = false;
+        return;
+    }
+    memcpy(buf_ + len_, s, n);
+    len_ += n;
+    buf_[len_] = '\0';
+}
+
+void JsonWriter::putU32(uint32_t v) {
+    char tmp[10];
+    int n = 0;
+    do {
+        tmp[9 - n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    put(tmp + 10 - n, (size_t)n);
+}
+
+void JsonWriter::separator() {
+    if (afterKey_) {
+        afterKey_ = false;
+        return;
+    }
+    if (depth_ == 0) return;
+    uint16_t bit = (uint16_t)(1u << (depth_ - 1));
+    if (hasItems_ & bit) put(',');
+    hasItems_ |= bit;
+}
+
+void JsonWriter::open(char c) {
+    separator();
+    if (depth_ >= JSON_WRITER_MAX_DEPTH) {
+        ok_ = false;
+        return;
+    }
+    put(c);
+    depth_++;
+    hasItems_ &= (uint16_t)~(1u << (depth_ - 1));
+}
+
+void JsonWriter::close(char c) {
+    if (depth_ == 0) {
+        ok_ = false;
+        return;
+    }
+    depth_--;
+    put(c);
+}
+
+JsonWriter& JsonWriter::beginObject() { open('{'); return *this; }
+JsonWriter& JsonWriter::endObject() { close('}'); return *this; }
+JsonWriter& JsonWriter::beginArray() { open('['); return *this; }
+JsonWriter& JsonWriter::endArray() { close(']'); return *this; }
+
+JsonWriter& JsonWriter::beginObject(const char* members) {
+    open('{');
+    size_t n = strlen(members);
+    if (n == 0) return *this;
+    put(members, n);
+    hasItems_ |= (uint16_t)(1u << (depth_ - 1));
+    return *this;
+}
+
+JsonWriter& JsonWriter::key(const char* name) {
+    value(name);
+    put(':');
+    afterKey_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(const char* s) {
+    if (!s) return null();
+    return value(s, strlen(s));
+}
+
+JsonWriter& JsonWriter::value(const char* s, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    separator();
+    put('"');
+    size_t start = 0;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+        put(s + start, i - start);
+        start = i + 1;
+        switch (c) {
+            case '"': put("\\\"", 2); break;
+            case '\\': put("\\\\", 2); break;
+            case '\n': put("\\n", 2); break;
+            case '\r': put("\\r", 2); break;
+            case '\t': put("\\t", 2); break;
+            case '\b': put("\\b", 2); break;
+            case '\f': put("\\f", 2); break;
+            default: {
+                char esc[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+                put(esc, 6);
+            }
+        }
+    }
+    put(s + start, len - start);
+    put('"');
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(int32_t v) {
+    separator();
+    if (v < 0) put('-');
+    putU32(v < 0 ? (uint32_t)(-(int64_t)v) : (uint32_t)v);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(uint32_t v) {
+    separator();
+    putU32(v);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(bool v) {
+    separator();
+    if (v) put("true", 4);
+    else put("false", 5);
+    return *this;
+}
+
+JsonWriter& JsonWriter::fixed(int32_t scaled, uint8_t decimals) {
+    separator();
+    uint32_t mag = scaled < 0 ? (uint32_t)(-(int64_t)scaled) : (uint32_t)scaled;
+    if (scaled < 0) put('-');
+    uint32_t div = 1;
+    for (uint8_t i = 0; i < decimals; i++) div *= 10;
+    putU32(mag / div);
+    if (decimals == 0) return *this;
+    put('.');
+    uint32_t frac = mag % div;
+    for (uint32_t d = div / 10; d > 1 && frac < d; d /= 10) put('0');
+    putU32(frac);
+    return *this;
+}
+
+JsonWriter& JsonWriter::value(double v, uint8_t decimals) {
+    if (isnan(v) || isinf(v)) return null();
+    if (decimals > 6) decimals = 6;
+    double scale = 1;
+    for (uint8_t i = 0; i < decimals; i++) scale *= 10;
+    double scaled = v * scale;
+    if (scaled > 2147483647.0 || scaled < -2147483647.0) {
+        // Out of fixed-point range: fall back to the integer part.
+        separator();
+        if (v < 0) put('-');
+        double mag = fabs(v);
+        char tmp[24];
+        int n = 0;
+        while (mag >= 1 && n < 24) {
+            double q = floor(mag / 10);
+            tmp[23 - n++] = (char)('0' + (int)(mag - q * 10));
+            mag = q;
+        }
+        put(tmp + 24 - n, (size_t)n);
+        return *this;
+    }
+    return fixed((int32_t)(scaled + (scaled < 0 ? -0.5 : 0.5)), decimals);
+}
+
+JsonWriter& JsonWriter::null() {
+    separator();
+    put("null", 4);
+    return *this;
+}
+
+JsonWriter& JsonWriter::raw(const char* json) {
+    separator();
+    put(json, strlen(json));
+    return *this;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_WRITER_MAX_DEPTH 16
+
+// Serializes JSON into a caller-provided buffer without touching the heap.
+// Commas are inserted automatically. On overflow the writer stops, ok()
+// turns false and the buffer keeps a NUL-terminated (truncated) prefix.
+class JsonWriter {
+public:
+    JsonWriter(char* buf, size_t cap);
+
+    JsonWriter& beginObject();
+    // Opens an object whose first members are already serialized, e.g.
+    // "\"device_id\":\"esp32-01\"" put together at compile time.
+    JsonWriter& beginObject(const char* members);
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+    JsonWriter& key(const char* name);
+
+    JsonWriter& value(const char* s);           // escaped string, NULL -> null
+    JsonWriter& value(const char* s, size_t len);
+    JsonWriter& value(int32_t v);
+    JsonWriter& value(uint32_t v);
+    JsonWriter& value(bool v);
+    JsonWriter& value(double v, uint8_t decimals);
+    // Writes scaled / 10^decimals exactly, e.g. (2550, 2) -> 25.50.
+    JsonWriter& fixed(int32_t scaled, uint8_t decimals);
+    JsonWriter& null();
+    // Inserts pre-serialized JSON as one value.
+    JsonWriter& raw(const char* json);
+
+    bool ok() const { return ok_; }
+    size_t length() const { return len_; }
+    const char* c_str() const { return buf_; }
+
+private:
+    void separator();
+    void put(char c);
+    void put(const char* s, size_t n);
+    void putU32(uint32_t v);
+    void open(char c);
+    void close(char c);
+
+    char* buf_;
+    size_t cap_;
+    size_t len_;
+    bool ok_;
+    uint8_t depth_;
+    uint16_t hasItems_; // bit per level: a value was already written
+    bool afterKey_;
+};
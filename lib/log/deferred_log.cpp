@@ -0,0 +1,240 @@
+#include "deferred_log.h"
+#include <stdio.h>
+#include <string.h>
+
+static std::atomic<DeferredLog*> installed(NULL);
+
+void logInstall(DeferredLog* log) {
+    installed.store(log, std::memory_order_release);
+}
+
+DeferredLog* installedLog() {
+    return installed.load(std::memory_order_acquire);
+}
+
+const char* logModuleName(uint8_t module) {
+    static const char* const names[LOG_MODULE_COUNT] = {"core", "net", "mqtt", "ota", "sensor", "power", "cmd"};
+    return module < LOG_MODULE_COUNT ? names[module] : "?";
+}
+
+char logLevelLetter(uint8_t level) {
+    static const char letters[] = "-EWID";
+    return level <= LOG_LEVEL_DEBUG ? letters[level] : '?';
+}
+
+size_t formatLogLine(const LogLine& line, char* out, size_t cap) {
+    int n = snprintf(out, cap, "%u.%03u %c %.*s\n", (unsigned)(line.ms / 1000), (unsigned)(line.ms % 1000),
+                     logLevelLetter(line.level), (int)line.len, line.text);
+    if (n < 0 || cap == 0) return 0;
+    return (size_t)n < cap ? (size_t)n : cap - 1;
+}
+
+static bool isPowerOfTwo(size_t n) {
+    return n && (n & (n - 1)) == 0;
+}
+
+// A capacity that is not a power of two leaves a one-slot ring, which
+// keeps the log usable and shows up as dropped records
+DeferredLog::DeferredLog(LogSlot* slots, size_t capacity, uint32_t (*nowMs)())
+    : slots_(slots), mask_(isPowerOfTwo(capacity) ? (uint32_t)capacity - 1 : 0), nowMs_(nowMs), head_(0), tail_(0),
+      written_(0), dropped_(0), highWater_(0), droppedReported_(0) {
+    for (uint32_t i = 0; i <= mask_; i++) slots_[i].seq.store(i, std::memory_order_relaxed);
+}
+
+// Bounded MPMC queue after D. Vyukov: a slot's sequence number says whose
+// turn it is. seq == pos: free for the producer that claims position pos;
+// seq == pos + 1: published, for the consumer at pos; the consumer hands it
+// back for the next lap with seq = pos + capacity.
+LogSlot* DeferredLog::claim() {
+    uint32_t pos = head_.load(std::memory_order_relaxed);
+    for (;;) {
+        LogSlot* slot = &slots_[pos & mask_];
+        int32_t diff = (int32_t)(slot->seq.load(std::memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                uint32_t used = pos + 1 - tail_.load(std::memory_order_relaxed);
+                uint32_t high = highWater_.load(std::memory_order_relaxed);
+                while (used > high && !highWater_.compare_exchange_weak(high, used, std::memory_order_relaxed)) {
+                }
+                LogRecord& r = slot->record;
+                r.ms = nowMs_();
+                r.argc = 0;
+                r.textLen = 0;
+                r.types = 0;
+                return slot;
+            }
+        } else if (diff < 0) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return NULL;
+        } else {
+            pos = head_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void DeferredLog::publish(LogSlot* slot) {
+    // Only this producer touches seq between claim() and here
+    slot->seq.store(slot->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    written_.fetch_add(1, std::memory_order_relaxed);
+}
+
+LogArg* DeferredLog::next(LogRecord& r, LogArgType type) {
+    if (r.argc >= LOG_MAX_ARGS) return NULL;
+    r.types |= (uint16_t)(type << (2 * r.argc));
+    return &r.args[r.argc++];
+}
+
+void DeferredLog::putText(LogRecord& r, const char* s) {
+    LogArg* a = next(r, LOG_ARG_TEXT);
+    if (!a) return;
+    if (!s) s = "(null)";
+    // Once the area is full every further string points at its last NUL
+    size_t room = LOG_TEXT_BYTES - r.textLen;
+    if (room <= 1) {
+        a->text = LOG_TEXT_BYTES - 1;
+        return;
+    }
+    size_t n = strlen(s);
+    if (n > room - 1) n = room - 1;
+    memcpy(r.text + r.textLen, s, n);
+    r.text[r.textLen + n] = '\0';
+    a->text = r.textLen;
+    r.textLen = (uint8_t)(r.textLen + n + 1);
+}
+
+size_t DeferredLog::size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+}
+
+// --- formatting ---
+
+static int64_t argInt(const LogRecord& r, int i) {
+    const LogArg& a = r.args[i];
+    switch ((r.types >> (2 * i)) & 3) {
+        case LOG_ARG_INT: return a.i;
+        case LOG_ARG_UINT: return (int64_t)a.u;
+        case LOG_ARG_DOUBLE: return (int64_t)a.d;
+    }
+    return 0;
+}
+
+static double argDouble(const LogRecord& r, int i) {
+    const LogArg& a = r.args[i];
+    switch ((r.types >> (2 * i)) & 3) {
+        case LOG_ARG_INT: return (double)a.i;
+        case LOG_ARG_UINT: return (double)a.u;
+        case LOG_ARG_DOUBLE: return a.d;
+    }
+    return 0;
+}
+
+static const char* argText(const LogRecord& r, int i) {
+    if (((r.types >> (2 * i)) & 3) != LOG_ARG_TEXT) return "?";
+    return r.text + r.args[i].text;
+}
+
+// Copies the conversion spec at p ('%') into spec without its length
+// modifier, then appends the modifier the stored argument needs. Returns
+// the conversion character (0 if there is none) and sets *end past it.
+static char parseSpec(const char* p, char* spec, size_t cap, const char** end) {
+    size_t n = 0;
+    spec[n++] = *p++;
+    while (*p && strchr("-+ #0123456789.", *p)) {
+        if (n + 4 < cap) spec[n++] = *p;
+        p++;
+    }
+    while (*p && strchr("hlLqjzt", *p)) p++;
+    char conv = *p;
+    *end = conv ? p + 1 : p;
+    if (conv && strchr("diuxXo", conv)) {
+        spec[n++] = 'l';
+        spec[n++] = 'l';
+    }
+    spec[n++] = conv;
+    spec[n] = '\0';
+    return conv;
+}
+
+size_t DeferredLog::format(const LogRecord& r, char* out, size_t cap) {
+    if (cap == 0) return 0;
+    size_t len = 0;
+    int arg = 0;
+    const char* p = r.fmt;
+    while (*p && len + 1 < cap) {
+        if (*p != '%') {
+            out[len++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            out[len++] = '%';
+            p += 2;
+            continue;
+        }
+        char spec[16];
+        char conv = parseSpec(p, spec, sizeof(spec), &p);
+        if (!conv) break;
+        char* dst = out + len;
+        size_t room = cap - len;
+        int n;
+        if (arg >= r.argc) {
+            n = snprintf(dst, room, "?");
+        } else if (conv == 'd' || conv == 'i') {
+            n = snprintf(dst, room, spec, (long long)argInt(r, arg));
+        } else if (strchr("uxXo", conv)) {
+            n = snprintf(dst, room, spec, (unsigned long long)argInt(r, arg));
+        } else if (conv == 'c') {
+            n = snprintf(dst, room, spec, (int)argInt(r, arg));
+        } else if (strchr("fFeEgGaA", conv)) {
+            n = snprintf(dst, room, spec, argDouble(r, arg));
+        } else if (conv == 's') {
+            n = snprintf(dst, room, spec, argText(r, arg));
+        } else {
+            n = snprintf(dst, room, "?");
+        }
+        arg++;
+        if (n < 0) break;
+        len += (size_t)n < room ? (size_t)n : room - 1;
+    }
+    out[len] = '\0';
+    return len;
+}
+
+// --- consumer ---
+
+static bool takeRecord(LogSlot* slots, uint32_t mask, std::atomic<uint32_t>& tail, LogRecord& out) {
+    uint32_t pos = tail.load(std::memory_order_relaxed);
+    for (;;) {
+        LogSlot* slot = &slots[pos & mask];
+        int32_t diff = (int32_t)(slot->seq.load(std::memory_order_acquire) - (pos + 1));
+        if (diff == 0) {
+            if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                out = slot->record;
+                slot->seq.store(pos + mask + 1, std::memory_order_release);
+                return true;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = tail.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t DeferredLog::drain(LogSink sink, void* ctx, size_t max) {
+    char text[LOG_LINE_MAX];
+    uint32_t dropped = dropped_.load(std::memory_order_relaxed);
+    uint32_t reported = droppedReported_.exchange(dropped, std::memory_order_relaxed);
+    if (dropped != reported) {
+        int n = snprintf(text, sizeof(text), "[Log] %u records dropped, ring full", (unsigned)(dropped - reported));
+        LogLine line = {nowMs_(), LOG_LEVEL_WARN, LOG_MOD_CORE, text, (size_t)n};
+        sink(line, ctx);
+    }
+    size_t count = 0;
+    LogRecord r;
+    while (count < max && takeRecord(slots_, mask_, tail_, r)) {
+        LogLine line = {r.ms, r.level, r.module, text, format(r, text, sizeof(text))};
+        sink(line, ctx);
+        count++;
+    }
+    return count;
+}
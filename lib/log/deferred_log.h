@@ -0,0 +1,206 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <type_traits>
+
+// Deferred logging: a LOGx() call stores the format string pointer and the
+// raw arguments in a lock-free ring and returns; a low-priority task formats
+// and prints the records later, so a task on a hot path never waits for the
+// UART. Format strings must be literals (they are kept by pointer); %s
+// arguments are copied into the record and cut at LOG_TEXT_BYTES in total.
+//
+//   LOGI(NET, "[HTTP] %s %s attempt %u/%u: %d", method, url, attempt, attempts, code);
+//
+// Levels are compiled out per module: a call above LOG_MAX_<MODULE> (default
+// LOG_MAX) is dead code, arguments and format string included, e.g.
+// -DLOG_MAX=LOG_LEVEL_WARN -DLOG_MAX_OTA=LOG_LEVEL_DEBUG.
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_MAX
+#define LOG_MAX LOG_LEVEL_INFO
+#endif
+#ifndef LOG_MAX_CORE
+#define LOG_MAX_CORE LOG_MAX
+#endif
+#ifndef LOG_MAX_NET
+#define LOG_MAX_NET LOG_MAX
+#endif
+#ifndef LOG_MAX_MQTT
+#define LOG_MAX_MQTT LOG_MAX
+#endif
+#ifndef LOG_MAX_OTA
+#define LOG_MAX_OTA LOG_MAX
+#endif
+#ifndef LOG_MAX_SENSOR
+#define LOG_MAX_SENSOR LOG_MAX
+#endif
+#ifndef LOG_MAX_POWER
+#define LOG_MAX_POWER LOG_MAX
+#endif
+#ifndef LOG_MAX_CMD
+#define LOG_MAX_CMD LOG_MAX
+#endif
+
+#define LOG_MAX_ARGS 6
+#ifndef LOG_TEXT_BYTES
+#define LOG_TEXT_BYTES 96 // copied %s arguments of one record, NULs included; an API URL fits
+#endif
+#define LOG_LINE_MAX 192  // a formatted message, longer ones are cut
+
+enum LogModule {
+    LOG_MOD_CORE = 0, // setup, tasks, memory, the logger itself
+    LOG_MOD_NET,      // WiFi, TLS, HTTP, heartbeat, Slack
+    LOG_MOD_MQTT,
+    LOG_MOD_OTA,
+    LOG_MOD_SENSOR,   // sampling, batches, flash queue
+    LOG_MOD_POWER,
+    LOG_MOD_CMD,      // backend commands
+    LOG_MODULE_COUNT
+};
+
+const char* logModuleName(uint8_t module);
+char logLevelLetter(uint8_t level); // 'E', 'W', 'I', 'D'
+
+enum LogArgType { LOG_ARG_INT = 0, LOG_ARG_UINT, LOG_ARG_DOUBLE, LOG_ARG_TEXT };
+
+union LogArg {
+    int64_t i;
+    uint64_t u;
+    double d;
+    uint16_t text; // offset into LogRecord::text
+};
+
+struct LogRecord {
+    const char* fmt;
+    uint32_t ms;
+    uint8_t level;
+    uint8_t module;
+    uint8_t argc;
+    uint8_t textLen;
+    uint16_t types; // LogArgType per argument, 2 bits each
+    LogArg args[LOG_MAX_ARGS];
+    char text[LOG_TEXT_BYTES];
+};
+
+// A record as the drain hands it out: the message is formatted, without
+// timestamp, level or newline. text is only valid during the sink call.
+struct LogLine {
+    uint32_t ms;
+    uint8_t level;
+    uint8_t module;
+    const char* text;
+    size_t len;
+};
+
+typedef void (*LogSink)(const LogLine& line, void* ctx);
+
+// Formats line as "12.345 I <text>\n" (seconds since boot); returns the
+// length, cut to cap - 1.
+size_t formatLogLine(const LogLine& line, char* out, size_t cap);
+
+struct LogSlot {
+    std::atomic<uint32_t> seq; // claim/publish handshake, see DeferredLog::claim()
+    LogRecord record;
+};
+
+// Bounded multi-producer, multi-consumer ring of LogRecords over caller
+// storage (capacity a power of two). Producers never wait for the consumer:
+// a full ring drops the new record and counts it. Any task may write, and
+// draining from a second task (e.g. to flush before a restart) is safe.
+class DeferredLog {
+public:
+    DeferredLog(LogSlot* slots, size_t capacity, uint32_t (*nowMs)());
+
+    template <class... Args>
+    void write(uint8_t module, uint8_t level, const char* fmt, const Args&... args) {
+        LogSlot* slot = claim();
+        if (!slot) return;
+        LogRecord& r = slot->record;
+        r.fmt = fmt;
+        r.level = level;
+        r.module = module;
+        pack(r, args...);
+        publish(slot);
+    }
+
+    // Formats and hands out up to max records, oldest first; a line about
+    // dropped records comes first when there were any since the last drain.
+    // Returns the number of records handed out.
+    size_t drain(LogSink sink, void* ctx, size_t max = (size_t)-1);
+
+    size_t capacity() const { return mask_ + 1; }
+    size_t size() const;
+    uint32_t written() const { return written_.load(std::memory_order_relaxed); }
+    uint32_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    uint32_t highWater() const { return highWater_.load(std::memory_order_relaxed); }
+
+    // Formats one record's message; also used by the benchmarks.
+    static size_t format(const LogRecord& r, char* out, size_t cap);
+
+private:
+    LogSlot* claim();
+    void publish(LogSlot* slot);
+
+    static void pack(LogRecord&) {}
+    template <class T, class... Rest>
+    static void pack(LogRecord& r, const T& v, const Rest&... rest) {
+        put(r, v);
+        pack(r, rest...);
+    }
+
+    template <class T>
+    static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    put(LogRecord& r, T v) {
+        if (LogArg* a = next(r, LOG_ARG_INT)) a->i = v;
+    }
+    template <class T>
+    static typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+    put(LogRecord& r, T v) {
+        if (LogArg* a = next(r, LOG_ARG_UINT)) a->u = v;
+    }
+    template <class T>
+    static typename std::enable_if<std::is_enum<T>::value>::type put(LogRecord& r, T v) {
+        if (LogArg* a = next(r, LOG_ARG_INT)) a->i = (int64_t)v;
+    }
+    template <class T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type put(LogRecord& r, T v) {
+        if (LogArg* a = next(r, LOG_ARG_DOUBLE)) a->d = v;
+    }
+    static void put(LogRecord& r, const char* s) { putText(r, s); }
+
+    static LogArg* next(LogRecord& r, LogArgType type);
+    static void putText(LogRecord& r, const char* s);
+
+    LogSlot* slots_;
+    uint32_t mask_;
+    uint32_t (*nowMs_)();
+    std::atomic<uint32_t> head_;  // next slot to claim
+    std::atomic<uint32_t> tail_;  // next slot to drain
+    std::atomic<uint32_t> written_;
+    std::atomic<uint32_t> dropped_;
+    std::atomic<uint32_t> highWater_;
+    std::atomic<uint32_t> droppedReported_;
+};
+
+// The log the LOGx() macros write to; while it is NULL (the default) they
+// do nothing and their arguments are not evaluated.
+void logInstall(DeferredLog* log);
+DeferredLog* installedLog();
+
+#define LOG_AT(mod, lvl, ...)                                                          \
+    do {                                                                               \
+        if ((lvl) <= LOG_MAX_##mod) {                                                  \
+            DeferredLog* log_ = installedLog();                                        \
+            if (log_) log_->write(LOG_MOD_##mod, (lvl), __VA_ARGS__);                  \
+        }                                                                              \
+    } while (0)
+#define LOGE(mod, ...) LOG_AT(mod, LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOGW(mod, ...) LOG_AT(mod, LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOGI(mod, ...) LOG_AT(mod, LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOGD(mod, ...) LOG_AT(mod, LOG_LEVEL_DEBUG, __VA_ARGS__)
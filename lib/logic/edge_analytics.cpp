@@ -0,0 +1,87 @@
+#include "edge_analytics.h"
+
+void RunningStats::reset() {
+    n_ = 0;
+    min_ = max_ = mean_ = m2_ = 0.0f;
+}
+
+void RunningStats::add(float v) {
+    if (n_ == 0) {
+        min_ = max_ = v;
+    } else {
+        if (v < min_) min_ = v;
+        if (v > max_) max_ = v;
+    }
+    n_++;
+    float d = v - mean_;
+    mean_ += d / n_;
+    m2_ += d * (v - mean_);
+}
+
+float Ewma::add(float v) {
+    if (!primed_) {
+        value_ = v;
+        primed_ = true;
+    } else {
+        value_ += alpha_ * (v - value_);
+    }
+    return value_;
+}
+
+const char* alarmStateName(AlarmState state) {
+    switch (state) {
+    case ALARM_HIGH: return "high";
+    case ALARM_LOW: return "low";
+    default: return "clear";
+    }
+}
+
+AlarmState HysteresisAlarm::target(float v) const {
+    switch (state_) {
+    case ALARM_HIGH:
+        if (v > limits_.highClear) return ALARM_HIGH;
+        break;
+    case ALARM_LOW:
+        if (v < limits_.lowClear) return ALARM_LOW;
+        break;
+    default:
+        break;
+    }
+    if (v >= limits_.highSet) return ALARM_HIGH;
+    if (v <= limits_.lowSet) return ALARM_LOW;
+    return ALARM_CLEAR;
+}
+
+bool HysteresisAlarm::update(float v) {
+    AlarmState next = target(v);
+    if (next == state_) {
+        streak_ = 0;
+        return false;
+    }
+    if (next != pending_) {
+        pending_ = next;
+        streak_ = 0;
+    }
+    if (++streak_ < limits_.holdSamples) return false;
+    state_ = next;
+    streak_ = 0;
+    return true;
+}
+
+bool DeadbandFilter::shouldReport(float v, uint32_t nowMs) {
+    bool report = !primed_ || fabsf(v - last_) > deadband_ ||
+                  (maxSilenceMs_ && nowMs - lastMs_ >= maxSilenceMs_);
+    if (report) {
+        last_ = v;
+        lastMs_ = nowMs;
+        primed_ = true;
+    }
+    return report;
+}
+
+bool ChannelAnalytics::closeInterval(uint32_t nowMs, RunningStats* out) {
+    if (out) *out = interval_;
+    bool report = interval_.count() > 0 && deadband_.shouldReport(interval_.mean(), nowMs);
+    interval_.reset();
+    return report;
+}
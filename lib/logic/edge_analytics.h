@@ -0,0 +1,228 @@
+#pragma once
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming statistics and threshold logic for on-device aggregation.
+// Nothing here allocates; per-sample cost is O(1).
+
+// Count, min, max, mean and variance of every value since reset(), using
+// Welford's method. One instance covers one reporting interval.
+class RunningStats {
+public:
+    RunningStats() { reset(); }
+    void reset();
+    void add(float v);
+
+    uint32_t count() const { return n_; }
+    float min() const { return min_; }
+    float max() const { return max_; }
+    float mean() const { return mean_; }
+    float variance() const { return n_ > 1 ? m2_ / (n_ - 1) : 0.0f; } // sample variance
+    float stddev() const { return sqrtf(variance()); }
+
+private:
+    uint32_t n_;
+    float min_;
+    float max_;
+    float mean_;
+    float m2_;
+};
+
+// The same statistics over the last N values. Min and max come from
+// monotonic queues; mean and variance are updated in place and recomputed
+// from the stored values once every N samples so float error cannot build up.
+template <size_t N>
+class SlidingWindow {
+public:
+    SlidingWindow() { reset(); }
+
+    void reset() {
+        count_ = next_ = 0;
+        seq_ = 0;
+        mean_ = m2_ = 0.0f;
+        minQ_.clear();
+        maxQ_.clear();
+    }
+
+    void add(float v) {
+        if (count_ == N) {
+            float old = values_[next_];
+            float mean = mean_ + (v - old) / N;
+            m2_ += (v - old) * (v - mean + old - mean_);
+            mean_ = mean;
+        } else {
+            count_++;
+            float d = v - mean_;
+            mean_ += d / count_;
+            m2_ += d * (v - mean_);
+        }
+        values_[next_] = v;
+        next_ = (next_ + 1) % N;
+        minQ_.push(v, seq_, true);
+        maxQ_.push(v, seq_, false);
+        seq_++;
+        if (count_ == N && next_ == 0) recompute();
+    }
+
+    size_t count() const { return count_; }
+    bool full() const { return count_ == N; }
+    float min() const { return count_ ? minQ_.front() : 0.0f; }
+    float max() const { return count_ ? maxQ_.front() : 0.0f; }
+    float mean() const { return mean_; }
+    float variance() const { return count_ > 1 && m2_ > 0 ? m2_ / (count_ - 1) : 0.0f; }
+    float stddev() const { return sqrtf(variance()); }
+
+private:
+    // Candidates for the window min (or max) in arrival order.
+    struct MonoQueue {
+        float v[N];
+        uint32_t seq[N];
+        size_t head;
+        size_t len;
+
+        void clear() { head = len = 0; }
+        float front() const { return v[head]; }
+        void push(float x, uint32_t s, bool isMin) {
+            if (len && seq[head] + N <= s) { // left the window
+                head = (head + 1) % N;
+                len--;
+            }
+            while (len) {
+                size_t back = (head + len - 1) % N;
+                if (isMin ? v[back] < x : v[back] > x) break;
+                len--;
+            }
+            size_t at = (head + len) % N;
+            v[at] = x;
+            seq[at] = s;
+            len++;
+        }
+    };
+
+    void recompute() {
+        float sum = 0.0f;
+        for (size_t i = 0; i < N; i++) sum += values_[i];
+        mean_ = sum / N;
+        m2_ = 0.0f;
+        for (size_t i = 0; i < N; i++) m2_ += (values_[i] - mean_) * (values_[i] - mean_);
+    }
+
+    float values_[N];
+    size_t count_;
+    size_t next_;
+    uint32_t seq_;
+    float mean_;
+    float m2_;
+    MonoQueue minQ_;
+    MonoQueue maxQ_;
+};
+
+// Exponentially weighted moving average; the first value seeds it.
+class Ewma {
+public:
+    explicit Ewma(float alpha) : alpha_(alpha), value_(0.0f), primed_(false) {}
+    float add(float v);
+    void reset() { primed_ = false; }
+    float value() const { return value_; }
+    bool primed() const { return primed_; }
+
+private:
+    float alpha_;
+    float value_;
+    bool primed_;
+};
+
+enum AlarmState {
+    ALARM_CLEAR = 0,
+    ALARM_HIGH = 1,
+    ALARM_LOW = 2
+};
+
+const char* alarmStateName(AlarmState state);
+
+// An alarm raises at *Set and clears only once the value is back past
+// *Clear, so noise around a limit does not toggle it. Use INFINITY /
+// -INFINITY to disable a side.
+struct AlarmLimits {
+    float highSet;
+    float highClear;
+    float lowSet;
+    float lowClear;
+    uint8_t holdSamples; // consecutive samples needed before a change, 0 or 1 for none
+};
+
+class HysteresisAlarm {
+public:
+    explicit HysteresisAlarm(const AlarmLimits& limits)
+        : limits_(limits), state_(ALARM_CLEAR), pending_(ALARM_CLEAR), streak_(0) {}
+
+    // Returns true when the state changed on this value.
+    bool update(float v);
+    AlarmState state() const { return state_; }
+    void setLimits(const AlarmLimits& limits) { limits_ = limits; }
+
+private:
+    AlarmState target(float v) const;
+
+    AlarmLimits limits_;
+    AlarmState state_;
+    AlarmState pending_;
+    uint8_t streak_;
+};
+
+// Report by exception: a value is worth sending when it moved more than the
+// deadband since the last one sent, or when nothing was sent for
+// maxSilenceMs (0: never) so the receiver can tell quiet from dead.
+class DeadbandFilter {
+public:
+    DeadbandFilter(float deadband, uint32_t maxSilenceMs)
+        : deadband_(deadband), maxSilenceMs_(maxSilenceMs), last_(0.0f), lastMs_(0), primed_(false) {}
+
+    // Returns true, and remembers v as sent, when v should be reported.
+    bool shouldReport(float v, uint32_t nowMs);
+    float lastReported() const { return last_; }
+    void reset() { primed_ = false; }
+
+private:
+    float deadband_;
+    uint32_t maxSilenceMs_;
+    float last_;
+    uint32_t lastMs_;
+    bool primed_;
+};
+
+struct ChannelConfig {
+    float ewmaAlpha;       // smoothing for the alarm input, 1 = raw values
+    AlarmLimits limits;
+    float deadband;        // on the interval mean
+    uint32_t maxSilenceMs;
+};
+
+// One sensor channel: interval statistics, a smoothed value feeding the
+// alarm, and the deadband decision for the interval summary.
+class ChannelAnalytics {
+public:
+    explicit ChannelAnalytics(const ChannelConfig& config)
+        : ewma_(config.ewmaAlpha), alarm_(config.limits), deadband_(config.deadband, config.maxSilenceMs) {}
+
+    // Returns true when the alarm state changed on this value.
+    bool add(float v) {
+        interval_.add(v);
+        return alarm_.update(ewma_.add(v));
+    }
+
+    // Ends the current interval and copies its statistics to out. Returns
+    // true when they should be reported.
+    bool closeInterval(uint32_t nowMs, RunningStats* out);
+
+    const RunningStats& interval() const { return interval_; }
+    float smoothed() const { return ewma_.value(); }
+    AlarmState alarm() const { return alarm_.state(); }
+
+private:
+    RunningStats interval_;
+    Ewma ewma_;
+    HysteresisAlarm alarm_;
+    DeadbandFilter deadband_;
+};
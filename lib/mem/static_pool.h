@@ -0,0 +1,56 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed set of N objects reserved at link time. The objects are built once
+// with the pool and handed out again and again, so a long-lived device
+// never returns them to the heap and cannot fragment it. The high-water
+// mark tells how many were ever needed at once, i.e. how far N can shrink.
+// Not thread safe: one task owns the pool, like the HTTP pool that uses it.
+template <class T, size_t N>
+class StaticPool {
+public:
+    StaticPool() : inUse_(0), highWater_(0), exhausted_(0) {
+        for (size_t i = 0; i < N; i++) used_[i] = false;
+    }
+
+    // A free object, or NULL when all N are out.
+    T* acquire() {
+        for (size_t i = 0; i < N; i++) {
+            if (used_[i]) continue;
+            used_[i] = true;
+            if (++inUse_ > highWater_) highWater_ = inUse_;
+            return &items_[i];
+        }
+        exhausted_++;
+        return NULL;
+    }
+
+    // Returns false for objects that are not out of this pool.
+    bool release(const T* item) {
+        if (!owns(item)) return false;
+        size_t i = (size_t)(item - items_);
+        if (!used_[i]) return false;
+        used_[i] = false;
+        inUse_--;
+        return true;
+    }
+
+    bool owns(const T* item) const { return item >= items_ && item < items_ + N; }
+
+    // Every object, free or not, e.g. to configure them once at boot.
+    T& at(size_t i) { return items_[i]; }
+
+    static size_t capacity() { return N; }
+    static size_t reservedBytes() { return sizeof(T) * N; }
+    size_t inUse() const { return inUse_; }
+    size_t highWater() const { return highWater_; }
+    uint32_t exhausted() const { return exhausted_; } // acquire() calls that found none free
+
+private:
+    T items_[N];
+    bool used_[N];
+    size_t inUse_;
+    size_t highWater_;
+    uint32_t exhausted_;
+};
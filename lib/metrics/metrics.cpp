@@ -0,0 +1,140 @@
+#include "metrics.h"
+#include "json_writer.h"
+
+uint8_t histogramBucket(uint32_t value) {
+    if (value == 0) return 0;
+    uint8_t bucket = 32 - __builtin_clz(value);
+    return bucket < METRIC_BUCKETS ? bucket : METRIC_BUCKETS - 1;
+}
+
+uint32_t histogramPercentile(const HistogramSnapshot& h, uint8_t percent) {
+    if (h.count == 0) return 0;
+    uint32_t rank = (uint32_t)(((uint64_t)h.count * percent + 99) / 100);
+    if (rank == 0) rank = 1;
+    uint32_t seen = 0;
+    for (uint8_t b = 0; b < METRIC_BUCKETS; b++) {
+        seen += h.buckets[b];
+        if (seen >= rank) {
+            uint32_t upper = b == 0 ? 0 : (b == METRIC_BUCKETS - 1 ? h.max : (1u << b) - 1);
+            return upper < h.max ? upper : h.max;
+        }
+    }
+    return h.max;
+}
+
+MetricsRegistry::MetricsRegistry() : count_(0), histCount_(0) {
+    for (size_t i = 0; i < METRICS_MAX; i++) {
+        metrics_[i].name = "";
+        metrics_[i].type = METRIC_COUNTER;
+        metrics_[i].value.store(0);
+        metrics_[i].hist = NULL;
+    }
+    for (size_t i = 0; i < METRICS_MAX_HISTOGRAMS; i++) {
+        histograms_[i].sum.store(0);
+        histograms_[i].max.store(0);
+        for (size_t b = 0; b < METRIC_BUCKETS; b++) histograms_[i].buckets[b].store(0);
+    }
+}
+
+int MetricsRegistry::define(const char* name, MetricType type) {
+    if (count_ >= METRICS_MAX) return -1;
+    if (type == METRIC_HISTOGRAM) {
+        if (histCount_ >= METRICS_MAX_HISTOGRAMS) return -1;
+        metrics_[count_].hist = &histograms_[histCount_++];
+    }
+    metrics_[count_].name = name;
+    metrics_[count_].type = type;
+    return (int)count_++;
+}
+
+int MetricsRegistry::counter(const char* name) {
+    return define(name, METRIC_COUNTER);
+}
+
+int MetricsRegistry::gauge(const char* name) {
+    return define(name, METRIC_GAUGE);
+}
+
+int MetricsRegistry::histogram(const char* name) {
+    return define(name, METRIC_HISTOGRAM);
+}
+
+void MetricsRegistry::add(int id, uint32_t n) {
+    if (!valid(id)) return;
+    metrics_[id].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+void MetricsRegistry::set(int id, int32_t value) {
+    if (!valid(id)) return;
+    metrics_[id].value.store((uint32_t)value, std::memory_order_relaxed);
+}
+
+void MetricsRegistry::record(int id, uint32_t value) {
+    if (!valid(id) || !metrics_[id].hist) return;
+    Histogram& h = *metrics_[id].hist;
+    metrics_[id].value.fetch_add(1, std::memory_order_relaxed);
+    h.sum.fetch_add(value, std::memory_order_relaxed);
+    h.buckets[histogramBucket(value)].fetch_add(1, std::memory_order_relaxed);
+    uint32_t max = h.max.load(std::memory_order_relaxed);
+    while (value > max && !h.max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+    }
+}
+
+uint32_t MetricsRegistry::count(int id) const {
+    return valid(id) ? metrics_[id].value.load(std::memory_order_relaxed) : 0;
+}
+
+int32_t MetricsRegistry::value(int id) const {
+    return (int32_t)count(id);
+}
+
+bool MetricsRegistry::snapshot(int id, HistogramSnapshot* out) const {
+    if (!valid(id) || !metrics_[id].hist) return false;
+    const Histogram& h = *metrics_[id].hist;
+    out->count = metrics_[id].value.load(std::memory_order_relaxed);
+    out->sum = h.sum.load(std::memory_order_relaxed);
+    out->max = h.max.load(std::memory_order_relaxed);
+    for (size_t b = 0; b < METRIC_BUCKETS; b++) out->buckets[b] = h.buckets[b].load(std::memory_order_relaxed);
+    return true;
+}
+
+void MetricsRegistry::resetHistograms() {
+    for (size_t i = 0; i < count_; i++) {
+        Histogram* h = metrics_[i].hist;
+        if (!h) continue;
+        metrics_[i].value.store(0, std::memory_order_relaxed);
+        h->sum.store(0, std::memory_order_relaxed);
+        h->max.store(0, std::memory_order_relaxed);
+        for (size_t b = 0; b < METRIC_BUCKETS; b++) h->buckets[b].store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t MetricsRegistry::encode(char* out, size_t cap) const {
+    static const char* const sections[] = {"c", "g", "h"};
+    JsonWriter json(out, cap);
+    json.beginObject();
+    for (int type = METRIC_COUNTER; type <= METRIC_HISTOGRAM; type++) {
+        json.key(sections[type]).beginObject();
+        for (size_t i = 0; i < count_; i++) {
+            if (metrics_[i].type != type) continue;
+            json.key(metrics_[i].name);
+            if (type == METRIC_COUNTER) {
+                json.value(count(i));
+            } else if (type == METRIC_GAUGE) {
+                json.value(value(i));
+            } else {
+                HistogramSnapshot h;
+                snapshot(i, &h);
+                json.beginArray()
+                    .value(h.count)
+                    .value(histogramPercentile(h, 50))
+                    .value(histogramPercentile(h, 99))
+                    .value(h.max)
+                    .endArray();
+            }
+        }
+        json.endObject();
+    }
+    json.endObject();
+    return json.ok() ? json.length() : 0;
+}
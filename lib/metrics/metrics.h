@@ -0,0 +1,82 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#define METRICS_MAX 40
+#define METRICS_MAX_HISTOGRAMS 10
+// Power-of-two buckets: 0, [1,2), [2,4), ... [8192,16384), >= 16384
+#define METRIC_BUCKETS 16
+
+enum MetricType {
+    METRIC_COUNTER = 0, // only goes up
+    METRIC_GAUGE,       // last value set
+    METRIC_HISTOGRAM    // distribution of recorded values, e.g. latency in ms
+};
+
+struct HistogramSnapshot {
+    uint32_t count;
+    uint32_t sum;
+    uint32_t max;
+    uint32_t buckets[METRIC_BUCKETS];
+};
+
+// Bucket a value falls in.
+uint8_t histogramBucket(uint32_t value);
+// Upper bound of the bucket holding the given percentile, capped at the
+// largest recorded value; 0 if the histogram is empty.
+uint32_t histogramPercentile(const HistogramSnapshot& h, uint8_t percent);
+
+// Fixed table of named counters, gauges and histograms. Metrics are
+// registered once in setup(); recording is lock free and allocation free
+// and may be done from any task. Names are not copied.
+class MetricsRegistry {
+public:
+    MetricsRegistry();
+
+    // Return the metric id, or -1 when the table is full. Recording to -1
+    // does nothing, so a full table only loses that metric.
+    int counter(const char* name);
+    int gauge(const char* name);
+    int histogram(const char* name);
+
+    void add(int id, uint32_t n = 1);
+    void set(int id, int32_t value);
+    void record(int id, uint32_t value);
+
+    // Counter value, or a histogram's sample count.
+    uint32_t count(int id) const;
+    int32_t value(int id) const;
+    bool snapshot(int id, HistogramSnapshot* out) const;
+    // Starts a new histogram interval; counters and gauges are kept.
+    void resetHistograms();
+
+    // Compact JSON, histograms as [count, p50, p99, max]:
+    //   {"c":{"http_retries":3},"g":{"heap_min":81234},"h":{"http_ms":[12,63,430,430]}}
+    // Returns the length, or 0 if it did not fit.
+    size_t encode(char* out, size_t cap) const;
+
+    size_t size() const { return count_; }
+    const char* name(int id) const { return valid(id) ? metrics_[id].name : ""; }
+
+private:
+    struct Histogram {
+        std::atomic<uint32_t> sum;
+        std::atomic<uint32_t> max;
+        std::atomic<uint32_t> buckets[METRIC_BUCKETS];
+    };
+    struct Metric {
+        const char* name;
+        MetricType type;
+        std::atomic<uint32_t> value; // counter, gauge bits or histogram count
+        Histogram* hist;
+    };
+
+    int define(const char* name, MetricType type);
+    bool valid(int id) const { return id >= 0 && (size_t)id < count_; }
+
+    Metric metrics_[METRICS_MAX];
+    Histogram histograms_[METRICS_MAX_HISTOGRAMS];
+    size_t count_;
+    size_t histCount_;
+};
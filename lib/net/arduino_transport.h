@@ -0,0 +1,36 @@
+#pragma once
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "transport.h"
+
+// Adapts an Arduino client (WiFiClient, WiFiClientSecure) to Transport.
+template <class ClientT>
+class ArduinoTransport : public Transport {
+public:
+    ClientT& client() { return client_; }
+
+    bool connect(const char* host, uint16_t port, uint32_t timeoutMs) {
+        return client_.connect(host, port, (int32_t)timeoutMs) == 1;
+    }
+    bool connected() { return client_.connected(); }
+    void stop() { client_.stop(); }
+    int write(const uint8_t* data, size_t len) {
+        size_t n = client_.write(data, len);
+        return n == 0 ? -1 : (int)n;
+    }
+    int available() { return client_.available(); }
+    int read(uint8_t* buf, size_t len, uint32_t timeoutMs) {
+        unsigned long start = millis();
+        while (client_.available() <= 0) {
+            if (!client_.connected()) return -1;
+            if (millis() - start >= timeoutMs) return 0;
+            delay(1);
+        }
+        int n = client_.read(buf, len);
+        return n < 0 ? -1 : n;
+    }
+
+private:
+    ClientT client_;
+};
+#endif
@@ -0,0 +1,75 @@
+#pragma once
+#ifdef ARDUINO
+#include <WiFi.h>
+#include <Preferences.h>
+#include <string.h>
+#include <time.h>
+#include "link_manager.h"
+
+#define LINK_CACHE_NAMESPACE "link"
+#define LINK_EPOCH_VALID 1700000000 // anything earlier means SNTP has not answered
+
+// Station mode on the Arduino WiFi library. The cache lives in NVS so it
+// survives power cycles; reconnects are left to LinkManager.
+class EspLinkBackend : public LinkBackend {
+public:
+    EspLinkBackend(const char* ssid, const char* pass) : ssid_(ssid), pass_(pass) {}
+
+    void connect(const LinkCache* hint) {
+        WiFi.persistent(false);
+        WiFi.setAutoReconnect(false);
+        WiFi.mode(WIFI_STA);
+        if (hint) {
+            // Reusing the last lease skips DHCP; a full connect goes back to it
+            WiFi.config(IPAddress(hint->ip), IPAddress(hint->gateway), IPAddress(hint->subnet),
+                        IPAddress(hint->dns));
+            WiFi.begin(ssid_, pass_, hint->channel, hint->bssid, true);
+        } else {
+            WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0));
+            WiFi.begin(ssid_, pass_);
+        }
+    }
+
+    void disconnect() { WiFi.disconnect(false, false); }
+
+    // Between uplink windows; connect() switches back to station mode
+    void powerDown() {
+        WiFi.disconnect(true, false);
+        WiFi.mode(WIFI_OFF);
+    }
+
+    bool current(LinkCache& out) {
+        const uint8_t* bssid = WiFi.BSSID();
+        if (!bssid) return false;
+        memcpy(out.bssid, bssid, sizeof(out.bssid));
+        out.channel = (uint8_t)WiFi.channel();
+        out.ip = WiFi.localIP();
+        out.gateway = WiFi.gatewayIP();
+        out.subnet = WiFi.subnetMask();
+        out.dns = WiFi.dnsIP(0);
+        return true;
+    }
+
+    bool loadCache(LinkCache& out) {
+        Preferences prefs;
+        if (!prefs.begin(LINK_CACHE_NAMESPACE, true)) return false;
+        size_t n = prefs.getBytes("cache", &out, sizeof(out));
+        prefs.end();
+        return n == sizeof(out);
+    }
+
+    void saveCache(const LinkCache& cache) {
+        Preferences prefs;
+        if (!prefs.begin(LINK_CACHE_NAMESPACE, false)) return;
+        prefs.putBytes("cache", &cache, sizeof(cache));
+        prefs.end();
+    }
+
+    void startTimeSync() { configTime(0, 0, "pool.ntp.org", "time.nist.gov"); }
+    bool timeSynced() { return time(nullptr) >= LINK_EPOCH_VALID; }
+
+private:
+    const char* ssid_;
+    const char* pass_;
+};
+#endif
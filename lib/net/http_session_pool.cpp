@@ -0,0 +1,486 @@
+#include "http_session_pool.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HTTP_POOL_TX_BUF 512
+#define HTTP_POOL_URL_LEN (HTTP_POOL_HOST_LEN + HTTP_POOL_PATH_LEN + 16)
+// Internal: a reused connection failed before any response byte arrived.
+#define HTTP_POOL_STALE_SEND -100
+#define HTTP_POOL_STALE_READ -101
+
+static bool startsWithNoCase(const char* s, const char* prefix) {
+    while (*prefix) {
+        if (tolower((unsigned char)*s) != tolower((unsigned char)*prefix)) return false;
+        s++;
+        prefix++;
+    }
+    return true;
+}
+
+// Returns the header value if line is "name: value", NULL otherwise.
+static const char* headerValue(const char* line, const char* name) {
+    size_t n = strlen(name);
+    if (!startsWithNoCase(line, name) || line[n] != ':') return NULL;
+    const char* v = line + n + 1;
+    while (*v == ' ' || *v == '\t') v++;
+    return v;
+}
+
+static bool containsNoCase(const char* s, const char* word) {
+    for (; *s; s++) {
+        if (startsWithNoCase(s, word)) return true;
+    }
+    return false;
+}
+
+bool parseUrl(const char* url, ParsedUrl& out) {
+    const char* p;
+    if (startsWithNoCase(url, "https://")) {
+        out.secure = true;
+        out.port = 443;
+        p = url + 8;
+    } else if (startsWithNoCase(url, "http://")) {
+        out.secure = false;
+        out.port = 80;
+        p = url + 7;
+    } else {
+        return false;
+    }
+    size_t hostLen = strcspn(p, ":/?");
+    if (hostLen == 0 || hostLen >= sizeof(out.host)) return false;
+    memcpy(out.host, p, hostLen);
+    out.host[hostLen] = '\0';
+    p += hostLen;
+    if (*p == ':') {
+        char* end;
+        long port = strtol(p + 1, &end, 10);
+        if (end == p + 1 || port <= 0 || port > 65535) return false;
+        out.port = (uint16_t)port;
+        p = end;
+    }
+    out.path = (*p == '/') ? p : "/";
+    return *p == '\0' || *p == '/' || *p == '?';
+}
+
+bool sameOrigin(const ParsedUrl& a, const ParsedUrl& b) {
+    if (a.secure != b.secure || a.port != b.port) return false;
+    size_t n = strlen(a.host);
+    return n == strlen(b.host) && startsWithNoCase(a.host, b.host);
+}
+
+// Copies headers without the lines that carry credentials. Returns false if
+// out is too small.
+static bool stripCredentials(const char* headers, char* out, size_t cap) {
+    size_t used = 0;
+    while (*headers) {
+        const char* end = strstr(headers, "\r\n");
+        size_t len = end ? (size_t)(end - headers) + 2 : strlen(headers);
+        bool secret = startsWithNoCase(headers, "Authorization:") || startsWithNoCase(headers, "Cookie:") ||
+                      startsWithNoCase(headers, "Proxy-Authorization:");
+        if (!secret) {
+            if (used + len >= cap) return false;
+            memcpy(out + used, headers, len);
+            used += len;
+        }
+        headers += len;
+    }
+    out[used] = '\0';
+    return true;
+}
+
+static bool idempotent(const char* method) {
+    return strcmp(method, "GET") == 0 || strcmp(method, "HEAD") == 0 || strcmp(method, "PUT") == 0 ||
+           strcmp(method, "DELETE") == 0 || strcmp(method, "OPTIONS") == 0;
+}
+
+HttpPoolConfig defaultHttpPoolConfig(uint32_t (*nowMs)()) {
+    HttpPoolConfig c;
+    c.idleTimeoutMs = 30000;
+    c.connectTimeoutMs = 10000;
+    c.ioTimeoutMs = 20000;
+    c.maxRequestsPerConn = 100;
+    c.maxRedirects = 3;
+    c.nowMs = nowMs;
+    return c;
+}
+
+HttpSessionPool::HttpSessionPool(TransportFactory& factory, const HttpPoolConfig& config)
+    : factory_(factory), config_(config) {
+    memset(sessions_, 0, sizeof(sessions_));
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+HttpSessionPool::~HttpSessionPool() {
+    closeAll();
+}
+
+size_t HttpSessionPool::openSessions() const {
+    size_t n = 0;
+    for (size_t i = 0; i < HTTP_POOL_MAX_SESSIONS; i++) {
+        if (sessions_[i].active) n++;
+    }
+    return n;
+}
+
+void HttpSessionPool::close(Session& s) {
+    if (!s.active) return;
+    s.transport->stop();
+    factory_.release(s.transport);
+    s.transport = NULL;
+    s.active = false;
+}
+
+void HttpSessionPool::closeAll() {
+    for (size_t i = 0; i < HTTP_POOL_MAX_SESSIONS; i++) close(sessions_[i]);
+}
+
+void HttpSessionPool::evictIdle() {
+    uint32_t now = config_.nowMs();
+    for (size_t i = 0; i < HTTP_POOL_MAX_SESSIONS; i++) {
+        Session& s = sessions_[i];
+        if (s.active && !healthy(s, now)) {
+            close(s);
+            stats_.evicted++;
+        }
+    }
+}
+
+bool HttpSessionPool::healthy(Session& s, uint32_t now) {
+    if (now - s.lastUsedMs >= s.keepAliveMs) return false;
+    if (s.requests >= config_.maxRequestsPerConn) return false;
+    // Unread bytes on an idle connection mean the peer closed it or broke framing.
+    if (s.rxPos < s.rxLen || s.transport->available() > 0) return false;
+    return s.transport->connected();
+}
+
+HttpSessionPool::Session* HttpSessionPool::sessionFor(const ParsedUrl& url, bool* reused) {
+    uint32_t now = config_.nowMs();
+    *reused = false;
+    Session* freeSlot = NULL;
+    Session* oldest = NULL;
+    for (size_t i = 0; i < HTTP_POOL_MAX_SESSIONS; i++) {
+        Session& s = sessions_[i];
+        if (!s.active) {
+            if (!freeSlot) freeSlot = &s;
+            continue;
+        }
+        if (s.secure == url.secure && s.port == url.port && strcmp(s.host, url.host) == 0) {
+            if (healthy(s, now)) {
+                *reused = true;
+                return &s;
+            }
+            close(s);
+            stats_.reconnects++;
+            if (!freeSlot) freeSlot = &s;
+            continue;
+        }
+        if (!oldest || (int32_t)(s.lastUsedMs - oldest->lastUsedMs) < 0) oldest = &s;
+    }
+    if (!freeSlot) {
+        if (!oldest) return NULL;
+        close(*oldest);
+        stats_.evicted++;
+        freeSlot = oldest;
+    }
+
+    Session& s = *freeSlot;
+    s.transport = factory_.acquire(url.secure);
+    if (!s.transport) return NULL;
+    if (!s.transport->connect(url.host, url.port, config_.connectTimeoutMs)) {
+        s.transport->stop();
+        factory_.release(s.transport);
+        s.transport = NULL;
+        stats_.connectsFailed++;
+        return NULL;
+    }
+    stats_.connectsOpened++;
+    s.active = true;
+    s.secure = url.secure;
+    strcpy(s.host, url.host);
+    s.port = url.port;
+    s.lastUsedMs = now;
+    s.keepAliveMs = config_.idleTimeoutMs;
+    s.requests = 0;
+    s.rxPos = s.rxLen = 0;
+    return &s;
+}
+
+int HttpSessionPool::request(const char* method, const char* url, const char* headers,
+                             const uint8_t* body, size_t bodyLen,
+                             HttpResponse* resp, HttpBodySink sink, void* sinkCtx) {
+    HttpResponse local;
+    if (!resp) resp = &local;
+    char target[HTTP_POOL_URL_LEN];
+    char location[HTTP_POOL_URL_LEN];
+    char redirectHeaders[HTTP_POOL_TX_BUF];
+    if (strlen(url) >= sizeof(target)) return HTTP_POOL_ERR_URL;
+    strcpy(target, url);
+
+    for (uint8_t redirects = 0;; redirects++) {
+        ParsedUrl parsed;
+        if (!parseUrl(target, parsed)) return HTTP_POOL_ERR_URL;
+
+        int rc = HTTP_POOL_ERR_CONNECT;
+        location[0] = '\0';
+        for (int attempt = 0; attempt < 2; attempt++) {
+            bool reused = false;
+            Session* s = sessionFor(parsed, &reused);
+            if (!s) {
+                rc = HTTP_POOL_ERR_CONNECT;
+                break;
+            }
+            stats_.requests++;
+            if (reused) stats_.reused++;
+            rc = exchange(*s, method, parsed, headers, body, bodyLen, *resp, sink, sinkCtx,
+                          location, sizeof(location));
+            // STALE_READ: the request went out and may have been processed, so
+            // only a method that is safe to repeat is sent again
+            bool stale = rc == HTTP_POOL_STALE_SEND || (rc == HTTP_POOL_STALE_READ && idempotent(method));
+            if (stale && reused) {
+                // The server dropped our idle connection; retry once on a fresh one.
+                stats_.reconnects++;
+                continue;
+            }
+            break;
+        }
+        if (rc == HTTP_POOL_STALE_SEND) rc = HTTP_POOL_ERR_SEND;
+        if (rc == HTTP_POOL_STALE_READ) rc = HTTP_POOL_ERR_READ;
+
+        bool redirect = rc == 301 || rc == 302 || rc == 303 || rc == 307 || rc == 308;
+        if (!redirect || location[0] == '\0') return rc;
+        if (redirects >= config_.maxRedirects) return HTTP_POOL_ERR_REDIRECTS;
+
+        if (location[0] == '/' && location[1] != '/') {
+            // Relative redirect: keep the current origin.
+            char origin[HTTP_POOL_URL_LEN];
+            snprintf(origin, sizeof(origin), "%s://%s:%u", parsed.secure ? "https" : "http",
+                     parsed.host, (unsigned)parsed.port);
+            if (strlen(origin) + strlen(location) >= sizeof(target)) return HTTP_POOL_ERR_URL;
+            strcpy(target, origin);
+            strcat(target, location);
+        } else {
+            if (location[0] == '/') {
+                // "//host/path" names another host under the current scheme
+                const char* scheme = parsed.secure ? "https:" : "http:";
+                if (strlen(scheme) + strlen(location) >= sizeof(target)) return HTTP_POOL_ERR_URL;
+                strcpy(target, scheme);
+                strcat(target, location);
+            } else {
+                strcpy(target, location);
+            }
+            ParsedUrl next;
+            if (headers && headers != redirectHeaders && parseUrl(target, next) && !sameOrigin(parsed, next)) {
+                if (!stripCredentials(headers, redirectHeaders, sizeof(redirectHeaders))) return HTTP_POOL_ERR_URL;
+                headers = redirectHeaders;
+            }
+        }
+        if (rc == 303) {
+            method = "GET";
+            body = NULL;
+            bodyLen = 0;
+        }
+    }
+}
+
+bool HttpSessionPool::writeAll(Session& s, const char* data, size_t len) {
+    while (len > 0) {
+        int n = s.transport->write((const uint8_t*)data, len);
+        if (n <= 0) return false;
+        data += n;
+        len -= (size_t)n;
+    }
+    return true;
+}
+
+int HttpSessionPool::exchange(Session& s, const char* method, const ParsedUrl& url, const char* headers,
+                              const uint8_t* body, size_t bodyLen, HttpResponse& resp,
+                              HttpBodySink sink, void* sinkCtx, char* location, size_t locationCap) {
+    char tx[HTTP_POOL_TX_BUF];
+    bool defaultPort = url.port == (url.secure ? 443 : 80);
+    char hostHeader[HTTP_POOL_HOST_LEN + 8];
+    if (defaultPort) {
+        snprintf(hostHeader, sizeof(hostHeader), "%s", url.host);
+    } else {
+        snprintf(hostHeader, sizeof(hostHeader), "%s:%u", url.host, (unsigned)url.port);
+    }
+    bool hasBody = body != NULL || strcmp(method, "POST") == 0 || strcmp(method, "PUT") == 0;
+    int n = snprintf(tx, sizeof(tx), "%s %s HTTP/1.1\r\nHost: %s\r\nConnection: keep-alive\r\n",
+                     method, url.path, hostHeader);
+    if (n < 0 || (size_t)n >= sizeof(tx)) return HTTP_POOL_ERR_URL;
+    size_t used = (size_t)n;
+    if (hasBody) {
+        n = snprintf(tx + used, sizeof(tx) - used, "Content-Length: %u\r\n", (unsigned)bodyLen);
+        if (n < 0 || (size_t)n >= sizeof(tx) - used) return HTTP_POOL_ERR_URL;
+        used += (size_t)n;
+    }
+
+    // Head and small bodies go out in a single write so they share one segment.
+    size_t headersLen = headers ? strlen(headers) : 0;
+    bool ok;
+    if (used + headersLen + 2 + bodyLen <= sizeof(tx)) {
+        if (headersLen) memcpy(tx + used, headers, headersLen);
+        used += headersLen;
+        memcpy(tx + used, "\r\n", 2);
+        used += 2;
+        if (bodyLen) memcpy(tx + used, body, bodyLen);
+        used += bodyLen;
+        ok = writeAll(s, tx, used);
+    } else {
+        ok = writeAll(s, tx, used) && (headersLen == 0 || writeAll(s, headers, headersLen)) &&
+             writeAll(s, "\r\n", 2) && (bodyLen == 0 || writeAll(s, (const char*)body, bodyLen));
+    }
+    if (!ok) {
+        close(s);
+        return HTTP_POOL_STALE_SEND;
+    }
+
+    memset(&resp, 0, sizeof(resp));
+    resp.contentLength = -1;
+    char line[HTTP_POOL_URL_LEN];
+    bool http10 = false;
+    do {
+        int len = readLine(s, line, sizeof(line));
+        if (len < 0) {
+            bool nothingReceived = len == -2;
+            close(s);
+            return nothingReceived ? HTTP_POOL_STALE_READ : HTTP_POOL_ERR_READ;
+        }
+        if (strncmp(line, "HTTP/1.", 7) != 0 || strlen(line) < 12) {
+            close(s);
+            return HTTP_POOL_ERR_PROTOCOL;
+        }
+        http10 = line[7] == '0';
+        resp.status = atoi(line + 9);
+        resp.keepAlive = !http10;
+        uint32_t keepAliveMs = config_.idleTimeoutMs;
+
+        for (;;) {
+            if (readLine(s, line, sizeof(line)) < 0) {
+                close(s);
+                return HTTP_POOL_ERR_READ;
+            }
+            if (line[0] == '\0') break;
+            const char* v;
+            if ((v = headerValue(line, "Content-Length"))) {
+                resp.contentLength = atol(v);
+            } else if ((v = headerValue(line, "Transfer-Encoding"))) {
+                resp.chunked = containsNoCase(v, "chunked");
+            } else if ((v = headerValue(line, "Connection"))) {
+                if (containsNoCase(v, "close")) resp.keepAlive = false;
+                if (containsNoCase(v, "keep-alive")) resp.keepAlive = true;
+            } else if ((v = headerValue(line, "Keep-Alive"))) {
+                const char* t = strstr(v, "timeout=");
+                if (t) {
+                    uint32_t ms = (uint32_t)atol(t + 8) * 1000;
+                    // Close a second early so we never race the server's own timer.
+                    if (ms > 1000) ms -= 1000;
+                    if (ms < keepAliveMs) keepAliveMs = ms;
+                }
+            } else if ((v = headerValue(line, "Retry-After"))) {
+                resp.retryAfterS = (uint32_t)atol(v);
+            } else if ((v = headerValue(line, "Content-Range"))) {
+                // bytes <start>-<end>/<total>
+                const char* start = strpbrk(v, "0123456789");
+                const char* slash = strchr(v, '/');
+                if (start) resp.rangeStart = (uint32_t)strtoul(start, NULL, 10);
+                if (slash && slash[1] != '*') resp.rangeTotal = (uint32_t)strtoul(slash + 1, NULL, 10);
+            } else if ((v = headerValue(line, "Location"))) {
+                snprintf(location, locationCap, "%s", v);
+            }
+        }
+        s.keepAliveMs = keepAliveMs;
+    } while (resp.status >= 100 && resp.status < 200);
+
+    bool redirect = resp.status >= 300 && resp.status < 400 && location[0] != '\0';
+    if (redirect) sink = NULL; // only the final response body reaches the caller
+
+    int rc = 0;
+    bool noBody = strcmp(method, "HEAD") == 0 || resp.status == 204 || resp.status == 304;
+    if (noBody) {
+        rc = 0;
+    } else if (resp.chunked) {
+        rc = readChunked(s, resp, sink, sinkCtx);
+    } else if (resp.contentLength >= 0) {
+        rc = readBody(s, (size_t)resp.contentLength, resp, sink, sinkCtx);
+    } else {
+        // No framing: the body runs until the server closes the connection.
+        resp.keepAlive = false;
+        rc = readBody(s, (size_t)-1, resp, sink, sinkCtx);
+    }
+    if (rc < 0) {
+        close(s);
+        return rc;
+    }
+
+    s.requests++;
+    s.lastUsedMs = config_.nowMs();
+    if (!resp.keepAlive || s.requests >= config_.maxRequestsPerConn) close(s);
+    return resp.status;
+}
+
+int HttpSessionPool::readByte(Session& s) {
+    if (s.rxPos >= s.rxLen) {
+        int n = s.transport->read(s.rx, sizeof(s.rx), config_.ioTimeoutMs);
+        if (n <= 0) return -1;
+        s.rxPos = 0;
+        s.rxLen = (size_t)n;
+    }
+    return s.rx[s.rxPos++];
+}
+
+// Reads one CRLF-terminated line, truncating it to cap - 1 characters.
+// Returns the stored length, -2 if the stream ended before any byte, -1 on a later error.
+int HttpSessionPool::readLine(Session& s, char* line, size_t cap) {
+    size_t len = 0;
+    bool any = false;
+    for (;;) {
+        int c = readByte(s);
+        if (c < 0) return any ? -1 : -2;
+        any = true;
+        if (c == '\n') break;
+        if (c != '\r' && len + 1 < cap) line[len++] = (char)c;
+    }
+    line[len] = '\0';
+    return (int)len;
+}
+
+int HttpSessionPool::readBody(Session& s, size_t len, HttpResponse& resp, HttpBodySink sink, void* sinkCtx) {
+    bool untilClose = len == (size_t)-1;
+    while (len > 0) {
+        if (s.rxPos >= s.rxLen) {
+            int n = s.transport->read(s.rx, sizeof(s.rx), config_.ioTimeoutMs);
+            if (n <= 0) return untilClose && n < 0 ? 0 : HTTP_POOL_ERR_READ;
+            s.rxPos = 0;
+            s.rxLen = (size_t)n;
+        }
+        size_t take = s.rxLen - s.rxPos;
+        if (take > len) take = len;
+        if (sink && !sink(s.rx + s.rxPos, take, sinkCtx)) return HTTP_POOL_ERR_ABORTED;
+        s.rxPos += take;
+        resp.bodyBytes += take;
+        if (!untilClose) len -= take;
+    }
+    return 0;
+}
+
+int HttpSessionPool::readChunked(Session& s, HttpResponse& resp, HttpBodySink sink, void* sinkCtx) {
+    char line[32];
+    for (;;) {
+        if (readLine(s, line, sizeof(line)) < 0) return HTTP_POOL_ERR_READ;
+        char* end;
+        unsigned long size = strtoul(line, &end, 16);
+        if (end == line) return HTTP_POOL_ERR_PROTOCOL;
+        if (size == 0) break;
+        int rc = readBody(s, size, resp, sink, sinkCtx);
+        if (rc < 0) return rc;
+        if (readLine(s, line, sizeof(line)) != 0) return HTTP_POOL_ERR_PROTOCOL;
+    }
+    // Trailers, terminated by an empty line.
+    for (;;) {
+        int len = readLine(s, line, sizeof(line));
+        if (len < 0) return HTTP_POOL_ERR_READ;
+        if (len == 0) return 0;
+    }
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "transport.h"
+
+#define HTTP_POOL_MAX_SESSIONS 4
+#define HTTP_POOL_HOST_LEN 64
+#define HTTP_POOL_PATH_LEN 192
+#ifndef HTTP_POOL_RX_BUF
+#define HTTP_POOL_RX_BUF 512
+#endif
+
+enum HttpPoolError {
+    HTTP_POOL_ERR_URL = -1,        // URL could not be parsed
+    HTTP_POOL_ERR_NO_SESSION = -2, // no free slot and nothing to evict
+    HTTP_POOL_ERR_CONNECT = -3,    // TCP/TLS connect failed
+    HTTP_POOL_ERR_SEND = -4,       // request could not be written
+    HTTP_POOL_ERR_READ = -5,       // timeout or peer closed while reading
+    HTTP_POOL_ERR_PROTOCOL = -6,   // malformed status line or headers
+    HTTP_POOL_ERR_ABORTED = -7,    // body sink asked to stop
+    HTTP_POOL_ERR_REDIRECTS = -8   // too many redirects
+};
+
+struct ParsedUrl {
+    bool secure;
+    char host[HTTP_POOL_HOST_LEN];
+    uint16_t port;
+    const char* path; // points into the original URL, "/" if empty
+};
+
+// Splits http(s)://host[:port]/path. Returns false for anything else.
+bool parseUrl(const char* url, ParsedUrl& out);
+// Same scheme, host (any case) and port.
+bool sameOrigin(const ParsedUrl& a, const ParsedUrl& b);
+
+struct HttpPoolConfig {
+    uint32_t idleTimeoutMs;     // close connections unused for this long
+    uint32_t connectTimeoutMs;
+    uint32_t ioTimeoutMs;       // per read/write wait
+    uint16_t maxRequestsPerConn;
+    uint8_t maxRedirects;
+    uint32_t (*nowMs)();        // clock used for idle bookkeeping
+};
+
+HttpPoolConfig defaultHttpPoolConfig(uint32_t (*nowMs)());
+
+struct HttpResponse {
+    int status;
+    int32_t contentLength; // -1 when unknown
+    bool chunked;
+    bool keepAlive;
+    uint32_t retryAfterS;  // 0 when the server did not send Retry-After
+    uint32_t rangeStart;   // from Content-Range on 206 responses
+    uint32_t rangeTotal;   // full resource size from Content-Range, 0 if unknown
+    size_t bodyBytes;
+};
+
+struct HttpPoolStats {
+    uint32_t connectsOpened;
+    uint32_t connectsFailed;
+    uint32_t requests;
+    uint32_t reused;        // requests served on an already open connection
+    uint32_t reconnects;    // stale keep-alive connections transparently replaced
+    uint32_t evicted;       // idle connections closed
+};
+
+// Receives the response body in pieces. Return false to abort the transfer.
+typedef bool (*HttpBodySink)(const uint8_t* data, size_t len, void* ctx);
+
+// One keep-alive HTTP/1.1 connection per origin (scheme, host, port).
+// Not thread safe: callers that share a pool between tasks must serialize access.
+class HttpSessionPool {
+public:
+    HttpSessionPool(TransportFactory& factory, const HttpPoolConfig& config);
+    ~HttpSessionPool();
+
+    // Sends a request and streams the body into sink (may be NULL to discard).
+    // headers is a pre-formatted block of "Name: value\r\n" lines, or NULL.
+    // A redirect to another origin gets them without Authorization and
+    // Cookie lines, so credentials stay with the origin they were meant for.
+    // A reused connection the server had closed is retried once on a fresh
+    // one, unless a POST already went out whole: the server may have acted on it.
+    // resp is filled in before the sink sees the first byte of the body.
+    // Returns the HTTP status code, or a negative HttpPoolError.
+    int request(const char* method, const char* url, const char* headers,
+                const uint8_t* body, size_t bodyLen,
+                HttpResponse* resp = NULL, HttpBodySink sink = NULL, void* sinkCtx = NULL);
+
+    // Closes connections that have been idle longer than idleTimeoutMs.
+    void evictIdle();
+    void closeAll();
+
+    size_t openSessions() const;
+    const HttpPoolStats& stats() const { return stats_; }
+
+private:
+    struct Session {
+        bool active;
+        bool secure;
+        char host[HTTP_POOL_HOST_LEN];
+        uint16_t port;
+        Transport* transport;
+        uint32_t lastUsedMs;
+        uint32_t keepAliveMs;
+        uint16_t requests;
+        uint8_t rx[HTTP_POOL_RX_BUF];
+        size_t rxPos;
+        size_t rxLen;
+    };
+
+    Session* sessionFor(const ParsedUrl& url, bool* reused);
+    bool healthy(Session& s, uint32_t now);
+    void close(Session& s);
+    int exchange(Session& s, const char* method, const ParsedUrl& url, const char* headers,
+                 const uint8_t* body, size_t bodyLen, HttpResponse& resp,
+                 HttpBodySink sink, void* sinkCtx, char* location, size_t locationCap);
+    int readByte(Session& s);
+    int readLine(Session& s, char* line, size_t cap);
+    int readBody(Session& s, size_t len, HttpResponse& resp, HttpBodySink sink, void* sinkCtx);
+    int readChunked(Session& s, HttpResponse& resp, HttpBodySink sink, void* sinkCtx);
+    bool writeAll(Session& s, const char* data, size_t len);
+
+    TransportFactory& factory_;
+    HttpPoolConfig config_;
+    Session sessions_[HTTP_POOL_MAX_SESSIONS];
+    HttpPoolStats stats_;
+};
@@ -0,0 +1,164 @@
+#include "link_manager.h"
+#include <string.h>
+
+bool sameLinkCache(const LinkCache& a, const LinkCache& b) {
+    return memcmp(a.bssid, b.bssid, sizeof(a.bssid)) == 0 && a.channel == b.channel && a.ip == b.ip &&
+           a.gateway == b.gateway && a.subnet == b.subnet && a.dns == b.dns;
+}
+
+LinkConfig defaultLinkConfig(uint32_t (*nowMs)()) {
+    LinkConfig c;
+    c.fastConnectTimeoutMs = 3000;
+    c.connectTimeoutMs = 15000;
+    c.retryBaseMs = 1000;
+    c.retryMaxMs = 60000;
+    c.timeSyncTimeoutMs = 15000;
+    c.nowMs = nowMs;
+    return c;
+}
+
+LinkManager::LinkManager(LinkBackend& backend, const LinkConfig& config)
+    : backend_(backend), config_(config), listener_(NULL), listenerCtx_(NULL), events_(0), online_(false),
+      timeSynced_(false), suspended_(false), firstPublishMs_(0), state_(LINK_IDLE), started_(false),
+      savedValid_(false), useCache_(false), timeStarted_(false), deadline_(0), timeDeadline_(0), attemptStart_(0),
+      failStreak_(0) {
+    memset(&saved_, 0, sizeof(saved_));
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void LinkManager::begin() {
+    savedValid_ = backend_.loadCache(saved_);
+    useCache_ = savedValid_;
+    started_ = true;
+    if (!suspended_.load()) startAttempt(config_.nowMs());
+}
+
+void LinkManager::enter(LinkState state) {
+    if (state == state_) return;
+    state_ = state;
+    online_.store(state == LINK_ONLINE);
+    if (listener_) listener_(state, listenerCtx_);
+}
+
+void LinkManager::startAttempt(uint32_t now) {
+    stats_.attempts++;
+    attemptStart_ = now;
+    if (useCache_) {
+        stats_.fastAttempts++;
+        deadline_ = now + config_.fastConnectTimeoutMs;
+        enter(LINK_FAST_CONNECT);
+        backend_.connect(&saved_);
+    } else {
+        deadline_ = now + config_.connectTimeoutMs;
+        enter(LINK_CONNECT);
+        backend_.connect(NULL);
+    }
+}
+
+void LinkManager::onGotIp(uint32_t now) {
+    if (state_ != LINK_FAST_CONNECT && state_ != LINK_CONNECT) return;
+    if (state_ == LINK_FAST_CONNECT) stats_.fastHits++;
+    stats_.lastConnectMs = now - attemptStart_;
+    if (stats_.bootToOnlineMs == 0) stats_.bootToOnlineMs = now ? now : 1;
+    failStreak_ = 0;
+    useCache_ = true;
+
+    // Only write when something changed: the cache lives in flash
+    LinkCache cur;
+    if (backend_.current(cur) && !(savedValid_ && sameLinkCache(cur, saved_))) {
+        saved_ = cur;
+        savedValid_ = true;
+        backend_.saveCache(saved_);
+        stats_.cacheWrites++;
+    }
+
+    if (!timeStarted_) {
+        timeStarted_ = true;
+        backend_.startTimeSync();
+        timeDeadline_ = now + config_.timeSyncTimeoutMs;
+    }
+    enter(LINK_ONLINE);
+}
+
+void LinkManager::onLost(uint32_t now) {
+    // Disconnects while associating are retries inside the attempt; only the
+    // timeout ends one
+    if (state_ != LINK_ONLINE) return;
+    stats_.drops++;
+    startAttempt(now);
+}
+
+void LinkManager::onTimeout(uint32_t now) {
+    if (state_ == LINK_BACKOFF) {
+        startAttempt(now);
+        return;
+    }
+    stats_.timeouts++;
+    backend_.disconnect();
+    if (state_ == LINK_FAST_CONNECT) {
+        // The AP moved or the lease is gone; scan right away
+        useCache_ = false;
+        startAttempt(now);
+        return;
+    }
+    uint32_t delay = config_.retryBaseMs;
+    for (uint8_t i = 0; i < failStreak_ && delay < config_.retryMaxMs; i++) delay *= 2;
+    if (delay > config_.retryMaxMs) delay = config_.retryMaxMs;
+    if (failStreak_ < 255) failStreak_++;
+    deadline_ = now + delay;
+    enter(LINK_BACKOFF);
+}
+
+uint32_t LinkManager::poll() {
+    if (!started_) return LINK_IDLE_MS;
+    uint32_t now = config_.nowMs();
+    if (suspended_.load()) {
+        if (state_ != LINK_IDLE) {
+            stats_.suspends++;
+            backend_.powerDown();
+            enter(LINK_IDLE);
+        }
+        events_.store(0); // the disconnect's own events
+        return LINK_IDLE_MS;
+    }
+    // Resumed: the cache is tried first, as after a drop
+    if (state_ == LINK_IDLE) startAttempt(now);
+    uint32_t events = events_.exchange(0);
+
+    if (events & LINK_EVT_GOT_IP) {
+        // Dropped and already back between two polls: the address is current
+        if ((events & LINK_EVT_LOST) && state_ == LINK_ONLINE) stats_.drops++;
+        onGotIp(now);
+    } else if (events & LINK_EVT_LOST) {
+        onLost(now);
+    }
+
+    if (state_ != LINK_ONLINE && (int32_t)(now - deadline_) >= 0) onTimeout(now);
+
+    if (timeStarted_ && !timeSynced()) {
+        if ((events & LINK_EVT_TIME_SYNCED) || backend_.timeSynced()) {
+            timeSynced_.store(true);
+            stats_.bootToTimeMs = now ? now : 1;
+        } else if (state_ == LINK_ONLINE && (int32_t)(now - timeDeadline_) >= 0) {
+            stats_.timeSyncRestarts++;
+            backend_.startTimeSync();
+            timeDeadline_ = now + config_.timeSyncTimeoutMs;
+        }
+    }
+
+    uint32_t wait = LINK_IDLE_MS;
+    if (state_ != LINK_ONLINE) {
+        int32_t left = (int32_t)(deadline_ - now);
+        wait = left > 0 ? (uint32_t)left : 0;
+    } else if (!timeSynced()) {
+        int32_t left = (int32_t)(timeDeadline_ - now);
+        wait = left > 0 ? (uint32_t)left : 0;
+    }
+    return wait < LINK_IDLE_MS ? wait : LINK_IDLE_MS;
+}
+
+void LinkManager::markFirstPublish() {
+    uint32_t now = config_.nowMs();
+    uint32_t expected = 0;
+    firstPublishMs_.compare_exchange_strong(expected, now ? now : 1);
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#define LINK_IDLE_MS 60000 // longest poll interval when nothing is pending
+
+// What the last good association used, so the next one can skip the scan
+// and DHCP. Addresses are IPv4 in the platform's byte order.
+struct LinkCache {
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+};
+
+bool sameLinkCache(const LinkCache& a, const LinkCache& b);
+
+// Radio, persistence and SNTP operations. Every call must return at once;
+// progress is reported back through LinkManager::post().
+class LinkBackend {
+public:
+    virtual ~LinkBackend() {}
+    // Starts associating. With a hint, joins that BSSID/channel and uses the
+    // cached addresses instead of DHCP; without one, scans and uses DHCP.
+    virtual void connect(const LinkCache* hint) = 0;
+    virtual void disconnect() = 0;
+    // Disconnects and turns the radio off; the next connect() turns it on.
+    virtual void powerDown() { disconnect(); }
+    // BSSID, channel and addresses of the current association.
+    virtual bool current(LinkCache& out) = 0;
+    virtual bool loadCache(LinkCache& out) = 0;
+    virtual void saveCache(const LinkCache& cache) = 0;
+    // Starts or restarts SNTP in the background.
+    virtual void startTimeSync() = 0;
+    virtual bool timeSynced() = 0;
+};
+
+enum LinkEvent {
+    LINK_EVT_GOT_IP = 1 << 0,
+    LINK_EVT_LOST = 1 << 1,       // disconnected or lost the address
+    LINK_EVT_TIME_SYNCED = 1 << 2
+};
+
+enum LinkState {
+    LINK_IDLE = 0,      // not started, or suspended
+    LINK_FAST_CONNECT,  // joining the cached BSSID/channel with the cached IP
+    LINK_CONNECT,       // full scan and DHCP
+    LINK_BACKOFF,       // waiting before the next attempt
+    LINK_ONLINE
+};
+
+struct LinkConfig {
+    uint32_t fastConnectTimeoutMs; // give up on the cache after this long
+    uint32_t connectTimeoutMs;     // one full scan + DHCP attempt
+    uint32_t retryBaseMs;          // first backoff, doubled per failed attempt
+    uint32_t retryMaxMs;
+    uint32_t timeSyncTimeoutMs;    // restart SNTP if it has not answered by then
+    uint32_t (*nowMs)();           // milliseconds since boot
+};
+
+LinkConfig defaultLinkConfig(uint32_t (*nowMs)());
+
+struct LinkStats {
+    uint32_t attempts;
+    uint32_t fastAttempts;
+    uint32_t fastHits;          // fast attempts that got an address
+    uint32_t timeouts;
+    uint32_t drops;             // link lost while online
+    uint32_t cacheWrites;
+    uint32_t timeSyncRestarts;
+    uint32_t suspends;          // radio turned off between uplink windows
+    uint32_t lastConnectMs;     // duration of the last successful attempt
+    uint32_t bootToOnlineMs;    // 0 until the first time online
+    uint32_t bootToTimeMs;      // 0 until SNTP first answered
+};
+
+typedef void (*LinkListener)(LinkState state, void* ctx);
+
+// WiFi/SNTP bring-up as a state machine that never blocks. A cached
+// BSSID/channel/IP is tried first for a short time, then a full connect,
+// then exponential backoff. SNTP runs in the background once online and
+// does not hold anything back.
+// post() may be called from any task or the WiFi event handler; everything
+// else belongs to the task that calls poll().
+class LinkManager {
+public:
+    LinkManager(LinkBackend& backend, const LinkConfig& config);
+
+    void setListener(LinkListener fn, void* ctx) { listener_ = fn; listenerCtx_ = ctx; }
+
+    // Loads the cache and starts the first attempt.
+    void begin();
+    void post(LinkEvent event) { events_.fetch_or(event); }
+    // Radio off until resume(), e.g. between uplink windows. Both may be
+    // called from any task and take effect at the next poll().
+    void suspend() { suspended_.store(true); }
+    void resume() { suspended_.store(false); }
+
+    // Handles posted events and timeouts. Returns how long the caller may
+    // wait for the next event before calling again.
+    uint32_t poll();
+
+    LinkState state() const { return state_; }
+    bool online() const { return online_.load(); }
+    bool timeSynced() const { return timeSynced_.load(); }
+
+    // Records the first delivered sensor reading; later calls are ignored.
+    void markFirstPublish();
+    uint32_t bootToFirstPublishMs() const { return firstPublishMs_.load(); }
+
+    const LinkStats& stats() const { return stats_; }
+
+private:
+    void startAttempt(uint32_t now);
+    void enter(LinkState state);
+    void onGotIp(uint32_t now);
+    void onLost(uint32_t now);
+    void onTimeout(uint32_t now);
+
+    LinkBackend& backend_;
+    LinkConfig config_;
+    LinkListener listener_;
+    void* listenerCtx_;
+    std::atomic<uint32_t> events_;
+    std::atomic<bool> online_;
+    std::atomic<bool> timeSynced_;
+    std::atomic<bool> suspended_;
+    std::atomic<uint32_t> firstPublishMs_;
+    LinkState state_;
+    LinkCache saved_;
+    bool started_;
+    bool savedValid_;   // saved_ matches what the backend persisted
+    bool useCache_;     // cleared when the cache failed to connect
+    bool timeStarted_;
+    uint32_t deadline_; // attempt timeout or end of backoff
+    uint32_t timeDeadline_;
+    uint32_t attemptStart_;
+    uint8_t failStreak_;
+    LinkStats stats_;
+};
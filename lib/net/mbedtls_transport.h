@@ -0,0 +1,249 @@
+#pragma once
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <string.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/x509_crt.h>
+#include "arduino_transport.h"
+#include "tls_context.h"
+
+// TLS on the ESP32 with mbedtls directly instead of WiFiClientSecure, which
+// neither exposes the session for resumption nor reports handshake costs.
+// Mirrors OpenSslTransport on the host: the pinned CA bundle is the only
+// trust store and sessions are cached in the shared TlsContext.
+
+// The parts shared by all connections: pinned roots, RNG and ssl config.
+class MbedTlsConfig {
+public:
+    MbedTlsConfig() : ready_(false) {
+        mbedtls_x509_crt_init(&ca_);
+        mbedtls_entropy_init(&entropy_);
+        mbedtls_ctr_drbg_init(&drbg_);
+        mbedtls_ssl_config_init(&conf_);
+    }
+
+    // Parses the CA bundle; NULL skips verification. False if no
+    // certificate could be loaded or the RNG failed.
+    bool begin(const char* caPem) {
+        if (mbedtls_ctr_drbg_seed(&drbg_, mbedtls_entropy_func, &entropy_, NULL, 0) != 0) return false;
+        if (mbedtls_ssl_config_defaults(&conf_, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                        MBEDTLS_SSL_PRESET_DEFAULT) != 0) {
+            return false;
+        }
+        mbedtls_ssl_conf_rng(&conf_, mbedtls_ctr_drbg_random, &drbg_);
+        mbedtls_ssl_conf_min_version(&conf_, MBEDTLS_SSL_MAJOR_VERSION_3, MBEDTLS_SSL_MINOR_VERSION_3);
+        mbedtls_ssl_conf_session_tickets(&conf_, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+        if (!caPem) {
+            mbedtls_ssl_conf_authmode(&conf_, MBEDTLS_SSL_VERIFY_NONE);
+        } else {
+            // A positive return is the number of certificates that failed to parse
+            int rc = mbedtls_x509_crt_parse(&ca_, (const unsigned char*)caPem, strlen(caPem) + 1);
+            if (rc < 0 || ca_.version == 0) return false;
+            mbedtls_ssl_conf_ca_chain(&conf_, &ca_, NULL);
+            mbedtls_ssl_conf_authmode(&conf_, MBEDTLS_SSL_VERIFY_REQUIRED);
+        }
+        ready_ = true;
+        return true;
+    }
+
+    bool ok() const { return ready_; }
+    const mbedtls_ssl_config* conf() const { return &conf_; }
+
+private:
+    mbedtls_x509_crt ca_;
+    mbedtls_entropy_context entropy_;
+    mbedtls_ctr_drbg_context drbg_;
+    mbedtls_ssl_config conf_;
+    bool ready_;
+};
+
+class MbedTlsTransport : public Transport {
+public:
+    MbedTlsTransport()
+        : tls_(NULL),
+          config_(NULL),
+          active_(false),
+          setUp_(false),
+          keepBuffers_(false),
+          port_(0),
+          ioTimeoutMs_(0),
+          error_(TLS_OK),
+          resumed_(false) {
+        host_[0] = '\0';
+    }
+    ~MbedTlsTransport() {
+        stop();
+        if (setUp_) mbedtls_ssl_free(&ssl_);
+    }
+
+    // keepBuffers: allocate the record buffers with the first connection and
+    // reuse them for every later one instead of freeing them in stop(). The
+    // heap then sees one allocation per transport for the device's lifetime.
+    void begin(TlsContext& tls, const MbedTlsConfig& config, bool keepBuffers = false) {
+        tls_ = &tls;
+        config_ = &config;
+        keepBuffers_ = keepBuffers;
+    }
+
+    bool connect(const char* host, uint16_t port, uint32_t timeoutMs) {
+        stop();
+        resumed_ = false;
+        if (!tls_ || !config_->ok() || strlen(host) >= sizeof(host_)) {
+            error_ = TLS_ERR_CONNECT;
+            return false;
+        }
+        strcpy(host_, host);
+        port_ = port;
+        uint32_t t0 = tls_->nowMs();
+        if (!tcp_.connect(host, port, timeoutMs)) {
+            error_ = TLS_ERR_CONNECT;
+            return false;
+        }
+        uint32_t budget = tls_->config().handshakeTimeoutMs ? tls_->config().handshakeTimeoutMs : timeoutMs;
+        error_ = handshake(host, budget);
+        tls_->handshakeDone(host_, port_, resumed_, tls_->nowMs() - t0, error_);
+        if (error_ != TLS_OK) {
+            stop();
+            return false;
+        }
+        if (tls_->config().resume) saveSession();
+        return true;
+    }
+
+    bool connected() { return active_ && tcp_.connected(); }
+
+    void stop() {
+        if (active_) {
+            ioTimeoutMs_ = 0;
+            mbedtls_ssl_close_notify(&ssl_);
+            active_ = false;
+            // Frees the ~32 KB of record buffers between connections
+            if (!keepBuffers_ || !setUp_) {
+                mbedtls_ssl_free(&ssl_);
+                setUp_ = false;
+            }
+        }
+        tcp_.stop();
+    }
+
+    int write(const uint8_t* data, size_t len) {
+        if (!active_) return -1;
+        int n;
+        while ((n = mbedtls_ssl_write(&ssl_, data, len)) == MBEDTLS_ERR_SSL_WANT_WRITE) {
+        }
+        return n <= 0 ? -1 : n;
+    }
+
+    int available() {
+        if (!active_) return 0;
+        size_t pending = mbedtls_ssl_get_bytes_avail(&ssl_);
+        return pending > 0 ? (int)pending : tcp_.available();
+    }
+
+    int read(uint8_t* buf, size_t len, uint32_t timeoutMs) {
+        if (!active_) return -1;
+        uint32_t start = millis();
+        for (;;) {
+            uint32_t elapsed = millis() - start;
+            ioTimeoutMs_ = elapsed >= timeoutMs ? 0 : timeoutMs - elapsed;
+            int n = mbedtls_ssl_read(&ssl_, buf, len);
+            if (n > 0) return n;
+            if (n == MBEDTLS_ERR_SSL_WANT_READ || n == MBEDTLS_ERR_SSL_WANT_WRITE) {
+                if (ioTimeoutMs_ == 0) return 0;
+                continue;
+            }
+            return -1; // close_notify (0) or a fatal error
+        }
+    }
+
+    // TlsError of the last connect().
+    int lastError() const { return error_; }
+    bool resumed() const { return resumed_; }
+
+private:
+    static int bioSend(void* ctx, const unsigned char* buf, size_t len) {
+        MbedTlsTransport* self = static_cast<MbedTlsTransport*>(ctx);
+        int n = self->tcp_.write(buf, len);
+        return n < 0 ? MBEDTLS_ERR_SSL_INTERNAL_ERROR : n;
+    }
+
+    // Waits at most ioTimeoutMs_ like every other Transport
+    static int bioRecv(void* ctx, unsigned char* buf, size_t len) {
+        MbedTlsTransport* self = static_cast<MbedTlsTransport*>(ctx);
+        int n = self->tcp_.read(buf, len, self->ioTimeoutMs_);
+        if (n == 0) return MBEDTLS_ERR_SSL_WANT_READ; // timeout, not end of stream
+        return n < 0 ? 0 : n;
+    }
+
+    int handshake(const char* host, uint32_t timeoutMs) {
+        active_ = true;
+        if (setUp_) {
+            if (mbedtls_ssl_session_reset(&ssl_) != 0) return TLS_ERR_HANDSHAKE;
+        } else {
+            mbedtls_ssl_init(&ssl_);
+            if (mbedtls_ssl_setup(&ssl_, config_->conf()) != 0) return TLS_ERR_HANDSHAKE;
+            setUp_ = true;
+        }
+        // SNI and the name the certificate must carry
+        if (mbedtls_ssl_set_hostname(&ssl_, host) != 0) return TLS_ERR_HANDSHAKE;
+        mbedtls_ssl_set_bio(&ssl_, this, bioSend, bioRecv, NULL);
+
+        const uint8_t* blob = NULL;
+        size_t len = tls_->config().resume ? tls_->findSession(host_, port_, &blob) : 0;
+        if (len) {
+            mbedtls_ssl_session session;
+            mbedtls_ssl_session_init(&session);
+            if (mbedtls_ssl_session_load(&session, blob, len) == 0) mbedtls_ssl_set_session(&ssl_, &session);
+            mbedtls_ssl_session_free(&session);
+        }
+
+        // mbedtls has no "session reused" query; an abbreviated handshake
+        // is one where the server never sent its certificate
+        bool sawCertificate = false;
+        uint32_t start = tls_->nowMs();
+        while (ssl_.state != MBEDTLS_SSL_HANDSHAKE_OVER) {
+            uint32_t elapsed = tls_->nowMs() - start;
+            if (elapsed >= timeoutMs) return TLS_ERR_TIMEOUT;
+            ioTimeoutMs_ = timeoutMs - elapsed;
+            if (ssl_.state == MBEDTLS_SSL_SERVER_CERTIFICATE) sawCertificate = true;
+            int rc = mbedtls_ssl_handshake_step(&ssl_);
+            if (rc == 0 || rc == MBEDTLS_ERR_SSL_WANT_READ || rc == MBEDTLS_ERR_SSL_WANT_WRITE) continue;
+            if (rc == MBEDTLS_ERR_X509_CERT_VERIFY_FAILED || mbedtls_ssl_get_verify_result(&ssl_) != 0) {
+                return TLS_ERR_VERIFY;
+            }
+            return TLS_ERR_HANDSHAKE;
+        }
+        resumed_ = len > 0 && !sawCertificate;
+        return TLS_OK;
+    }
+
+    void saveSession() {
+        mbedtls_ssl_session session;
+        mbedtls_ssl_session_init(&session);
+        if (mbedtls_ssl_get_session(&ssl_, &session) == 0) {
+            static uint8_t buf[TLS_SESSION_MAX]; // only the network task connects
+            size_t len = 0;
+            if (mbedtls_ssl_session_save(&session, buf, sizeof(buf), &len) == 0) {
+                tls_->saveSession(host_, port_, buf, len);
+            }
+        }
+        mbedtls_ssl_session_free(&session);
+    }
+
+    TlsContext* tls_;
+    const MbedTlsConfig* config_;
+    ArduinoTransport<WiFiClient> tcp_;
+    mbedtls_ssl_context ssl_;
+    bool active_;
+    bool setUp_;       // ssl_ holds its buffers
+    bool keepBuffers_;
+    char host_[TLS_HOST_LEN];
+    uint16_t port_;
+    uint32_t ioTimeoutMs_;
+    int error_;
+    bool resumed_;
+};
+#endif
@@ -0,0 +1,24 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Delivers an incoming message; runs inside loop().
+typedef void (*MqttMessageFn)(const char* topic, const uint8_t* payload, size_t len, void* ctx);
+
+// The MQTT operations the firmware uses, so publishing code does not depend
+// on PubSubClient and can run against a fake on the host.
+class MqttClient {
+public:
+    virtual ~MqttClient() {}
+    virtual bool connected() = 0;
+    virtual bool connect(const char* clientId) = 0;
+    // qos is a request; a client that only speaks QoS 0 sends it at QoS 0.
+    virtual bool publish(const char* topic, const uint8_t* payload, size_t len, uint8_t qos, bool retain) = 0;
+    // Subscriptions do not survive a reconnect; subscribe again after connect().
+    virtual bool subscribe(const char* topic, uint8_t qos) = 0;
+    virtual void onMessage(MqttMessageFn fn, void* ctx) = 0;
+    // Services the connection; returns false once it is lost.
+    virtual bool loop() = 0;
+    // Client-specific status code for logs.
+    virtual int state() = 0;
+};
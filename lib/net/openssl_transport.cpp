@@ -0,0 +1,221 @@
+#ifndef ARDUINO
+#include "openssl_transport.h"
+#include <arpa/inet.h>
+#include <string.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+// The BIO reads and writes through the TCP transport, so a read waits at
+// most ioTimeoutMs_ like every other Transport.
+static BIO_METHOD* transportBioMethod(int (*rd)(BIO*, char*, int), int (*wr)(BIO*, const char*, int),
+                                      long (*ctrl)(BIO*, int, long, void*)) {
+    static BIO_METHOD* method = NULL;
+    if (!method) {
+        method = BIO_meth_new(BIO_get_new_index() | BIO_TYPE_SOURCE_SINK, "transport");
+        BIO_meth_set_read(method, rd);
+        BIO_meth_set_write(method, wr);
+        BIO_meth_set_ctrl(method, ctrl);
+    }
+    return method;
+}
+
+OpenSslTransport::OpenSslTransport(TlsContext& tls, SSL_CTX* ctx)
+    : tls_(tls), ctx_(ctx), ssl_(NULL), port_(0), ioTimeoutMs_(0), error_(TLS_OK), resumed_(false) {
+    host_[0] = '\0';
+}
+
+int OpenSslTransport::bioRead(BIO* bio, char* buf, int len) {
+    OpenSslTransport* self = static_cast<OpenSslTransport*>(BIO_get_data(bio));
+    BIO_clear_retry_flags(bio);
+    int n = self->tcp_.read((uint8_t*)buf, len, self->ioTimeoutMs_);
+    if (n == 0) {
+        BIO_set_retry_read(bio); // timeout, not end of stream
+        return -1;
+    }
+    return n < 0 ? 0 : n;
+}
+
+int OpenSslTransport::bioWrite(BIO* bio, const char* buf, int len) {
+    OpenSslTransport* self = static_cast<OpenSslTransport*>(BIO_get_data(bio));
+    BIO_clear_retry_flags(bio);
+    return self->tcp_.write((const uint8_t*)buf, len);
+}
+
+long OpenSslTransport::bioCtrl(BIO*, int cmd, long, void*) {
+    return cmd == BIO_CTRL_FLUSH ? 1 : 0;
+}
+
+bool OpenSslTransport::connect(const char* host, uint16_t port, uint32_t timeoutMs) {
+    stop();
+    resumed_ = false;
+    if (strlen(host) >= sizeof(host_)) {
+        error_ = TLS_ERR_CONNECT;
+        return false;
+    }
+    strcpy(host_, host);
+    port_ = port;
+    uint32_t t0 = tls_.nowMs();
+    if (!tcp_.connect(host, port, timeoutMs)) {
+        error_ = TLS_ERR_CONNECT;
+        return false;
+    }
+    uint32_t budget = tls_.config().handshakeTimeoutMs ? tls_.config().handshakeTimeoutMs : timeoutMs;
+    error_ = handshake(host, budget);
+    tls_.handshakeDone(host_, port_, resumed_, tls_.nowMs() - t0, error_);
+    if (error_ != TLS_OK) {
+        stop();
+        return false;
+    }
+    saveSession(); // TLS 1.2; a TLS 1.3 ticket arrives later and is saved in stop()
+    return true;
+}
+
+int OpenSslTransport::handshake(const char* host, uint32_t timeoutMs) {
+    ssl_ = SSL_new(ctx_);
+    if (!ssl_) return TLS_ERR_HANDSHAKE;
+    BIO* bio = BIO_new(transportBioMethod(bioRead, bioWrite, bioCtrl));
+    BIO_set_data(bio, this);
+    BIO_set_init(bio, 1);
+    SSL_set_bio(ssl_, bio, bio);
+
+    // The certificate must name the host we dialed: DNS name or IP address
+    struct in_addr addr;
+    if (inet_pton(AF_INET, host, &addr) == 1) {
+        X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(ssl_), host);
+    } else {
+        SSL_set_tlsext_host_name(ssl_, host);
+        SSL_set1_host(ssl_, host);
+    }
+
+    const uint8_t* blob = NULL;
+    size_t len = tls_.config().resume ? tls_.findSession(host_, port_, &blob) : 0;
+    if (len) {
+        SSL_SESSION* session = d2i_SSL_SESSION(NULL, &blob, (long)len);
+        if (session) {
+            SSL_set_session(ssl_, session);
+            SSL_SESSION_free(session);
+        }
+    }
+
+    uint32_t start = tls_.nowMs();
+    for (;;) {
+        uint32_t elapsed = tls_.nowMs() - start;
+        if (elapsed >= timeoutMs) return TLS_ERR_TIMEOUT;
+        ioTimeoutMs_ = timeoutMs - elapsed;
+        int rc = SSL_connect(ssl_);
+        if (rc == 1) break;
+        int err = SSL_get_error(ssl_, rc);
+        if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) continue;
+        ERR_clear_error();
+        if (SSL_get_verify_result(ssl_) != X509_V_OK) return TLS_ERR_VERIFY;
+        return TLS_ERR_HANDSHAKE;
+    }
+    resumed_ = SSL_session_reused(ssl_) == 1;
+    return TLS_OK;
+}
+
+void OpenSslTransport::saveSession() {
+    SSL_SESSION* session = ssl_ ? SSL_get_session(ssl_) : NULL;
+    if (!session || !SSL_SESSION_is_resumable(session)) return;
+    uint8_t buf[TLS_SESSION_MAX];
+    int len = i2d_SSL_SESSION(session, NULL);
+    if (len <= 0 || len > (int)sizeof(buf)) return;
+    uint8_t* p = buf;
+    i2d_SSL_SESSION(session, &p);
+    tls_.saveSession(host_, port_, buf, (size_t)len);
+}
+
+bool OpenSslTransport::connected() {
+    return ssl_ && tcp_.connected();
+}
+
+void OpenSslTransport::stop() {
+    if (ssl_) {
+        if (error_ == TLS_OK && tls_.config().resume) saveSession();
+        ioTimeoutMs_ = 0;
+        SSL_shutdown(ssl_); // sends close_notify, does not wait for the peer's
+        SSL_free(ssl_);
+        ssl_ = NULL;
+        ERR_clear_error();
+    }
+    tcp_.stop();
+}
+
+int OpenSslTransport::write(const uint8_t* data, size_t len) {
+    if (!ssl_) return -1;
+    int n = SSL_write(ssl_, data, (int)len);
+    if (n <= 0) {
+        ERR_clear_error();
+        return -1;
+    }
+    return n;
+}
+
+int OpenSslTransport::available() {
+    if (!ssl_) return 0;
+    int pending = SSL_pending(ssl_);
+    // Raw bytes on an idle connection are an alert or stray data either way
+    return pending > 0 ? pending : tcp_.available();
+}
+
+int OpenSslTransport::read(uint8_t* buf, size_t len, uint32_t timeoutMs) {
+    if (!ssl_) return -1;
+    uint32_t start = tls_.nowMs();
+    for (;;) {
+        uint32_t elapsed = tls_.nowMs() - start;
+        ioTimeoutMs_ = elapsed >= timeoutMs ? 0 : timeoutMs - elapsed;
+        int n = SSL_read(ssl_, buf, (int)len);
+        if (n > 0) return n;
+        int err = SSL_get_error(ssl_, n);
+        // A TLS 1.3 session ticket is a record without application data
+        if (err == SSL_ERROR_WANT_READ) {
+            if (ioTimeoutMs_ == 0) return 0;
+            continue;
+        }
+        ERR_clear_error();
+        return -1;
+    }
+}
+
+static SSL_CTX* newClientContext(const char* caPem) {
+    SSL_CTX* ctx = SSL_CTX_new(TLS_client_method());
+    if (!ctx) return NULL;
+    SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF); // TlsContext keeps the sessions
+    if (!caPem) {
+        SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, NULL);
+        return ctx;
+    }
+    // Only the pinned roots: the system store is never loaded
+    X509_STORE* store = SSL_CTX_get_cert_store(ctx);
+    BIO* bio = BIO_new_mem_buf(caPem, -1);
+    int loaded = 0;
+    X509* cert;
+    while ((cert = PEM_read_bio_X509(bio, NULL, NULL, NULL)) != NULL) {
+        if (X509_STORE_add_cert(store, cert) == 1) loaded++;
+        X509_free(cert);
+    }
+    BIO_free(bio);
+    ERR_clear_error();
+    if (loaded == 0) {
+        SSL_CTX_free(ctx);
+        return NULL;
+    }
+    SSL_CTX_set_verify(ctx, SSL_VERIFY_PEER, NULL);
+    return ctx;
+}
+
+OpenSslTransportFactory::OpenSslTransportFactory(TlsContext& tls)
+    : tls_(tls), ctx_(newClientContext(tls.config().caPem)) {}
+
+OpenSslTransportFactory::~OpenSslTransportFactory() {
+    if (ctx_) SSL_CTX_free(ctx_);
+}
+
+Transport* OpenSslTransportFactory::acquire(bool secure) {
+    if (!secure) return new PosixTransport();
+    return ctx_ ? new OpenSslTransport(tls_, ctx_) : NULL;
+}
+#endif
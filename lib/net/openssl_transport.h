@@ -0,0 +1,61 @@
+#pragma once
+#ifndef ARDUINO
+#include "posix_transport.h"
+#include "tls_context.h"
+
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_st SSL;
+
+// TLS over a PosixTransport with OpenSSL, for the native build and tests.
+// Mirrors the mbedtls transport on the ESP32: the pinned CA bundle is the
+// only trust store and sessions are cached in the shared TlsContext.
+class OpenSslTransport : public Transport {
+public:
+    OpenSslTransport(TlsContext& tls, SSL_CTX* ctx);
+    ~OpenSslTransport() { stop(); }
+
+    bool connect(const char* host, uint16_t port, uint32_t timeoutMs);
+    bool connected();
+    void stop();
+    int write(const uint8_t* data, size_t len);
+    int available();
+    int read(uint8_t* buf, size_t len, uint32_t timeoutMs);
+
+    // TlsError of the last connect().
+    int lastError() const { return error_; }
+    bool resumed() const { return resumed_; }
+
+private:
+    static int bioRead(struct bio_st* bio, char* buf, int len);
+    static int bioWrite(struct bio_st* bio, const char* buf, int len);
+    static long bioCtrl(struct bio_st* bio, int cmd, long num, void* ptr);
+    int handshake(const char* host, uint32_t timeoutMs);
+    void saveSession();
+
+    TlsContext& tls_;
+    SSL_CTX* ctx_;
+    SSL* ssl_;
+    PosixTransport tcp_;
+    char host_[TLS_HOST_LEN];
+    uint16_t port_;
+    uint32_t ioTimeoutMs_;
+    int error_;
+    bool resumed_;
+};
+
+// Plain sockets for http://, OpenSslTransport for https://.
+class OpenSslTransportFactory : public TransportFactory {
+public:
+    explicit OpenSslTransportFactory(TlsContext& tls);
+    ~OpenSslTransportFactory();
+
+    // False if the CA bundle could not be loaded.
+    bool ok() const { return ctx_ != NULL; }
+    Transport* acquire(bool secure);
+    void release(Transport* transport) { delete transport; }
+
+private:
+    TlsContext& tls_;
+    SSL_CTX* ctx_;
+};
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+#include <stddef.h>
+#include "static_pool.h"
+#include "transport.h"
+
+// Transports for the HTTP session pool out of two StaticPools, one for
+// plain and one for TLS connections; nothing is allocated per connection.
+// Both types must be default constructible; configure them once through
+// plain()/secure() before the first request.
+template <class PlainT, class SecureT, size_t N>
+class PooledTransportFactory : public TransportFactory {
+public:
+    Transport* acquire(bool secure) {
+        if (secure) return secure_.acquire();
+        return plain_.acquire();
+    }
+
+    void release(Transport* transport) {
+        for (size_t i = 0; i < N; i++) {
+            if (static_cast<Transport*>(&plain_.at(i)) == transport) {
+                plain_.release(&plain_.at(i));
+                return;
+            }
+            if (static_cast<Transport*>(&secure_.at(i)) == transport) {
+                secure_.release(&secure_.at(i));
+                return;
+            }
+        }
+    }
+
+    StaticPool<PlainT, N>& plain() { return plain_; }
+    StaticPool<SecureT, N>& secure() { return secure_; }
+    static size_t reservedBytes() {
+        return StaticPool<PlainT, N>::reservedBytes() + StaticPool<SecureT, N>::reservedBytes();
+    }
+
+private:
+    StaticPool<PlainT, N> plain_;
+    StaticPool<SecureT, N> secure_;
+};
@@ -0,0 +1,99 @@
+#ifndef ARDUINO
+#include "posix_transport.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+uint32_t posixMillis() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000ULL);
+}
+
+bool PosixTransport::connect(const char* host, uint16_t port, uint32_t timeoutMs) {
+    stop();
+    char service[8];
+    snprintf(service, sizeof(service), "%u", (unsigned)port);
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* res = NULL;
+    if (getaddrinfo(host, service, &hints, &res) != 0 || !res) return false;
+
+    int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (fd < 0) {
+        freeaddrinfo(res);
+        return false;
+    }
+    int flags = fcntl(fd, F_GETFL, 0);
+    fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    int rc = ::connect(fd, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rc != 0 && errno != EINPROGRESS) {
+        ::close(fd);
+        return false;
+    }
+    if (rc != 0) {
+        struct pollfd p = {fd, POLLOUT, 0};
+        int err = 0;
+        socklen_t errLen = sizeof(err);
+        if (poll(&p, 1, (int)timeoutMs) != 1 ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errLen) != 0 || err != 0) {
+            ::close(fd);
+            return false;
+        }
+    }
+    fcntl(fd, F_SETFL, flags);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fd_ = fd;
+    return true;
+}
+
+bool PosixTransport::connected() {
+    if (fd_ < 0) return false;
+    char c;
+    ssize_t n = recv(fd_, &c, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n == 0) return false;
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) return false;
+    return true;
+}
+
+void PosixTransport::stop() {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+int PosixTransport::write(const uint8_t* data, size_t len) {
+    if (fd_ < 0) return -1;
+    ssize_t n = send(fd_, data, len, MSG_NOSIGNAL);
+    return n < 0 ? -1 : (int)n;
+}
+
+int PosixTransport::available() {
+    if (fd_ < 0) return 0;
+    int n = 0;
+    if (ioctl(fd_, FIONREAD, &n) != 0) return 0;
+    return n;
+}
+
+int PosixTransport::read(uint8_t* buf, size_t len, uint32_t timeoutMs) {
+    if (fd_ < 0) return -1;
+    struct pollfd p = {fd_, POLLIN, 0};
+    int ready = poll(&p, 1, (int)timeoutMs);
+    if (ready == 0) return 0;
+    if (ready < 0) return -1;
+    ssize_t n = recv(fd_, buf, len, 0);
+    return n <= 0 ? -1 : (int)n;
+}
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+#ifndef ARDUINO
+#include "transport.h"
+
+// Plain TCP transport over POSIX sockets, used by the native build and tests.
+class PosixTransport : public Transport {
+public:
+    PosixTransport() : fd_(-1) {}
+    ~PosixTransport() { stop(); }
+
+    bool connect(const char* host, uint16_t port, uint32_t timeoutMs);
+    bool connected();
+    void stop();
+    int write(const uint8_t* data, size_t len);
+    int available();
+    int read(uint8_t* buf, size_t len, uint32_t timeoutMs);
+
+private:
+    int fd_;
+};
+
+// Factory that allocates plain transports; TLS is not available on the host.
+class PosixTransportFactory : public TransportFactory {
+public:
+    Transport* acquire(bool secure) { return secure ? NULL : new PosixTransport(); }
+    void release(Transport* transport) { delete transport; }
+};
+
+uint32_t posixMillis();
+#endif
@@ -0,0 +1,34 @@
+#pragma once
+#ifdef ARDUINO
+#include <PubSubClient.h>
+#include "mqtt_client.h"
+
+// MqttClient over a PubSubClient configured by the caller. PubSubClient
+// publishes at QoS 0 only, so qos is not passed on; publish() returning true
+// means the packet was handed to the TCP stack.
+class PubSubMqttClient : public MqttClient {
+public:
+    explicit PubSubMqttClient(PubSubClient& client) : client_(client), messageFn_(NULL), messageCtx_(NULL) {}
+
+    bool connected() { return client_.connected(); }
+    bool connect(const char* clientId) { return client_.connect(clientId); }
+    bool publish(const char* topic, const uint8_t* payload, size_t len, uint8_t, bool retain) {
+        return client_.publish(topic, payload, (unsigned int)len, retain);
+    }
+    bool subscribe(const char* topic, uint8_t qos) { return client_.subscribe(topic, qos); }
+    void onMessage(MqttMessageFn fn, void* ctx) {
+        messageFn_ = fn;
+        messageCtx_ = ctx;
+        client_.setCallback([this](char* topic, uint8_t* payload, unsigned int len) {
+            if (messageFn_) messageFn_(topic, payload, len, messageCtx_);
+        });
+    }
+    bool loop() { return client_.loop(); }
+    int state() { return client_.state(); }
+
+private:
+    PubSubClient& client_;
+    MqttMessageFn messageFn_;
+    void* messageCtx_;
+};
+#endif
@@ -0,0 +1,74 @@
+#include "tls_context.h"
+#include <string.h>
+
+TlsContext::TlsContext(const TlsConfig& config, uint32_t (*nowMs)())
+    : config_(config), nowMs_(nowMs), handshakeFn_(NULL), handshakeCtx_(NULL) {
+    clearSessions();
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+TlsContext::Slot* TlsContext::find(const char* host, uint16_t port) {
+    for (size_t i = 0; i < TLS_SESSION_SLOTS; i++) {
+        Slot& s = slots_[i];
+        if (s.len && s.port == port && strcmp(s.host, host) == 0) return &s;
+    }
+    return NULL;
+}
+
+bool TlsContext::saveSession(const char* host, uint16_t port, const uint8_t* data, size_t len) {
+    if (len == 0 || len > TLS_SESSION_MAX || strlen(host) >= TLS_HOST_LEN) return false;
+    Slot* slot = find(host, port);
+    if (!slot) {
+        // An empty slot, else the oldest session
+        slot = &slots_[0];
+        for (size_t i = 0; i < TLS_SESSION_SLOTS && slot->len; i++) {
+            Slot& s = slots_[i];
+            if (!s.len || (int32_t)(s.savedMs - slot->savedMs) < 0) slot = &s;
+        }
+    }
+    strcpy(slot->host, host);
+    slot->port = port;
+    slot->savedMs = nowMs_();
+    memcpy(slot->data, data, len);
+    slot->len = len;
+    return true;
+}
+
+size_t TlsContext::findSession(const char* host, uint16_t port, const uint8_t** data) {
+    Slot* slot = find(host, port);
+    if (!slot) return 0;
+    if (nowMs_() - slot->savedMs >= TLS_SESSION_LIFETIME_MS) {
+        slot->len = 0;
+        return 0;
+    }
+    *data = slot->data;
+    return slot->len;
+}
+
+void TlsContext::forgetSession(const char* host, uint16_t port) {
+    Slot* slot = find(host, port);
+    if (slot) slot->len = 0;
+}
+
+void TlsContext::clearSessions() {
+    for (size_t i = 0; i < TLS_SESSION_SLOTS; i++) {
+        slots_[i].host[0] = '\0';
+        slots_[i].port = 0;
+        slots_[i].savedMs = 0;
+        slots_[i].len = 0;
+    }
+}
+
+void TlsContext::handshakeDone(const char* host, uint16_t port, bool resumed, uint32_t ms, int error) {
+    if (error == TLS_OK) {
+        stats_.handshakes++;
+        stats_.handshakeMs += ms;
+        if (resumed) stats_.resumed++;
+    } else {
+        stats_.failures++;
+        if (error == TLS_ERR_VERIFY) stats_.verifyFailures++;
+        // A session the server rejected must not be offered again
+        forgetSession(host, port);
+    }
+    if (handshakeFn_) handshakeFn_(host, resumed, ms, error, handshakeCtx_);
+}
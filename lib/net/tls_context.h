@@ -0,0 +1,86 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define TLS_SESSION_SLOTS 4      // one per pooled origin
+#define TLS_HOST_LEN 64
+#ifndef TLS_SESSION_MAX
+#define TLS_SESSION_MAX 2048     // serialized session, including the server certificate
+#endif
+#define TLS_SESSION_LIFETIME_MS 3600000 // servers keep tickets for an hour or more
+
+enum TlsError {
+    TLS_OK = 0,
+    TLS_ERR_CONNECT = -1,   // TCP connect failed
+    TLS_ERR_HANDSHAKE = -2, // alert, protocol error or out of memory
+    TLS_ERR_VERIFY = -3,    // certificate not signed by a pinned CA or wrong host
+    TLS_ERR_TIMEOUT = -4
+};
+
+struct TlsConfig {
+    // Pinned CA bundle: one or more PEM certificates, the only roots the
+    // server chain may lead to. NULL skips verification (local testing only).
+    const char* caPem;
+    uint32_t handshakeTimeoutMs;
+    bool resume;            // offer the cached session of the origin
+};
+
+struct TlsStats {
+    uint32_t handshakes;    // successful, full or resumed
+    uint32_t resumed;
+    uint32_t failures;
+    uint32_t verifyFailures;
+    uint32_t handshakeMs;   // total time spent in successful handshakes
+};
+
+// Reports every handshake attempt; error is a TlsError.
+typedef void (*TlsHandshakeFn)(const char* host, bool resumed, uint32_t ms, int error, void* ctx);
+
+// State shared by the TLS transports of one device: configuration, the
+// session cache that lets reconnects skip the full handshake, and stats.
+// The TLS library specific transports (mbedtls on the ESP32, OpenSSL on the
+// host) store sessions as opaque serialized blobs. Not thread safe; used by
+// the task that owns the HTTP pool.
+class TlsContext {
+public:
+    TlsContext(const TlsConfig& config, uint32_t (*nowMs)());
+
+    const TlsConfig& config() const { return config_; }
+    uint32_t nowMs() const { return nowMs_(); }
+    void onHandshake(TlsHandshakeFn fn, void* ctx) {
+        handshakeFn_ = fn;
+        handshakeCtx_ = ctx;
+    }
+
+    // Keeps a copy of the session for host:port, replacing its previous
+    // session or the oldest slot. False if it is larger than TLS_SESSION_MAX.
+    bool saveSession(const char* host, uint16_t port, const uint8_t* data, size_t len);
+    // Returns the cached session's length and points *data at it; 0 if
+    // there is none or it expired.
+    size_t findSession(const char* host, uint16_t port, const uint8_t** data);
+    void forgetSession(const char* host, uint16_t port);
+    void clearSessions();
+
+    // Called by the transports once per handshake.
+    void handshakeDone(const char* host, uint16_t port, bool resumed, uint32_t ms, int error);
+
+    const TlsStats& stats() const { return stats_; }
+
+private:
+    struct Slot {
+        char host[TLS_HOST_LEN];
+        uint16_t port;
+        uint32_t savedMs;
+        size_t len; // 0 = empty
+        uint8_t data[TLS_SESSION_MAX];
+    };
+
+    Slot* find(const char* host, uint16_t port);
+
+    TlsConfig config_;
+    uint32_t (*nowMs_)();
+    TlsHandshakeFn handshakeFn_;
+    void* handshakeCtx_;
+    Slot slots_[TLS_SESSION_SLOTS];
+    TlsStats stats_;
+};
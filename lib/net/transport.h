@@ -0,0 +1,26 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte-stream connection used by the HTTP layer. On the ESP32 it wraps
+// WiFiClient/WiFiClientSecure, on the host it wraps a POSIX socket.
+class Transport {
+public:
+    virtual ~Transport() {}
+    virtual bool connect(const char* host, uint16_t port, uint32_t timeoutMs) = 0;
+    virtual bool connected() = 0;
+    virtual void stop() = 0;
+    virtual int write(const uint8_t* data, size_t len) = 0;
+    // Bytes that can be read without blocking.
+    virtual int available() = 0;
+    // Waits up to timeoutMs for data. Returns bytes read, 0 on timeout, -1 if the peer closed.
+    virtual int read(uint8_t* buf, size_t len, uint32_t timeoutMs) = 0;
+};
+
+// Hands out transports for plain (secure == false) or TLS connections.
+class TransportFactory {
+public:
+    virtual ~TransportFactory() {}
+    virtual Transport* acquire(bool secure) = 0;
+    virtual void release(Transport* transport) = 0;
+};
@@ -0,0 +1,113 @@
+#ifndef ARDUINO
+#include "delta_encoder.h"
+#include <string.h>
+#include <unordered_map>
+#include "delta_patch.h"
+
+static void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+static void putLe32(std::vector<uint8_t>& out, uint32_t v) {
+    for (int i = 0; i < 4; i++) out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static uint64_t blockHash(const uint8_t* p) {
+    uint64_t h = 1469598103934665603ULL;
+    for (int i = 0; i < DELTA_BLOCK; i++) h = (h ^ p[i]) * 1099511628211ULL;
+    return h;
+}
+
+static void digest(const uint8_t* data, size_t len, std::vector<uint8_t>& out) {
+    Sha256 sha;
+    uint8_t d[SHA256_DIGEST_LEN];
+    sha.update(data, len);
+    sha.finish(d);
+    out.insert(out.end(), d, d + SHA256_DIGEST_LEN);
+}
+
+// Bytes that did not match anywhere. If they line up with the source right
+// after the previous copy and differ in at most half the positions (changed
+// constants, shifted addresses) they go out as ADD, otherwise as INSERT.
+static void emitGap(std::vector<uint8_t>& out, const uint8_t* src, size_t srcLen, const uint8_t* dst,
+                    size_t from, size_t to, size_t srcFrom) {
+    size_t len = to - from;
+    if (len == 0) return;
+    size_t same = 0;
+    if (srcFrom + len <= srcLen) {
+        for (size_t i = 0; i < len; i++) same += dst[from + i] == src[srcFrom + i];
+    }
+    if (same * 2 < len) {
+        out.push_back(DELTA_OP_INSERT);
+        putVarint(out, (uint32_t)len);
+        out.insert(out.end(), dst + from, dst + to);
+        return;
+    }
+    out.push_back(DELTA_OP_ADD);
+    putVarint(out, (uint32_t)len);
+    putVarint(out, (uint32_t)srcFrom);
+    size_t i = 0;
+    while (i < len) {
+        size_t zeros = 0;
+        while (i + zeros < len && dst[from + i + zeros] == src[srcFrom + i + zeros]) zeros++;
+        i += zeros;
+        // A literal run ends at the first stretch of three equal bytes.
+        size_t lit = 0;
+        while (i + lit < len) {
+            size_t run = 0;
+            while (run < 3 && i + lit + run < len && dst[from + i + lit + run] == src[srcFrom + i + lit + run]) run++;
+            if (run == 3 || i + lit + run == len) {
+                if (run < 3) lit += run;
+                break;
+            }
+            lit += run + 1;
+        }
+        putVarint(out, (uint32_t)zeros);
+        putVarint(out, (uint32_t)lit);
+        for (size_t k = 0; k < lit; k++) out.push_back((uint8_t)(dst[from + i + k] - src[srcFrom + i + k]));
+        i += lit;
+    }
+}
+
+std::vector<uint8_t> makeDeltaPatch(const uint8_t* src, size_t srcLen, const uint8_t* dst, size_t dstLen) {
+    std::vector<uint8_t> out(DELTA_MAGIC, DELTA_MAGIC + 4);
+    putLe32(out, (uint32_t)srcLen);
+    putLe32(out, (uint32_t)dstLen);
+    digest(src, srcLen, out);
+    digest(dst, dstLen, out);
+
+    // Index block-aligned source blocks; any match of two blocks or more hits one.
+    std::unordered_map<uint64_t, size_t> index;
+    for (size_t s = 0; s + DELTA_BLOCK <= srcLen; s += DELTA_BLOCK) index.emplace(blockHash(src + s), s);
+
+    size_t t = 0, litStart = 0, srcNext = 0;
+    while (t + DELTA_BLOCK <= dstLen) {
+        auto it = index.find(blockHash(dst + t));
+        if (it == index.end() || memcmp(src + it->second, dst + t, DELTA_BLOCK) != 0) {
+            t++;
+            continue;
+        }
+        size_t s = it->second;
+        while (t > litStart && s > 0 && dst[t - 1] == src[s - 1]) {
+            t--;
+            s--;
+        }
+        size_t n = 0;
+        while (t + n < dstLen && s + n < srcLen && dst[t + n] == src[s + n]) n++;
+        emitGap(out, src, srcLen, dst, litStart, t, srcNext);
+        out.push_back(DELTA_OP_COPY);
+        putVarint(out, (uint32_t)n);
+        putVarint(out, (uint32_t)s);
+        t += n;
+        litStart = t;
+        srcNext = s + n;
+    }
+    emitGap(out, src, srcLen, dst, litStart, dstLen, srcNext);
+    out.push_back(DELTA_OP_END);
+    return out;
+}
+#endif
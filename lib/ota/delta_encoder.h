@@ -0,0 +1,13 @@
+#pragma once
+#ifndef ARDUINO
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Host-side patch generator for the format in delta_patch.h. Produces the
+// same bytes as tools/make_delta_patch.py for the same pair of images.
+#define DELTA_BLOCK 16
+
+std::vector<uint8_t> makeDeltaPatch(const uint8_t* source, size_t sourceLen, const uint8_t* target,
+                                    size_t targetLen);
+#endif
@@ -0,0 +1,215 @@
+#include "delta_patch.h"
+#include <string.h>
+
+static uint32_t readLe32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+DeltaPatchWriter::DeltaPatchWriter(SourceImage& source, FlashWriter& target, uint8_t* buffer, size_t bufferSize)
+    : source_(source), target_(target), buffer_(buffer), bufferSize_(bufferSize), buffered_(0),
+      expectedHex_(NULL), state_(S_HEADER), error_(DELTA_OK), targetBegun_(false), headerLen_(0),
+      sourceSize_(0), targetSize_(0), written_(0), emitted_(0), cacheStart_(0), cacheLen_(0) {}
+
+bool DeltaPatchWriter::begin(uint32_t) {
+    state_ = S_HEADER;
+    error_ = DELTA_OK;
+    targetBegun_ = false;
+    headerLen_ = 0;
+    buffered_ = 0;
+    written_ = 0;
+    emitted_ = 0;
+    cacheLen_ = 0;
+    sha_.reset();
+    return true;
+}
+
+bool DeltaPatchWriter::fail(int error) {
+    if (error_ == DELTA_OK) error_ = error;
+    return false;
+}
+
+bool DeltaPatchWriter::takeVarint(uint8_t b, uint32_t& out) {
+    if (shift_ > 28) return fail(DELTA_ERR_FORMAT);
+    varint_ |= (uint32_t)(b & 0x7f) << shift_;
+    shift_ += 7;
+    if (b & 0x80) return false;
+    out = varint_;
+    varint_ = 0;
+    shift_ = 0;
+    return true;
+}
+
+bool DeltaPatchWriter::readSource(uint32_t offset, size_t len) {
+    if (!source_.read(offset, cache_, len)) return fail(DELTA_ERR_SOURCE);
+    cacheStart_ = offset;
+    cacheLen_ = len;
+    return true;
+}
+
+// Checks the patch was made against the running image before touching flash.
+bool DeltaPatchWriter::startTarget() {
+    if (memcmp(header_, DELTA_MAGIC, 4) != 0) return fail(DELTA_ERR_FORMAT);
+    sourceSize_ = readLe32(header_ + 4);
+    targetSize_ = readLe32(header_ + 8);
+    const uint8_t* sourceSha = header_ + 12;
+    const uint8_t* targetSha = sourceSha + SHA256_DIGEST_LEN;
+
+    if (expectedHex_ && !sha256MatchesHex(targetSha, expectedHex_)) return fail(DELTA_ERR_DIGEST);
+
+    Sha256 sha;
+    for (uint32_t off = 0; off < sourceSize_; off += (uint32_t)cacheLen_) {
+        size_t n = sourceSize_ - off < sizeof(cache_) ? sourceSize_ - off : sizeof(cache_);
+        if (!readSource(off, n)) return false;
+        sha.update(cache_, n);
+    }
+    uint8_t digest[SHA256_DIGEST_LEN];
+    sha.finish(digest);
+    if (memcmp(digest, sourceSha, SHA256_DIGEST_LEN) != 0) return fail(DELTA_ERR_SOURCE);
+
+    if (!target_.begin(targetSize_)) return fail(DELTA_ERR_WRITE);
+    targetBegun_ = true;
+    varint_ = 0;
+    shift_ = 0;
+    state_ = S_OP;
+    return true;
+}
+
+bool DeltaPatchWriter::flush() {
+    if (buffered_ == 0) return true;
+    sha_.update(buffer_, buffered_);
+    if (!target_.write(buffer_, buffered_)) return fail(DELTA_ERR_WRITE);
+    written_ += (uint32_t)buffered_;
+    buffered_ = 0;
+    return true;
+}
+
+bool DeltaPatchWriter::emit(const uint8_t* data, size_t len) {
+    if (len > targetSize_ - emitted_) return fail(DELTA_ERR_RANGE);
+    emitted_ += (uint32_t)len;
+    while (len) {
+        size_t take = bufferSize_ - buffered_ < len ? bufferSize_ - buffered_ : len;
+        memcpy(buffer_ + buffered_, data, take);
+        buffered_ += take;
+        data += take;
+        len -= take;
+        if (buffered_ == bufferSize_ && !flush()) return false;
+    }
+    return true;
+}
+
+bool DeltaPatchWriter::emitByte(uint8_t b) {
+    return emit(&b, 1);
+}
+
+bool DeltaPatchWriter::copySource(uint32_t offset, uint32_t len) {
+    while (len) {
+        size_t n = len < sizeof(cache_) ? len : sizeof(cache_);
+        if (!readSource(offset, n) || !emit(cache_, n)) return false;
+        offset += (uint32_t)n;
+        len -= (uint32_t)n;
+    }
+    return true;
+}
+
+bool DeltaPatchWriter::write(const uint8_t* data, size_t len) {
+    if (error_ != DELTA_OK) return false;
+    size_t i = 0;
+    while (i < len) {
+        switch (state_) {
+        case S_HEADER: {
+            size_t n = DELTA_HEADER_LEN - headerLen_ < len - i ? DELTA_HEADER_LEN - headerLen_ : len - i;
+            memcpy(header_ + headerLen_, data + i, n);
+            headerLen_ += n;
+            i += n;
+            if (headerLen_ == DELTA_HEADER_LEN && !startTarget()) return false;
+            break;
+        }
+        case S_OP:
+            op_ = data[i++];
+            if (op_ == DELTA_OP_END) {
+                state_ = S_DONE;
+            } else if (op_ == DELTA_OP_COPY || op_ == DELTA_OP_ADD || op_ == DELTA_OP_INSERT) {
+                state_ = S_LEN;
+            } else {
+                return fail(DELTA_ERR_FORMAT);
+            }
+            break;
+        case S_LEN:
+            if (takeVarint(data[i++], opLen_)) {
+                if (opLen_ > targetSize_ - emitted_) return fail(DELTA_ERR_RANGE);
+                if (op_ == DELTA_OP_INSERT) state_ = opLen_ ? S_INSERT : S_OP;
+                else state_ = S_SRC;
+            }
+            break;
+        case S_SRC:
+            if (takeVarint(data[i++], srcPos_)) {
+                if (srcPos_ > sourceSize_ || opLen_ > sourceSize_ - srcPos_) return fail(DELTA_ERR_RANGE);
+                if (op_ == DELTA_OP_COPY) {
+                    if (!copySource(srcPos_, opLen_)) return false;
+                    state_ = S_OP;
+                } else {
+                    state_ = opLen_ ? S_ADD_ZERO : S_OP;
+                }
+            }
+            break;
+        case S_INSERT: {
+            size_t n = opLen_ < len - i ? opLen_ : len - i;
+            if (!emit(data + i, n)) return false;
+            i += n;
+            opLen_ -= (uint32_t)n;
+            if (opLen_ == 0) state_ = S_OP;
+            break;
+        }
+        case S_ADD_ZERO: {
+            uint32_t run;
+            if (takeVarint(data[i++], run)) {
+                if (run > opLen_) return fail(DELTA_ERR_FORMAT);
+                if (!copySource(srcPos_, run)) return false;
+                srcPos_ += run;
+                opLen_ -= run;
+                state_ = S_ADD_LITLEN;
+            }
+            break;
+        }
+        case S_ADD_LITLEN:
+            if (takeVarint(data[i++], litLen_)) {
+                if (litLen_ > opLen_) return fail(DELTA_ERR_FORMAT);
+                if (litLen_) state_ = S_ADD_LIT;
+                else state_ = opLen_ ? S_ADD_ZERO : S_OP;
+            }
+            break;
+        case S_ADD_LIT: {
+            if (srcPos_ < cacheStart_ || srcPos_ >= cacheStart_ + cacheLen_) {
+                uint32_t left = sourceSize_ - srcPos_;
+                if (!readSource(srcPos_, left < sizeof(cache_) ? left : sizeof(cache_))) return false;
+            }
+            uint8_t b = (uint8_t)(cache_[srcPos_ - cacheStart_] + data[i++]);
+            if (!emitByte(b)) return false;
+            srcPos_++;
+            opLen_--;
+            if (--litLen_ == 0) state_ = opLen_ ? S_ADD_ZERO : S_OP;
+            break;
+        }
+        case S_DONE:
+            return fail(DELTA_ERR_FORMAT);
+        }
+        if (error_ != DELTA_OK) return false;
+    }
+    return true;
+}
+
+bool DeltaPatchWriter::commit() {
+    if (error_ != DELTA_OK) return false;
+    if (state_ != S_DONE || emitted_ != targetSize_) return fail(DELTA_ERR_INCOMPLETE);
+    if (!flush()) return false;
+    uint8_t digest[SHA256_DIGEST_LEN];
+    sha_.finish(digest);
+    if (memcmp(digest, header_ + 12 + SHA256_DIGEST_LEN, SHA256_DIGEST_LEN) != 0) return fail(DELTA_ERR_DIGEST);
+    if (!target_.commit()) return fail(DELTA_ERR_WRITE);
+    return true;
+}
+
+void DeltaPatchWriter::abort() {
+    if (targetBegun_) target_.abort();
+    targetBegun_ = false;
+}
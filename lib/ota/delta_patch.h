@@ -0,0 +1,97 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "flash_writer.h"
+#include "sha256.h"
+
+// Patch layout (all integers little endian, lengths and offsets LEB128):
+//   "EDP1" | u32 sourceSize | u32 targetSize | sha256(source) | sha256(target)
+//   then ops until END:
+//     COPY   len srcOffset                copy source bytes
+//     ADD    len srcOffset {zeroRun litLen lit[litLen]}...
+//                                         source bytes plus a mostly-zero difference
+//     INSERT len bytes[len]               new bytes
+#define DELTA_MAGIC "EDP1"
+#define DELTA_HEADER_LEN (4 + 4 + 4 + 2 * SHA256_DIGEST_LEN)
+#ifndef DELTA_SOURCE_CACHE
+#define DELTA_SOURCE_CACHE 256
+#endif
+
+enum DeltaOp { DELTA_OP_END = 0, DELTA_OP_COPY = 1, DELTA_OP_ADD = 2, DELTA_OP_INSERT = 3 };
+
+enum DeltaError {
+    DELTA_OK = 0,
+    DELTA_ERR_FORMAT = -1,     // bad magic, unknown op or trailing data
+    DELTA_ERR_SOURCE = -2,     // running image is not the one the patch was made from
+    DELTA_ERR_RANGE = -3,      // op reaches outside the source or target
+    DELTA_ERR_WRITE = -4,      // target writer failed
+    DELTA_ERR_DIGEST = -5,     // rebuilt image does not hash to the expected value
+    DELTA_ERR_INCOMPLETE = -6  // patch ended before the END op
+};
+
+// Read access to the image the patch applies to (the running partition).
+class SourceImage {
+public:
+    virtual ~SourceImage() {}
+    virtual bool read(uint32_t offset, uint8_t* buf, size_t len) = 0;
+};
+
+// Applies a patch as it streams in and writes the rebuilt image to target.
+// Being a FlashWriter itself, it plugs into OtaDownloader in place of the
+// partition writer, so patches get the same Range resume as full images.
+// RAM use is the output buffer plus DELTA_SOURCE_CACHE bytes.
+class DeltaPatchWriter : public FlashWriter {
+public:
+    DeltaPatchWriter(SourceImage& source, FlashWriter& target, uint8_t* buffer, size_t bufferSize);
+
+    // Optional: reject the patch up front unless it builds this image.
+    void expectTarget(const char* sha256Hex) { expectedHex_ = sha256Hex; }
+
+    bool begin(uint32_t patchSize);
+    bool write(const uint8_t* data, size_t len);
+    bool commit();
+    void abort();
+
+    int error() const { return error_; }
+    uint32_t targetSize() const { return targetSize_; }
+    uint32_t targetBytes() const { return written_ + (uint32_t)buffered_; }
+
+private:
+    enum State { S_HEADER, S_OP, S_LEN, S_SRC, S_INSERT, S_ADD_ZERO, S_ADD_LITLEN, S_ADD_LIT, S_DONE };
+
+    bool startTarget();
+    bool takeVarint(uint8_t b, uint32_t& out);
+    bool readSource(uint32_t offset, size_t len);
+    bool copySource(uint32_t offset, uint32_t len);
+    bool emit(const uint8_t* data, size_t len);
+    bool emitByte(uint8_t b);
+    bool flush();
+    bool fail(int error);
+
+    SourceImage& source_;
+    FlashWriter& target_;
+    uint8_t* buffer_;
+    size_t bufferSize_;
+    size_t buffered_;
+    const char* expectedHex_;
+
+    State state_;
+    int error_;
+    bool targetBegun_;
+    uint8_t header_[DELTA_HEADER_LEN];
+    size_t headerLen_;
+    uint32_t sourceSize_;
+    uint32_t targetSize_;
+    uint32_t written_;
+    uint32_t emitted_;
+    uint8_t op_;
+    uint32_t opLen_;
+    uint32_t srcPos_;
+    uint32_t litLen_;
+    uint32_t varint_;
+    uint8_t shift_;
+    Sha256 sha_;
+    uint8_t cache_[DELTA_SOURCE_CACHE];
+    uint32_t cacheStart_;
+    size_t cacheLen_;
+};
@@ -0,0 +1,29 @@
+#pragma once
+#ifdef ARDUINO
+#include <Update.h>
+#include <esp_ota_ops.h>
+#include "delta_patch.h"
+#include "flash_writer.h"
+
+// Writes into the next OTA partition through the Arduino Update library.
+// commit() is the only step that switches the boot partition.
+class EspUpdateWriter : public FlashWriter {
+public:
+    bool begin(uint32_t imageSize) { return Update.begin(imageSize ? imageSize : UPDATE_SIZE_UNKNOWN); }
+    bool write(const uint8_t* data, size_t len) { return Update.write((uint8_t*)data, len) == len; }
+    bool commit() { return Update.end(true); }
+    void abort() { Update.abort(); }
+};
+
+// The running app partition, which delta patches are made against.
+class EspPartitionSource : public SourceImage {
+public:
+    EspPartitionSource() : partition_(esp_ota_get_running_partition()) {}
+    bool read(uint32_t offset, uint8_t* buf, size_t len) {
+        return partition_ && esp_partition_read(partition_, offset, buf, len) == ESP_OK;
+    }
+
+private:
+    const esp_partition_t* partition_;
+};
+#endif
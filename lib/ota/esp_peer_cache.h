@@ -0,0 +1,122 @@
+#pragma once
+#ifdef ARDUINO
+#include <atomic>
+#include <ESPAsyncWebServer.h>
+#include <ESPmDNS.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <esp_ota_ops.h>
+#include "peer_cache.h"
+
+#define PEER_NAMESPACE "peer"
+
+// The image installed by the last update, saved when it committed; a
+// device serves it once it runs and has passed the health gate.
+inline bool peerImageLoad(PeerImage& out) {
+    Preferences prefs;
+    if (!prefs.begin(PEER_NAMESPACE, true)) return false;
+    size_t n = prefs.getBytes("image", &out, sizeof(out));
+    prefs.end();
+    return n == sizeof(out) && peerImageValid(out);
+}
+
+inline void peerImageSave(const PeerImage& image) {
+    Preferences prefs;
+    if (!prefs.begin(PEER_NAMESPACE, false)) return;
+    prefs.putBytes("image", &image, sizeof(image));
+    prefs.end();
+}
+
+// mDNS discovery of the peers on the LAN plus this device's own image
+// server (AsyncWebServer, on the AsyncTCP task). Only the running partition
+// is served, and only under the sha256 it was verified against.
+class EspPeerCache : public PeerDiscovery {
+public:
+    EspPeerCache(const char* hostname, uint16_t port)
+        : hostname_(hostname), port_(port), mdns_(false), serving_(false), server_(port),
+          partition_(esp_ota_get_running_partition()), served_(0) {}
+
+    size_t query(PeerInfo* out, size_t max) {
+        if (!beginMdns()) return 0;
+        int n = MDNS.queryService(PEER_SERVICE, "tcp");
+        IPAddress self = WiFi.localIP();
+        size_t count = 0;
+        for (int i = 0; i < n && count < max; i++) {
+            IPAddress ip = MDNS.IP(i);
+            if (ip == self) continue;
+            PeerInfo& peer = out[count];
+            memset(&peer, 0, sizeof(peer));
+            snprintf(peer.host, sizeof(peer.host), "%u.%u.%u.%u", ip[0], ip[1], ip[2], ip[3]);
+            peer.port = MDNS.port(i);
+            if (!peerTxtField("v", MDNS.txt(i, "v").c_str(), peer.image) ||
+                !peerTxtField("sha", MDNS.txt(i, "sha").c_str(), peer.image) ||
+                !peerTxtField("size", MDNS.txt(i, "size").c_str(), peer.image)) {
+                continue;
+            }
+            count++;
+        }
+        return count;
+    }
+
+    // Starts serving image and advertises it; once per boot.
+    bool serve(const PeerImage& image) {
+        if (serving_ || !partition_ || image.size > partition_->size || !beginMdns()) return serving_;
+        image_ = image;
+        server_.on("/fw", HTTP_GET, [this](AsyncWebServerRequest* req) { handle(req); });
+        server_.begin();
+        char size[12];
+        snprintf(size, sizeof(size), "%lu", (unsigned long)image_.size);
+        MDNS.addService(PEER_SERVICE, "tcp", port_);
+        MDNS.addServiceTxt(PEER_SERVICE, "tcp", "v", image_.version);
+        MDNS.addServiceTxt(PEER_SERVICE, "tcp", "sha", image_.sha256);
+        MDNS.addServiceTxt(PEER_SERVICE, "tcp", "size", size);
+        serving_ = true;
+        return true;
+    }
+
+    bool serving() const { return serving_; }
+    // Images and ranges handed out to peers since boot.
+    uint32_t served() const { return served_.load(); }
+
+private:
+    bool beginMdns() {
+        if (!mdns_) mdns_ = MDNS.begin(hostname_);
+        return mdns_;
+    }
+
+    void handle(AsyncWebServerRequest* req) {
+        const char* range = req->hasHeader("Range") ? req->getHeader("Range")->value().c_str() : NULL;
+        PeerServeResult r = peerServe(image_, req->url().c_str(), range);
+        if (r.status != 200 && r.status != 206) {
+            req->send(r.status);
+            return;
+        }
+        const esp_partition_t* partition = partition_;
+        AsyncWebServerResponse* resp = req->beginResponse(
+            "application/octet-stream", r.length, [partition, r](uint8_t* buf, size_t maxLen, size_t index) -> size_t {
+                size_t n = r.length - index < maxLen ? r.length - index : maxLen;
+                // A short answer ends the body; the client resumes with a Range request
+                if (n && esp_partition_read(partition, r.start + index, buf, n) != ESP_OK) return 0;
+                return n;
+            });
+        if (r.status == 206) {
+            char value[48];
+            peerContentRange(r, image_, value, sizeof(value));
+            resp->setCode(206);
+            resp->addHeader("Content-Range", value);
+        }
+        resp->addHeader("Accept-Ranges", "bytes");
+        req->send(resp);
+        served_++;
+    }
+
+    const char* hostname_;
+    uint16_t port_;
+    bool mdns_;
+    bool serving_;
+    AsyncWebServer server_;
+    const esp_partition_t* partition_;
+    PeerImage image_;
+    std::atomic<uint32_t> served_;
+};
+#endif
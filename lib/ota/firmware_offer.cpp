@@ -0,0 +1,14 @@
+#include "firmware_offer.h"
+
+FirmwareOfferParser::FirmwareOfferParser(FirmwareOffer& offer)
+    : fields_{{"version", offer.version, sizeof(offer.version), false},
+              {"url", offer.url, sizeof(offer.url), false},
+              {"sha256", offer.sha256, sizeof(offer.sha256), false},
+              {"patch_url", offer.patchUrl, sizeof(offer.patchUrl), false},
+              {"patch_from", offer.patchFrom, sizeof(offer.patchFrom), false},
+              {"patch_sha256", offer.patchSha256, sizeof(offer.patchSha256), false}},
+      extractor_(fields_, FIRMWARE_OFFER_FIELDS) {}
+
+bool FirmwareOfferParser::finish() {
+    return extractor_.finish() && fields_[0].found && fields_[1].found;
+}
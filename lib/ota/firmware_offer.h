@@ -0,0 +1,39 @@
+#pragma once
+#include <stddef.h>
+#include "http_session_pool.h"
+#include "json_fields.h"
+#include "sha256.h"
+
+#define FIRMWARE_OFFER_FIELDS 6
+
+// An available update, from the version endpoint or an "ota" command:
+//   {"version":"1.2.0","url":"...","sha256":"...",
+//    "patch_url":"...","patch_from":"1.1.0","patch_sha256":"..."}
+// The patch fields are optional: a delta from patch_from to version. A field
+// missing from the JSON is left as an empty string.
+struct FirmwareOffer {
+    char version[32];
+    char url[HTTP_POOL_PATH_LEN];
+    char sha256[2 * SHA256_DIGEST_LEN + 1];
+    char patchUrl[HTTP_POOL_PATH_LEN];
+    char patchFrom[32];
+    char patchSha256[2 * SHA256_DIGEST_LEN + 1];
+};
+
+// Fills an offer from a JSON object as it streams in; other keys are ignored.
+class FirmwareOfferParser {
+public:
+    explicit FirmwareOfferParser(FirmwareOffer& offer);
+
+    bool feed(const char* data, size_t len) { return extractor_.feed(data, len); }
+    // Returns true if the object was valid and had at least version and url.
+    bool finish();
+
+    bool hasSha256() const { return fields_[2].found; }
+    bool hasPatch() const { return fields_[3].found && fields_[4].found; }
+    bool hasPatchSha256() const { return fields_[5].found; }
+
+private:
+    JsonField fields_[FIRMWARE_OFFER_FIELDS];
+    JsonFieldExtractor extractor_;
+};
@@ -0,0 +1,17 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Destination of a firmware image. On the ESP32 this is the inactive OTA
+// partition, in native tests a buffer or file.
+class FlashWriter {
+public:
+    virtual ~FlashWriter() {}
+    // imageSize is 0 when the server did not report it.
+    virtual bool begin(uint32_t imageSize) = 0;
+    // Called with consecutive pieces of the image.
+    virtual bool write(const uint8_t* data, size_t len) = 0;
+    // The image is complete and verified: make it the boot image.
+    virtual bool commit() = 0;
+    virtual void abort() = 0;
+};
@@ -0,0 +1,27 @@
+#include "fw_version.h"
+#include <stdint.h>
+
+// Reads one component and leaves p on the character after its '.', or on
+// the terminating NUL.
+static uint32_t nextComponent(const char*& p) {
+    uint32_t v = 0;
+    while (*p >= '0' && *p <= '9') {
+        if (v < 100000000u) v = v * 10 + (uint32_t)(*p - '0');
+        p++;
+    }
+    while (*p && *p != '.') p++;
+    if (*p == '.') p++;
+    return v;
+}
+
+int compareVersion(const char* v1, const char* v2) {
+    if (*v1 == 'v' || *v1 == 'V') v1++;
+    if (*v2 == 'v' || *v2 == 'V') v2++;
+    while (*v1 || *v2) {
+        uint32_t a = nextComponent(v1);
+        uint32_t b = nextComponent(v2);
+        if (a > b) return 1;
+        if (a < b) return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+// Compares dotted versions such as "1.10.2" component by component; missing
+// components count as 0 ("1.2" == "1.2.0"). A leading 'v' is ignored and a
+// component stops at its first non-digit, so "1.3.0-rc1" compares as 1.3.0.
+// Returns 1 if v1 is newer, -1 if older, 0 if equal.
+int compareVersion(const char* v1, const char* v2);
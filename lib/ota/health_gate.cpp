@@ -0,0 +1,80 @@
+#include "health_gate.h"
+#include <string.h>
+
+static const char* const checkNames[HEALTH_CHECK_COUNT] = {"wifi", "mqtt", "http", "heap", "watchdog"};
+
+static int checkIndex(HealthCheck check) {
+    for (int i = 0; i < HEALTH_CHECK_COUNT; i++) {
+        if (check == (1 << i)) return i;
+    }
+    return -1;
+}
+
+const char* healthCheckName(HealthCheck check) {
+    int i = checkIndex(check);
+    return i < 0 ? "unknown" : checkNames[i];
+}
+
+size_t healthCheckList(uint8_t mask, char* out, size_t cap) {
+    if (cap == 0) return 0;
+    size_t len = 0;
+    out[0] = '\0';
+    for (int i = 0; i < HEALTH_CHECK_COUNT; i++) {
+        if (!(mask & (1 << i))) continue;
+        size_t name = strlen(checkNames[i]);
+        if (len + name + (len ? 1 : 0) >= cap) break;
+        if (len) out[len++] = ',';
+        memcpy(out + len, checkNames[i], name + 1);
+        len += name;
+    }
+    return len;
+}
+
+HealthGate::HealthGate(HealthProbes& probes, const HealthGateConfig& config, uint32_t (*nowMs)())
+    : probes_(probes), config_(config), nowMs_(nowMs), startMs_(0), started_(false) {
+    memset(&report_, 0, sizeof(report_));
+}
+
+void HealthGate::begin() {
+    memset(&report_, 0, sizeof(report_));
+    startMs_ = nowMs_();
+    started_ = true;
+}
+
+HealthVerdict HealthGate::poll() {
+    if (!active()) return report_.verdict;
+    uint32_t elapsed = nowMs_() - startMs_;
+
+    // Heap and watchdog can only fail; they pass by surviving the soak
+    report_.minFreeHeap = probes_.minFreeHeap();
+    if (report_.minFreeHeap < config_.heapFloor) report_.failed |= HEALTH_HEAP;
+    if (probes_.watchdogTripped()) report_.failed |= HEALTH_WATCHDOG;
+    report_.failed &= config_.required;
+    if (report_.failed) return decide(HEALTH_FAILED, elapsed);
+
+    if (probes_.wifiConnected()) pass(HEALTH_WIFI, elapsed);
+    if (probes_.mqttRoundTrip()) pass(HEALTH_MQTT, elapsed);
+    if (probes_.httpRoundTrip()) pass(HEALTH_HTTP, elapsed);
+    if (elapsed >= config_.minSoakMs) {
+        pass(HEALTH_HEAP, elapsed);
+        pass(HEALTH_WATCHDOG, elapsed);
+    }
+    if ((report_.passed & config_.required) == config_.required) return decide(HEALTH_PASSED, elapsed);
+    if (elapsed >= config_.timeoutMs) {
+        report_.failed = config_.required & ~report_.passed;
+        return decide(HEALTH_FAILED, elapsed);
+    }
+    return HEALTH_PENDING;
+}
+
+void HealthGate::pass(HealthCheck check, uint32_t elapsed) {
+    if (report_.passed & check) return;
+    report_.passed |= check;
+    report_.passedAtMs[checkIndex(check)] = elapsed;
+}
+
+HealthVerdict HealthGate::decide(HealthVerdict verdict, uint32_t elapsed) {
+    report_.verdict = verdict;
+    report_.elapsedMs = elapsed;
+    return verdict;
+}
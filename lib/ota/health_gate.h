@@ -0,0 +1,82 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Checks a new firmware image must pass before it is marked valid.
+enum HealthCheck {
+    HEALTH_WIFI = 1 << 0,     // associated and got an address
+    HEALTH_MQTT = 1 << 1,     // broker accepted a connection
+    HEALTH_HTTP = 1 << 2,     // an API request got a 2xx/3xx answer
+    HEALTH_HEAP = 1 << 3,     // free heap never went below the floor
+    HEALTH_WATCHDOG = 1 << 4  // no task stalled
+};
+#define HEALTH_CHECK_COUNT 5
+#define HEALTH_ALL_CHECKS 0x1f
+
+const char* healthCheckName(HealthCheck check);
+// Comma separated names of the checks in mask, e.g. "mqtt,http". Returns
+// the length; the list is cut short if it does not fit.
+size_t healthCheckList(uint8_t mask, char* out, size_t cap);
+
+// What the gate samples on each poll. Every call must return at once.
+class HealthProbes {
+public:
+    virtual ~HealthProbes() {}
+    virtual bool wifiConnected() = 0;
+    virtual bool mqttRoundTrip() = 0;
+    virtual bool httpRoundTrip() = 0;
+    // Lowest free heap since boot.
+    virtual uint32_t minFreeHeap() = 0;
+    // True once a watched task has stopped making progress.
+    virtual bool watchdogTripped() = 0;
+};
+
+struct HealthGateConfig {
+    uint8_t required;     // HealthCheck bits that must pass
+    uint32_t heapFloor;   // bytes
+    uint32_t minSoakMs;   // heap and watchdog are watched at least this long
+    uint32_t timeoutMs;   // checks still missing by then fail the image
+};
+
+enum HealthVerdict {
+    HEALTH_PENDING = 0,
+    HEALTH_PASSED,
+    HEALTH_FAILED
+};
+
+struct HealthReport {
+    HealthVerdict verdict;
+    uint32_t elapsedMs;        // time to healthy, or to the failure
+    uint8_t passed;            // HealthCheck bits
+    uint8_t failed;
+    uint32_t passedAtMs[HEALTH_CHECK_COUNT]; // ms after begin(), by bit index; valid for passed bits
+    uint32_t minFreeHeap;
+};
+
+// Decides whether a freshly installed image is healthy without blocking:
+// poll() is called every few seconds from a job while the device runs
+// normally. A heap or watchdog failure fails the image at once; anything
+// else may pass at any time until timeoutMs.
+class HealthGate {
+public:
+    HealthGate(HealthProbes& probes, const HealthGateConfig& config, uint32_t (*nowMs)());
+
+    void begin();
+    // Samples the probes and returns the verdict; it does not change once
+    // it is HEALTH_PASSED or HEALTH_FAILED.
+    HealthVerdict poll();
+
+    bool active() const { return started_ && report_.verdict == HEALTH_PENDING; }
+    const HealthReport& report() const { return report_; }
+
+private:
+    void pass(HealthCheck check, uint32_t elapsed);
+    HealthVerdict decide(HealthVerdict verdict, uint32_t elapsed);
+
+    HealthProbes& probes_;
+    HealthGateConfig config_;
+    uint32_t (*nowMs_)();
+    uint32_t startMs_;
+    bool started_;
+    HealthReport report_;
+};
@@ -0,0 +1,168 @@
+#include "ota_downloader.h"
+#include <stdio.h>
+#include <string.h>
+
+#define OTA_HEADER_BUF 384
+
+OtaConfig defaultOtaConfig(uint32_t (*nowMs)(), void (*sleepMs)(uint32_t)) {
+    OtaConfig c;
+    c.maxAttempts = 5;
+    c.retryDelayMs = 1000;
+    c.stallThresholdMs = 500;
+    c.progressIntervalMs = 2000;
+    c.nowMs = nowMs;
+    c.sleepMs = sleepMs;
+    return c;
+}
+
+OtaDownloader::OtaDownloader(HttpSessionPool& pool, FlashWriter& writer, uint8_t* buffer, size_t bufferSize,
+                             const OtaConfig& config)
+    : pool_(pool), writer_(writer), buffer_(buffer), bufferSize_(bufferSize), buffered_(0), config_(config),
+      progress_(NULL), progressCtx_(NULL) {
+    memset(&stats_, 0, sizeof(stats_));
+    digestHex_[0] = '\0';
+}
+
+bool OtaDownloader::sinkThunk(const uint8_t* data, size_t len, void* ctx) {
+    return static_cast<OtaDownloader*>(ctx)->onData(data, len);
+}
+
+bool OtaDownloader::flush() {
+    if (buffered_ == 0) return true;
+    if (!writer_.write(buffer_, buffered_)) {
+        error_ = OTA_ERR_WRITE;
+        return false;
+    }
+    buffered_ = 0;
+    return true;
+}
+
+void OtaDownloader::reportProgress(bool force) {
+    uint32_t now = config_.nowMs();
+    stats_.elapsedMs = now - startMs_;
+    if (!progress_) return;
+    if (!force && now - lastProgressMs_ < config_.progressIntervalMs) return;
+    lastProgressMs_ = now;
+    progress_(stats_, progressCtx_);
+}
+
+bool OtaDownloader::onData(const uint8_t* data, size_t len) {
+    if (resp_.status != 200 && resp_.status != 206) return true; // error page, not firmware
+    uint32_t now = config_.nowMs();
+    if (firstChunk_) {
+        firstChunk_ = false;
+        uint32_t total;
+        if (resp_.status == 206) {
+            if (resp_.rangeStart != stats_.bytes) {
+                error_ = OTA_ERR_HTTP;
+                return false;
+            }
+            total = resp_.rangeTotal;
+            skip_ = 0;
+        } else {
+            // Full body: either the first attempt or a server that ignores Range.
+            total = resp_.contentLength > 0 ? (uint32_t)resp_.contentLength : 0;
+            skip_ = stats_.bytes;
+        }
+        if (!begun_) {
+            if (!writer_.begin(total)) {
+                error_ = OTA_ERR_WRITE;
+                return false;
+            }
+            begun_ = true;
+            stats_.total = total;
+        } else if (total && stats_.total && total != stats_.total) {
+            error_ = OTA_ERR_SIZE;
+            return false;
+        }
+    }
+
+    if (now - lastDataMs_ > config_.stallThresholdMs) stats_.stallMs += now - lastDataMs_;
+    lastDataMs_ = now;
+
+    if (skip_) {
+        size_t n = skip_ < len ? skip_ : len;
+        skip_ -= (uint32_t)n;
+        data += n;
+        len -= n;
+    }
+    if (stats_.total && stats_.bytes + len > stats_.total) {
+        error_ = OTA_ERR_SIZE;
+        return false;
+    }
+    sha_.update(data, len);
+    stats_.bytes += (uint32_t)len;
+    while (len) {
+        size_t take = bufferSize_ - buffered_ < len ? bufferSize_ - buffered_ : len;
+        memcpy(buffer_ + buffered_, data, take);
+        buffered_ += take;
+        data += take;
+        len -= take;
+        if (buffered_ == bufferSize_ && !flush()) return false;
+    }
+    reportProgress(false);
+    return true;
+}
+
+int OtaDownloader::run(const char* url, const char* headers, const char* expectedSha256) {
+    memset(&stats_, 0, sizeof(stats_));
+    sha_.reset();
+    buffered_ = 0;
+    begun_ = false;
+    digestHex_[0] = '\0';
+    startMs_ = lastDataMs_ = lastProgressMs_ = config_.nowMs();
+
+    uint32_t delayMs = config_.retryDelayMs;
+    bool complete = false;
+    int result = OTA_ERR_NETWORK;
+    while (stats_.attempts < config_.maxAttempts) {
+        stats_.attempts++;
+        char reqHeaders[OTA_HEADER_BUF];
+        if (stats_.bytes > 0) {
+            stats_.resumes++;
+            snprintf(reqHeaders, sizeof(reqHeaders), "%sRange: bytes=%lu-\r\n", headers ? headers : "",
+                     (unsigned long)stats_.bytes);
+        } else {
+            snprintf(reqHeaders, sizeof(reqHeaders), "%s", headers ? headers : "");
+        }
+        firstChunk_ = true;
+        error_ = OTA_OK;
+        int code = pool_.request("GET", url, reqHeaders, NULL, 0, &resp_, sinkThunk, this);
+        stats_.lastHttpCode = code;
+
+        if (error_ != OTA_OK) {
+            result = error_;
+            break;
+        }
+        if (code == 200 || code == 206) {
+            complete = stats_.total ? stats_.bytes == stats_.total : true;
+            if (complete) break;
+        } else if (code > 0 && code != 408 && code != 429 && code < 500) {
+            result = OTA_ERR_HTTP;
+            break;
+        }
+        // Connection dropped or server hiccup: pick up where we stopped.
+        if (stats_.attempts < config_.maxAttempts && config_.sleepMs) {
+            config_.sleepMs(delayMs);
+            delayMs *= 2;
+        }
+    }
+
+    uint8_t digest[SHA256_DIGEST_LEN];
+    sha_.finish(digest);
+    sha256ToHex(digest, digestHex_);
+    if (complete && !flush()) {
+        result = OTA_ERR_WRITE;
+        complete = false;
+    }
+    if (complete && expectedSha256 && !sha256MatchesHex(digest, expectedSha256)) {
+        result = OTA_ERR_DIGEST;
+        complete = false;
+    }
+    if (complete) {
+        result = writer_.commit() ? OTA_OK : OTA_ERR_COMMIT;
+    }
+    if (result != OTA_OK && begun_) writer_.abort();
+    reportProgress(true);
+    return result;
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "flash_writer.h"
+#include "http_session_pool.h"
+#include "sha256.h"
+
+enum OtaResult {
+    OTA_OK = 0,
+    OTA_ERR_HTTP = -1,       // server refused the download
+    OTA_ERR_NETWORK = -2,    // ran out of attempts on connection errors
+    OTA_ERR_WRITE = -3,      // flash writer rejected the data
+    OTA_ERR_DIGEST = -4,     // SHA-256 mismatch, image discarded
+    OTA_ERR_SIZE = -5,       // image size changed between attempts
+    OTA_ERR_COMMIT = -6      // image could not be made bootable
+};
+
+struct OtaConfig {
+    uint8_t maxAttempts;        // connections used for one image, resumes included
+    uint32_t retryDelayMs;      // pause before resuming, doubled per attempt
+    uint32_t stallThresholdMs;  // gaps between chunks longer than this count as stall
+    uint32_t progressIntervalMs;
+    uint32_t (*nowMs)();
+    void (*sleepMs)(uint32_t);
+};
+
+OtaConfig defaultOtaConfig(uint32_t (*nowMs)(), void (*sleepMs)(uint32_t));
+
+struct OtaStats {
+    uint32_t bytes;        // image bytes received and hashed
+    uint32_t total;        // image size, 0 if the server never said
+    uint32_t elapsedMs;
+    uint32_t stallMs;      // time without data: slow chunks plus reconnects
+    uint8_t attempts;
+    uint8_t resumes;       // attempts that continued with a Range request
+    int lastHttpCode;
+
+    // Throughput over the whole transfer, stalls included.
+    uint32_t bytesPerSec() const { return elapsedMs ? (uint32_t)((uint64_t)bytes * 1000 / elapsedMs) : 0; }
+};
+
+typedef void (*OtaProgressFn)(const OtaStats& stats, void* ctx);
+
+// Streams a firmware image into a FlashWriter through the shared HTTP pool.
+// Dropped connections resume with an HTTP Range request where they stopped;
+// the image is hashed on the fly and only committed if the SHA-256 matches.
+class OtaDownloader {
+public:
+    // buffer collects data so the writer sees bufferSize-sized writes
+    // (a multiple of the 4 KB flash sector works best on the ESP32).
+    OtaDownloader(HttpSessionPool& pool, FlashWriter& writer, uint8_t* buffer, size_t bufferSize,
+                  const OtaConfig& config);
+
+    void onProgress(OtaProgressFn fn, void* ctx) {
+        progress_ = fn;
+        progressCtx_ = ctx;
+    }
+
+    // headers: extra request headers or NULL. expectedSha256: 64 hex chars, or
+    // NULL to skip verification. Returns OTA_OK or an OtaResult error.
+    int run(const char* url, const char* headers, const char* expectedSha256);
+
+    const OtaStats& stats() const { return stats_; }
+    // Hex digest of the received image, valid after run().
+    const char* digestHex() const { return digestHex_; }
+
+private:
+    static bool sinkThunk(const uint8_t* data, size_t len, void* ctx);
+    bool onData(const uint8_t* data, size_t len);
+    bool flush();
+    void reportProgress(bool force);
+
+    HttpSessionPool& pool_;
+    FlashWriter& writer_;
+    uint8_t* buffer_;
+    size_t bufferSize_;
+    size_t buffered_;
+    OtaConfig config_;
+    OtaProgressFn progress_;
+    void* progressCtx_;
+
+    Sha256 sha_;
+    OtaStats stats_;
+    HttpResponse resp_;
+    bool firstChunk_;
+    bool begun_;
+    int error_;
+    uint32_t skip_;
+    uint32_t startMs_;
+    uint32_t lastDataMs_;
+    uint32_t lastProgressMs_;
+    char digestHex_[SHA256_DIGEST_LEN * 2 + 1];
+};
@@ -0,0 +1,185 @@
+#include "peer_cache.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ota_downloader.h"
+
+static bool copyField(char* dst, size_t cap, const char* value) {
+    size_t n = strlen(value);
+    if (n == 0 || n >= cap) return false;
+    memcpy(dst, value, n + 1);
+    return true;
+}
+
+static bool isHexDigest(const char* s) {
+    for (size_t i = 0; i < 2 * SHA256_DIGEST_LEN; i++) {
+        if (!isxdigit((unsigned char)s[i])) return false;
+    }
+    return s[2 * SHA256_DIGEST_LEN] == '\0';
+}
+
+static bool sameDigest(const char* a, const char* b) {
+    for (size_t i = 0; i < 2 * SHA256_DIGEST_LEN; i++) {
+        if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) return false;
+    }
+    return true;
+}
+
+bool peerTxtField(const char* key, const char* value, PeerImage& image) {
+    if (strcmp(key, "v") == 0) return copyField(image.version, sizeof(image.version), value);
+    if (strcmp(key, "sha") == 0) return isHexDigest(value) && copyField(image.sha256, sizeof(image.sha256), value);
+    if (strcmp(key, "size") == 0) {
+        char* end;
+        unsigned long size = strtoul(value, &end, 10);
+        if (end == value || *end || size == 0 || size > 0xFFFFFFFFUL) return false;
+        image.size = (uint32_t)size;
+        return true;
+    }
+    return false;
+}
+
+bool peerImageValid(const PeerImage& image) {
+    return image.version[0] && isHexDigest(image.sha256) && image.size > 0;
+}
+
+size_t peerImageUrl(const PeerInfo& peer, char* out, size_t cap) {
+    int n = snprintf(out, cap, "http://%s:%u" PEER_PATH_PREFIX "%s", peer.host, (unsigned)peer.port,
+                     peer.image.sha256);
+    return n > 0 && (size_t)n < cap ? (size_t)n : 0;
+}
+
+bool peerImageMatches(SourceImage& source, const PeerImage& image, uint8_t* buf, size_t bufSize) {
+    if (!peerImageValid(image) || bufSize == 0) return false;
+    Sha256 sha;
+    for (uint32_t offset = 0; offset < image.size;) {
+        size_t n = image.size - offset < bufSize ? image.size - offset : bufSize;
+        if (!source.read(offset, buf, n)) return false;
+        sha.update(buf, n);
+        offset += (uint32_t)n;
+    }
+    uint8_t digest[SHA256_DIGEST_LEN];
+    sha.finish(digest);
+    return sha256MatchesHex(digest, image.sha256);
+}
+
+// --- serving ---
+
+PeerServeResult peerServe(const PeerImage& image, const char* path, const char* range) {
+    PeerServeResult r = {404, 0, 0};
+    size_t prefix = strlen(PEER_PATH_PREFIX);
+    if (!peerImageValid(image) || strncmp(path, PEER_PATH_PREFIX, prefix) != 0) return r;
+    path += prefix;
+    if (!isHexDigest(path) || !sameDigest(path, image.sha256)) return r;
+
+    uint32_t last = image.size - 1;
+    r.status = 200;
+    r.length = image.size;
+    // Anything but a single "bytes=N-[M]" range is ignored and the whole image sent
+    if (!range || strncmp(range, "bytes=", 6) != 0 || !isdigit((unsigned char)range[6])) return r;
+    char* end;
+    unsigned long from = strtoul(range + 6, &end, 10);
+    if (*end != '-') return r;
+    unsigned long to = last;
+    if (isdigit((unsigned char)end[1])) {
+        to = strtoul(end + 1, &end, 10);
+    } else {
+        end++;
+    }
+    if (*end) return r;
+    if (from > last || to < from) {
+        r.status = 416;
+        r.length = 0;
+        return r;
+    }
+    if (to > last) to = last;
+    r.status = 206;
+    r.start = (uint32_t)from;
+    r.length = (uint32_t)(to - from + 1);
+    return r;
+}
+
+size_t peerContentRange(const PeerServeResult& result, const PeerImage& image, char* out, size_t cap) {
+    int n = snprintf(out, cap, "bytes %lu-%lu/%lu", (unsigned long)result.start,
+                     (unsigned long)(result.start + result.length - 1), (unsigned long)image.size);
+    return n > 0 && (size_t)n < cap ? (size_t)n : 0;
+}
+
+// --- discovery and fetch ---
+
+PeerDirectory::PeerDirectory(PeerDiscovery& discovery, uint32_t (*nowMs)(), uint32_t (*random)(uint32_t),
+                             uint32_t backoffMs)
+    : discovery_(discovery), nowMs_(nowMs), random_(random), backoffMs_(backoffMs), count_(0) {}
+
+bool PeerDirectory::backingOff(const Entry& e, uint32_t now) const {
+    return e.failed && now - e.failedAtMs < backoffMs_;
+}
+
+static bool samePeer(const PeerInfo& a, const PeerInfo& b) {
+    return a.port == b.port && strcmp(a.host, b.host) == 0 && sameDigest(a.image.sha256, b.image.sha256);
+}
+
+size_t PeerDirectory::refresh() {
+    PeerInfo found[PEER_MAX];
+    size_t n = discovery_.query(found, PEER_MAX);
+    if (n > PEER_MAX) n = PEER_MAX;
+    Entry next[PEER_MAX];
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!found[i].host[0] || !found[i].port || !peerImageValid(found[i].image)) continue;
+        Entry& e = next[count++];
+        e.info = found[i];
+        e.failed = false;
+        e.failedAtMs = 0;
+        for (size_t j = 0; j < count_; j++) {
+            if (samePeer(entries_[j].info, e.info)) {
+                e.failed = entries_[j].failed;
+                e.failedAtMs = entries_[j].failedAtMs;
+            }
+        }
+    }
+    memcpy(entries_, next, count * sizeof(Entry));
+    count_ = count;
+    return count_;
+}
+
+bool PeerDirectory::choose(const char* sha256, PeerInfo& out) {
+    if (count_ == 0 || !sha256 || !isHexDigest(sha256)) return false;
+    uint32_t now = nowMs_();
+    size_t start = random_ ? random_((uint32_t)count_) % count_ : 0;
+    for (size_t k = 0; k < count_; k++) {
+        const Entry& e = entries_[(start + k) % count_];
+        if (backingOff(e, now) || !sameDigest(e.info.image.sha256, sha256)) continue;
+        out = e.info;
+        return true;
+    }
+    return false;
+}
+
+void PeerDirectory::reportFailure(const PeerInfo& peer) {
+    for (size_t i = 0; i < count_; i++) {
+        if (!samePeer(entries_[i].info, peer)) continue;
+        entries_[i].failed = true;
+        entries_[i].failedAtMs = nowMs_();
+    }
+}
+
+int fetchFromPeers(PeerDirectory& peers, const char* sha256, uint8_t maxPeers, PeerFetchFn fetch, void* ctx,
+                   PeerInfo* used) {
+    int result = OTA_ERR_NETWORK;
+    PeerInfo peer;
+    for (uint8_t tried = 0; tried < maxPeers && peers.choose(sha256, peer); tried++) {
+        char url[PEER_URL_MAX];
+        if (!peerImageUrl(peer, url, sizeof(url))) {
+            peers.reportFailure(peer);
+            continue;
+        }
+        result = fetch(url, sha256, ctx);
+        if (result == OTA_OK) {
+            if (used) *used = peer;
+            return OTA_OK;
+        }
+        peers.reportFailure(peer);
+    }
+    return result;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "delta_patch.h"
+#include "http_session_pool.h"
+#include "sha256.h"
+
+// LAN peer firmware cache. A device whose running image is verified serves
+// it over plain HTTP on the LAN and advertises it (mDNS service _edgefw._tcp,
+// TXT v=<version> sha=<sha256> size=<bytes>); a device installing an offer
+// fetches the image from such a peer first and falls back to the server.
+// Peers are never trusted: only offers with a sha256 are fetched from them,
+// the digest is checked as the image streams in, and a peer that fails is
+// skipped for a while.
+#define PEER_SERVICE "edgefw"
+#define PEER_PATH_PREFIX "/fw/"
+#define PEER_MAX 8
+#define PEER_BACKOFF_MS 600000 // a failed peer is skipped for 10 minutes
+#define PEER_URL_MAX (sizeof("http://:65535" PEER_PATH_PREFIX) + HTTP_POOL_HOST_LEN + 2 * SHA256_DIGEST_LEN)
+
+// The image a peer serves
+struct PeerImage {
+    char version[32];
+    char sha256[2 * SHA256_DIGEST_LEN + 1];
+    uint32_t size;
+};
+
+struct PeerInfo {
+    char host[HTTP_POOL_HOST_LEN]; // dotted IPv4 address
+    uint16_t port;
+    PeerImage image;
+};
+
+// Takes one TXT entry of an advertisement (v, sha or size); false for an
+// unknown key or a value that does not fit.
+bool peerTxtField(const char* key, const char* value, PeerImage& image);
+// Version set, 64 hex digits of sha256, size above 0.
+bool peerImageValid(const PeerImage& image);
+// http://host:port/fw/<sha256>; returns the length, 0 if cap is too small.
+size_t peerImageUrl(const PeerInfo& peer, char* out, size_t cap);
+
+// Hashes the first image.size bytes of source and compares them with
+// image.sha256; buf is scratch space for the reads.
+bool peerImageMatches(SourceImage& source, const PeerImage& image, uint8_t* buf, size_t bufSize);
+
+// --- serving ---
+
+struct PeerServeResult {
+    int status;      // 200, 206, 404 (another image), 416 (range past the end)
+    uint32_t start;  // first image byte to send
+    uint32_t length; // bytes to send
+};
+
+// Answers GET path with an optional "Range: bytes=N-" or "bytes=N-M" value
+// (NULL when absent) for the image a device serves.
+PeerServeResult peerServe(const PeerImage& image, const char* path, const char* range);
+// "bytes start-end/size" for a 206 answer; returns the length.
+size_t peerContentRange(const PeerServeResult& result, const PeerImage& image, char* out, size_t cap);
+
+// --- discovery and fetch ---
+
+// Finds peers on the LAN: mDNS on the ESP32 (esp_peer_cache.h), a fixed
+// list of stand-in peers in tests.
+class PeerDiscovery {
+public:
+    virtual ~PeerDiscovery() {}
+    // Fills up to max peers that answered; returns how many.
+    virtual size_t query(PeerInfo* out, size_t max) = 0;
+};
+
+// The peers last discovered, with the ones that failed recently held back.
+// Not thread safe: the task that installs updates owns it.
+class PeerDirectory {
+public:
+    // random(bound) returns a value below bound; it picks where the search
+    // for a peer starts, so devices updating together spread over the peers.
+    PeerDirectory(PeerDiscovery& discovery, uint32_t (*nowMs)(), uint32_t (*random)(uint32_t),
+                  uint32_t backoffMs = PEER_BACKOFF_MS);
+
+    // Queries discovery again; peers still in backoff stay there. Returns
+    // the number of valid peers.
+    size_t refresh();
+    // A peer serving the image with this sha256 and not in backoff.
+    bool choose(const char* sha256, PeerInfo& out);
+    void reportFailure(const PeerInfo& peer);
+
+    size_t size() const { return count_; }
+
+private:
+    struct Entry {
+        PeerInfo info;
+        bool failed;
+        uint32_t failedAtMs;
+    };
+
+    bool backingOff(const Entry& e, uint32_t now) const;
+
+    PeerDiscovery& discovery_;
+    uint32_t (*nowMs_)();
+    uint32_t (*random_)(uint32_t);
+    uint32_t backoffMs_;
+    Entry entries_[PEER_MAX];
+    size_t count_;
+};
+
+// Downloads the image from url into the inactive partition (or a test
+// buffer), checking sha256; returns OTA_OK or an OtaResult error.
+typedef int (*PeerFetchFn)(const char* url, const char* sha256, void* ctx);
+
+// Tries up to maxPeers peers serving sha256, each failure putting that peer
+// into backoff. Returns OTA_OK with *used set to the peer, the last error,
+// or OTA_ERR_NETWORK when no peer serves the image.
+int fetchFromPeers(PeerDirectory& peers, const char* sha256, uint8_t maxPeers, PeerFetchFn fetch, void* ctx,
+                   PeerInfo* used);
@@ -0,0 +1,27 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_LEN 32
+
+// Incremental SHA-256, fed as the image streams in.
+class Sha256 {
+public:
+    Sha256() { reset(); }
+    void reset();
+    void update(const uint8_t* data, size_t len);
+    void finish(uint8_t digest[SHA256_DIGEST_LEN]);
+
+private:
+    void block(const uint8_t* p);
+
+    uint32_t state_[8];
+    uint64_t bits_;
+    uint8_t buf_[64];
+    size_t used_;
+};
+
+// Lower-case hex, out must hold 2 * SHA256_DIGEST_LEN + 1 chars.
+void sha256ToHex(const uint8_t digest[SHA256_DIGEST_LEN], char* out);
+// Case-insensitive comparison against a 64-character hex string.
+bool sha256MatchesHex(const uint8_t digest[SHA256_DIGEST_LEN], const char* hex);
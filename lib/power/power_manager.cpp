@@ -0,0 +1,168 @@
+#include "power_manager.h"
+#include <string.h>
+
+static const char* const modeNames[POWER_MODES] = {"awake", "modem_sleep", "light_sleep", "deep_sleep"};
+static const char* const profileNames[POWER_PROFILES] = {"normal", "saver", "critical"};
+
+// Wrap-safe "a is at or before b" for millisecond timestamps.
+static inline bool reached(uint32_t a, uint32_t b) {
+    return (int32_t)(b - a) >= 0;
+}
+
+const char* powerModeName(PowerMode mode) {
+    return (unsigned)mode < POWER_MODES ? modeNames[mode] : "unknown";
+}
+
+const char* powerProfileName(PowerProfile profile) {
+    return (unsigned)profile < POWER_PROFILES ? profileNames[profile] : "unknown";
+}
+
+uint32_t powerRadioMsPerReport(const PowerStats& stats) {
+    if (stats.reports == 0) return 0;
+    return (uint32_t)((stats.modeMs[POWER_AWAKE] + stats.modeMs[POWER_MODEM_SLEEP]) / stats.reports);
+}
+
+uint32_t powerAverageMicroamps(const PowerStats& stats, const PowerCurrents& currents) {
+    uint64_t total = 0;
+    uint64_t charge = 0; // µA·ms
+    for (int i = 0; i < POWER_MODES; i++) {
+        total += stats.modeMs[i];
+        charge += stats.modeMs[i] * currents.uA[i];
+    }
+    return total ? (uint32_t)(charge / total) : 0;
+}
+
+int batteryPercent(uint32_t mv, uint32_t emptyMv, uint32_t fullMv) {
+    if (mv <= emptyMv || fullMv <= emptyMv) return 0;
+    if (mv >= fullMv) return 100;
+    return (int)((mv - emptyMv) * 100 / (fullMv - emptyMv));
+}
+
+static PowerProfile classify(int percent, const PowerConfig& config) {
+    if (percent < config.criticalBelowPercent) return POWER_CRITICAL;
+    if (percent < config.saverBelowPercent) return POWER_SAVER;
+    return POWER_NORMAL;
+}
+
+PowerManager::PowerManager(const PowerConfig& config, uint32_t (*nowMs)())
+    : config_(config), nowMs_(nowMs), profile_(POWER_NORMAL), mode_(POWER_AWAKE), lastMs_(0), windowStartMs_(0),
+      onlineAtMs_(0), backlog_(0), windowOpen_(false), firstWindow_(true), online_(false), busy_(false),
+      urgent_(false) {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+void PowerManager::setBattery(int percent) {
+    PowerProfile target = POWER_NORMAL;
+    if (percent >= 0) {
+        // Worse levels apply at once; better ones only past the hysteresis
+        target = classify(percent, config_);
+        if (target < profile_) {
+            PowerProfile up = classify(percent - config_.hysteresisPercent, config_);
+            target = up < profile_ ? up : profile_;
+        }
+    }
+    if (target == profile_) return;
+    account(nowMs_());
+    profile_ = target;
+    stats_.profileChanges++;
+}
+
+void PowerManager::setOnline(bool online) {
+    if (online && !online_) onlineAtMs_ = nowMs_();
+    online_ = online;
+}
+
+uint32_t PowerManager::uplinkIntervalMs() const {
+    uint32_t interval = config_.profiles[profile_].uplinkIntervalMs;
+    // Drain a backlog at the normal rate, unless the battery cannot afford it
+    if (config_.backlogHigh && backlog_ >= config_.backlogHigh && profile_ != POWER_CRITICAL) {
+        uint32_t normal = config_.profiles[POWER_NORMAL].uplinkIntervalMs;
+        if (normal < interval) interval = normal;
+    }
+    return interval;
+}
+
+uint32_t PowerManager::msUntilWindow() const {
+    uint32_t interval = uplinkIntervalMs();
+    if (windowOpen_ || firstWindow_ || interval == 0) return 0;
+    uint32_t next = windowStartMs_ + interval;
+    uint32_t now = nowMs_();
+    return reached(next, now) ? 0 : next - now;
+}
+
+void PowerManager::account(uint32_t now) {
+    stats_.modeMs[mode_] += now - lastMs_;
+    lastMs_ = now;
+}
+
+void PowerManager::openWindow(uint32_t now) {
+    windowOpen_ = true;
+    firstWindow_ = false;
+    urgent_ = false;
+    windowStartMs_ = now;
+    onlineAtMs_ = now;
+    stats_.windows++;
+}
+
+PowerPlan PowerManager::plan(uint32_t msUntilRadio, uint32_t msUntilSample) {
+    uint32_t now = nowMs_();
+    account(now);
+    PowerPlan plan = {POWER_MODEM_SLEEP, 0};
+    uint32_t interval = uplinkIntervalMs();
+
+    if (busy_) {
+        plan.mode = POWER_AWAKE;
+    } else if (interval == 0) {
+        windowOpen_ = false; // always associated, so there are no windows
+    } else {
+        if (!windowOpen_ && (urgent_ || msUntilWindow() == 0)) openWindow(now);
+        if (windowOpen_) {
+            // A window that outlives the interval becomes the next one
+            if (reached(windowStartMs_ + interval, now)) openWindow(now);
+            bool done = online_ ? now - onlineAtMs_ >= config_.windowMinMs && msUntilRadio > 0
+                                : now - windowStartMs_ >= config_.windowMaxMs;
+            uint32_t gap = windowStartMs_ + interval - now;
+            // Reassociating costs more than dozing through a short gap
+            if (done && gap >= config_.radioOffMinMs) windowOpen_ = false;
+        }
+        if (!windowOpen_) {
+            uint32_t gap = msUntilWindow();
+            if (msUntilSample < gap) gap = msUntilSample;
+            if (config_.profiles[profile_].deepSleep && gap >= config_.deepSleepMinMs) {
+                plan.mode = POWER_DEEP_SLEEP;
+                plan.sleepMs = gap - config_.wakeLeadMs;
+            } else {
+                plan.mode = POWER_LIGHT_SLEEP;
+                plan.sleepMs = gap;
+            }
+        }
+    }
+    mode_ = plan.mode;
+    return plan;
+}
+
+PowerSnapshot PowerManager::save(uint32_t sleepMs) {
+    account(nowMs_());
+    stats_.deepSleeps++;
+    PowerSnapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.profile = (uint8_t)profile_;
+    snapshot.msUntilWindow = msUntilWindow();
+    snapshot.sleepMs = sleepMs;
+    snapshot.stats = stats_;
+    return snapshot;
+}
+
+void PowerManager::restore(const PowerSnapshot& snapshot) {
+    uint32_t now = nowMs_();
+    stats_ = snapshot.stats;
+    stats_.modeMs[POWER_DEEP_SLEEP] += snapshot.sleepMs;
+    stats_.modeMs[POWER_AWAKE] += now; // booting since the wake
+    lastMs_ = now;
+    mode_ = POWER_AWAKE;
+    profile_ = snapshot.profile < POWER_PROFILES ? (PowerProfile)snapshot.profile : POWER_NORMAL;
+    uint32_t left = snapshot.msUntilWindow > snapshot.sleepMs ? snapshot.msUntilWindow - snapshot.sleepMs : 0;
+    windowStartMs_ = now + left - uplinkIntervalMs();
+    windowOpen_ = false;
+    firstWindow_ = false;
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// How deeply the device may sleep until the next plan().
+enum PowerMode {
+    POWER_AWAKE = 0,    // radio at full power, no CPU sleep (OTA, health gate)
+    POWER_MODEM_SLEEP,  // associated; the radio dozes between beacons
+    POWER_LIGHT_SLEEP,  // radio off; the CPU light-sleeps between samples
+    POWER_DEEP_SLEEP    // everything off; state survives in RTC memory
+};
+#define POWER_MODES 4
+
+// Duty cycle chosen from the battery level.
+enum PowerProfile {
+    POWER_NORMAL = 0,
+    POWER_SAVER,
+    POWER_CRITICAL
+};
+#define POWER_PROFILES 3
+
+const char* powerModeName(PowerMode mode);
+const char* powerProfileName(PowerProfile profile);
+
+struct PowerProfileSpec {
+    uint32_t sampleIntervalMs;
+    uint32_t uplinkIntervalMs; // one radio window per interval; 0 keeps the radio associated
+    bool deepSleep;            // long gaps between samples use deep sleep
+};
+
+struct PowerConfig {
+    PowerProfileSpec profiles[POWER_PROFILES];
+    uint8_t saverBelowPercent;
+    uint8_t criticalBelowPercent;
+    uint8_t hysteresisPercent; // a profile is left only this far above its threshold
+    uint32_t backlogHigh;      // samples waiting; above it uplinks run at the normal interval
+    uint32_t windowMinMs;      // a window stays open this long once online, for queued commands
+    uint32_t windowMaxMs;      // a window that cannot get online gives up after this long
+    uint32_t radioOffMinMs;    // shorter gaps keep the radio associated in modem sleep
+    uint32_t deepSleepMinMs;   // shorter gaps use light sleep
+    uint32_t wakeLeadMs;       // deep sleep ends this early to boot before the deadline
+};
+
+struct PowerPlan {
+    PowerMode mode;
+    uint32_t sleepMs; // light/deep sleep: how long until the next sample or window
+};
+
+struct PowerStats {
+    uint64_t modeMs[POWER_MODES]; // time spent in each mode; survives deep sleep, so 64 bits
+    uint32_t windows;             // radio windows opened
+    uint32_t reports;             // uplinks delivered
+    uint32_t deepSleeps;
+    uint32_t profileChanges;
+};
+
+// Average draw in each mode, µA, for the power budget.
+struct PowerCurrents {
+    uint32_t uA[POWER_MODES];
+};
+
+// Radio-on time (awake or modem sleep) per delivered report, in ms.
+uint32_t powerRadioMsPerReport(const PowerStats& stats);
+// Average current over everything in stats, in µA.
+uint32_t powerAverageMicroamps(const PowerStats& stats, const PowerCurrents& currents);
+
+// Linear charge estimate from the cell voltage, clamped to 0..100.
+int batteryPercent(uint32_t mv, uint32_t emptyMv, uint32_t fullMv);
+
+// What PowerManager keeps across deep sleep; times are relative because
+// the millisecond clock restarts on every boot.
+struct PowerSnapshot {
+    uint8_t profile;
+    uint32_t msUntilWindow;
+    uint32_t sleepMs;
+    PowerStats stats;
+};
+
+// Duty cycling policy for the network task. Between radio windows, which
+// open once per uplink interval, the radio is off and the CPU sleeps; work
+// that needs the network waits for the next window unless it is urgent.
+// The battery level picks the profile and a large backlog shortens the
+// uplink interval until it drains. Not thread safe; used by the network
+// task only.
+class PowerManager {
+public:
+    PowerManager(const PowerConfig& config, uint32_t (*nowMs)());
+
+    // Battery charge in percent; a negative value (unknown, mains) keeps POWER_NORMAL.
+    void setBattery(int percent);
+    void setBacklog(uint32_t samples) { backlog_ = samples; }
+    // OTA or health gate running: the radio stays up at full power.
+    void setBusy(bool busy) { busy_ = busy; }
+    void setOnline(bool online);
+    // Opens a window at the next plan(), e.g. for an alarm.
+    void requestWindow() { urgent_ = true; }
+    void reportSent() { stats_.reports++; }
+
+    // Decides the mode until the next call. msUntilRadio is the time to the
+    // next job that needs the network, msUntilSample to the next reading.
+    PowerPlan plan(uint32_t msUntilRadio, uint32_t msUntilSample);
+
+    // True while the link should be up.
+    bool radioWanted() const { return busy_ || windowOpen_ || uplinkIntervalMs() == 0; }
+    PowerProfile profile() const { return profile_; }
+    uint32_t sampleIntervalMs() const { return config_.profiles[profile_].sampleIntervalMs; }
+    uint32_t uplinkIntervalMs() const;
+    // ms until the next window opens, 0 if one is open or due.
+    uint32_t msUntilWindow() const;
+    const PowerStats& stats() const { return stats_; }
+
+    // Before deep sleep: accounts the time so far and returns what restore() needs.
+    PowerSnapshot save(uint32_t sleepMs);
+    // After a deep sleep wake; the sleep is counted in POWER_DEEP_SLEEP.
+    void restore(const PowerSnapshot& snapshot);
+
+private:
+    void account(uint32_t now);
+    void openWindow(uint32_t now);
+
+    PowerConfig config_;
+    uint32_t (*nowMs_)();
+    PowerProfile profile_;
+    PowerMode mode_;
+    uint32_t lastMs_;        // last accounting point
+    uint32_t windowStartMs_; // the next window opens one uplink interval later
+    uint32_t onlineAtMs_;
+    uint32_t backlog_;
+    bool windowOpen_;
+    bool firstWindow_;       // the first window opens at once
+    bool online_;
+    bool busy_;
+    bool urgent_;
+    PowerStats stats_;
+};
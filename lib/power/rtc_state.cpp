@@ -0,0 +1,35 @@
+#include "rtc_state.h"
+#include <string.h>
+
+// FNV-1a over everything but the checksum itself
+static uint32_t rtcChecksum(const RtcState& state) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&state);
+    size_t len = offsetof(RtcState, checksum);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void rtcStateClear(RtcState& state) {
+    memset(&state, 0, sizeof(state));
+    state.magic = RTC_STATE_MAGIC;
+    rtcStateSeal(state);
+}
+
+void rtcStateSeal(RtcState& state) {
+    state.checksum = rtcChecksum(state);
+}
+
+bool rtcStateValid(const RtcState& state) {
+    return state.magic == RTC_STATE_MAGIC && state.sampleCount <= RTC_SAMPLE_CAPACITY &&
+           state.checksum == rtcChecksum(state);
+}
+
+bool rtcPushSample(RtcState& state, const SensorSample& sample) {
+    if (state.sampleCount >= RTC_SAMPLE_CAPACITY) return false;
+    state.samples[state.sampleCount++] = sample;
+    return true;
+}
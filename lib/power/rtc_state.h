@@ -0,0 +1,32 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "link_manager.h"
+#include "power_manager.h"
+#include "sensor_sample.h"
+
+#define RTC_STATE_MAGIC 0x52544331 // "RTC1"
+#define RTC_SAMPLE_CAPACITY 48     // 576 bytes of the 8 KB RTC slow memory
+
+// What survives a deep sleep: readings taken while the radio was off, the
+// link cache (so the next window skips NVS, scan and DHCP) and the power
+// manager's state. On the ESP32 it lives in RTC slow memory (RTC_DATA_ATTR),
+// which holds garbage after a power cycle; the checksum tells the two apart.
+struct RtcState {
+    uint32_t magic;
+    uint32_t wakes;          // deep sleep wakes since the last full boot
+    PowerSnapshot power;
+    bool linkValid;
+    LinkCache link;
+    uint16_t sampleCount;
+    SensorSample samples[RTC_SAMPLE_CAPACITY];
+    uint32_t checksum;
+};
+
+// Empties and seals the state.
+void rtcStateClear(RtcState& state);
+// Call after every change, before the next sleep.
+void rtcStateSeal(RtcState& state);
+bool rtcStateValid(const RtcState& state);
+// False once RTC_SAMPLE_CAPACITY readings are waiting.
+bool rtcPushSample(RtcState& state, const SensorSample& sample);
@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+
+// Exponential backoff shared by the scheduler and the API client.
+
+// baseMs doubled per failure after the first, capped at maxMs.
+inline uint32_t backoffCeilingMs(uint32_t baseMs, uint32_t maxMs, uint8_t failures) {
+    if (failures == 0) return 0;
+    uint8_t shift = failures - 1;
+    if (shift >= 31 || baseMs > (maxMs >> shift)) return maxMs;
+    return baseMs << shift;
+}
+
+// "Full jitter": a uniform draw from [0, ceiling]. Devices that failed
+// together spread over the whole window instead of retrying in lockstep.
+// Without randomMs the ceiling itself is returned, which keeps tests exact.
+inline uint32_t fullJitterBackoffMs(uint32_t baseMs, uint32_t maxMs, uint8_t failures,
+                                    uint32_t (*randomMs)(uint32_t bound)) {
+    uint32_t ceiling = backoffCeilingMs(baseMs, maxMs, failures);
+    if (!randomMs || ceiling == 0) return ceiling;
+    return randomMs(ceiling == UINT32_MAX ? ceiling : ceiling + 1);
+}
@@ -0,0 +1,154 @@
+#include "net_scheduler.h"
+#include <string.h>
+#include "backoff.h"
+
+// Wrap-safe "a is at or before b" for millisecond timestamps.
+static inline bool reached(uint32_t a, uint32_t b) {
+    return (int32_t)(b - a) >= 0;
+}
+
+NetScheduler::NetScheduler(uint32_t (*nowMs)(), uint32_t (*randomMs)(uint32_t), uint32_t coalesceMs)
+    : nowMs_(nowMs), randomMs_(randomMs), coalesceMs_(coalesceMs), radio_(true), running_(-1), count_(0) {
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+int NetScheduler::add(const JobSpec& spec, uint32_t firstDelayMs) {
+    if (count_ >= SCHED_MAX_JOBS || !spec.fn) return -1;
+    Job& job = jobs_[count_];
+    job.spec = spec;
+    memset(&job.stats, 0, sizeof(job.stats));
+    job.holdMs = 0;
+    job.armed = spec.periodMs > 0 || firstDelayMs > 0;
+    job.rearmed = false;
+    job.rearmDue = 0;
+    job.due = nowMs_() + firstDelayMs + jitter(spec.jitterMs);
+    return (int)count_++;
+}
+
+void NetScheduler::trigger(int id) {
+    triggerIn(id, 0);
+}
+
+void NetScheduler::triggerIn(int id, uint32_t delayMs) {
+    if (id < 0 || (size_t)id >= count_) return;
+    Job& job = jobs_[id];
+    uint32_t due = nowMs_() + delayMs;
+    if (id == running_) {
+        // job.due still holds the deadline of this run, which is in the past
+        if (!job.rearmed || !reached(job.rearmDue, due)) job.rearmDue = due;
+        job.rearmed = true;
+        return;
+    }
+    if (!job.armed || !reached(job.due, due)) job.due = due;
+    job.armed = true;
+}
+
+void NetScheduler::holdOff(int id, uint32_t delayMs) {
+    if (id < 0 || (size_t)id >= count_) return;
+    if (delayMs > jobs_[id].holdMs) jobs_[id].holdMs = delayMs;
+}
+
+void NetScheduler::reschedule(Job& job, JobResult result, uint32_t now) {
+    bool rearmed = job.rearmed;
+    job.rearmed = false;
+    if (result == JOB_RETRY) {
+        job.stats.retries++;
+        if (job.stats.failStreak < 31) job.stats.failStreak++;
+        uint32_t backoff = fullJitterBackoffMs(job.spec.retryBaseMs, job.spec.retryMaxMs, job.stats.failStreak,
+                                               randomMs_);
+        if (backoff < job.holdMs) backoff = job.holdMs;
+        job.holdMs = 0;
+        job.due = now + backoff;
+        return;
+    }
+    job.stats.failStreak = 0;
+    job.holdMs = 0;
+    if (job.spec.periodMs == 0) {
+        job.armed = rearmed;
+        if (rearmed) job.due = job.rearmDue;
+        return;
+    }
+    // Keep the cadence, but never schedule into the past after a long outage.
+    uint32_t next = job.due + job.spec.periodMs + jitter(job.spec.jitterMs);
+    if (reached(next, now)) next = now + job.spec.periodMs + jitter(job.spec.jitterMs);
+    if (rearmed && !reached(next, job.rearmDue)) next = job.rearmDue;
+    job.due = next;
+}
+
+uint32_t NetScheduler::runDue() {
+    uint32_t now = nowMs_();
+
+    // A radio wake happens once some radio job is past its slack.
+    bool radioWake = false;
+    for (size_t i = 0; i < count_; i++) {
+        const Job& job = jobs_[i];
+        if (job.armed && job.spec.needsRadio && radio_ && reached(job.due + job.spec.slackMs, now)) radioWake = true;
+    }
+
+    uint8_t order[SCHED_MAX_JOBS];
+    size_t n = 0;
+    for (size_t i = 0; i < count_; i++) {
+        const Job& job = jobs_[i];
+        if (!job.armed) continue;
+        bool run;
+        if (job.spec.needsRadio) {
+            run = radioWake && reached(job.due, now + coalesceMs_);
+            if (run && !reached(job.due, now)) stats_.coalesced++;
+        } else {
+            run = reached(job.due, now);
+        }
+        if (!run) continue;
+        // Insertion sort: priority descending, earlier deadline first.
+        size_t k = n++;
+        while (k > 0) {
+            const Job& prev = jobs_[order[k - 1]];
+            if (prev.spec.priority > job.spec.priority ||
+                (prev.spec.priority == job.spec.priority && reached(prev.due, job.due)))
+                break;
+            order[k] = order[k - 1];
+            k--;
+        }
+        order[k] = (uint8_t)i;
+    }
+
+    if (n > 0) {
+        stats_.wakes++;
+        if (radioWake) stats_.radioWakes++;
+    }
+    for (size_t k = 0; k < n; k++) {
+        Job& job = jobs_[order[k]];
+        running_ = order[k];
+        JobResult result = job.spec.fn(job.spec.ctx);
+        running_ = -1;
+        job.stats.runs++;
+        stats_.jobsRun++;
+        reschedule(job, result, nowMs_());
+    }
+    return msUntilNext();
+}
+
+uint32_t NetScheduler::msUntilNext() const {
+    uint32_t now = nowMs_();
+    uint32_t best = SCHED_IDLE_MS;
+    for (size_t i = 0; i < count_; i++) {
+        const Job& job = jobs_[i];
+        if (!job.armed || (job.spec.needsRadio && !radio_)) continue;
+        uint32_t deadline = job.due + (job.spec.needsRadio ? job.spec.slackMs : 0);
+        if (reached(deadline, now)) return 0;
+        if (deadline - now < best) best = deadline - now;
+    }
+    return best;
+}
+
+uint32_t NetScheduler::msUntilRadio() const {
+    uint32_t now = nowMs_();
+    uint32_t best = SCHED_IDLE_MS;
+    for (size_t i = 0; i < count_; i++) {
+        const Job& job = jobs_[i];
+        if (!job.armed || !job.spec.needsRadio) continue;
+        uint32_t deadline = job.due + job.spec.slackMs;
+        if (reached(deadline, now)) return 0;
+        if (deadline - now < best) best = deadline - now;
+    }
+    return best;
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#define SCHED_MAX_JOBS 12
+#define SCHED_IDLE_MS 60000 // longest sleep when nothing is scheduled
+
+enum JobResult {
+    JOB_DONE = 0,  // ran, wait a full period
+    JOB_RETRY = 1  // failed, try again after the backoff
+};
+
+typedef JobResult (*JobFn)(void* ctx);
+
+struct JobSpec {
+    const char* name;
+    JobFn fn;
+    void* ctx;
+    uint32_t periodMs;    // 0: runs only when triggered
+    uint32_t jitterMs;    // random extra delay added to every period
+    uint32_t slackMs;     // may run this much late to share a radio wake
+    uint8_t priority;     // higher runs first within a wake
+    bool needsRadio;      // held back while the network is down
+    uint32_t retryBaseMs; // backoff ceiling after the first failure, doubled per failed attempt
+    uint32_t retryMaxMs;  // the retry comes at a random point below the ceiling
+};
+
+struct JobStats {
+    uint32_t runs;
+    uint32_t retries;     // runs that returned JOB_RETRY
+    uint8_t failStreak;   // consecutive JOB_RETRY results
+};
+
+struct SchedStats {
+    uint32_t wakes;       // runDue() calls that ran at least one job
+    uint32_t radioWakes;  // wakes that used the network
+    uint32_t jobsRun;
+    uint32_t coalesced;   // radio jobs pulled forward into another job's wake
+};
+
+// Deadline scheduler for the network task. Jobs become due after their
+// period; when one radio job has to run, every radio job due within the
+// coalescing window runs in the same wake so the radio wakes up once.
+// Failed jobs retry with full-jitter exponential backoff instead of
+// blocking the task.
+// Not thread safe: call add/trigger/runDue from the task that owns it.
+class NetScheduler {
+public:
+    // randomMs(bound) returns [0, bound); may be NULL to disable jitter.
+    NetScheduler(uint32_t (*nowMs)(), uint32_t (*randomMs)(uint32_t bound), uint32_t coalesceMs);
+
+    // Returns a job id, or -1 when the table is full.
+    int add(const JobSpec& spec, uint32_t firstDelayMs);
+    // Makes a job due now; it runs at the next runDue().
+    void trigger(int id);
+    // Makes a job due in delayMs unless it is already due sooner. Called by
+    // a job on itself, it counts from the end of the current run: a
+    // trigger-only job stays armed and a periodic one runs no later than that.
+    void triggerIn(int id, uint32_t delayMs);
+    // Called by a job about to return JOB_RETRY: the retry waits at least
+    // delayMs, e.g. until an open circuit or a server's Retry-After allows it.
+    void holdOff(int id, uint32_t delayMs);
+    void setRadioAvailable(bool available) { radio_ = available; }
+
+    // Runs due jobs in priority order and returns how long the caller may
+    // sleep before the next one.
+    uint32_t runDue();
+    uint32_t msUntilNext() const;
+    // Time until a radio job is due, whether or not the radio is available;
+    // tells the power manager when the network is needed next.
+    uint32_t msUntilRadio() const;
+
+    const SchedStats& stats() const { return stats_; }
+    const JobStats& jobStats(int id) const { return jobs_[id].stats; }
+    uint32_t dueAt(int id) const { return jobs_[id].due; }
+
+private:
+    struct Job {
+        JobSpec spec;
+        JobStats stats;
+        uint32_t due;
+        uint32_t holdMs; // floor for the next retry's backoff
+        bool armed;      // false for trigger-only jobs waiting for trigger()
+        bool rearmed;    // triggerIn() from the job's own run, applied once it returns
+        uint32_t rearmDue;
+    };
+
+    uint32_t jitter(uint32_t bound) const { return bound && randomMs_ ? randomMs_(bound) : 0; }
+    void reschedule(Job& job, JobResult result, uint32_t now);
+
+    uint32_t (*nowMs_)();
+    uint32_t (*randomMs_)(uint32_t);
+    uint32_t coalesceMs_;
+    bool radio_;
+    int running_;        // job whose fn is executing, -1 between runs
+    Job jobs_[SCHED_MAX_JOBS];
+    size_t count_;
+    SchedStats stats_;
+};
+
+// Lets other tasks trigger jobs of a scheduler they do not own. post() is
+// safe from any task; the owner applies what was posted with deliver()
+// before runDue(). The poster still has to wake the owner.
+class JobMailbox {
+public:
+    explicit JobMailbox(uint32_t (*nowMs)()) : nowMs_(nowMs), pending_(0) {
+        for (size_t i = 0; i < SCHED_MAX_JOBS; i++) dueAt_[i] = 0;
+    }
+
+    // The job becomes due in delayMs, or sooner if it already is.
+    void post(int id, uint32_t delayMs = 0) {
+        if (id < 0 || id >= SCHED_MAX_JOBS) return;
+        dueAt_[id].store(nowMs_() + delayMs, std::memory_order_relaxed);
+        pending_.fetch_or(1u << id, std::memory_order_release);
+    }
+
+    bool empty() const { return pending_.load(std::memory_order_relaxed) == 0; }
+
+    void deliver(NetScheduler& sched) {
+        uint32_t ids = pending_.exchange(0, std::memory_order_acquire);
+        if (!ids) return;
+        uint32_t now = nowMs_();
+        for (int id = 0; id < SCHED_MAX_JOBS; id++) {
+            if (!(ids & (1u << id))) continue;
+            int32_t wait = (int32_t)(dueAt_[id].load(std::memory_order_relaxed) - now);
+            sched.triggerIn(id, wait > 0 ? (uint32_t)wait : 0);
+        }
+    }
+
+private:
+    uint32_t (*nowMs_)();
+    std::atomic<uint32_t> pending_;
+    std::atomic<uint32_t> dueAt_[SCHED_MAX_JOBS];
+};
@@ -0,0 +1,63 @@
+#include "task_topology.h"
+
+int checkTopology(const TaskSpec* tasks, size_t count, const TopologyLimits& limits, size_t* bad) {
+    for (size_t i = 0; i < count; i++) {
+        const TaskSpec& t = tasks[i];
+        int err = TOPOLOGY_OK;
+        if (t.core != TASK_ANY_CORE && (t.core < 0 || t.core >= limits.cores)) err = TOPOLOGY_ERR_CORE;
+        else if (t.priority >= limits.maxPriority) err = TOPOLOGY_ERR_PRIORITY;
+        else if (t.stackBytes != 0 && t.stackBytes < limits.minStackBytes) err = TOPOLOGY_ERR_STACK;
+        else if (t.isolated && t.core == TASK_ANY_CORE) err = TOPOLOGY_ERR_ISOLATION;
+        if (err != TOPOLOGY_OK) {
+            if (bad) *bad = i;
+            return err;
+        }
+    }
+    // An unpinned task can land on every core, so it has to stay below
+    // every isolated task; a pinned one only below those on its own core
+    for (size_t i = 0; i < count; i++) {
+        if (tasks[i].isolated) continue;
+        for (size_t k = 0; k < count; k++) {
+            const TaskSpec& critical = tasks[k];
+            if (!critical.isolated) continue;
+            bool shares = tasks[i].core == TASK_ANY_CORE || tasks[i].core == critical.core;
+            if (shares && tasks[i].priority >= critical.priority) {
+                if (bad) *bad = i;
+                return TOPOLOGY_ERR_ISOLATION;
+            }
+        }
+    }
+    return TOPOLOGY_OK;
+}
+
+const char* topologyErrorName(int error) {
+    switch (error) {
+        case TOPOLOGY_OK: return "ok";
+        case TOPOLOGY_ERR_CORE: return "no such core";
+        case TOPOLOGY_ERR_PRIORITY: return "priority too high";
+        case TOPOLOGY_ERR_STACK: return "stack too small";
+        case TOPOLOGY_ERR_ISOLATION: return "isolation broken";
+    }
+    return "?";
+}
+
+// The first window starts at clock 0, i.e. at boot
+CoreLoad::CoreLoad(uint32_t (*nowMs)()) : nowMs_(nowMs), windowStart_(0) {
+    for (int c = 0; c < TOPOLOGY_MAX_CORES; c++) busyUs_[c] = 0;
+}
+
+void CoreLoad::add(int core, uint32_t busyUs) {
+    if (core < 0 || core >= TOPOLOGY_MAX_CORES) return;
+    busyUs_[core].fetch_add(busyUs, std::memory_order_relaxed);
+}
+
+void CoreLoad::sample(uint8_t percent[TOPOLOGY_MAX_CORES]) {
+    uint32_t now = nowMs_();
+    uint32_t windowMs = now - windowStart_;
+    windowStart_ = now;
+    for (int c = 0; c < TOPOLOGY_MAX_CORES; c++) {
+        uint64_t busyUs = busyUs_[c].exchange(0, std::memory_order_relaxed);
+        uint64_t pct = windowMs ? busyUs / 10 / windowMs : 0; // us * 100 / (ms * 1000)
+        percent[c] = (uint8_t)(pct > 100 ? 100 : pct);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+#define TASK_ANY_CORE -1      // runs wherever the scheduler finds time (FreeRTOS tskNO_AFFINITY)
+#define TOPOLOGY_MAX_CORES 2
+
+enum TopologyError {
+    TOPOLOGY_OK = 0,
+    TOPOLOGY_ERR_CORE = -1,      // pinned to a core the chip does not have
+    TOPOLOGY_ERR_PRIORITY = -2,  // at or above the RTOS priority limit
+    TOPOLOGY_ERR_STACK = -3,     // below the minimum stack
+    TOPOLOGY_ERR_ISOLATION = -4  // an isolated task can be preempted by other work on its core
+};
+
+// One row of the task table: where a task runs, what it preempts and how
+// much stack it gets.
+struct TaskSpec {
+    const char* name;
+    int8_t core;          // 0 .. cores-1, or TASK_ANY_CORE
+    uint8_t priority;     // higher preempts lower on the same core
+    uint32_t stackBytes;  // 0 for tasks created elsewhere, e.g. the Arduino loop
+    bool isolated;        // latency critical: pinned, and outranks every
+                          // non-isolated task that may run on its core
+};
+
+struct TopologyLimits {
+    uint8_t cores;
+    uint8_t maxPriority;  // configMAX_PRIORITIES: valid priorities are below it
+    uint32_t minStackBytes;
+};
+
+// Checks a task table before any task is created. Returns TOPOLOGY_OK or the
+// first error found; *bad (may be NULL) is the index of the offending row.
+int checkTopology(const TaskSpec* tasks, size_t count, const TopologyLimits& limits, size_t* bad);
+const char* topologyErrorName(int error);
+
+// Per-core utilization as reported by the tasks themselves: every task adds
+// the time it ran after each pass, and sample() turns the totals into the
+// share of wall time since the previous sample. Work outside those tasks
+// (the WiFi driver, lwIP, idle) is not counted, so this is the load the
+// topology places on each core, which is what tuning the table needs.
+// add() is safe from any task; sample() belongs to one.
+class CoreLoad {
+public:
+    explicit CoreLoad(uint32_t (*nowMs)());
+
+    // core outside [0, TOPOLOGY_MAX_CORES) is ignored
+    void add(int core, uint32_t busyUs);
+    // Percent per core since the previous call (capped at 100), then starts a new window.
+    void sample(uint8_t percent[TOPOLOGY_MAX_CORES]);
+
+private:
+    uint32_t (*nowMs_)();
+    uint32_t windowStart_;
+    std::atomic<uint32_t> busyUs_[TOPOLOGY_MAX_CORES];
+};
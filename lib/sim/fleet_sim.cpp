@@ -0,0 +1,746 @@
+#ifndef ARDUINO
+#include "fleet_sim.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include "api_client.h"
+#include "api_endpoints.h"
+#include "api_payloads.h"
+#include "batch_uplink.h"
+#include "circuit_breaker.h"
+#include "command_channel.h"
+#include "device_config.h"
+#include "firmware_offer.h"
+#include "flash_writer.h"
+#include "fw_version.h"
+#include "json_fields.h"
+#include "metrics.h"
+#include "net_scheduler.h"
+#include "ota_downloader.h"
+#include "posix_transport.h"
+#include "telemetry_publisher.h"
+
+// Firmware timing from src/main.cpp, before FleetConfig::timeScale
+#define SIM_SAMPLE_INTERVAL 5000
+#define SIM_MQTT_SERVICE_INTERVAL 10000
+#define SIM_HEARTBEAT_INTERVAL 60000
+#define SIM_OTA_CHECK_INTERVAL 21600000
+#define SIM_SUMMARY_INTERVAL 60000
+#define SIM_COALESCE_MS 10000
+#define SIM_REUSE_TIMEOUT 30000
+#define SIM_RESTART_DELAY_MS 2000 // installFirmware() waits this long before ESP.restart()
+#define SIM_OTA_SPREAD_MAX_S 3600
+#define SIM_BATCH_SAMPLES 30
+#define SIM_BATCH_MAX_AGE_MS 300000
+#define SIM_BATCH_MAX_BYTES 1536
+#define SIM_BUFFER_CAPACITY 64
+#define SIM_SUMMARY_PACK 5
+#define SIM_OTA_BUFFER 4096
+#define SIM_TOPIC_PREFIX "edge"
+#define SIM_MAX_WAKE_MS 50 // workers look at the stop flag at least this often
+
+const char* fleetRequestName(FleetRequestKind kind) {
+    switch (kind) {
+    case FLEET_HEARTBEAT: return "heartbeat";
+    case FLEET_SENSOR_BATCH: return "sensor_batch";
+    case FLEET_OTA_CHECK: return "ota_check";
+    case FLEET_OTA_DOWNLOAD: return "ota_download";
+    case FLEET_OTA_LOG: return "ota_log";
+    default: return "unknown";
+    }
+}
+
+FleetConfig defaultFleetConfig(uint32_t devices, const std::string& server) {
+    FleetConfig c;
+    c.devices = devices;
+    unsigned cores = std::thread::hardware_concurrency();
+    c.workers = cores ? cores : 4;
+    c.durationMs = 600000;
+    c.bootSpreadMs = 60000;
+    c.timeScale = 1;
+    c.reconnectMs = 3000;
+    c.server = server;
+    c.authToken = "sim";
+    c.firmwareVersion = "1.0.0";
+    c.seed = 1;
+    return c;
+}
+
+// Scheduler jitter for the calling worker; NetScheduler takes a plain function.
+static thread_local uint32_t rngState = 1;
+
+static uint32_t fleetRandom(uint32_t bound) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return bound ? rngState % bound : 0;
+}
+
+static void fleetSleep(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+static uint32_t scaled(uint32_t ms, uint32_t scale) {
+    return ms / scale;
+}
+
+// Everything the workers share; read-only while they run except the broker.
+struct FleetShared {
+    FleetConfig config;
+    MqttStandin& broker;
+    std::recursive_mutex brokerLock; // the stand-in is single threaded
+    PosixTransportFactory transports;
+    std::string headers;
+    std::string heartbeatUrl;
+    std::string logUrl;
+    std::string batchUrl;
+    uint32_t startMs;
+    std::atomic<bool> stop;
+
+    FleetShared(const FleetConfig& c, MqttStandin& b) : config(c), broker(b), startMs(0), stop(false) {}
+    uint32_t scale(uint32_t ms) const { return scaled(ms, config.timeScale); }
+};
+
+// A device's broker connection; every call takes the shared broker lock.
+class SharedBrokerClient : public MqttClient {
+public:
+    SharedBrokerClient(MqttStandin::Client& client, std::recursive_mutex& lock) : client_(client), lock_(lock) {}
+
+    bool connected() {
+        std::lock_guard<std::recursive_mutex> guard(lock_);
+        return client_.connected();
+    }
+    bool connect(const char* clientId) {
+        std::lock_guard<std::recursive_mutex> guard(lock_);
+        return client_.connect(clientId);
+    }
+    bool publish(const char* topic, const uint8_t* payload, size_t len, uint8_t qos, bool retain) {
+        std::lock_guard<std::recursive_mutex> guard(lock_);
+        return client_.publish(topic, payload, len, qos, retain);
+    }
+    bool subscribe(const char* topic, uint8_t qos) {
+        std::lock_guard<std::recursive_mutex> guard(lock_);
+        return client_.subscribe(topic, qos);
+    }
+    void onMessage(MqttMessageFn fn, void* ctx) {
+        std::lock_guard<std::recursive_mutex> guard(lock_);
+        client_.onMessage(fn, ctx);
+    }
+    bool loop() {
+        std::lock_guard<std::recursive_mutex> guard(lock_);
+        return client_.loop();
+    }
+    int state() { return client_.state(); }
+    void disconnect() {
+        std::lock_guard<std::recursive_mutex> guard(lock_);
+        client_.disconnect();
+    }
+
+private:
+    MqttStandin::Client& client_;
+    std::recursive_mutex& lock_;
+};
+
+// The image goes nowhere; OtaDownloader still hashes and verifies it.
+class DiscardFlashWriter : public FlashWriter {
+public:
+    bool begin(uint32_t) { return true; }
+    bool write(const uint8_t*, size_t) { return true; }
+    bool commit() { return true; }
+    void abort() {}
+};
+
+struct FleetWorkerStats {
+    std::vector<uint32_t> latencyUs[FLEET_REQUEST_KINDS];
+    uint32_t failures[FLEET_REQUEST_KINDS];
+    std::vector<uint32_t> lagUs;
+    std::vector<uint32_t> perSecond;
+    uint32_t updated;
+    uint32_t outages;
+    uint32_t rejected;
+};
+
+class SimDevice;
+
+// One thread's event loop over its share of the fleet.
+struct FleetWorker {
+    FleetShared& shared;
+    std::vector<std::unique_ptr<SimDevice> > devices;
+    FleetWorkerStats stats;
+    uint8_t otaBuffer[SIM_OTA_BUFFER]; // one download at a time per worker
+
+    explicit FleetWorker(FleetShared& s) : shared(s) {
+        memset(stats.failures, 0, sizeof(stats.failures));
+        stats.updated = 0;
+        stats.outages = 0;
+        stats.rejected = 0;
+    }
+
+    void record(FleetRequestKind kind, std::chrono::steady_clock::time_point t0, bool ok) {
+        uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0)
+                          .count();
+        stats.latencyUs[kind].push_back(us > UINT32_MAX ? UINT32_MAX : (uint32_t)us);
+        if (!ok) stats.failures[kind]++;
+        uint32_t second = (posixMillis() - shared.startMs) / 1000;
+        if (stats.perSecond.size() <= second) stats.perSecond.resize(second + 1, 0);
+        stats.perSecond[second]++;
+    }
+
+    void run(uint32_t seed);
+};
+
+// One virtual ESP32: the network task of src/main.cpp with the radio and
+// flash replaced. Job functions mirror their firmware counterparts.
+class SimDevice {
+public:
+    SimDevice(FleetWorker& worker, uint32_t index);
+
+    // Runs whatever is due and returns how long the device can sleep.
+    uint32_t step(uint32_t now);
+    uint32_t bootAt() const { return bootAt_; }
+    const HttpSessionPool& pool() const { return pool_; }
+    uint32_t commandsExecuted() const { return commands_.stats().executed; }
+
+private:
+    static JobResult ingestJob(void* ctx);
+    static JobResult sensorHttpJob(void* ctx);
+    static JobResult summaryJob(void* ctx);
+    static JobResult mqttServiceJob(void* ctx);
+    static JobResult heartbeatJob(void* ctx);
+    static JobResult otaCheckJob(void* ctx);
+    static JobResult evictIdleJob(void* ctx);
+    static int otaCommand(const char* json, size_t len, void* ctx);
+    static bool feedOffer(const uint8_t* data, size_t len, void* ctx);
+
+    void boot(uint32_t t);
+    void updateLink(uint32_t t);
+    uint32_t msUntilLinkChange(uint32_t t) const;
+    bool inOutage(uint32_t t, uint32_t* endsAt) const;
+    bool inShare(uint8_t percent) const;
+    void dropLink();
+    bool reconnect();
+    int post(FleetRequestKind kind, const std::string& url, const void* body, size_t len, uint8_t attempts,
+             CircuitBreaker* breaker);
+    JobResult retryAfterCircuit(int job, const CircuitBreaker& breaker);
+    void installFirmware(const FirmwareOffer& offer);
+    bool sendOtaLog(const char* status, const char* version, const char* error, uint32_t latencyMs,
+                    const OtaStats* transfer);
+    uint32_t relative(uint32_t now) const { return now - worker_.shared.startMs; }
+
+    FleetWorker& worker_;
+    const FleetShared& shared_;
+    uint32_t index_;
+    char id_[16];
+    char version_[32];
+    HttpSessionPool pool_;
+    ApiClient api_;
+    SharedBrokerClient mqtt_;
+    CommandSpec commandTable_[1];
+    CommandChannel commands_;
+    TelemetryPublisher summaries_;
+    SensorSample samples_[SIM_BUFFER_CAPACITY];
+    BatchUplink batch_;
+    NetScheduler sched_;
+    CircuitBreaker heartbeatBreaker_;
+    CircuitBreaker otaLogBreaker_;
+    CircuitBreaker sensorBreaker_;
+    CircuitBreaker otaCheckBreaker_;
+    MetricsRegistry metrics_;
+    int mHttpMs_;
+    int mOtaCheckMs_;
+    int mOtaMs_;
+    int mHttpFailures_;
+    int mMqttConnects_;
+    int sensorHttpJob_;
+    int heartbeatJob_;
+    int otaJob_;
+    bool booted_;
+    bool linkUp_;
+    uint32_t bootAt_;          // relative to the start of the run
+    uint32_t onlineAt_;
+    uint32_t reconnectDelay_;  // this device's WiFi join time
+    uint32_t intervalSamples_; // readings since the last summary
+};
+
+static HttpPoolConfig simPoolConfig(uint32_t scale) {
+    HttpPoolConfig config = defaultHttpPoolConfig(posixMillis);
+    config.idleTimeoutMs = scaled(SIM_REUSE_TIMEOUT, scale);
+    config.ioTimeoutMs = 20000;
+    return config;
+}
+
+// apiRetryPolicy() in src/main.cpp
+static ApiRetryPolicy simRetryPolicy(uint32_t scale) {
+    ApiRetryPolicy policy = defaultApiRetryPolicy(fleetSleep);
+    policy.retryDelayMs = scaled(policy.retryDelayMs, scale);
+    policy.maxRetryDelayMs = scaled(8000, scale);
+    policy.randomMs = fleetRandom;
+    return policy;
+}
+
+// A server's Retry-After is not scaled, only capped at the scaled maximum
+static CircuitBreakerConfig simBreakerConfig(uint32_t scale) {
+    CircuitBreakerConfig config = defaultCircuitBreakerConfig();
+    config.openMs = scaled(config.openMs, scale);
+    config.maxOpenMs = scaled(config.maxOpenMs, scale);
+    config.maxRetryAfterMs = scaled(config.maxRetryAfterMs, scale);
+    return config;
+}
+
+static TelemetryStream summaryStream(uint32_t scale) {
+    TelemetryStream stream = {"s", 0, false, SIM_SUMMARY_PACK, scaled(SIM_SUMMARY_PACK * SIM_SUMMARY_INTERVAL, scale)};
+    return stream;
+}
+
+static const FlushPolicy simFlushPolicy = {SIM_BATCH_SAMPLES, SIM_BATCH_MAX_AGE_MS, SIM_BATCH_MAX_BYTES};
+
+SimDevice::SimDevice(FleetWorker& worker, uint32_t index)
+    : worker_(worker),
+      shared_(worker.shared),
+      index_(index),
+      pool_(worker.shared.transports, simPoolConfig(worker.shared.config.timeScale)),
+      api_(pool_, worker.shared.headers.c_str(), simRetryPolicy(worker.shared.config.timeScale)),
+      mqtt_(worker.shared.broker.client(), worker.shared.brokerLock),
+      commands_(mqtt_, commandTable_, 1),
+      summaries_(mqtt_, TELEMETRY_SUMMARY, summaryStream(worker.shared.config.timeScale), posixMillis),
+      batch_(samples_, SIM_BUFFER_CAPACITY, simFlushPolicy),
+      sched_(posixMillis, fleetRandom, 0),
+      heartbeatBreaker_(simBreakerConfig(worker.shared.config.timeScale), posixMillis, fleetRandom),
+      otaLogBreaker_(simBreakerConfig(worker.shared.config.timeScale), posixMillis, fleetRandom),
+      sensorBreaker_(simBreakerConfig(worker.shared.config.timeScale), posixMillis, fleetRandom),
+      otaCheckBreaker_(simBreakerConfig(worker.shared.config.timeScale), posixMillis, fleetRandom),
+      sensorHttpJob_(-1),
+      heartbeatJob_(-1),
+      otaJob_(-1),
+      booted_(false),
+      linkUp_(false),
+      onlineAt_(0),
+      intervalSamples_(0) {
+    snprintf(id_, sizeof(id_), "sim-%05u", (unsigned)index);
+    snprintf(version_, sizeof(version_), "%s", shared_.config.firmwareVersion);
+    commandTable_[0].name = "ota";
+    commandTable_[0].fn = otaCommand;
+    commandTable_[0].ctx = this;
+    commands_.begin(SIM_TOPIC_PREFIX, id_);
+    summaries_.begin(SIM_TOPIC_PREFIX, id_);
+    mHttpMs_ = metrics_.histogram("http_ms");
+    mOtaCheckMs_ = metrics_.histogram("ota_check_ms");
+    mOtaMs_ = metrics_.histogram("ota_ms");
+    mHttpFailures_ = metrics_.counter("http_failures");
+    mMqttConnects_ = metrics_.counter("mqtt_connects");
+    const FleetConfig& c = shared_.config;
+    bootAt_ = c.bootSpreadMs ? fleetRandom(c.bootSpreadMs) : 0;
+    uint32_t join = shared_.scale(c.reconnectMs);
+    reconnectDelay_ = join + fleetRandom(join + 1);
+}
+
+// setupNetJobs() in src/main.cpp, minus the jobs that only touch local
+// hardware (flash replay, power, health gate, diagnostics)
+void SimDevice::boot(uint32_t t) {
+    uint32_t s = shared_.config.timeScale;
+    sched_ = NetScheduler(posixMillis, fleetRandom, scaled(SIM_COALESCE_MS, s));
+    CircuitBreaker fresh(simBreakerConfig(s), posixMillis, fleetRandom);
+    heartbeatBreaker_ = otaLogBreaker_ = sensorBreaker_ = otaCheckBreaker_ = fresh;
+    //                name            fn              ctx   period                                  jitter                  slack                   prio radio retry base/max
+    JobSpec ingest = {"ingest",       ingestJob,      this, scaled(SIM_SAMPLE_INTERVAL, s),         0,                      0,                      9, false, 0,                  0};
+    JobSpec http   = {"sensor-http",  sensorHttpJob,  this, 0,                                      0,                      0,                      8, true,  scaled(5000, s),    scaled(120000, s)};
+    JobSpec summary = {"summary",     summaryJob,     this, scaled(SIM_SUMMARY_INTERVAL, s),        0,                      scaled(5000, s),        6, true,  scaled(5000, s),    scaled(60000, s)};
+    JobSpec broker = {"mqtt",         mqttServiceJob, this, scaled(SIM_MQTT_SERVICE_INTERVAL, s),   0,                      0,                      7, true,  scaled(3000, s),    scaled(60000, s)};
+    JobSpec beat   = {"heartbeat",    heartbeatJob,   this, scaled(SIM_HEARTBEAT_INTERVAL, s),      scaled(5000, s),        scaled(15000, s),       5, true,  scaled(5000, s),    scaled(60000, s)};
+    JobSpec ota    = {"ota",          otaCheckJob,    this, scaled(SIM_OTA_CHECK_INTERVAL, s),      scaled(30000, s),       scaled(60000, s),       1, true,  0,                  0};
+    JobSpec evict  = {"evict",        evictIdleJob,   this, scaled(SIM_REUSE_TIMEOUT, s),           0,                      0,                      0, false, 0,                  0};
+    sched_.add(ingest, ingest.periodMs);
+    sensorHttpJob_ = sched_.add(http, 0);
+    sched_.add(summary, summary.periodMs);
+    sched_.add(broker, 0);
+    heartbeatJob_ = sched_.add(beat, beat.periodMs);
+    otaJob_ = sched_.add(ota, ota.periodMs);
+    sched_.add(evict, evict.periodMs);
+    sched_.setRadioAvailable(false);
+    booted_ = true;
+    linkUp_ = false;
+    intervalSamples_ = 0;
+    onlineAt_ = t + reconnectDelay_;
+}
+
+bool SimDevice::inShare(uint8_t percent) const {
+    // Fixed per device, so a smaller share is always part of a larger one
+    return (index_ * 2654435761u >> 16) % 100 < percent;
+}
+
+bool SimDevice::inOutage(uint32_t t, uint32_t* endsAt) const {
+    const std::vector<FleetOutage>& outages = shared_.config.outages;
+    bool out = false;
+    for (size_t i = 0; i < outages.size(); i++) {
+        const FleetOutage& o = outages[i];
+        if (t < o.atMs || t - o.atMs >= o.durationMs || !inShare(o.percent)) continue;
+        uint32_t end = o.atMs + o.durationMs;
+        if (!out || end > *endsAt) *endsAt = end;
+        out = true;
+    }
+    return out;
+}
+
+uint32_t SimDevice::msUntilLinkChange(uint32_t t) const {
+    if (!linkUp_) return onlineAt_ > t ? onlineAt_ - t : 0;
+    uint32_t next = SCHED_IDLE_MS;
+    const std::vector<FleetOutage>& outages = shared_.config.outages;
+    for (size_t i = 0; i < outages.size(); i++) {
+        if (outages[i].atMs > t && inShare(outages[i].percent)) next = std::min(next, outages[i].atMs - t);
+    }
+    return next;
+}
+
+void SimDevice::dropLink() {
+    linkUp_ = false;
+    sched_.setRadioAvailable(false);
+    pool_.closeAll();
+    mqtt_.disconnect();
+}
+
+// What LinkManager reports to the network task: down at once, back up one
+// WiFi join after the outage
+void SimDevice::updateLink(uint32_t t) {
+    uint32_t end = 0;
+    if (inOutage(t, &end)) {
+        if (linkUp_) {
+            dropLink();
+            worker_.stats.outages++;
+        }
+        if (onlineAt_ < end + reconnectDelay_) onlineAt_ = end + reconnectDelay_;
+        return;
+    }
+    if (!linkUp_ && t >= onlineAt_) {
+        linkUp_ = true;
+        sched_.setRadioAvailable(true);
+    }
+}
+
+uint32_t SimDevice::step(uint32_t now) {
+    uint32_t t = relative(now);
+    if (!booted_) {
+        if (t < bootAt_) return bootAt_ - t;
+        boot(t);
+    }
+    updateLink(t);
+    uint32_t sleepMs = sched_.runDue();
+    if (!booted_) return bootAt_ > relative(posixMillis()) ? bootAt_ - relative(posixMillis()) : 0;
+    return std::min(sleepMs, msUntilLinkChange(relative(posixMillis())));
+}
+
+int SimDevice::post(FleetRequestKind kind, const std::string& url, const void* body, size_t len,
+                    uint8_t attempts, CircuitBreaker* breaker) {
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    uint32_t ms0 = posixMillis();
+    int code = api_.request("POST", url.c_str(), (const uint8_t*)body, len, attempts, NULL, breaker);
+    if (code == API_ERR_CIRCUIT_OPEN) {
+        worker_.stats.rejected++; // nothing reached the server
+        return code;
+    }
+    metrics_.record(mHttpMs_, posixMillis() - ms0);
+    bool ok = ApiClient::succeeded(code);
+    if (!ok) metrics_.add(mHttpFailures_);
+    worker_.record(kind, t0, ok);
+    return code;
+}
+
+JobResult SimDevice::retryAfterCircuit(int job, const CircuitBreaker& breaker) {
+    sched_.holdOff(job, breaker.msUntilAllowed());
+    return JOB_RETRY;
+}
+
+bool SimDevice::reconnect() {
+    char clientId[24];
+    snprintf(clientId, sizeof(clientId), "ESP32Client-%04x", (unsigned)fleetRandom(0xffff));
+    if (!mqtt_.connect(clientId)) return false;
+    metrics_.add(mMqttConnects_);
+    commands_.subscribe();
+    return true;
+}
+
+// Synthetic readings; only their size and cadence matter to the server
+JobResult SimDevice::ingestJob(void* ctx) {
+    SimDevice* d = static_cast<SimDevice*>(ctx);
+    uint32_t now = posixMillis();
+    float jitter = fleetRandom(1000) / 100.0f;
+    d->batch_.add(makeSample((uint32_t)time(NULL), 25.0f + jitter, 50.0f + jitter, 100.0f + jitter * 10), now);
+    d->intervalSamples_++;
+    if (d->batch_.shouldFlush(now) && d->sched_.jobStats(d->sensorHttpJob_).failStreak == 0) {
+        d->sched_.trigger(d->sensorHttpJob_);
+    }
+    return JOB_DONE;
+}
+
+JobResult SimDevice::sensorHttpJob(void* ctx) {
+    SimDevice* d = static_cast<SimDevice*>(ctx);
+    if (d->batch_.ring().size() == 0) return JOB_DONE;
+    uint8_t body[SIM_BATCH_MAX_BYTES];
+    size_t samples = 0;
+    size_t len = d->batch_.encode(d->id_, body, sizeof(body), &samples);
+    if (len == 0) return JOB_DONE;
+    if (!ApiClient::succeeded(d->post(FLEET_SENSOR_BATCH, d->shared_.batchUrl, body, len, 1, &d->sensorBreaker_))) {
+        return d->retryAfterCircuit(d->sensorHttpJob_, d->sensorBreaker_);
+    }
+    d->batch_.commit(samples, posixMillis());
+    return JOB_DONE;
+}
+
+// Every interval is reported; the firmware's deadband would skip some
+JobResult SimDevice::summaryJob(void* ctx) {
+    SimDevice* d = static_cast<SimDevice*>(ctx);
+    if (d->intervalSamples_ == 0) return JOB_DONE;
+    if (!d->mqtt_.connected()) return JOB_RETRY;
+    SummaryRecord record;
+    memset(&record, 0, sizeof(record));
+    record.timestamp = (uint32_t)time(NULL);
+    record.samples = d->intervalSamples_;
+    record.channels = 3;
+    for (int c = 0; c < 3; c++) {
+        record.ch[c].min = 2500 + fleetRandom(100);
+        record.ch[c].max = record.ch[c].min + fleetRandom(300);
+        record.ch[c].mean = (record.ch[c].min + record.ch[c].max) / 2;
+        record.ch[c].sd = fleetRandom(50);
+    }
+    d->intervalSamples_ = 0;
+    d->summaries_.add(record);
+    d->summaries_.flush();
+    return JOB_DONE;
+}
+
+JobResult SimDevice::mqttServiceJob(void* ctx) {
+    SimDevice* d = static_cast<SimDevice*>(ctx);
+    if (!d->mqtt_.connected() && !d->reconnect()) return JOB_RETRY;
+    d->mqtt_.loop();
+    return JOB_DONE;
+}
+
+JobResult SimDevice::heartbeatJob(void* ctx) {
+    SimDevice* d = static_cast<SimDevice*>(ctx);
+    HeartbeatInfo info;
+    memset(&info, 0, sizeof(info));
+    info.deviceId = d->id_;
+    info.firmwareVersion = d->version_;
+    char metricsJson[1280];
+    info.metrics = d->metrics_.encode(metricsJson, sizeof(metricsJson)) ? metricsJson : NULL;
+    char body[1600];
+    size_t len = buildHeartbeat(info, body, sizeof(body));
+    if (!ApiClient::succeeded(d->post(FLEET_HEARTBEAT, d->shared_.heartbeatUrl, body, len, 1, &d->heartbeatBreaker_))) {
+        return d->retryAfterCircuit(d->heartbeatJob_, d->heartbeatBreaker_);
+    }
+    d->metrics_.resetHistograms();
+    return JOB_DONE;
+}
+
+bool SimDevice::feedOffer(const uint8_t* data, size_t len, void* ctx) {
+    return static_cast<FirmwareOfferParser*>(ctx)->feed((const char*)data, len);
+}
+
+JobResult SimDevice::otaCheckJob(void* ctx) {
+    SimDevice* d = static_cast<SimDevice*>(ctx);
+    if (!d->otaCheckBreaker_.allow()) {
+        d->worker_.stats.rejected++;
+        return JOB_DONE;
+    }
+    std::string url = d->shared_.config.server + API_PATH_FIRMWARE_VERSION + d->version_;
+    FirmwareOffer offer;
+    FirmwareOfferParser parser(offer);
+    HttpResponse resp;
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    uint32_t ms0 = posixMillis();
+    int code = d->pool_.request("GET", url.c_str(), d->shared_.headers.c_str(), NULL, 0, &resp, feedOffer, &parser);
+    d->metrics_.record(d->mOtaCheckMs_, posixMillis() - ms0);
+    d->otaCheckBreaker_.record(code, code > 0 ? resp.retryAfterS : 0);
+    d->worker_.record(FLEET_OTA_CHECK, t0, code == 200);
+    if (code == 200 && parser.finish() && compareVersion(offer.version, d->version_) > 0) d->installFirmware(offer);
+    return JOB_DONE;
+}
+
+JobResult SimDevice::evictIdleJob(void* ctx) {
+    static_cast<SimDevice*>(ctx)->pool_.evictIdle();
+    return JOB_DONE;
+}
+
+// otaCommand() in src/main.cpp
+int SimDevice::otaCommand(const char* json, size_t len, void* ctx) {
+    SimDevice* d = static_cast<SimDevice*>(ctx);
+    char version[32];
+    char spread[12];
+    JsonField fields[] = {{"version", version, sizeof(version), false}, {"spread_s", spread, sizeof(spread), false}};
+    JsonFieldExtractor extractor(fields, 2);
+    if (!extractor.feed(json, len) || !extractor.finish()) return CMD_ERR_ARGS;
+    uint32_t spreadS = 0;
+    if (fields[1].found && !parseUint32(spread, &spreadS)) return CMD_ERR_ARGS;
+    if (fields[0].found && compareVersion(version, d->version_) <= 0) return CMD_SKIPPED;
+    if (spreadS > SIM_OTA_SPREAD_MAX_S) spreadS = SIM_OTA_SPREAD_MAX_S;
+    uint32_t delayMs = spreadS ? fleetRandom(d->shared_.scale(spreadS * 1000) + 1) : 0;
+    d->sched_.triggerIn(d->otaJob_, delayMs);
+    return CMD_OK;
+}
+
+bool SimDevice::sendOtaLog(const char* status, const char* version, const char* error, uint32_t latencyMs,
+                           const OtaStats* transfer) {
+    OtaLogInfo info = {id_, status, version, error, (int32_t)latencyMs, transfer, NULL, NULL, 1};
+    char body[512];
+    size_t len = buildOtaLog(info, body, sizeof(body));
+    if (len == 0) return false;
+    return ApiClient::succeeded(post(FLEET_OTA_LOG, shared_.logUrl, body, len, 3, &otaLogBreaker_));
+}
+
+// installFirmware() in src/main.cpp, full images only: a simulated device
+// has no running partition to apply a delta patch to
+void SimDevice::installFirmware(const FirmwareOffer& offer) {
+    pool_.closeAll();
+    DiscardFlashWriter flash;
+    OtaConfig config = defaultOtaConfig(posixMillis, fleetSleep);
+    config.retryDelayMs = shared_.scale(config.retryDelayMs);
+    OtaDownloader ota(pool_, flash, worker_.otaBuffer, sizeof(worker_.otaBuffer), config);
+    std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    uint32_t ms0 = posixMillis();
+    int ret = ota.run(offer.url, shared_.headers.c_str(), offer.sha256[0] ? offer.sha256 : NULL);
+    uint32_t latency = posixMillis() - ms0;
+    metrics_.record(mOtaMs_, latency);
+    worker_.record(FLEET_OTA_DOWNLOAD, t0, ret == OTA_OK);
+    if (ret != OTA_OK) {
+        sendOtaLog("update_failed", offer.version, "OTA failed", latency, &ota.stats());
+        return;
+    }
+    sendOtaLog("update_success", offer.version, "", latency, &ota.stats());
+    worker_.stats.updated++;
+    // ESP.restart(): the new version boots after the restart delay
+    snprintf(version_, sizeof(version_), "%s", offer.version);
+    dropLink();
+    booted_ = false;
+    bootAt_ = relative(posixMillis()) + shared_.scale(SIM_RESTART_DELAY_MS);
+}
+
+void FleetWorker::run(uint32_t seed) {
+    rngState = seed ? seed : 1;
+    typedef std::pair<uint32_t, uint32_t> Wake; // relative time, device
+    std::priority_queue<Wake, std::vector<Wake>, std::greater<Wake> > queue;
+    for (uint32_t i = 0; i < devices.size(); i++) queue.push(Wake(devices[i]->bootAt(), i));
+    uint32_t end = shared.config.durationMs;
+    while (!shared.stop.load() && !queue.empty()) {
+        uint32_t t = posixMillis() - shared.startMs;
+        if (t >= end) break;
+        Wake next = queue.top();
+        if (next.first > t) {
+            fleetSleep(std::min(next.first - t, (uint32_t)SIM_MAX_WAKE_MS));
+            continue;
+        }
+        queue.pop();
+        stats.lagUs.push_back((t - next.first) * 1000);
+        uint32_t sleepMs = devices[next.second]->step(posixMillis());
+        queue.push(Wake(posixMillis() - shared.startMs + sleepMs, next.second));
+    }
+}
+
+static FleetLatency summarize(std::vector<uint32_t>& values, uint32_t failures) {
+    FleetLatency l;
+    memset(&l, 0, sizeof(l));
+    l.count = values.size();
+    l.failures = failures;
+    if (values.empty()) return l;
+    std::sort(values.begin(), values.end());
+    l.p50Us = values[(values.size() - 1) * 50 / 100];
+    l.p99Us = values[(values.size() - 1) * 99 / 100];
+    l.maxUs = values.back();
+    return l;
+}
+
+FleetSimulator::FleetSimulator(const FleetConfig& config) : config_(config) {
+    if (config_.workers == 0) config_.workers = 1;
+    if (config_.timeScale == 0) config_.timeScale = 1;
+    broker_.keepHistory(false);
+}
+
+FleetSimulator::~FleetSimulator() {}
+
+FleetReport FleetSimulator::run() {
+    FleetShared shared(config_, broker_);
+    shared.headers = std::string(API_HEADERS_HEAD) + config_.authToken + API_HEADERS_TAIL;
+    shared.heartbeatUrl = config_.server + API_PATH_HEARTBEAT;
+    shared.logUrl = config_.server + API_PATH_LOG;
+    shared.batchUrl = config_.server + API_PATH_SENSOR_BATCH;
+
+    std::vector<std::unique_ptr<FleetWorker> > workers;
+    for (uint32_t w = 0; w < config_.workers; w++) workers.push_back(std::unique_ptr<FleetWorker>(new FleetWorker(shared)));
+    rngState = config_.seed ? config_.seed : 1;
+    for (uint32_t i = 0; i < config_.devices; i++) {
+        FleetWorker& w = *workers[i % config_.workers];
+        w.devices.push_back(std::unique_ptr<SimDevice>(new SimDevice(w, i)));
+    }
+    MqttStandin::Client& operatorClient = broker_.client();
+    operatorClient.connect("fleet-operator");
+
+    shared.startMs = posixMillis();
+    std::vector<std::thread> threads;
+    for (uint32_t w = 0; w < config_.workers; w++) {
+        threads.push_back(std::thread(&FleetWorker::run, workers[w].get(), config_.seed * 7919 + w + 1));
+    }
+
+    // Rollout waves go out from here, each to the devices it adds
+    std::vector<FleetWave> waves = config_.waves;
+    std::sort(waves.begin(), waves.end(), [](const FleetWave& a, const FleetWave& b) { return a.atMs < b.atMs; });
+    uint32_t offered = 0;
+    for (size_t k = 0; k < waves.size(); k++) {
+        while (posixMillis() - shared.startMs < waves[k].atMs && posixMillis() - shared.startMs < config_.durationMs) {
+            fleetSleep(SIM_MAX_WAKE_MS);
+        }
+        if (posixMillis() - shared.startMs >= config_.durationMs) break;
+        uint32_t upTo = (uint32_t)((uint64_t)config_.devices * std::min<uint32_t>(waves[k].percent, 100) / 100);
+        char head[64];
+        snprintf(head, sizeof(head), "{\"cmd\":\"ota\",\"id\":\"wave%u\",\"spread_s\":%u,", (unsigned)(k + 1),
+                 (unsigned)waves[k].spreadS);
+        std::string command = head + std::string("\"version\":\"") + config_.offerVersion + "\"}";
+        std::lock_guard<std::recursive_mutex> guard(shared.brokerLock);
+        for (; offered < upTo; offered++) {
+            char topic[CMD_TOPIC_LEN];
+            snprintf(topic, sizeof(topic), SIM_TOPIC_PREFIX "/sim-%05u/cmd", (unsigned)offered);
+            operatorClient.publish(topic, (const uint8_t*)command.data(), command.size(), 1, false);
+        }
+    }
+    for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+
+    FleetReport report;
+    memset(&report, 0, sizeof(report));
+    report.elapsedMs = posixMillis() - shared.startMs;
+    std::vector<uint32_t> merged[FLEET_REQUEST_KINDS];
+    uint32_t failures[FLEET_REQUEST_KINDS] = {0};
+    std::vector<uint32_t> lag;
+    std::vector<uint32_t> perSecond;
+    for (size_t w = 0; w < workers.size(); w++) {
+        FleetWorker& worker = *workers[w];
+        for (int k = 0; k < FLEET_REQUEST_KINDS; k++) {
+            merged[k].insert(merged[k].end(), worker.stats.latencyUs[k].begin(), worker.stats.latencyUs[k].end());
+            failures[k] += worker.stats.failures[k];
+        }
+        lag.insert(lag.end(), worker.stats.lagUs.begin(), worker.stats.lagUs.end());
+        if (perSecond.size() < worker.stats.perSecond.size()) perSecond.resize(worker.stats.perSecond.size(), 0);
+        for (size_t s = 0; s < worker.stats.perSecond.size(); s++) perSecond[s] += worker.stats.perSecond[s];
+        report.updated += worker.stats.updated;
+        report.outages += worker.stats.outages;
+        report.rejected += worker.stats.rejected;
+        for (size_t i = 0; i < worker.devices.size(); i++) {
+            const HttpPoolStats& pool = worker.devices[i]->pool().stats();
+            report.httpRequests += pool.requests;
+            report.connects += pool.connectsOpened;
+            report.reused += pool.reused;
+            report.commands += worker.devices[i]->commandsExecuted();
+        }
+    }
+    for (int k = 0; k < FLEET_REQUEST_KINDS; k++) report.requests[k] = summarize(merged[k], failures[k]);
+    report.lag = summarize(lag, 0);
+    for (size_t s = 0; s < perSecond.size(); s++) report.peakPerSec = std::max(report.peakPerSec, perSecond[s]);
+    report.mqttMessages = broker_.messageCount();
+    report.mqttBytes = broker_.byteCount();
+    return report;
+}
+#endif
@@ -0,0 +1,103 @@
+#pragma once
+#ifndef ARDUINO
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "mqtt_standin.h"
+
+// What the simulated devices send, for the latency report.
+enum FleetRequestKind {
+    FLEET_HEARTBEAT = 0,
+    FLEET_SENSOR_BATCH,
+    FLEET_OTA_CHECK,
+    FLEET_OTA_DOWNLOAD, // one whole image, resumes included
+    FLEET_OTA_LOG
+};
+#define FLEET_REQUEST_KINDS 5
+
+const char* fleetRequestName(FleetRequestKind kind);
+
+// Loss of WiFi for a share of the fleet, e.g. an access point rebooting.
+// Devices reconnect once it ends, like the firmware's LinkManager would.
+struct FleetOutage {
+    uint32_t atMs;       // from the start of the run
+    uint32_t durationMs;
+    uint8_t percent;     // of the devices, always the same ones for the same percent
+};
+
+// One step of an OTA rollout: at atMs the "ota" command goes to the first
+// percent of the fleet (cumulative), with spread_s like the operator sets it.
+struct FleetWave {
+    uint32_t atMs;
+    uint8_t percent;
+    uint32_t spreadS;
+};
+
+struct FleetConfig {
+    uint32_t devices;
+    uint32_t workers;         // threads; each runs an event loop over its share of devices
+    uint32_t durationMs;
+    uint32_t bootSpreadMs;    // devices power up at random over this long
+    // Firmware intervals, jitter, slack and backoff are divided by this, so a
+    // short run sees as many cycles as a long one at the same ratios.
+    uint32_t timeScale;
+    uint32_t reconnectMs;     // WiFi join plus DHCP after boot or an outage, before scaling
+    std::string server;       // OTA_SERVER, e.g. http://127.0.0.1:8080
+    const char* authToken;
+    const char* firmwareVersion; // what the fleet runs at the start
+    std::string offerVersion; // named in the "ota" command of every wave; the server must offer it
+    std::vector<FleetOutage> outages;
+    std::vector<FleetWave> waves;
+    uint32_t seed;
+};
+
+// The firmware's intervals (src/main.cpp) at time scale 1, one worker per core.
+FleetConfig defaultFleetConfig(uint32_t devices, const std::string& server);
+
+struct FleetLatency {
+    uint32_t count;      // requests that got an answer, success or not
+    uint32_t failures;   // error statuses and network errors
+    uint32_t p50Us;
+    uint32_t p99Us;
+    uint32_t maxUs;
+};
+
+struct FleetReport {
+    uint32_t elapsedMs;
+    FleetLatency requests[FLEET_REQUEST_KINDS];
+    FleetLatency lag;          // how late devices were served, i.e. worker saturation
+    uint32_t httpRequests;     // all HTTP exchanges, retries included
+    uint32_t peakPerSec;       // busiest one second window of httpRequests
+    uint32_t connects;         // TCP connections the devices opened
+    uint32_t reused;           // requests served on a kept-alive connection
+    uint32_t mqttMessages;     // published through the broker, acks and commands included
+    uint64_t mqttBytes;
+    uint32_t commands;         // commands the devices executed
+    uint32_t updated;          // devices that installed the offer and rebooted into it
+    uint32_t outages;          // device-side link losses
+    uint32_t rejected;         // requests the devices' circuit breakers kept from the server
+
+    double requestsPerSec() const { return elapsedMs ? httpRequests * 1000.0 / elapsedMs : 0; }
+};
+
+// Runs a fleet of virtual devices in one process. Every device has the
+// firmware's own job table, scheduler and backoff, HTTP session pool,
+// payload builders, command channel and OTA downloader; only the radio and
+// the flash are simulated. HTTP goes to config.server, MQTT to an
+// in-process MqttStandin the simulator owns.
+class FleetSimulator {
+public:
+    explicit FleetSimulator(const FleetConfig& config);
+    ~FleetSimulator();
+
+    // Blocks for config.durationMs and returns the totals.
+    FleetReport run();
+
+    MqttStandin& broker() { return broker_; }
+
+private:
+    FleetConfig config_;
+    MqttStandin broker_;
+};
+#endif
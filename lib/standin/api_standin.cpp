@@ -0,0 +1,86 @@
+#ifndef ARDUINO
+#include "api_standin.h"
+#include <stdlib.h>
+#include "sha256.h"
+
+ApiStandin::ApiStandin(const char* version, size_t imageBytes)
+    : http_([this](const StandinRequest& req, StandinResponse& resp) { handle(req, resp); }),
+      released_(version), down_(false), rejected_(0), updates_(0) {
+    for (size_t i = 0; i < API_STANDIN_ROUTES; i++) counts_[i].store(0);
+    // Incompressible, so transfer sizes match a real image
+    image_.resize(imageBytes);
+    uint32_t x = 0x9E3779B9;
+    for (size_t i = 0; i < imageBytes; i++) {
+        x = x * 1664525 + 1013904223;
+        image_[i] = (char)(x >> 24);
+    }
+    Sha256 sha;
+    sha.update((const uint8_t*)image_.data(), image_.size());
+    uint8_t digest[SHA256_DIGEST_LEN];
+    sha.finish(digest);
+    char hex[2 * SHA256_DIGEST_LEN + 1];
+    sha256ToHex(digest, hex);
+    sha256_ = hex;
+}
+
+void ApiStandin::release(const char* version) {
+    std::lock_guard<std::mutex> guard(lock_);
+    released_ = version;
+}
+
+std::string ApiStandin::offerJson(const char* version) const {
+    return std::string("{\"version\":\"") + version + "\",\"url\":\"" + baseUrl() + "/firmware/esp32-v" + version +
+           ".bin\",\"sha256\":\"" + sha256_ + "\"}";
+}
+
+static ApiStandinRoute routeOf(const StandinRequest& req) {
+    const std::string& p = req.path;
+    if (p == "/api/heartbeat") return API_ROUTE_HEARTBEAT;
+    if (p == "/api/log") return API_ROUTE_LOG;
+    if (p == "/api/sensor/batch") return API_ROUTE_SENSOR_BATCH;
+    if (p.compare(0, 21, "/api/firmware/version") == 0) return API_ROUTE_VERSION;
+    if (p.compare(0, 10, "/firmware/") == 0) return API_ROUTE_FIRMWARE;
+    return API_ROUTE_OTHER;
+}
+
+void ApiStandin::handle(const StandinRequest& req, StandinResponse& resp) {
+    ApiStandinRoute route = routeOf(req);
+    counts_[route]++;
+    if (down_.load()) {
+        rejected_++;
+        resp.status = 503;
+        resp.body = "{\"error\":\"unavailable\"}";
+        return;
+    }
+    switch (route) {
+        case API_ROUTE_VERSION: {
+            std::lock_guard<std::mutex> guard(lock_);
+            resp.body = offerJson(released_.c_str());
+            return;
+        }
+        case API_ROUTE_FIRMWARE: {
+            auto it = req.headers.find("range");
+            size_t from = 0;
+            if (it != req.headers.end() && it->second.compare(0, 6, "bytes=") == 0) {
+                from = strtoul(it->second.c_str() + 6, NULL, 10);
+                if (from > image_.size()) from = image_.size();
+                resp.status = 206;
+                resp.extraHeaders = "Content-Range: bytes " + std::to_string(from) + "-" +
+                                    std::to_string(image_.size() - 1) + "/" + std::to_string(image_.size()) + "\r\n";
+            }
+            resp.body = image_.substr(from);
+            return;
+        }
+        case API_ROUTE_OTHER:
+            resp.status = 404;
+            resp.body = "{\"error\":\"not found\"}";
+            return;
+        case API_ROUTE_LOG:
+            if (req.body.find("\"update_success\"") != std::string::npos) updates_++;
+            // fall through
+        default:
+            resp.body = "{\"ok\":true}";
+            return;
+    }
+}
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+#ifndef ARDUINO
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include "http_standin.h"
+
+enum ApiStandinRoute {
+    API_ROUTE_HEARTBEAT = 0, // POST /api/heartbeat
+    API_ROUTE_LOG,           // POST /api/log
+    API_ROUTE_SENSOR_BATCH,  // POST /api/sensor/batch
+    API_ROUTE_VERSION,       // GET /api/firmware/version
+    API_ROUTE_FIRMWARE,      // GET /firmware/...
+    API_ROUTE_OTHER
+};
+#define API_STANDIN_ROUTES 6
+
+// Stand-in for the OTA web server's device API on 127.0.0.1, for the fleet
+// simulator and its tests. Uploads are answered 200 {"ok":true}; the version
+// endpoint offers the released version, and every /firmware/ path serves
+// the same generated image, honouring Range so resumed downloads work.
+class ApiStandin {
+public:
+    ApiStandin(const char* version, size_t imageBytes);
+
+    bool start() { return http_.start(); }
+    void stop() { http_.stop(); }
+    // http://127.0.0.1:<port>, what the firmware calls OTA_SERVER.
+    std::string baseUrl() const { return http_.url(""); }
+
+    // Version the version endpoint offers from now on.
+    void release(const char* version);
+    // The offer for a version as the version endpoint returns it.
+    std::string offerJson(const char* version) const;
+    const std::string& imageSha256() const { return sha256_; }
+    size_t imageBytes() const { return image_.size(); }
+
+    // A server outage: every request gets 503 until it is back up.
+    void setDown(bool down) { down_.store(down); }
+
+    uint32_t requests(ApiStandinRoute route) const { return counts_[route].load(); }
+    uint32_t rejected() const { return rejected_.load(); }
+    // OTA logs whose status was update_success.
+    uint32_t updatesLogged() const { return updates_.load(); }
+    HttpStandin& http() { return http_; }
+
+private:
+    void handle(const StandinRequest& req, StandinResponse& resp);
+
+    HttpStandin http_;
+    std::string image_;
+    std::string sha256_;
+    mutable std::mutex lock_;
+    std::string released_;
+    std::atomic<bool> down_;
+    std::atomic<uint32_t> counts_[API_STANDIN_ROUTES];
+    std::atomic<uint32_t> rejected_;
+    std::atomic<uint32_t> updates_;
+};
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+#ifndef ARDUINO
+#include <chrono>
+
+// Machine-readable benchmark results. When the BENCH_JSON environment
+// variable names a file, every call appends one JSON object per line:
+//   {"suite":"bench_json","metric":"ota_log_json_writer","value":812.4,"unit":"ns/op"}
+// Without it the call does nothing, so benchmarks keep their console output.
+// tools/bench_compare.py diffs two such files.
+void benchRecord(const char* suite, const char* metric, double value, const char* unit);
+
+// Nanoseconds per operation for ops operations started at t0.
+double nsPerOp(std::chrono::steady_clock::time_point t0, int ops);
+#endif
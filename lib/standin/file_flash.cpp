@@ -0,0 +1,64 @@
+#ifndef ARDUINO
+#include "file_flash.h"
+#include <string.h>
+
+FileFlash::FileFlash(const std::string& path, uint32_t sectorSize, uint32_t sectorCount)
+    : path_(path), sectorSize_(sectorSize), sectorCount_(sectorCount), file_(NULL), failAfter_(-1),
+      bitViolation_(false), eraseCounts_(sectorCount, 0) {}
+
+FileFlash::~FileFlash() {
+    close();
+}
+
+bool FileFlash::open() {
+    close();
+    file_ = fopen(path_.c_str(), "r+b");
+    if (file_) return true;
+    file_ = fopen(path_.c_str(), "w+b");
+    if (!file_) return false;
+    std::vector<uint8_t> blank(sectorSize_, 0xFF);
+    for (uint32_t s = 0; s < sectorCount_; s++) fwrite(blank.data(), 1, blank.size(), file_);
+    fflush(file_);
+    return true;
+}
+
+void FileFlash::close() {
+    if (file_) fclose(file_);
+    file_ = NULL;
+}
+
+bool FileFlash::read(uint32_t addr, void* buf, size_t len) {
+    if (!file_ || addr + len > (uint64_t)sectorSize_ * sectorCount_) return false;
+    fseek(file_, addr, SEEK_SET);
+    return fread(buf, 1, len, file_) == len;
+}
+
+bool FileFlash::write(uint32_t addr, const void* data, size_t len) {
+    if (!file_ || addr + len > (uint64_t)sectorSize_ * sectorCount_) return false;
+    if (failAfter_ == 0) return false;
+    size_t n = len;
+    if (failAfter_ > 0 && (long)len > failAfter_) n = (size_t)failAfter_;
+    std::vector<uint8_t> cur(n);
+    fseek(file_, addr, SEEK_SET);
+    if (fread(cur.data(), 1, n, file_) != n) return false;
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < n; i++) {
+        if (p[i] & ~cur[i]) bitViolation_ = true;
+        cur[i] &= p[i];
+    }
+    fseek(file_, addr, SEEK_SET);
+    fwrite(cur.data(), 1, n, file_);
+    if (failAfter_ > 0) failAfter_ -= (long)n;
+    return n == len;
+}
+
+bool FileFlash::erase(uint32_t sector) {
+    if (!file_ || sector >= sectorCount_) return false;
+    if (failAfter_ == 0) return false;
+    std::vector<uint8_t> blank(sectorSize_, 0xFF);
+    fseek(file_, (long)sector * sectorSize_, SEEK_SET);
+    fwrite(blank.data(), 1, blank.size(), file_);
+    eraseCounts_[sector]++;
+    return true;
+}
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef ARDUINO
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "sector_storage.h"
+
+// SectorStorage backed by a file, with NOR flash rules: erase sets 0xFF and
+// writes can only clear bits. Counts erases per sector and can simulate a
+// reset partway through a write.
+class FileFlash : public SectorStorage {
+public:
+    FileFlash(const std::string& path, uint32_t sectorSize, uint32_t sectorCount);
+    ~FileFlash();
+
+    // Opens the file, creating it fully erased if it does not exist.
+    bool open();
+    void close();
+
+    uint32_t sectorSize() const { return sectorSize_; }
+    uint32_t sectorCount() const { return sectorCount_; }
+    bool read(uint32_t addr, void* buf, size_t len);
+    bool write(uint32_t addr, const void* data, size_t len);
+    bool erase(uint32_t sector);
+
+    // After `bytes` more bytes are written, the rest of that write and all
+    // later writes are lost, as if power failed. -1 disables.
+    void failAfter(long bytes) { failAfter_ = bytes; }
+    uint32_t erases(uint32_t sector) const { return eraseCounts_[sector]; }
+    // Set when a write tried to turn a 0 bit back into 1.
+    bool bitViolation() const { return bitViolation_; }
+
+private:
+    std::string path_;
+    uint32_t sectorSize_;
+    uint32_t sectorCount_;
+    FILE* file_;
+    long failAfter_;
+    bool bitViolation_;
+    std::vector<uint32_t> eraseCounts_;
+};
+#endif
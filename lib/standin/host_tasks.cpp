@@ -0,0 +1,32 @@
+#ifndef ARDUINO
+#include "host_tasks.h"
+#include <sched.h>
+#include <unistd.h>
+
+bool startHostTask(const TaskSpec& spec, void* (*entry)(void*), void* arg, pthread_t* thread) {
+    pthread_attr_t attr;
+    if (pthread_attr_init(&attr) != 0) return false;
+    size_t stack = spec.stackBytes > HOST_TASK_MIN_STACK ? spec.stackBytes : HOST_TASK_MIN_STACK;
+    pthread_attr_setstacksize(&attr, stack);
+#ifdef __linux__
+    if (spec.core != TASK_ANY_CORE && spec.core < sysconf(_SC_NPROCESSORS_ONLN)) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(spec.core, &cpus);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    }
+#endif
+    bool ok = pthread_create(thread, &attr, entry, arg) == 0;
+    pthread_attr_destroy(&attr);
+    return ok;
+}
+
+int hostTaskCore() {
+#ifdef __linux__
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : cpu;
+#else
+    return 0;
+#endif
+}
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+#ifndef ARDUINO
+#include <pthread.h>
+#include "task_topology.h"
+
+#define HOST_TASK_MIN_STACK (256 * 1024) // glibc and the sanitizers need far more than firmware
+
+// Starts a task table row on a pthread, the stand-in for
+// xTaskCreatePinnedToCore in native tests. A pinned task is bound to that
+// CPU when the host has it. The stack is at least HOST_TASK_MIN_STACK.
+// Priorities are not applied: SCHED_FIFO needs root, so tests cannot rely
+// on preemption, only on which work shares a thread.
+bool startHostTask(const TaskSpec& spec, void* (*entry)(void*), void* arg, pthread_t* thread);
+
+// The CPU the caller runs on, for CoreLoad::add(); 0 when unknown.
+int hostTaskCore();
+#endif
@@ -0,0 +1,172 @@
+#ifndef ARDUINO
+#include "http_standin.h"
+#include <arpa/inet.h>
+#include <ctype.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+
+HttpStandin::HttpStandin(StandinHandler handler) : handler_(handler) {}
+
+HttpStandin::~HttpStandin() {
+    stop();
+}
+
+bool HttpStandin::start() {
+    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd_ < 0) return false;
+    int one = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (bind(listenFd_, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd_, 128) != 0) {
+        ::close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(listenFd_, (sockaddr*)&addr, &len);
+    port_ = ntohs(addr.sin_port);
+    if (pipe(wakePipe_) != 0) return false;
+    running_.store(true);
+    thread_ = std::thread(&HttpStandin::run, this);
+    return true;
+}
+
+void HttpStandin::stop() {
+    if (!running_.exchange(false)) return;
+    char c = 0;
+    if (::write(wakePipe_[1], &c, 1) < 0) {
+        // The poll timeout still lets the thread notice running_ == false.
+    }
+    thread_.join();
+    ::close(listenFd_);
+    ::close(wakePipe_[0]);
+    ::close(wakePipe_[1]);
+    listenFd_ = -1;
+}
+
+std::string HttpStandin::url(const char* path) const {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "http://127.0.0.1:%u", (unsigned)port_);
+    return std::string(buf) + path;
+}
+
+void HttpStandin::run() {
+    std::map<int, std::string> clients;
+    while (running_.load()) {
+        if (dropRequested_.exchange(false)) {
+            for (auto& c : clients) ::close(c.first);
+            clients.clear();
+        }
+        std::vector<pollfd> fds;
+        fds.push_back({listenFd_, POLLIN, 0});
+        fds.push_back({wakePipe_[0], POLLIN, 0});
+        for (auto& c : clients) fds.push_back({c.first, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), 20) <= 0) continue;
+
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listenFd_, NULL, NULL);
+            if (fd >= 0) {
+                clients[fd] = std::string();
+                accepted_++;
+            }
+        }
+        for (size_t i = 2; i < fds.size(); i++) {
+            if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            int fd = fds[i].fd;
+            char buf[4096];
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            std::string& pending = clients[fd];
+            bool keep = n > 0;
+            if (keep) {
+                pending.append(buf, (size_t)n);
+                keep = handle(fd, pending);
+            }
+            if (!keep) {
+                ::close(fd);
+                clients.erase(fd);
+            }
+        }
+    }
+    for (auto& c : clients) ::close(c.first);
+}
+
+static void sendAll(int fd, const std::string& data) {
+    size_t off = 0;
+    while (off < data.size()) {
+        ssize_t n = send(fd, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+        if (n <= 0) return;
+        off += (size_t)n;
+    }
+}
+
+// Serves every complete request in buf. Returns false if the connection should close.
+bool HttpStandin::handle(int fd, std::string& buf) {
+    for (;;) {
+        size_t headEnd = buf.find("\r\n\r\n");
+        if (headEnd == std::string::npos) return true;
+
+        StandinRequest req;
+        size_t lineEnd = buf.find("\r\n");
+        std::string requestLine = buf.substr(0, lineEnd);
+        size_t sp1 = requestLine.find(' ');
+        size_t sp2 = requestLine.find(' ', sp1 + 1);
+        req.method = requestLine.substr(0, sp1);
+        req.path = requestLine.substr(sp1 + 1, sp2 - sp1 - 1);
+        size_t pos = lineEnd + 2;
+        while (pos < headEnd) {
+            size_t e = buf.find("\r\n", pos);
+            std::string line = buf.substr(pos, e - pos);
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) {
+                std::string name = line.substr(0, colon);
+                std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+                size_t v = line.find_first_not_of(' ', colon + 1);
+                req.headers[name] = v == std::string::npos ? "" : line.substr(v);
+            }
+            pos = e + 2;
+        }
+        size_t bodyLen = 0;
+        if (req.headers.count("content-length")) bodyLen = strtoul(req.headers["content-length"].c_str(), NULL, 10);
+        if (buf.size() < headEnd + 4 + bodyLen) return true;
+        req.body = buf.substr(headEnd + 4, bodyLen);
+        buf.erase(0, headEnd + 4 + bodyLen);
+
+        StandinResponse resp;
+        {
+            std::lock_guard<std::mutex> guard(handlerLock_);
+            handler_(req, resp);
+        }
+        if (resp.noReply) return false;
+        char head[128];
+        snprintf(head, sizeof(head), "HTTP/1.1 %d X\r\n", resp.status);
+        std::string out = head;
+        out += resp.extraHeaders;
+        if (resp.close) out += "Connection: close\r\n";
+        if (resp.chunked) {
+            out += "Transfer-Encoding: chunked\r\n\r\n";
+            for (size_t off = 0; off < resp.body.size(); off += 7) {
+                std::string piece = resp.body.substr(off, 7);
+                char size[16];
+                snprintf(size, sizeof(size), "%zx\r\n", piece.size());
+                out += size + piece + "\r\n";
+            }
+            out += "0\r\n\r\n";
+        } else {
+            out += "Content-Length: " + std::to_string(resp.body.size()) + "\r\n\r\n";
+            if (req.method != "HEAD") out += resp.cutAfter ? resp.body.substr(0, resp.cutAfter) : resp.body;
+        }
+        served_++; // counted before the client can see the reply
+        sendAll(fd, out);
+        if (resp.cutAfter) return false;
+        if (resp.close || resp.dropAfter) return false;
+    }
+}
+#endif
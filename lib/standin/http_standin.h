@@ -0,0 +1,64 @@
+#pragma once
+#ifndef ARDUINO
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal HTTP/1.1 server for native tests and benchmarks. It stands in for
+// the OTA web server on 127.0.0.1 and counts accepted TCP connections.
+struct StandinRequest {
+    std::string method;
+    std::string path;
+    std::map<std::string, std::string> headers; // names lower-cased
+    std::string body;
+};
+
+struct StandinResponse {
+    int status = 200;
+    std::string body;
+    std::string extraHeaders;    // "Name: value\r\n" lines
+    bool close = false;          // send "Connection: close" and close
+    bool dropAfter = false;      // close silently after replying (server-side idle timeout)
+    bool chunked = false;
+    size_t cutAfter = 0;         // if set, send only this many body bytes, then close
+    bool noReply = false;        // close without answering, after reading the whole request
+};
+
+typedef std::function<void(const StandinRequest&, StandinResponse&)> StandinHandler;
+
+class HttpStandin {
+public:
+    explicit HttpStandin(StandinHandler handler);
+    ~HttpStandin();
+
+    bool start();
+    void stop();
+    uint16_t port() const { return port_; }
+    std::string url(const char* path) const;
+
+    uint32_t acceptedConnections() const { return accepted_.load(); }
+    uint32_t requestsServed() const { return served_.load(); }
+    // Closes every open client connection without notice.
+    void dropConnections() { dropRequested_.store(true); }
+
+private:
+    void run();
+    bool handle(int fd, std::string& buf);
+
+    StandinHandler handler_;
+    std::mutex handlerLock_;
+    int listenFd_ = -1;
+    int wakePipe_[2] = {-1, -1};
+    uint16_t port_ = 0;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<bool> dropRequested_{false};
+    std::atomic<uint32_t> accepted_{0};
+    std::atomic<uint32_t> served_{0};
+};
+#endif
@@ -0,0 +1,106 @@
+#ifndef ARDUINO
+#include "mqtt_standin.h"
+
+bool MqttStandin::Client::connect(const char* clientId) {
+    if (!broker_.up_) return false;
+    id_ = clientId;
+    connected_ = true;
+    return true;
+}
+
+bool MqttStandin::Client::publish(const char* topic, const uint8_t* payload, size_t len, uint8_t qos, bool retain) {
+    if (!connected_) return false;
+    MqttStandinMessage msg = {topic, std::string((const char*)payload, len), qos, retain};
+    broker_.route(msg);
+    return true;
+}
+
+bool MqttStandin::Client::subscribe(const char* topic, uint8_t) {
+    if (!connected_) return false;
+    filters_.push_back(topic);
+    for (auto& it : broker_.retained_) {
+        if (MqttStandin::topicMatches(topic, it.first)) inbox_.push_back(it.second);
+    }
+    return true;
+}
+
+bool MqttStandin::Client::loop() {
+    if (!connected_) return false;
+    // Handlers may publish, which can queue more messages for this client
+    std::deque<MqttStandinMessage> batch;
+    batch.swap(inbox_);
+    for (size_t i = 0; i < batch.size(); i++) {
+        const MqttStandinMessage& m = batch[i];
+        if (fn_) fn_(m.topic.c_str(), (const uint8_t*)m.payload.data(), m.payload.size(), ctx_);
+    }
+    return connected_;
+}
+
+void MqttStandin::Client::drop() {
+    connected_ = false;
+    filters_.clear();
+    inbox_.clear();
+}
+
+MqttStandin::Client& MqttStandin::client() {
+    clients_.push_back(std::unique_ptr<Client>(new Client(*this)));
+    return *clients_.back();
+}
+
+void MqttStandin::setUp(bool up) {
+    up_ = up;
+    if (up) return;
+    for (size_t i = 0; i < clients_.size(); i++) clients_[i]->drop();
+}
+
+bool MqttStandin::retained(const std::string& topic, MqttStandinMessage* out) const {
+    auto it = retained_.find(topic);
+    if (it == retained_.end()) return false;
+    if (out) *out = it->second;
+    return true;
+}
+
+void MqttStandin::route(const MqttStandinMessage& msg) {
+    messages_++;
+    bytes_ += msg.topic.size() + msg.payload.size();
+    if (history_) published_.push_back(msg);
+    if (msg.retain) {
+        // An empty retained message clears the topic
+        if (msg.payload.empty()) {
+            retained_.erase(msg.topic);
+        } else {
+            retained_[msg.topic] = msg;
+        }
+    }
+    for (size_t i = 0; i < clients_.size(); i++) {
+        Client& c = *clients_[i];
+        for (size_t f = 0; f < c.filters_.size(); f++) {
+            if (topicMatches(c.filters_[f], msg.topic)) {
+                MqttStandinMessage copy = msg;
+                copy.retain = false; // only set on delivery of a stored message
+                c.inbox_.push_back(copy);
+                break;
+            }
+        }
+    }
+}
+
+bool MqttStandin::topicMatches(const std::string& filter, const std::string& topic) {
+    // Most filters are exact topics; fleet simulations match thousands per publish
+    if (filter.find_first_of("+#") == std::string::npos) return filter == topic;
+    size_t f = 0, t = 0;
+    while (f < filter.size()) {
+        size_t fEnd = filter.find('/', f);
+        if (fEnd == std::string::npos) fEnd = filter.size();
+        std::string level = filter.substr(f, fEnd - f);
+        if (level == "#") return true;
+        if (t > topic.size()) return false;
+        size_t tEnd = topic.find('/', t);
+        if (tEnd == std::string::npos) tEnd = topic.size();
+        if (level != "+" && level != topic.substr(t, tEnd - t)) return false;
+        f = fEnd + 1;
+        t = tEnd + 1;
+    }
+    return t > topic.size();
+}
+#endif
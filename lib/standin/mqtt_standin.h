@@ -0,0 +1,87 @@
+#pragma once
+#ifndef ARDUINO
+#include <stdint.h>
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "mqtt_client.h"
+
+struct MqttStandinMessage {
+    std::string topic;
+    std::string payload;
+    uint8_t qos;
+    bool retain;
+};
+
+// In-process MQTT broker for native tests and simulations. Clients created
+// by it route publishes through it and receive matching messages ('+' and
+// '#' filters, retained messages) from loop(), like PubSubClient. Delivery
+// is always exactly once; qos and retain are kept for inspection. Single
+// threaded.
+class MqttStandin {
+public:
+    class Client : public MqttClient {
+    public:
+        explicit Client(MqttStandin& broker) : broker_(broker), connected_(false), fn_(NULL), ctx_(NULL) {}
+
+        bool connected() { return connected_; }
+        bool connect(const char* clientId);
+        bool publish(const char* topic, const uint8_t* payload, size_t len, uint8_t qos, bool retain);
+        bool subscribe(const char* topic, uint8_t qos);
+        void onMessage(MqttMessageFn fn, void* ctx) {
+            fn_ = fn;
+            ctx_ = ctx;
+        }
+        bool loop();
+        int state() { return connected_ ? 0 : -1; }
+        // Drops the connection as if the network went away.
+        void disconnect() { drop(); }
+
+        const std::string& id() const { return id_; }
+        size_t queued() const { return inbox_.size(); }
+
+    private:
+        friend class MqttStandin;
+        void drop();
+
+        MqttStandin& broker_;
+        std::string id_;
+        bool connected_;
+        std::vector<std::string> filters_;
+        std::deque<MqttStandinMessage> inbox_;
+        MqttMessageFn fn_;
+        void* ctx_;
+    };
+
+    MqttStandin() : up_(true), history_(true), messages_(0), bytes_(0) {}
+
+    // A new client, owned by the broker.
+    Client& client();
+    // Taking the broker down disconnects every client and drops its subscriptions.
+    void setUp(bool up);
+    bool up() const { return up_; }
+
+    // Every message published so far, in order.
+    const std::vector<MqttStandinMessage>& published() const { return published_; }
+    // Long simulations only need the totals below; stops filling published().
+    void keepHistory(bool keep) { history_ = keep; }
+    uint32_t messageCount() const { return messages_; }
+    uint64_t byteCount() const { return bytes_; } // topics plus payloads
+    bool retained(const std::string& topic, MqttStandinMessage* out) const;
+
+    static bool topicMatches(const std::string& filter, const std::string& topic);
+
+private:
+    void route(const MqttStandinMessage& msg);
+
+    bool up_;
+    bool history_;
+    uint32_t messages_;
+    uint64_t bytes_;
+    std::vector<std::unique_ptr<Client> > clients_;
+    std::map<std::string, MqttStandinMessage> retained_;
+    std::vector<MqttStandinMessage> published_;
+};
+#endif
@@ -0,0 +1,45 @@
+#ifndef ARDUINO
+#include "peer_standin.h"
+#include <string.h>
+
+PeerStandin::PeerStandin(const std::string& image, const char* version)
+    : http_([this](const StandinRequest& req, StandinResponse& resp) { handle(req, resp); }), data_(image),
+      corrupt_(false), cutNext_(0), requests_(0), ranges_(0), bytes_(0) {
+    memset(&advertised_, 0, sizeof(advertised_));
+    strncpy(advertised_.version, version, sizeof(advertised_.version) - 1);
+    Sha256 sha;
+    sha.update((const uint8_t*)data_.data(), data_.size());
+    uint8_t digest[SHA256_DIGEST_LEN];
+    sha.finish(digest);
+    sha256ToHex(digest, advertised_.sha256);
+    advertised_.size = (uint32_t)data_.size();
+}
+
+PeerInfo PeerStandin::info() const {
+    PeerInfo peer;
+    memset(&peer, 0, sizeof(peer));
+    strcpy(peer.host, "127.0.0.1");
+    peer.port = http_.port();
+    peer.image = advertised_;
+    return peer;
+}
+
+void PeerStandin::handle(const StandinRequest& req, StandinResponse& resp) {
+    requests_++;
+    auto it = req.headers.find("range");
+    if (it != req.headers.end()) ranges_++;
+    PeerServeResult r = peerServe(advertised_, req.path.c_str(), it != req.headers.end() ? it->second.c_str() : NULL);
+    resp.status = r.status;
+    if (r.status != 200 && r.status != 206) return;
+    if (r.status == 206) {
+        char value[64];
+        peerContentRange(r, advertised_, value, sizeof(value));
+        resp.extraHeaders = std::string("Content-Range: ") + value + "\r\n";
+    }
+    resp.body = data_.substr(r.start, r.length);
+    if (corrupt_.load() && !resp.body.empty()) resp.body[resp.body.size() / 2] ^= 0x5A;
+    size_t cut = cutNext_.exchange(0);
+    if (cut && cut < resp.body.size()) resp.cutAfter = cut;
+    bytes_ += cut && cut < resp.body.size() ? cut : resp.body.size();
+}
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+#ifndef ARDUINO
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include "http_standin.h"
+#include "peer_cache.h"
+
+// A LAN peer for native tests: serves an image on 127.0.0.1 through the
+// same peerServe() logic as the firmware, and can misbehave on request.
+class PeerStandin {
+public:
+    PeerStandin(const std::string& image, const char* version);
+
+    bool start() { return http_.start(); }
+    void stop() { http_.stop(); }
+
+    // What discovery reports for this peer.
+    PeerInfo info() const;
+    const PeerImage& image() const { return advertised_; }
+
+    // Keeps advertising the image but serves one flipped byte.
+    void corrupt(bool on) { corrupt_.store(on); }
+    // The next response is cut after this many body bytes.
+    void cutNextAfter(size_t bytes) { cutNext_.store(bytes); }
+
+    uint32_t requests() const { return requests_.load(); }
+    uint32_t rangeRequests() const { return ranges_.load(); }
+    uint64_t bytesServed() const { return bytes_.load(); }
+
+private:
+    void handle(const StandinRequest& req, StandinResponse& resp);
+
+    HttpStandin http_;
+    std::string data_;
+    PeerImage advertised_;
+    std::atomic<bool> corrupt_;
+    std::atomic<size_t> cutNext_;
+    std::atomic<uint32_t> requests_;
+    std::atomic<uint32_t> ranges_;
+    std::atomic<uint64_t> bytes_;
+};
+#endif
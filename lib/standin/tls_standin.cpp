@@ -0,0 +1,126 @@
+#ifndef ARDUINO
+#include "tls_standin.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+
+#define TLS_STANDIN_POLL_MS 50
+
+TlsStandin::TlsStandin(uint16_t backendPort, const char* certPem, const char* keyPem, int maxVersion)
+    : backendPort_(backendPort), certPem_(certPem), keyPem_(keyPem), maxVersion_(maxVersion) {}
+
+TlsStandin::~TlsStandin() {
+    stop();
+}
+
+bool TlsStandin::start() {
+    ctx_ = SSL_CTX_new(TLS_server_method());
+    if (!ctx_) return false;
+    if (maxVersion_) SSL_CTX_set_max_proto_version(ctx_, maxVersion_);
+    BIO* bio = BIO_new_mem_buf(certPem_.c_str(), -1);
+    X509* cert = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+    BIO_free(bio);
+    bio = BIO_new_mem_buf(keyPem_.c_str(), -1);
+    EVP_PKEY* key = PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL);
+    BIO_free(bio);
+    bool loaded = cert && key && SSL_CTX_use_certificate(ctx_, cert) == 1 && SSL_CTX_use_PrivateKey(ctx_, key) == 1;
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    if (!loaded) return false;
+
+    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd_ < 0) return false;
+    int one = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listenFd_, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd_, 64) != 0) return false;
+    socklen_t len = sizeof(addr);
+    getsockname(listenFd_, (sockaddr*)&addr, &len);
+    port_ = ntohs(addr.sin_port);
+    running_.store(true);
+    thread_ = std::thread(&TlsStandin::run, this);
+    return true;
+}
+
+void TlsStandin::stop() {
+    if (running_.exchange(false)) {
+        thread_.join();
+        std::lock_guard<std::mutex> lock(workersLock_);
+        for (size_t i = 0; i < workers_.size(); i++) workers_[i].join();
+        workers_.clear();
+    }
+    if (listenFd_ >= 0) ::close(listenFd_);
+    listenFd_ = -1;
+    if (ctx_) SSL_CTX_free(ctx_);
+    ctx_ = nullptr;
+}
+
+std::string TlsStandin::url(const char* path) const {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "https://localhost:%u", (unsigned)port_);
+    return std::string(buf) + path;
+}
+
+void TlsStandin::run() {
+    while (running_.load()) {
+        struct pollfd p = {listenFd_, POLLIN, 0};
+        if (poll(&p, 1, TLS_STANDIN_POLL_MS) != 1) continue;
+        int fd = accept(listenFd_, NULL, NULL);
+        if (fd < 0) continue;
+        std::lock_guard<std::mutex> lock(workersLock_);
+        workers_.push_back(std::thread(&TlsStandin::serve, this, fd));
+    }
+}
+
+// One connection: handshake, then copy bytes both ways until either side closes.
+void TlsStandin::serve(int fd) {
+    SSL* ssl = SSL_new(ctx_);
+    SSL_set_fd(ssl, fd);
+    int backend = -1;
+    if (SSL_accept(ssl) != 1) {
+        failed_++;
+    } else {
+        handshakes_++;
+        if (SSL_session_reused(ssl)) resumed_++;
+        backend = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(backendPort_);
+        if (::connect(backend, (sockaddr*)&addr, sizeof(addr)) != 0) {
+            ::close(backend);
+            backend = -1;
+        }
+    }
+    char buf[4096];
+    while (backend >= 0 && running_.load()) {
+        struct pollfd p[2] = {{fd, POLLIN, 0}, {backend, POLLIN, 0}};
+        if (SSL_pending(ssl) == 0 && poll(p, 2, TLS_STANDIN_POLL_MS) <= 0) continue;
+        if (SSL_pending(ssl) > 0 || (p[0].revents & (POLLIN | POLLHUP))) {
+            int n = SSL_read(ssl, buf, sizeof(buf));
+            if (n <= 0) {
+                if (SSL_get_error(ssl, n) == SSL_ERROR_WANT_READ) continue;
+                break;
+            }
+            if (send(backend, buf, n, MSG_NOSIGNAL) != n) break;
+        }
+        if (p[1].revents & (POLLIN | POLLHUP)) {
+            ssize_t n = recv(backend, buf, sizeof(buf), 0);
+            if (n <= 0 || SSL_write(ssl, buf, (int)n) != n) break;
+        }
+    }
+    if (backend >= 0) ::close(backend);
+    SSL_shutdown(ssl);
+    SSL_free(ssl);
+    ERR_clear_error();
+    ::close(fd);
+}
+#endif
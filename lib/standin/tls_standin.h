@@ -0,0 +1,50 @@
+#pragma once
+#ifndef ARDUINO
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef struct ssl_ctx_st SSL_CTX;
+
+// TLS front for a plain stand-in server (HttpStandin) on 127.0.0.1: it
+// terminates TLS with the given certificate and forwards the bytes to the
+// backend port. Counts handshakes and how many resumed a session.
+class TlsStandin {
+public:
+    // maxVersion limits the protocol, e.g. TLS1_2_VERSION; 0 allows TLS 1.3.
+    TlsStandin(uint16_t backendPort, const char* certPem, const char* keyPem, int maxVersion = 0);
+    ~TlsStandin();
+
+    bool start();
+    void stop();
+    uint16_t port() const { return port_; }
+    // https://localhost:<port><path>
+    std::string url(const char* path) const;
+
+    uint32_t handshakes() const { return handshakes_.load(); }
+    uint32_t resumed() const { return resumed_.load(); }
+    uint32_t failedHandshakes() const { return failed_.load(); }
+
+private:
+    void run();
+    void serve(int fd);
+
+    uint16_t backendPort_;
+    std::string certPem_;
+    std::string keyPem_;
+    int maxVersion_;
+    SSL_CTX* ctx_ = nullptr;
+    int listenFd_ = -1;
+    uint16_t port_ = 0;
+    std::thread thread_;
+    std::mutex workersLock_;
+    std::vector<std::thread> workers_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint32_t> handshakes_{0};
+    std::atomic<uint32_t> resumed_{0};
+    std::atomic<uint32_t> failed_{0};
+};
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+#ifdef ARDUINO
+#include <esp_partition.h>
+#include "sector_storage.h"
+
+// The first sectorCount sectors of a raw data partition, found by label.
+class EspPartitionStorage : public SectorStorage {
+public:
+    EspPartitionStorage(const char* label, uint32_t sectorCount)
+        : label_(label), sectors_(sectorCount), partition_(NULL) {}
+
+    bool begin() {
+        partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label_);
+        if (!partition_) return false;
+        if (sectors_ > partition_->size / SPI_FLASH_SEC_SIZE) sectors_ = partition_->size / SPI_FLASH_SEC_SIZE;
+        return sectors_ >= 2;
+    }
+
+    uint32_t sectorSize() const { return SPI_FLASH_SEC_SIZE; }
+    uint32_t sectorCount() const { return sectors_; }
+    bool read(uint32_t addr, void* buf, size_t len) {
+        return partition_ && esp_partition_read(partition_, addr, buf, len) == ESP_OK;
+    }
+    bool write(uint32_t addr, const void* data, size_t len) {
+        return partition_ && esp_partition_write(partition_, addr, data, len) == ESP_OK;
+    }
+    bool erase(uint32_t sector) {
+        return partition_ &&
+               esp_partition_erase_range(partition_, sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE) == ESP_OK;
+    }
+
+private:
+    const char* label_;
+    uint32_t sectors_;
+    const esp_partition_t* partition_;
+};
+#endif
@@ -0,0 +1,227 @@
+#include "flash_queue.h"
+#include <string.h>
+
+#define FQ_MAGIC 0x31305153u // "SQ01"
+#define FQ_ERASED_LEN 0xFFFF
+#define FQ_PENDING 0xFF
+#define FQ_CONSUMED 0x00
+
+static const uint32_t crcNibble[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
+
+static uint32_t crc32Update(uint32_t crc, const uint8_t* p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        crc ^= p[i];
+        crc = (crc >> 4) ^ crcNibble[crc & 0x0f];
+        crc = (crc >> 4) ^ crcNibble[crc & 0x0f];
+    }
+    return crc;
+}
+
+static uint32_t recordSize(uint16_t len) {
+    return FQ_RECORD_HEADER + ((len + 3u) & ~3u);
+}
+
+// Wrap-safe sequence comparison.
+static bool newer(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b) > 0;
+}
+
+FlashQueue::FlashQueue(SectorStorage& storage)
+    : storage_(storage), sectorSize_(storage.sectorSize()), sectors_(storage.sectorCount()), hasTail_(false),
+      tail_(0), tailOffset_(0), tailSeq_(0), count_(0) {
+    head_.sector = 0;
+    head_.offset = FQ_SECTOR_HEADER;
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+bool FlashQueue::readSectorSeq(uint32_t sector, uint32_t* seq) {
+    uint32_t hdr[2];
+    if (!storage_.read(addr(sector, 0), hdr, sizeof(hdr)) || hdr[0] != FQ_MAGIC) return false;
+    *seq = hdr[1];
+    return true;
+}
+
+bool FlashQueue::readHeader(const FlashQueueCursor& c, RecordHeader& h) {
+    uint8_t raw[FQ_RECORD_HEADER];
+    if (!storage_.read(addr(c.sector, c.offset), raw, sizeof(raw))) return false;
+    h.len = (uint16_t)(raw[0] | (raw[1] << 8));
+    h.state = raw[2];
+    h.pad = raw[3];
+    h.crc = (uint32_t)raw[4] | ((uint32_t)raw[5] << 8) | ((uint32_t)raw[6] << 16) | ((uint32_t)raw[7] << 24);
+    return true;
+}
+
+bool FlashQueue::validRecord(const FlashQueueCursor& c, const RecordHeader& h) {
+    if (h.len == 0 || h.pad != 0xFF || (h.state != FQ_PENDING && h.state != FQ_CONSUMED)) return false;
+    if (c.offset + recordSize(h.len) > sectorSize_) return false;
+    uint8_t chunk[64];
+    uint32_t crc = 0xFFFFFFFFu;
+    for (uint32_t off = 0; off < h.len; off += sizeof(chunk)) {
+        size_t n = h.len - off < sizeof(chunk) ? h.len - off : sizeof(chunk);
+        if (!storage_.read(addr(c.sector, c.offset + FQ_RECORD_HEADER + off), chunk, n)) return false;
+        crc = crc32Update(crc, chunk, n);
+    }
+    return ~crc == h.crc;
+}
+
+// Moves c onto the next valid record, crossing into newer sectors as needed.
+// An erased or damaged header ends a sector; torn reports the latter.
+bool FlashQueue::nextRecord(FlashQueueCursor& c, RecordHeader& h, bool* torn) {
+    if (!hasTail_) return false;
+    for (;;) {
+        bool atTail = c.sector == tail_;
+        if (atTail && c.offset >= tailOffset_) return false;
+        if (c.offset + FQ_RECORD_HEADER <= sectorSize_ && readHeader(c, h) && h.len != FQ_ERASED_LEN) {
+            if (validRecord(c, h)) return true;
+            if (torn && !atTail) *torn = true; // the tail was checked by mount()
+        }
+        if (atTail) return false;
+        c.sector = next(c.sector);
+        c.offset = FQ_SECTOR_HEADER;
+    }
+}
+
+int FlashQueue::mount() {
+    if (sectors_ < 2) return FQ_ERR_GEOMETRY;
+    hasTail_ = false;
+    count_ = 0;
+    for (uint32_t s = 0; s < sectors_; s++) {
+        uint32_t seq;
+        if (readSectorSeq(s, &seq) && (!hasTail_ || newer(seq, tailSeq_))) {
+            hasTail_ = true;
+            tail_ = s;
+            tailSeq_ = seq;
+        }
+    }
+    if (!hasTail_) {
+        head_.sector = 0;
+        head_.offset = FQ_SECTOR_HEADER;
+        return FQ_OK;
+    }
+
+    // The ring runs backwards from the tail through consecutive sequence numbers.
+    uint32_t oldest = tail_;
+    uint32_t seq = tailSeq_;
+    for (uint32_t i = 1; i < sectors_; i++) {
+        uint32_t prev = (oldest + sectors_ - 1) % sectors_;
+        uint32_t prevSeq;
+        if (!readSectorSeq(prev, &prevSeq) || prevSeq != seq - 1) break;
+        oldest = prev;
+        seq = prevSeq;
+    }
+
+    // Find the end of the tail; a torn record closes the sector for writing.
+    RecordHeader h;
+    FlashQueueCursor c = {tail_, FQ_SECTOR_HEADER};
+    tailOffset_ = sectorSize_;
+    while (c.offset + FQ_RECORD_HEADER <= sectorSize_ && readHeader(c, h)) {
+        if (h.len == FQ_ERASED_LEN) {
+            tailOffset_ = c.offset;
+            break;
+        }
+        if (!validRecord(c, h)) {
+            stats_.corrupt++;
+            break;
+        }
+        c.offset += recordSize(h.len);
+    }
+
+    bool found = false;
+    bool torn = false;
+    c.sector = oldest;
+    c.offset = FQ_SECTOR_HEADER;
+    while (nextRecord(c, h, &torn)) {
+        if (h.state == FQ_PENDING) {
+            if (!found) head_ = c;
+            found = true;
+            count_++;
+        }
+        c.offset += recordSize(h.len);
+    }
+    if (torn) stats_.corrupt++;
+    if (!found) {
+        head_.sector = tail_;
+        head_.offset = tailOffset_;
+    }
+    return FQ_OK;
+}
+
+// Starts the sector after the tail, dropping whatever was still unread in it.
+int FlashQueue::openSector() {
+    uint32_t n = hasTail_ ? next(tail_) : 0;
+    if (hasTail_ && count_ > 0 && head_.sector == n) {
+        FlashQueueCursor c = head_;
+        RecordHeader h;
+        while (count_ > 0 && nextRecord(c, h) && c.sector == n) {
+            c.offset += recordSize(h.len);
+            count_--;
+            stats_.dropped++;
+        }
+        head_ = c;
+    }
+    if (!storage_.erase(n)) return FQ_ERR_IO;
+    stats_.erases++;
+    uint32_t seq = hasTail_ ? tailSeq_ + 1 : 1;
+    uint32_t hdr[2] = {FQ_MAGIC, seq};
+    if (!storage_.write(addr(n, 0), hdr, sizeof(hdr))) return FQ_ERR_IO;
+    hasTail_ = true;
+    tail_ = n;
+    tailSeq_ = seq;
+    tailOffset_ = FQ_SECTOR_HEADER;
+    return FQ_OK;
+}
+
+int FlashQueue::push(const void* data, size_t len) {
+    if (len == 0 || len > maxRecord()) return FQ_ERR_SIZE;
+    uint32_t size = recordSize((uint16_t)len);
+    if (!hasTail_ || tailOffset_ + size > sectorSize_) {
+        int rc = openSector();
+        if (rc != FQ_OK) return rc;
+    }
+    uint32_t crc = ~crc32Update(0xFFFFFFFFu, (const uint8_t*)data, len);
+    uint8_t hdr[FQ_RECORD_HEADER] = {(uint8_t)len, (uint8_t)(len >> 8), FQ_PENDING, 0xFF,
+                                     (uint8_t)crc, (uint8_t)(crc >> 8), (uint8_t)(crc >> 16), (uint8_t)(crc >> 24)};
+    uint32_t at = addr(tail_, tailOffset_);
+    // Header first: a reset between the two writes leaves a CRC mismatch, not a bogus record.
+    if (!storage_.write(at, hdr, sizeof(hdr)) || !storage_.write(at + FQ_RECORD_HEADER, data, len)) {
+        tailOffset_ = sectorSize_; // never write over a half-written record
+        return FQ_ERR_IO;
+    }
+    if (count_ == 0) {
+        head_.sector = tail_;
+        head_.offset = tailOffset_;
+    }
+    tailOffset_ += size;
+    count_++;
+    stats_.appended++;
+    return FQ_OK;
+}
+
+FlashQueueCursor FlashQueue::head() const {
+    return head_;
+}
+
+int FlashQueue::read(FlashQueueCursor& cursor, void* buf, size_t cap) {
+    RecordHeader h;
+    if (!nextRecord(cursor, h)) return 0;
+    size_t n = h.len < cap ? h.len : cap;
+    if (!storage_.read(addr(cursor.sector, cursor.offset + FQ_RECORD_HEADER), buf, n)) return FQ_ERR_IO;
+    cursor.offset += recordSize(h.len);
+    return h.len;
+}
+
+int FlashQueue::pop(size_t n) {
+    RecordHeader h;
+    static const uint8_t consumed = FQ_CONSUMED;
+    while (n > 0 && count_ > 0 && nextRecord(head_, h)) {
+        if (!storage_.write(addr(head_.sector, head_.offset + 2), &consumed, 1)) return FQ_ERR_IO;
+        head_.offset += recordSize(h.len);
+        count_--;
+        n--;
+        stats_.drained++;
+    }
+    return FQ_OK;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "sector_storage.h"
+
+#define FQ_SECTOR_HEADER 8  // magic, sequence number
+#define FQ_RECORD_HEADER 8  // length, state, pad, CRC-32
+
+enum FlashQueueError {
+    FQ_OK = 0,
+    FQ_ERR_IO = -1,        // storage read/write/erase failed
+    FQ_ERR_SIZE = -2,      // record empty or larger than a sector
+    FQ_ERR_GEOMETRY = -3   // fewer than two sectors
+};
+
+struct FlashQueueStats {
+    uint32_t appended;
+    uint32_t drained;
+    uint32_t dropped;      // oldest records overwritten while full
+    uint32_t erases;
+    uint32_t corrupt;      // torn or damaged records skipped at mount
+};
+
+// Position of a record; lets a caller read ahead before popping.
+struct FlashQueueCursor {
+    uint32_t sector;
+    uint32_t offset;
+};
+
+// Append-only record queue over a ring of flash sectors. Records carry a
+// CRC and are never rewritten: popping clears a state byte in place, and a
+// sector is only erased when the writer wraps around to it, so erases are
+// spread evenly over the ring. When the ring is full the oldest sector is
+// erased and its unread records are counted as dropped.
+// Not thread safe.
+class FlashQueue {
+public:
+    explicit FlashQueue(SectorStorage& storage);
+
+    // Scans the storage and recovers head, tail and record count after a
+    // restart. A torn record at the tail ends that sector.
+    int mount();
+    int push(const void* data, size_t len);
+
+    FlashQueueCursor head() const;
+    // Copies the record at cursor into buf and advances the cursor. Returns
+    // the record length (truncated copies report the full length), 0 at the
+    // end of the queue, or a negative FlashQueueError.
+    int read(FlashQueueCursor& cursor, void* buf, size_t cap);
+    // Removes the n oldest records.
+    int pop(size_t n);
+
+    size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    // Largest payload that fits in one record.
+    size_t maxRecord() const { return sectorSize_ - FQ_SECTOR_HEADER - FQ_RECORD_HEADER; }
+    const FlashQueueStats& stats() const { return stats_; }
+
+private:
+    struct RecordHeader {
+        uint16_t len;
+        uint8_t state;  // 0xFF pending, 0x00 consumed
+        uint8_t pad;
+        uint32_t crc;
+    };
+
+    uint32_t addr(uint32_t sector, uint32_t offset) const { return sector * sectorSize_ + offset; }
+    uint32_t next(uint32_t sector) const { return (sector + 1) % sectors_; }
+    bool readSectorSeq(uint32_t sector, uint32_t* seq);
+    bool readHeader(const FlashQueueCursor& c, RecordHeader& h);
+    bool validRecord(const FlashQueueCursor& c, const RecordHeader& h);
+    bool nextRecord(FlashQueueCursor& c, RecordHeader& h, bool* torn = NULL);
+    int openSector();
+
+    SectorStorage& storage_;
+    uint32_t sectorSize_;
+    uint32_t sectors_;
+    bool hasTail_;
+    uint32_t tail_;        // sector being written
+    uint32_t tailOffset_;
+    uint32_t tailSeq_;
+    FlashQueueCursor head_;
+    size_t count_;
+    FlashQueueStats stats_;
+};
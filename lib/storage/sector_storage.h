@@ -0,0 +1,15 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// NOR-flash-like storage: erase() sets a whole sector to 0xFF and write()
+// can only clear bits, so every byte is written once between erases.
+class SectorStorage {
+public:
+    virtual ~SectorStorage() {}
+    virtual uint32_t sectorSize() const = 0;
+    virtual uint32_t sectorCount() const = 0;
+    virtual bool read(uint32_t addr, void* buf, size_t len) = 0;
+    virtual bool write(uint32_t addr, const void* data, size_t len) = 0;
+    virtual bool erase(uint32_t sector) = 0;
+};
@@ -0,0 +1,42 @@
+#include "batch_encoder.h"
+#include <string.h>
+#include "json_writer.h"
+
+#define JSON_SAMPLE_BOUND 40 // "4294967295," "-327.68," "655.35," "429496729.5,"
+#define JSON_HEADER_BOUND 80
+
+size_t batchEncodedBound(size_t n) {
+    return JSON_HEADER_BOUND + n * JSON_SAMPLE_BOUND;
+}
+
+static size_t fitSamples(const SampleRing& ring, size_t maxSamples, size_t idLen, size_t cap) {
+    size_t n = ring.size() < maxSamples ? ring.size() : maxSamples;
+    size_t header = batchEncodedBound(0) + idLen;
+    if (cap <= header) return 0;
+    size_t fit = (cap - header) / JSON_SAMPLE_BOUND;
+    return n < fit ? n : fit;
+}
+
+static size_t encodeJson(const SampleRing& ring, size_t n, const char* deviceId, char* out, size_t cap) {
+    uint32_t t0 = ring.at(0).timestamp;
+    JsonWriter w(out, cap);
+    w.beginObject().key("device_id").value(deviceId).key("t0").value(t0);
+    w.key("dt").beginArray();
+    for (size_t i = 0; i < n; i++) w.value(ring.at(i).timestamp - t0);
+    w.endArray().key("temp").beginArray();
+    for (size_t i = 0; i < n; i++) w.fixed(ring.at(i).tempC100, 2);
+    w.endArray().key("humidity").beginArray();
+    for (size_t i = 0; i < n; i++) w.fixed(ring.at(i).humidityC100, 2);
+    w.endArray().key("light").beginArray();
+    for (size_t i = 0; i < n; i++) w.fixed((int32_t)ring.at(i).lightC10, 1);
+    w.endArray().endObject();
+    return w.ok() ? w.length() : 0;
+}
+
+size_t encodeBatch(const SampleRing& ring, size_t maxSamples, const char* deviceId, uint8_t* out, size_t cap,
+                   size_t* encoded) {
+    size_t n = fitSamples(ring, maxSamples, strlen(deviceId), cap);
+    *encoded = n;
+    if (n == 0) return 0;
+    return encodeJson(ring, n, deviceId, (char*)out, cap);
+}
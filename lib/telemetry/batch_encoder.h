@@ -0,0 +1,14 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "sample_ring.h"
+
+// Upper bound on the encoded size of n samples, excluding the device id.
+size_t batchEncodedBound(size_t n);
+
+// Encodes the oldest samples of ring that fit in cap bytes, at most maxSamples,
+// as columnar JSON for the HTTP batch endpoint:
+//   {"device_id":"..","t0":1700000000,"dt":[0,10],"temp":[25.1,..],"humidity":[..],"light":[..]}
+// Returns bytes written (0 if not even one sample fits); *encoded gets the sample count.
+size_t encodeBatch(const SampleRing& ring, size_t maxSamples, const char* deviceId, uint8_t* out, size_t cap,
+                   size_t* encoded);
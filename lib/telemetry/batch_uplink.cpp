@@ -0,0 +1,38 @@
+#include "batch_uplink.h"
+
+BatchUplink::BatchUplink(SensorSample* storage, size_t capacity, const FlushPolicy& policy)
+    : ring_(storage, capacity), policy_(policy), oldestMs_(0), batches_(0), samplesSent_(0) {}
+
+void BatchUplink::add(const SensorSample& sample, uint32_t nowMs) {
+    if (ring_.empty()) oldestMs_ = nowMs;
+    ring_.push(sample);
+}
+
+bool BatchUplink::shouldFlush(uint32_t nowMs) const {
+    size_t n = ring_.size();
+    if (n == 0) return false;
+    if (n >= policy_.maxSamples || ring_.full()) return true;
+    if (nowMs - oldestMs_ >= policy_.maxAgeMs) return true;
+    return batchEncodedBound(n) >= policy_.maxBytes;
+}
+
+size_t BatchUplink::encode(const char* deviceId, uint8_t* out, size_t cap, size_t* samples) const {
+    if (policy_.maxBytes && cap > policy_.maxBytes) cap = policy_.maxBytes;
+    return encodeBatch(ring_, policy_.maxSamples, deviceId, out, cap, samples);
+}
+
+void BatchUplink::commit(size_t samples, uint32_t nowMs) {
+    ring_.consume(samples);
+    batches_++;
+    samplesSent_ += (uint32_t)samples;
+    // Whatever is left was not in the batch; give it a fresh age window.
+    if (!ring_.empty()) oldestMs_ = nowMs;
+}
+
+size_t BatchUplink::takeOldest(SensorSample* out, size_t max, uint32_t nowMs) {
+    size_t n = ring_.size() < max ? ring_.size() : max;
+    for (size_t i = 0; i < n; i++) out[i] = ring_.at(i);
+    ring_.consume(n);
+    if (!ring_.empty()) oldestMs_ = nowMs;
+    return n;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "batch_encoder.h"
+#include "sample_ring.h"
+
+// A batch is flushed when any limit is reached.
+struct FlushPolicy {
+    size_t maxSamples;  // samples per batch
+    uint32_t maxAgeMs;  // age of the oldest buffered sample
+    size_t maxBytes;    // encoded payload budget
+};
+
+// Buffers samples for one uplink and decides when to send them as a batch.
+class BatchUplink {
+public:
+    BatchUplink(SensorSample* storage, size_t capacity, const FlushPolicy& policy);
+
+    void add(const SensorSample& sample, uint32_t nowMs);
+    bool shouldFlush(uint32_t nowMs) const;
+
+    // Encodes the next batch into out. Returns its length and the sample count in *samples.
+    size_t encode(const char* deviceId, uint8_t* out, size_t cap, size_t* samples) const;
+    // Drops samples once the batch was delivered.
+    void commit(size_t samples, uint32_t nowMs);
+    // Moves up to max of the oldest samples into out, e.g. to spill them to
+    // flash before the ring overwrites them. Returns the count moved.
+    size_t takeOldest(SensorSample* out, size_t max, uint32_t nowMs);
+
+    void rebaseTimestamps(uint32_t before, uint32_t offset) { ring_.rebase(before, offset); }
+
+    void setPolicy(const FlushPolicy& policy) { policy_ = policy; }
+    const FlushPolicy& policy() const { return policy_; }
+    const SampleRing& ring() const { return ring_; }
+    uint32_t batchesSent() const { return batches_; }
+    uint32_t samplesSent() const { return samplesSent_; }
+
+private:
+    SampleRing ring_;
+    FlushPolicy policy_;
+    uint32_t oldestMs_;
+    uint32_t batches_;
+    uint32_t samplesSent_;
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "sensor_sample.h"
+
+// Fixed-capacity FIFO of samples over caller-provided storage. When full the
+// oldest sample is overwritten and counted in dropped().
+class SampleRing {
+public:
+    SampleRing(SensorSample* storage, size_t capacity)
+        : buf_(storage), cap_(capacity), head_(0), count_(0), dropped_(0) {}
+
+    void push(const SensorSample& s) {
+        if (count_ == cap_) {
+            head_ = (head_ + 1) % cap_;
+            count_--;
+            dropped_++;
+        }
+        buf_[(head_ + count_) % cap_] = s;
+        count_++;
+    }
+
+    // i = 0 is the oldest sample.
+    const SensorSample& at(size_t i) const { return buf_[(head_ + i) % cap_]; }
+
+    // Removes the n oldest samples, e.g. after they were delivered.
+    void consume(size_t n) {
+        if (n > count_) n = count_;
+        head_ = (head_ + n) % cap_;
+        count_ -= n;
+    }
+
+    // Adds offset to every timestamp below before, e.g. to move readings
+    // taken before the clock was set from uptime to epoch seconds.
+    void rebase(uint32_t before, uint32_t offset) {
+        for (size_t i = 0; i < count_; i++) {
+            SensorSample& s = buf_[(head_ + i) % cap_];
+            if (s.timestamp < before) s.timestamp += offset;
+        }
+    }
+
+    void clear() { head_ = count_ = 0; }
+    size_t size() const { return count_; }
+    size_t capacity() const { return cap_; }
+    bool empty() const { return count_ == 0; }
+    bool full() const { return count_ == cap_; }
+    uint32_t dropped() const { return dropped_; }
+
+private:
+    SensorSample* buf_;
+    size_t cap_;
+    size_t head_;
+    size_t count_;
+    uint32_t dropped_;
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+
+// One reading in fixed point so a sample fits in 12 bytes.
+struct SensorSample {
+    uint32_t timestamp;   // epoch seconds
+    int16_t tempC100;     // °C * 100
+    uint16_t humidityC100; // %RH * 100
+    uint32_t lightC10;    // lux * 10
+};
+
+inline int16_t toCenti(float v) { return (int16_t)(v * 100.0f + (v < 0 ? -0.5f : 0.5f)); }
+inline uint16_t toCentiU(float v) { return (uint16_t)(v * 100.0f + 0.5f); }
+inline uint32_t toDeci(float v) { return (uint32_t)(v * 10.0f + 0.5f); }
+
+inline SensorSample makeSample(uint32_t timestamp, float temp, float humidity, float light) {
+    SensorSample s;
+    s.timestamp = timestamp;
+    s.tempC100 = toCenti(temp);
+    s.humidityC100 = toCentiU(humidity);
+    s.lightC10 = toDeci(light);
+    return s;
+}
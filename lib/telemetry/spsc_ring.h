@@ -0,0 +1,69 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free FIFO between exactly one producer and one consumer thread, over
+// caller-provided storage whose capacity is a power of two. The producer
+// never waits: when the ring is full the new item is dropped and counted,
+// so a stalled consumer cannot delay it. Fan out to several consumers by
+// giving each its own ring.
+template <class T>
+class SpscRing {
+public:
+    SpscRing(T* storage, size_t capacity)
+        : buf_(isPowerOfTwo(capacity) ? storage : NULL), mask_(buf_ ? (uint32_t)capacity - 1 : 0),
+          head_(0), tail_(0), overflows_(0), highWater_(0) {}
+
+    // Producer side. Returns false (and counts an overflow) when full, or
+    // always if the capacity was not a power of two.
+    bool push(const T& item) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        uint32_t used = head - tail_.load(std::memory_order_acquire);
+        if (used > mask_ || !buf_) {
+            overflows_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        buf_[head & mask_] = item;
+        head_.store(head + 1, std::memory_order_release);
+        if (used + 1 > highWater_.load(std::memory_order_relaxed)) {
+            highWater_.store(used + 1, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Consumer side. Returns false when empty.
+    bool pop(T& out) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail == head_.load(std::memory_order_acquire)) return false;
+        out = buf_[tail & mask_];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: pops up to max items into out, returns the count.
+    size_t drain(T* out, size_t max) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        uint32_t avail = head_.load(std::memory_order_acquire) - tail;
+        size_t n = avail < max ? avail : max;
+        for (size_t i = 0; i < n; i++) out[i] = buf_[(tail + i) & mask_];
+        tail_.store(tail + (uint32_t)n, std::memory_order_release);
+        return n;
+    }
+
+    // Approximate when called from a third thread.
+    size_t size() const { return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire); }
+    size_t capacity() const { return buf_ ? mask_ + 1 : 0; }
+    uint32_t overflows() const { return overflows_.load(std::memory_order_relaxed); }
+    uint32_t highWater() const { return highWater_.load(std::memory_order_relaxed); }
+
+private:
+    static bool isPowerOfTwo(size_t n) { return n && (n & (n - 1)) == 0; }
+
+    T* buf_;
+    uint32_t mask_;
+    std::atomic<uint32_t> head_;      // next slot to write, written by the producer only
+    std::atomic<uint32_t> tail_;      // next slot to read, written by the consumer only
+    std::atomic<uint32_t> overflows_;
+    std::atomic<uint32_t> highWater_; // most items ever queued at once
+};
@@ -0,0 +1,126 @@
+#include "telemetry_frame.h"
+#include "varint.h"
+
+#define SUMMARY_RECORD_BOUND(channels) (2 * VARINT_MAX_BYTES + 1 + (channels) * 4 * VARINT_MAX_BYTES + 2)
+#define ALARM_RECORD_BOUND (2 + 2 * VARINT_MAX_BYTES)
+
+TelemetryFrame::TelemetryFrame(uint8_t* buf, size_t cap) : buf_(buf), cap_(cap) {
+    reset(TELEMETRY_SUMMARY);
+}
+
+void TelemetryFrame::reset(TelemetryFrameType type) {
+    type_ = type;
+    start_ = 0;
+    end_ = TELEMETRY_HEADER_BOUND;
+    count_ = 0;
+    t0_ = last_ = 0;
+}
+
+bool TelemetryFrame::add(const SummaryRecord& r) {
+    if (type_ != TELEMETRY_SUMMARY || r.channels > TELEMETRY_MAX_CHANNELS) return false;
+    if (!reserve(SUMMARY_RECORD_BOUND(r.channels))) return false;
+    if (count_ == 0) t0_ = last_ = r.timestamp;
+    uint8_t* p = buf_ + end_;
+    p = putVarint(p, zigzag((int32_t)(r.timestamp - last_)));
+    p = putVarint(p, r.samples);
+    *p++ = r.channels;
+    uint32_t alarms = 0;
+    for (uint8_t c = 0; c < r.channels; c++) {
+        const ChannelSummary& ch = r.ch[c];
+        p = putVarint(p, zigzag(ch.min));
+        // Float rounding must not turn a zero spread into a huge varint
+        p = putVarint(p, ch.max > ch.min ? (uint32_t)(ch.max - ch.min) : 0);
+        p = putVarint(p, ch.mean > ch.min ? (uint32_t)(ch.mean - ch.min) : 0);
+        p = putVarint(p, ch.sd);
+        alarms |= (uint32_t)(ch.alarm & 3) << (2 * c);
+    }
+    p = putVarint(p, alarms);
+    end_ = p - buf_;
+    last_ = r.timestamp;
+    count_++;
+    return true;
+}
+
+bool TelemetryFrame::add(const AlarmRecord& r) {
+    if (type_ != TELEMETRY_ALARM || !reserve(ALARM_RECORD_BOUND)) return false;
+    if (count_ == 0) t0_ = r.timestamp;
+    uint8_t* p = buf_ + end_;
+    *p++ = r.channel;
+    *p++ = (uint8_t)((r.state & 0x7f) | (r.changed ? 0x80 : 0));
+    p = putVarint(p, zigzag(r.value));
+    p = putVarint(p, zigzag((int32_t)(r.timestamp - t0_)));
+    end_ = p - buf_;
+    count_++;
+    return true;
+}
+
+void TelemetryFrame::finish(uint32_t seq) {
+    uint8_t header[TELEMETRY_HEADER_BOUND];
+    uint8_t* p = header;
+    *p++ = (uint8_t)(TELEMETRY_FRAME_VERSION << 4 | type_);
+    p = putVarint(p, seq);
+    p = putVarint(p, t0_);
+    *p++ = count_;
+    size_t len = p - header;
+    start_ = TELEMETRY_HEADER_BOUND - len;
+    for (size_t i = 0; i < len; i++) buf_[start_ + i] = header[i];
+}
+
+static int decodeHeader(const uint8_t*& p, const uint8_t* end, TelemetryFrameType type, uint32_t* seq,
+                        uint32_t* t0, size_t cap) {
+    if (p >= end || *p++ != (TELEMETRY_FRAME_VERSION << 4 | type)) return -1;
+    if (!getVarint(p, end, seq) || !getVarint(p, end, t0) || p >= end) return -1;
+    uint8_t count = *p++;
+    return count <= cap ? count : -1;
+}
+
+int decodeSummaryFrame(const uint8_t* data, size_t len, uint32_t* seq, SummaryRecord* out, size_t cap) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + len;
+    uint32_t ts;
+    int count = decodeHeader(p, end, TELEMETRY_SUMMARY, seq, &ts, cap);
+    if (count < 0) return -1;
+    for (int i = 0; i < count; i++) {
+        SummaryRecord& r = out[i];
+        uint32_t dt, v;
+        if (!getVarint(p, end, &dt) || !getVarint(p, end, &r.samples) || p >= end) return -1;
+        ts += unzigzag(dt);
+        r.timestamp = ts;
+        r.channels = *p++;
+        if (r.channels > TELEMETRY_MAX_CHANNELS) return -1;
+        for (uint8_t c = 0; c < r.channels; c++) {
+            ChannelSummary& ch = r.ch[c];
+            if (!getVarint(p, end, &v)) return -1;
+            ch.min = unzigzag(v);
+            if (!getVarint(p, end, &v)) return -1;
+            ch.max = ch.min + (int32_t)v;
+            if (!getVarint(p, end, &v)) return -1;
+            ch.mean = ch.min + (int32_t)v;
+            if (!getVarint(p, end, &ch.sd)) return -1;
+        }
+        uint32_t alarms;
+        if (!getVarint(p, end, &alarms)) return -1;
+        for (uint8_t c = 0; c < r.channels; c++) r.ch[c].alarm = (alarms >> (2 * c)) & 3;
+    }
+    return p == end ? count : -1;
+}
+
+int decodeAlarmFrame(const uint8_t* data, size_t len, uint32_t* seq, AlarmRecord* out, size_t cap) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + len;
+    uint32_t t0;
+    int count = decodeHeader(p, end, TELEMETRY_ALARM, seq, &t0, cap);
+    if (count < 0) return -1;
+    for (int i = 0; i < count; i++) {
+        AlarmRecord& r = out[i];
+        uint32_t v, dt;
+        if (end - p < 2) return -1;
+        r.channel = *p++;
+        r.state = *p & 0x7f;
+        r.changed = (*p++ & 0x80) != 0;
+        if (!getVarint(p, end, &v) || !getVarint(p, end, &dt)) return -1;
+        r.value = unzigzag(v);
+        r.timestamp = t0 + unzigzag(dt);
+    }
+    return p == end ? count : -1;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// Compact binary frames for MQTT telemetry. The device id travels in the
+// topic, not in the payload, and one frame can carry several records.
+//
+//   byte   version << 4 | type
+//   varint seq         per-stream counter, gaps reveal lost QoS 0 frames
+//   varint t0          epoch seconds of the first record
+//   byte   count       records that follow
+//
+// Summary record:
+//   zigzag dt (s since the previous record), varint n, byte channels,
+//   per channel: zigzag min, varint max-min, varint mean-min, varint sd,
+//   then varint alarm states, 2 bits per channel
+// Alarm record (one per channel, so the frame is the full alarm state):
+//   byte channel, byte state | 0x80 if it changed in this frame,
+//   zigzag value, zigzag dt (s relative to t0)
+//
+// Values are fixed point, value * 100.
+
+#define TELEMETRY_FRAME_VERSION 1
+#define TELEMETRY_MAX_CHANNELS 4
+#define TELEMETRY_MAX_RECORDS 255
+#define TELEMETRY_HEADER_BOUND 12 // 1 + 5 + 5 + 1
+
+enum TelemetryFrameType {
+    TELEMETRY_SUMMARY = 1,
+    TELEMETRY_ALARM = 2
+};
+
+struct ChannelSummary {
+    int32_t min;   // all * 100
+    int32_t max;
+    int32_t mean;
+    uint32_t sd;
+    uint8_t alarm; // AlarmState
+};
+
+struct SummaryRecord {
+    uint32_t timestamp; // epoch seconds at the end of the interval
+    uint32_t samples;
+    uint8_t channels;
+    ChannelSummary ch[TELEMETRY_MAX_CHANNELS];
+};
+
+struct AlarmRecord {
+    uint32_t timestamp; // when the state last changed, 0 if never
+    uint8_t channel;
+    uint8_t state;      // AlarmState
+    bool changed;       // changed since the previous alarm frame
+    int32_t value;      // smoothed value * 100 at the change
+};
+
+// Scales a reading to the frame's fixed point.
+inline int32_t toFrameValue(float v) { return (int32_t)(v * 100.0f + (v < 0 ? -0.5f : 0.5f)); }
+
+// Builds one frame in a caller buffer. Records are appended after a
+// reserved header, which finish() fills in once the count is known.
+class TelemetryFrame {
+public:
+    TelemetryFrame(uint8_t* buf, size_t cap);
+
+    void reset(TelemetryFrameType type);
+    // Return false, leaving the frame unchanged, when the record does not fit
+    // or its type does not match the frame.
+    bool add(const SummaryRecord& record);
+    bool add(const AlarmRecord& record);
+
+    // Completes the header; data() and length() are valid until the next add/reset.
+    void finish(uint32_t seq);
+    const uint8_t* data() const { return buf_ + start_; }
+    size_t length() const { return end_ - start_; }
+
+    TelemetryFrameType type() const { return type_; }
+    uint8_t count() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    uint32_t firstTimestamp() const { return t0_; }
+
+private:
+    bool reserve(size_t bound) const { return count_ < TELEMETRY_MAX_RECORDS && end_ + bound <= cap_; }
+
+    uint8_t* buf_;
+    size_t cap_;
+    size_t start_;
+    size_t end_;
+    TelemetryFrameType type_;
+    uint8_t count_;
+    uint32_t t0_;
+    uint32_t last_;
+};
+
+// Parse a frame. *seq gets the sequence number. Return the number of records,
+// or -1 if the frame is malformed, of the other type or has more than cap records.
+int decodeSummaryFrame(const uint8_t* data, size_t len, uint32_t* seq, SummaryRecord* out, size_t cap);
+int decodeAlarmFrame(const uint8_t* data, size_t len, uint32_t* seq, AlarmRecord* out, size_t cap);
@@ -0,0 +1,76 @@
+#include "telemetry_publisher.h"
+#include <stdio.h>
+#include <string.h>
+
+TelemetryPublisher::TelemetryPublisher(MqttClient& mqtt, TelemetryFrameType type, const TelemetryStream& stream,
+                                       uint32_t (*nowMs)())
+    : mqtt_(mqtt), type_(type), stream_(stream), nowMs_(nowMs), frame_(buf_, sizeof(buf_)), seq_(0), firstMs_(0) {
+    topic_[0] = '\0';
+    frame_.reset(type);
+    memset(&stats_, 0, sizeof(stats_));
+    if (stream_.maxRecords == 0) stream_.maxRecords = 1;
+}
+
+bool TelemetryPublisher::begin(const char* prefix, const char* deviceId) {
+    int n = snprintf(topic_, sizeof(topic_), "%s/%s/%s", prefix, deviceId, stream_.name);
+    return n > 0 && (size_t)n < sizeof(topic_);
+}
+
+bool TelemetryPublisher::add(const SummaryRecord& record) {
+    return queue(record);
+}
+
+bool TelemetryPublisher::add(const AlarmRecord& record) {
+    return queue(record);
+}
+
+template <class Record>
+bool TelemetryPublisher::queue(const Record& record) {
+    if (frame_.count() >= stream_.maxRecords || !frame_.add(record)) {
+        // Make room by sending what is pending; a QoS 0 frame is dropped if that fails
+        if (!flush(true) && pending()) {
+            stats_.dropped++;
+            return false;
+        }
+        if (!frame_.add(record)) {
+            stats_.dropped++;
+            return false;
+        }
+    }
+    if (frame_.count() == 1) firstMs_ = nowMs_();
+    if (frame_.count() >= stream_.maxRecords) flush(true);
+    return true;
+}
+
+uint32_t TelemetryPublisher::dueInMs() const {
+    if (!pending() || frame_.count() >= stream_.maxRecords) return 0;
+    uint32_t age = nowMs_() - firstMs_;
+    return age >= stream_.maxAgeMs ? 0 : stream_.maxAgeMs - age;
+}
+
+bool TelemetryPublisher::flush(bool force) {
+    if (!pending()) return true;
+    if (!force && dueInMs() > 0) return true;
+    return publish();
+}
+
+bool TelemetryPublisher::publish() {
+    // Offline is not a failure: the frame waits for the broker
+    if (!mqtt_.connected()) return false;
+    frame_.finish(seq_);
+    if (mqtt_.publish(topic_, frame_.data(), frame_.length(), stream_.qos, stream_.retain)) {
+        stats_.frames++;
+        stats_.records += frame_.count();
+        stats_.bytes += frame_.length();
+        seq_++;
+        frame_.reset(type_);
+        return true;
+    }
+    stats_.failures++;
+    if (stream_.qos == 0) {
+        stats_.dropped += frame_.count();
+        seq_++; // the gap tells the receiver a frame was lost
+        frame_.reset(type_);
+    }
+    return false;
+}
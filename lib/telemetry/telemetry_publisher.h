@@ -0,0 +1,69 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include "mqtt_client.h"
+#include "telemetry_frame.h"
+
+#define TELEMETRY_TOPIC_LEN 64
+#define TELEMETRY_FRAME_CAP 256
+
+// How one telemetry stream is published.
+struct TelemetryStream {
+    const char* name;    // topic is <prefix>/<device id>/<name>
+    uint8_t qos;         // 0: a frame the broker refused is dropped; 1: kept and retried
+    bool retain;         // only for last-known-value topics
+    uint8_t maxRecords;  // records packed into one frame
+    uint32_t maxAgeMs;   // a partial frame goes out once its first record is this old
+};
+
+struct TelemetryStats {
+    uint32_t frames;
+    uint32_t records;
+    uint32_t bytes;      // payload bytes published
+    uint32_t failures;   // publish calls that failed
+    uint32_t dropped;    // records lost to failures or a full frame
+};
+
+// Packs records of one type into binary frames and publishes them on the
+// stream's topic. Not thread safe; used from the network task only.
+class TelemetryPublisher {
+public:
+    TelemetryPublisher(MqttClient& mqtt, TelemetryFrameType type, const TelemetryStream& stream,
+                       uint32_t (*nowMs)());
+
+    // Builds the topic. Returns false if it does not fit TELEMETRY_TOPIC_LEN.
+    bool begin(const char* prefix, const char* deviceId);
+
+    // Queue a record; a full frame is published right away. Return false if
+    // the record had to be dropped.
+    bool add(const SummaryRecord& record);
+    bool add(const AlarmRecord& record);
+
+    // Publishes the pending frame when it is full, old enough, or force is
+    // set. Returns false if a frame that was due is still pending or was dropped.
+    bool flush(bool force = false);
+    // Forgets the pending frame, e.g. before rebuilding a last-known-value frame.
+    void discard() { frame_.reset(type_); }
+
+    bool pending() const { return !frame_.empty(); }
+    // ms until the pending frame is due, 0 if it is due now or nothing is pending.
+    uint32_t dueInMs() const;
+    const char* topic() const { return topic_; }
+    const TelemetryStats& stats() const { return stats_; }
+
+private:
+    template <class Record>
+    bool queue(const Record& record);
+    bool publish();
+
+    MqttClient& mqtt_;
+    TelemetryFrameType type_;
+    TelemetryStream stream_;
+    uint32_t (*nowMs_)();
+    char topic_[TELEMETRY_TOPIC_LEN];
+    uint8_t buf_[TELEMETRY_FRAME_CAP];
+    TelemetryFrame frame_;
+    uint32_t seq_;
+    uint32_t firstMs_;
+    TelemetryStats stats_;
+};
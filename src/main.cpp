@@ -1,25 +1,309 @@
+#include <atomic>
+#include <stdarg.h>
 #include <WiFi.h>
 #include <HTTPClient.h>
-#include <HTTPUpdate.h>
 #include <PubSubClient.h>
 #include <Update.h>
 #include <esp_ota_ops.h>
+#include <esp_sntp.h>
+#include <esp_sleep.h>
+#include <esp_pm.h>
 #include "config.h"
+#include "arduino_transport.h"
+#include "mbedtls_transport.h"
+#include "tls_context.h"
+#include "ca_bundle.h"
+#include "http_session_pool.h"
+#include "pooled_transport_factory.h"
+#include "link_manager.h"
+#include "esp_link_backend.h"
+#include "batch_uplink.h"
+#include "spsc_ring.h"
+#include "telemetry_publisher.h"
+#include "json_fields.h"
+#include "api_client.h"
+#include "api_endpoints.h"
+#include "circuit_breaker.h"
+#include "api_payloads.h"
+#include "command_channel.h"
+#include "device_config.h"
+#include "pubsub_mqtt_client.h"
+#include "edge_analytics.h"
+#include "ota_downloader.h"
+#include "fw_version.h"
+#include "firmware_offer.h"
+#include "health_gate.h"
+#include "delta_patch.h"
+#include "esp_flash_writer.h"
+#include "net_scheduler.h"
+#include "task_topology.h"
+#include "flash_queue.h"
+#include "esp_partition_storage.h"
+#include "metrics.h"
+#include "power_manager.h"
+#include "rtc_state.h"
+#include "deferred_log.h"
+#include "event_outbox.h"
+#include "esp_outbox_store.h"
+#ifdef PEER_OTA_PORT
+#include "esp_peer_cache.h"
+#endif
+
+// Runtime metrics (metrics.h), sent with every heartbeat. Histograms are in
+// ms and cover one heartbeat interval; counters run since boot.
+MetricsRegistry metrics;
+const int mHttpMs = metrics.histogram("http_ms");            // request including retries
+const int mHttpAttemptMs = metrics.histogram("http_attempt_ms");
+const int mMqttConnectMs = metrics.histogram("mqtt_connect_ms");
+const int mMqttPublishMs = metrics.histogram("mqtt_publish_ms");
+const int mOtaCheckMs = metrics.histogram("ota_check_ms");
+const int mOtaMs = metrics.histogram("ota_ms");               // download and flash
+const int mNetWakeMs = metrics.histogram("net_wake_ms");      // one runDue() of the HTTP worker
+const int mMqttWakeMs = metrics.histogram("mqtt_wake_ms");    // one runDue() of the MQTT task, the most a publish waits
+const int mHttpRetries = metrics.counter("http_retries");
+const int mHttpFailures = metrics.counter("http_failures");
+const int mHttpRejected = metrics.counter("http_rejected");   // refused by an open circuit, nothing sent
+const int mHttpCircuitsOpen = metrics.gauge("http_circuits_open");
+const int mMqttConnects = metrics.counter("mqtt_connects");
+const int mMqttPublishFailures = metrics.counter("mqtt_publish_failures");
+const int mNetBusyMs = metrics.counter("net_busy_ms");        // time the HTTP worker spent running jobs
+const int mHeapFree = metrics.gauge("heap_free");
+const int mHeapMin = metrics.gauge("heap_min");
+const int mHeapMaxBlock = metrics.gauge("heap_max_block");    // largest allocatable block
+const int mStackHttp = metrics.gauge("stack_http");           // free stack high-water mark, bytes
+const int mStackMqtt = metrics.gauge("stack_mqtt");
+const int mStackSampling = metrics.gauge("stack_sampling");
+const int mStackLoop = metrics.gauge("stack_loop");
+const int mCore0Load = metrics.gauge("core0_load_pct");       // share of the interval spent in our tasks
+const int mCore1Load = metrics.gauge("core1_load_pct");
+const int mTlsHandshakeMs = metrics.histogram("tls_handshake_ms");
+const int mTlsHandshakes = metrics.counter("tls_handshakes");
+const int mTlsResumed = metrics.counter("tls_resumed");     // abbreviated handshakes, no certificate exchange
+const int mTlsFailures = metrics.counter("tls_failures");
+const int mPowerProfile = metrics.gauge("power_profile");    // PowerProfile
+const int mBatteryPct = metrics.gauge("battery_pct");        // -1 on mains
+const int mRadioMsPerReport = metrics.gauge("radio_ms_per_report");
+const int mAvgCurrentUa = metrics.gauge("avg_current_ua");   // estimated from the time in each power mode
+const int mPoolTlsHigh = metrics.gauge("pool_tls_high");     // most TLS transports ever out at once
+const int mPoolTcpHigh = metrics.gauge("pool_tcp_high");
+const int mPoolExhausted = metrics.gauge("pool_exhausted");  // connections refused for want of a transport
+const int mStackLog = metrics.gauge("stack_log");
+const int mLogDropped = metrics.gauge("log_dropped");        // log records lost to a full ring since boot
+const int mOutboxPending = metrics.gauge("outbox_pending");  // OTA logs and Slack lines not yet delivered
+#ifdef PEER_OTA_PORT
+const int mPeerServed = metrics.gauge("peer_served");        // images and ranges handed to LAN peers
+#endif
+
+// Đo thời gian mỗi lần publish; everything else goes straight to the client
+class TimedMqttClient : public MqttClient {
+public:
+    explicit TimedMqttClient(MqttClient& client) : client_(client) {}
+    bool connected() { return client_.connected(); }
+    bool connect(const char* clientId) {
+        uint32_t t0 = millis();
+        bool ok = client_.connect(clientId);
+        metrics.record(mMqttConnectMs, millis() - t0);
+        if (ok) metrics.add(mMqttConnects);
+        return ok;
+    }
+    bool publish(const char* topic, const uint8_t* payload, size_t len, uint8_t qos, bool retain) {
+        uint32_t t0 = millis();
+        bool ok = client_.publish(topic, payload, len, qos, retain);
+        metrics.record(mMqttPublishMs, millis() - t0);
+        if (!ok) metrics.add(mMqttPublishFailures);
+        return ok;
+    }
+    bool subscribe(const char* topic, uint8_t qos) { return client_.subscribe(topic, qos); }
+    void onMessage(MqttMessageFn fn, void* ctx) { client_.onMessage(fn, ctx); }
+    bool loop() { return client_.loop(); }
+    int state() { return client_.state(); }
+
+private:
+    MqttClient& client_;
+};
 
 WiFiClient espClient;
-PubSubClient client(espClient);
-unsigned long lastHeartbeat = 0;
-unsigned long lastOtaCheck = 0;
+PubSubClient pubSubClient(espClient);
+PubSubMqttClient pubSubMqtt(pubSubClient);
+TimedMqttClient mqtt(pubSubMqtt); // publishing code only sees the MqttClient interface
+
+// Bảng lệnh; the handlers run inside mqtt.loop() and hand slow work to jobs
+int otaCommand(const char* json, size_t len, void*);
+int configCommand(const char* json, size_t len, void*);
+int diagCommand(const char* json, size_t len, void*);
+const CommandSpec commandTable[] = {
+    {"ota",    otaCommand,    nullptr},
+    {"config", configCommand, nullptr},
+    {"diag",   diagCommand,   nullptr},
+};
+CommandChannel commands(mqtt, commandTable, sizeof(commandTable) / sizeof(commandTable[0]));
+char diagTopic[CMD_TOPIC_LEN];
 unsigned long lastLog = 0;
 #define LED_RED 13      // Error message (WiFi/OTA fail) - GPIO 13 is safer
 #define LED_GREEN 14    // Normal operation report - GPIO 14 is safer
 
-// FreeRTOS task handles
-TaskHandle_t mqttTaskHandle = NULL;
-TaskHandle_t httpTaskHandle = NULL;
+// Sensor batching: a batch is sent after N samples, T ms or B bytes, whichever comes first
+#define SENSOR_BATCH_SAMPLES 30
+#define SENSOR_BATCH_MAX_AGE_MS 300000
+#define SENSOR_BATCH_MAX_BYTES 1536
+#define SENSOR_BUFFER_CAPACITY 64 // Keeps readings through a few failed flushes
+
+// Edge analytics: MQTT carries one summary per interval, only when a channel
+// moved past its deadband, plus alarm changes instead of every reading
+#define SUMMARY_INTERVAL 60000
+#define SUMMARY_MAX_SILENCE 900000      // a summary goes out at least every 15 minutes
+
+// Binary telemetry frames (telemetry_frame.h) on per-device topics, so the
+// payload does not repeat the device id: edge/<DEVICE_ID>/s carries up to
+// SUMMARY_PACK summaries per publish, edge/<DEVICE_ID>/a is the retained
+// alarm state of every channel
+#define MQTT_TOPIC_PREFIX "edge"
+#define SUMMARY_PACK 5
+#define MQTT_BUFFER_SIZE 512            // frame plus topic, down from 2048
+
+// Commands from the backend on edge/<DEVICE_ID>/cmd or edge/all/cmd, acked on
+// edge/<DEVICE_ID>/ack (command_channel.h). An "ota" command starts the
+// version check within spread_s seconds, so the poll is only a slow fallback.
+#define OTA_SPREAD_MAX_S 3600
 
-// Mutex for shared data
-SemaphoreHandle_t dataMutex = NULL;
+// Store-and-forward: samples the HTTP ring cannot hold are spilled to flash
+// (the unused "spiffs" data partition) and replayed once the server is back
+#define SENSOR_QUEUE_PARTITION "spiffs"
+#define SENSOR_QUEUE_SECTORS 64         // 256 KB, about a day of readings at 5 s
+#define SENSOR_SPILL_SAMPLES 32         // samples per flash record
+#define SENSOR_REPLAY_RECORDS 2         // records per replayed batch
+#define SENSOR_REPLAY_INTERVAL 5000     // pause between replayed batches
+#define SENSOR_REPLAY_MAX_BYTES 3072    // JSON bound for 64 samples plus the device id
+
+const FlushPolicy sensorFlushPolicy = {SENSOR_BATCH_SAMPLES, SENSOR_BATCH_MAX_AGE_MS, SENSOR_BATCH_MAX_BYTES};
+SensorSample httpSamples[SENSOR_BUFFER_CAPACITY];
+BatchUplink httpBatch(httpSamples, SENSOR_BUFFER_CAPACITY, sensorFlushPolicy);
+
+enum SensorChannel { CH_TEMP, CH_HUMIDITY, CH_LIGHT, CH_COUNT };
+const char* const channelNames[CH_COUNT] = {"temp", "humidity", "light"};
+//                                  ewma   high set/clear  low set/clear        hold  deadband  max silence
+const ChannelConfig tempChannel  = {0.3f, {33.0f, 32.5f,   10.0f,     11.0f,     3},   0.3f,     SUMMARY_MAX_SILENCE};
+const ChannelConfig humChannel   = {0.3f, {80.0f, 75.0f,   20.0f,     25.0f,     3},   1.0f,     SUMMARY_MAX_SILENCE};
+const ChannelConfig lightChannel = {0.3f, {INFINITY, INFINITY, -INFINITY, -INFINITY, 0}, 5.0f,  SUMMARY_MAX_SILENCE};
+ChannelAnalytics channels[CH_COUNT] = {
+    ChannelAnalytics(tempChannel), ChannelAnalytics(humChannel), ChannelAnalytics(lightChannel)};
+
+// Last alarm change per channel; pending until the alarm frame carrying it is published
+struct PendingAlarm {
+    bool pending;
+    AlarmState state;
+    float value;
+    uint32_t timestamp;
+};
+PendingAlarm pendingAlarms[CH_COUNT];
+// Sampling pipeline: the sampling task pushes every reading into one
+// lock-free ring per uplink; the HTTP worker and the MQTT task drain them at
+// their own pace
+#define SENSOR_PIPE_CAPACITY 64 // power of two; covers a 5 minute OTA download
+SensorSample httpPipeStorage[SENSOR_PIPE_CAPACITY];
+SensorSample mqttPipeStorage[SENSOR_PIPE_CAPACITY];
+SpscRing<SensorSample> httpPipe(httpPipeStorage, SENSOR_PIPE_CAPACITY);
+SpscRing<SensorSample> mqttPipe(mqttPipeStorage, SENSOR_PIPE_CAPACITY);
+
+EspPartitionStorage sensorQueueStorage(SENSOR_QUEUE_PARTITION, SENSOR_QUEUE_SECTORS);
+FlashQueue sensorQueue(sensorQueueStorage);
+bool sensorQueueReady = false;
+
+// Task topology (task_topology.h): core, priority and stack of every task.
+// Core 1 is kept for the latency critical work: sampling and MQTT publishing
+// outrank everything else that can run there, the Arduino loop included.
+// TLS and HTTP run on a worker without affinity, so a handshake or an OTA
+// download uses whichever core is free and never delays a publish. Core 0
+// also carries the WiFi driver and lwIP. core0/1_load_pct in the heartbeat
+// show what each core spends in these tasks.
+#define SAMPLING_TASK_STACK 3072 // bytes; no network I/O
+#define MQTT_TASK_STACK 6144     // broker, edge analytics, command parsing
+#define HTTP_TASK_STACK 10240    // TLS handshakes, OTA download and flashing
+#define LOG_TASK_STACK 3072      // formats log records, writes the UART
+enum TaskSlot { TASK_SAMPLING, TASK_MQTT, TASK_HTTP, TASK_LOG, TASK_LOOP, TASK_COUNT };
+//                                       name        core           prio stack                isolated
+const TaskSpec taskTable[TASK_COUNT] = {{"Sampling", 1,             5,   SAMPLING_TASK_STACK, true},
+                                        {"MQTT",     1,             4,   MQTT_TASK_STACK,     true},
+                                        {"HTTP",     TASK_ANY_CORE, 2,   HTTP_TASK_STACK,     false},
+                                        {"Log",      0,             1,   LOG_TASK_STACK,      false},
+                                        {"loop",     1,             1,   0,                   false}}; // created by Arduino
+const TopologyLimits taskLimits = {portNUM_PROCESSORS, configMAX_PRIORITIES, 2048};
+TaskHandle_t taskHandles[TASK_COUNT] = {NULL};
+uint32_t poolMillis();
+CoreLoad coreLoad(poolMillis);
+
+// Static allocation mode (-DSTATIC_ALLOCATION, env esp32dev_static): task
+// stacks and TCBs, the event group, transports and TLS record buffers are
+// all reserved at link time or once at boot, so months of uptime cannot
+// fragment the heap; `pio run -e esp32dev_static -t size` shows the total.
+// WiFi, lwIP and PubSubClient's buffer still allocate, once, at startup.
+#ifdef STATIC_ALLOCATION
+#define STATIC_ALLOCATION_ON true
+StackType_t samplingTaskStack[SAMPLING_TASK_STACK];
+StackType_t mqttTaskStack[MQTT_TASK_STACK];
+StackType_t httpTaskStack[HTTP_TASK_STACK];
+StackType_t logTaskStack[LOG_TASK_STACK];
+StackType_t* const taskStacks[TASK_COUNT] = {samplingTaskStack, mqttTaskStack, httpTaskStack, logTaskStack, NULL};
+StaticTask_t taskTcbs[TASK_COUNT];
+StaticEventGroup_t netEventsBuffer;
+#else
+#define STATIC_ALLOCATION_ON false
+#endif
+
+// Network jobs (chu kỳ, độ ưu tiên). Jobs due within NET_COALESCE_MS of each
+// other share one radio wake; slack lets low priority jobs wait for one.
+#define SENSOR_SAMPLE_INTERVAL 5000
+#define MQTT_SERVICE_INTERVAL 10000
+#define HEARTBEAT_INTERVAL 60000
+#define OTA_CHECK_INTERVAL 21600000 // fallback poll, 6 h; updates are pushed as commands
+#define NET_COALESCE_MS 10000
+
+// Power management (power_manager.h). Between uplink windows WiFi is off and
+// the CPU light-sleeps; inside one the radio stays associated in modem
+// sleep. Sampling and uplink intervals can be set in config.h; an uplink
+// interval of 0 keeps WiFi associated (mains powered), battery sites use
+// e.g. 900000. The saver and critical profiles apply only with a battery.
+#ifndef POWER_SAMPLE_INTERVAL
+#define POWER_SAMPLE_INTERVAL SENSOR_SAMPLE_INTERVAL
+#endif
+#ifndef POWER_UPLINK_INTERVAL
+#define POWER_UPLINK_INTERVAL 0
+#endif
+#define POWER_BACKLOG_HIGH 256          // samples in RAM and flash
+#define POWER_WINDOW_MIN_MS 500         // lets queued commands arrive
+#define POWER_WINDOW_MAX_MS 20000       // covers a full scan + DHCP
+#define POWER_RADIO_OFF_MIN_MS 30000    // a fast reconnect plus TLS resumption costs ~1 s
+#define POWER_DEEP_SLEEP_MIN_MS 60000
+#define POWER_WAKE_LEAD_MS 500
+#define POWER_CHECK_INTERVAL 60000      // battery level and budget gauges
+#define MQTT_KEEPALIVE_S 180            // fewer PINGREQ wakes in modem sleep, below common NAT timeouts
+
+// Battery on an ADC pin through a divider; define BATTERY_ADC_PIN in
+// config.h, without it the device counts as mains powered
+#ifndef BATTERY_DIVIDER
+#define BATTERY_DIVIDER 2
+#endif
+#define BATTERY_EMPTY_MV 3300
+#define BATTERY_FULL_MV 4150
+
+// Sampling period, changed at run time by the "config" command and the power profile
+std::atomic<uint32_t> sampleIntervalMs(POWER_SAMPLE_INTERVAL);
+std::atomic<uint32_t> nextSampleMs(0);  // millis() of the next reading, for the power manager
+std::atomic<uint32_t> samplingBeats(0); // one per sampling loop, watched by the health gate
+
+// Post-update health gate: a PENDING_VERIFY image runs normally while
+// healthJob polls the checks, then is marked valid or rolled back
+#define HEALTH_HEAP_FLOOR 40000
+#define HEALTH_SOAK_MS 30000            // heap and watchdog must hold this long
+#define HEALTH_TIMEOUT_MS 180000        // covers a slow WiFi join and the first heartbeat
+#define HEALTH_POLL_INTERVAL 2000
+
+// Wakes the HTTP worker and the MQTT task early (WiFi back up, work posted
+// from the other task) and loop() on WiFi/SNTP events
+EventGroupHandle_t netEvents = NULL;
+#define NET_EVT_HTTP_WAKE (1 << 0)
+#define NET_EVT_LINK (1 << 1)
+#define NET_EVT_MQTT_WAKE (1 << 2)
 
 unsigned long lastErrorBlink = 0;
 bool errorLedState = false;
@@ -27,152 +311,303 @@ bool wifiConnected = false;
 bool otaFailFlag = false;
 bool hasError = false; // Flag to indicate if there is any error
 
-// Global secure client để tái sử dụng kết nối
-WiFiClientSecure* globalSecureClient = nullptr;
-unsigned long lastConnectionTime = 0;
+// Keep-alive HTTP sessions, một kết nối cho mỗi origin (sensor, heartbeat, log, OTA)
 const unsigned long CONNECTION_REUSE_TIMEOUT = 30000; // 30 seconds
 
-// Cấu hình SSL cho ngrok
-void configureSSLClient(WiFiClientSecure* client) {
-    client->setInsecure(); // Tạm thời bypass SSL verification
-    client->setHandshakeTimeout(30); // 30 giây cho handshake
-    client->setTimeout(20000); // 20 giây cho read/write
+uint32_t poolMillis() {
+    return millis();
 }
 
-void addCommonHeaders(HTTPClient &http) {
-    http.addHeader("Content-Type", "application/json");
-    http.addHeader("Authorization", String("Bearer ") + AUTH_TOKEN);
-    // Thêm headers cho ngrok
-    http.addHeader("Connection", "close"); // Không dùng keep-alive với ngrok
-    http.addHeader("Accept", "application/json");
-    http.addHeader("User-Agent", "ESP32-OTA-Client/1.0");
+// Log deferred (deferred_log.h): tasks call LOGx(), which only copies the
+// arguments into this ring; logTask formats and prints them. A full ring
+// drops records instead of blocking, counted in log_dropped.
+#define LOG_RING_RECORDS 32
+#define LOG_DRAIN_IDLE_MS 50 // logTask naps this long once the ring is empty
+LogSlot logSlots[LOG_RING_RECORDS];
+DeferredLog deferredLog(logSlots, LOG_RING_RECORDS, poolMillis);
+
+void printLogLine(const LogLine& line, void*) {
+    char out[LOG_LINE_MAX + 16];
+    Serial.write((const uint8_t*)out, formatLogLine(line, out, sizeof(out)));
 }
 
-// Khởi tạo global secure client
-void initGlobalSecureClient() {
-    if (globalSecureClient == nullptr) {
-        globalSecureClient = new WiFiClientSecure();
-        configureSSLClient(globalSecureClient);
-        Serial.println("[SSL] Global secure client initialized with enhanced config");
+// Before a restart or deep sleep, from whichever task is going down
+void flushLog() {
+    deferredLog.drain(printLogLine, nullptr);
+    Serial.flush();
+}
+
+// TLS với CA được pin; sessions are resumed so a reconnect skips the certificate exchange
+const TlsConfig tlsConfig = {TLS_CA_PEM, 30000, true};
+TlsContext tlsContext(tlsConfig, poolMillis);
+MbedTlsConfig mbedTlsConfig;
+
+void onTlsHandshake(const char* host, bool resumed, uint32_t ms, int error, void*) {
+    if (error != TLS_OK) {
+        metrics.add(mTlsFailures, 1);
+        LOGW(NET, "[TLS] Handshake with %s failed (%d)", host, error);
+        return;
     }
+    metrics.add(mTlsHandshakes, 1);
+    if (resumed) metrics.add(mTlsResumed, 1);
+    metrics.record(mTlsHandshakeMs, ms);
 }
 
-// Kiểm tra và reset connection nếu cần
-void checkAndResetConnection() {
-    unsigned long now = millis();
-    if (globalSecureClient && (now - lastConnectionTime > CONNECTION_REUSE_TIMEOUT)) {
-        Serial.println("[SSL] Resetting secure client connection");
-        globalSecureClient->stop();
-        delete globalSecureClient;
-        globalSecureClient = nullptr;
-        initGlobalSecureClient();
-        lastConnectionTime = now;
+// Statically allocated clients backing the session pool; their high-water
+// marks go out with the heartbeat
+typedef PooledTransportFactory<ArduinoTransport<WiFiClient>, MbedTlsTransport, HTTP_POOL_MAX_SESSIONS>
+    EspTransportFactory;
+
+HttpPoolConfig makePoolConfig() {
+    HttpPoolConfig config = defaultHttpPoolConfig(poolMillis);
+    config.idleTimeoutMs = CONNECTION_REUSE_TIMEOUT;
+    config.ioTimeoutMs = 20000;
+    return config;
+}
+
+// Only used from setup() and then httpTask, so no locking is needed
+EspTransportFactory transportFactory;
+HttpSessionPool httpPool(transportFactory, makePoolConfig());
+
+//                               sample                 uplink                  deep sleep
+const PowerConfig powerConfig = {{{POWER_SAMPLE_INTERVAL, POWER_UPLINK_INTERVAL, false},   // normal
+                                  {60000,                 3600000,               false},   // saver, < 30 %
+                                  {300000,                14400000,              true}},   // critical, < 10 %
+                                 30, 10, 5, POWER_BACKLOG_HIGH, POWER_WINDOW_MIN_MS, POWER_WINDOW_MAX_MS,
+                                 POWER_RADIO_OFF_MIN_MS, POWER_DEEP_SLEEP_MIN_MS, POWER_WAKE_LEAD_MS};
+// Datasheet draw of the module per mode (µA) for the avg_current_ua estimate
+const PowerCurrents moduleCurrents = {{110000, 20000, 800, 10}};
+// Owned by the HTTP worker, except the deep sleep wake path in setup()
+PowerManager power(powerConfig, poolMillis);
+RTC_DATA_ATTR RtcState rtcState;
+esp_pm_lock_handle_t noLightSleepLock = NULL;
+std::atomic<bool> radioFullPower(false);
+bool fullPowerHeld = false;
+// The MQTT task hands the power manager its reports and urgent windows,
+// and tells it when its next radio job is due
+std::atomic<uint32_t> mqttReportsSent(0);
+std::atomic<bool> windowRequested(false);
+std::atomic<uint32_t> mqttRadioDueMs(0);
+
+// POWER_AWAKE: no modem or light sleep, e.g. for an OTA download
+void setFullPower(bool on) {
+    if (on == fullPowerHeld) return;
+    fullPowerHeld = on;
+    radioFullPower = on;
+    if (WiFi.getMode() != WIFI_OFF) WiFi.setSleep(on ? WIFI_PS_NONE : WIFI_PS_MAX_MODEM);
+    if (noLightSleepLock) {
+        if (on) esp_pm_lock_acquire(noLightSleepLock);
+        else esp_pm_lock_release(noLightSleepLock);
     }
 }
 
-// Hàm helper để thực hiện HTTP request với error handling tốt hơn
-int performHTTPRequest(const String& url, const String& method, const String& body = "") {
-    HTTPClient http;
-    int retryCount = 3;
-    int httpCode = -1;
+int readBatteryPercent() {
+#ifdef BATTERY_ADC_PIN
+    uint32_t mv = analogReadMilliVolts(BATTERY_ADC_PIN) * BATTERY_DIVIDER;
+    return batteryPercent(mv, BATTERY_EMPTY_MV, BATTERY_FULL_MV);
+#else
+    return -1;
+#endif
+}
 
-    for (int attempt = 1; attempt <= retryCount; attempt++) {
-        Serial.printf("[HTTP] Attempt %d/%d for URL: %s\n", attempt, retryCount, url.c_str());
+// API endpoints, headers and the device_id member of the bodies, joined at
+// compile time from config.h (api_endpoints.h); a malformed setting fails the build
+static_assert(apiServerValid(OTA_SERVER), "OTA_SERVER must be http(s)://host[:port][/path] without a trailing slash");
+static_assert(apiTokenValid(AUTH_TOKEN), "AUTH_TOKEN must be a non-empty bearer token (letters, digits, -._~+/=)");
+static_assert(apiIdValid(DEVICE_ID), "DEVICE_ID must be non-empty letters, digits, '-', '_' or '.'");
+static_assert(apiIdValid(FIRMWARE_VERSION), "FIRMWARE_VERSION must be non-empty letters, digits, '-', '_' or '.'");
+#ifdef SLACK_WEBHOOK_URL
+static_assert(apiUrlValid(SLACK_WEBHOOK_URL), "SLACK_WEBHOOK_URL must be an http(s) URL");
+#endif
 
-        http.setReuse(false);
-        http.setFollowRedirects(HTTPC_FORCE_FOLLOW_REDIRECTS);
+const char apiHeaders[] = API_HEADERS(AUTH_TOKEN);
+const char deviceMember[] = API_DEVICE_MEMBER(DEVICE_ID);
+const char heartbeatUrl[] = OTA_SERVER API_PATH_HEARTBEAT;
+const char logUrl[] = OTA_SERVER API_PATH_LOG;
+const char batchUrl[] = OTA_SERVER API_PATH_SENSOR_BATCH;
+const char versionUrl[] = OTA_SERVER API_PATH_FIRMWARE_VERSION FIRMWARE_VERSION;
+static_assert(sizeof(versionUrl) <= API_URL_MAX, "OTA_SERVER and FIRMWARE_VERSION too long for the version check URL");
 
-        if (!http.begin(url)) { // Dùng HTTP, không cần WiFiClientSecure
-            Serial.println("[HTTP] Failed to begin HTTP connection");
-            delay(2000);
-            continue;
-        }
+// apiHeaders for a URL on OTA_SERVER's origin (scheme, host, port), NULL for
+// any other: an offer may point at a CDN, which must not see the token
+const char* apiHeadersFor(const char* url) {
+    ParsedUrl server, target;
+    if (!parseUrl(OTA_SERVER, server) || !parseUrl(url, target)) return nullptr;
+    return sameOrigin(server, target) ? apiHeaders : nullptr;
+}
 
-        http.setTimeout(20000);
-        addCommonHeaders(http);
+bool feedFirmwareOffer(const uint8_t* data, size_t len, void* ctx) {
+    return static_cast<FirmwareOfferParser*>(ctx)->feed((const char*)data, len);
+}
 
-        if (method == "POST") {
-            httpCode = http.POST(body);
-        } else {
-            httpCode = http.GET();
-        }
+uint32_t httpAttemptStart = 0;
+
+void httpDelay(uint32_t ms) {
+    delay(ms);
+    httpAttemptStart = millis(); // the next attempt starts after the backoff
+}
 
-        Serial.printf("[HTTP] HTTP response code: %d\n", httpCode);
+void logHttpAttempt(const char* method, const char* url, uint8_t attempt, uint8_t attempts, int code, void*) {
+    LOGI(NET, "[HTTP] %s %s attempt %u/%u: %d", method, url, attempt, attempts, code);
+    metrics.record(mHttpAttemptMs, millis() - httpAttemptStart);
+    if (attempt > 1) metrics.add(mHttpRetries);
+}
 
-        http.end();
+uint32_t schedRandom(uint32_t bound);
 
-        if (httpCode > 0 && httpCode < 400) {
-            Serial.printf("[HTTP] Request successful with code: %d\n", httpCode);
-            return httpCode;
-        }
+// Retries wait a random time below 2 s, 4 s, 8 s so devices that failed
+// together do not retry together
+ApiRetryPolicy apiRetryPolicy() {
+    ApiRetryPolicy policy = defaultApiRetryPolicy(httpDelay);
+    policy.maxRetryDelayMs = 8000;
+    policy.randomMs = schedRandom;
+    return policy;
+}
 
-        delay(2000);
-    }
+// API requests with retry
+ApiClient apiClient(httpPool, apiHeaders, apiRetryPolicy());
+
+// Một circuit breaker cho mỗi endpoint: after a few failures the device stops
+// calling it until a jittered cool-down ends, and a 429 or Retry-After
+// pauses it for as long as the server asked. Jobs wait it out via holdOff().
+const CircuitBreakerConfig apiBreakerConfig = defaultCircuitBreakerConfig();
+CircuitBreaker heartbeatBreaker(apiBreakerConfig, poolMillis, schedRandom);
+CircuitBreaker otaLogBreaker(apiBreakerConfig, poolMillis, schedRandom);
+CircuitBreaker sensorBreaker(apiBreakerConfig, poolMillis, schedRandom); // live batches and flash replay
+CircuitBreaker otaCheckBreaker(apiBreakerConfig, poolMillis, schedRandom);
+CircuitBreaker* const apiBreakers[] = {&heartbeatBreaker, &otaLogBreaker, &sensorBreaker, &otaCheckBreaker};
 
-    Serial.printf("[HTTP] All attempts failed. Final code: %d\n", httpCode);
+// Báo cáo OTA và Slack (event_outbox.h): the update path only queues them,
+// saved to NVS so they survive the restart that follows; outboxJob sends
+// OUTBOX_BATCH per round, OUTBOX_INTERVAL apart, over the pooled connection
+#define OUTBOX_BATCH 4
+#define OUTBOX_INTERVAL 5000
+EspOutboxStore outboxStore;
+EventOutbox outbox(outboxStore);
+void triggerOutbox();
+
+// LAN peer firmware cache (peer_cache.h), opt-in: define PEER_OTA_PORT (e.g.
+// 8070) in config.h. Offers with a sha256 are fetched from a peer on the LAN
+// serving that image before the server is asked, so a rollout to a site
+// crosses its uplink about once. A device serves its own image once the
+// health gate passed; only mains powered ones, the radio of the others is
+// off most of the time.
+#ifdef PEER_OTA_PORT
+#define PEER_OTA_TRIES 2 // peers tried per install before OTA_SERVER
+EspPeerCache peerCache(DEVICE_ID, PEER_OTA_PORT);
+PeerDirectory peerDirectory(peerCache, poolMillis, schedRandom);
+#endif
+
+// Hàm helper để thực hiện HTTP request với error handling tốt hơn
+int performHTTPRequest(const char* url, const char* method, const uint8_t* body, size_t bodyLen,
+                       int retryCount = 3, CircuitBreaker* breaker = nullptr) {
+    uint32_t t0 = millis();
+    httpAttemptStart = t0;
+    int httpCode = apiClient.request(method, url, body, bodyLen, retryCount, nullptr, breaker);
+    if (httpCode == API_ERR_CIRCUIT_OPEN) {
+        LOGW(NET, "[HTTP] %s skipped, circuit %s for %u ms", url, circuitStateName(breaker->state()),
+             (unsigned)breaker->msUntilAllowed());
+        metrics.add(mHttpRejected);
+        return httpCode;
+    }
+    metrics.record(mHttpMs, millis() - t0);
+    if (!ApiClient::succeeded(httpCode)) {
+        LOGW(NET, "[HTTP] All attempts failed. Final code: %d", httpCode);
+        metrics.add(mHttpFailures);
+    }
     return httpCode;
 }
 
-void setup_wifi() {
-    Serial.print("Connecting to WiFi...");
-    digitalWrite(LED_GREEN, LOW);  // Turn off green LED initially
-    digitalWrite(LED_RED, HIGH);   // Turn on red LED to indicate connection attempt
-    wifiConnected = false;
-    WiFi.begin(WIFI_SSID, WIFI_PASS);
-    while (WiFi.status() != WL_CONNECTED) {
-        delay(500);
-        Serial.print(".");
-    }
-    digitalWrite(LED_GREEN, HIGH); // Turn on green LED when connected
-    digitalWrite(LED_RED, LOW);    // Turn off red LED when connected
-    wifiConnected = true;
-    Serial.println("\nWiFi connected!");
-    Serial.print("IP address: ");
-    Serial.println(WiFi.localIP());
-
-    configTime(0, 0, "pool.ntp.org", "time.nist.gov");
-    Serial.println("[WiFi] Waiting for NTP time sync...");
-    time_t now = time(nullptr);
-    while (now < 1700000000) {  // Giá trị ~2023 trở lên
-        delay(500);
-        Serial.print(".");
-        now = time(nullptr);
-    }
-    Serial.println();
-    Serial.print("[WiFi] Time synchronized: ");
-    Serial.println(ctime(&now));
-}
-
-void reconnect() {
-    int retryCount = 0;
-    const int maxRetries = 3;
-    
-    while (!client.connected() && retryCount < maxRetries) {
-        Serial.println("[MQTT] Attempting to connect to broker...");
-        
-        // Generate a unique client ID
-        String clientId = "ESP32Client-";
-        clientId += String(random(0xffff), HEX);
-        
-        if (client.connect(clientId.c_str())) {
-            Serial.println("[MQTT] Connected to broker!");
-            // Subscribe to any required topics here
-            // client.subscribe("topic/example");
-            return;
-        } else {
-            retryCount++;
-            Serial.print("[MQTT] Failed, rc=");
-            Serial.print(client.state());
-            Serial.printf(" attempt %d/%d\n", retryCount, maxRetries);
-            
-            // Exponential backoff
-            delay(3000 * retryCount);
+// WiFi/SNTP bring-up không chặn: cached BSSID/channel/IP first, then a full
+// scan, then backoff. loop() drives it; WiFi events only post to it.
+// The cache is mirrored in RTC memory so a deep sleep wake skips the NVS read
+class RtcLinkBackend : public EspLinkBackend {
+public:
+    RtcLinkBackend(const char* ssid, const char* pass) : EspLinkBackend(ssid, pass) {}
+
+    bool loadCache(LinkCache& out) {
+        if (rtcState.linkValid) {
+            out = rtcState.link;
+            return true;
         }
+        if (!EspLinkBackend::loadCache(out)) return false;
+        keep(out);
+        return true;
     }
-    
-    if (retryCount >= maxRetries) {
-        Serial.println("[MQTT] Max retry attempts reached, will try again later");
+
+    void saveCache(const LinkCache& cache) {
+        keep(cache);
+        EspLinkBackend::saveCache(cache);
     }
+
+private:
+    void keep(const LinkCache& cache) {
+        rtcState.link = cache;
+        rtcState.linkValid = true;
+        rtcStateSeal(rtcState);
+    }
+};
+
+RtcLinkBackend linkBackend(WIFI_SSID, WIFI_PASS);
+LinkManager linkManager(linkBackend, defaultLinkConfig(poolMillis));
+
+void onWiFiEvent(arduino_event_id_t event) {
+    if (event == ARDUINO_EVENT_WIFI_STA_GOT_IP) {
+        linkManager.post(LINK_EVT_GOT_IP);
+    } else if (event == ARDUINO_EVENT_WIFI_STA_DISCONNECTED || event == ARDUINO_EVENT_WIFI_STA_LOST_IP) {
+        linkManager.post(LINK_EVT_LOST);
+    } else {
+        return;
+    }
+    xEventGroupSetBits(netEvents, NET_EVT_LINK);
+}
+
+void onTimeSynced(struct timeval*) {
+    linkManager.post(LINK_EVT_TIME_SYNCED);
+    xEventGroupSetBits(netEvents, NET_EVT_LINK);
+}
+
+// Runs in loop() on every state change
+void onLinkState(LinkState state, void*) {
+    const LinkStats& st = linkManager.stats();
+    switch (state) {
+    case LINK_FAST_CONNECT:
+        LOGI(NET, "[WiFi] Connecting with cached BSSID/channel/IP...");
+        break;
+    case LINK_CONNECT:
+        LOGI(NET, "[WiFi] Connecting (scan + DHCP)...");
+        break;
+    case LINK_BACKOFF:
+        LOGW(NET, "[WiFi] Connect timed out (%u so far), backing off", (unsigned)st.timeouts);
+        break;
+    case LINK_ONLINE:
+        LOGI(NET, "[WiFi] Connected in %u ms, IP address: %s", (unsigned)st.lastConnectMs,
+             WiFi.localIP().toString().c_str());
+        // The radio dozes between beacons unless a download needs full throughput
+        WiFi.setSleep(radioFullPower ? WIFI_PS_NONE : WIFI_PS_MAX_MODEM);
+        // Let both network tasks flush what piled up while offline
+        xEventGroupSetBits(netEvents, NET_EVT_HTTP_WAKE | NET_EVT_MQTT_WAKE);
+        break;
+    default:
+        break;
+    }
+}
+
+// One connection attempt; the scheduler backs off between failures
+bool reconnect() {
+    LOGI(MQTT, "[MQTT] Attempting to connect to broker...");
+
+    // Generate a unique client ID
+    char clientId[24];
+    snprintf(clientId, sizeof(clientId), "ESP32Client-%lx", (unsigned long)random(0xffff));
+
+    if (mqtt.connect(clientId)) {
+        LOGI(MQTT, "[MQTT] Connected to broker!");
+        if (!commands.subscribe()) LOGW(MQTT, "[MQTT] Could not subscribe to the command topics");
+        return true;
+    }
+    LOGW(MQTT, "[MQTT] Failed, rc=%d", mqtt.state());
+    return false;
 }
 
 void blinkErrorLed() {
@@ -184,293 +619,1045 @@ void blinkErrorLed() {
     }
 } 
 
+// Heap and stack gauges, sampled right before each heartbeat
+void sampleSystemMetrics() {
+    metrics.set(mHeapFree, ESP.getFreeHeap());
+    metrics.set(mHeapMin, ESP.getMinFreeHeap());
+    metrics.set(mHeapMaxBlock, ESP.getMaxAllocHeap());
+    metrics.set(mStackHttp, uxTaskGetStackHighWaterMark(taskHandles[TASK_HTTP]));
+    metrics.set(mStackMqtt, uxTaskGetStackHighWaterMark(taskHandles[TASK_MQTT]));
+    metrics.set(mStackSampling, uxTaskGetStackHighWaterMark(taskHandles[TASK_SAMPLING]));
+    metrics.set(mStackLog, uxTaskGetStackHighWaterMark(taskHandles[TASK_LOG]));
+    metrics.set(mStackLoop, uxTaskGetStackHighWaterMark(taskHandles[TASK_LOOP]));
+    uint8_t load[TOPOLOGY_MAX_CORES];
+    coreLoad.sample(load);
+    metrics.set(mCore0Load, load[0]);
+    metrics.set(mCore1Load, load[1]);
+    metrics.set(mPoolTlsHigh, transportFactory.secure().highWater());
+    metrics.set(mPoolTcpHigh, transportFactory.plain().highWater());
+    metrics.set(mPoolExhausted, transportFactory.secure().exhausted() + transportFactory.plain().exhausted());
+    int open = 0;
+    for (CircuitBreaker* breaker : apiBreakers) open += breaker->state() != CIRCUIT_CLOSED;
+    metrics.set(mHttpCircuitsOpen, open);
+    metrics.set(mLogDropped, deferredLog.dropped());
+    metrics.set(mOutboxPending, outbox.size());
+#ifdef PEER_OTA_PORT
+    metrics.set(mPeerServed, peerCache.served());
+#endif
+}
+
 bool sendHeartbeatWithRetry(int maxRetry = 3) {
-    if (String(OTA_SERVER).length() == 0) {
-        Serial.println("[Heartbeat] OTA_SERVER not configured!");
-        return false;
-    }
-    String heartbeatUrl = String(OTA_SERVER) + "/api/heartbeat";
-    if (heartbeatUrl.startsWith("https://")) heartbeatUrl.replace("https://", "http://");
-    String body = String("{\"device_id\":\"") + DEVICE_ID + "\"," +
-                  "\"status\":\"online\"," +
-                  "\"firmware_version\":\"" + FIRMWARE_VERSION + "\"}";
-    Serial.print("[Heartbeat] Sending to: "); Serial.println(heartbeatUrl);
-    int code = performHTTPRequest(heartbeatUrl, "POST", body);
+    const LinkStats& link = linkManager.stats();
+    HeartbeatInfo info;
+    info.deviceId = DEVICE_ID;
+    info.deviceMember = deviceMember;
+    info.firmwareVersion = FIRMWARE_VERSION;
+    info.bootToWifiMs = link.bootToOnlineMs;
+    info.bootToNtpMs = link.bootToTimeMs;
+    info.bootToFirstPublishMs = linkManager.bootToFirstPublishMs();
+    info.wifiFastHits = link.fastHits;
+    info.wifiDrops = link.drops;
+    info.sampleOverflows = httpPipe.overflows() + mqttPipe.overflows();
+    sampleSystemMetrics();
+    char metricsJson[1280];
+    info.metrics = metrics.encode(metricsJson, sizeof(metricsJson)) ? metricsJson : nullptr;
+    char body[1600];
+    size_t len = buildHeartbeat(info, body, sizeof(body));
+    LOGI(NET, "[Heartbeat] Sending %u bytes", (unsigned)len);
+    int code = performHTTPRequest(heartbeatUrl, "POST", (const uint8_t*)body, len, maxRetry, &heartbeatBreaker);
     if (code > 0 && code < 400) {
-        Serial.println("[Heartbeat] Sent successfully!");
+        LOGI(NET, "[Heartbeat] Sent successfully!");
+        power.reportSent();
+        metrics.resetHistograms(); // the next heartbeat covers the next interval
         return true;
     } else {
-        Serial.println("[Heartbeat] Failed to send!");
+        LOGW(NET, "[Heartbeat] Failed to send!");
         otaFailFlag = true;
         return false;
     }
 }
 
-bool sendOtaLogWithRetry(const char* status, const char* version, const char* error_message, int latency_ms, int maxRetry = 3) {
-    if (String(OTA_SERVER).length() == 0) {
-        Serial.println("[OTA Log] OTA_SERVER not configured!");
-        return false;
+// Sends what the outbox hands over: one attempt per request, no sleeps in
+// between; outboxJob reschedules whatever failed
+class ApiOutboxSender : public OutboxSender {
+public:
+    OutboxSendResult sendOtaLog(const OutboxEvent& event) {
+        OtaLogInfo info = {DEVICE_ID, event.status, event.version, event.text, event.latencyMs,
+                           event.hasTransfer ? &event.transfer : nullptr, event.hasHealth ? &event.health : nullptr,
+                           deviceMember, event.count};
+        char body[512];
+        size_t len = buildOtaLog(info, body, sizeof(body));
+        if (len == 0) {
+            LOGE(OTA, "[OTA Log] Payload too large!");
+            return OUTBOX_REJECTED;
+        }
+        LOGI(OTA, "[OTA Log] Sending %s", event.status);
+        return result(performHTTPRequest(logUrl, "POST", (const uint8_t*)body, len, 1, &otaLogBreaker));
     }
-    String logUrl = String(OTA_SERVER) + "/api/log";
-    if (logUrl.startsWith("https://")) logUrl.replace("https://", "http://");
-    String body = String("{\"device_id\":\"") + DEVICE_ID + "\"," +
-                  "\"status\":\"" + status + "\"," +
-                  "\"version\":\"" + version + "\"," +
-                  "\"error_message\":\"" + error_message + "\"," +
-                  "\"latency_ms\":" + String(latency_ms) + "}";
-    Serial.print("[OTA Log] Sending to: "); Serial.println(logUrl);
-    int code = performHTTPRequest(logUrl, "POST", body);
-    if (code > 0 && code < 400) {
-        Serial.println("[OTA Log] Sent successfully!");
-        return true;
-    } else {
-        Serial.println("[OTA Log] Failed to send!");
-        return false;
+
+    // Slack lines queued since the last round, one message
+    OutboxSendResult sendSlack(const char* text, size_t textLen) {
+#ifdef SLACK_WEBHOOK_URL
+        char payload[2 * OUTBOX_SLACK_MAX]; // room for escaping the newlines
+        size_t len = buildSlackMessage(text, textLen, payload, sizeof(payload));
+        if (len == 0) return OUTBOX_REJECTED;
+        // Through the session pool like every API call, so the webhook is held
+        // to the pinned bundle too: its CA has to be in TLS_CA_PEM
+        int code = httpPool.request("POST", SLACK_WEBHOOK_URL, "Content-Type: application/json\r\n",
+                                    (const uint8_t*)payload, len);
+        LOGI(NET, "[Slack] Sent notification, code: %d", code);
+        return result(code);
+#else
+        return OUTBOX_REJECTED; // nothing is queued for Slack without a webhook
+#endif
     }
-}
 
-// Hàm so sánh version dạng x.y.z, trả về 1 nếu v1 > v2, -1 nếu v1 < v2, 0 nếu bằng nhau
-int compareVersion(const String& v1, const String& v2) {
-    int vnum1 = 0, vnum2 = 0;
-    int i = 0, j = 0;
-    while (i < v1.length() || j < v2.length()) {
-        vnum1 = 0;
-        vnum2 = 0;
-        while (i < v1.length() && v1[i] != '.') {
-            vnum1 = vnum1 * 10 + (v1[i] - '0');
-            i++;
-        }
-        while (j < v2.length() && v2[j] != '.') {
-            vnum2 = vnum2 * 10 + (v2[j] - '0');
-            j++;
-        }
-        if (vnum1 > vnum2) return 1;
-        if (vnum1 < vnum2) return -1;
-        i++;
-        j++;
+private:
+    static OutboxSendResult result(int code) {
+        if (ApiClient::succeeded(code)) return OUTBOX_SENT;
+        // Refused for good, except a timeout or a 429 that asks to come back later
+        if (code >= 400 && code < 500 && code != 408 && code != 429) return OUTBOX_REJECTED;
+        return OUTBOX_RETRY;
+    }
+};
+ApiOutboxSender outboxSender;
+
+// Queues an OTA log; it goes out with the next outboxJob round, after the
+// restart if the update restarts first
+void reportOtaLog(const char* status, const char* version, const char* error, int latencyMs,
+                  const OtaStats* transfer = nullptr, const HealthReport* health = nullptr) {
+    if (!outbox.otaLog(status, version, error, latencyMs, transfer, health)) {
+        LOGW(OTA, "[Outbox] Could not save %s, a restart would lose it", status);
     }
-    return 0;
+    triggerOutbox();
 }
 
-// Gửi thông báo lên Slack nếu có webhook
-void sendSlackNotification(const String& message) {
+// Gửi thông báo lên Slack nếu có webhook; printf-style, queued like the OTA logs
+void notifySlack(const char* format, ...) {
 #ifdef SLACK_WEBHOOK_URL
-    HTTPClient http;
-    http.begin(SLACK_WEBHOOK_URL);
-    http.addHeader("Content-Type", "application/json");
-    String payload = String("{\"text\": ") + "\"" + message + "\"}";
-    int code = http.POST(payload);
-    http.end();
-    Serial.printf("[Slack] Sent notification, code: %d\n", code);
+    char message[OUTBOX_TEXT_LEN];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+    if (!outbox.slack(message)) LOGW(NET, "[Outbox] Could not save the Slack notification");
+    triggerOutbox();
 #endif
 }
 
-bool checkAndUpdateFirmware() {
-    if (String(OTA_SERVER).length() == 0) {
-        Serial.println("[OTA] OTA_SERVER not configured!");
-        return false;
+// Bộ đệm ghi flash cho OTA, bội số của sector 4 KB
+#define OTA_WRITE_BUFFER_SIZE 4096
+static uint8_t otaBuffer[OTA_WRITE_BUFFER_SIZE];
+// Patch bytes only feed the delta applier, so a small buffer is enough
+#define OTA_PATCH_BUFFER_SIZE 1024
+static uint8_t otaPatchBuffer[OTA_PATCH_BUFFER_SIZE];
+
+void otaSleep(uint32_t ms) {
+    delay(ms);
+}
+
+void logOtaProgress(const OtaStats& stats, void*) {
+    if (stats.total) {
+        LOGI(OTA, "[OTA] %u/%u bytes (%u%%), %u B/s", (unsigned)stats.bytes, (unsigned)stats.total,
+             (unsigned)((uint64_t)stats.bytes * 100 / stats.total), (unsigned)stats.bytesPerSec());
+    } else {
+        LOGI(OTA, "[OTA] %u bytes, %u B/s", (unsigned)stats.bytes, (unsigned)stats.bytesPerSec());
     }
-    String versionUrl = String(OTA_SERVER) + "/api/firmware/version?device=esp32";
-    Serial.print("[OTA] Checking firmware version at: ");
-    Serial.println(versionUrl);
+}
 
-    HTTPClient http;
-    WiFiClientSecure secureClient;
-    secureClient.setHandshakeTimeout(30);
-    secureClient.setTimeout(20000);
+const char* otaErrorMessage(int result) {
+    switch (result) {
+        case OTA_ERR_HTTP: return "OTA download refused by server";
+        case OTA_ERR_NETWORK: return "OTA download failed after retries";
+        case OTA_ERR_WRITE: return "OTA flash write failed";
+        case OTA_ERR_DIGEST: return "OTA image SHA-256 mismatch";
+        case OTA_ERR_SIZE: return "OTA image size mismatch";
+        case OTA_ERR_COMMIT: return "OTA image could not be activated";
+        default: return "OTA failed";
+    }
+}
 
-    http.setReuse(false);
-    http.setFollowRedirects(HTTPC_FORCE_FOLLOW_REDIRECTS);
+// Tải url vào writer, in tiến độ và thống kê tốc độ; headers NULL for peers
+// and other hosts, which must not see the API token
+int downloadFirmware(const char* url, const char* headers, FlashWriter& writer, uint8_t* buffer, size_t bufferSize,
+                     const char* sha256, OtaStats* stats) {
+    OtaDownloader ota(httpPool, writer, buffer, bufferSize, defaultOtaConfig(poolMillis, otaSleep));
+    ota.onProgress(logOtaProgress, nullptr);
+    int ret = ota.run(url, headers, sha256);
+    *stats = ota.stats();
+    LOGI(OTA, "[OTA] %u bytes in %u ms, %u B/s, stalled %u ms, %u attempt(s)", (unsigned)stats->bytes,
+         (unsigned)stats->elapsedMs, (unsigned)stats->bytesPerSec(), (unsigned)stats->stallMs,
+         (unsigned)stats->attempts);
+    return ret;
+}
 
-    if (!http.begin(secureClient, versionUrl)) {
-        Serial.println("[OTA] Failed to begin HTTP connection");
-        otaFailFlag = true;
-        return false;
+#ifdef PEER_OTA_PORT
+// Full image from a LAN peer, checked against the offer's sha256
+int fetchFromPeer(const char* url, const char* sha256, void* stats) {
+    LOGI(OTA, "[OTA] Downloading from peer: %s", url);
+    EspUpdateWriter flash;
+    return downloadFirmware(url, nullptr, flash, otaBuffer, sizeof(otaBuffer), sha256, static_cast<OtaStats*>(stats));
+}
+#endif
+
+// Tải và cài bản cập nhật; restarts on success, returns only on failure
+void installFirmware(const FirmwareOffer& offer) {
+    LOGI(OTA, "[OTA] New firmware available: %s", offer.version);
+    notifySlack("[OTA] New firmware available: %s", offer.version);
+    httpPool.closeAll(); // Free pooled TLS buffers before the download
+    setFullPower(true);  // modem sleep would throttle the download; a failed install drops it at the next plan
+    digitalWrite(LED_GREEN, LOW);
+    digitalWrite(LED_RED, HIGH);
+    unsigned long t0 = millis();
+    if (!offer.sha256[0]) LOGW(OTA, "[OTA] No sha256 in the offer, digest not checked");
+    const char* expectedSha = offer.sha256[0] ? offer.sha256 : nullptr;
+    OtaStats st;
+    int ret = OTA_ERR_HTTP;
+    uint32_t imageSize = 0;
+#ifdef PEER_OTA_PORT
+    if (expectedSha && peerDirectory.refresh() > 0) {
+        ret = fetchFromPeers(peerDirectory, expectedSha, PEER_OTA_TRIES, fetchFromPeer, &st, nullptr);
+        if (ret == OTA_OK) imageSize = st.bytes;
+    }
+#endif
+    if (ret != OTA_OK && offer.patchUrl[0] && strcmp(offer.patchFrom, FIRMWARE_VERSION) == 0) {
+        LOGI(OTA, "[OTA] Downloading delta patch from: %s", offer.patchUrl);
+        EspPartitionSource running;
+        EspUpdateWriter flash;
+        DeltaPatchWriter patch(running, flash, otaBuffer, sizeof(otaBuffer));
+        patch.expectTarget(expectedSha);
+        ret = downloadFirmware(offer.patchUrl, apiHeadersFor(offer.patchUrl), patch, otaPatchBuffer,
+                               sizeof(otaPatchBuffer), offer.patchSha256[0] ? offer.patchSha256 : nullptr, &st);
+        if (ret == OTA_OK) {
+            imageSize = patch.targetSize();
+        } else {
+            // Không áp dụng được patch thì tải bản đầy đủ
+            LOGW(OTA, "[OTA] Delta update failed (%d, patch error %d), using full image", ret, patch.error());
+            reportOtaLog("delta_failed", offer.version, otaErrorMessage(ret), millis() - t0, &st);
+        }
+    }
+    if (ret != OTA_OK) {
+        LOGI(OTA, "[OTA] Downloading from: %s", offer.url);
+        EspUpdateWriter flash;
+        ret = downloadFirmware(offer.url, apiHeadersFor(offer.url), flash, otaBuffer, sizeof(otaBuffer), expectedSha,
+                               &st);
+        imageSize = st.bytes;
+    }
+    int latency = millis() - t0;
+    metrics.record(mOtaMs, latency);
+    if (ret == OTA_OK) {
+        LOGI(OTA, "[OTA] Update successful, %u byte image", (unsigned)imageSize);
+#ifdef PEER_OTA_PORT
+        if (expectedSha) {
+            // What this device will serve to its peers once the image proves healthy
+            PeerImage installed = {};
+            snprintf(installed.version, sizeof(installed.version), "%s", offer.version);
+            snprintf(installed.sha256, sizeof(installed.sha256), "%s", expectedSha);
+            installed.size = imageSize;
+            peerImageSave(installed);
+        }
+#endif
+        // Saved to NVS; the new image sends them once it is online
+        reportOtaLog("update_success", offer.version, "", latency, &st);
+        notifySlack("[OTA] Update successful: %s", offer.version);
+        flushLog();
+        ESP.restart();
     }
+    LOGE(OTA, "[OTA] Update failed, code: %d", ret);
+    reportOtaLog("update_failed", offer.version, otaErrorMessage(ret), latency, &st);
+    notifySlack("[OTA] Update failed: %s", offer.version);
+    otaFailFlag = true;
+}
 
-    int httpCode = http.GET();
-    Serial.printf("[OTA] Version check response code: %d\n", httpCode);
+bool checkAndUpdateFirmware() {
+    LOGI(OTA, "[OTA] Checking firmware version");
 
-    if (httpCode == HTTP_CODE_TEMPORARY_REDIRECT || 
-        httpCode == HTTP_CODE_FOUND || 
-        httpCode == HTTP_CODE_MOVED_PERMANENTLY) {
-        String redirectedUrl = http.header("Location");
-        Serial.printf("[OTA] Redirected to: %s\n", redirectedUrl.c_str());
-        httpCode = 200; // Treat as success for ngrok redirects
+    if (!otaCheckBreaker.allow()) {
+        LOGW(OTA, "[OTA] Version check skipped, server paused us for %u ms",
+             (unsigned)otaCheckBreaker.msUntilAllowed());
+        metrics.add(mHttpRejected);
+        return false;
     }
 
+    // Parse the response as it streams in instead of buffering the whole body
+    FirmwareOffer offer;
+    FirmwareOfferParser versionInfo(offer);
+    HttpResponse resp;
+    uint32_t t0 = millis();
+    int httpCode = httpPool.request("GET", versionUrl, apiHeaders, nullptr, 0,
+                                    &resp, feedFirmwareOffer, &versionInfo);
+    metrics.record(mOtaCheckMs, millis() - t0);
+    otaCheckBreaker.record(httpCode, httpCode > 0 ? resp.retryAfterS : 0);
+    LOGI(OTA, "[OTA] Version check response code: %d", httpCode);
+
     if (httpCode == 200) {
-        String payload = http.getString();
-        Serial.print("[OTA] Response payload: "); Serial.println(payload);
-        int vIdx = payload.indexOf("\"version\":");
-        int urlIdx = payload.indexOf("\"url\":");
-        if (vIdx > 0 && urlIdx > 0) {
-            String newVersion = payload.substring(vIdx + 11, payload.indexOf('"', vIdx + 12));
-            String url = payload.substring(urlIdx + 7, payload.indexOf('"', urlIdx + 8));
-            Serial.printf("[OTA] Current version: %s, Available version: %s\n", FIRMWARE_VERSION, newVersion.c_str());
-            int cmp = compareVersion(newVersion, FIRMWARE_VERSION);
-            if (cmp > 0) {
-                Serial.print("[OTA] New firmware available: "); Serial.println(newVersion);
-                Serial.print("[OTA] Downloading from: "); Serial.println(url);
-                sendSlackNotification(String("[OTA] New firmware available: ") + newVersion);
-                http.end();
-                digitalWrite(LED_GREEN, LOW);
-                digitalWrite(LED_RED, HIGH);
-                unsigned long t0 = millis();
-                t_httpUpdate_return ret;
-                if (url.startsWith("https://")) {
-                    WiFiClientSecure secureClient2;
-                    secureClient2.setHandshakeTimeout(30);
-                    secureClient2.setTimeout(30000);
-                    ret = HTTPUpdate().update(secureClient2, url.c_str());
-                } else {
-                    ret = HTTPUpdate().update(espClient, url.c_str());
-                }
-                int latency = millis() - t0;
-                if (ret == HTTP_UPDATE_OK) {
-                    Serial.println("[OTA] Update successful!");
-                    sendOtaLogWithRetry("update_success", newVersion.c_str(), "", latency);
-                    sendSlackNotification(String("[OTA] Update successful: ") + newVersion);
-                    delay(2000);
-                    ESP.restart();
-                } else {
-                    Serial.print("[OTA] Update failed, code: "); Serial.println((int)ret);
-                    sendOtaLogWithRetry("update_failed", newVersion.c_str(), "OTA failed", latency);
-                    sendSlackNotification(String("[OTA] Update failed: ") + newVersion);
-                    otaFailFlag = true;
-                }
+        if (versionInfo.finish()) {
+            LOGI(OTA, "[OTA] Current version: %s, Available version: %s", FIRMWARE_VERSION, offer.version);
+            if (compareVersion(offer.version, FIRMWARE_VERSION) > 0) {
+                installFirmware(offer);
                 return true;
             } else {
-                Serial.println("[OTA] Firmware is up to date.");
+                LOGI(OTA, "[OTA] Firmware is up to date.");
             }
         } else {
-            Serial.println("[OTA] Failed to parse version response");
+            LOGW(OTA, "[OTA] Failed to parse version response");
         }
     } else {
-        Serial.print("[OTA] Failed to check firmware version, HTTP code: "); Serial.println(httpCode);
+        LOGW(OTA, "[OTA] Failed to check firmware version, HTTP code: %d", httpCode);
         otaFailFlag = true;
     }
-    http.end();
     return false;
 }
 
-void sendSensorDataHttp(float temp, float humidity, float light, int maxRetry = 3) {
-    if (String(OTA_SERVER).length() == 0) {
-        Serial.println("[Sensor] OTA_SERVER not configured!");
-        return;
-    }
-    String sensorUrl = String(OTA_SERVER) + "/api/sensor";
-    if (sensorUrl.startsWith("https://")) sensorUrl.replace("https://", "http://");
-    String body = String("{\"device_id\":\"") + DEVICE_ID + "\"," +
-                  "\"temp\":" + String(temp, 2) + "," +
-                  "\"humidity\":" + String(humidity, 2) + "," +
-                  "\"light\":" + String(light, 2) + "}";
-    Serial.print("[Sensor] Sending to: "); Serial.println(sensorUrl);
-    int code = performHTTPRequest(sensorUrl, "POST", body);
+// Gửi các mẫu đang đệm thành một batch lên /api/sensor/batch
+bool sendSensorBatchHttp(int maxRetry = 3) {
+    static uint8_t body[SENSOR_BATCH_MAX_BYTES];
+    size_t samples = 0;
+    size_t len = httpBatch.encode(DEVICE_ID, body, sizeof(body), &samples);
+    if (len == 0) return false;
+    int code = performHTTPRequest(batchUrl, "POST", body, len, maxRetry, &sensorBreaker);
     if (code > 0 && code < 400) {
-        Serial.println(" -> Success!");
+        httpBatch.commit(samples, millis());
+        linkManager.markFirstPublish();
+        power.reportSent();
+        LOGI(SENSOR, "[Sensor] Sent batch of %u samples (%u bytes)", (unsigned)samples, (unsigned)len);
+        return true;
     } else {
-        Serial.println(" -> Failed!");
+        LOGW(SENSOR, "[Sensor] Batch of %u samples failed, %u kept for the next flush", (unsigned)samples,
+             (unsigned)httpBatch.ring().size());
         otaFailFlag = true;
+        return false;
+    }
+}
+
+// Seconds to add to readings stamped before SNTP answered, 0 until it has
+uint32_t epochOffset() {
+    time_t epoch = time(nullptr);
+    return epoch >= LINK_EPOCH_VALID ? (uint32_t)epoch - millis() / 1000 : 0;
+}
+
+uint32_t fixTimestamp(uint32_t ts) {
+    return ts < LINK_EPOCH_VALID ? ts + epochOffset() : ts;
+}
+
+//                                         name qos retain pack          max age
+const TelemetryStream summaryStream = {"s", 0,  false, SUMMARY_PACK, SUMMARY_PACK * SUMMARY_INTERVAL};
+const TelemetryStream alarmStream   = {"a", 1,  true,  CH_COUNT,     0};
+TelemetryPublisher summaryPublisher(mqtt, TELEMETRY_SUMMARY, summaryStream, poolMillis);
+TelemetryPublisher alarmPublisher(mqtt, TELEMETRY_ALARM, alarmStream, poolMillis);
+
+// Tóm tắt min/max/mean/sd của mỗi kênh trong interval vừa qua; the frame
+// goes out once SUMMARY_PACK summaries are in it or the oldest is due
+void queueSensorSummary(const RunningStats* stats) {
+    SummaryRecord record;
+    record.timestamp = fixTimestamp(millis() / 1000);
+    record.samples = stats[CH_TEMP].count();
+    record.channels = CH_COUNT;
+    for (int c = 0; c < CH_COUNT; c++) {
+        record.ch[c].min = toFrameValue(stats[c].min());
+        record.ch[c].max = toFrameValue(stats[c].max());
+        record.ch[c].mean = toFrameValue(stats[c].mean());
+        record.ch[c].sd = (uint32_t)toFrameValue(stats[c].stddev());
+        record.ch[c].alarm = channels[c].alarm();
     }
+    if (!summaryPublisher.add(record)) LOGW(MQTT, "[MQTT] Summary frame full, summary dropped");
 }
 
-// MQTT Task - runs on Core 1
+bool flushSensorSummaries() {
+    uint32_t frames = summaryPublisher.stats().frames;
+    bool ok = summaryPublisher.flush();
+    if (summaryPublisher.stats().frames != frames) {
+        linkManager.markFirstPublish();
+        mqttReportsSent++;
+        LOGI(MQTT, "[MQTT] Published summaries, %u records in %u bytes so far",
+             (unsigned)summaryPublisher.stats().records, (unsigned)summaryPublisher.stats().bytes);
+    }
+    return ok;
+}
+
+// Rebuilds the alarm frame from every channel, so the retained message is
+// always the full current state
+bool publishAlarmState() {
+    alarmPublisher.discard();
+    for (int c = 0; c < CH_COUNT; c++) {
+        const PendingAlarm& alarm = pendingAlarms[c];
+        AlarmRecord record = {alarm.timestamp ? fixTimestamp(alarm.timestamp) : 0, (uint8_t)c, (uint8_t)alarm.state,
+                              alarm.pending, toFrameValue(alarm.value)};
+        alarmPublisher.add(record);
+    }
+    if (!alarmPublisher.flush(true)) return false;
+    mqttReportsSent++;
+    for (int c = 0; c < CH_COUNT; c++) {
+        if (!pendingAlarms[c].pending) continue;
+        LOGI(MQTT, "[MQTT] Alarm %s: %s (%.2f)", channelNames[c], alarmStateName(pendingAlarms[c].state),
+             pendingAlarms[c].value);
+        pendingAlarms[c].pending = false;
+    }
+    return true;
+}
+
+uint32_t schedRandom(uint32_t bound) {
+    return (uint32_t)random((long)bound);
+}
+
+// One scheduler per network task, each over the state only its jobs touch.
+// The MQTT task has the broker, the edge analytics and the publishers; the
+// HTTP worker has the session pool, the breakers, the batch, the flash queue
+// and the power manager. The MQTT side reaches HTTP jobs via httpMailbox.
+NetScheduler mqttScheduler(poolMillis, schedRandom, NET_COALESCE_MS);
+NetScheduler httpScheduler(poolMillis, schedRandom, NET_COALESCE_MS);
+JobMailbox httpMailbox(poolMillis);
+int analyticsJob = -1;
+int summaryJob = -1;
+int alarmJob = -1;
+int diagJob = -1;
+int ingestJob = -1;
+int sensorHttpJob = -1;
+int sensorReplayJob = -1;
+int otaJob = -1;
+int healthJob = -1;
+int heartbeatJob = -1;
+int bootJob = -1;
+int peerServeJob = -1;
+int outboxJob = -1;
+
+// Reports are queued from setup() too, before the job exists
+void triggerOutbox() {
+    if (outboxJob >= 0) httpScheduler.trigger(outboxJob);
+}
+
+// A failed API job retries no sooner than its endpoint's circuit allows;
+// until then another attempt would only be refused locally
+JobResult retryAfterCircuit(int job, const CircuitBreaker& breaker) {
+    httpScheduler.holdOff(job, breaker.msUntilAllowed());
+    return JOB_RETRY;
+}
+
+// Ghi các mẫu cũ nhất ra flash trước khi ring ghi đè lên chúng
+void spillSensorSamples() {
+    SensorSample spill[SENSOR_SPILL_SAMPLES];
+    size_t n = httpBatch.takeOldest(spill, SENSOR_SPILL_SAMPLES, millis());
+    if (!sensorQueueReady || sensorQueue.push(spill, n * sizeof(SensorSample)) != FQ_OK) {
+        LOGE(SENSOR, "[Queue] Could not store %u samples, they are lost", (unsigned)n);
+        return;
+    }
+    LOGI(SENSOR, "[Queue] Stored %u samples in flash (%u records pending)", (unsigned)n,
+         (unsigned)sensorQueue.size());
+}
+
+// Batch size from the "config" command, applied by the HTTP worker; 0 when unchanged
+std::atomic<uint16_t> batchSamplesWanted(0);
+
+// Moves new readings from the sampling pipeline into the HTTP batch
+JobResult ingestSamplesJob(void*) {
+    uint16_t batchSamples = batchSamplesWanted.exchange(0);
+    if (batchSamples) {
+        FlushPolicy policy = httpBatch.policy();
+        policy.maxSamples = batchSamples;
+        httpBatch.setPolicy(policy);
+    }
+    SensorSample samples[16];
+    unsigned long now = millis();
+    size_t n;
+    while ((n = httpPipe.drain(samples, 16)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            if (httpBatch.ring().full()) spillSensorSamples();
+            httpBatch.add(samples[i], now);
+        }
+    }
+    // Readings taken before SNTP answered carry seconds since boot
+    uint32_t offset = epochOffset();
+    if (offset) httpBatch.rebaseTimestamps(LINK_EPOCH_VALID, offset);
+    // A failing upload keeps its backoff instead of retrying at every sample
+    if (httpBatch.shouldFlush(now) && httpScheduler.jobStats(sensorHttpJob).failStreak == 0) {
+        httpScheduler.trigger(sensorHttpJob);
+    }
+    return JOB_DONE;
+}
+
+// Feeds new readings to the edge analytics on the MQTT task
+JobResult analyticsSamplesJob(void*) {
+    SensorSample samples[16];
+    size_t n;
+    while ((n = mqttPipe.drain(samples, 16)) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            const float values[CH_COUNT] = {samples[i].tempC100 / 100.0f, samples[i].humidityC100 / 100.0f,
+                                            samples[i].lightC10 / 10.0f};
+            for (int c = 0; c < CH_COUNT; c++) {
+                if (!channels[c].add(values[c])) continue;
+                PendingAlarm alarm = {true, channels[c].alarm(), channels[c].smoothed(), samples[i].timestamp};
+                pendingAlarms[c] = alarm;
+                mqttScheduler.trigger(alarmJob);
+                // Alarms do not wait for the next uplink window
+                windowRequested = true;
+                xEventGroupSetBits(netEvents, NET_EVT_HTTP_WAKE);
+            }
+        }
+    }
+    return JOB_DONE;
+}
+
+// Send buffered sensor data as one batch (giảm số request lên server)
+JobResult sensorHttpJobFn(void*) {
+    if (httpBatch.ring().size() == 0) return JOB_DONE;
+    if (!sendSensorBatchHttp(1)) return retryAfterCircuit(sensorHttpJob, sensorBreaker);
+    // Server reachable again: start draining what was stored while offline
+    if (sensorQueueReady && !sensorQueue.empty()) httpScheduler.trigger(sensorReplayJob);
+    return JOB_DONE;
+}
+
+// Gửi lại một batch từ flash; live data has higher priority, and batches
+// are spaced SENSOR_REPLAY_INTERVAL apart so replay never floods the link
+JobResult sensorReplayJobFn(void*) {
+    if (!sensorQueueReady || sensorQueue.empty()) return JOB_DONE;
+    static SensorSample replaySamples[SENSOR_SPILL_SAMPLES * SENSOR_REPLAY_RECORDS];
+    SampleRing ring(replaySamples, SENSOR_SPILL_SAMPLES * SENSOR_REPLAY_RECORDS);
+    SensorSample record[SENSOR_SPILL_SAMPLES];
+    FlashQueueCursor cursor = sensorQueue.head();
+    size_t records = 0;
+    int len;
+    while (records < SENSOR_REPLAY_RECORDS && (len = sensorQueue.read(cursor, record, sizeof(record))) > 0) {
+        for (size_t i = 0; i < len / sizeof(SensorSample); i++) ring.push(record[i]);
+        records++;
+    }
+    static uint8_t body[SENSOR_REPLAY_MAX_BYTES];
+    size_t samples = 0;
+    size_t bodyLen = encodeBatch(ring, ring.size(), DEVICE_ID, body, sizeof(body), &samples);
+    if (bodyLen == 0 || samples != ring.size()) {
+        LOGW(SENSOR, "[Queue] Stored batch does not fit the replay buffer, skipping it");
+        sensorQueue.pop(records); // do not block the queue behind it
+        return JOB_DONE;
+    }
+    int code = performHTTPRequest(batchUrl, "POST", body, bodyLen, 1, &sensorBreaker);
+    if (code <= 0 || code >= 400) return retryAfterCircuit(sensorReplayJob, sensorBreaker);
+    sensorQueue.pop(records);
+    power.reportSent();
+    LOGI(SENSOR, "[Queue] Replayed %u samples, %u records left", (unsigned)samples, (unsigned)sensorQueue.size());
+    if (!sensorQueue.empty()) httpScheduler.triggerIn(sensorReplayJob, SENSOR_REPLAY_INTERVAL);
+    return JOB_DONE;
+}
+
+// Đóng interval và gửi tóm tắt nếu có kênh thay đổi quá deadband
+JobResult summaryJobFn(void*) {
+    if (channels[CH_TEMP].interval().count() == 0) return JOB_DONE;
+    if (!mqtt.connected()) return JOB_RETRY; // keep accumulating until the broker is back
+    RunningStats stats[CH_COUNT];
+    bool report = false;
+    for (int c = 0; c < CH_COUNT; c++) report |= channels[c].closeInterval(millis(), &stats[c]);
+    if (report) queueSensorSummary(stats);
+    flushSensorSummaries();
+    return JOB_DONE;
+}
+
+JobResult alarmJobFn(void*) {
+    if (!mqtt.connected()) return JOB_RETRY;
+    return publishAlarmState() ? JOB_DONE : JOB_RETRY;
+}
+
+// Giữ kết nối MQTT: connect khi mất, loop() khi đã kết nối
+JobResult mqttServiceJob(void*) {
+    if (!mqtt.connected() && !reconnect()) return JOB_RETRY;
+    mqtt.loop();
+    return JOB_DONE;
+}
+
+JobResult heartbeatJobFn(void*) {
+    LOGI(NET, "[Net] Sending heartbeat...");
+    return sendHeartbeatWithRetry(1) ? JOB_DONE : retryAfterCircuit(heartbeatJob, heartbeatBreaker);
+}
+
+// Lệnh "ota" chỉ đẩy sớm lần hỏi version: otaCheckJob asks the authenticated
+// version endpoint as usual. Set by the MQTT task, cleared by the HTTP worker.
+std::atomic<bool> otaCheckPushed(false);
+
+JobResult otaCheckJob(void*) {
+    otaCheckPushed = false;
+    LOGI(OTA, "[Net] Checking for OTA update...");
+    checkAndUpdateFirmware();
+    return JOB_DONE;
+}
+
+// {"cmd":"ota","id":"r1","version":"1.3.0","spread_s":120}
+// Starts the version check early. What to install, where from and its
+// sha256 come from OTA_SERVER, never from the broker; a url or sha256 in
+// the command is ignored. version, if given, lets devices already on it
+// skip the check. spread_s spreads a fleet-wide rollout over a random delay
+// so the devices do not all hit the OTA server at once.
+int otaCommand(const char* json, size_t len, void*) {
+    char version[32];
+    char spread[12];
+    JsonField fields[] = {{"version", version, sizeof(version), false}, {"spread_s", spread, sizeof(spread), false}};
+    JsonFieldExtractor extractor(fields, 2);
+    if (!extractor.feed(json, len) || !extractor.finish()) return CMD_ERR_ARGS;
+    uint32_t spreadS = 0;
+    if (fields[1].found && !parseUint32(spread, &spreadS)) return CMD_ERR_ARGS;
+    if (fields[0].found && compareVersion(version, FIRMWARE_VERSION) <= 0) {
+        LOGI(CMD, "[Cmd] Firmware %s announced, already on %s", version, FIRMWARE_VERSION);
+        return CMD_SKIPPED;
+    }
+    if (otaCheckPushed) {
+        LOGW(CMD, "[Cmd] Update pushed, an earlier push is still waiting");
+        return CMD_SKIPPED;
+    }
+    if (spreadS > OTA_SPREAD_MAX_S) spreadS = OTA_SPREAD_MAX_S;
+    otaCheckPushed = true;
+    uint32_t delayMs = spreadS ? schedRandom(spreadS * 1000) : 0;
+    LOGI(CMD, "[Cmd] Update pushed, checking the version in %u ms", (unsigned)delayMs);
+    httpMailbox.post(otaJob, delayMs);
+    xEventGroupSetBits(netEvents, NET_EVT_HTTP_WAKE);
+    return CMD_OK;
+}
+
+// {"cmd":"config","id":"c1","sample_interval_ms":10000,"batch_samples":20}
+int configCommand(const char* json, size_t len, void*) {
+    ConfigUpdate update;
+    int status = parseConfigCommand(json, len, SENSOR_BUFFER_CAPACITY, &update);
+    if (status != CMD_OK) return status;
+    if (update.hasSampleInterval) {
+        sampleIntervalMs = update.sampleIntervalMs;
+        LOGI(CMD, "[Cmd] Sample interval set to %u ms", (unsigned)update.sampleIntervalMs);
+    }
+    if (update.hasBatchSamples) {
+        batchSamplesWanted = update.batchSamples; // the batch belongs to the HTTP worker
+        LOGI(CMD, "[Cmd] HTTP batch set to %u samples", (unsigned)update.batchSamples);
+    }
+    return CMD_OK;
+}
+
+// {"cmd":"diag","id":"d1"}: the snapshot goes out on edge/<DEVICE_ID>/diag
+int diagCommand(const char*, size_t, void*) {
+    mqttScheduler.trigger(diagJob);
+    return CMD_OK;
+}
+
+// The HTTP side of the diagnostics, refreshed by the HTTP worker after every pass
+struct UplinkSnapshot {
+    std::atomic<uint32_t> bufferedSamples;
+    std::atomic<uint32_t> queuedRecords;
+    std::atomic<uint32_t> apiRequests;
+    std::atomic<uint32_t> apiFailures;
+};
+UplinkSnapshot uplinkSnapshot;
+
+void refreshUplinkSnapshot() {
+    uplinkSnapshot.bufferedSamples = httpBatch.ring().size();
+    uplinkSnapshot.queuedRecords = sensorQueueReady ? sensorQueue.size() : 0;
+    uplinkSnapshot.apiRequests = apiClient.stats().requests;
+    uplinkSnapshot.apiFailures = apiClient.stats().failures;
+}
+
+JobResult diagJobFn(void*) {
+    if (!mqtt.connected()) return JOB_RETRY;
+    DiagnosticsInfo info;
+    info.deviceId = DEVICE_ID;
+    info.deviceMember = deviceMember;
+    info.firmwareVersion = FIRMWARE_VERSION;
+    info.uptimeMs = millis();
+    info.freeHeap = ESP.getFreeHeap();
+    info.minFreeHeap = ESP.getMinFreeHeap();
+    info.rssi = WiFi.RSSI();
+    info.sampleIntervalMs = sampleIntervalMs.load();
+    info.bufferedSamples = uplinkSnapshot.bufferedSamples;
+    info.queuedRecords = uplinkSnapshot.queuedRecords;
+    info.apiRequests = uplinkSnapshot.apiRequests;
+    info.apiFailures = uplinkSnapshot.apiFailures;
+    info.telemetryFrames = summaryPublisher.stats().frames + alarmPublisher.stats().frames;
+    info.telemetryDropped = summaryPublisher.stats().dropped + alarmPublisher.stats().dropped;
+    info.commands = commands.stats().received;
+    char body[512];
+    size_t len = buildDiagnostics(info, body, sizeof(body));
+    if (!len) return JOB_DONE;
+    return mqtt.publish(diagTopic, (const uint8_t*)body, len, 0, false) ? JOB_DONE : JOB_RETRY;
+}
+
+// Chạy một lần sau khi có mạng (HTTPS probe); setup() no longer waits for
+// WiFi, so it runs from the HTTP worker instead
+void testPublicHTTPS();
+
+JobResult bootReportJob(void*) {
+    LOGI(NET, "[Setup] Bắt đầu test HTTPS endpoint công khai để xác định lỗi SSL...");
+    testPublicHTTPS();
+    return JOB_DONE;
+}
+
+// Gửi các báo cáo trong outbox, OUTBOX_BATCH per round; a failure waits for
+// the OTA log circuit and the job's backoff, so an outage is not hammered
+JobResult outboxJobFn(void*) {
+    if (outbox.empty()) return JOB_DONE;
+    OutboxDelivery d = outbox.deliver(outboxSender, OUTBOX_BATCH);
+    if (d.sent || d.rejected) {
+        LOGI(OTA, "[Outbox] %u sent, %u rejected, %u left", (unsigned)d.sent, (unsigned)d.rejected,
+             (unsigned)d.pending);
+    }
+    if (d.failed) return retryAfterCircuit(outboxJob, otaLogBreaker);
+    if (d.pending) httpScheduler.triggerIn(outboxJob, OUTBOX_INTERVAL);
+    return JOB_DONE;
+}
+
+// What the health gate samples; every probe only reads state the tasks keep
+class DeviceHealthProbes : public HealthProbes {
+public:
+    bool wifiConnected() { return linkManager.online(); }
+    bool mqttRoundTrip() { return metrics.count(mMqttConnects) > 0; }
+    bool httpRoundTrip() { return apiClient.stats().requests > apiClient.stats().failures; }
+    uint32_t minFreeHeap() { return ESP.getMinFreeHeap(); }
+    // Software watchdog over the sampling task; the HTTP worker runs the gate itself
+    bool watchdogTripped() {
+        uint32_t beats = samplingBeats.load();
+        uint32_t now = millis();
+        if (beats != lastBeats_) {
+            lastBeats_ = beats;
+            lastBeatMs_ = now;
+        }
+        return now - lastBeatMs_ > 3 * sampleIntervalMs.load() + 1000;
+    }
+
+private:
+    uint32_t lastBeats_ = 0;
+    uint32_t lastBeatMs_ = 0;
+};
+
+DeviceHealthProbes healthProbes;
+//                                     required           heap floor          soak            timeout
+const HealthGateConfig healthConfig = {HEALTH_ALL_CHECKS, HEALTH_HEAP_FLOOR, HEALTH_SOAK_MS, HEALTH_TIMEOUT_MS};
+HealthGate healthGate(healthProbes, healthConfig, poolMillis);
+
+// Kiểm tra firmware mới; thay cho delay(30000) trong setup()
+JobResult healthJobFn(void*) {
+    if (!healthGate.active()) return JOB_DONE;
+    HealthVerdict verdict = healthGate.poll();
+    if (verdict == HEALTH_PENDING) {
+        httpScheduler.triggerIn(healthJob, HEALTH_POLL_INTERVAL);
+        return JOB_DONE;
+    }
+    const HealthReport& report = healthGate.report();
+    if (verdict == HEALTH_PASSED) {
+        esp_ota_mark_app_valid_cancel_rollback();
+        LOGI(OTA, "[OTA] Firmware %s healthy after %u ms, marked valid", FIRMWARE_VERSION,
+             (unsigned)report.elapsedMs);
+        reportOtaLog("healthy", FIRMWARE_VERSION, "", report.elapsedMs, nullptr, &report);
+#ifdef PEER_OTA_PORT
+        httpScheduler.trigger(peerServeJob);
+#endif
+        return JOB_DONE;
+    }
+    char failed[48];
+    healthCheckList(report.failed, failed, sizeof(failed));
+    LOGE(OTA, "[OTA] Firmware %s failed health checks (%s) after %u ms, rolling back", FIRMWARE_VERSION, failed,
+         (unsigned)report.elapsedMs);
+    reportOtaLog("health_failed", FIRMWARE_VERSION, failed, report.elapsedMs, nullptr, &report);
+    notifySlack("[OTA] Firmware %s failed health checks: %s", FIRMWARE_VERSION, failed);
+    // The image we roll back to may predate the outbox, so one round goes
+    // out now; what fails stays queued for whoever reads it
+    outbox.deliver(outboxSender, OUTBOX_BATCH);
+    flushLog();
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+    return JOB_DONE;
+}
+
+#ifdef PEER_OTA_PORT
+// Phục vụ image đang chạy cho các peer trong LAN, once it is known good: the
+// health gate passed and the partition still hashes to the sha256 the update
+// was verified against (about a second of flash reads)
+JobResult peerServeJobFn(void*) {
+    if (POWER_UPLINK_INTERVAL || healthGate.active() || peerCache.serving()) return JOB_DONE;
+    PeerImage image;
+    if (!peerImageLoad(image) || strcmp(image.version, FIRMWARE_VERSION) != 0) return JOB_DONE;
+    EspPartitionSource running;
+    if (!peerImageMatches(running, image, otaBuffer, sizeof(otaBuffer))) {
+        LOGW(OTA, "[Peer] Running image does not hash to the saved %s, not serving it", image.version);
+        return JOB_DONE;
+    }
+    if (!peerCache.serve(image)) return JOB_RETRY;
+    LOGI(OTA, "[Peer] Serving %s (%u bytes) on port %u", image.version, (unsigned)image.size, (unsigned)PEER_OTA_PORT);
+    return JOB_DONE;
+}
+#endif
+
+// Pin mức pin và cập nhật profile; also refreshes the power budget gauges
+JobResult powerJobFn(void*) {
+    PowerProfile before = power.profile();
+    int battery = readBatteryPercent();
+    power.setBattery(battery);
+    if (power.profile() != before) {
+        sampleIntervalMs = power.sampleIntervalMs();
+        LOGI(POWER, "[Power] Battery %d%%, %s profile: sample every %u s, uplink every %u s", battery,
+             powerProfileName(power.profile()), (unsigned)(power.sampleIntervalMs() / 1000),
+             (unsigned)(power.uplinkIntervalMs() / 1000));
+    }
+    metrics.set(mPowerProfile, power.profile());
+    metrics.set(mBatteryPct, battery);
+    metrics.set(mRadioMsPerReport, (int32_t)powerRadioMsPerReport(power.stats()));
+    metrics.set(mAvgCurrentUa, (int32_t)powerAverageMicroamps(power.stats(), moduleCurrents));
+    return JOB_DONE;
+}
+
+// Close keep-alive connections that the next wake will not reuse in time
+JobResult evictIdleJob(void*) {
+    httpPool.evictIdle();
+    return JOB_DONE;
+}
+
+void setupNetJobs() {
+    // MQTT task
+    //                  name          fn                   ctx      period                  jitter slack  prio radio  retry base/max
+    JobSpec analytics = {"analytics", analyticsSamplesJob, nullptr, SENSOR_SAMPLE_INTERVAL, 0,     0,     9,   false, 0,    0};
+    JobSpec alarm     = {"alarm",     alarmJobFn,          nullptr, 0,                      0,     0,     8,   true,  5000, 60000};
+    JobSpec broker    = {"mqtt",      mqttServiceJob,      nullptr, MQTT_SERVICE_INTERVAL,  0,     0,     7,   true,  3000, 60000};
+    JobSpec summary   = {"summary",   summaryJobFn,        nullptr, SUMMARY_INTERVAL,       0,     5000,  6,   true,  5000, 60000};
+    JobSpec diag      = {"diag",      diagJobFn,           nullptr, 0,                      0,     0,     4,   true,  5000, 60000};
+    analyticsJob = mqttScheduler.add(analytics, SENSOR_SAMPLE_INTERVAL);
+    alarmJob = mqttScheduler.add(alarm, 0);
+    mqttScheduler.add(broker, 0);
+    summaryJob = mqttScheduler.add(summary, SUMMARY_INTERVAL);
+    diagJob = mqttScheduler.add(diag, 0);
+
+    // HTTP worker
+    //                name            fn                ctx      period                  jitter slack  prio radio  retry base/max
+    JobSpec ingest = {"ingest",       ingestSamplesJob, nullptr, SENSOR_SAMPLE_INTERVAL, 0,     0,     9,   false, 0,    0};
+    JobSpec http   = {"sensor-http",  sensorHttpJobFn,  nullptr, 0,                      0,     0,     8,   true,  5000, 120000};
+    JobSpec replay = {"sensor-replay", sensorReplayJobFn, nullptr, 0,                     0,     0,     3,   true,  10000, 300000};
+    JobSpec beat   = {"heartbeat",    heartbeatJobFn,   nullptr, HEARTBEAT_INTERVAL,     5000,  15000, 5,   true,  5000, 60000};
+    JobSpec ota    = {"ota",          otaCheckJob,      nullptr, OTA_CHECK_INTERVAL,     30000, 60000, 1,   true,  0,    0};
+    JobSpec evict  = {"evict",        evictIdleJob,     nullptr, CONNECTION_REUSE_TIMEOUT, 0,   0,     0,   false, 0,    0};
+    JobSpec boot   = {"boot-report",  bootReportJob,    nullptr, 0,                      0,     0,     6,   true,  5000, 60000};
+    JobSpec report = {"outbox",       outboxJobFn,      nullptr, 0,                      0,     0,     4,   true,  10000, 300000};
+    JobSpec health = {"health",       healthJobFn,      nullptr, 0,                      0,     0,     9,   false, 0,    0};
+    JobSpec pwr    = {"power",        powerJobFn,       nullptr, POWER_CHECK_INTERVAL,   0,     0,     2,   false, 0,    0};
+    ingestJob = httpScheduler.add(ingest, SENSOR_SAMPLE_INTERVAL);
+    sensorHttpJob = httpScheduler.add(http, 0);
+    sensorReplayJob = httpScheduler.add(replay, 0);
+    heartbeatJob = httpScheduler.add(beat, HEARTBEAT_INTERVAL);
+    otaJob = httpScheduler.add(ota, OTA_CHECK_INTERVAL);
+    healthJob = httpScheduler.add(health, 0);
+    httpScheduler.trigger(httpScheduler.add(pwr, 0)); // read the battery before the first window
+    if (healthGate.active()) httpScheduler.trigger(healthJob);
+    httpScheduler.add(evict, CONNECTION_REUSE_TIMEOUT);
+    bootJob = httpScheduler.add(boot, 0);
+    httpScheduler.trigger(bootJob); // once, as soon as WiFi is up
+    outboxJob = httpScheduler.add(report, 0);
+    if (!outbox.empty()) httpScheduler.trigger(outboxJob); // left by the last boot or queued by setup()
+#ifdef PEER_OTA_PORT
+    JobSpec peer   = {"peer-serve",   peerServeJobFn,   nullptr, 0,                      0,     0,     1,   true,  10000, 300000};
+    peerServeJob = httpScheduler.add(peer, 0);
+    httpScheduler.trigger(peerServeJob); // again by healthJob after an update
+#endif
+}
+
+// Đọc cảm biến (giả lập); timestamps fall back to seconds since boot until SNTP answers
+SensorSample readSensors() {
+    float temp = 25.0 + (rand() % 1000) / 100.0;
+    float humidity = 50.0 + (rand() % 1000) / 100.0;
+    float light = 100.0 + (rand() % 1000) / 10.0;
+    time_t epoch = time(nullptr);
+    uint32_t timestamp = epoch >= LINK_EPOCH_VALID ? (uint32_t)epoch : millis() / 1000;
+    return makeSample(timestamp, temp, humidity, light);
+}
+
+// Sampling Task - highest priority on the isolated core, at a fixed rate.
+// It never touches the network, so slow TLS calls cannot shift the sampling
+// instants; a full ring drops the reading and counts it instead of blocking.
+void samplingTask(void *pvParameters) {
+    LOGI(CORE, "[Sampling Task] Started on Core %d", xPortGetCoreID());
+    TickType_t lastWake = xTaskGetTickCount();
+    while (true) {
+        uint32_t t0 = micros();
+        SensorSample sample = readSensors();
+        httpPipe.push(sample);
+        mqttPipe.push(sample);
+        samplingBeats++;
+        coreLoad.add(xPortGetCoreID(), micros() - t0);
+        uint32_t interval = sampleIntervalMs.load();
+        nextSampleMs = millis() + interval;
+        vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(interval));
+    }
+}
+
+// Readings that were not sent yet go to RTC memory (the rest to flash), then
+// the chip sleeps; setup() picks them up after the wake. The edge analytics
+// state is not kept, so the first summary after a full boot starts fresh.
+void enterDeepSleep(uint32_t sleepMs) {
+    ingestSamplesJob(nullptr);
+    while (httpBatch.ring().size() > (size_t)(RTC_SAMPLE_CAPACITY - rtcState.sampleCount)) spillSensorSamples();
+    SensorSample samples[16];
+    size_t n;
+    while ((n = httpBatch.takeOldest(samples, 16, millis())) > 0) {
+        for (size_t i = 0; i < n; i++) rtcPushSample(rtcState, samples[i]);
+    }
+    rtcState.power = power.save(sleepMs);
+    rtcStateSeal(rtcState);
+    LOGI(POWER, "[Power] Deep sleep for %u s, %u samples in RTC memory", (unsigned)(sleepMs / 1000),
+         (unsigned)rtcState.sampleCount);
+    flushLog();
+    esp_sleep_enable_timer_wakeup((uint64_t)sleepMs * 1000);
+    esp_deep_sleep_start();
+}
+
+// Applies the power manager's plan after each scheduler pass: radio on or off
+// for the uplink window, full power or modem sleep, or deep sleep. Returns
+// how long the HTTP worker may wait before the next window opens.
+uint32_t applyPowerPlan() {
+    static bool radioOn = true;
+    bool online = linkManager.online();
+    power.setOnline(online);
+    power.setBusy(healthGate.active());
+    power.setBacklog(httpBatch.ring().size() + (sensorQueueReady ? sensorQueue.size() * SENSOR_SPILL_SAMPLES : 0));
+    int32_t toSample = (int32_t)(nextSampleMs.load() - millis());
+    // The radio is needed by whichever task wants it first
+    uint32_t radioIn = httpScheduler.msUntilRadio();
+    int32_t mqttRadioIn = (int32_t)(mqttRadioDueMs.load() - millis());
+    if (mqttRadioIn < (int32_t)radioIn) radioIn = mqttRadioIn > 0 ? (uint32_t)mqttRadioIn : 0;
+    PowerPlan plan = power.plan(radioIn, toSample > 0 ? (uint32_t)toSample : 0);
+    setFullPower(plan.mode == POWER_AWAKE);
+    if (plan.mode == POWER_DEEP_SLEEP) enterDeepSleep(plan.sleepMs);
+
+    bool wanted = power.radioWanted();
+    if (wanted != radioOn) {
+        radioOn = wanted;
+        if (wanted) {
+            linkManager.resume();
+        } else {
+            httpPool.closeAll(); // TLS sessions stay cached for the next window
+            linkManager.suspend();
+            LOGI(POWER, "[Power] Radio off, next window in %u s", (unsigned)(power.msUntilWindow() / 1000));
+        }
+        xEventGroupSetBits(netEvents, NET_EVT_LINK); // loop() drives the link
+    }
+    return wanted ? SCHED_IDLE_MS : power.msUntilWindow();
+}
+
+// MQTT Task - isolated core, below sampling only. Keeps the broker
+// connection and publishes summaries and alarms; it never waits on HTTP or
+// TLS, so a slow HTTPS call no longer leaves gaps in the MQTT stream.
 void mqttTask(void *pvParameters) {
-    Serial.println("[MQTT Task] Started on Core " + String(xPortGetCoreID()));
-    TickType_t xLastWakeTime = xTaskGetTickCount();
-    
+    LOGI(CORE, "[MQTT Task] Started on Core %d", xPortGetCoreID());
+    bool firstFlush = true;
     while (true) {
-        if (WiFi.status() == WL_CONNECTED) {
-            if (!client.connected()) {
-                reconnect();
-            }
-            
-            if (client.connected()) {
-                client.loop();
-                
-                // Generate sensor data
-                float temp = 25.0 + (rand() % 1000) / 100.0;
-                float humidity = 50.0 + (rand() % 1000) / 100.0;
-                float light = 100.0 + (rand() % 1000) / 10.0;
-                
-                // Publish to MQTT with QoS 1 and retain flag
-                char payload[128];
-                snprintf(payload, sizeof(payload), 
-                    "{\"device_id\":\"%s\",\"temp\":%.2f,\"humidity\":%.2f,\"light\":%.2f}", 
-                    DEVICE_ID, temp, humidity, light);
-                
-                if (client.publish("edge/sensor/data", payload, true)) {
-                    Serial.print("[MQTT] Published: "); Serial.println(payload);
-                } else {
-                    Serial.println("[MQTT] Failed to publish message");
-                }
-            }
+        bool radio = linkManager.online();
+        if (radio && firstFlush) {
+            firstFlush = false;
+            mqttScheduler.trigger(summaryJob);
+            mqttScheduler.trigger(alarmJob); // replace the retained state left by the previous boot
+        }
+        mqttScheduler.setRadioAvailable(radio);
+        uint32_t t0 = micros();
+        uint32_t sleepMs = mqttScheduler.runDue();
+        uint32_t busyUs = micros() - t0;
+        coreLoad.add(xPortGetCoreID(), busyUs);
+        if (busyUs >= 1000) metrics.record(mMqttWakeMs, busyUs / 1000);
+        mqttRadioDueMs = millis() + mqttScheduler.msUntilRadio();
+        if (sleepMs > 0) {
+            xEventGroupWaitBits(netEvents, NET_EVT_MQTT_WAKE, pdTRUE, pdFALSE, pdMS_TO_TICKS(sleepMs));
         }
-        
-        // Use proper FreeRTOS delay
-        vTaskDelayUntil(&xLastWakeTime, pdMS_TO_TICKS(5000));
     }
 }
 
-// HTTP Task - runs on Core 1
+// HTTP Task - the TLS/HTTP worker, thay cho httpTask. No core affinity:
+// FreeRTOS runs it on whichever core is free, and on core 1 it only gets
+// the time sampling and MQTT leave. It owns the session pool, so a second
+// worker would only queue behind the first. Also runs the power plan.
+// Sleeps until the next job deadline, a job posted by the MQTT task, or
+// until loop() reports WiFi back up.
 void httpTask(void *pvParameters) {
-    Serial.println("[HTTP Task] Started on Core " + String(xPortGetCoreID()));
-    
+    LOGI(CORE, "[HTTP Task] Started on Core %d", xPortGetCoreID());
+    bool radioWasUp = false;
+    bool firstFlush = true;
     while (true) {
-        if (WiFi.status() == WL_CONNECTED) {
-            // Generate sensor data
-            float temp = 25.0 + (rand() % 1000) / 100.0;
-            float humidity = 50.0 + (rand() % 1000) / 100.0;
-            float light = 100.0 + (rand() % 1000) / 10.0;
-            
-            // Send sensor data via HTTP (giảm tần suất để tránh overload)
-            sendSensorDataHttp(temp, humidity, light);
-            
-            // Send heartbeat every 60 seconds (tăng từ 30s)
-            unsigned long now = millis();
-            if (now - lastHeartbeat > 60000) {
-                Serial.println("[HTTP Task] Sending heartbeat...");
-                sendHeartbeatWithRetry();
-                lastHeartbeat = now;
-            }
-            
-            // Check for OTA update every 5 minutes (tăng từ 60s)
-            if (now - lastOtaCheck > 300000) {
-                Serial.println("[HTTP Task] Checking for OTA update...");
-                checkAndUpdateFirmware();
-                lastOtaCheck = now;
-            }
-        } else {
-            Serial.println("[HTTP Task] WiFi not connected, waiting...");
+        bool radio = linkManager.online();
+        // Pooled connections are dead once WiFi drops
+        if (radioWasUp && !radio) httpPool.closeAll();
+        if (radio && firstFlush) {
+            // Gửi ngay các mẫu đầu tiên instead of waiting for a full batch
+            firstFlush = false;
+            httpScheduler.trigger(ingestJob);
+            httpScheduler.trigger(sensorHttpJob);
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(10000)); // Tăng delay lên 10 seconds để giảm tải
+        radioWasUp = radio;
+        httpMailbox.deliver(httpScheduler);
+        if (windowRequested.exchange(false)) power.requestWindow();
+        for (uint32_t n = mqttReportsSent.exchange(0); n > 0; n--) power.reportSent();
+        httpScheduler.setRadioAvailable(radio);
+        uint32_t t0 = micros();
+        uint32_t sleepMs = httpScheduler.runDue();
+        uint32_t busyUs = micros() - t0;
+        coreLoad.add(xPortGetCoreID(), busyUs); // where it finished; it may have moved meanwhile
+        if (busyUs >= 1000) {
+            metrics.record(mNetWakeMs, busyUs / 1000);
+            metrics.add(mNetBusyMs, busyUs / 1000);
+        }
+        refreshUplinkSnapshot();
+        uint32_t window = applyPowerPlan();
+        if (window < sleepMs) sleepMs = window;
+        if (sleepMs > 0 && httpMailbox.empty()) {
+            xEventGroupWaitBits(netEvents, NET_EVT_HTTP_WAKE, pdTRUE, pdFALSE, pdMS_TO_TICKS(sleepMs));
+        }
+    }
+}
+
+// Log Task - lowest priority on core 0: prints what the other tasks logged
+// whenever nothing else wants the CPU, so no task waits for the UART
+void logTask(void *pvParameters) {
+    LOGI(CORE, "[Log Task] Started on Core %d", xPortGetCoreID());
+    while (true) {
+        if (deferredLog.drain(printLogLine, nullptr) == 0) vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_IDLE_MS));
     }
 }
 
 // Thêm hàm test HTTPS với endpoint công khai
 void testPublicHTTPS() {
-    Serial.println("[TEST] Bắt đầu kiểm tra HTTPS với endpoint công khai...");
+#ifdef STATIC_ALLOCATION
+    // WiFiClientSecure sets up its own TLS context on the heap for every call
+    LOGI(NET, "[TEST] Public HTTPS probe skipped in static allocation mode");
+#else
+    LOGI(NET, "[TEST] Bắt đầu kiểm tra HTTPS với endpoint công khai...");
     HTTPClient http;
     WiFiClientSecure secureClient;
     http.setReuse(false);
     http.setFollowRedirects(HTTPC_FORCE_FOLLOW_REDIRECTS);
     const char* testUrl = "https://jsonplaceholder.typicode.com/posts/1";
     if (!http.begin(secureClient, testUrl)) {
-        Serial.println("[TEST] Không thể bắt đầu kết nối HTTPS tới endpoint công khai!");
+        LOGW(NET, "[TEST] Không thể bắt đầu kết nối HTTPS tới endpoint công khai!");
         return;
     }
     int httpCode = http.GET();
-    Serial.printf("[TEST] Mã phản hồi HTTPS: %d\n", httpCode);
+    LOGI(NET, "[TEST] Mã phản hồi HTTPS: %d", httpCode);
     if (httpCode > 0 && httpCode < 400) {
         String payload = http.getString();
-        Serial.println("[TEST] Nhận dữ liệu thành công từ endpoint công khai!");
-        Serial.println(payload);
+        LOGI(NET, "[TEST] Nhận dữ liệu thành công từ endpoint công khai! (%u bytes)", (unsigned)payload.length());
     } else {
-        Serial.println("[TEST] Lỗi khi truy cập endpoint công khai!");
+        LOGW(NET, "[TEST] Lỗi khi truy cập endpoint công khai!");
     }
     http.end();
+#endif
+}
+
+// Creates a task from its taskTable row
+TaskHandle_t startTask(TaskSlot slot, void (*fn)(void*)) {
+    const TaskSpec& spec = taskTable[slot];
+    BaseType_t core = spec.core == TASK_ANY_CORE ? tskNO_AFFINITY : spec.core;
+#ifdef STATIC_ALLOCATION
+    return xTaskCreateStaticPinnedToCore(fn, spec.name, spec.stackBytes, NULL, spec.priority, taskStacks[slot],
+                                         &taskTcbs[slot], core);
+#else
+    TaskHandle_t handle = NULL;
+    xTaskCreatePinnedToCore(fn, spec.name, spec.stackBytes, NULL, spec.priority, &handle, core);
+    return handle;
+#endif
+}
+
+// What was reserved at link time, and the heap left once the tasks run
+void logMemoryReservations() {
+#ifdef STATIC_ALLOCATION
+    size_t stacks = sizeof(samplingTaskStack) + sizeof(mqttTaskStack) + sizeof(httpTaskStack) + sizeof(logTaskStack) +
+                    sizeof(taskTcbs);
+#else
+    size_t stacks = 0;
+#endif
+    Serial.printf("[Mem] %s allocation: %u transports in %u B, task stacks %u B static; "
+                  "heap free %u B, largest block %u B\n",
+                  STATIC_ALLOCATION_ON ? "static" : "heap", (unsigned)(2 * HTTP_POOL_MAX_SESSIONS),
+                  (unsigned)EspTransportFactory::reservedBytes(), (unsigned)stacks, (unsigned)ESP.getFreeHeap(),
+                  (unsigned)ESP.getMaxAllocHeap());
 }
 
 void setup() {
@@ -479,95 +1666,144 @@ void setup() {
     digitalWrite(LED_RED, LOW);    // Turn off red LED initially
     digitalWrite(LED_GREEN, LOW);  // Turn off green LED initially
     Serial.begin(115200);
-    
-    setup_wifi();
-    
-    // Initialize global secure client
-    initGlobalSecureClient();
+
+    taskHandles[TASK_LOOP] = xTaskGetCurrentTaskHandle(); // setup() and loop() share the Arduino loop task
+    logInstall(&deferredLog); // setup() prints directly; what the tasks log waits for logTask
+
+    // Deep sleep wake: unless the uplink window is due or RTC memory is full,
+    // take one reading and go straight back to sleep without WiFi
+    if (esp_sleep_get_wakeup_cause() == ESP_SLEEP_WAKEUP_TIMER && rtcStateValid(rtcState)) {
+        rtcState.wakes++;
+        power.restore(rtcState.power);
+        power.setBattery(readBatteryPercent());
+        bool kept = rtcPushSample(rtcState, readSensors());
+        PowerPlan plan = power.plan(SCHED_IDLE_MS, power.sampleIntervalMs());
+        if (plan.mode == POWER_DEEP_SLEEP && kept && rtcState.sampleCount < RTC_SAMPLE_CAPACITY) {
+            rtcState.power = power.save(plan.sleepMs);
+            rtcStateSeal(rtcState);
+            esp_sleep_enable_timer_wakeup((uint64_t)plan.sleepMs * 1000);
+            esp_deep_sleep_start();
+        }
+        Serial.printf("[Power] Woke for an uplink window, %u samples from RTC memory\n",
+                      (unsigned)rtcState.sampleCount);
+        sampleIntervalMs = power.sampleIntervalMs();
+    } else {
+        rtcStateClear(rtcState);
+    }
+    // Readings kept through deep sleep join the normal pipeline
+    for (uint16_t i = 0; i < rtcState.sampleCount; i++) {
+        httpPipe.push(rtcState.samples[i]);
+        mqttPipe.push(rtcState.samples[i]);
+    }
+    rtcState.sampleCount = 0;
+    rtcStateSeal(rtcState);
+
+    // Automatic light sleep whenever every task is blocked; it needs an SDK
+    // built with CONFIG_PM_ENABLE, otherwise only modem sleep saves power
+    esp_pm_config_esp32_t pmConfig;
+    pmConfig.max_freq_mhz = 240;
+    pmConfig.min_freq_mhz = 80;
+    pmConfig.light_sleep_enable = true;
+    esp_err_t pmErr = esp_pm_configure(&pmConfig);
+    if (pmErr == ESP_OK) {
+        esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "awake", &noLightSleepLock);
+    } else {
+        Serial.printf("[Power] Light sleep unavailable (%s), using modem sleep only\n", esp_err_to_name(pmErr));
+    }
+
+    // WiFi comes up in the background while the rest of setup runs
+#ifdef STATIC_ALLOCATION
+    netEvents = xEventGroupCreateStatic(&netEventsBuffer);
+#else
+    netEvents = xEventGroupCreate();
+#endif
+    WiFi.onEvent(onWiFiEvent);
+    sntp_set_time_sync_notification_cb(onTimeSynced);
+    linkManager.setListener(onLinkState, nullptr);
+    linkManager.begin();
+    if (!mbedTlsConfig.begin(TLS_CA_PEM)) {
+        Serial.println("[TLS] CA bundle invalid, HTTPS requests will fail");
+        hasError = true;
+    }
+    tlsContext.onHandshake(onTlsHandshake, nullptr);
+    // Static allocation mode keeps each TLS client's record buffers for good
+    for (size_t i = 0; i < HTTP_POOL_MAX_SESSIONS; i++) {
+        transportFactory.secure().at(i).begin(tlsContext, mbedTlsConfig, STATIC_ALLOCATION_ON);
+    }
+    apiClient.onAttempt(logHttpAttempt, nullptr);
     
     // Configure MQTT client
-    client.setServer(MQTT_HOST, MQTT_PORT);
-    client.setKeepAlive(60); // Set keepalive to 60 seconds
-    client.setSocketTimeout(20); // Socket timeout 20 seconds
-    client.setBufferSize(2048); // Increase buffer size
+    pubSubClient.setServer(MQTT_HOST, MQTT_PORT);
+    pubSubClient.setKeepAlive(MQTT_KEEPALIVE_S);
+    pubSubClient.setSocketTimeout(20); // Socket timeout 20 seconds
+    pubSubClient.setBufferSize(MQTT_BUFFER_SIZE);
+    summaryPublisher.begin(MQTT_TOPIC_PREFIX, DEVICE_ID);
+    alarmPublisher.begin(MQTT_TOPIC_PREFIX, DEVICE_ID);
+    commands.begin(MQTT_TOPIC_PREFIX, DEVICE_ID);
+    snprintf(diagTopic, sizeof(diagTopic), "%s/%s/diag", MQTT_TOPIC_PREFIX, DEVICE_ID);
 
-    // Create mutex for shared data
-    dataMutex = xSemaphoreCreateMutex();
+    // Báo cáo chưa gửi được trước lần restart trước, e.g. update_success
+    Serial.printf("[Outbox] %u event(s) waiting from the last boot\n", (unsigned)outbox.restore());
 
-    // Rollback OTA: If new firmware is pending verification, wait for 30s and mark it as valid
+    // Rollback OTA: new firmware pending verification runs normally while
+    // healthJob decides whether to mark it valid or roll it back
     Serial.println("[OTA] Checking OTA state...");
     esp_ota_img_states_t ota_state;
     if (esp_ota_get_state_partition(esp_ota_get_running_partition(), &ota_state) == ESP_OK) {
         if (ota_state == ESP_OTA_IMG_PENDING_VERIFY) {
-            Serial.println("[OTA] Firmware pending verify, waiting 30s to mark as valid...");
-            delay(30000); // wait for 30 seconds
-            Serial.println("[OTA] Marking firmware as valid...");
-            // Mark the firmware as valid, preventing rollback
-            esp_ota_mark_app_valid_cancel_rollback();
-            Serial.println("[OTA] Firmware marked as valid, rollback cancelled.");
+            Serial.println("[OTA] Firmware pending verify, starting health gate...");
+            healthGate.begin();
         } else if (ota_state == ESP_OTA_IMG_ABORTED) {
-            // Firmware rollback detected
+            // Firmware rollback detected; queued now, sent by outboxJob once online
             Serial.println("[OTA] Firmware rollback detected!");
-            // Send log to server
             Serial.print("[OTA] Current firmware version: "); Serial.println(FIRMWARE_VERSION);
-            Serial.print("[OTA] Sending rollback log to server...");
-            Serial.println("[OTA] Firmware rollback detected, sending log...");
-            sendOtaLogWithRetry("rollback", FIRMWARE_VERSION, "Firmware rollback triggered", 0);
-            sendSlackNotification(String("[OTA] Firmware rollback to version: ") + FIRMWARE_VERSION);
-            Serial.println("[OTA] Firmware rollback log sent.");
+            reportOtaLog("rollback", FIRMWARE_VERSION, "Firmware rollback triggered", 0);
+            notifySlack("[OTA] Firmware rollback to version: %s", FIRMWARE_VERSION);
         }
     }
     
     // Create FreeRTOS tasks
     Serial.println("[Setup] Creating FreeRTOS tasks...");
-    xTaskCreatePinnedToCore(
-        mqttTask,           // Task function
-        "MQTT Task",        // Task name
-        4096,               // Stack size
-        NULL,               // Parameters
-        1,                  // Priority
-        &mqttTaskHandle,    // Task handle
-        1                   // Core (1 for MQTT)
-    );
-    
-    xTaskCreatePinnedToCore(
-        httpTask,           // Task function
-        "HTTP Task",        // Task name
-        8192,               // Stack size (larger for HTTP operations)
-        NULL,               // Parameters
-        1,                  // Priority
-        &httpTaskHandle,    // Task handle
-        1                   // Core (1 for HTTP)
-    );
+    // Mở hàng đợi trên flash; records left from before a reset are replayed
+    sensorQueueReady = sensorQueueStorage.begin() && sensorQueue.mount() == FQ_OK;
+    if (sensorQueueReady) {
+        Serial.printf("[Queue] %u records waiting in flash\n", (unsigned)sensorQueue.size());
+    } else {
+        Serial.println("[Queue] Flash queue unavailable, offline readings will be dropped");
+    }
+
+    setupNetJobs();
+    if (sensorQueueReady && !sensorQueue.empty()) httpScheduler.trigger(sensorReplayJob);
+    size_t badTask = 0;
+    int topology = checkTopology(taskTable, TASK_COUNT, taskLimits, &badTask);
+    if (topology != TOPOLOGY_OK) {
+        Serial.printf("[Tasks] taskTable entry %s: %s\n", taskTable[badTask].name, topologyErrorName(topology));
+        hasError = true;
+    }
+    for (int t = 0; t < TASK_COUNT; t++) {
+        const TaskSpec& spec = taskTable[t];
+        char core[4] = "any";
+        if (spec.core != TASK_ANY_CORE) snprintf(core, sizeof(core), "%d", spec.core);
+        Serial.printf("[Tasks] %-8s core %s, priority %u, stack %u B%s\n", spec.name, core,
+                      (unsigned)spec.priority, (unsigned)spec.stackBytes, spec.isolated ? ", isolated" : "");
+    }
+    taskHandles[TASK_SAMPLING] = startTask(TASK_SAMPLING, samplingTask);
+    taskHandles[TASK_MQTT] = startTask(TASK_MQTT, mqttTask);
+    taskHandles[TASK_HTTP] = startTask(TASK_HTTP, httpTask);
+    taskHandles[TASK_LOG] = startTask(TASK_LOG, logTask);
+    logMemoryReservations();
     
     Serial.println("[Setup] FreeRTOS tasks created successfully!");
-
-    Serial.println("[Setup] Bắt đầu test HTTPS endpoint công khai để xác định lỗi SSL...");
-    testPublicHTTPS();
 }
 
 void loop() {
-    // Main loop now only handles LED status and WiFi monitoring
+    // Main loop drives the WiFi/SNTP state machine and the status LEDs
     // MQTT and HTTP operations are handled by FreeRTOS tasks
-    
-    // Check WiFi connection status
-    if (WiFi.status() != WL_CONNECTED) {
+    uint32_t waitMs = linkManager.poll();
+
+    if (!linkManager.online()) {
         digitalWrite(LED_GREEN, LOW);  // Turn off green LED when WiFi is not connected
         digitalWrite(LED_RED, HIGH);   // Turn on red LED when WiFi is not connected
-        Serial.println("[Main] WiFi not connected, retrying...");
-        
-        // Clean up secure client on WiFi disconnection
-        if (globalSecureClient) {
-            globalSecureClient->stop();
-            delete globalSecureClient;
-            globalSecureClient = nullptr;
-        }
-        
-        setup_wifi();
-        
-        // Reinitialize secure client after WiFi reconnection
-        initGlobalSecureClient();
-        
         wifiConnected = false;
         hasError = true;
     } else {
@@ -585,6 +1821,7 @@ void loop() {
         }
     }
     
-    // Small delay to prevent watchdog issues
-    delay(1000);
-}
\ No newline at end of file
+    // Sleep until the next WiFi event or link deadline; LEDs refresh at least every second
+    if (waitMs > 1000) waitMs = 1000;
+    xEventGroupWaitBits(netEvents, NET_EVT_LINK, pdTRUE, pdFALSE, pdMS_TO_TICKS(waitMs));
+}
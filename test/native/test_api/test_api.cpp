@@ -0,0 +1,279 @@
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "api_client.h"
+#include "api_payloads.h"
+#include "fw_version.h"
+#include "http_standin.h"
+#include "posix_transport.h"
+
+static PosixTransportFactory factory;
+static std::vector<uint32_t> sleeps;
+static void recordSleep(uint32_t ms) { sleeps.push_back(ms); }
+
+static HttpPoolConfig poolConfig() {
+    HttpPoolConfig cfg = defaultHttpPoolConfig(posixMillis);
+    cfg.ioTimeoutMs = 2000;
+    cfg.connectTimeoutMs = 2000;
+    return cfg;
+}
+
+void setUp(void) { sleeps.clear(); }
+void tearDown(void) {}
+
+void test_compare_version() {
+    TEST_ASSERT_EQUAL(0, compareVersion("1.2.3", "1.2.3"));
+    TEST_ASSERT_EQUAL(1, compareVersion("1.10.0", "1.9.9"));
+    TEST_ASSERT_EQUAL(-1, compareVersion("1.2", "1.2.1"));
+    TEST_ASSERT_EQUAL(0, compareVersion("1.2", "1.2.0"));
+    TEST_ASSERT_EQUAL(1, compareVersion("2024.05.01.120000", "2024.04.30.235959"));
+    TEST_ASSERT_EQUAL(0, compareVersion("v1.3.0", "1.3.0"));
+    // Suffixes are ignored instead of being read as digits
+    TEST_ASSERT_EQUAL(0, compareVersion("1.3.0-rc1", "1.3.0"));
+    TEST_ASSERT_EQUAL(1, compareVersion("1.0.1", ""));
+}
+
+void test_heartbeat_payload() {
+    HeartbeatInfo info;
+    memset(&info, 0, sizeof(info));
+    info.deviceId = "esp32-01";
+    info.firmwareVersion = "1.0.2";
+    info.bootToWifiMs = 300;
+    info.wifiDrops = 2;
+    char out[320];
+    size_t len = buildHeartbeat(info, out, sizeof(out));
+    TEST_ASSERT_EQUAL(strlen(out), len);
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"device_id\":\"esp32-01\",\"status\":\"online\",\"firmware_version\":\"1.0.2\","
+        "\"boot_to_wifi_ms\":300,\"boot_to_ntp_ms\":0,\"boot_to_first_publish_ms\":0,"
+        "\"wifi_fast_hits\":0,\"wifi_drops\":2,\"sample_overflows\":0}", out);
+    TEST_ASSERT_EQUAL(0, buildHeartbeat(info, out, 64));
+}
+
+void test_heartbeat_carries_metrics() {
+    HeartbeatInfo info;
+    memset(&info, 0, sizeof(info));
+    info.deviceId = "esp32-01";
+    info.firmwareVersion = "1.0.2";
+    info.metrics = "{\"c\":{\"http_retries\":3},\"g\":{},\"h\":{}}";
+    char out[400];
+    TEST_ASSERT_TRUE(buildHeartbeat(info, out, sizeof(out)) > 0);
+    TEST_ASSERT_NOT_NULL(
+        strstr(out, "\"sample_overflows\":0,\"metrics\":{\"c\":{\"http_retries\":3},\"g\":{},\"h\":{}}}"));
+}
+
+void test_diagnostics_payload() {
+    DiagnosticsInfo info;
+    memset(&info, 0, sizeof(info));
+    info.deviceId = "esp32-01";
+    info.firmwareVersion = "1.0.2";
+    info.uptimeMs = 60000;
+    info.rssi = -67;
+    info.sampleIntervalMs = 5000;
+    info.commands = 3;
+    char out[400];
+    size_t len = buildDiagnostics(info, out, sizeof(out));
+    TEST_ASSERT_EQUAL(strlen(out), len);
+    TEST_ASSERT_NOT_NULL(strstr(out, "\"uptime_ms\":60000,"));
+    TEST_ASSERT_NOT_NULL(strstr(out, "\"rssi\":-67,"));
+    TEST_ASSERT_NOT_NULL(strstr(out, "\"sample_interval_ms\":5000,"));
+    TEST_ASSERT_NOT_NULL(strstr(out, "\"commands\":3}"));
+    TEST_ASSERT_EQUAL(0, buildDiagnostics(info, out, 128));
+}
+
+void test_ota_log_payload_with_transfer() {
+    OtaStats st;
+    memset(&st, 0, sizeof(st));
+    st.bytes = 1048576;
+    st.elapsedMs = 1000;
+    st.attempts = 2;
+    st.lastHttpCode = 206;
+    OtaLogInfo info = {"esp32-01", "update_success", "1.0.3", "", 1500, &st, NULL, NULL, 1};
+    char out[384];
+    TEST_ASSERT_TRUE(buildOtaLog(info, out, sizeof(out)) > 0);
+    TEST_ASSERT_NOT_NULL(strstr(out, "\"latency_ms\":1500,\"bytes\":1048576,\"throughput_mbps\":8.389"));
+    TEST_ASSERT_NOT_NULL(strstr(out, "\"attempts\":2,\"http_code\":206}"));
+
+    TEST_ASSERT_NULL(strstr(out, "count"));
+
+    info.transfer = NULL;
+    buildOtaLog(info, out, sizeof(out));
+    TEST_ASSERT_NULL(strstr(out, "bytes"));
+
+    // Duplicates merged by the event outbox
+    info.count = 3;
+    buildOtaLog(info, out, sizeof(out));
+    TEST_ASSERT_NOT_NULL(strstr(out, "\"latency_ms\":1500,\"count\":3}"));
+}
+
+void test_slack_payload() {
+    char out[64];
+    TEST_ASSERT_TRUE(buildSlackMessage("OTA \"ok\"", 8, out, sizeof(out)) > 0);
+    TEST_ASSERT_EQUAL_STRING("{\"text\":\"OTA \\\"ok\\\"\"}", out);
+}
+
+void test_client_retries_until_success() {
+    int calls = 0;
+    std::string auth;
+    HttpStandin server([&](const StandinRequest& req, StandinResponse& resp) {
+        auth = req.headers.at("authorization");
+        if (++calls < 3) resp.status = 503;
+    });
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    ApiClient api(pool, "Authorization: Bearer t0k\r\n", defaultApiRetryPolicy(recordSleep));
+    std::string url = server.url("/api/heartbeat");
+
+    TEST_ASSERT_EQUAL(200, api.post(url.c_str(), "{}", 2, 3));
+    TEST_ASSERT_EQUAL(3, calls);
+    TEST_ASSERT_EQUAL_STRING("Bearer t0k", auth.c_str());
+    TEST_ASSERT_EQUAL(2, (int)sleeps.size());
+    TEST_ASSERT_EQUAL_UINT32(2000, sleeps[1]);
+    TEST_ASSERT_EQUAL_UINT32(2, api.stats().retries);
+    TEST_ASSERT_EQUAL_UINT32(0, api.stats().failures);
+}
+
+void test_client_backoff_doubles_and_caps() {
+    HttpStandin server([](const StandinRequest&, StandinResponse& resp) { resp.status = 500; });
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    ApiRetryPolicy policy = defaultApiRetryPolicy(recordSleep);
+    policy.retryDelayMs = 100;
+    policy.maxRetryDelayMs = 300;
+    ApiClient api(pool, NULL, policy);
+    std::string url = server.url("/api/log");
+
+    TEST_ASSERT_EQUAL(500, api.post(url.c_str(), "{}", 2, 5));
+    TEST_ASSERT_EQUAL(4, (int)sleeps.size());
+    TEST_ASSERT_EQUAL_UINT32(100, sleeps[0]);
+    TEST_ASSERT_EQUAL_UINT32(200, sleeps[1]);
+    TEST_ASSERT_EQUAL_UINT32(300, sleeps[2]);
+    TEST_ASSERT_EQUAL_UINT32(300, sleeps[3]);
+    TEST_ASSERT_EQUAL_UINT32(900, api.stats().backoffMs);
+    TEST_ASSERT_EQUAL_UINT32(1, api.stats().failures);
+    TEST_ASSERT_EQUAL(500, api.stats().lastStatus);
+}
+
+void test_client_reports_network_errors() {
+    HttpStandin server([](const StandinRequest&, StandinResponse&) {});
+    TEST_ASSERT_TRUE(server.start());
+    std::string url = server.url("/api/log");
+    server.stop(); // nothing listening any more
+    HttpSessionPool pool(factory, poolConfig());
+    ApiClient api(pool, NULL, defaultApiRetryPolicy(recordSleep));
+    TEST_ASSERT_EQUAL(HTTP_POOL_ERR_CONNECT, api.post(url.c_str(), "{}", 2, 2));
+    TEST_ASSERT_EQUAL_UINT32(2, api.stats().attempts);
+}
+
+void test_client_jitters_retries_below_the_ceiling() {
+    HttpStandin server([](const StandinRequest&, StandinResponse& resp) { resp.status = 500; });
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    ApiRetryPolicy policy = defaultApiRetryPolicy(recordSleep);
+    policy.retryDelayMs = 100;
+    policy.maxRetryDelayMs = 300;
+    policy.randomMs = [](uint32_t bound) { return bound / 2; };
+    ApiClient api(pool, NULL, policy);
+    std::string url = server.url("/api/log");
+
+    TEST_ASSERT_EQUAL(500, api.post(url.c_str(), "{}", 2, 4));
+    TEST_ASSERT_EQUAL(3, (int)sleeps.size());
+    TEST_ASSERT_EQUAL_UINT32(50, sleeps[0]);
+    TEST_ASSERT_EQUAL_UINT32(100, sleeps[1]);
+    TEST_ASSERT_EQUAL_UINT32(150, sleeps[2]);
+}
+
+void test_client_stops_on_retry_after_and_opens_the_circuit() {
+    int calls = 0;
+    HttpStandin server([&](const StandinRequest&, StandinResponse& resp) {
+        calls++;
+        resp.status = 429;
+        resp.extraHeaders = "Retry-After: 30\r\n";
+    });
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    ApiClient api(pool, NULL, defaultApiRetryPolicy(recordSleep));
+    CircuitBreaker breaker(defaultCircuitBreakerConfig(), posixMillis, NULL);
+    std::string url = server.url("/api/heartbeat");
+
+    HttpResponse resp;
+    TEST_ASSERT_EQUAL(429, api.request("POST", url.c_str(), (const uint8_t*)"{}", 2, 3, &resp, &breaker));
+    TEST_ASSERT_EQUAL(1, calls); // no retries against a server that asked for a pause
+    TEST_ASSERT_EQUAL_UINT32(30, resp.retryAfterS);
+    TEST_ASSERT_EQUAL(0, (int)sleeps.size());
+    TEST_ASSERT_EQUAL(CIRCUIT_OPEN, breaker.state());
+    TEST_ASSERT_UINT32_WITHIN(100, 30000, breaker.msUntilAllowed());
+
+    // Refused locally until the circuit lets a probe through
+    TEST_ASSERT_EQUAL(API_ERR_CIRCUIT_OPEN, api.post(url.c_str(), "{}", 2, 3, &breaker));
+    TEST_ASSERT_EQUAL(1, calls);
+    TEST_ASSERT_EQUAL_UINT32(1, api.stats().rejected);
+    TEST_ASSERT_EQUAL_UINT32(2, api.stats().failures);
+}
+
+void test_client_retries_come_out_of_the_budget() {
+    int calls = 0;
+    HttpStandin server([&](const StandinRequest&, StandinResponse& resp) {
+        calls++;
+        resp.status = 404;
+    });
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    ApiClient api(pool, NULL, defaultApiRetryPolicy(recordSleep));
+    CircuitBreakerConfig config = defaultCircuitBreakerConfig();
+    config.retryBudget = 3;
+    config.retryPercent = 0;
+    CircuitBreaker breaker(config, posixMillis, NULL);
+    std::string url = server.url("/api/log");
+
+    // 404 leaves the circuit closed, so only the budget limits the retries
+    TEST_ASSERT_EQUAL(404, api.post(url.c_str(), "{}", 2, 3, &breaker));
+    TEST_ASSERT_EQUAL(404, api.post(url.c_str(), "{}", 2, 3, &breaker));
+    TEST_ASSERT_EQUAL(404, api.post(url.c_str(), "{}", 2, 3, &breaker));
+    TEST_ASSERT_EQUAL(6, calls); // 3 first attempts and the 3 banked retries
+    TEST_ASSERT_EQUAL(CIRCUIT_CLOSED, breaker.state());
+    TEST_ASSERT_EQUAL_UINT32(2, breaker.stats().retriesDenied);
+    TEST_ASSERT_EQUAL_UINT32(3, api.stats().retries);
+}
+
+void test_client_circuit_opens_during_an_outage() {
+    int calls = 0;
+    HttpStandin server([&](const StandinRequest&, StandinResponse& resp) {
+        calls++;
+        resp.status = 503;
+    });
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    ApiClient api(pool, NULL, defaultApiRetryPolicy(recordSleep));
+    CircuitBreaker breaker(defaultCircuitBreakerConfig(), posixMillis, NULL);
+    std::string url = server.url("/api/sensor/batch");
+
+    // The third failure opens the circuit; the other attempts are never sent
+    TEST_ASSERT_EQUAL(503, api.post(url.c_str(), "{}", 2, 5, &breaker));
+    TEST_ASSERT_EQUAL(3, calls);
+    TEST_ASSERT_EQUAL(CIRCUIT_OPEN, breaker.state());
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_EQUAL(API_ERR_CIRCUIT_OPEN, api.post(url.c_str(), "{}", 2, 5, &breaker));
+    }
+    TEST_ASSERT_EQUAL(3, calls);
+    TEST_ASSERT_EQUAL_UINT32(10, api.stats().rejected);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_compare_version);
+    RUN_TEST(test_heartbeat_payload);
+    RUN_TEST(test_heartbeat_carries_metrics);
+    RUN_TEST(test_diagnostics_payload);
+    RUN_TEST(test_ota_log_payload_with_transfer);
+    RUN_TEST(test_slack_payload);
+    RUN_TEST(test_client_retries_until_success);
+    RUN_TEST(test_client_backoff_doubles_and_caps);
+    RUN_TEST(test_client_reports_network_errors);
+    RUN_TEST(test_client_jitters_retries_below_the_ceiling);
+    RUN_TEST(test_client_stops_on_retry_after_and_opens_the_circuit);
+    RUN_TEST(test_client_retries_come_out_of_the_budget);
+    RUN_TEST(test_client_circuit_opens_during_an_outage);
+    return UNITY_END();
+}
@@ -0,0 +1,104 @@
+#include <unity.h>
+#include <string.h>
+#include "api_endpoints.h"
+#include "api_payloads.h"
+
+// What a config.h gives the firmware; every check below runs in the compiler
+#define TEST_SERVER "https://ota.example.com:8443"
+#define TEST_TOKEN "eyJhbGciOiJIUzI1NiJ9.e30.ZRrHA1JJJW8opsbCGfG_HACGpVUMN_a9IV7pAx_Zmeo="
+#define TEST_DEVICE "esp32-01"
+#define TEST_VERSION "2024.05.01.120000"
+
+static_assert(apiServerValid(TEST_SERVER), "server");
+static_assert(apiServerValid("http://10.0.0.2"), "plain http, no port");
+static_assert(apiServerValid("http://ota.local:3000/fleet-a"), "base path");
+static_assert(apiPort(TEST_SERVER) == 8443 && apiPort("http://10.0.0.2") == 80 && apiPort("https://a.b") == 443,
+              "port");
+static_assert(apiTokenValid(TEST_TOKEN), "token");
+static_assert(apiIdValid(TEST_DEVICE) && apiIdValid(TEST_VERSION), "ids");
+
+// Misconfigurations that must not build
+static_assert(!apiServerValid(""), "empty");
+static_assert(!apiServerValid("ota.example.com"), "no scheme");
+static_assert(!apiServerValid("ftp://ota.example.com"), "other scheme");
+static_assert(!apiServerValid("HTTPS://ota.example.com"), "scheme is lower case");
+static_assert(!apiServerValid("https://"), "no host");
+static_assert(!apiServerValid("https://ota.example.com/"), "trailing slash doubles the one in the paths");
+static_assert(!apiServerValid("https://ota.example.com:"), "empty port");
+static_assert(!apiServerValid("https://ota.example.com:0"), "port 0");
+static_assert(!apiServerValid("https://ota.example.com:65536"), "port out of range");
+static_assert(!apiServerValid("https://ota.example.com:1234567"), "overlong port");
+static_assert(!apiServerValid("https://ota example.com"), "space");
+static_assert(!apiServerValid("https://user@ota.example.com"), "credentials");
+static_assert(!apiServerValid("https://ota.example.com?x=1"), "query without path");
+static_assert(!apiServerValid("https://a234567890123456789012345678901234567890123456789012345678901234.com"),
+              "host longer than the pool keeps");
+static_assert(apiUrlValid("https://hooks.slack.com/services/T0/B0/x/"), "full URLs may end in a slash");
+static_assert(!apiTokenValid(""), "empty token");
+static_assert(!apiTokenValid("abc\r\nX-Injected: 1"), "header injection");
+static_assert(!apiTokenValid("Bearer abc"), "space");
+static_assert(!apiIdValid(""), "empty id");
+static_assert(!apiIdValid("esp32\"01"), "quote breaks the JSON");
+static_assert(!apiIdValid("esp32/01"), "slash breaks the MQTT topic");
+static_assert(!apiIdValid("1.0 beta"), "space breaks the query");
+
+static const char testHeaders[] = API_HEADERS(TEST_TOKEN);
+static const char testVersionUrl[] = TEST_SERVER API_PATH_FIRMWARE_VERSION TEST_VERSION;
+static const char testDeviceMember[] = API_DEVICE_MEMBER(TEST_DEVICE);
+
+// A long token is checked in halves, so it stays far from the compiler's
+// recursion limit
+#define X16 "0123456789abcdef"
+#define X256 X16 X16 X16 X16 X16 X16 X16 X16 X16 X16 X16 X16 X16 X16 X16 X16
+static_assert(apiTokenValid(X256 X256 X256 X256 X256 X256 X256 X256), "2 KB token");
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_headers_and_urls_are_joined_at_compile_time() {
+    TEST_ASSERT_EQUAL_STRING("Content-Type: application/json\r\n"
+                             "Authorization: Bearer " TEST_TOKEN "\r\n"
+                             "Accept: application/json\r\n"
+                             "User-Agent: ESP32-OTA-Client/1.0\r\n",
+                             testHeaders);
+    TEST_ASSERT_EQUAL_STRING(
+        "https://ota.example.com:8443/api/firmware/version?device=esp32&current=2024.05.01.120000", testVersionUrl);
+    TEST_ASSERT_EQUAL_STRING("\"device_id\":\"esp32-01\"", testDeviceMember);
+}
+
+// The pre-serialized member gives the same body as escaping the id per call
+void test_payloads_with_a_serialized_device_member() {
+    HeartbeatInfo hb;
+    memset(&hb, 0, sizeof(hb));
+    hb.deviceId = TEST_DEVICE;
+    hb.firmwareVersion = TEST_VERSION;
+    hb.wifiDrops = 2;
+    char plain[320], joined[320];
+    size_t len = buildHeartbeat(hb, plain, sizeof(plain));
+    hb.deviceMember = testDeviceMember;
+    TEST_ASSERT_EQUAL(len, buildHeartbeat(hb, joined, sizeof(joined)));
+    TEST_ASSERT_EQUAL_STRING(plain, joined);
+
+    OtaLogInfo log = {TEST_DEVICE, "update_success", TEST_VERSION, "", 1500, NULL, NULL, NULL, 1};
+    len = buildOtaLog(log, plain, sizeof(plain));
+    log.deviceMember = testDeviceMember;
+    TEST_ASSERT_EQUAL(len, buildOtaLog(log, joined, sizeof(joined)));
+    TEST_ASSERT_EQUAL_STRING(plain, joined);
+
+    DiagnosticsInfo diag;
+    memset(&diag, 0, sizeof(diag));
+    diag.deviceId = TEST_DEVICE;
+    diag.firmwareVersion = TEST_VERSION;
+    len = buildDiagnostics(diag, plain, sizeof(plain));
+    diag.deviceMember = testDeviceMember;
+    TEST_ASSERT_EQUAL(len, buildDiagnostics(diag, joined, sizeof(joined)));
+    TEST_ASSERT_EQUAL_STRING(plain, joined);
+    TEST_ASSERT_EQUAL(0, buildDiagnostics(diag, joined, 20));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_headers_and_urls_are_joined_at_compile_time);
+    RUN_TEST(test_payloads_with_a_serialized_device_member);
+    return UNITY_END();
+}
@@ -0,0 +1,140 @@
+#include <unity.h>
+#include <string.h>
+#include "batch_encoder.h"
+#include "batch_uplink.h"
+
+static SensorSample storage[16];
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static FlushPolicy policy(size_t maxSamples, uint32_t maxAgeMs, size_t maxBytes) {
+    FlushPolicy p;
+    p.maxSamples = maxSamples;
+    p.maxAgeMs = maxAgeMs;
+    p.maxBytes = maxBytes;
+    return p;
+}
+
+void test_ring_overwrites_oldest() {
+    SensorSample buf[4];
+    SampleRing ring(buf, 4);
+    for (uint32_t i = 0; i < 6; i++) ring.push(makeSample(1000 + i, 20, 50, 100));
+    TEST_ASSERT_EQUAL(4, ring.size());
+    TEST_ASSERT_EQUAL(2, ring.dropped());
+    TEST_ASSERT_EQUAL(1002, ring.at(0).timestamp);
+    TEST_ASSERT_EQUAL(1005, ring.at(3).timestamp);
+    ring.consume(3);
+    TEST_ASSERT_EQUAL(1, ring.size());
+    TEST_ASSERT_EQUAL(1005, ring.at(0).timestamp);
+}
+
+void test_json_batch_layout() {
+    SampleRing ring(storage, 16);
+    ring.push(makeSample(1700000000, 25.5f, 50.25f, 110.4f));
+    ring.push(makeSample(1700000010, -3.07f, 49.0f, 0.0f));
+    char out[256];
+    size_t n = 0;
+    size_t len = encodeBatch(ring, 16, "esp32-01", (uint8_t*)out, sizeof(out), &n);
+    TEST_ASSERT_EQUAL(2, n);
+    TEST_ASSERT_EQUAL(strlen(out), len);
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"device_id\":\"esp32-01\",\"t0\":1700000000,\"dt\":[0,10],"
+        "\"temp\":[25.50,-3.07],\"humidity\":[50.25,49.00],\"light\":[110.4,0.0]}",
+        out);
+}
+
+void test_encode_respects_capacity() {
+    SampleRing ring(storage, 16);
+    for (uint32_t i = 0; i < 16; i++) ring.push(makeSample(1700000000 + i, 25.0f, 50.0f, 120.0f));
+    uint8_t out[256];
+    size_t n = 0;
+    size_t len = encodeBatch(ring, 16, "esp32-01", out, 200, &n);
+    TEST_ASSERT_GREATER_THAN(0, n);
+    TEST_ASSERT_LESS_THAN(16, n);
+    TEST_ASSERT_LESS_THAN(200, len);
+    TEST_ASSERT_EQUAL(0, encodeBatch(ring, 16, "esp32-01", out, 20, &n));
+    TEST_ASSERT_EQUAL(0, n);
+}
+
+void test_flush_on_count() {
+    BatchUplink up(storage, 16, policy(4, 60000, 4096));
+    for (uint32_t i = 0; i < 3; i++) up.add(makeSample(i, 1, 1, 1), 0);
+    TEST_ASSERT_FALSE(up.shouldFlush(0));
+    up.add(makeSample(3, 1, 1, 1), 0);
+    TEST_ASSERT_TRUE(up.shouldFlush(0));
+}
+
+void test_flush_on_age() {
+    BatchUplink up(storage, 16, policy(16, 30000, 4096));
+    TEST_ASSERT_FALSE(up.shouldFlush(100000));
+    up.add(makeSample(0, 1, 1, 1), 1000);
+    up.add(makeSample(10, 1, 1, 1), 20000);
+    TEST_ASSERT_FALSE(up.shouldFlush(30999));
+    TEST_ASSERT_TRUE(up.shouldFlush(31000));
+}
+
+void test_flush_on_bytes() {
+    BatchUplink up(storage, 16, policy(16, 60000, batchEncodedBound(5)));
+    for (uint32_t i = 0; i < 4; i++) up.add(makeSample(i, 1, 1, 1), 0);
+    TEST_ASSERT_FALSE(up.shouldFlush(0));
+    up.add(makeSample(4, 1, 1, 1), 0);
+    TEST_ASSERT_TRUE(up.shouldFlush(0));
+}
+
+void test_commit_only_after_delivery() {
+    BatchUplink up(storage, 16, policy(4, 60000, 4096));
+    for (uint32_t i = 0; i < 6; i++) up.add(makeSample(100 + i, 1, 1, 1), 0);
+    uint8_t out[512];
+    size_t n = 0;
+    TEST_ASSERT_GREATER_THAN(0, up.encode("dev", out, sizeof(out), &n));
+    TEST_ASSERT_EQUAL(4, n);
+    // A failed send keeps everything buffered.
+    TEST_ASSERT_EQUAL(6, up.ring().size());
+    up.commit(n, 10);
+    TEST_ASSERT_EQUAL(2, up.ring().size());
+    TEST_ASSERT_EQUAL(104, up.ring().at(0).timestamp);
+    TEST_ASSERT_EQUAL(1, up.batchesSent());
+    TEST_ASSERT_EQUAL(4, up.samplesSent());
+}
+
+void test_take_oldest_for_spill() {
+    BatchUplink up(storage, 16, policy(8, 60000, 4096));
+    for (uint32_t i = 0; i < 10; i++) up.add(makeSample(200 + i, 1, 1, 1), 0);
+    SensorSample out[16];
+    TEST_ASSERT_EQUAL(6, up.takeOldest(out, 6, 50));
+    TEST_ASSERT_EQUAL(200, out[0].timestamp);
+    TEST_ASSERT_EQUAL(205, out[5].timestamp);
+    TEST_ASSERT_EQUAL(4, up.ring().size());
+    TEST_ASSERT_EQUAL(206, up.ring().at(0).timestamp);
+    // Spilled samples are not counted as sent.
+    TEST_ASSERT_EQUAL(0, up.samplesSent());
+    TEST_ASSERT_EQUAL(4, up.takeOldest(out, 16, 60));
+    TEST_ASSERT_FALSE(up.shouldFlush(60));
+}
+
+void test_rebase_uptime_timestamps() {
+    SensorSample buf[4];
+    SampleRing ring(buf, 4);
+    ring.push(makeSample(3, 20, 50, 100));   // before SNTP: seconds since boot
+    ring.push(makeSample(8, 20, 50, 100));
+    ring.push(makeSample(1700000010, 20, 50, 100));
+    ring.rebase(1700000000, 1699999990);
+    TEST_ASSERT_EQUAL_UINT32(1699999993, ring.at(0).timestamp);
+    TEST_ASSERT_EQUAL_UINT32(1699999998, ring.at(1).timestamp);
+    TEST_ASSERT_EQUAL_UINT32(1700000010, ring.at(2).timestamp);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_ring_overwrites_oldest);
+    RUN_TEST(test_json_batch_layout);
+    RUN_TEST(test_encode_respects_capacity);
+    RUN_TEST(test_flush_on_count);
+    RUN_TEST(test_flush_on_age);
+    RUN_TEST(test_flush_on_bytes);
+    RUN_TEST(test_commit_only_after_delivery);
+    RUN_TEST(test_take_oldest_for_spill);
+    RUN_TEST(test_rebase_uptime_timestamps);
+    return UNITY_END();
+}
@@ -0,0 +1,68 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "api_payloads.h"
+#include "bench_report.h"
+#include "fw_version.h"
+
+// Cost of every payload the firmware builds and of the version comparison
+// run on each OTA check. Results also go to BENCH_JSON for regression checks.
+
+#define ROUNDS 200000
+#define SUITE "bench_api"
+
+static volatile size_t sink;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void report(const char* metric, double ns) {
+    printf("[BENCH] %s: %.1f ns/op\n", metric, ns);
+    benchRecord(SUITE, metric, ns, "ns/op");
+}
+
+void bench_heartbeat() {
+    HeartbeatInfo info = {"esp32-01", "2024.05.01.120000", 2130, 3400, 5200, 12, 1, 0, NULL, NULL};
+    char out[320];
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) {
+        info.wifiDrops = i;
+        sink += buildHeartbeat(info, out, sizeof(out));
+    }
+    report("heartbeat_payload", nsPerOp(t0, ROUNDS));
+}
+
+void bench_ota_log() {
+    OtaStats st;
+    memset(&st, 0, sizeof(st));
+    st.bytes = 1048576;
+    st.elapsedMs = 9000;
+    st.attempts = 1;
+    st.lastHttpCode = 200;
+    OtaLogInfo info = {"esp32-01", "update_success", "2024.05.01.120000", "", 0, &st, NULL, NULL, 1};
+    char out[384];
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) {
+        info.latencyMs = i;
+        sink += buildOtaLog(info, out, sizeof(out));
+    }
+    report("ota_log_payload", nsPerOp(t0, ROUNDS));
+}
+
+void bench_compare_version() {
+    const char* versions[4] = {"2024.05.01.120000", "2024.05.01.120001", "1.0.2", "v1.10.0-rc1"};
+    int newer = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) newer += compareVersion(versions[i & 3], versions[(i + 1) & 3]) > 0;
+    sink += newer;
+    report("compare_version", nsPerOp(t0, ROUNDS));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(bench_heartbeat);
+    RUN_TEST(bench_ota_log);
+    RUN_TEST(bench_compare_version);
+    return UNITY_END();
+}
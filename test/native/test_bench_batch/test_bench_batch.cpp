@@ -0,0 +1,92 @@
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "batch_encoder.h"
+#include "batch_uplink.h"
+#include "bench_report.h"
+
+// Throughput of the batch encoder against the legacy one-snprintf-per-reading payload.
+
+#define BATCH 32
+#define ROUNDS 20000
+
+static SensorSample storage[BATCH];
+static volatile size_t sink;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static double secondsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void fill(SampleRing& ring) {
+    ring.clear();
+    for (uint32_t i = 0; i < BATCH; i++) {
+        ring.push(makeSample(1700000000 + i * 10, 25.0f + (i % 7) * 0.13f, 50.0f + (i % 5) * 0.4f, 100.0f + i));
+    }
+}
+
+void bench_json_batch() {
+    SampleRing ring(storage, BATCH);
+    fill(ring);
+    uint8_t out[2048];
+    size_t bytes = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        size_t n = 0;
+        bytes = encodeBatch(ring, BATCH, "esp32-01", out, sizeof(out), &n);
+        sink += n;
+    }
+    double s = secondsSince(t0);
+    printf("[BENCH] batch_json: %.0f samples/s, %.1f bytes/sample\n", ROUNDS * BATCH / s, (double)bytes / BATCH);
+    benchRecord("bench_batch", "batch_json", ROUNDS * BATCH / s, "samples/s");
+    TEST_ASSERT_GREATER_THAN(0, bytes);
+}
+
+void bench_legacy_per_reading_json() {
+    char payload[128];
+    int len = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int i = 0; i < BATCH; i++) {
+            len = snprintf(payload, sizeof(payload),
+                           "{\"device_id\":\"%s\",\"temp\":%.2f,\"humidity\":%.2f,\"light\":%.2f}",
+                           "esp32-01", 25.0 + (i % 7) * 0.13, 50.0 + (i % 5) * 0.4, 100.0 + i);
+            sink += (size_t)len;
+        }
+    }
+    double s = secondsSince(t0);
+    printf("[BENCH] legacy_json: %.0f samples/s, %d bytes/sample\n", ROUNDS * BATCH / s, len);
+    benchRecord("bench_batch", "legacy_json", ROUNDS * BATCH / s, "samples/s");
+    TEST_ASSERT_GREATER_THAN(0, len);
+}
+
+void bench_uplink_add_and_flush() {
+    FlushPolicy policy = {BATCH, 60000, 2048};
+    BatchUplink up(storage, BATCH, policy);
+    uint8_t out[2048];
+    uint32_t flushes = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < ROUNDS * BATCH; i++) {
+        up.add(makeSample(i, 25.0f, 50.0f, 100.0f), i);
+        if (up.shouldFlush(i)) {
+            size_t n = 0;
+            up.encode("esp32-01", out, sizeof(out), &n);
+            up.commit(n, i);
+            flushes++;
+        }
+    }
+    double s = secondsSince(t0);
+    printf("[BENCH] uplink_add_flush: %.0f samples/s, %u batches\n", ROUNDS * BATCH / s, (unsigned)flushes);
+    benchRecord("bench_batch", "uplink_add_flush", ROUNDS * BATCH / s, "samples/s");
+    TEST_ASSERT_EQUAL(ROUNDS, flushes);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(bench_json_batch);
+    RUN_TEST(bench_legacy_per_reading_json);
+    RUN_TEST(bench_uplink_add_and_flush);
+    return UNITY_END();
+}
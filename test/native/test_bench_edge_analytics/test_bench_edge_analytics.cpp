@@ -0,0 +1,111 @@
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include "bench_report.h"
+#include "edge_analytics.h"
+
+// Per-sample cost of the edge analytics, and how many uplink messages a
+// simulated day of readings turns into compared with sending each one.
+
+#define SAMPLES 2000000
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static volatile float sink;
+
+static double nsPerSample(std::chrono::steady_clock::time_point t0, size_t n) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / n;
+}
+
+// Slow daily swing plus noise, roughly what the room sensors see.
+static float reading(uint32_t i, uint32_t& rng) {
+    rng = rng * 1103515245u + 12345u;
+    float noise = (float)((rng >> 8) % 100) / 500.0f - 0.1f;
+    return 27.0f + 4.0f * sinf((float)i * 2.0f * 3.14159265f / 17280.0f) + noise;
+}
+
+static ChannelConfig tempConfig() {
+    ChannelConfig c;
+    c.ewmaAlpha = 0.2f;
+    c.limits.highSet = 30.5f;
+    c.limits.highClear = 30.0f;
+    c.limits.lowSet = -INFINITY;
+    c.limits.lowClear = -INFINITY;
+    c.limits.holdSamples = 3;
+    c.deadband = 0.3f;
+    c.maxSilenceMs = 900000;
+    return c;
+}
+
+void bench_channel_per_sample() {
+    ChannelAnalytics ch(tempConfig());
+    uint32_t rng = 1;
+    float values[4096];
+    for (int i = 0; i < 4096; i++) values[i] = reading(i * 4, rng);
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < SAMPLES; i++) {
+        ch.add(values[i & 4095]);
+        if ((i % 12) == 11) ch.closeInterval((uint32_t)i * 5000, NULL);
+    }
+    sink = ch.smoothed();
+    double ns = nsPerSample(t0, SAMPLES);
+    printf("[BENCH] channel_analytics: %.1f ns per sample (stats + EWMA + alarm + deadband)\n", ns);
+    benchRecord("bench_edge_analytics", "channel_analytics", ns, "ns/op");
+}
+
+void bench_sliding_window_per_sample() {
+    SlidingWindow<64> w;
+    uint32_t rng = 1;
+    float values[4096];
+    for (int i = 0; i < 4096; i++) values[i] = reading(i * 4, rng);
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < SAMPLES; i++) w.add(values[i & 4095]);
+    sink = w.max() + w.min() + w.variance();
+    double ns = nsPerSample(t0, SAMPLES);
+    printf("[BENCH] sliding_window_64: %.1f ns per sample (min/max/mean/variance)\n", ns);
+    benchRecord("bench_edge_analytics", "sliding_window_64", ns, "ns/op");
+}
+
+// One day at 5 s per reading, 1 minute summaries, three channels.
+void bench_message_reduction() {
+    ChannelAnalytics temp(tempConfig());
+    ChannelConfig hc = tempConfig();
+    hc.limits.highSet = INFINITY;
+    hc.limits.highClear = INFINITY;
+    hc.deadband = 1.0f;
+    ChannelAnalytics hum(hc);
+    ChannelConfig lc = hc;
+    lc.deadband = 5.0f;
+    ChannelAnalytics light(lc);
+
+    uint32_t rng = 3, raw = 0, summaries = 0, alarms = 0;
+    for (uint32_t i = 0; i < 17280; i++) {
+        float t = reading(i, rng);
+        raw++;
+        alarms += temp.add(t);
+        alarms += hum.add(55.0f + (t - 27.0f));
+        alarms += light.add(150.0f + 10.0f * (t - 27.0f));
+        if ((i % 12) == 11) {
+            uint32_t now = (i + 1) * 5000;
+            bool a = temp.closeInterval(now, NULL);
+            bool b = hum.closeInterval(now, NULL);
+            bool c = light.closeInterval(now, NULL);
+            summaries += a || b || c;
+        }
+    }
+    printf("[BENCH] edge_message_reduction: %u raw readings -> %u summaries + %u alarms (%.1fx fewer)\n",
+           (unsigned)raw, (unsigned)summaries, (unsigned)alarms, (double)raw / (summaries + alarms));
+    benchRecord("bench_edge_analytics", "messages_per_day", summaries + alarms, "messages");
+    TEST_ASSERT_TRUE(summaries + alarms < raw / 10);
+    TEST_ASSERT_TRUE(alarms >= 2);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(bench_channel_per_sample);
+    RUN_TEST(bench_sliding_window_per_sample);
+    RUN_TEST(bench_message_reduction);
+    return UNITY_END();
+}
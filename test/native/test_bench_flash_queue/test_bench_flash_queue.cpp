@@ -0,0 +1,70 @@
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include <string>
+#include "bench_report.h"
+#include "file_flash.h"
+#include "flash_queue.h"
+#include "sensor_sample.h"
+
+// Append and drain throughput of the store-and-forward queue on the
+// file-backed flash stand-in, for single samples and spilled batches.
+
+#define SECTOR 4096
+#define SECTORS 64
+#define RECORDS 20000
+
+static const char* PATH = "/tmp/bench_flash_queue.bin";
+
+void setUp(void) { remove(PATH); }
+void tearDown(void) { remove(PATH); }
+
+static double secondsSince(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void benchRecords(size_t samplesPerRecord, const char* name) {
+    FileFlash flash(PATH, SECTOR, SECTORS);
+    TEST_ASSERT_TRUE(flash.open());
+    FlashQueue q(flash);
+    TEST_ASSERT_EQUAL(FQ_OK, q.mount());
+
+    SensorSample batch[32];
+    for (size_t i = 0; i < samplesPerRecord; i++) batch[i] = makeSample(1700000000 + i, 25.5f, 55.0f, 123.4f);
+    size_t len = samplesPerRecord * sizeof(SensorSample);
+    size_t records = RECORDS / samplesPerRecord;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < records; i++) TEST_ASSERT_EQUAL(FQ_OK, q.push(batch, len));
+    double appendS = secondsSince(t0);
+
+    size_t drained = 0;
+    t0 = std::chrono::steady_clock::now();
+    while (!q.empty()) {
+        FlashQueueCursor c = q.head();
+        int n = q.read(c, batch, sizeof(batch));
+        TEST_ASSERT_EQUAL((int)len, n);
+        q.pop(1);
+        drained++;
+    }
+    double drainS = secondsSince(t0);
+
+    printf("[BENCH] %s: append %.0f samples/s, drain %.0f samples/s, %u dropped, %u erases, %.1f bytes/sample on flash\n",
+           name, records * samplesPerRecord / appendS, drained * samplesPerRecord / drainS,
+           (unsigned)q.stats().dropped, (unsigned)q.stats().erases,
+           (double)(len + FQ_RECORD_HEADER) / samplesPerRecord);
+    std::string metric(name);
+    benchRecord("bench_flash_queue", (metric + "_append").c_str(), records * samplesPerRecord / appendS, "samples/s");
+    benchRecord("bench_flash_queue", (metric + "_drain").c_str(), drained * samplesPerRecord / drainS, "samples/s");
+    TEST_ASSERT_EQUAL(records, drained + q.stats().dropped);
+}
+
+void bench_queue_single_samples() { benchRecords(1, "flash_queue_1_sample"); }
+void bench_queue_spilled_batches() { benchRecords(32, "flash_queue_32_samples"); }
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(bench_queue_single_samples);
+    RUN_TEST(bench_queue_spilled_batches);
+    return UNITY_END();
+}
@@ -0,0 +1,105 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "api_client.h"
+#include "bench_report.h"
+#include "http_standin.h"
+#include "posix_transport.h"
+
+// Request throughput and retry cost of the API path (ApiClient over the
+// session pool) against a local stand-in server. Loopback hides network
+// latency, so these numbers track client-side CPU and connection handling.
+
+#define REQUESTS 2000
+#define SUITE "bench_http"
+
+static PosixTransportFactory factory;
+static const char* kHeaders = "Content-Type: application/json\r\nAuthorization: Bearer bench\r\n";
+static const char* kBody = "{\"device_id\":\"esp32-01\",\"status\":\"online\",\"firmware_version\":\"1.0.2\"}";
+
+static uint32_t sleptMs = 0;
+static void fakeSleep(uint32_t ms) { sleptMs += ms; }
+
+void setUp(void) { sleptMs = 0; }
+void tearDown(void) {}
+
+static HttpPoolConfig poolConfig() {
+    HttpPoolConfig cfg = defaultHttpPoolConfig(posixMillis);
+    cfg.ioTimeoutMs = 2000;
+    cfg.connectTimeoutMs = 2000;
+    return cfg;
+}
+
+static double elapsedUs(std::chrono::steady_clock::time_point t0) {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+}
+
+static void throughput(const char* name, bool keepAlive) {
+    HttpStandin server([keepAlive](const StandinRequest&, StandinResponse& resp) {
+        resp.body = "{\"ok\":true}";
+        resp.close = !keepAlive;
+    });
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    ApiClient api(pool, kHeaders, defaultApiRetryPolicy(fakeSleep));
+    std::string url = server.url("/api/heartbeat");
+
+    std::vector<double> latency;
+    latency.reserve(REQUESTS);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < REQUESTS; i++) {
+        auto t0 = std::chrono::steady_clock::now();
+        TEST_ASSERT_EQUAL(200, api.post(url.c_str(), kBody, strlen(kBody), 1));
+        latency.push_back(elapsedUs(t0));
+    }
+    double rate = REQUESTS / (elapsedUs(start) / 1e6);
+    std::sort(latency.begin(), latency.end());
+    double p50 = latency[REQUESTS / 2];
+    double p99 = latency[REQUESTS * 99 / 100];
+    printf("[BENCH] %s: %.0f req/s, p50 %.1f us, p99 %.1f us, %u connections\n", name, rate, p50, p99,
+           (unsigned)server.acceptedConnections());
+
+    std::string metric(name);
+    benchRecord(SUITE, (metric + "_rate").c_str(), rate, "req/s");
+    benchRecord(SUITE, (metric + "_p50").c_str(), p50, "us");
+    benchRecord(SUITE, (metric + "_p99").c_str(), p99, "us");
+}
+
+void bench_keep_alive() { throughput("keep_alive", true); }
+void bench_connection_close() { throughput("connection_close", false); }
+
+// Every request fails twice before it succeeds. Sleeping is stubbed, so the
+// wall time is the client cost of a retried request; the backoff it would
+// have slept is reported separately.
+void bench_retry_path() {
+    int calls = 0;
+    HttpStandin server([&calls](const StandinRequest&, StandinResponse& resp) {
+        if (++calls % 3) resp.status = 503;
+    });
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    ApiClient api(pool, kHeaders, defaultApiRetryPolicy(fakeSleep));
+    std::string url = server.url("/api/log");
+
+    const int rounds = REQUESTS / 3;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) TEST_ASSERT_EQUAL(200, api.post(url.c_str(), kBody, strlen(kBody), 3));
+    double us = elapsedUs(start) / rounds;
+    double backoff = (double)sleptMs / rounds;
+    printf("[BENCH] retry_2_of_3: %.1f us per request (CPU), %.0f ms backoff per request\n", us, backoff);
+    TEST_ASSERT_EQUAL_UINT32(2 * rounds, api.stats().retries);
+    benchRecord(SUITE, "retry_2_of_3_cpu", us, "us");
+    benchRecord(SUITE, "retry_2_of_3_backoff", backoff, "ms");
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(bench_keep_alive);
+    RUN_TEST(bench_connection_close);
+    RUN_TEST(bench_retry_path);
+    return UNITY_END();
+}
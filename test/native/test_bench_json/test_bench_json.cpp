@@ -0,0 +1,94 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include "bench_report.h"
+#include "json_fields.h"
+#include "json_writer.h"
+
+// Payload building and version-response parsing cost, JsonWriter/JsonFieldExtractor
+// against the String-concatenation and indexOf/substring code they replaced.
+
+#define ROUNDS 200000
+
+static volatile size_t sink;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void bench_ota_log_writer() {
+    char body[256];
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) {
+        JsonWriter w(body, sizeof(body));
+        w.beginObject()
+            .key("device_id").value("esp32-01")
+            .key("status").value("update_failed")
+            .key("version").value("1.0.2")
+            .key("error_message").value("OTA failed")
+            .key("latency_ms").value((int32_t)i)
+            .endObject();
+        sink += w.length();
+    }
+    printf("[BENCH] ota_log_json_writer: %.1f ns/payload\n", nsPerOp(t0, ROUNDS));
+    benchRecord("bench_json", "ota_log_json_writer", nsPerOp(t0, ROUNDS), "ns/op");
+}
+
+void bench_ota_log_string_concat() {
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) {
+        std::string body = std::string("{\"device_id\":\"") + "esp32-01" + "\"," +
+                           "\"status\":\"" + "update_failed" + "\"," +
+                           "\"version\":\"" + "1.0.2" + "\"," +
+                           "\"error_message\":\"" + "OTA failed" + "\"," +
+                           "\"latency_ms\":" + std::to_string(i) + "}";
+        sink += body.size();
+    }
+    printf("[BENCH] ota_log_string_concat: %.1f ns/payload\n", nsPerOp(t0, ROUNDS));
+    benchRecord("bench_json", "ota_log_string_concat", nsPerOp(t0, ROUNDS), "ns/op");
+}
+
+static const char* kVersionResponse =
+    "{\"id\":42,\"device\":\"esp32\",\"notes\":\"Auto uploaded from GitHub Actions\","
+    "\"version\":\"2024.05.01.120000\",\"url\":\"http://ota.example.com/firmware/esp32-2024.05.01.120000.bin\","
+    "\"sha256\":\"9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08\",\"size\":1048576}";
+
+void bench_version_extractor_streaming() {
+    size_t len = strlen(kVersionResponse);
+    char version[32], url[160];
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) {
+        JsonField fields[] = {{"version", version, sizeof(version), false}, {"url", url, sizeof(url), false}};
+        JsonFieldExtractor ex(fields, 2);
+        for (size_t off = 0; off < len; off += 64) ex.feed(kVersionResponse + off, len - off < 64 ? len - off : 64);
+        sink += ex.finish() && fields[1].found;
+    }
+    double ns = nsPerOp(t0, ROUNDS);
+    printf("[BENCH] version_extractor_64B_chunks: %.1f ns/response, %.1f MB/s\n", ns, len / ns * 1e3);
+    benchRecord("bench_json", "version_extractor_64B_chunks", ns, "ns/op");
+    TEST_ASSERT_EQUAL_STRING("2024.05.01.120000", version);
+}
+
+void bench_version_indexof_substring() {
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) {
+        std::string payload(kVersionResponse); // http.getString()
+        size_t vIdx = payload.find("\"version\":");
+        size_t urlIdx = payload.find("\"url\":");
+        std::string v = payload.substr(vIdx + 11, payload.find('"', vIdx + 12) - (vIdx + 11));
+        std::string u = payload.substr(urlIdx + 7, payload.find('"', urlIdx + 8) - (urlIdx + 7));
+        sink += v.size() + u.size();
+    }
+    printf("[BENCH] version_indexof_substring: %.1f ns/response\n", nsPerOp(t0, ROUNDS));
+    benchRecord("bench_json", "version_indexof_substring", nsPerOp(t0, ROUNDS), "ns/op");
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(bench_ota_log_writer);
+    RUN_TEST(bench_ota_log_string_concat);
+    RUN_TEST(bench_version_extractor_streaming);
+    RUN_TEST(bench_version_indexof_substring);
+    return UNITY_END();
+}
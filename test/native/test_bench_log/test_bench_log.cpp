@@ -0,0 +1,105 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "bench_report.h"
+#include "deferred_log.h"
+
+// What a log call costs the task that makes it: a deferred LOGI() next to
+// formatting the same line with snprintf (the part of Serial.printf before
+// the UART), and the wait a blocking Serial.printf adds at 115200 baud.
+
+#define ITERATIONS 1000000
+#define RING 1024
+#define UART_BAUD 115200
+
+static uint32_t zeroMillis() { return 0; }
+static LogSlot slots[RING];
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void discard(const LogLine&, void* ctx) {
+    (*static_cast<size_t*>(ctx))++;
+}
+
+static const char* url = "https://ota.example.com/api/sensor/batch";
+
+// Only the writes are timed; the ring is emptied between rounds the way the
+// log task would
+void bench_deferred_write() {
+    DeferredLog log(slots, RING, zeroMillis);
+    logInstall(&log);
+    size_t drained = 0;
+    double totalNs = 0;
+    for (int done = 0; done < ITERATIONS; done += RING) {
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < RING; i++) {
+            LOGI(NET, "[HTTP] %s %s attempt %u/%u: %d", "POST", url, (uint8_t)1, (uint8_t)3, 200);
+        }
+        totalNs += nsPerOp(t0, 1);
+        log.drain(discard, &drained);
+    }
+    logInstall(NULL);
+    double ns = totalNs / ((ITERATIONS + RING - 1) / RING * RING);
+    TEST_ASSERT_EQUAL_UINT32(0, log.dropped());
+    printf("[BENCH] deferred LOGI (2 strings, 3 ints): %.1f ns/call\n", ns);
+    benchRecord("bench_log", "deferred_write", ns, "ns/op");
+}
+
+void bench_compiled_out() {
+    DeferredLog log(slots, RING, zeroMillis);
+    logInstall(&log);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) LOGD(NET, "[HTTP] %s %s attempt %u/%u: %d", "POST", url, 1u, 3u, i);
+    double ns = nsPerOp(t0, ITERATIONS);
+    logInstall(NULL);
+    TEST_ASSERT_EQUAL_UINT32(0, log.written());
+    printf("[BENCH] LOGD above LOG_MAX: %.2f ns/call\n", ns);
+    benchRecord("bench_log", "compiled_out", ns, "ns/op");
+}
+
+void bench_drain_format() {
+    DeferredLog log(slots, RING, zeroMillis);
+    size_t drained = 0;
+    double totalNs = 0;
+    for (int done = 0; done < ITERATIONS / 4; done += RING) {
+        for (int i = 0; i < RING; i++) {
+            log.write(LOG_MOD_NET, LOG_LEVEL_INFO, "[HTTP] %s %s attempt %u/%u: %d", "POST", url, 1u, 3u, i);
+        }
+        auto t0 = std::chrono::steady_clock::now();
+        log.drain(discard, &drained);
+        totalNs += nsPerOp(t0, RING);
+    }
+    double ns = totalNs / ((ITERATIONS / 4 + RING - 1) / RING);
+    TEST_ASSERT_TRUE(drained > 0);
+    printf("[BENCH] drain + format on the log task: %.1f ns/record\n", ns);
+    benchRecord("bench_log", "drain_format", ns, "ns/op");
+}
+
+void bench_synchronous_printf() {
+    char line[LOG_LINE_MAX];
+    int len = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) {
+        len = snprintf(line, sizeof(line), "[HTTP] %s %s attempt %u/%u: %d\n", "POST", url, 1u, 3u, i & 1023);
+    }
+    double ns = nsPerOp(t0, ITERATIONS);
+    // 10 bits per byte on the wire; Serial.printf returns once the line is
+    // in the UART FIFO, so a burst longer than the FIFO waits for all of it
+    double uartUs = len * 10.0 * 1e6 / UART_BAUD;
+    TEST_ASSERT_TRUE(len > 0);
+    printf("[BENCH] snprintf of the same line: %.1f ns/call; %d bytes at %u baud: %.0f us on the wire\n", ns, len,
+           (unsigned)UART_BAUD, uartUs);
+    benchRecord("bench_log", "snprintf", ns, "ns/op");
+    benchRecord("bench_log", "uart_115200_line", uartUs * 1000, "ns/op");
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(bench_deferred_write);
+    RUN_TEST(bench_compiled_out);
+    RUN_TEST(bench_drain_format);
+    RUN_TEST(bench_synchronous_printf);
+    return UNITY_END();
+}
@@ -0,0 +1,62 @@
+#include <unity.h>
+#include <stdio.h>
+#include <chrono>
+#include "bench_report.h"
+#include "metrics.h"
+
+// Per-call cost of recording, so instrumentation can stay on in hot paths.
+
+#define ITERATIONS 2000000
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void bench_counter_add() {
+    MetricsRegistry m;
+    int id = m.counter("ops");
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) m.add(id);
+    double ns = nsPerOp(t0, ITERATIONS);
+    TEST_ASSERT_EQUAL_UINT32(ITERATIONS, m.count(id));
+    printf("[BENCH] counter add: %.1f ns/op\n", ns);
+    benchRecord("bench_metrics", "counter_add", ns, "ns/op");
+}
+
+void bench_histogram_record() {
+    MetricsRegistry m;
+    int id = m.histogram("lat");
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; i++) m.record(id, (uint32_t)(i & 4095));
+    double ns = nsPerOp(t0, ITERATIONS);
+    TEST_ASSERT_EQUAL_UINT32(ITERATIONS, m.count(id));
+    printf("[BENCH] histogram record: %.1f ns/op\n", ns);
+    benchRecord("bench_metrics", "histogram_record", ns, "ns/op");
+}
+
+void bench_encode() {
+    MetricsRegistry m;
+    const char* names[] = {"http_ms", "mqtt_ms", "ota_ms", "http_retries", "heap_free", "heap_min",
+                           "heap_max_block", "stack_net", "stack_sampling"};
+    for (int i = 0; i < 3; i++) m.histogram(names[i]);
+    for (int i = 3; i < 4; i++) m.counter(names[i]);
+    for (int i = 4; i < 9; i++) m.gauge(names[i]);
+    for (int i = 0; i < 1000; i++) m.record(i % 3, (uint32_t)(i * 7));
+    char out[512];
+    size_t len = 0;
+    const int rounds = 20000;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) len = m.encode(out, sizeof(out));
+    double ns = nsPerOp(t0, rounds);
+    TEST_ASSERT_TRUE(len > 0);
+    printf("[BENCH] encode %u metrics: %.0f ns, %u bytes\n", (unsigned)m.size(), ns, (unsigned)len);
+    benchRecord("bench_metrics", "encode", ns, "ns/op");
+    benchRecord("bench_metrics", "encoded_bytes", (double)len, "bytes");
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(bench_counter_add);
+    RUN_TEST(bench_histogram_record);
+    RUN_TEST(bench_encode);
+    return UNITY_END();
+}
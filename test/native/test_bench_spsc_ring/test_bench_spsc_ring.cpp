@@ -0,0 +1,150 @@
+#include <unity.h>
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bench_report.h"
+#include "sample_ring.h"
+#include "spsc_ring.h"
+
+// Hand-off latency (push to pop on another thread) and throughput of the
+// sampling pipeline ring, next to a mutex-guarded SampleRing as baseline.
+
+#define ITEMS 100000
+#define CAPACITY 64
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The producer stamps each sample with its push time in lightC10/timestamp.
+static SensorSample stamped() {
+    uint64_t t = nowNs();
+    SensorSample s;
+    s.timestamp = (uint32_t)(t >> 32);
+    s.lightC10 = (uint32_t)t;
+    s.tempC100 = 0;
+    s.humidityC100 = 0;
+    return s;
+}
+
+static uint64_t stampOf(const SensorSample& s) { return ((uint64_t)s.timestamp << 32) | s.lightC10; }
+
+static void report(const char* name, std::vector<uint64_t>& lat, double seconds, uint32_t dropped) {
+    std::sort(lat.begin(), lat.end());
+    size_t n = lat.size();
+    printf("[BENCH] %s: p50 %llu ns, p99 %llu ns, max %llu ns, %.2f M items/s, %u dropped\n", name,
+           (unsigned long long)lat[n / 2], (unsigned long long)lat[n * 99 / 100], (unsigned long long)lat[n - 1],
+           n / seconds / 1e6, (unsigned)dropped);
+    std::string metric(name);
+    benchRecord("bench_spsc_ring", (metric + "_p50").c_str(), (double)lat[n / 2], "ns");
+    benchRecord("bench_spsc_ring", (metric + "_p99").c_str(), (double)lat[n * 99 / 100], "ns");
+}
+
+void bench_spsc_handoff_latency() {
+    static SensorSample buf[CAPACITY];
+    SpscRing<SensorSample> ring(buf, CAPACITY);
+    std::vector<uint64_t> lat;
+    lat.reserve(ITEMS);
+    std::atomic<bool> producerDone(false);
+
+    uint64_t t0 = nowNs();
+    std::thread consumer([&]() {
+        SensorSample s;
+        for (;;) {
+            bool finished = producerDone.load();
+            while (ring.pop(s)) lat.push_back(nowNs() - stampOf(s));
+            if (finished) break;
+            std::this_thread::yield();
+        }
+    });
+    for (int i = 0; i < ITEMS; i++) {
+        while (ring.size() >= CAPACITY / 2) std::this_thread::yield(); // keep it measuring latency, not queueing
+        ring.push(stamped());
+    }
+    producerDone.store(true);
+    consumer.join();
+    double seconds = (nowNs() - t0) / 1e9;
+    TEST_ASSERT_EQUAL(ITEMS, (int)lat.size());
+    report("spsc_ring", lat, seconds, ring.overflows());
+}
+
+void bench_mutex_ring_handoff_latency() {
+    static SensorSample buf[CAPACITY];
+    SampleRing ring(buf, CAPACITY);
+    std::mutex lock;
+    std::vector<uint64_t> lat;
+    lat.reserve(ITEMS);
+    std::atomic<bool> producerDone(false);
+
+    uint64_t t0 = nowNs();
+    std::thread consumer([&]() {
+        for (;;) {
+            bool finished = producerDone.load();
+            for (;;) {
+                std::lock_guard<std::mutex> g(lock);
+                if (ring.empty()) break;
+                SensorSample s = ring.at(0);
+                ring.consume(1);
+                lat.push_back(nowNs() - stampOf(s));
+            }
+            if (finished) break;
+            std::this_thread::yield();
+        }
+    });
+    for (int i = 0; i < ITEMS; i++) {
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> g(lock);
+                if (ring.size() < CAPACITY / 2) {
+                    ring.push(stamped());
+                    break;
+                }
+            }
+            std::this_thread::yield();
+        }
+    }
+    producerDone.store(true);
+    consumer.join();
+    double seconds = (nowNs() - t0) / 1e9;
+    TEST_ASSERT_EQUAL(ITEMS, (int)lat.size());
+    report("mutex_ring", lat, seconds, ring.dropped());
+}
+
+// Cost the sampling task pays per reading with two uplink rings and no consumer.
+void bench_producer_push_cost() {
+    static SensorSample a[CAPACITY], b[CAPACITY];
+    SpscRing<SensorSample> http(a, CAPACITY), mqtt(b, CAPACITY);
+    SensorSample s = stamped();
+    SensorSample sink[CAPACITY];
+    const int rounds = 20000;
+    uint64_t t0 = nowNs();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < CAPACITY; i++) {
+            http.push(s);
+            mqtt.push(s);
+        }
+        http.drain(sink, CAPACITY);
+        mqtt.drain(sink, CAPACITY);
+    }
+    double ns = (double)(nowNs() - t0) / ((double)rounds * CAPACITY);
+    printf("[BENCH] spsc_fan_out_2: %.1f ns per sample (push to both rings + drain)\n", ns);
+    benchRecord("bench_spsc_ring", "spsc_fan_out_2", ns, "ns/op");
+    TEST_ASSERT_EQUAL_UINT32(0, http.overflows() + mqtt.overflows());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(bench_spsc_handoff_latency);
+    RUN_TEST(bench_mutex_ring_handoff_latency);
+    RUN_TEST(bench_producer_push_cost);
+    return UNITY_END();
+}
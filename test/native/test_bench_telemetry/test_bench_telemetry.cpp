@@ -0,0 +1,87 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include "bench_report.h"
+#include "edge_analytics.h"
+#include "telemetry_frame.h"
+
+// Bytes on the wire and encode cost of one interval summary as binary
+// frames on a per-device topic, one summary per frame and five packed together.
+
+#define ROUNDS 100000
+#define SUITE "bench_telemetry"
+#define CHANNELS 3
+
+static volatile size_t sink;
+static RunningStats stats[CHANNELS];
+static const AlarmState alarms[CHANNELS] = {ALARM_CLEAR, ALARM_HIGH, ALARM_CLEAR};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// MQTT 3.1.1 PUBLISH packet: fixed header, topic, packet id for QoS > 0, payload.
+static size_t mqttPacketBytes(const char* topic, size_t payload, int qos) {
+    size_t remaining = 2 + strlen(topic) + (qos ? 2 : 0) + payload;
+    size_t lenBytes = remaining < 128 ? 1 : remaining < 16384 ? 2 : 3;
+    return 1 + lenBytes + remaining;
+}
+
+static SummaryRecord toRecord(uint32_t ts) {
+    SummaryRecord r;
+    r.timestamp = ts;
+    r.samples = stats[0].count();
+    r.channels = CHANNELS;
+    for (int c = 0; c < CHANNELS; c++) {
+        r.ch[c].min = toFrameValue(stats[c].min());
+        r.ch[c].max = toFrameValue(stats[c].max());
+        r.ch[c].mean = toFrameValue(stats[c].mean());
+        r.ch[c].sd = (uint32_t)toFrameValue(stats[c].stddev());
+        r.ch[c].alarm = alarms[c];
+    }
+    return r;
+}
+
+static void report(const char* name, double ns, double bytes, double publishesPerHour) {
+    printf("[BENCH] %s: %.1f ns/summary, %.1f bytes/summary on the wire, %.0f publishes/h\n", name, ns, bytes,
+           publishesPerHour);
+    char metric[64];
+    snprintf(metric, sizeof(metric), "%s_encode", name);
+    benchRecord(SUITE, metric, ns, "ns/op");
+    snprintf(metric, sizeof(metric), "%s_wire", name);
+    benchRecord(SUITE, metric, bytes, "bytes");
+}
+
+static void benchBinary(const char* name, int pack) {
+    uint8_t buf[256];
+    TelemetryFrame frame(buf, sizeof(buf));
+    size_t wire = 0;
+    int frames = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUNDS; i++) {
+        if (i % pack == 0) frame.reset(TELEMETRY_SUMMARY);
+        frame.add(toRecord(1700000000 + 60 * i));
+        if (i % pack == pack - 1) {
+            frame.finish(frames++);
+            wire += mqttPacketBytes("edge/esp32-01/s", frame.length(), 0);
+        }
+    }
+    double ns = nsPerOp(t0, ROUNDS);
+    report(name, ns, (double)wire / (frames * pack), 60.0 / pack);
+    sink += wire;
+}
+
+void bench_binary_summary() { benchBinary("binary_x1", 1); }
+void bench_binary_packed_summary() { benchBinary("binary_x5", 5); }
+
+int main() {
+    for (int i = 0; i < 12; i++) {
+        stats[0].add(25.13f + i * 0.07f);
+        stats[1].add(81.2f - i * 0.11f);
+        stats[2].add(143.5f + i * 1.3f);
+    }
+    UNITY_BEGIN();
+    RUN_TEST(bench_binary_summary);
+    RUN_TEST(bench_binary_packed_summary);
+    return UNITY_END();
+}
@@ -0,0 +1,225 @@
+#include <unity.h>
+#include <vector>
+#include "backoff.h"
+#include "circuit_breaker.h"
+
+static uint32_t fakeNow = 0;
+static uint32_t fakeMillis() { return fakeNow; }
+static uint32_t rngState = 1;
+static uint32_t fakeRandom(uint32_t bound) {
+    rngState = rngState * 1103515245u + 12345u;
+    return (rngState >> 8) % bound;
+}
+// Always the top of the range: the longest cool-down, the ceiling as backoff
+static uint32_t maxRandom(uint32_t bound) { return bound - 1; }
+
+static CircuitBreakerConfig testConfig() {
+    CircuitBreakerConfig config = defaultCircuitBreakerConfig();
+    config.failureThreshold = 3;
+    config.openMs = 1000;
+    config.maxOpenMs = 8000;
+    config.maxRetryAfterMs = 60000;
+    config.retryBudget = 2;
+    config.retryPercent = 50;
+    return config;
+}
+
+void setUp(void) {
+    fakeNow = 100000;
+    rngState = 1;
+}
+void tearDown(void) {}
+
+void test_backoff_ceiling_doubles_and_caps() {
+    TEST_ASSERT_EQUAL_UINT32(0, backoffCeilingMs(1000, 8000, 0));
+    TEST_ASSERT_EQUAL_UINT32(1000, backoffCeilingMs(1000, 8000, 1));
+    TEST_ASSERT_EQUAL_UINT32(4000, backoffCeilingMs(1000, 8000, 3));
+    TEST_ASSERT_EQUAL_UINT32(8000, backoffCeilingMs(1000, 8000, 5));
+    TEST_ASSERT_EQUAL_UINT32(8000, backoffCeilingMs(1000, 8000, 200)); // no overflow
+    TEST_ASSERT_EQUAL_UINT32(300000, backoffCeilingMs(5000, 300000, 31));
+}
+
+void test_full_jitter_spreads_over_the_window() {
+    TEST_ASSERT_EQUAL_UINT32(4000, fullJitterBackoffMs(1000, 8000, 3, NULL));
+    uint32_t lo = UINT32_MAX, hi = 0;
+    uint64_t sum = 0;
+    for (int i = 0; i < 1000; i++) {
+        uint32_t d = fullJitterBackoffMs(1000, 8000, 3, fakeRandom);
+        TEST_ASSERT_TRUE(d <= 4000);
+        if (d < lo) lo = d;
+        if (d > hi) hi = d;
+        sum += d;
+    }
+    // A fleet that failed at the same instant comes back over the whole window
+    TEST_ASSERT_TRUE(lo < 400);
+    TEST_ASSERT_TRUE(hi > 3600);
+    TEST_ASSERT_UINT32_WITHIN(300, 2000, (uint32_t)(sum / 1000));
+}
+
+void test_opens_after_consecutive_failures() {
+    CircuitBreaker breaker(testConfig(), fakeMillis, NULL);
+    TEST_ASSERT_TRUE(breaker.allow());
+    breaker.record(-3);
+    breaker.record(500);
+    breaker.record(200); // a success in between resets the count
+    breaker.record(503);
+    breaker.record(-5);
+    TEST_ASSERT_EQUAL(CIRCUIT_CLOSED, breaker.state());
+    breaker.record(502);
+    TEST_ASSERT_EQUAL(CIRCUIT_OPEN, breaker.state());
+    TEST_ASSERT_EQUAL_UINT32(1, breaker.stats().opened);
+    TEST_ASSERT_FALSE(breaker.allow());
+    TEST_ASSERT_EQUAL_UINT32(1000, breaker.msUntilAllowed());
+    TEST_ASSERT_EQUAL_UINT32(1, breaker.stats().rejected);
+}
+
+void test_client_errors_do_not_count() {
+    CircuitBreaker breaker(testConfig(), fakeMillis, NULL);
+    for (int i = 0; i < 10; i++) breaker.record(404);
+    TEST_ASSERT_EQUAL(CIRCUIT_CLOSED, breaker.state());
+    TEST_ASSERT_TRUE(CircuitBreaker::isFailure(429));
+    TEST_ASSERT_TRUE(CircuitBreaker::isFailure(0));
+    TEST_ASSERT_FALSE(CircuitBreaker::isFailure(401));
+}
+
+void test_half_open_lets_one_probe_through() {
+    CircuitBreaker breaker(testConfig(), fakeMillis, NULL);
+    for (int i = 0; i < 3; i++) breaker.record(-3);
+    fakeNow += 999;
+    TEST_ASSERT_FALSE(breaker.allow());
+    fakeNow += 1;
+    TEST_ASSERT_TRUE(breaker.allow());
+    TEST_ASSERT_EQUAL(CIRCUIT_HALF_OPEN, breaker.state());
+    TEST_ASSERT_FALSE(breaker.allow()); // the probe is still out
+    TEST_ASSERT_EQUAL_UINT32(1, breaker.stats().probes);
+    breaker.record(200);
+    TEST_ASSERT_EQUAL(CIRCUIT_CLOSED, breaker.state());
+    TEST_ASSERT_TRUE(breaker.allow());
+    TEST_ASSERT_EQUAL(0, breaker.failures());
+}
+
+void test_failed_probes_double_the_cool_down() {
+    CircuitBreaker breaker(testConfig(), fakeMillis, NULL);
+    for (int i = 0; i < 3; i++) breaker.record(-3);
+    uint32_t expected[] = {2000, 4000, 8000, 8000};
+    for (int i = 0; i < 4; i++) {
+        fakeNow += breaker.msUntilAllowed();
+        TEST_ASSERT_TRUE(breaker.allow());
+        breaker.record(503); // one failed probe reopens at once
+        TEST_ASSERT_EQUAL(CIRCUIT_OPEN, breaker.state());
+        TEST_ASSERT_EQUAL_UINT32(expected[i], breaker.msUntilAllowed());
+    }
+    // Recovery resets the ladder
+    fakeNow += breaker.msUntilAllowed();
+    TEST_ASSERT_TRUE(breaker.allow());
+    breaker.record(200);
+    for (int i = 0; i < 3; i++) breaker.record(-3);
+    TEST_ASSERT_EQUAL_UINT32(1000, breaker.msUntilAllowed());
+}
+
+void test_cool_down_is_jittered_but_never_short() {
+    std::vector<uint32_t> seen;
+    for (int d = 0; d < 50; d++) {
+        CircuitBreaker breaker(testConfig(), fakeMillis, fakeRandom);
+        for (int i = 0; i < 3; i++) breaker.record(-3);
+        uint32_t wait = breaker.msUntilAllowed();
+        TEST_ASSERT_TRUE(wait >= 500 && wait <= 1000);
+        seen.push_back(wait);
+    }
+    bool differ = false;
+    for (size_t i = 1; i < seen.size(); i++) differ |= seen[i] != seen[0];
+    TEST_ASSERT_TRUE(differ);
+}
+
+void test_lost_probe_does_not_hold_the_circuit() {
+    CircuitBreaker breaker(testConfig(), fakeMillis, NULL);
+    for (int i = 0; i < 3; i++) breaker.record(-3);
+    fakeNow += 1000;
+    TEST_ASSERT_TRUE(breaker.allow()); // its result is never recorded
+    fakeNow += 500;
+    TEST_ASSERT_FALSE(breaker.allow());
+    TEST_ASSERT_EQUAL_UINT32(500, breaker.msUntilAllowed());
+    fakeNow += 500;
+    TEST_ASSERT_TRUE(breaker.allow());
+    TEST_ASSERT_EQUAL_UINT32(2, breaker.stats().probes);
+}
+
+void test_retry_after_opens_for_as_long_as_asked() {
+    CircuitBreaker breaker(testConfig(), fakeMillis, NULL);
+    breaker.record(503, 30);
+    TEST_ASSERT_EQUAL(CIRCUIT_OPEN, breaker.state());
+    TEST_ASSERT_EQUAL_UINT32(30000, breaker.msUntilAllowed());
+    TEST_ASSERT_EQUAL_UINT32(1, breaker.stats().throttled);
+    fakeNow += 29999;
+    TEST_ASSERT_FALSE(breaker.allow());
+    fakeNow += 1;
+    TEST_ASSERT_TRUE(breaker.allow());
+    breaker.record(200);
+
+    // A 429 without a header still opens, for the computed cool-down
+    breaker.record(429);
+    TEST_ASSERT_EQUAL(CIRCUIT_OPEN, breaker.state());
+    TEST_ASSERT_EQUAL_UINT32(1000, breaker.msUntilAllowed());
+
+    // An absurd Retry-After is capped
+    CircuitBreaker capped(testConfig(), fakeMillis, NULL);
+    capped.record(429, 86400);
+    TEST_ASSERT_EQUAL_UINT32(60000, capped.msUntilAllowed());
+}
+
+void test_retry_after_is_spread_on_top() {
+    CircuitBreaker breaker(testConfig(), fakeMillis, maxRandom);
+    breaker.record(503, 20);
+    TEST_ASSERT_EQUAL_UINT32(25000, breaker.msUntilAllowed());
+}
+
+void test_retry_budget_refills_from_successes() {
+    CircuitBreaker breaker(testConfig(), fakeMillis, NULL);
+    TEST_ASSERT_EQUAL_UINT32(2, breaker.retryTokens());
+    TEST_ASSERT_TRUE(breaker.allowRetry());
+    TEST_ASSERT_TRUE(breaker.allowRetry());
+    TEST_ASSERT_FALSE(breaker.allowRetry());
+    TEST_ASSERT_EQUAL_UINT32(1, breaker.stats().retriesDenied);
+    breaker.record(200);
+    TEST_ASSERT_FALSE(breaker.allowRetry()); // half a retry per success
+    breaker.record(200);
+    TEST_ASSERT_TRUE(breaker.allowRetry());
+    for (int i = 0; i < 20; i++) breaker.record(200);
+    TEST_ASSERT_EQUAL_UINT32(2, breaker.retryTokens()); // never above the budget
+}
+
+void test_no_retries_while_open() {
+    CircuitBreaker breaker(testConfig(), fakeMillis, NULL);
+    for (int i = 0; i < 3; i++) breaker.record(-3);
+    TEST_ASSERT_FALSE(breaker.allowRetry());
+    TEST_ASSERT_EQUAL_UINT32(2, breaker.retryTokens());
+}
+
+void test_clock_wrap() {
+    fakeNow = UINT32_MAX - 200;
+    CircuitBreaker breaker(testConfig(), fakeMillis, NULL);
+    for (int i = 0; i < 3; i++) breaker.record(-3);
+    TEST_ASSERT_EQUAL_UINT32(1000, breaker.msUntilAllowed());
+    fakeNow += 999;
+    TEST_ASSERT_FALSE(breaker.allow());
+    fakeNow += 1;
+    TEST_ASSERT_TRUE(breaker.allow());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_backoff_ceiling_doubles_and_caps);
+    RUN_TEST(test_full_jitter_spreads_over_the_window);
+    RUN_TEST(test_opens_after_consecutive_failures);
+    RUN_TEST(test_client_errors_do_not_count);
+    RUN_TEST(test_half_open_lets_one_probe_through);
+    RUN_TEST(test_failed_probes_double_the_cool_down);
+    RUN_TEST(test_cool_down_is_jittered_but_never_short);
+    RUN_TEST(test_lost_probe_does_not_hold_the_circuit);
+    RUN_TEST(test_retry_after_opens_for_as_long_as_asked);
+    RUN_TEST(test_retry_after_is_spread_on_top);
+    RUN_TEST(test_retry_budget_refills_from_successes);
+    RUN_TEST(test_no_retries_while_open);
+    RUN_TEST(test_clock_wrap);
+    return UNITY_END();
+}
@@ -0,0 +1,177 @@
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "command_channel.h"
+#include "device_config.h"
+#include "firmware_offer.h"
+#include "fw_version.h"
+#include "mqtt_standin.h"
+
+// The device side of the command channel against an in-process broker,
+// with a server client publishing commands and reading acks.
+
+struct Device {
+    FirmwareOffer offer;
+    bool offerPending = false;
+    ConfigUpdate config;
+    int configs = 0;
+    int diags = 0;
+};
+
+static int otaCommand(const char* json, size_t len, void* ctx) {
+    Device* d = static_cast<Device*>(ctx);
+    FirmwareOfferParser parser(d->offer);
+    if (!parser.feed(json, len) || !parser.finish()) return CMD_ERR_ARGS;
+    if (compareVersion(d->offer.version, "1.2.0") <= 0) return CMD_SKIPPED;
+    d->offerPending = true;
+    return CMD_OK;
+}
+
+static int configCommand(const char* json, size_t len, void* ctx) {
+    Device* d = static_cast<Device*>(ctx);
+    int status = parseConfigCommand(json, len, 64, &d->config);
+    if (status == CMD_OK) d->configs++;
+    return status;
+}
+
+static int diagCommand(const char*, size_t, void* ctx) {
+    static_cast<Device*>(ctx)->diags++;
+    return CMD_OK;
+}
+
+static std::vector<std::string> acks;
+static void recordAck(const char*, const uint8_t* payload, size_t len, void*) {
+    acks.push_back(std::string((const char*)payload, len));
+}
+
+struct Fixture {
+    Fixture() : server(broker.client()), deviceMqtt(broker.client()), channel(deviceMqtt, table, 3) {
+        table[0] = {"ota", otaCommand, &device};
+        table[1] = {"config", configCommand, &device};
+        table[2] = {"diag", diagCommand, &device};
+        server.connect("backend");
+        server.subscribe("edge/+/ack", 1);
+        server.onMessage(recordAck, NULL);
+        deviceMqtt.connect("esp32-01");
+        channel.begin("edge", "esp32-01");
+        channel.subscribe();
+    }
+
+    void send(const char* topic, const char* json, bool retain = false) {
+        server.publish(topic, (const uint8_t*)json, strlen(json), 1, retain);
+        deviceMqtt.loop();
+        server.loop();
+    }
+
+    MqttStandin broker;
+    MqttStandin::Client& server;
+    MqttStandin::Client& deviceMqtt;
+    Device device;
+    CommandSpec table[3];
+    CommandChannel channel;
+};
+
+void setUp(void) { acks.clear(); }
+void tearDown(void) {}
+
+void test_topic_matching() {
+    TEST_ASSERT_TRUE(MqttStandin::topicMatches("edge/+/ack", "edge/esp32-01/ack"));
+    TEST_ASSERT_TRUE(MqttStandin::topicMatches("edge/#", "edge/esp32-01/ack"));
+    TEST_ASSERT_FALSE(MqttStandin::topicMatches("edge/+", "edge/esp32-01/ack"));
+    TEST_ASSERT_FALSE(MqttStandin::topicMatches("edge/+/ack/x", "edge/esp32-01/ack"));
+    TEST_ASSERT_TRUE(MqttStandin::topicMatches("edge/esp32-01/cmd", "edge/esp32-01/cmd"));
+}
+
+void test_fleet_ota_command_is_dispatched_and_acked() {
+    Fixture f;
+    TEST_ASSERT_EQUAL_STRING("edge/esp32-01/cmd", f.channel.commandTopic());
+    f.send("edge/all/cmd",
+           "{\"cmd\":\"ota\",\"id\":\"r1\",\"version\":\"1.3.0\",\"url\":\"http://ota/fw.bin\","
+           "\"sha256\":\"9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08\"}");
+    TEST_ASSERT_TRUE(f.device.offerPending);
+    TEST_ASSERT_EQUAL_STRING("1.3.0", f.device.offer.version);
+    TEST_ASSERT_EQUAL_STRING("http://ota/fw.bin", f.device.offer.url);
+    TEST_ASSERT_EQUAL(1, (int)acks.size());
+    TEST_ASSERT_EQUAL_STRING("{\"id\":\"r1\",\"cmd\":\"ota\",\"ok\":true,\"status\":\"ok\"}", acks[0].c_str());
+}
+
+void test_offer_for_the_running_version_is_skipped() {
+    Fixture f;
+    f.send("edge/esp32-01/cmd", "{\"cmd\":\"ota\",\"id\":\"r2\",\"version\":\"1.2.0\",\"url\":\"http://ota/fw.bin\"}");
+    TEST_ASSERT_FALSE(f.device.offerPending);
+    TEST_ASSERT_EQUAL_STRING("{\"id\":\"r2\",\"cmd\":\"ota\",\"ok\":true,\"status\":\"skipped\"}", acks[0].c_str());
+}
+
+void test_config_command_is_range_checked() {
+    Fixture f;
+    f.send("edge/esp32-01/cmd", "{\"cmd\":\"config\",\"id\":\"c1\",\"sample_interval_ms\":10000,\"batch_samples\":20}");
+    TEST_ASSERT_EQUAL(1, f.device.configs);
+    TEST_ASSERT_TRUE(f.device.config.hasSampleInterval);
+    TEST_ASSERT_EQUAL_UINT32(10000, f.device.config.sampleIntervalMs);
+    TEST_ASSERT_EQUAL_UINT32(20, f.device.config.batchSamples);
+
+    f.send("edge/esp32-01/cmd", "{\"cmd\":\"config\",\"id\":\"c2\",\"sample_interval_ms\":10}");
+    f.send("edge/esp32-01/cmd", "{\"cmd\":\"config\",\"id\":\"c3\",\"batch_samples\":\"many\"}");
+    f.send("edge/esp32-01/cmd", "{\"cmd\":\"config\",\"id\":\"c4\"}");
+    TEST_ASSERT_EQUAL(1, f.device.configs);
+    TEST_ASSERT_EQUAL(4, (int)acks.size());
+    TEST_ASSERT_NOT_NULL(strstr(acks[1].c_str(), "\"status\":\"bad_arguments\""));
+    TEST_ASSERT_EQUAL_UINT32(3, f.channel.stats().failed);
+}
+
+void test_unknown_malformed_and_foreign_messages() {
+    Fixture f;
+    f.send("edge/esp32-01/cmd", "{\"cmd\":\"reboot\",\"id\":\"u1\"}");
+    TEST_ASSERT_EQUAL_STRING("{\"id\":\"u1\",\"cmd\":\"reboot\",\"ok\":false,\"status\":\"unknown_command\"}",
+                             acks[0].c_str());
+    f.send("edge/esp32-01/cmd", "not json");
+    TEST_ASSERT_EQUAL_STRING("{\"id\":null,\"cmd\":\"\",\"ok\":false,\"status\":\"malformed\"}", acks[1].c_str());
+    f.send("edge/esp32-02/cmd", "{\"cmd\":\"diag\"}"); // another device
+    TEST_ASSERT_EQUAL(0, f.device.diags);
+    TEST_ASSERT_EQUAL(2, (int)acks.size());
+}
+
+void test_redelivered_command_runs_once() {
+    Fixture f;
+    f.send("edge/esp32-01/cmd", "{\"cmd\":\"diag\",\"id\":\"d1\"}");
+    f.send("edge/esp32-01/cmd", "{\"cmd\":\"diag\",\"id\":\"d1\"}");
+    TEST_ASSERT_EQUAL(1, f.device.diags);
+    TEST_ASSERT_EQUAL(2, (int)acks.size());
+    TEST_ASSERT_EQUAL_STRING(acks[0].c_str(), acks[1].c_str());
+    TEST_ASSERT_EQUAL_UINT32(1, f.channel.stats().duplicates);
+    f.send("edge/esp32-01/cmd", "{\"cmd\":\"diag\",\"id\":\"d2\"}");
+    TEST_ASSERT_EQUAL(2, f.device.diags);
+}
+
+void test_retained_command_reaches_a_device_after_reconnect() {
+    Fixture f;
+    f.broker.setUp(false);
+    TEST_ASSERT_FALSE(f.deviceMqtt.connected());
+    f.broker.setUp(true);
+    f.server.connect("backend");
+    f.server.subscribe("edge/+/ack", 1);
+    // Rollout published while the device was offline
+    const char* cmd = "{\"cmd\":\"ota\",\"id\":\"r9\",\"version\":\"2.0.0\",\"url\":\"http://ota/fw2.bin\"}";
+    f.server.publish("edge/all/cmd", (const uint8_t*)cmd, strlen(cmd), 1, true);
+
+    TEST_ASSERT_TRUE(f.deviceMqtt.connect("esp32-01"));
+    TEST_ASSERT_TRUE(f.channel.subscribe());
+    f.deviceMqtt.loop();
+    f.server.loop();
+    TEST_ASSERT_TRUE(f.device.offerPending);
+    TEST_ASSERT_EQUAL_STRING("2.0.0", f.device.offer.version);
+    TEST_ASSERT_EQUAL(1, (int)acks.size());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_topic_matching);
+    RUN_TEST(test_fleet_ota_command_is_dispatched_and_acked);
+    RUN_TEST(test_offer_for_the_running_version_is_skipped);
+    RUN_TEST(test_config_command_is_range_checked);
+    RUN_TEST(test_unknown_malformed_and_foreign_messages);
+    RUN_TEST(test_redelivered_command_runs_once);
+    RUN_TEST(test_retained_command_reaches_a_device_after_reconnect);
+    return UNITY_END();
+}
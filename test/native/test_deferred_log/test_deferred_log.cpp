@@ -0,0 +1,185 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One module compiled down to warnings for the compile-out test
+#define LOG_MAX_POWER LOG_LEVEL_WARN
+#include "deferred_log.h"
+
+static uint32_t fakeNow = 0;
+static uint32_t fakeMillis() { return fakeNow; }
+
+static std::vector<std::string> lines;
+static std::vector<LogLine> meta;
+
+static void collect(const LogLine& line, void*) {
+    lines.push_back(std::string(line.text, line.len));
+    meta.push_back(line);
+}
+
+void setUp(void) {
+    fakeNow = 12345;
+    lines.clear();
+    meta.clear();
+}
+void tearDown(void) {
+    logInstall(NULL);
+}
+
+void test_formats_like_printf_when_drained() {
+    static LogSlot slots[8];
+    DeferredLog log(slots, 8, fakeMillis);
+    char version[8];
+    strcpy(version, "1.2.0");
+    log.write(LOG_MOD_NET, LOG_LEVEL_INFO, "[HTTP] %s %s attempt %u/%u: %d", "POST", "http://x/api/log",
+              (uint8_t)1, (uint8_t)3, -3);
+    log.write(LOG_MOD_OTA, LOG_LEVEL_WARN, "[OTA] %-6s|%5.2f|%x|%lu|%c|100%%|%zu", version, 3.14159, 255u,
+              (unsigned long)4000000000UL, 'k', (size_t)7);
+    strcpy(version, "9.9.9"); // copied at the call, not read at drain time
+    TEST_ASSERT_EQUAL(2, (int)log.size());
+    TEST_ASSERT_EQUAL(0, (int)lines.size()); // nothing formatted yet
+
+    fakeNow = 20000;
+    TEST_ASSERT_EQUAL(2, (int)log.drain(collect, NULL));
+    TEST_ASSERT_EQUAL_STRING("[HTTP] POST http://x/api/log attempt 1/3: -3", lines[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("[OTA] 1.2.0 | 3.14|ff|4000000000|k|100%|7", lines[1].c_str());
+    TEST_ASSERT_EQUAL_UINT32(12345, meta[0].ms); // stamped when written
+    TEST_ASSERT_EQUAL(LOG_MOD_OTA, meta[1].module);
+    TEST_ASSERT_EQUAL(LOG_LEVEL_WARN, meta[1].level);
+    TEST_ASSERT_EQUAL(0, (int)log.size());
+
+    LogLine line = meta[1];
+    line.text = lines[1].c_str(); // the drain's buffer is gone
+    char out[64];
+    size_t n = formatLogLine(line, out, sizeof(out));
+    TEST_ASSERT_EQUAL(strlen(out), n);
+    TEST_ASSERT_EQUAL_STRING_LEN("12.345 W [OTA] 1.2.0 ", out, 21);
+    TEST_ASSERT_EQUAL('\n', out[n - 1]);
+}
+
+void test_missing_long_and_extra_arguments() {
+    static LogSlot slots[4];
+    DeferredLog log(slots, 4, fakeMillis);
+    log.write(LOG_MOD_CORE, LOG_LEVEL_INFO, "%d and %s", 5);             // one short
+    log.write(LOG_MOD_CORE, LOG_LEVEL_INFO, "%s", 42);                   // wrong type
+    log.write(LOG_MOD_CORE, LOG_LEVEL_INFO, "%d%d%d%d%d%d%d", 1, 2, 3, 4, 5, 6, 7); // one past LOG_MAX_ARGS
+    std::string big(100, 'a');
+    log.write(LOG_MOD_CORE, LOG_LEVEL_INFO, "<%s><%s><%s>", big.c_str(), "b", (const char*)NULL);
+    log.drain(collect, NULL);
+    TEST_ASSERT_EQUAL_STRING("5 and ?", lines[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("?", lines[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("123456?", lines[2].c_str());
+    // The text area holds LOG_TEXT_BYTES: the long string is cut, later ones come out empty
+    TEST_ASSERT_EQUAL_STRING(("<" + std::string(LOG_TEXT_BYTES - 1, 'a') + "><><>").c_str(), lines[3].c_str());
+}
+
+void test_full_ring_drops_and_reports() {
+    static LogSlot slots[4];
+    DeferredLog log(slots, 4, fakeMillis);
+    for (int i = 0; i < 7; i++) log.write(LOG_MOD_SENSOR, LOG_LEVEL_INFO, "n=%d", i);
+    TEST_ASSERT_EQUAL_UINT32(4, log.written());
+    TEST_ASSERT_EQUAL_UINT32(3, log.dropped());
+    TEST_ASSERT_EQUAL_UINT32(4, log.highWater());
+
+    TEST_ASSERT_EQUAL(2, (int)log.drain(collect, NULL, 2));
+    TEST_ASSERT_EQUAL_STRING("[Log] 3 records dropped, ring full", lines[0].c_str());
+    TEST_ASSERT_EQUAL(LOG_LEVEL_WARN, meta[0].level);
+    TEST_ASSERT_EQUAL_STRING("n=0", lines[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("n=1", lines[2].c_str());
+
+    // Freed slots take new records; the drop is reported once
+    log.write(LOG_MOD_SENSOR, LOG_LEVEL_INFO, "n=%d", 7);
+    log.drain(collect, NULL);
+    TEST_ASSERT_EQUAL(6, (int)lines.size());
+    TEST_ASSERT_EQUAL_STRING("n=3", lines[4].c_str());
+    TEST_ASSERT_EQUAL_STRING("n=7", lines[5].c_str());
+}
+
+static int evaluated = 0;
+static int sideEffect() { return ++evaluated; }
+
+void test_levels_compile_out_per_module() {
+    static LogSlot slots[8];
+    DeferredLog log(slots, 8, fakeMillis);
+    LOGI(NET, "not installed %d", sideEffect()); // nowhere to go: arguments not evaluated
+    TEST_ASSERT_EQUAL(0, evaluated);
+
+    logInstall(&log);
+    LOGI(POWER, "gone %d", sideEffect());  // above LOG_MAX_POWER: not even evaluated
+    LOGD(NET, "gone %d", sideEffect());    // above the default LOG_MAX
+    LOGW(POWER, "kept %d", sideEffect());
+    LOGI(NET, "kept %d", sideEffect());
+    LOGE(CMD, "kept");
+    TEST_ASSERT_EQUAL(2, evaluated);
+    log.drain(collect, NULL);
+    TEST_ASSERT_EQUAL(3, (int)lines.size());
+    TEST_ASSERT_EQUAL_STRING("kept 1", lines[0].c_str());
+    TEST_ASSERT_EQUAL(LOG_MOD_POWER, meta[0].module);
+    TEST_ASSERT_EQUAL_STRING("kept 2", lines[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("cmd", logModuleName(meta[2].module));
+    TEST_ASSERT_EQUAL('E', logLevelLetter(meta[2].level));
+}
+
+// Four tasks write while one drains: every record arrives once, each
+// task's records in order, and whatever did not fit is counted
+#define WRITERS 4
+#define PER_WRITER 20000
+
+struct Seen {
+    std::vector<int> next;
+    uint32_t records;
+    bool ordered;
+};
+
+static void checkOrder(const LogLine& line, void* ctx) {
+    Seen* seen = static_cast<Seen*>(ctx);
+    int writer = 0, n = 0;
+    if (sscanf(line.text, "w%d n%d", &writer, &n) != 2) return; // the drop report
+    if (n < seen->next[writer]) seen->ordered = false;
+    seen->next[writer] = n + 1;
+    seen->records++;
+}
+
+void test_concurrent_writers_and_a_drain_task() {
+    static LogSlot slots[64];
+    DeferredLog log(slots, 64, fakeMillis);
+    Seen seen;
+    seen.next.assign(WRITERS, 0);
+    seen.records = 0;
+    seen.ordered = true;
+    std::atomic<int> running(WRITERS);
+    std::vector<std::thread> writers;
+    for (int w = 0; w < WRITERS; w++) {
+        writers.push_back(std::thread([&log, &running, w]() {
+            for (int i = 0; i < PER_WRITER; i++) log.write(LOG_MOD_NET, LOG_LEVEL_INFO, "w%d n%d", w, i);
+            running--;
+        }));
+    }
+    std::thread drainer([&]() {
+        while (running.load() > 0) {
+            if (log.drain(checkOrder, &seen) == 0) std::this_thread::yield();
+        }
+        log.drain(checkOrder, &seen);
+    });
+    for (size_t i = 0; i < writers.size(); i++) writers[i].join();
+    drainer.join();
+    TEST_ASSERT_TRUE(seen.ordered);
+    TEST_ASSERT_EQUAL_UINT32(WRITERS * PER_WRITER, log.written() + log.dropped());
+    TEST_ASSERT_EQUAL_UINT32(log.written(), seen.records);
+    TEST_ASSERT_TRUE(log.written() > 0);
+    TEST_ASSERT_EQUAL(0, (int)log.size());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_formats_like_printf_when_drained);
+    RUN_TEST(test_missing_long_and_extra_arguments);
+    RUN_TEST(test_full_ring_drops_and_reports);
+    RUN_TEST(test_levels_compile_out_per_module);
+    RUN_TEST(test_concurrent_writers_and_a_drain_task);
+    return UNITY_END();
+}
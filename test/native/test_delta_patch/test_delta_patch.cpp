@@ -0,0 +1,265 @@
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "delta_encoder.h"
+#include "delta_patch.h"
+#include "http_session_pool.h"
+#include "http_standin.h"
+#include "ota_downloader.h"
+#include "posix_transport.h"
+
+typedef std::vector<uint8_t> Bytes;
+
+static uint32_t fakeNow = 0;
+static uint32_t fakeMillis() { return fakeNow; }
+static void fakeSleep(uint32_t ms) { fakeNow += ms; }
+
+// Same generator as the fixture script used for the Python tool check.
+static Bytes lcg(uint32_t seed, size_t n) {
+    Bytes out(n);
+    uint32_t x = seed;
+    for (size_t i = 0; i < n; i++) {
+        x = x * 1103515245u + 12345u;
+        out[i] = (uint8_t)(x >> 16);
+    }
+    return out;
+}
+
+static Bytes splice(const Bytes& a, size_t at, size_t remove, const Bytes& insert) {
+    Bytes out(a.begin(), a.begin() + at);
+    out.insert(out.end(), insert.begin(), insert.end());
+    out.insert(out.end(), a.begin() + at + remove, a.end());
+    return out;
+}
+
+// A typical release: a few constants change, code is inserted and removed
+// (shifting everything after it), and new data is appended.
+static Bytes nextRelease(const Bytes& old) {
+    Bytes img = old;
+    for (size_t i = 1000; i < 1040; i += 4) img[i]++;
+    img = splice(img, 5000, 0, lcg(2, 300));
+    img = splice(img, 9000, 200, Bytes());
+    Bytes tail = lcg(3, 100);
+    img.insert(img.end(), tail.begin(), tail.end());
+    return img;
+}
+
+class MemorySource : public SourceImage {
+public:
+    explicit MemorySource(const Bytes& image) : image_(image) {}
+    bool read(uint32_t offset, uint8_t* buf, size_t len) {
+        reads++;
+        if (offset + len > image_.size()) return false;
+        memcpy(buf, image_.data() + offset, len);
+        return true;
+    }
+    int reads = 0;
+
+private:
+    const Bytes& image_;
+};
+
+class MemoryWriter : public FlashWriter {
+public:
+    bool begin(uint32_t size) {
+        begun = true;
+        announced = size;
+        return true;
+    }
+    bool write(const uint8_t* p, size_t len) {
+        data.insert(data.end(), p, p + len);
+        return true;
+    }
+    bool commit() { return committed = true; }
+    void abort() { aborted = true; }
+
+    bool begun = false, committed = false, aborted = false;
+    uint32_t announced = 0;
+    Bytes data;
+};
+
+// Feeds the patch in pieces of `step` bytes, as the HTTP sink would.
+static int apply(const Bytes& source, const Bytes& patch, size_t step, MemoryWriter& target,
+                 const char* expectHex = NULL) {
+    MemorySource src(source);
+    uint8_t buffer[1024];
+    DeltaPatchWriter delta(src, target, buffer, sizeof(buffer));
+    delta.expectTarget(expectHex);
+    delta.begin((uint32_t)patch.size());
+    for (size_t off = 0; off < patch.size(); off += step) {
+        size_t n = patch.size() - off < step ? patch.size() - off : step;
+        if (!delta.write(patch.data() + off, n)) {
+            delta.abort();
+            return delta.error();
+        }
+    }
+    if (!delta.commit()) {
+        delta.abort();
+        return delta.error();
+    }
+    return DELTA_OK;
+}
+
+void setUp(void) { fakeNow = 1000; }
+void tearDown(void) {}
+
+void test_round_trip_typical_release() {
+    Bytes oldImg = lcg(1, 64 * 1024);
+    Bytes newImg = nextRelease(oldImg);
+    Bytes patch = makeDeltaPatch(oldImg.data(), oldImg.size(), newImg.data(), newImg.size());
+    TEST_ASSERT_TRUE(patch.size() < newImg.size() / 20);
+
+    MemoryWriter target;
+    TEST_ASSERT_EQUAL(DELTA_OK, apply(oldImg, patch, 4096, target));
+    TEST_ASSERT_TRUE(target.committed);
+    TEST_ASSERT_EQUAL(newImg.size(), target.announced);
+    TEST_ASSERT_TRUE(target.data == newImg);
+}
+
+void test_round_trip_byte_by_byte() {
+    Bytes oldImg = lcg(1, 20000);
+    Bytes newImg = nextRelease(oldImg);
+    Bytes patch = makeDeltaPatch(oldImg.data(), oldImg.size(), newImg.data(), newImg.size());
+    for (size_t step = 1; step <= 97; step += 48) {
+        MemoryWriter target;
+        TEST_ASSERT_EQUAL(DELTA_OK, apply(oldImg, patch, step, target));
+        TEST_ASSERT_TRUE(target.data == newImg);
+    }
+}
+
+void test_round_trip_edge_cases() {
+    Bytes a = lcg(5, 10000);
+    Bytes unrelated = lcg(6, 12000);
+    Bytes tiny = lcg(7, 10);
+    Bytes empty;
+    const Bytes* pairs[][2] = {{&a, &a}, {&a, &unrelated}, {&a, &tiny}, {&tiny, &a}, {&a, &empty}, {&empty, &a}};
+    for (size_t i = 0; i < sizeof(pairs) / sizeof(pairs[0]); i++) {
+        const Bytes& src = *pairs[i][0];
+        const Bytes& dst = *pairs[i][1];
+        Bytes patch = makeDeltaPatch(src.data(), src.size(), dst.data(), dst.size());
+        MemoryWriter target;
+        TEST_ASSERT_EQUAL_MESSAGE(DELTA_OK, apply(src, patch, 333, target), std::to_string(i).c_str());
+        TEST_ASSERT_TRUE(target.data == dst);
+    }
+    // Identical images cost a header and one copy.
+    Bytes same = makeDeltaPatch(a.data(), a.size(), a.data(), a.size());
+    TEST_ASSERT_TRUE(same.size() < DELTA_HEADER_LEN + 8);
+}
+
+void test_matches_python_tool() {
+    // tools/make_delta_patch.py on the same two images gives 535 bytes with this digest.
+    Bytes oldImg = lcg(1, 20000);
+    Bytes newImg = nextRelease(oldImg);
+    Bytes patch = makeDeltaPatch(oldImg.data(), oldImg.size(), newImg.data(), newImg.size());
+    TEST_ASSERT_EQUAL(535, patch.size());
+    Sha256 sha;
+    uint8_t d[SHA256_DIGEST_LEN];
+    sha.update(patch.data(), patch.size());
+    sha.finish(d);
+    TEST_ASSERT_TRUE(sha256MatchesHex(d, "faba4570ca2e5c56295ddca31e33f14042ff0e62fa5c864a467863e9c905ea51"));
+}
+
+void test_wrong_source_is_rejected_before_flash() {
+    Bytes oldImg = lcg(1, 20000);
+    Bytes newImg = nextRelease(oldImg);
+    Bytes patch = makeDeltaPatch(oldImg.data(), oldImg.size(), newImg.data(), newImg.size());
+    Bytes otherImg = oldImg;
+    otherImg[12345] ^= 1;
+    MemoryWriter target;
+    TEST_ASSERT_EQUAL(DELTA_ERR_SOURCE, apply(otherImg, patch, 512, target));
+    TEST_ASSERT_FALSE(target.begun);
+}
+
+void test_unexpected_target_is_rejected_before_flash() {
+    Bytes oldImg = lcg(1, 20000);
+    Bytes newImg = nextRelease(oldImg);
+    Bytes patch = makeDeltaPatch(oldImg.data(), oldImg.size(), newImg.data(), newImg.size());
+    std::string wrong(64, 'a');
+    MemoryWriter target;
+    TEST_ASSERT_EQUAL(DELTA_ERR_DIGEST, apply(oldImg, patch, 512, target, wrong.c_str()));
+    TEST_ASSERT_FALSE(target.begun);
+}
+
+void test_corrupt_or_truncated_patch_never_commits() {
+    Bytes oldImg = lcg(1, 20000);
+    Bytes newImg = nextRelease(oldImg);
+    Bytes patch = makeDeltaPatch(oldImg.data(), oldImg.size(), newImg.data(), newImg.size());
+
+    Bytes truncated(patch.begin(), patch.end() - 1);
+    MemoryWriter t1;
+    TEST_ASSERT_EQUAL(DELTA_ERR_INCOMPLETE, apply(oldImg, truncated, 512, t1));
+    TEST_ASSERT_FALSE(t1.committed);
+    TEST_ASSERT_TRUE(t1.aborted);
+
+    // Random damage to the op stream must fail or still build the right image.
+    srand(3);
+    for (int k = 0; k < 200; k++) {
+        Bytes bad = patch;
+        size_t pos = DELTA_HEADER_LEN + (size_t)rand() % (patch.size() - DELTA_HEADER_LEN);
+        bad[pos] ^= (uint8_t)(1 + rand() % 255);
+        MemoryWriter t;
+        int rc = apply(oldImg, bad, 64, t);
+        if (rc == DELTA_OK) TEST_ASSERT_TRUE(t.data == newImg);
+        else TEST_ASSERT_FALSE(t.committed);
+    }
+
+    Bytes trailing = patch;
+    trailing.push_back(0);
+    MemoryWriter t2;
+    TEST_ASSERT_EQUAL(DELTA_ERR_FORMAT, apply(oldImg, trailing, 512, t2));
+}
+
+void test_patch_download_resumes_through_ota_downloader() {
+    Bytes oldImg = lcg(1, 128 * 1024);
+    Bytes newImg = nextRelease(oldImg);
+    Bytes patch = makeDeltaPatch(oldImg.data(), oldImg.size(), newImg.data(), newImg.size());
+    std::string body(patch.begin(), patch.end());
+    int requests = 0;
+    HttpStandin server([&](const StandinRequest& req, StandinResponse& resp) {
+        size_t from = 0;
+        auto it = req.headers.find("range");
+        if (it != req.headers.end()) {
+            from = strtoul(it->second.c_str() + 6, NULL, 10);
+            resp.status = 206;
+            resp.extraHeaders = "Content-Range: bytes " + std::to_string(from) + "-" +
+                                std::to_string(body.size() - 1) + "/" + std::to_string(body.size()) + "\r\n";
+        }
+        resp.body = body.substr(from);
+        if (++requests == 1) resp.cutAfter = body.size() / 2;
+    });
+    TEST_ASSERT_TRUE(server.start());
+    PosixTransportFactory factory;
+    HttpPoolConfig poolCfg = defaultHttpPoolConfig(fakeMillis);
+    poolCfg.ioTimeoutMs = 2000;
+    HttpSessionPool pool(factory, poolCfg);
+
+    MemorySource source(oldImg);
+    MemoryWriter flash;
+    uint8_t flashBuffer[4096];
+    DeltaPatchWriter delta(source, flash, flashBuffer, sizeof(flashBuffer));
+    uint8_t patchBuffer[256];
+    OtaDownloader ota(pool, delta, patchBuffer, sizeof(patchBuffer), defaultOtaConfig(fakeMillis, fakeSleep));
+
+    std::string url = server.url("/firmware/esp32.patch");
+    TEST_ASSERT_EQUAL(OTA_OK, ota.run(url.c_str(), NULL, NULL));
+    TEST_ASSERT_EQUAL(2, requests);
+    TEST_ASSERT_EQUAL(1, ota.stats().resumes);
+    TEST_ASSERT_TRUE(flash.committed);
+    TEST_ASSERT_TRUE(flash.data == newImg);
+    TEST_ASSERT_EQUAL(newImg.size(), delta.targetBytes());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_typical_release);
+    RUN_TEST(test_round_trip_byte_by_byte);
+    RUN_TEST(test_round_trip_edge_cases);
+    RUN_TEST(test_matches_python_tool);
+    RUN_TEST(test_wrong_source_is_rejected_before_flash);
+    RUN_TEST(test_unexpected_target_is_rejected_before_flash);
+    RUN_TEST(test_corrupt_or_truncated_patch_never_commits);
+    RUN_TEST(test_patch_download_resumes_through_ota_downloader);
+    return UNITY_END();
+}
@@ -0,0 +1,157 @@
+#include <unity.h>
+#include <math.h>
+#include "edge_analytics.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static AlarmLimits limits(float highSet, float highClear, float lowSet, float lowClear, uint8_t hold) {
+    AlarmLimits l;
+    l.highSet = highSet;
+    l.highClear = highClear;
+    l.lowSet = lowSet;
+    l.lowClear = lowClear;
+    l.holdSamples = hold;
+    return l;
+}
+
+void test_running_stats() {
+    RunningStats s;
+    TEST_ASSERT_EQUAL_UINT32(0, s.count());
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, s.variance());
+    const float v[] = {2, 4, 4, 4, 5, 5, 7, 9};
+    for (float x : v) s.add(x);
+    TEST_ASSERT_EQUAL_UINT32(8, s.count());
+    TEST_ASSERT_EQUAL_FLOAT(2.0f, s.min());
+    TEST_ASSERT_EQUAL_FLOAT(9.0f, s.max());
+    TEST_ASSERT_EQUAL_FLOAT(5.0f, s.mean());
+    TEST_ASSERT_FLOAT_WITHIN(1e-5f, 32.0f / 7.0f, s.variance());
+    s.reset();
+    s.add(-3.5f);
+    TEST_ASSERT_EQUAL_FLOAT(-3.5f, s.min());
+    TEST_ASSERT_EQUAL_FLOAT(-3.5f, s.max());
+}
+
+// Sliding results match a brute-force pass over the last N values.
+void test_sliding_window_matches_brute_force() {
+    const size_t N = 8;
+    SlidingWindow<N> w;
+    float history[200];
+    uint32_t rng = 7;
+    for (int i = 0; i < 200; i++) {
+        rng = rng * 1103515245u + 12345u;
+        history[i] = 20.0f + (float)((rng >> 8) % 1000) / 100.0f + (i > 100 ? 15.0f : 0.0f);
+        w.add(history[i]);
+        size_t n = i + 1 < (int)N ? i + 1 : N;
+        TEST_ASSERT_EQUAL(n, w.count());
+        float mn = INFINITY, mx = -INFINITY, sum = 0;
+        for (size_t k = 0; k < n; k++) {
+            float x = history[i - k];
+            if (x < mn) mn = x;
+            if (x > mx) mx = x;
+            sum += x;
+        }
+        float mean = sum / n, m2 = 0;
+        for (size_t k = 0; k < n; k++) m2 += (history[i - k] - mean) * (history[i - k] - mean);
+        TEST_ASSERT_EQUAL_FLOAT(mn, w.min());
+        TEST_ASSERT_EQUAL_FLOAT(mx, w.max());
+        TEST_ASSERT_FLOAT_WITHIN(1e-3f, mean, w.mean());
+        if (n > 1) TEST_ASSERT_FLOAT_WITHIN(1e-2f, m2 / (n - 1), w.variance());
+    }
+}
+
+// A long run with a large offset stays accurate thanks to the periodic recompute.
+void test_sliding_window_does_not_drift() {
+    SlidingWindow<16> w;
+    for (int i = 0; i < 200000; i++) w.add(1000.0f + (float)(i % 16) * 0.01f);
+    TEST_ASSERT_FLOAT_WITHIN(1e-3f, 1000.075f, w.mean());
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 0.0022667f, w.variance());
+    TEST_ASSERT_EQUAL_FLOAT(1000.0f, w.min());
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 1000.15f, w.max());
+}
+
+void test_ewma() {
+    Ewma e(0.5f);
+    TEST_ASSERT_FALSE(e.primed());
+    TEST_ASSERT_EQUAL_FLOAT(10.0f, e.add(10.0f));
+    TEST_ASSERT_EQUAL_FLOAT(15.0f, e.add(20.0f));
+    TEST_ASSERT_EQUAL_FLOAT(17.5f, e.add(20.0f));
+    e.reset();
+    TEST_ASSERT_EQUAL_FLOAT(3.0f, e.add(3.0f));
+}
+
+void test_hysteresis_does_not_chatter() {
+    HysteresisAlarm a(limits(30.0f, 29.0f, -INFINITY, -INFINITY, 1));
+    const float v[] = {28.0f, 30.0f, 29.5f, 30.2f, 29.1f, 28.9f, 29.5f};
+    const bool changed[] = {false, true, false, false, false, true, false};
+    const AlarmState state[] = {ALARM_CLEAR, ALARM_HIGH, ALARM_HIGH, ALARM_HIGH, ALARM_HIGH, ALARM_CLEAR, ALARM_CLEAR};
+    for (int i = 0; i < 7; i++) {
+        TEST_ASSERT_EQUAL(changed[i], a.update(v[i]));
+        TEST_ASSERT_EQUAL(state[i], a.state());
+    }
+    TEST_ASSERT_EQUAL_STRING("clear", alarmStateName(a.state()));
+}
+
+void test_low_alarm_and_hold_samples() {
+    HysteresisAlarm a(limits(INFINITY, INFINITY, 10.0f, 12.0f, 3));
+    TEST_ASSERT_FALSE(a.update(9.0f));
+    TEST_ASSERT_FALSE(a.update(13.0f)); // a glitch resets the count
+    TEST_ASSERT_FALSE(a.update(9.0f));
+    TEST_ASSERT_FALSE(a.update(9.0f));
+    TEST_ASSERT_TRUE(a.update(9.0f));
+    TEST_ASSERT_EQUAL(ALARM_LOW, a.state());
+    TEST_ASSERT_FALSE(a.update(11.0f)); // still below lowClear
+    TEST_ASSERT_FALSE(a.update(12.5f));
+    TEST_ASSERT_FALSE(a.update(12.5f));
+    TEST_ASSERT_TRUE(a.update(12.5f));
+    TEST_ASSERT_EQUAL(ALARM_CLEAR, a.state());
+}
+
+void test_deadband_report_by_exception() {
+    DeadbandFilter f(0.5f, 60000);
+    TEST_ASSERT_TRUE(f.shouldReport(25.0f, 0));   // first value always goes out
+    TEST_ASSERT_FALSE(f.shouldReport(25.4f, 1000));
+    TEST_ASSERT_FALSE(f.shouldReport(24.6f, 2000));
+    TEST_ASSERT_TRUE(f.shouldReport(25.6f, 3000));
+    TEST_ASSERT_EQUAL_FLOAT(25.6f, f.lastReported());
+    // Small drift is measured from the last reported value, not the last seen
+    TEST_ASSERT_FALSE(f.shouldReport(25.9f, 4000));
+    TEST_ASSERT_TRUE(f.shouldReport(25.7f, 63000)); // silence limit
+    DeadbandFilter never(1.0f, 0);
+    TEST_ASSERT_TRUE(never.shouldReport(1.0f, 0));
+    TEST_ASSERT_FALSE(never.shouldReport(1.0f, 0xffffffffu));
+}
+
+void test_channel_summaries_and_alarms() {
+    ChannelConfig c;
+    c.ewmaAlpha = 1.0f;
+    c.limits = limits(30.0f, 29.0f, -INFINITY, -INFINITY, 1);
+    c.deadband = 0.5f;
+    c.maxSilenceMs = 0;
+    ChannelAnalytics ch(c);
+    RunningStats out;
+    TEST_ASSERT_FALSE(ch.closeInterval(0, &out)); // nothing to report yet
+    for (int i = 0; i < 12; i++) TEST_ASSERT_FALSE(ch.add(25.0f + (i % 2) * 0.2f));
+    TEST_ASSERT_TRUE(ch.closeInterval(60000, &out));
+    TEST_ASSERT_EQUAL_UINT32(12, out.count());
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, 25.1f, out.mean());
+    TEST_ASSERT_EQUAL_UINT32(0, ch.interval().count());
+
+    for (int i = 0; i < 12; i++) ch.add(25.2f);
+    TEST_ASSERT_FALSE(ch.closeInterval(120000, &out)); // within the deadband
+    TEST_ASSERT_TRUE(ch.add(31.0f));
+    TEST_ASSERT_EQUAL(ALARM_HIGH, ch.alarm());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_running_stats);
+    RUN_TEST(test_sliding_window_matches_brute_force);
+    RUN_TEST(test_sliding_window_does_not_drift);
+    RUN_TEST(test_ewma);
+    RUN_TEST(test_hysteresis_does_not_chatter);
+    RUN_TEST(test_low_alarm_and_hold_samples);
+    RUN_TEST(test_deadband_report_by_exception);
+    RUN_TEST(test_channel_summaries_and_alarms);
+    return UNITY_END();
+}
@@ -0,0 +1,325 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "event_outbox.h"
+#include "net_scheduler.h"
+
+// NVS stand-in: the blob outlives the EventOutbox, the way NVS outlives a restart.
+class MemoryStore : public OutboxStore {
+public:
+    MemoryStore() : failSaves(false) {}
+
+    size_t load(void* buf, size_t cap) {
+        if (blob.empty() || blob.size() > cap) return 0;
+        memcpy(buf, blob.data(), blob.size());
+        return blob.size();
+    }
+    bool save(const void* data, size_t len) {
+        if (failSaves) return false;
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        blob.assign(p, p + len);
+        return true;
+    }
+
+    std::vector<uint8_t> blob;
+    bool failSaves;
+};
+
+// Records every request; results are scripted per call, OUTBOX_SENT once the script runs out.
+class ScriptedSender : public OutboxSender {
+public:
+    OutboxSendResult sendOtaLog(const OutboxEvent& event) {
+        sent.push_back(std::string("log:") + event.status + ":" + event.version);
+        return next();
+    }
+    OutboxSendResult sendSlack(const char* text, size_t len) {
+        sent.push_back("slack:" + std::string(text, len));
+        return next();
+    }
+
+    std::vector<OutboxSendResult> script;
+    std::vector<std::string> sent;
+
+private:
+    OutboxSendResult next() {
+        if (script.empty()) return OUTBOX_SENT;
+        OutboxSendResult r = script.front();
+        script.erase(script.begin());
+        return r;
+    }
+};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_events_survive_restart() {
+    MemoryStore store;
+    {
+        EventOutbox outbox(store);
+        TEST_ASSERT_EQUAL(0, outbox.restore());
+        OtaStats st = {1048576, 1048576, 20000, 300, 2, 1, 206};
+        TEST_ASSERT_TRUE(outbox.otaLog("update_success", "1.3.0", "", 21000, &st));
+        TEST_ASSERT_TRUE(outbox.slack("[OTA] Update successful: 1.3.0"));
+        // ESP.restart() here: nothing was delivered
+    }
+    EventOutbox after(store);
+    TEST_ASSERT_EQUAL(2, after.restore());
+    const OutboxEvent& log = after.at(0);
+    TEST_ASSERT_EQUAL(OUTBOX_OTA_LOG, log.kind);
+    TEST_ASSERT_EQUAL_STRING("update_success", log.status);
+    TEST_ASSERT_EQUAL_STRING("1.3.0", log.version);
+    TEST_ASSERT_EQUAL(21000, log.latencyMs);
+    TEST_ASSERT_TRUE(log.hasTransfer);
+    TEST_ASSERT_FALSE(log.hasHealth);
+    TEST_ASSERT_EQUAL_UINT32(1048576, log.transfer.bytes);
+    TEST_ASSERT_EQUAL(OUTBOX_SLACK, after.at(1).kind);
+    TEST_ASSERT_EQUAL_STRING("[OTA] Update successful: 1.3.0", after.at(1).text);
+
+    ScriptedSender sender;
+    OutboxDelivery d = after.deliver(sender, 8);
+    TEST_ASSERT_EQUAL(2, d.sent);
+    TEST_ASSERT_EQUAL(0, d.pending);
+    TEST_ASSERT_FALSE(d.failed);
+    // Delivered events do not come back after the next restart
+    EventOutbox again(store);
+    TEST_ASSERT_EQUAL(0, again.restore());
+}
+
+void test_damaged_or_foreign_blob_is_discarded() {
+    MemoryStore store;
+    {
+        EventOutbox outbox(store);
+        outbox.otaLog("rollback", "1.2.0", "Firmware rollback triggered", 0);
+    }
+    store.blob[20] ^= 0x01;
+    EventOutbox torn(store);
+    TEST_ASSERT_EQUAL(0, torn.restore());
+
+    // A blob of another size, e.g. from a build with another event layout
+    store.blob.assign(64, 0xAB);
+    EventOutbox foreign(store);
+    TEST_ASSERT_EQUAL(0, foreign.restore());
+    TEST_ASSERT_TRUE(foreign.otaLog("rollback", "1.2.0", "", 0));
+    TEST_ASSERT_EQUAL(1, foreign.size());
+}
+
+void test_duplicates_are_merged() {
+    MemoryStore store;
+    EventOutbox outbox(store);
+    OtaStats first = {100, 200, 1000, 0, 3, 0, -1};
+    OtaStats last = {150, 200, 1500, 0, 3, 1, -1};
+    outbox.otaLog("update_failed", "1.3.0", "OTA download failed after retries", 5000, &first);
+    outbox.slack("[OTA] Update failed: 1.3.0");
+    outbox.otaLog("update_failed", "1.3.0", "OTA download failed after retries", 7000, &last);
+    outbox.slack("[OTA] Update failed: 1.3.0");
+    outbox.slack("[OTA] Update failed: 1.3.0");
+    // Another error is another event
+    outbox.otaLog("update_failed", "1.3.0", "OTA image SHA-256 mismatch", 6000);
+
+    TEST_ASSERT_EQUAL(3, outbox.size());
+    TEST_ASSERT_EQUAL(3, outbox.stats().queued);
+    TEST_ASSERT_EQUAL(3, outbox.stats().merged);
+    const OutboxEvent& failed = outbox.at(0);
+    TEST_ASSERT_EQUAL(2, failed.count);
+    TEST_ASSERT_EQUAL(7000, failed.latencyMs);
+    TEST_ASSERT_EQUAL_UINT32(150, failed.transfer.bytes);
+    TEST_ASSERT_EQUAL(3, outbox.at(1).count);
+
+    char line[OUTBOX_TEXT_LEN + 16];
+    outboxSlackLine(outbox.at(1), line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("[OTA] Update failed: 1.3.0 (x3)", line);
+    // The merge was saved too
+    EventOutbox after(store);
+    TEST_ASSERT_EQUAL(3, after.restore());
+    TEST_ASSERT_EQUAL(2, after.at(0).count);
+}
+
+void test_failed_log_holds_back_the_later_ones() {
+    MemoryStore store;
+    EventOutbox outbox(store);
+    outbox.otaLog("delta_failed", "1.3.0", "OTA image SHA-256 mismatch", 3000);
+    outbox.otaLog("update_success", "1.3.0", "", 9000);
+    outbox.otaLog("healthy", "1.3.0", "", 40000);
+
+    ScriptedSender sender;
+    sender.script.push_back(OUTBOX_SENT);
+    sender.script.push_back(OUTBOX_RETRY);
+    OutboxDelivery d = outbox.deliver(sender, 8);
+    TEST_ASSERT_TRUE(d.failed);
+    TEST_ASSERT_EQUAL(1, d.sent);
+    TEST_ASSERT_EQUAL(2, d.pending);
+    // "healthy" was not tried: it must not reach the server before "update_success"
+    TEST_ASSERT_EQUAL(2, sender.sent.size());
+    TEST_ASSERT_EQUAL_STRING("log:delta_failed:1.3.0", sender.sent[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("log:update_success:1.3.0", sender.sent[1].c_str());
+    TEST_ASSERT_EQUAL(1, outbox.at(0).attempts);
+
+    // Restart before the retry; the order and the attempt count are kept
+    EventOutbox after(store);
+    TEST_ASSERT_EQUAL(2, after.restore());
+    sender.sent.clear();
+    d = after.deliver(sender, 8);
+    TEST_ASSERT_EQUAL(2, d.sent);
+    TEST_ASSERT_EQUAL(0, d.pending);
+    TEST_ASSERT_EQUAL_STRING("log:update_success:1.3.0", sender.sent[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("log:healthy:1.3.0", sender.sent[1].c_str());
+}
+
+void test_rejected_event_is_dropped() {
+    MemoryStore store;
+    EventOutbox outbox(store);
+    outbox.otaLog("update_failed", "1.3.0", "OTA failed", 1000);
+    outbox.otaLog("healthy", "1.2.0", "", 30000);
+    ScriptedSender sender;
+    sender.script.push_back(OUTBOX_REJECTED);
+    OutboxDelivery d = outbox.deliver(sender, 8);
+    TEST_ASSERT_EQUAL(1, d.rejected);
+    TEST_ASSERT_EQUAL(1, d.sent);
+    TEST_ASSERT_FALSE(d.failed);
+    TEST_ASSERT_TRUE(outbox.empty());
+    TEST_ASSERT_EQUAL(1, outbox.stats().rejected);
+}
+
+void test_slack_lines_batched_in_one_message() {
+    MemoryStore store;
+    EventOutbox outbox(store);
+    outbox.slack("[OTA] New firmware available: 1.3.0");
+    outbox.otaLog("update_success", "1.3.0", "", 9000);
+    outbox.slack("[OTA] Update successful: 1.3.0");
+
+    ScriptedSender sender;
+    sender.script.push_back(OUTBOX_SENT);  // the OTA log
+    sender.script.push_back(OUTBOX_RETRY); // Slack is down
+    OutboxDelivery d = outbox.deliver(sender, 8);
+    TEST_ASSERT_TRUE(d.failed);
+    TEST_ASSERT_EQUAL(1, d.sent);
+    TEST_ASSERT_EQUAL(2, d.pending);
+    TEST_ASSERT_EQUAL(2, sender.sent.size());
+    TEST_ASSERT_EQUAL_STRING("slack:[OTA] New firmware available: 1.3.0\n[OTA] Update successful: 1.3.0",
+                             sender.sent[1].c_str());
+    TEST_ASSERT_EQUAL(1, outbox.at(0).attempts);
+    TEST_ASSERT_EQUAL(1, outbox.at(1).attempts);
+
+    // Slack failing did not hold back the OTA log; next round the same message again
+    sender.sent.clear();
+    d = outbox.deliver(sender, 8);
+    TEST_ASSERT_EQUAL(2, d.sent);
+    TEST_ASSERT_EQUAL(1, sender.sent.size());
+    TEST_ASSERT_TRUE(outbox.empty());
+}
+
+void test_batch_limit_spreads_delivery() {
+    MemoryStore store;
+    EventOutbox outbox(store);
+    char version[8];
+    for (int i = 0; i < 5; i++) {
+        snprintf(version, sizeof(version), "1.%d.0", i);
+        outbox.otaLog("rollback", version, "", 0);
+    }
+    ScriptedSender sender;
+    OutboxDelivery d = outbox.deliver(sender, 2);
+    TEST_ASSERT_EQUAL(2, d.sent);
+    TEST_ASSERT_EQUAL(3, d.pending);
+    TEST_ASSERT_EQUAL_STRING("1.2.0", outbox.at(0).version);
+    d = outbox.deliver(sender, 2);
+    d = outbox.deliver(sender, 2);
+    TEST_ASSERT_EQUAL(0, d.pending);
+    TEST_ASSERT_EQUAL(5, sender.sent.size());
+    TEST_ASSERT_EQUAL_STRING("log:rollback:1.4.0", sender.sent[4].c_str());
+}
+
+void test_full_outbox_drops_the_oldest() {
+    MemoryStore store;
+    EventOutbox outbox(store);
+    char text[32];
+    for (int i = 0; i < OUTBOX_CAPACITY + 3; i++) {
+        snprintf(text, sizeof(text), "event %d", i);
+        outbox.slack(text);
+    }
+    TEST_ASSERT_EQUAL(OUTBOX_CAPACITY, outbox.size());
+    TEST_ASSERT_EQUAL(3, outbox.stats().dropped);
+    TEST_ASSERT_EQUAL_STRING("event 3", outbox.at(0).text);
+    TEST_ASSERT_TRUE(outbox.at(0).seq < outbox.at(1).seq);
+}
+
+void test_save_failure_is_reported() {
+    MemoryStore store;
+    EventOutbox outbox(store);
+    store.failSaves = true;
+    TEST_ASSERT_FALSE(outbox.otaLog("rollback", "1.2.0", "", 0));
+    // Still queued in RAM and delivered this boot
+    TEST_ASSERT_EQUAL(1, outbox.size());
+    TEST_ASSERT_EQUAL(1, outbox.stats().saveErrors);
+    store.failSaves = false;
+    ScriptedSender sender;
+    TEST_ASSERT_EQUAL(1, outbox.deliver(sender, 8).sent);
+}
+
+static uint32_t fakeNow = 0;
+static uint32_t fakeMillis() { return fakeNow; }
+
+// The firmware's outbox job: one batch per round, re-armed while events are left
+struct OutboxJob {
+    NetScheduler* sched;
+    EventOutbox* outbox;
+    OutboxSender* sender;
+    int id;
+    std::vector<uint32_t> rounds;
+};
+
+static JobResult outboxJob(void* ctx) {
+    OutboxJob* job = static_cast<OutboxJob*>(ctx);
+    if (job->outbox->empty()) return JOB_DONE;
+    job->rounds.push_back(fakeNow);
+    OutboxDelivery d = job->outbox->deliver(*job->sender, 4);
+    if (d.failed) return JOB_RETRY;
+    if (d.pending) job->sched->triggerIn(job->id, 5000);
+    return JOB_DONE;
+}
+
+void test_job_drains_several_batches() {
+    MemoryStore store;
+    EventOutbox outbox(store);
+    char version[8];
+    for (int i = 0; i < 7; i++) {
+        snprintf(version, sizeof(version), "1.%d.0", i);
+        outbox.otaLog("update_failed", version, "", 0);
+    }
+    ScriptedSender sender;
+    sender.script.push_back(OUTBOX_SENT);
+    sender.script.push_back(OUTBOX_RETRY); // the second round backs off and resumes with 1.1.0
+    fakeNow = 1000;
+    NetScheduler sched(fakeMillis, NULL, 0);
+    OutboxJob job = {&sched, &outbox, &sender, -1, {}};
+    JobSpec spec = {"outbox", outboxJob, &job, 0, 0, 0, 4, true, 10000, 300000};
+    job.id = sched.add(spec, 0);
+    sched.trigger(job.id);
+    for (uint32_t end = fakeNow + 60000; (int32_t)(end - fakeNow) > 0;) {
+        uint32_t sleep = sched.runDue();
+        fakeNow += sleep < end - fakeNow ? sleep : end - fakeNow;
+    }
+    TEST_ASSERT_TRUE(outbox.empty());
+    TEST_ASSERT_EQUAL(3, job.rounds.size());
+    TEST_ASSERT_EQUAL(10000, job.rounds[1] - job.rounds[0]); // backoff after the failure
+    TEST_ASSERT_EQUAL(5000, job.rounds[2] - job.rounds[1]);  // OUTBOX_INTERVAL between full batches
+    TEST_ASSERT_EQUAL(8, sender.sent.size());
+    TEST_ASSERT_EQUAL_STRING("log:update_failed:1.1.0", sender.sent[2].c_str());
+    TEST_ASSERT_EQUAL_STRING("log:update_failed:1.6.0", sender.sent[7].c_str());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_events_survive_restart);
+    RUN_TEST(test_damaged_or_foreign_blob_is_discarded);
+    RUN_TEST(test_duplicates_are_merged);
+    RUN_TEST(test_failed_log_holds_back_the_later_ones);
+    RUN_TEST(test_rejected_event_is_dropped);
+    RUN_TEST(test_slack_lines_batched_in_one_message);
+    RUN_TEST(test_batch_limit_spreads_delivery);
+    RUN_TEST(test_full_outbox_drops_the_oldest);
+    RUN_TEST(test_save_failure_is_reported);
+    RUN_TEST(test_job_drains_several_batches);
+    return UNITY_END();
+}
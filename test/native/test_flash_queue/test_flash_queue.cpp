@@ -0,0 +1,208 @@
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "file_flash.h"
+#include "flash_queue.h"
+
+#define SECTOR 4096
+#define SECTORS 8
+
+static const char* PATH = "/tmp/test_flash_queue.bin";
+
+static std::string record(int i) {
+    // Variable length so records do not line up with sector boundaries.
+    return "rec-" + std::to_string(i) + std::string((size_t)(i * 7) % 300, (char)('a' + i % 26));
+}
+
+static int pushRange(FlashQueue& q, int from, int to) {
+    for (int i = from; i < to; i++) {
+        std::string r = record(i);
+        int rc = q.push(r.data(), r.size());
+        if (rc != FQ_OK) return rc;
+    }
+    return FQ_OK;
+}
+
+// Reads every pending record without consuming it.
+static std::vector<std::string> pending(FlashQueue& q) {
+    std::vector<std::string> out;
+    FlashQueueCursor c = q.head();
+    char buf[1024];
+    int n;
+    while ((n = q.read(c, buf, sizeof(buf))) > 0) out.push_back(std::string(buf, (size_t)n));
+    return out;
+}
+
+void setUp(void) { remove(PATH); }
+void tearDown(void) { remove(PATH); }
+
+void test_fifo_push_read_pop() {
+    FileFlash flash(PATH, SECTOR, SECTORS);
+    TEST_ASSERT_TRUE(flash.open());
+    FlashQueue q(flash);
+    TEST_ASSERT_EQUAL(FQ_OK, q.mount());
+    TEST_ASSERT_TRUE(q.empty());
+    TEST_ASSERT_EQUAL(FQ_OK, pushRange(q, 0, 40));
+    TEST_ASSERT_EQUAL(40, q.size());
+
+    std::vector<std::string> all = pending(q);
+    TEST_ASSERT_EQUAL(40, all.size());
+    for (int i = 0; i < 40; i++) TEST_ASSERT_EQUAL_STRING(record(i).c_str(), all[i].c_str());
+
+    TEST_ASSERT_EQUAL(FQ_OK, q.pop(15));
+    TEST_ASSERT_EQUAL(25, q.size());
+    all = pending(q);
+    TEST_ASSERT_EQUAL_STRING(record(15).c_str(), all[0].c_str());
+    TEST_ASSERT_EQUAL(FQ_OK, q.pop(100));
+    TEST_ASSERT_TRUE(q.empty());
+    TEST_ASSERT_EQUAL(0, pending(q).size());
+    TEST_ASSERT_FALSE(flash.bitViolation());
+}
+
+void test_survives_restart() {
+    {
+        FileFlash flash(PATH, SECTOR, SECTORS);
+        TEST_ASSERT_TRUE(flash.open());
+        FlashQueue q(flash);
+        TEST_ASSERT_EQUAL(FQ_OK, q.mount());
+        TEST_ASSERT_EQUAL(FQ_OK, pushRange(q, 0, 50));
+        TEST_ASSERT_EQUAL(FQ_OK, q.pop(20));
+    }
+    FileFlash flash(PATH, SECTOR, SECTORS);
+    TEST_ASSERT_TRUE(flash.open());
+    FlashQueue q(flash);
+    TEST_ASSERT_EQUAL(FQ_OK, q.mount());
+    TEST_ASSERT_EQUAL(30, q.size());
+    std::vector<std::string> all = pending(q);
+    for (int i = 0; i < 30; i++) TEST_ASSERT_EQUAL_STRING(record(20 + i).c_str(), all[i].c_str());
+
+    // Appending after the restart continues in the same sector.
+    TEST_ASSERT_EQUAL(FQ_OK, pushRange(q, 50, 55));
+    all = pending(q);
+    TEST_ASSERT_EQUAL(35, all.size());
+    TEST_ASSERT_EQUAL_STRING(record(54).c_str(), all.back().c_str());
+    TEST_ASSERT_EQUAL(0, q.stats().corrupt);
+}
+
+void test_oldest_records_dropped_when_full() {
+    FileFlash flash(PATH, SECTOR, SECTORS);
+    TEST_ASSERT_TRUE(flash.open());
+    FlashQueue q(flash);
+    TEST_ASSERT_EQUAL(FQ_OK, q.mount());
+    TEST_ASSERT_EQUAL(FQ_OK, pushRange(q, 0, 1000));
+    TEST_ASSERT_TRUE(q.stats().dropped > 0);
+    TEST_ASSERT_EQUAL(1000, q.size() + q.stats().dropped);
+    // What is left is the newest contiguous run, in order.
+    std::vector<std::string> all = pending(q);
+    TEST_ASSERT_EQUAL(q.size(), all.size());
+    int first = 1000 - (int)all.size();
+    for (size_t i = 0; i < all.size(); i++) TEST_ASSERT_EQUAL_STRING(record(first + (int)i).c_str(), all[i].c_str());
+    // Capacity stays close to the ring size: at most one sector is lost to wrapping.
+    size_t bytes = 0;
+    for (size_t i = 0; i < all.size(); i++) bytes += all[i].size() + FQ_RECORD_HEADER;
+    TEST_ASSERT_TRUE(bytes > (SECTORS - 2) * SECTOR);
+}
+
+void test_torn_write_is_recovered() {
+    {
+        FileFlash flash(PATH, SECTOR, SECTORS);
+        TEST_ASSERT_TRUE(flash.open());
+        FlashQueue q(flash);
+        TEST_ASSERT_EQUAL(FQ_OK, q.mount());
+        TEST_ASSERT_EQUAL(FQ_OK, pushRange(q, 0, 10));
+        flash.failAfter(FQ_RECORD_HEADER + 3); // power fails inside the next record
+        TEST_ASSERT_EQUAL(FQ_ERR_IO, pushRange(q, 10, 11));
+    }
+    FileFlash flash(PATH, SECTOR, SECTORS);
+    TEST_ASSERT_TRUE(flash.open());
+    FlashQueue q(flash);
+    TEST_ASSERT_EQUAL(FQ_OK, q.mount());
+    TEST_ASSERT_EQUAL(10, q.size());
+    TEST_ASSERT_EQUAL(1, q.stats().corrupt);
+
+    // New records go after the torn one and survive another restart.
+    TEST_ASSERT_EQUAL(FQ_OK, pushRange(q, 11, 20));
+    FlashQueue again(flash);
+    TEST_ASSERT_EQUAL(FQ_OK, again.mount());
+    std::vector<std::string> all = pending(again);
+    TEST_ASSERT_EQUAL(19, all.size());
+    TEST_ASSERT_EQUAL_STRING(record(9).c_str(), all[9].c_str());
+    TEST_ASSERT_EQUAL_STRING(record(11).c_str(), all[10].c_str());
+    TEST_ASSERT_FALSE(flash.bitViolation());
+}
+
+void test_damaged_record_ends_its_sector() {
+    FileFlash flash(PATH, SECTOR, SECTORS);
+    TEST_ASSERT_TRUE(flash.open());
+    {
+        FlashQueue q(flash);
+        TEST_ASSERT_EQUAL(FQ_OK, q.mount());
+        TEST_ASSERT_EQUAL(FQ_OK, pushRange(q, 0, 60));
+    }
+    // Clear a bit inside the first record's payload (sector 0).
+    uint8_t b;
+    TEST_ASSERT_TRUE(flash.read(FQ_SECTOR_HEADER + FQ_RECORD_HEADER + 1, &b, 1));
+    b &= 0xFE;
+    TEST_ASSERT_TRUE(flash.write(FQ_SECTOR_HEADER + FQ_RECORD_HEADER + 1, &b, 1));
+
+    FlashQueue q(flash);
+    TEST_ASSERT_EQUAL(FQ_OK, q.mount());
+    TEST_ASSERT_EQUAL(1, q.stats().corrupt);
+    std::vector<std::string> all = pending(q);
+    TEST_ASSERT_TRUE(all.size() > 0 && all.size() < 60);
+    TEST_ASSERT_EQUAL_STRING(record(59).c_str(), all.back().c_str());
+}
+
+void test_erases_are_spread_over_the_ring() {
+    FileFlash flash(PATH, SECTOR, SECTORS);
+    TEST_ASSERT_TRUE(flash.open());
+    FlashQueue q(flash);
+    TEST_ASSERT_EQUAL(FQ_OK, q.mount());
+    // Producer slightly faster than the consumer, for a long time.
+    for (int round = 0; round < 400; round++) {
+        TEST_ASSERT_EQUAL(FQ_OK, pushRange(q, round * 10, round * 10 + 10));
+        TEST_ASSERT_EQUAL(FQ_OK, q.pop(9));
+    }
+    uint32_t lo = flash.erases(0), hi = flash.erases(0), total = 0;
+    for (uint32_t s = 0; s < SECTORS; s++) {
+        if (flash.erases(s) < lo) lo = flash.erases(s);
+        if (flash.erases(s) > hi) hi = flash.erases(s);
+        total += flash.erases(s);
+    }
+    TEST_ASSERT_TRUE(lo > 0);
+    TEST_ASSERT_TRUE(hi - lo <= 1);
+    TEST_ASSERT_EQUAL(total, q.stats().erases);
+    TEST_ASSERT_FALSE(flash.bitViolation());
+}
+
+void test_rejects_bad_sizes() {
+    FileFlash flash(PATH, SECTOR, SECTORS);
+    TEST_ASSERT_TRUE(flash.open());
+    FlashQueue q(flash);
+    TEST_ASSERT_EQUAL(FQ_OK, q.mount());
+    std::vector<uint8_t> big(q.maxRecord() + 1, 1);
+    TEST_ASSERT_EQUAL(FQ_ERR_SIZE, q.push(big.data(), big.size()));
+    TEST_ASSERT_EQUAL(FQ_ERR_SIZE, q.push("", 0));
+    big.pop_back();
+    TEST_ASSERT_EQUAL(FQ_OK, q.push(big.data(), big.size()));
+
+    FileFlash tiny("/tmp/test_flash_queue_tiny.bin", SECTOR, 1);
+    TEST_ASSERT_TRUE(tiny.open());
+    FlashQueue t(tiny);
+    TEST_ASSERT_EQUAL(FQ_ERR_GEOMETRY, t.mount());
+    remove("/tmp/test_flash_queue_tiny.bin");
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo_push_read_pop);
+    RUN_TEST(test_survives_restart);
+    RUN_TEST(test_oldest_records_dropped_when_full);
+    RUN_TEST(test_torn_write_is_recovered);
+    RUN_TEST(test_damaged_record_ends_its_sector);
+    RUN_TEST(test_erases_are_spread_over_the_ring);
+    RUN_TEST(test_rejects_bad_sizes);
+    return UNITY_END();
+}
@@ -0,0 +1,135 @@
+#include <unity.h>
+#include <stdio.h>
+#include "api_standin.h"
+#include "fleet_sim.h"
+
+// Short runs of the fleet simulator against the API stand-in. Time scale
+// 100 turns the 60 s heartbeat into 600 ms and the 5 s backoff into 50 ms,
+// so a few seconds cover several firmware cycles.
+
+#define DEVICES 40
+#define IMAGE_BYTES 16384
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static FleetConfig smallFleet(const ApiStandin& server, uint32_t durationMs) {
+    FleetConfig config = defaultFleetConfig(DEVICES, server.baseUrl());
+    config.workers = 2;
+    config.durationMs = durationMs;
+    config.bootSpreadMs = 200;
+    config.timeScale = 100;
+    return config;
+}
+
+static void printReport(const char* name, const FleetReport& r) {
+    printf("[FLEET] %s: %u requests in %u ms, peak %u/s, %u connects, %u held back\n", name, (unsigned)r.httpRequests,
+           (unsigned)r.elapsedMs, (unsigned)r.peakPerSec, (unsigned)r.connects, (unsigned)r.rejected);
+    for (int k = 0; k < FLEET_REQUEST_KINDS; k++) {
+        const FleetLatency& l = r.requests[k];
+        printf("[FLEET]   %-13s %4u (%u failed) p50 %u us p99 %u us\n", fleetRequestName((FleetRequestKind)k),
+               (unsigned)l.count, (unsigned)l.failures, (unsigned)l.p50Us, (unsigned)l.p99Us);
+    }
+}
+
+void test_devices_follow_the_firmware_cadence() {
+    ApiStandin server("1.0.0", IMAGE_BYTES);
+    TEST_ASSERT_TRUE(server.start());
+    FleetSimulator sim(smallFleet(server, 3500));
+    FleetReport r = sim.run();
+    server.stop();
+    printReport("steady", r);
+
+    const FleetLatency& beats = r.requests[FLEET_HEARTBEAT];
+    // First heartbeat one interval after boot, then every 600 ms plus jitter
+    TEST_ASSERT_GREATER_OR_EQUAL(DEVICES * 2, beats.count);
+    TEST_ASSERT_EQUAL(0, beats.failures);
+    TEST_ASSERT_EQUAL(beats.count, server.requests(API_ROUTE_HEARTBEAT));
+    TEST_ASSERT_TRUE(beats.p50Us <= beats.p99Us && beats.p99Us <= beats.maxUs);
+    // 30 samples at 50 ms fill a batch every 1.5 s
+    TEST_ASSERT_GREATER_OR_EQUAL(DEVICES, r.requests[FLEET_SENSOR_BATCH].count);
+    TEST_ASSERT_EQUAL(r.requests[FLEET_SENSOR_BATCH].count, server.requests(API_ROUTE_SENSOR_BATCH));
+    // The 30 s idle timeout is shorter than the 60 s heartbeat, so most
+    // heartbeats open a new connection, as on the device
+    TEST_ASSERT_TRUE(r.connects > 0 && r.connects <= r.httpRequests);
+    TEST_ASSERT_GREATER_THAN(0, r.peakPerSec);
+    // Summaries go out five to a frame, the first after 3 s
+    TEST_ASSERT_GREATER_THAN(0, r.mqttMessages);
+    TEST_ASSERT_EQUAL(0, r.updated);
+}
+
+void test_rollout_waves_update_their_share() {
+    ApiStandin server("1.0.0", IMAGE_BYTES);
+    TEST_ASSERT_TRUE(server.start());
+    FleetConfig config = smallFleet(server, 2500);
+    server.release("1.1.0");
+    config.offerVersion = "1.1.0";
+    FleetWave first = {500, 25, 0};
+    FleetWave rest = {1200, 100, 20}; // spread over 20 s / 100
+    config.waves.push_back(first);
+    config.waves.push_back(rest);
+    FleetSimulator sim(config);
+    FleetReport r = sim.run();
+    server.stop();
+    printReport("rollout", r);
+
+    TEST_ASSERT_EQUAL(DEVICES, r.commands);
+    // Each command only started a version check; the offer came from the server
+    TEST_ASSERT_GREATER_OR_EQUAL(DEVICES, server.requests(API_ROUTE_VERSION));
+    TEST_ASSERT_EQUAL(DEVICES, r.updated);
+    TEST_ASSERT_EQUAL(DEVICES, r.requests[FLEET_OTA_DOWNLOAD].count);
+    TEST_ASSERT_EQUAL(0, r.requests[FLEET_OTA_DOWNLOAD].failures);
+    TEST_ASSERT_EQUAL(DEVICES, server.updatesLogged());
+    TEST_ASSERT_EQUAL(DEVICES, server.requests(API_ROUTE_FIRMWARE));
+}
+
+void test_wifi_outage_holds_jobs_until_reconnect() {
+    ApiStandin server("1.0.0", IMAGE_BYTES);
+    TEST_ASSERT_TRUE(server.start());
+    FleetConfig config = smallFleet(server, 2500);
+    FleetOutage outage = {700, 1000, 100};
+    config.outages.push_back(outage);
+    FleetSimulator sim(config);
+    FleetReport r = sim.run();
+    server.stop();
+    printReport("wifi outage", r);
+
+    TEST_ASSERT_EQUAL(DEVICES, r.outages);
+    // Radio jobs wait for the link instead of failing against it
+    TEST_ASSERT_EQUAL(0, r.requests[FLEET_HEARTBEAT].failures);
+    TEST_ASSERT_EQUAL(0, r.requests[FLEET_SENSOR_BATCH].failures);
+    // Everything held back goes out once the devices are back
+    TEST_ASSERT_GREATER_OR_EQUAL(DEVICES, r.requests[FLEET_HEARTBEAT].count);
+    TEST_ASSERT_GREATER_OR_EQUAL(DEVICES, r.requests[FLEET_SENSOR_BATCH].count);
+}
+
+void test_server_outage_is_retried_with_backoff() {
+    ApiStandin server("1.0.0", IMAGE_BYTES);
+    TEST_ASSERT_TRUE(server.start());
+    server.setDown(true);
+    FleetSimulator sim(smallFleet(server, 2000));
+    FleetReport r = sim.run();
+    server.stop();
+    printReport("server down", r);
+
+    TEST_ASSERT_GREATER_THAN(0, r.requests[FLEET_HEARTBEAT].failures);
+    TEST_ASSERT_EQUAL(r.requests[FLEET_HEARTBEAT].count, r.requests[FLEET_HEARTBEAT].failures);
+    // Backoff doubles from 50 ms: retries over about 1.5 s stay at a few per
+    // device, not one per scheduler wake. New samples must not bypass the
+    // batch upload's backoff.
+    TEST_ASSERT_LESS_THAN(DEVICES * 6, r.requests[FLEET_HEARTBEAT].count);
+    TEST_ASSERT_LESS_THAN(DEVICES * 6, r.requests[FLEET_SENSOR_BATCH].count);
+    TEST_ASSERT_EQUAL(r.httpRequests, server.rejected());
+    // After three failures the circuits open; jobs wait out the cool-down
+    // and only single probes reach the server
+    TEST_ASSERT_GREATER_THAN(0, r.rejected);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_devices_follow_the_firmware_cadence);
+    RUN_TEST(test_rollout_waves_update_their_share);
+    RUN_TEST(test_wifi_outage_holds_jobs_until_reconnect);
+    RUN_TEST(test_server_outage_is_retried_with_backoff);
+    return UNITY_END();
+}
@@ -0,0 +1,204 @@
+#include <unity.h>
+#include <string.h>
+#include "health_gate.h"
+#include "api_payloads.h"
+#include "net_scheduler.h"
+
+static uint32_t fakeNow = 0;
+static uint32_t fakeMillis() { return fakeNow; }
+
+struct FakeProbes : public HealthProbes {
+    bool wifiConnected() { return wifi; }
+    bool mqttRoundTrip() { return mqtt; }
+    bool httpRoundTrip() { return http; }
+    uint32_t minFreeHeap() { return heap; }
+    bool watchdogTripped() { return watchdog; }
+
+    bool wifi = false;
+    bool mqtt = false;
+    bool http = false;
+    uint32_t heap = 120000;
+    bool watchdog = false;
+};
+
+//                                    required           heap floor  soak   timeout
+static const HealthGateConfig config = {HEALTH_ALL_CHECKS, 40000,     10000, 120000};
+
+void setUp(void) { fakeNow = 5000; }
+void tearDown(void) {}
+
+void test_check_names() {
+    char out[64];
+    TEST_ASSERT_EQUAL_STRING("mqtt", healthCheckName(HEALTH_MQTT));
+    TEST_ASSERT_EQUAL(9, healthCheckList(HEALTH_MQTT | HEALTH_HTTP, out, sizeof(out)));
+    TEST_ASSERT_EQUAL_STRING("mqtt,http", out);
+    TEST_ASSERT_EQUAL(0, healthCheckList(0, out, sizeof(out)));
+    TEST_ASSERT_EQUAL_STRING("", out);
+    TEST_ASSERT_EQUAL(4, healthCheckList(HEALTH_WIFI | HEALTH_WATCHDOG, out, 8));
+    TEST_ASSERT_EQUAL_STRING("wifi", out);
+}
+
+void test_passes_once_every_check_has_passed_and_the_soak_is_over() {
+    FakeProbes probes;
+    HealthGate gate(probes, config, fakeMillis);
+    TEST_ASSERT_FALSE(gate.active());
+    gate.begin();
+    TEST_ASSERT_EQUAL(HEALTH_PENDING, gate.poll());
+
+    fakeNow += 1500;
+    probes.wifi = true;
+    TEST_ASSERT_EQUAL(HEALTH_PENDING, gate.poll());
+    fakeNow += 2000;
+    probes.mqtt = true;
+    probes.http = true;
+    TEST_ASSERT_EQUAL(HEALTH_PENDING, gate.poll()); // heap and watchdog still soaking
+    fakeNow += 6500;
+    TEST_ASSERT_EQUAL(HEALTH_PASSED, gate.poll());
+    TEST_ASSERT_FALSE(gate.active());
+
+    const HealthReport& r = gate.report();
+    TEST_ASSERT_EQUAL_UINT32(10000, r.elapsedMs);
+    TEST_ASSERT_EQUAL_UINT32(1500, r.passedAtMs[0]);
+    TEST_ASSERT_EQUAL_UINT32(3500, r.passedAtMs[1]);
+    TEST_ASSERT_EQUAL_UINT32(3500, r.passedAtMs[2]);
+    TEST_ASSERT_EQUAL(0, r.failed);
+
+    // The verdict is final
+    probes.watchdog = true;
+    TEST_ASSERT_EQUAL(HEALTH_PASSED, gate.poll());
+}
+
+void test_heap_below_floor_fails_at_once() {
+    FakeProbes probes;
+    HealthGate gate(probes, config, fakeMillis);
+    gate.begin();
+    probes.wifi = true;
+    TEST_ASSERT_EQUAL(HEALTH_PENDING, gate.poll());
+    fakeNow += 2000;
+    probes.heap = 32000;
+    TEST_ASSERT_EQUAL(HEALTH_FAILED, gate.poll());
+    TEST_ASSERT_EQUAL(HEALTH_HEAP, gate.report().failed);
+    TEST_ASSERT_EQUAL_UINT32(2000, gate.report().elapsedMs);
+    TEST_ASSERT_EQUAL_UINT32(32000, gate.report().minFreeHeap);
+}
+
+void test_watchdog_fails_at_once() {
+    FakeProbes probes;
+    probes.wifi = probes.mqtt = probes.http = true;
+    HealthGate gate(probes, config, fakeMillis);
+    gate.begin();
+    fakeNow += 4000;
+    probes.watchdog = true;
+    TEST_ASSERT_EQUAL(HEALTH_FAILED, gate.poll());
+    TEST_ASSERT_EQUAL(HEALTH_WATCHDOG, gate.report().failed);
+}
+
+void test_missing_round_trips_fail_at_the_timeout() {
+    FakeProbes probes;
+    HealthGate gate(probes, config, fakeMillis);
+    gate.begin();
+    probes.wifi = true;
+    probes.http = true;
+    fakeNow += 119999;
+    TEST_ASSERT_EQUAL(HEALTH_PENDING, gate.poll());
+    fakeNow += 1;
+    TEST_ASSERT_EQUAL(HEALTH_FAILED, gate.poll());
+    TEST_ASSERT_EQUAL(HEALTH_MQTT, gate.report().failed);
+    TEST_ASSERT_EQUAL(HEALTH_WIFI | HEALTH_HTTP | HEALTH_HEAP | HEALTH_WATCHDOG, gate.report().passed);
+}
+
+void test_only_required_checks_count() {
+    FakeProbes probes;
+    HealthGateConfig lenient = config;
+    lenient.required = HEALTH_WIFI | HEALTH_HEAP;
+    HealthGate gate(probes, lenient, fakeMillis);
+    gate.begin();
+    probes.wifi = true;
+    probes.watchdog = true; // not required
+    fakeNow += 10000;
+    TEST_ASSERT_EQUAL(HEALTH_PASSED, gate.poll());
+    TEST_ASSERT_EQUAL(0, gate.report().failed);
+}
+
+// The firmware's health job: poll, and re-arm itself while the verdict is pending
+struct HealthJob {
+    NetScheduler* sched;
+    HealthGate* gate;
+    int id;
+    int polls;
+    HealthVerdict verdict;
+};
+
+static JobResult healthJob(void* ctx) {
+    HealthJob* job = static_cast<HealthJob*>(ctx);
+    if (!job->gate->active()) return JOB_DONE;
+    job->polls++;
+    job->verdict = job->gate->poll();
+    if (job->verdict == HEALTH_PENDING) job->sched->triggerIn(job->id, 2000);
+    return JOB_DONE;
+}
+
+static void runScheduler(NetScheduler& sched, uint32_t end) {
+    while ((int32_t)(end - fakeNow) > 0) {
+        uint32_t sleep = sched.runDue();
+        fakeNow += sleep < end - fakeNow ? sleep : end - fakeNow;
+    }
+}
+
+void test_scheduled_polls_reach_a_verdict() {
+    FakeProbes probes;
+    HealthGate gate(probes, config, fakeMillis);
+    NetScheduler sched(fakeMillis, NULL, 0);
+    HealthJob job = {&sched, &gate, -1, 0, HEALTH_PENDING};
+    //             name      fn         ctx   period delay slack prio radio retry
+    JobSpec spec = {"health", healthJob, &job, 0,     0,    0,    9,   false, 0, 0};
+    job.id = sched.add(spec, 0);
+    gate.begin();
+    sched.trigger(job.id);
+    runScheduler(sched, fakeNow + 5000);
+    probes.wifi = probes.mqtt = probes.http = true;
+    runScheduler(sched, fakeNow + 60000);
+    TEST_ASSERT_EQUAL(HEALTH_PASSED, job.verdict);
+    TEST_ASSERT_FALSE(gate.active());
+    TEST_ASSERT_EQUAL(6, job.polls); // every 2 s until the 10 s soak is over
+    TEST_ASSERT_EQUAL_UINT32(10000, gate.report().elapsedMs);
+
+    // A round trip that never passes fails the image at the timeout
+    probes.http = false;
+    gate.begin();
+    sched.trigger(job.id);
+    runScheduler(sched, fakeNow + 200000);
+    TEST_ASSERT_EQUAL(HEALTH_FAILED, job.verdict);
+    TEST_ASSERT_EQUAL_UINT32(120000, gate.report().elapsedMs);
+}
+
+void test_report_goes_into_the_ota_log() {
+    FakeProbes probes;
+    HealthGate gate(probes, config, fakeMillis);
+    gate.begin();
+    fakeNow += 800;
+    probes.wifi = true;
+    gate.poll();
+    fakeNow += 119200;
+    gate.poll();
+
+    OtaLogInfo info = {"esp32-01", "health_failed", "1.3.0", "mqtt,http", 120000, NULL, &gate.report(), NULL, 1};
+    char out[512];
+    TEST_ASSERT_TRUE(buildOtaLog(info, out, sizeof(out)) > 0);
+    TEST_ASSERT_NOT_NULL(strstr(out,
+        "\"health\":{\"healthy\":false,\"elapsed_ms\":120000,\"failed\":\"mqtt,http\","
+        "\"wifi_ms\":800,\"mqtt_ms\":null,\"http_ms\":null,\"min_free_heap\":120000}}"));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_check_names);
+    RUN_TEST(test_passes_once_every_check_has_passed_and_the_soak_is_over);
+    RUN_TEST(test_heap_below_floor_fails_at_once);
+    RUN_TEST(test_watchdog_fails_at_once);
+    RUN_TEST(test_missing_round_trips_fail_at_the_timeout);
+    RUN_TEST(test_only_required_checks_count);
+    RUN_TEST(test_scheduled_polls_reach_a_verdict);
+    RUN_TEST(test_report_goes_into_the_ota_log);
+    return UNITY_END();
+}
@@ -0,0 +1,287 @@
+#include <unity.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include "http_session_pool.h"
+#include "http_standin.h"
+#include "posix_transport.h"
+
+static uint32_t fakeNow = 0;
+static uint32_t fakeMillis() { return fakeNow; }
+
+static PosixTransportFactory factory;
+
+static void okHandler(const StandinRequest& req, StandinResponse& resp) {
+    resp.body = "{\"ok\":true,\"path\":\"" + req.path + "\"}";
+}
+
+static bool appendSink(const uint8_t* data, size_t len, void* ctx) {
+    static_cast<std::string*>(ctx)->append((const char*)data, len);
+    return true;
+}
+
+static HttpPoolConfig testConfig() {
+    HttpPoolConfig cfg = defaultHttpPoolConfig(fakeMillis);
+    cfg.ioTimeoutMs = 2000;
+    cfg.connectTimeoutMs = 2000;
+    return cfg;
+}
+
+void setUp(void) { fakeNow = 1000; }
+void tearDown(void) {}
+
+void test_parse_url() {
+    ParsedUrl u;
+    TEST_ASSERT_TRUE(parseUrl("https://ota.example.com/api/log", u));
+    TEST_ASSERT_TRUE(u.secure);
+    TEST_ASSERT_EQUAL(443, u.port);
+    TEST_ASSERT_EQUAL_STRING("ota.example.com", u.host);
+    TEST_ASSERT_EQUAL_STRING("/api/log", u.path);
+    TEST_ASSERT_TRUE(parseUrl("http://10.0.0.2:3000", u));
+    TEST_ASSERT_EQUAL(3000, u.port);
+    TEST_ASSERT_EQUAL_STRING("/", u.path);
+    TEST_ASSERT_FALSE(parseUrl("ftp://host/file", u));
+    TEST_ASSERT_FALSE(parseUrl("http://host:99999/", u));
+}
+
+void test_keep_alive_reuses_one_connection() {
+    HttpStandin server(okHandler);
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, testConfig());
+    std::string url = server.url("/api/sensor");
+    const char* body = "{\"temp\":25.00}";
+
+    for (int i = 0; i < 20; i++) {
+        std::string out;
+        int code = pool.request("POST", url.c_str(), "Content-Type: application/json\r\n",
+                                (const uint8_t*)body, strlen(body), NULL, appendSink, &out);
+        TEST_ASSERT_EQUAL(200, code);
+        TEST_ASSERT_EQUAL_STRING("{\"ok\":true,\"path\":\"/api/sensor\"}", out.c_str());
+        fakeNow += 100;
+    }
+    TEST_ASSERT_EQUAL(1, server.acceptedConnections());
+    TEST_ASSERT_EQUAL(20, server.requestsServed());
+    TEST_ASSERT_EQUAL(1, pool.stats().connectsOpened);
+    TEST_ASSERT_EQUAL(19, pool.stats().reused);
+}
+
+void test_connection_close_is_honoured() {
+    HttpStandin server([](const StandinRequest&, StandinResponse& resp) {
+        resp.body = "bye";
+        resp.close = true;
+    });
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, testConfig());
+    std::string url = server.url("/api/heartbeat");
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_EQUAL(200, pool.request("GET", url.c_str(), NULL, NULL, 0));
+    }
+    TEST_ASSERT_EQUAL(5, server.acceptedConnections());
+    TEST_ASSERT_EQUAL(0, pool.openSessions());
+}
+
+void test_idle_eviction() {
+    HttpStandin server(okHandler);
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, testConfig());
+    std::string url = server.url("/api/log");
+    TEST_ASSERT_EQUAL(200, pool.request("GET", url.c_str(), NULL, NULL, 0));
+    TEST_ASSERT_EQUAL(1, pool.openSessions());
+
+    fakeNow += 29000;
+    pool.evictIdle();
+    TEST_ASSERT_EQUAL(1, pool.openSessions());
+    fakeNow += 2000;
+    pool.evictIdle();
+    TEST_ASSERT_EQUAL(0, pool.openSessions());
+    TEST_ASSERT_EQUAL(1, pool.stats().evicted);
+
+    TEST_ASSERT_EQUAL(200, pool.request("GET", url.c_str(), NULL, NULL, 0));
+    TEST_ASSERT_EQUAL(2, server.acceptedConnections());
+}
+
+void test_keep_alive_timeout_header_shortens_idle() {
+    HttpStandin server([](const StandinRequest&, StandinResponse& resp) {
+        resp.body = "x";
+        resp.extraHeaders = "Keep-Alive: timeout=5\r\n";
+    });
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, testConfig());
+    std::string url = server.url("/");
+    TEST_ASSERT_EQUAL(200, pool.request("GET", url.c_str(), NULL, NULL, 0));
+    fakeNow += 4500;
+    TEST_ASSERT_EQUAL(200, pool.request("GET", url.c_str(), NULL, NULL, 0));
+    TEST_ASSERT_EQUAL(2, server.acceptedConnections());
+}
+
+void test_transparent_reconnect_after_server_drop() {
+    HttpStandin server(okHandler);
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, testConfig());
+    std::string url = server.url("/api/sensor");
+    TEST_ASSERT_EQUAL(200, pool.request("GET", url.c_str(), NULL, NULL, 0));
+
+    server.dropConnections();
+    usleep(100 * 1000);
+    std::string out;
+    TEST_ASSERT_EQUAL(200, pool.request("GET", url.c_str(), NULL, NULL, 0, NULL, appendSink, &out));
+    TEST_ASSERT_TRUE(out.find("/api/sensor") != std::string::npos);
+    TEST_ASSERT_EQUAL(2, server.acceptedConnections());
+    TEST_ASSERT_EQUAL(1, pool.stats().reconnects);
+}
+
+void test_post_is_not_resent_after_the_server_read_it() {
+    int posts = 0, gets = 0;
+    bool hangUp = false;
+    HttpStandin server([&](const StandinRequest& req, StandinResponse& resp) {
+        if (req.method == "POST") posts++;
+        if (req.method == "GET") gets++;
+        resp.body = "ok";
+        resp.noReply = hangUp;
+        hangUp = false;
+    });
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, testConfig());
+    std::string url = server.url("/api/log");
+    TEST_ASSERT_EQUAL(200, pool.request("GET", url.c_str(), NULL, NULL, 0));
+
+    // The server reads the POST on the kept-alive connection and hangs up
+    hangUp = true;
+    const uint8_t body[] = "{\"status\":\"ok\"}";
+    TEST_ASSERT_EQUAL(HTTP_POOL_ERR_READ, pool.request("POST", url.c_str(), NULL, body, sizeof(body) - 1));
+    TEST_ASSERT_EQUAL(1, posts);
+    TEST_ASSERT_EQUAL(0, pool.stats().reconnects);
+
+    // A GET in the same spot is repeated on a fresh connection
+    TEST_ASSERT_EQUAL(200, pool.request("GET", url.c_str(), NULL, NULL, 0));
+    hangUp = true;
+    TEST_ASSERT_EQUAL(200, pool.request("GET", url.c_str(), NULL, NULL, 0));
+    TEST_ASSERT_EQUAL(4, gets);
+    TEST_ASSERT_EQUAL(1, pool.stats().reconnects);
+}
+
+void test_chunked_body_and_redirect() {
+    HttpStandin server([](const StandinRequest& req, StandinResponse& resp) {
+        if (req.path == "/old") {
+            resp.status = 302;
+            resp.extraHeaders = "Location: /api/firmware/version\r\n";
+            return;
+        }
+        resp.chunked = true;
+        resp.body = "{\"version\":\"1.2.3\",\"url\":\"http://x/fw.bin\"}";
+    });
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, testConfig());
+    std::string url = server.url("/old");
+    std::string out;
+    HttpResponse resp;
+    TEST_ASSERT_EQUAL(200, pool.request("GET", url.c_str(), NULL, NULL, 0, &resp, appendSink, &out));
+    TEST_ASSERT_TRUE(resp.chunked);
+    TEST_ASSERT_EQUAL_STRING("{\"version\":\"1.2.3\",\"url\":\"http://x/fw.bin\"}", out.c_str());
+    TEST_ASSERT_EQUAL(1, server.acceptedConnections());
+}
+
+void test_cross_origin_redirect_drops_credentials() {
+    std::map<std::string, std::string> seen;
+    HttpStandin b([&seen](const StandinRequest& req, StandinResponse& resp) {
+        seen = req.headers;
+        resp.body = "ok";
+    });
+    TEST_ASSERT_TRUE(b.start());
+    std::string target = b.url("/fw.bin");
+    HttpStandin a([&target](const StandinRequest& req, StandinResponse& resp) {
+        if (req.path == "/same") {
+            resp.status = 302;
+            resp.extraHeaders = "Location: /other\r\n";
+            return;
+        }
+        if (req.path == "/other") {
+            if (req.headers.count("authorization")) {
+                resp.status = 302;
+                resp.extraHeaders = "Location: " + target + "\r\n";
+            } else {
+                resp.status = 401;
+            }
+            return;
+        }
+        resp.status = 404;
+    });
+    TEST_ASSERT_TRUE(a.start());
+    HttpSessionPool pool(factory, testConfig());
+    std::string url = a.url("/same");
+    const char* headers = "Authorization: Bearer secret\r\nRange: bytes=10-\r\ncookie: s=1\r\n";
+    std::string out;
+    TEST_ASSERT_EQUAL(200, pool.request("GET", url.c_str(), headers, NULL, 0, NULL, appendSink, &out));
+    TEST_ASSERT_EQUAL_STRING("ok", out.c_str());
+    // The same-origin hop kept the token; the cross-origin one did not
+    TEST_ASSERT_EQUAL(2, a.requestsServed());
+    TEST_ASSERT_EQUAL(0, (int)seen.count("authorization"));
+    TEST_ASSERT_EQUAL(0, (int)seen.count("cookie"));
+    TEST_ASSERT_EQUAL_STRING("bytes=10-", seen["range"].c_str());
+}
+
+void test_protocol_relative_redirect() {
+    std::map<std::string, std::string> seen;
+    HttpStandin b([&seen](const StandinRequest& req, StandinResponse& resp) {
+        seen = req.headers;
+        resp.body = req.path;
+    });
+    TEST_ASSERT_TRUE(b.start());
+    // "//127.0.0.1:<b>/fw.bin": b's host under a's scheme, not a path on a
+    std::string target = b.url("/fw.bin").substr(5);
+    HttpStandin a([&target](const StandinRequest& req, StandinResponse& resp) {
+        resp.status = 302;
+        resp.extraHeaders = "Location: " + target + "\r\n";
+    });
+    TEST_ASSERT_TRUE(a.start());
+    HttpSessionPool pool(factory, testConfig());
+    std::string url = a.url("/old");
+    std::string out;
+    TEST_ASSERT_EQUAL(200, pool.request("GET", url.c_str(), "Authorization: Bearer secret\r\n", NULL, 0, NULL,
+                                        appendSink, &out));
+    TEST_ASSERT_EQUAL_STRING("/fw.bin", out.c_str());
+    TEST_ASSERT_EQUAL(1, a.requestsServed());
+    TEST_ASSERT_EQUAL(1, b.requestsServed());
+    TEST_ASSERT_EQUAL(0, (int)seen.count("authorization"));
+}
+
+void test_one_session_per_origin() {
+    HttpStandin a(okHandler);
+    HttpStandin b(okHandler);
+    TEST_ASSERT_TRUE(a.start());
+    TEST_ASSERT_TRUE(b.start());
+    HttpSessionPool pool(factory, testConfig());
+    std::string ua = a.url("/a");
+    std::string ub = b.url("/b");
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_EQUAL(200, pool.request("GET", ua.c_str(), NULL, NULL, 0));
+        TEST_ASSERT_EQUAL(200, pool.request("GET", ub.c_str(), NULL, NULL, 0));
+    }
+    TEST_ASSERT_EQUAL(2, pool.openSessions());
+    TEST_ASSERT_EQUAL(1, a.acceptedConnections());
+    TEST_ASSERT_EQUAL(1, b.acceptedConnections());
+}
+
+void test_connect_failure() {
+    HttpSessionPool pool(factory, testConfig());
+    TEST_ASSERT_EQUAL(HTTP_POOL_ERR_CONNECT, pool.request("GET", "http://127.0.0.1:1/", NULL, NULL, 0));
+    TEST_ASSERT_EQUAL(HTTP_POOL_ERR_URL, pool.request("GET", "not a url", NULL, NULL, 0));
+    TEST_ASSERT_EQUAL(1, pool.stats().connectsFailed);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_parse_url);
+    RUN_TEST(test_keep_alive_reuses_one_connection);
+    RUN_TEST(test_connection_close_is_honoured);
+    RUN_TEST(test_idle_eviction);
+    RUN_TEST(test_keep_alive_timeout_header_shortens_idle);
+    RUN_TEST(test_transparent_reconnect_after_server_drop);
+    RUN_TEST(test_post_is_not_resent_after_the_server_read_it);
+    RUN_TEST(test_chunked_body_and_redirect);
+    RUN_TEST(test_cross_origin_redirect_drops_credentials);
+    RUN_TEST(test_protocol_relative_redirect);
+    RUN_TEST(test_one_session_per_origin);
+    RUN_TEST(test_connect_failure);
+    return UNITY_END();
+}
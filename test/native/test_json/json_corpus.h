@@ -0,0 +1,46 @@
+#pragma once
+#include <stdbool.h>
+
+// Inputs for the chunk-split and mutation tests: {document, valid}.
+struct CorpusEntry {
+    const char* json;
+    bool valid;
+};
+
+static const CorpusEntry kJsonCorpus[] = {
+    {"{\"version\":\"1.0.2\",\"url\":\"http://ota.local/fw/1.0.2.bin\"}", true},
+    {"{ \"url\" : \"https://x/y.bin\" ,\n\t\"version\":\"2.0.0\" }", true},
+    {"{\"version\":\"1.1.0\",\"url\":\"http://a/b\",\"sha256\":\"9f86d081884c7d659a2feaa0c55ad015a3bf4f1b2b0b822cd15d6c15b0f00a08\",\"size\":1048576}", true},
+    {"{\"notes\":{\"lang\":\"vi\",\"text\":\"C\\u1eadp nh\\u1eadt\"},\"version\":\"3.0.0\"}", true},
+    {"{\"a\":[1,2,[3,{\"b\":null}],true,false],\"c\":-0.5e+3}", true},
+    {"{\"emoji\":\"\\ud83d\\ude00\",\"esc\":\"\\\"\\\\\\/\\b\\f\\n\\r\\t\"}", true},
+    {"{}", true},
+    {"[]", true},
+    {"[{}, [], \"\", 0, -1, 1.5, 1e9]", true},
+    {"42", true},
+    {"\"just a string\"", true},
+    {"  {\"k\":\"v\"}  \r\n", true},
+    {"{\"version\":\"1.0.0\"", false},
+    {"{\"version\" \"1.0.0\"}", false},
+    {"{\"version\":1.0.0}", false},
+    {"{\"a\":01}", false},
+    {"{\"a\":-}", false},
+    {"{\"a\":1.}", false},
+    {"{\"a\":tru}", false},
+    {"{\"a\":\"unterminated}", false},
+    {"{\"a\":\"bad \\x escape\"}", false},
+    {"{\"a\":\"\\u12G4\"}", false},
+    {"{,}", false},
+    {"{\"a\":1,}", false},
+    {"[1,2,]", false},
+    {"[1 2]", false},
+    {"{\"a\":1}}", false},
+    {"{\"a\":1} x", false},
+    {"{\"a\":[}", false},
+    {"]", false},
+    {"", false},
+    {"{\"ctl\":\"a\tb\"}", false},
+    {"{1:2}", false},
+};
+
+static const int kJsonCorpusSize = sizeof(kJsonCorpus) / sizeof(kJsonCorpus[0]);
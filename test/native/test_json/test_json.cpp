@@ -0,0 +1,249 @@
+#include <unity.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include "json_corpus.h"
+#include "json_fields.h"
+#include "json_pull_parser.h"
+#include "json_writer.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Runs doc through a fresh parser in chunks of chunkSize bytes and returns
+// the token stream as text, or "ERROR" if the document is rejected.
+static std::string tokenize(const char* doc, size_t len, size_t chunkSize) {
+    char text[64];
+    JsonPullParser p(text, sizeof(text));
+    std::string out;
+    size_t off = 0;
+    for (;;) {
+        JsonToken t = p.next();
+        if (t == JSON_NEED_MORE) {
+            if (off >= len) {
+                p.finish();
+                continue;
+            }
+            size_t n = len - off < chunkSize ? len - off : chunkSize;
+            p.feed(doc + off, n);
+            off += n;
+            continue;
+        }
+        if (t == JSON_ERROR) return "ERROR";
+        if (t == JSON_DONE) return out;
+        out += (char)('A' + t);
+        if (t == JSON_KEY || t == JSON_STRING || t == JSON_NUMBER) {
+            out += std::string(p.text(), p.textLength());
+            out += '|';
+        }
+    }
+}
+
+void test_writer_object() {
+    char buf[160];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject()
+        .key("device_id").value("esp32-01")
+        .key("latency_ms").value((int32_t)-12)
+        .key("ok").value(true)
+        .key("temp").fixed(2505, 2)
+        .key("ratio").value(0.125, 3)
+        .key("list").beginArray().value((uint32_t)1).value((uint32_t)2).null().endArray()
+        .endObject();
+    TEST_ASSERT_TRUE(w.ok());
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"device_id\":\"esp32-01\",\"latency_ms\":-12,\"ok\":true,\"temp\":25.05,"
+        "\"ratio\":0.125,\"list\":[1,2,null]}",
+        buf);
+    TEST_ASSERT_EQUAL(strlen(buf), w.length());
+}
+
+void test_writer_object_with_serialized_members() {
+    char buf[96];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject("\"device_id\":\"esp32-01\"").key("t0").value((uint32_t)5)
+        .key("inner").beginObject("").key("a").value(true).endObject()
+        .endObject();
+    TEST_ASSERT_TRUE(w.ok());
+    TEST_ASSERT_EQUAL_STRING("{\"device_id\":\"esp32-01\",\"t0\":5,\"inner\":{\"a\":true}}", buf);
+
+    JsonWriter small(buf, 12);
+    small.beginObject("\"device_id\":\"esp32-01\"");
+    TEST_ASSERT_FALSE(small.ok());
+}
+
+void test_writer_escapes() {
+    char buf[96];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject().key("error_message").value("say \"hi\"\\\n\x01").endObject();
+    TEST_ASSERT_TRUE(w.ok());
+    TEST_ASSERT_EQUAL_STRING("{\"error_message\":\"say \\\"hi\\\"\\\\\\n\\u0001\"}", buf);
+}
+
+void test_writer_fixed_point() {
+    char buf[64];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginArray().fixed(-307, 2).fixed(5, 2).fixed(1104, 1).fixed(42, 0).fixed(7, 3).endArray();
+    TEST_ASSERT_EQUAL_STRING("[-3.07,0.05,110.4,42,0.007]", buf);
+}
+
+void test_writer_overflow_is_reported() {
+    char buf[16];
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject().key("device_id").value("a-very-long-identifier").endObject();
+    TEST_ASSERT_FALSE(w.ok());
+    TEST_ASSERT_LESS_THAN(sizeof(buf), strlen(buf));
+}
+
+void test_parser_tokens() {
+    const char* doc = "{\"a\":[1,\"x\",true,null],\"b\":{\"c\":-2.5}}";
+    TEST_ASSERT_EQUAL_STRING("BFa|DH1|Gx|IKEFb|BFc|H-2.5|CC", tokenize(doc, strlen(doc), 1000).c_str());
+}
+
+void test_parser_unicode() {
+    char text[32];
+    JsonPullParser p(text, sizeof(text));
+    const char* doc = "\"C\\u1eadp \\ud83d\\ude00\"";
+    p.feed(doc, strlen(doc));
+    TEST_ASSERT_EQUAL(JSON_STRING, p.next());
+    TEST_ASSERT_EQUAL_STRING("C\xe1\xba\xadp \xf0\x9f\x98\x80", p.text());
+}
+
+void test_parser_truncates_long_text() {
+    char text[8];
+    JsonPullParser p(text, sizeof(text));
+    const char* doc = "[\"0123456789\",12]";
+    p.feed(doc, strlen(doc));
+    TEST_ASSERT_EQUAL(JSON_BEGIN_ARRAY, p.next());
+    TEST_ASSERT_EQUAL(JSON_STRING, p.next());
+    TEST_ASSERT_TRUE(p.truncated());
+    TEST_ASSERT_EQUAL_STRING("0123456", p.text());
+    TEST_ASSERT_EQUAL(JSON_NUMBER, p.next());
+    TEST_ASSERT_FALSE(p.truncated());
+    TEST_ASSERT_EQUAL(12, p.intValue());
+}
+
+void test_fields_ignore_order_whitespace_and_nesting() {
+    char version[16], url[64], sha[72];
+    JsonField fields[] = {
+        {"version", version, sizeof(version), false},
+        {"url", url, sizeof(url), false},
+        {"sha256", sha, sizeof(sha), false},
+    };
+    JsonFieldExtractor ex(fields, 3);
+    const char* doc =
+        "{\n  \"meta\": {\"version\": \"9.9.9\"},\n  \"url\" : \"http://ota/fw.bin\",\n  \"version\":\"1.2.3\"\n}";
+    // Feed in uneven chunks, as HTTP delivers it.
+    size_t len = strlen(doc);
+    for (size_t off = 0; off < len; off += 5) {
+        TEST_ASSERT_TRUE(ex.feed(doc + off, len - off < 5 ? len - off : 5));
+    }
+    TEST_ASSERT_TRUE(ex.finish());
+    TEST_ASSERT_TRUE(fields[0].found);
+    TEST_ASSERT_EQUAL_STRING("1.2.3", version);
+    TEST_ASSERT_TRUE(fields[1].found);
+    TEST_ASSERT_EQUAL_STRING("http://ota/fw.bin", url);
+    TEST_ASSERT_FALSE(fields[2].found);
+}
+
+void test_fields_reject_oversized_and_invalid() {
+    char version[4];
+    JsonField fields[] = {{"version", version, sizeof(version), false}};
+    JsonFieldExtractor ex(fields, 1);
+    const char* doc = "{\"version\":\"10.20.30\"}";
+    TEST_ASSERT_TRUE(ex.feed(doc, strlen(doc)));
+    TEST_ASSERT_TRUE(ex.finish());
+    TEST_ASSERT_FALSE(fields[0].found);
+
+    JsonFieldExtractor bad(fields, 1);
+    const char* broken = "{\"version\":\"1.0\"";
+    bad.feed(broken, strlen(broken));
+    TEST_ASSERT_FALSE(bad.finish());
+    JsonFieldExtractor array(fields, 1);
+    TEST_ASSERT_FALSE(array.feed("[1]", 3));
+}
+
+// Every corpus document must tokenize identically no matter how it is split.
+void test_corpus_chunk_split_invariance() {
+    for (int i = 0; i < kJsonCorpusSize; i++) {
+        const char* doc = kJsonCorpus[i].json;
+        size_t len = strlen(doc);
+        std::string whole = tokenize(doc, len, len ? len : 1);
+        if (kJsonCorpus[i].valid != (whole != "ERROR")) {
+            printf("  corpus[%d] %s\n", i, doc);
+        }
+        TEST_ASSERT_EQUAL(kJsonCorpus[i].valid, whole != "ERROR");
+        for (size_t chunk = 1; chunk < 9; chunk++) {
+            TEST_ASSERT_EQUAL_STRING(whole.c_str(), tokenize(doc, len, chunk).c_str());
+        }
+    }
+}
+
+// Random byte flips, truncations and insertions must never crash or hang,
+// and the result must still not depend on chunking.
+void test_corpus_mutations() {
+    uint32_t seed = 12345;
+    int rejected = 0;
+    for (int round = 0; round < 4000; round++) {
+        const char* base = kJsonCorpus[round % kJsonCorpusSize].json;
+        std::string doc(base);
+        int edits = 1 + (int)((seed >> 8) % 3);
+        for (int e = 0; e < edits && !doc.empty(); e++) {
+            seed = seed * 1103515245u + 12345u;
+            size_t at = (seed >> 4) % doc.size();
+            switch ((seed >> 16) % 3) {
+                case 0: doc[at] = (char)(seed >> 20); break;
+                case 1: doc.resize(at); break;
+                default: doc.insert(at, 1, "{}[]\",:\\u0e-"[(seed >> 24) % 13]); break;
+            }
+        }
+        std::string whole = tokenize(doc.data(), doc.size(), doc.size() ? doc.size() : 1);
+        if (whole == "ERROR") rejected++;
+        TEST_ASSERT_EQUAL_STRING(whole.c_str(), tokenize(doc.data(), doc.size(), 3).c_str());
+    }
+    TEST_ASSERT_GREATER_THAN(0, rejected);
+}
+
+// Whatever the writer produces, the parser reads back unchanged.
+void test_writer_parser_round_trip() {
+    uint32_t seed = 99;
+    for (int round = 0; round < 500; round++) {
+        char original[40];
+        size_t n = 1 + round % 39;
+        for (size_t i = 0; i < n; i++) {
+            seed = seed * 1103515245u + 12345u;
+            original[i] = (char)(1 + (seed >> 16) % 127);
+        }
+        char buf[512];
+        JsonWriter w(buf, sizeof(buf));
+        w.beginObject().key("s").value(original, n).endObject();
+        TEST_ASSERT_TRUE(w.ok());
+
+        char out[48];
+        JsonField fields[] = {{"s", out, sizeof(out), false}};
+        JsonFieldExtractor ex(fields, 1);
+        TEST_ASSERT_TRUE(ex.feed(buf, w.length()));
+        TEST_ASSERT_TRUE(ex.finish());
+        TEST_ASSERT_TRUE(fields[0].found);
+        TEST_ASSERT_EQUAL(n, strlen(out));
+        TEST_ASSERT_EQUAL_MEMORY(original, out, n);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_writer_object);
+    RUN_TEST(test_writer_object_with_serialized_members);
+    RUN_TEST(test_writer_escapes);
+    RUN_TEST(test_writer_fixed_point);
+    RUN_TEST(test_writer_overflow_is_reported);
+    RUN_TEST(test_parser_tokens);
+    RUN_TEST(test_parser_unicode);
+    RUN_TEST(test_parser_truncates_long_text);
+    RUN_TEST(test_fields_ignore_order_whitespace_and_nesting);
+    RUN_TEST(test_fields_reject_oversized_and_invalid);
+    RUN_TEST(test_corpus_chunk_split_invariance);
+    RUN_TEST(test_corpus_mutations);
+    RUN_TEST(test_writer_parser_round_trip);
+    return UNITY_END();
+}
@@ -0,0 +1,323 @@
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "link_manager.h"
+
+static uint32_t fakeNow = 0;
+static uint32_t fakeMillis() { return fakeNow; }
+
+static const uint32_t NEVER = 0xffffffffu;
+
+// Access point, NVS and SNTP in one. Association completes after a delay
+// that depends on whether the hint still matches the AP.
+struct FakeWifi : public LinkBackend {
+    FakeWifi() {
+        memset(&ap, 0, sizeof(ap));
+        memset(&stored, 0, sizeof(stored));
+        uint8_t bssid[6] = {0x24, 0x0a, 0xc4, 0x11, 0x22, 0x33};
+        memcpy(ap.bssid, bssid, 6);
+        ap.channel = 6;
+        ap.ip = 0x0a01a8c0;
+        ap.gateway = 0x0101a8c0;
+        ap.subnet = 0x00ffffff;
+        ap.dns = 0x0101a8c0;
+    }
+
+    void connect(const LinkCache* hint) {
+        connects++;
+        lastHint = hint != NULL;
+        if (!apUp) {
+            gotIpAt = NEVER;
+        } else if (hint) {
+            bool match = memcmp(hint->bssid, ap.bssid, 6) == 0 && hint->channel == ap.channel;
+            gotIpAt = match ? fakeNow + fastMs : NEVER;
+        } else {
+            gotIpAt = fakeNow + scanMs + dhcpMs;
+        }
+    }
+    void disconnect() {
+        disconnects++;
+        gotIpAt = NEVER;
+    }
+    void powerDown() {
+        powerDowns++;
+        gotIpAt = NEVER;
+    }
+    bool current(LinkCache& out) {
+        out = ap;
+        return true;
+    }
+    bool loadCache(LinkCache& out) {
+        if (!hasStored) return false;
+        out = stored;
+        return true;
+    }
+    void saveCache(const LinkCache& cache) {
+        stored = cache;
+        hasStored = true;
+        saves++;
+    }
+    void startTimeSync() {
+        syncStarts++;
+        syncAt = sntpReachable ? fakeNow + sntpMs : NEVER;
+    }
+    bool timeSynced() { return syncAt != NEVER && (int32_t)(fakeNow - syncAt) >= 0; }
+
+    LinkCache ap;
+    LinkCache stored;
+    bool hasStored = false;
+    bool apUp = true;
+    bool sntpReachable = true;
+    uint32_t fastMs = 300;
+    uint32_t scanMs = 2500;
+    uint32_t dhcpMs = 1500;
+    uint32_t sntpMs = 800;
+    uint32_t gotIpAt = NEVER;
+    uint32_t syncAt = NEVER;
+    bool lastHint = false;
+    int connects = 0;
+    int disconnects = 0;
+    int powerDowns = 0;
+    int saves = 0;
+    int syncStarts = 0;
+};
+
+// The loop task: wait for the next event or poll deadline, whichever is first.
+static void runUntil(LinkManager& link, FakeWifi& wifi, uint32_t end) {
+    for (;;) {
+        uint32_t wait = link.poll();
+        uint32_t next = fakeNow + wait;
+        if (wifi.gotIpAt != NEVER && (int32_t)(wifi.gotIpAt - next) < 0) next = wifi.gotIpAt;
+        if (wifi.syncAt != NEVER && (int32_t)(wifi.syncAt - next) < 0 && (int32_t)(wifi.syncAt - fakeNow) > 0)
+            next = wifi.syncAt;
+        if ((int32_t)(next - end) > 0) break;
+        fakeNow = next;
+        if (wifi.gotIpAt == fakeNow) {
+            wifi.gotIpAt = NEVER;
+            link.post(LINK_EVT_GOT_IP);
+        }
+        if (wifi.syncAt == fakeNow) link.post(LINK_EVT_TIME_SYNCED);
+    }
+    fakeNow = end;
+    link.poll();
+}
+
+static std::vector<LinkState> transitions;
+static void recordState(LinkState state, void*) { transitions.push_back(state); }
+
+static LinkConfig config() { return defaultLinkConfig(fakeMillis); }
+
+void setUp(void) {
+    fakeNow = 0;
+    transitions.clear();
+}
+void tearDown(void) {}
+
+void test_cold_boot_scans_and_saves_the_cache() {
+    FakeWifi wifi;
+    LinkManager link(wifi, config());
+    link.setListener(recordState, NULL);
+    link.begin();
+    TEST_ASSERT_EQUAL(LINK_CONNECT, link.state());
+    TEST_ASSERT_FALSE(wifi.lastHint);
+
+    runUntil(link, wifi, 5000);
+    TEST_ASSERT_TRUE(link.online());
+    TEST_ASSERT_EQUAL_UINT32(4000, link.stats().bootToOnlineMs);
+    TEST_ASSERT_EQUAL(1, wifi.saves);
+    TEST_ASSERT_TRUE(sameLinkCache(wifi.ap, wifi.stored));
+    TEST_ASSERT_EQUAL(2, (int)transitions.size());
+    TEST_ASSERT_EQUAL(LINK_ONLINE, transitions[1]);
+}
+
+void test_warm_boot_uses_cache_and_skips_the_scan() {
+    FakeWifi wifi;
+    wifi.stored = wifi.ap;
+    wifi.hasStored = true;
+    LinkManager link(wifi, config());
+    link.begin();
+    TEST_ASSERT_EQUAL(LINK_FAST_CONNECT, link.state());
+    TEST_ASSERT_TRUE(wifi.lastHint);
+
+    runUntil(link, wifi, 1000);
+    TEST_ASSERT_TRUE(link.online());
+    TEST_ASSERT_EQUAL_UINT32(300, link.stats().bootToOnlineMs);
+    TEST_ASSERT_EQUAL_UINT32(1, link.stats().fastHits);
+    // Nothing changed, so flash is not written again
+    TEST_ASSERT_EQUAL(0, wifi.saves);
+}
+
+void test_stale_cache_falls_back_to_a_scan() {
+    FakeWifi wifi;
+    wifi.stored = wifi.ap;
+    wifi.hasStored = true;
+    wifi.ap.channel = 11; // AP moved since the last boot
+    wifi.ap.bssid[5] = 0x44;
+    LinkManager link(wifi, config());
+    link.begin();
+
+    runUntil(link, wifi, 3000);
+    TEST_ASSERT_EQUAL(LINK_CONNECT, link.state());
+    TEST_ASSERT_EQUAL_UINT32(1, link.stats().timeouts);
+    TEST_ASSERT_EQUAL(1, wifi.disconnects);
+
+    runUntil(link, wifi, 8000);
+    TEST_ASSERT_TRUE(link.online());
+    TEST_ASSERT_EQUAL_UINT32(7000, link.stats().bootToOnlineMs);
+    TEST_ASSERT_EQUAL(1, wifi.saves);
+    TEST_ASSERT_EQUAL(11, wifi.stored.channel);
+}
+
+void test_failed_attempts_back_off_exponentially() {
+    FakeWifi wifi;
+    wifi.apUp = false;
+    wifi.scanMs = 500;
+    wifi.dhcpMs = 300;
+    LinkConfig c = config();
+    c.connectTimeoutMs = 1000;
+    c.retryBaseMs = 1000;
+    c.retryMaxMs = 4000;
+    LinkManager link(wifi, c);
+    link.begin();
+
+    std::vector<uint32_t> starts;
+    int seen = wifi.connects;
+    starts.push_back(fakeNow);
+    while (fakeNow < 30000) {
+        uint32_t wait = link.poll();
+        TEST_ASSERT_TRUE(wait > 0); // never spins
+        fakeNow += wait;
+        link.poll();
+        if (wifi.connects != seen) {
+            seen = wifi.connects;
+            starts.push_back(fakeNow);
+        }
+    }
+    // attempt 1 s + backoff 1, 2, 4, 4 ... s
+    TEST_ASSERT_TRUE(starts.size() >= 6);
+    TEST_ASSERT_EQUAL_UINT32(2000, starts[1] - starts[0]);
+    TEST_ASSERT_EQUAL_UINT32(3000, starts[2] - starts[1]);
+    TEST_ASSERT_EQUAL_UINT32(5000, starts[3] - starts[2]);
+    TEST_ASSERT_EQUAL_UINT32(5000, starts[4] - starts[3]);
+    TEST_ASSERT_FALSE(link.online());
+
+    wifi.apUp = true;
+    runUntil(link, wifi, 40000);
+    TEST_ASSERT_TRUE(link.online());
+}
+
+void test_time_sync_does_not_gate_online() {
+    FakeWifi wifi;
+    wifi.sntpReachable = false;
+    LinkConfig c = config();
+    c.timeSyncTimeoutMs = 5000;
+    LinkManager link(wifi, c);
+    link.begin();
+
+    runUntil(link, wifi, 4000);
+    TEST_ASSERT_TRUE(link.online());
+    TEST_ASSERT_FALSE(link.timeSynced());
+    TEST_ASSERT_EQUAL(1, wifi.syncStarts);
+
+    // SNTP is restarted after each timeout while it stays silent
+    runUntil(link, wifi, 14000);
+    TEST_ASSERT_EQUAL(3, wifi.syncStarts);
+    TEST_ASSERT_EQUAL_UINT32(2, link.stats().timeSyncRestarts);
+
+    wifi.sntpReachable = true;
+    runUntil(link, wifi, 20000);
+    TEST_ASSERT_TRUE(link.timeSynced());
+    TEST_ASSERT_EQUAL_UINT32(19800, link.stats().bootToTimeMs);
+    TEST_ASSERT_EQUAL(4, wifi.syncStarts);
+    TEST_ASSERT_EQUAL_UINT32(LINK_IDLE_MS, link.poll());
+}
+
+void test_drop_reconnects_with_the_cache() {
+    FakeWifi wifi;
+    LinkManager link(wifi, config());
+    link.setListener(recordState, NULL);
+    link.begin();
+    runUntil(link, wifi, 5000);
+    TEST_ASSERT_TRUE(link.online());
+
+    link.post(LINK_EVT_LOST);
+    link.poll();
+    TEST_ASSERT_FALSE(link.online());
+    TEST_ASSERT_EQUAL(LINK_FAST_CONNECT, link.state());
+    TEST_ASSERT_EQUAL_UINT32(1, link.stats().drops);
+
+    runUntil(link, wifi, 6000);
+    TEST_ASSERT_TRUE(link.online());
+    TEST_ASSERT_EQUAL_UINT32(300, link.stats().lastConnectMs);
+    TEST_ASSERT_EQUAL(1, wifi.saves);
+    // connect, online, fast connect, online
+    TEST_ASSERT_EQUAL(4, (int)transitions.size());
+    // SNTP is started once per boot, not per association
+    TEST_ASSERT_EQUAL(1, wifi.syncStarts);
+}
+
+void test_lost_while_connecting_waits_for_the_timeout() {
+    FakeWifi wifi;
+    LinkManager link(wifi, config());
+    link.begin();
+    fakeNow = 1000;
+    link.post(LINK_EVT_LOST);
+    link.poll();
+    TEST_ASSERT_EQUAL(LINK_CONNECT, link.state());
+    TEST_ASSERT_EQUAL(1, wifi.connects);
+    TEST_ASSERT_EQUAL_UINT32(0, link.stats().drops);
+}
+
+void test_suspend_turns_the_radio_off_until_resumed() {
+    FakeWifi wifi;
+    LinkManager link(wifi, config());
+    link.setListener(recordState, NULL);
+    link.begin();
+    runUntil(link, wifi, 5000);
+    TEST_ASSERT_TRUE(link.online());
+
+    link.suspend();
+    link.post(LINK_EVT_LOST); // the disconnect reports itself
+    TEST_ASSERT_EQUAL_UINT32(LINK_IDLE_MS, link.poll());
+    TEST_ASSERT_EQUAL(LINK_IDLE, link.state());
+    TEST_ASSERT_FALSE(link.online());
+    TEST_ASSERT_EQUAL(1, wifi.powerDowns);
+    runUntil(link, wifi, 300000);
+    TEST_ASSERT_EQUAL(1, wifi.connects);
+    TEST_ASSERT_EQUAL_UINT32(0, link.stats().drops);
+
+    // Back on the cached BSSID/IP in one fast attempt
+    link.resume();
+    runUntil(link, wifi, 300400);
+    TEST_ASSERT_TRUE(link.online());
+    TEST_ASSERT_TRUE(wifi.lastHint);
+    TEST_ASSERT_EQUAL(2, wifi.connects);
+    TEST_ASSERT_EQUAL_UINT32(1, link.stats().suspends);
+    TEST_ASSERT_EQUAL(1, wifi.saves);
+}
+
+void test_first_publish_is_recorded_once() {
+    FakeWifi wifi;
+    LinkManager link(wifi, config());
+    link.begin();
+    runUntil(link, wifi, 4200);
+    TEST_ASSERT_EQUAL_UINT32(0, link.bootToFirstPublishMs());
+    link.markFirstPublish();
+    fakeNow = 9000;
+    link.markFirstPublish();
+    TEST_ASSERT_EQUAL_UINT32(4200, link.bootToFirstPublishMs());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_cold_boot_scans_and_saves_the_cache);
+    RUN_TEST(test_warm_boot_uses_cache_and_skips_the_scan);
+    RUN_TEST(test_stale_cache_falls_back_to_a_scan);
+    RUN_TEST(test_failed_attempts_back_off_exponentially);
+    RUN_TEST(test_time_sync_does_not_gate_online);
+    RUN_TEST(test_drop_reconnects_with_the_cache);
+    RUN_TEST(test_lost_while_connecting_waits_for_the_timeout);
+    RUN_TEST(test_suspend_turns_the_radio_off_until_resumed);
+    RUN_TEST(test_first_publish_is_recorded_once);
+    return UNITY_END();
+}
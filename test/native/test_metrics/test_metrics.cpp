@@ -0,0 +1,117 @@
+#include <unity.h>
+#include <string.h>
+#include <thread>
+#include "metrics.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_buckets_are_powers_of_two() {
+    TEST_ASSERT_EQUAL(0, histogramBucket(0));
+    TEST_ASSERT_EQUAL(1, histogramBucket(1));
+    TEST_ASSERT_EQUAL(2, histogramBucket(2));
+    TEST_ASSERT_EQUAL(2, histogramBucket(3));
+    TEST_ASSERT_EQUAL(7, histogramBucket(100));
+    TEST_ASSERT_EQUAL(METRIC_BUCKETS - 1, histogramBucket(16384));
+    TEST_ASSERT_EQUAL(METRIC_BUCKETS - 1, histogramBucket(0xffffffffu));
+}
+
+void test_counters_and_gauges() {
+    MetricsRegistry m;
+    int retries = m.counter("http_retries");
+    int heap = m.gauge("heap_min");
+    m.add(retries);
+    m.add(retries, 2);
+    m.set(heap, 81234);
+    m.set(heap, 80000);
+    TEST_ASSERT_EQUAL_UINT32(3, m.count(retries));
+    TEST_ASSERT_EQUAL_INT32(80000, m.value(heap));
+    m.set(heap, -5);
+    TEST_ASSERT_EQUAL_INT32(-5, m.value(heap));
+    TEST_ASSERT_EQUAL_STRING("heap_min", m.name(heap));
+}
+
+void test_histogram_percentiles() {
+    MetricsRegistry m;
+    int http = m.histogram("http_ms");
+    for (int i = 0; i < 98; i++) m.record(http, 40);  // bucket [32,64)
+    m.record(http, 300);                              // [256,512)
+    m.record(http, 2100);                             // [2048,4096)
+    HistogramSnapshot h;
+    TEST_ASSERT_TRUE(m.snapshot(http, &h));
+    TEST_ASSERT_EQUAL_UINT32(100, h.count);
+    TEST_ASSERT_EQUAL_UINT32(98 * 40 + 300 + 2100, h.sum);
+    TEST_ASSERT_EQUAL_UINT32(2100, h.max);
+    TEST_ASSERT_EQUAL_UINT32(63, histogramPercentile(h, 50));
+    TEST_ASSERT_EQUAL_UINT32(511, histogramPercentile(h, 99));
+    TEST_ASSERT_EQUAL_UINT32(2100, histogramPercentile(h, 100)); // capped at max
+
+    m.resetHistograms();
+    TEST_ASSERT_TRUE(m.snapshot(http, &h));
+    TEST_ASSERT_EQUAL_UINT32(0, h.count);
+    TEST_ASSERT_EQUAL_UINT32(0, histogramPercentile(h, 99));
+}
+
+void test_full_table_drops_only_the_new_metric() {
+    MetricsRegistry m;
+    int last = -1;
+    for (int i = 0; i < METRICS_MAX_HISTOGRAMS; i++) last = m.histogram("h");
+    TEST_ASSERT_EQUAL(METRICS_MAX_HISTOGRAMS - 1, last);
+    TEST_ASSERT_EQUAL(-1, m.histogram("one_too_many"));
+    while (m.size() < METRICS_MAX) m.counter("c");
+    TEST_ASSERT_EQUAL(-1, m.counter("one_too_many"));
+    m.add(-1);
+    m.record(-1, 5);
+    m.record(0, 5);
+    TEST_ASSERT_EQUAL_UINT32(0, m.count(-1));
+    TEST_ASSERT_EQUAL_UINT32(1, m.count(0));
+    TEST_ASSERT_FALSE(m.snapshot(METRICS_MAX - 1, NULL)); // a counter has no histogram
+}
+
+void test_compact_encoding() {
+    MetricsRegistry m;
+    int retries = m.counter("http_retries");
+    int heap = m.gauge("heap_min");
+    int http = m.histogram("http_ms");
+    m.histogram("mqtt_ms");
+    m.add(retries, 3);
+    m.set(heap, 81234);
+    m.record(http, 40);
+    m.record(http, 430);
+    char out[256];
+    size_t len = m.encode(out, sizeof(out));
+    TEST_ASSERT_EQUAL(strlen(out), len);
+    TEST_ASSERT_EQUAL_STRING(
+        "{\"c\":{\"http_retries\":3},\"g\":{\"heap_min\":81234},"
+        "\"h\":{\"http_ms\":[2,63,430,430],\"mqtt_ms\":[0,0,0,0]}}", out);
+    TEST_ASSERT_EQUAL(0, m.encode(out, 40));
+}
+
+void test_records_from_several_tasks() {
+    MetricsRegistry m;
+    int ops = m.counter("ops");
+    int lat = m.histogram("lat");
+    std::thread a([&]() { for (int i = 0; i < 100000; i++) { m.add(ops); m.record(lat, i & 1023); } });
+    std::thread b([&]() { for (int i = 0; i < 100000; i++) { m.add(ops); m.record(lat, 5000); } });
+    a.join();
+    b.join();
+    HistogramSnapshot h;
+    m.snapshot(lat, &h);
+    TEST_ASSERT_EQUAL_UINT32(200000, m.count(ops));
+    TEST_ASSERT_EQUAL_UINT32(200000, h.count);
+    TEST_ASSERT_EQUAL_UINT32(5000, h.max);
+    uint32_t total = 0;
+    for (int i = 0; i < METRIC_BUCKETS; i++) total += h.buckets[i];
+    TEST_ASSERT_EQUAL_UINT32(200000, total);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_buckets_are_powers_of_two);
+    RUN_TEST(test_counters_and_gauges);
+    RUN_TEST(test_histogram_percentiles);
+    RUN_TEST(test_full_table_drops_only_the_new_metric);
+    RUN_TEST(test_compact_encoding);
+    RUN_TEST(test_records_from_several_tasks);
+    return UNITY_END();
+}
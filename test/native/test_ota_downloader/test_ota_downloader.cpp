@@ -0,0 +1,308 @@
+#include <unity.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "http_session_pool.h"
+#include "http_standin.h"
+#include "ota_downloader.h"
+#include "posix_transport.h"
+#include "sha256.h"
+
+static uint32_t fakeNow = 0;
+static uint32_t fakeMillis() { return fakeNow; }
+static uint32_t sleptMs = 0;
+static void fakeSleep(uint32_t ms) {
+    sleptMs += ms;
+    fakeNow += ms;
+}
+
+static PosixTransportFactory factory;
+static const char* IMAGE_PATH = "/tmp/ota_downloader_image.bin";
+static std::string image;
+static std::string imageSha;
+
+// Collects the image in memory the way the OTA partition would.
+class MemoryWriter : public FlashWriter {
+public:
+    bool begin(uint32_t size) {
+        begun = true;
+        announced = size;
+        data.clear();
+        return true;
+    }
+    bool write(const uint8_t* p, size_t len) {
+        writes.push_back(len);
+        data.append((const char*)p, len);
+        return !failWrites;
+    }
+    bool commit() {
+        committed = true;
+        return true;
+    }
+    void abort() { aborted = true; }
+
+    bool begun = false, committed = false, aborted = false, failWrites = false;
+    uint32_t announced = 0;
+    std::string data;
+    std::vector<size_t> writes;
+};
+
+// Serves IMAGE_PATH from disk, honouring "Range: bytes=N-".
+struct FileServer {
+    bool honourRange = true;
+    size_t cutFirstAfter = 0; // drop the first response after this many bytes
+    int requests = 0;
+    std::vector<std::string> ranges;
+
+    void operator()(const StandinRequest& req, StandinResponse& resp) {
+        requests++;
+        FILE* f = fopen(IMAGE_PATH, "rb");
+        std::string file;
+        char buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) file.append(buf, n);
+        fclose(f);
+
+        auto it = req.headers.find("range");
+        ranges.push_back(it == req.headers.end() ? "" : it->second);
+        size_t from = 0;
+        if (honourRange && it != req.headers.end()) {
+            from = strtoul(it->second.c_str() + 6, NULL, 10);
+            resp.status = 206;
+            resp.extraHeaders = "Content-Range: bytes " + std::to_string(from) + "-" +
+                                std::to_string(file.size() - 1) + "/" + std::to_string(file.size()) + "\r\n";
+        }
+        resp.body = file.substr(from);
+        if (requests == 1 && cutFirstAfter) resp.cutAfter = cutFirstAfter;
+    }
+};
+
+static OtaConfig testConfig() {
+    OtaConfig cfg = defaultOtaConfig(fakeMillis, fakeSleep);
+    cfg.progressIntervalMs = 0;
+    return cfg;
+}
+
+static HttpPoolConfig poolConfig() {
+    HttpPoolConfig cfg = defaultHttpPoolConfig(fakeMillis);
+    cfg.ioTimeoutMs = 2000;
+    return cfg;
+}
+
+void setUp(void) {
+    fakeNow = 1000;
+    sleptMs = 0;
+}
+void tearDown(void) {}
+
+void test_sha256_known_vectors() {
+    uint8_t d[SHA256_DIGEST_LEN];
+    char hex[65];
+    Sha256 sha;
+    sha.update((const uint8_t*)"abc", 3);
+    sha.finish(d);
+    sha256ToHex(d, hex);
+    TEST_ASSERT_EQUAL_STRING("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", hex);
+
+    // Same digest when fed byte by byte across block boundaries.
+    std::string msg(1000, 'a');
+    Sha256 whole, pieces;
+    whole.update((const uint8_t*)msg.data(), msg.size());
+    for (size_t i = 0; i < msg.size(); i++) pieces.update((const uint8_t*)msg.data() + i, 1);
+    uint8_t a[SHA256_DIGEST_LEN], b[SHA256_DIGEST_LEN];
+    whole.finish(a);
+    pieces.finish(b);
+    TEST_ASSERT_EQUAL_MEMORY(a, b, SHA256_DIGEST_LEN);
+    sha256ToHex(a, hex);
+    TEST_ASSERT_TRUE(sha256MatchesHex(a, hex));
+    hex[0] = hex[0] == '0' ? '1' : '0';
+    TEST_ASSERT_FALSE(sha256MatchesHex(a, hex));
+}
+
+void test_full_download_verifies_and_commits() {
+    FileServer files;
+    HttpStandin server(std::ref(files));
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    MemoryWriter writer;
+    uint8_t buffer[4096];
+    OtaDownloader ota(pool, writer, buffer, sizeof(buffer), testConfig());
+
+    std::string url = server.url("/firmware.bin");
+    TEST_ASSERT_EQUAL(OTA_OK, ota.run(url.c_str(), NULL, imageSha.c_str()));
+    TEST_ASSERT_TRUE(writer.committed);
+    TEST_ASSERT_FALSE(writer.aborted);
+    TEST_ASSERT_EQUAL(image.size(), writer.announced);
+    TEST_ASSERT_TRUE(writer.data == image);
+    TEST_ASSERT_EQUAL_STRING(imageSha.c_str(), ota.digestHex());
+    TEST_ASSERT_EQUAL(1, ota.stats().attempts);
+    TEST_ASSERT_EQUAL(0, ota.stats().resumes);
+    // Every write but the last fills the whole buffer.
+    for (size_t i = 0; i + 1 < writer.writes.size(); i++) TEST_ASSERT_EQUAL(sizeof(buffer), writer.writes[i]);
+}
+
+void test_digest_mismatch_aborts() {
+    FileServer files;
+    HttpStandin server(std::ref(files));
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    MemoryWriter writer;
+    uint8_t buffer[1024];
+    OtaDownloader ota(pool, writer, buffer, sizeof(buffer), testConfig());
+
+    std::string wrong(64, '0');
+    std::string url = server.url("/firmware.bin");
+    TEST_ASSERT_EQUAL(OTA_ERR_DIGEST, ota.run(url.c_str(), NULL, wrong.c_str()));
+    TEST_ASSERT_FALSE(writer.committed);
+    TEST_ASSERT_TRUE(writer.aborted);
+}
+
+void test_resume_with_range_after_drop() {
+    FileServer files;
+    files.cutFirstAfter = 50000;
+    HttpStandin server(std::ref(files));
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    MemoryWriter writer;
+    uint8_t buffer[4096];
+    OtaDownloader ota(pool, writer, buffer, sizeof(buffer), testConfig());
+
+    std::string url = server.url("/firmware.bin");
+    TEST_ASSERT_EQUAL(OTA_OK, ota.run(url.c_str(), "X-Device-ID: esp32-test\r\n", imageSha.c_str()));
+    TEST_ASSERT_TRUE(writer.data == image);
+    TEST_ASSERT_EQUAL(2, files.requests);
+    TEST_ASSERT_EQUAL_STRING("", files.ranges[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("bytes=50000-", files.ranges[1].c_str());
+    TEST_ASSERT_EQUAL(2, ota.stats().attempts);
+    TEST_ASSERT_EQUAL(1, ota.stats().resumes);
+    TEST_ASSERT_EQUAL(1000, sleptMs);
+    TEST_ASSERT_TRUE(ota.stats().stallMs >= 1000);
+}
+
+void test_resume_when_server_ignores_range() {
+    FileServer files;
+    files.cutFirstAfter = 30001;
+    files.honourRange = false;
+    HttpStandin server(std::ref(files));
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    MemoryWriter writer;
+    uint8_t buffer[512];
+    OtaDownloader ota(pool, writer, buffer, sizeof(buffer), testConfig());
+
+    std::string url = server.url("/firmware.bin");
+    TEST_ASSERT_EQUAL(OTA_OK, ota.run(url.c_str(), NULL, imageSha.c_str()));
+    TEST_ASSERT_TRUE(writer.data == image);
+    TEST_ASSERT_EQUAL(image.size(), ota.stats().bytes);
+}
+
+void test_gives_up_after_max_attempts() {
+    HttpStandin server([](const StandinRequest&, StandinResponse& resp) {
+        resp.body = std::string(10000, 'x');
+        resp.cutAfter = 100;
+    });
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    MemoryWriter writer;
+    uint8_t buffer[256];
+    OtaConfig cfg = testConfig();
+    cfg.maxAttempts = 3;
+    OtaDownloader ota(pool, writer, buffer, sizeof(buffer), cfg);
+
+    std::string url = server.url("/firmware.bin");
+    TEST_ASSERT_EQUAL(OTA_ERR_NETWORK, ota.run(url.c_str(), NULL, NULL));
+    TEST_ASSERT_EQUAL(3, ota.stats().attempts);
+    TEST_ASSERT_TRUE(writer.aborted);
+    TEST_ASSERT_FALSE(writer.committed);
+    TEST_ASSERT_EQUAL(1000 + 2000, sleptMs);
+}
+
+void test_http_error_does_not_touch_flash() {
+    HttpStandin server([](const StandinRequest&, StandinResponse& resp) {
+        resp.status = 404;
+        resp.body = "not found";
+    });
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    MemoryWriter writer;
+    uint8_t buffer[256];
+    OtaDownloader ota(pool, writer, buffer, sizeof(buffer), testConfig());
+
+    std::string url = server.url("/missing.bin");
+    TEST_ASSERT_EQUAL(OTA_ERR_HTTP, ota.run(url.c_str(), NULL, NULL));
+    TEST_ASSERT_EQUAL(404, ota.stats().lastHttpCode);
+    TEST_ASSERT_FALSE(writer.begun);
+    TEST_ASSERT_EQUAL(1, ota.stats().attempts);
+}
+
+void test_write_failure_aborts() {
+    FileServer files;
+    HttpStandin server(std::ref(files));
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    MemoryWriter writer;
+    writer.failWrites = true;
+    uint8_t buffer[4096];
+    OtaDownloader ota(pool, writer, buffer, sizeof(buffer), testConfig());
+
+    std::string url = server.url("/firmware.bin");
+    TEST_ASSERT_EQUAL(OTA_ERR_WRITE, ota.run(url.c_str(), NULL, imageSha.c_str()));
+    TEST_ASSERT_TRUE(writer.aborted);
+    TEST_ASSERT_FALSE(writer.committed);
+}
+
+static void countProgress(const OtaStats& stats, void* ctx) {
+    std::vector<uint32_t>* seen = static_cast<std::vector<uint32_t>*>(ctx);
+    seen->push_back(stats.bytes);
+}
+
+void test_progress_reports_are_monotonic() {
+    FileServer files;
+    HttpStandin server(std::ref(files));
+    TEST_ASSERT_TRUE(server.start());
+    HttpSessionPool pool(factory, poolConfig());
+    MemoryWriter writer;
+    uint8_t buffer[2048];
+    OtaDownloader ota(pool, writer, buffer, sizeof(buffer), testConfig());
+    std::vector<uint32_t> seen;
+    ota.onProgress(countProgress, &seen);
+
+    std::string url = server.url("/firmware.bin");
+    TEST_ASSERT_EQUAL(OTA_OK, ota.run(url.c_str(), NULL, NULL));
+    TEST_ASSERT_TRUE(seen.size() > 2);
+    for (size_t i = 1; i < seen.size(); i++) TEST_ASSERT_TRUE(seen[i] >= seen[i - 1]);
+    TEST_ASSERT_EQUAL(image.size(), seen.back());
+}
+
+int main() {
+    // 200 KB of pseudo-random "firmware".
+    srand(7);
+    image.resize(200 * 1024 + 123);
+    for (size_t i = 0; i < image.size(); i++) image[i] = (char)(rand() & 0xff);
+    FILE* f = fopen(IMAGE_PATH, "wb");
+    fwrite(image.data(), 1, image.size(), f);
+    fclose(f);
+    Sha256 sha;
+    uint8_t d[SHA256_DIGEST_LEN];
+    char hex[65];
+    sha.update((const uint8_t*)image.data(), image.size());
+    sha.finish(d);
+    sha256ToHex(d, hex);
+    imageSha = hex;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_sha256_known_vectors);
+    RUN_TEST(test_full_download_verifies_and_commits);
+    RUN_TEST(test_digest_mismatch_aborts);
+    RUN_TEST(test_resume_with_range_after_drop);
+    RUN_TEST(test_resume_when_server_ignores_range);
+    RUN_TEST(test_gives_up_after_max_attempts);
+    RUN_TEST(test_http_error_does_not_touch_flash);
+    RUN_TEST(test_write_failure_aborts);
+    RUN_TEST(test_progress_reports_are_monotonic);
+    int rc = UNITY_END();
+    remove(IMAGE_PATH);
+    return rc;
+}
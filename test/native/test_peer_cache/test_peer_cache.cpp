@@ -0,0 +1,358 @@
+#include <unity.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "http_session_pool.h"
+#include "ota_downloader.h"
+#include "peer_cache.h"
+#include "peer_standin.h"
+#include "posix_transport.h"
+
+static uint32_t fakeNow = 0;
+static uint32_t fakeMillis() { return fakeNow; }
+static void fakeSleep(uint32_t ms) { fakeNow += ms; }
+
+// Start of the peer search, normally random
+static uint32_t nextStart = 0;
+static uint32_t fixedRandom(uint32_t bound) { return bound ? nextStart++ % bound : 0; }
+
+static PosixTransportFactory factory;
+static std::string image;
+static std::string otherImage;
+
+static std::string makeImage(size_t size, uint32_t seed) {
+    std::string out(size, '\0');
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1664525 + 1013904223;
+        out[i] = (char)(seed >> 24);
+    }
+    return out;
+}
+
+// Stands in for mDNS: reports whatever peers the test put in it
+class ListDiscovery : public PeerDiscovery {
+public:
+    size_t query(PeerInfo* out, size_t max) {
+        queries++;
+        size_t n = peers.size() < max ? peers.size() : max;
+        for (size_t i = 0; i < n; i++) out[i] = peers[i];
+        return n;
+    }
+    std::vector<PeerInfo> peers;
+    int queries = 0;
+};
+
+// Collects the image the way the OTA partition would
+class MemoryWriter : public FlashWriter {
+public:
+    bool begin(uint32_t) {
+        data.clear();
+        return true;
+    }
+    bool write(const uint8_t* p, size_t len) {
+        data.append((const char*)p, len);
+        return true;
+    }
+    bool commit() {
+        commits++;
+        return true;
+    }
+    void abort() { aborts++; }
+
+    std::string data;
+    int commits = 0, aborts = 0;
+};
+
+// What installFirmware does with a peer URL: no API headers, digest checked
+struct Fetcher {
+    HttpSessionPool* pool;
+    MemoryWriter writer;
+    std::vector<std::string> urls;
+};
+
+static int fetchImage(const char* url, const char* sha256, void* ctx) {
+    Fetcher* f = static_cast<Fetcher*>(ctx);
+    f->urls.push_back(url);
+    uint8_t buffer[4096];
+    OtaConfig cfg = defaultOtaConfig(fakeMillis, fakeSleep);
+    cfg.maxAttempts = 2;
+    OtaDownloader ota(*f->pool, f->writer, buffer, sizeof(buffer), cfg);
+    return ota.run(url, NULL, sha256);
+}
+
+static HttpPoolConfig poolConfig() {
+    HttpPoolConfig cfg = defaultHttpPoolConfig(fakeMillis);
+    cfg.ioTimeoutMs = 2000;
+    return cfg;
+}
+
+static PeerInfo fakePeer(const char* host, const PeerImage& img) {
+    PeerInfo peer;
+    memset(&peer, 0, sizeof(peer));
+    strcpy(peer.host, host);
+    peer.port = 8070;
+    peer.image = img;
+    return peer;
+}
+
+void setUp(void) {
+    fakeNow = 1000;
+    nextStart = 0;
+}
+void tearDown(void) {}
+
+void test_txt_fields_make_an_advertisement() {
+    PeerImage img;
+    memset(&img, 0, sizeof(img));
+    TEST_ASSERT_FALSE(peerImageValid(img));
+    TEST_ASSERT_TRUE(peerTxtField("v", "1.3.0", img));
+    TEST_ASSERT_TRUE(peerTxtField("sha", "BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD", img));
+    TEST_ASSERT_FALSE(peerImageValid(img));
+    TEST_ASSERT_TRUE(peerTxtField("size", "1048576", img));
+    TEST_ASSERT_TRUE(peerImageValid(img));
+    TEST_ASSERT_EQUAL_UINT32(1048576, img.size);
+
+    TEST_ASSERT_FALSE(peerTxtField("sha", "ba7816bf", img));     // too short
+    TEST_ASSERT_FALSE(peerTxtField("size", "12kb", img));
+    TEST_ASSERT_FALSE(peerTxtField("size", "0", img));
+    TEST_ASSERT_FALSE(peerTxtField("v", "", img));
+    TEST_ASSERT_FALSE(peerTxtField("path", "/fw/", img));
+    TEST_ASSERT_EQUAL_STRING("1.3.0", img.version);        // rejected values change nothing
+
+    PeerInfo peer = fakePeer("192.168.1.23", img);
+    char url[PEER_URL_MAX];
+    TEST_ASSERT_TRUE(peerImageUrl(peer, url, sizeof(url)) > 0);
+    TEST_ASSERT_EQUAL_STRING(
+        "http://192.168.1.23:8070/fw/BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD", url);
+    TEST_ASSERT_EQUAL(0, (int)peerImageUrl(peer, url, 20));
+}
+
+void test_serves_the_image_and_ranges_of_it() {
+    PeerStandin peer(image, "1.3.0");
+    const PeerImage& img = peer.image();
+    std::string path = std::string(PEER_PATH_PREFIX) + img.sha256;
+
+    PeerServeResult r = peerServe(img, path.c_str(), NULL);
+    TEST_ASSERT_EQUAL(200, r.status);
+    TEST_ASSERT_EQUAL_UINT32(0, r.start);
+    TEST_ASSERT_EQUAL_UINT32(image.size(), r.length);
+
+    r = peerServe(img, path.c_str(), "bytes=1000-");
+    TEST_ASSERT_EQUAL(206, r.status);
+    TEST_ASSERT_EQUAL_UINT32(1000, r.start);
+    TEST_ASSERT_EQUAL_UINT32(image.size() - 1000, r.length);
+    char value[64];
+    peerContentRange(r, img, value, sizeof(value));
+    std::string expected = "bytes 1000-" + std::to_string(image.size() - 1) + "/" + std::to_string(image.size());
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), value);
+
+    r = peerServe(img, path.c_str(), "bytes=10-19");
+    TEST_ASSERT_EQUAL(206, r.status);
+    TEST_ASSERT_EQUAL_UINT32(10, r.length);
+    r = peerServe(img, path.c_str(), "bytes=10-99999999"); // end clipped to the image
+    TEST_ASSERT_EQUAL_UINT32(image.size() - 10, r.length);
+
+    // Upper-case digests name the same image
+    std::string upper = path;
+    for (size_t i = 0; i < upper.size(); i++) upper[i] = (char)toupper(upper[i]);
+    upper.replace(0, strlen(PEER_PATH_PREFIX), PEER_PATH_PREFIX);
+    TEST_ASSERT_EQUAL(200, peerServe(img, upper.c_str(), NULL).status);
+}
+
+void test_refuses_other_images_and_bad_ranges() {
+    PeerStandin peer(image, "1.3.0");
+    PeerStandin other(otherImage, "1.2.0");
+    const PeerImage& img = peer.image();
+    std::string path = std::string(PEER_PATH_PREFIX) + img.sha256;
+
+    TEST_ASSERT_EQUAL(404, peerServe(img, (std::string(PEER_PATH_PREFIX) + other.image().sha256).c_str(), NULL).status);
+    TEST_ASSERT_EQUAL(404, peerServe(img, "/fw/", NULL).status);
+    TEST_ASSERT_EQUAL(404, peerServe(img, (path + "x").c_str(), NULL).status);
+    TEST_ASSERT_EQUAL(404, peerServe(img, ("/api" + path).c_str(), NULL).status);
+    std::string past = "bytes=" + std::to_string(image.size()) + "-";
+    TEST_ASSERT_EQUAL(416, peerServe(img, path.c_str(), past.c_str()).status);
+    TEST_ASSERT_EQUAL(416, peerServe(img, path.c_str(), "bytes=20-10").status);
+    // Ranges the peer does not understand get the whole image
+    TEST_ASSERT_EQUAL(200, peerServe(img, path.c_str(), "bytes=-500").status);
+    TEST_ASSERT_EQUAL(200, peerServe(img, path.c_str(), "bytes=0-10,20-30").status);
+    TEST_ASSERT_EQUAL(200, peerServe(img, path.c_str(), "items=0-").status);
+
+    // Nothing is served without a valid image
+    PeerImage none;
+    memset(&none, 0, sizeof(none));
+    TEST_ASSERT_EQUAL(404, peerServe(none, "/fw/", NULL).status);
+}
+
+class StringSource : public SourceImage {
+public:
+    explicit StringSource(const std::string& s) : data(s) {}
+    bool read(uint32_t offset, uint8_t* buf, size_t len) {
+        if (offset + len > data.size()) return false;
+        memcpy(buf, data.data() + offset, len);
+        return true;
+    }
+    std::string data;
+};
+
+// Before serving, the device re-hashes what is in its running partition;
+// the partition is larger than the image, the rest does not count
+void test_image_is_checked_against_the_partition() {
+    PeerStandin peer(image, "1.3.0");
+    StringSource partition(image + std::string(4096, '\xff'));
+    uint8_t buf[1000];
+    TEST_ASSERT_TRUE(peerImageMatches(partition, peer.image(), buf, sizeof(buf)));
+    partition.data[7] ^= 1;
+    TEST_ASSERT_FALSE(peerImageMatches(partition, peer.image(), buf, sizeof(buf)));
+    StringSource shorter(image.substr(0, 100));
+    TEST_ASSERT_FALSE(peerImageMatches(shorter, peer.image(), buf, sizeof(buf)));
+}
+
+void test_directory_backs_off_failed_peers() {
+    PeerStandin a(image, "1.3.0");
+    PeerStandin b(otherImage, "1.2.0");
+    ListDiscovery discovery;
+    discovery.peers.push_back(fakePeer("10.0.0.1", b.image()));
+    discovery.peers.push_back(fakePeer("10.0.0.2", a.image()));
+    discovery.peers.push_back(fakePeer("10.0.0.3", a.image()));
+    PeerInfo broken = fakePeer("10.0.0.4", a.image());
+    broken.image.sha256[5] = 'z';
+    discovery.peers.push_back(broken);
+    PeerDirectory peers(discovery, fakeMillis, NULL, 60000);
+    TEST_ASSERT_EQUAL(3, (int)peers.refresh()); // the broken advertisement is dropped
+
+    PeerInfo got;
+    TEST_ASSERT_TRUE(peers.choose(a.image().sha256, got));
+    TEST_ASSERT_EQUAL_STRING("10.0.0.2", got.host);
+    peers.reportFailure(got);
+    TEST_ASSERT_TRUE(peers.choose(a.image().sha256, got));
+    TEST_ASSERT_EQUAL_STRING("10.0.0.3", got.host);
+    peers.reportFailure(got);
+    TEST_ASSERT_FALSE(peers.choose(a.image().sha256, got));
+    TEST_ASSERT_TRUE(peers.choose(b.image().sha256, got));
+
+    // A new query does not forgive them, the backoff does
+    peers.refresh();
+    TEST_ASSERT_FALSE(peers.choose(a.image().sha256, got));
+    fakeNow += 60000;
+    TEST_ASSERT_TRUE(peers.choose(a.image().sha256, got));
+    TEST_ASSERT_FALSE(peers.choose("not a digest", got));
+}
+
+void test_devices_updating_together_spread_over_peers() {
+    PeerStandin a(image, "1.3.0");
+    ListDiscovery discovery;
+    for (int i = 0; i < 4; i++) {
+        char host[16];
+        snprintf(host, sizeof(host), "10.0.0.%d", i + 1);
+        discovery.peers.push_back(fakePeer(host, a.image()));
+    }
+    PeerDirectory peers(discovery, fakeMillis, fixedRandom);
+    peers.refresh();
+    std::vector<std::string> hosts;
+    for (int i = 0; i < 4; i++) {
+        PeerInfo got;
+        TEST_ASSERT_TRUE(peers.choose(a.image().sha256, got));
+        hosts.push_back(got.host);
+    }
+    TEST_ASSERT_EQUAL_STRING("10.0.0.1", hosts[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("10.0.0.2", hosts[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("10.0.0.4", hosts[3].c_str());
+}
+
+// A peer that serves a bad image and one that went away are skipped; the
+// good peer's image arrives intact and the server is never asked
+void test_fetch_skips_corrupt_and_missing_peers() {
+    PeerStandin corrupt(image, "1.3.0");
+    PeerStandin gone(image, "1.3.0");
+    PeerStandin good(image, "1.3.0");
+    TEST_ASSERT_TRUE(corrupt.start());
+    TEST_ASSERT_TRUE(gone.start());
+    TEST_ASSERT_TRUE(good.start());
+    corrupt.corrupt(true);
+    ListDiscovery discovery;
+    discovery.peers.push_back(corrupt.info());
+    discovery.peers.push_back(gone.info());
+    discovery.peers.push_back(good.info());
+    gone.stop();
+
+    PeerDirectory peers(discovery, fakeMillis, NULL);
+    TEST_ASSERT_EQUAL(3, (int)peers.refresh());
+    HttpSessionPool pool(factory, poolConfig());
+    Fetcher fetcher;
+    fetcher.pool = &pool;
+    PeerInfo used;
+    const char* sha = good.image().sha256;
+    TEST_ASSERT_EQUAL(OTA_OK, fetchFromPeers(peers, sha, 3, fetchImage, &fetcher, &used));
+    TEST_ASSERT_EQUAL(good.info().port, used.port);
+    TEST_ASSERT_TRUE(fetcher.writer.data == image);
+    TEST_ASSERT_EQUAL(1, fetcher.writer.commits);
+    TEST_ASSERT_EQUAL(1, fetcher.writer.aborts); // the corrupt image, never committed; the gone peer sent nothing
+    TEST_ASSERT_EQUAL(3, (int)fetcher.urls.size());
+    TEST_ASSERT_EQUAL(1, (int)corrupt.requests());
+
+    // Only the good peer is left for the next device
+    PeerInfo next;
+    TEST_ASSERT_TRUE(peers.choose(sha, next));
+    TEST_ASSERT_EQUAL(good.info().port, next.port);
+    corrupt.stop();
+    good.stop();
+}
+
+void test_fetch_resumes_from_the_same_peer() {
+    PeerStandin good(image, "1.3.0");
+    TEST_ASSERT_TRUE(good.start());
+    good.cutNextAfter(50000);
+    ListDiscovery discovery;
+    discovery.peers.push_back(good.info());
+    PeerDirectory peers(discovery, fakeMillis, NULL);
+    peers.refresh();
+    HttpSessionPool pool(factory, poolConfig());
+    Fetcher fetcher;
+    fetcher.pool = &pool;
+    TEST_ASSERT_EQUAL(OTA_OK, fetchFromPeers(peers, good.image().sha256, 3, fetchImage, &fetcher, NULL));
+    TEST_ASSERT_TRUE(fetcher.writer.data == image);
+    TEST_ASSERT_EQUAL(1, (int)good.rangeRequests());
+    TEST_ASSERT_EQUAL_UINT32(image.size(), (uint32_t)good.bytesServed()); // no byte sent twice
+    good.stop();
+}
+
+void test_no_peer_with_the_image_means_the_server() {
+    PeerStandin old(otherImage, "1.2.0");
+    PeerStandin wanted(image, "1.3.0");
+    TEST_ASSERT_TRUE(old.start());
+    ListDiscovery discovery;
+    discovery.peers.push_back(old.info());
+    PeerDirectory peers(discovery, fakeMillis, NULL);
+    peers.refresh();
+    HttpSessionPool pool(factory, poolConfig());
+    Fetcher fetcher;
+    fetcher.pool = &pool;
+    TEST_ASSERT_EQUAL(OTA_ERR_NETWORK, fetchFromPeers(peers, wanted.image().sha256, 3, fetchImage, &fetcher, NULL));
+    TEST_ASSERT_EQUAL(0, (int)fetcher.urls.size());
+    TEST_ASSERT_EQUAL(0, (int)old.requests());
+
+    // Every peer failing ends with the last error, after maxPeers tries
+    old.corrupt(true);
+    TEST_ASSERT_EQUAL(OTA_ERR_DIGEST, fetchFromPeers(peers, old.image().sha256, 3, fetchImage, &fetcher, NULL));
+    TEST_ASSERT_EQUAL(1, (int)fetcher.urls.size());
+    old.stop();
+}
+
+int main() {
+    image = makeImage(150 * 1024 + 77, 1);
+    otherImage = makeImage(140 * 1024, 2);
+    UNITY_BEGIN();
+    RUN_TEST(test_txt_fields_make_an_advertisement);
+    RUN_TEST(test_serves_the_image_and_ranges_of_it);
+    RUN_TEST(test_refuses_other_images_and_bad_ranges);
+    RUN_TEST(test_image_is_checked_against_the_partition);
+    RUN_TEST(test_directory_backs_off_failed_peers);
+    RUN_TEST(test_devices_updating_together_spread_over_peers);
+    RUN_TEST(test_fetch_skips_corrupt_and_missing_peers);
+    RUN_TEST(test_fetch_resumes_from_the_same_peer);
+    RUN_TEST(test_no_peer_with_the_image_means_the_server);
+    return UNITY_END();
+}
@@ -0,0 +1,344 @@
+#include <unity.h>
+#include <string.h>
+#include "power_manager.h"
+#include "rtc_state.h"
+
+static uint32_t fakeNow = 0;
+static uint32_t fakeMillis() { return fakeNow; }
+
+static const uint32_t NEVER = 0xffffffffu;
+static const uint32_t IDLE = 60000; // nothing needs the network
+
+static PowerConfig testConfig() {
+    //                       sample  uplink   deep sleep
+    PowerConfig c = {{{60000,  900000,  false},    // normal
+                      {120000, 3600000, false},    // saver
+                      {300000, 14400000, true}},   // critical
+                     30, 10, 5,                    // saver below, critical below, hysteresis (%)
+                     100,                          // backlog high (samples)
+                     500, 20000,                   // window min/max
+                     10000, 30000, 200};           // radio off min, deep sleep min, wake lead
+    return c;
+}
+
+// Typical draw of an ESP32 module in each mode, µA.
+static const PowerCurrents esp32Currents = {{110000, 20000, 800, 10}};
+
+void setUp(void) { fakeNow = 1000; }
+void tearDown(void) {}
+
+void test_first_window_opens_at_once_and_closes_after_the_hold() {
+    PowerManager pm(testConfig(), fakeMillis);
+    TEST_ASSERT_EQUAL(POWER_MODEM_SLEEP, pm.plan(0, 60000).mode);
+    TEST_ASSERT_TRUE(pm.radioWanted());
+    TEST_ASSERT_EQUAL_UINT32(1, pm.stats().windows);
+
+    fakeNow += 300;
+    pm.setOnline(true);
+    fakeNow += 100;
+    // Online but the jobs ran only just now; queued commands get windowMinMs
+    TEST_ASSERT_EQUAL(POWER_MODEM_SLEEP, pm.plan(IDLE, 59600).mode);
+    fakeNow += 300;
+    TEST_ASSERT_EQUAL(POWER_MODEM_SLEEP, pm.plan(IDLE, 59300).mode);
+    fakeNow += 100;
+    PowerPlan plan = pm.plan(IDLE, 59200);
+    TEST_ASSERT_EQUAL(POWER_LIGHT_SLEEP, plan.mode);
+    TEST_ASSERT_EQUAL_UINT32(59200, plan.sleepMs); // the next sample comes first
+    TEST_ASSERT_FALSE(pm.radioWanted());
+    TEST_ASSERT_EQUAL_UINT32(900000 - 800, pm.msUntilWindow());
+    TEST_ASSERT_EQUAL_UINT32(800, (uint32_t)pm.stats().modeMs[POWER_MODEM_SLEEP]);
+    TEST_ASSERT_EQUAL_UINT32(1000, (uint32_t)pm.stats().modeMs[POWER_AWAKE]); // booting
+}
+
+void test_radio_jobs_wait_for_the_next_window() {
+    PowerManager pm(testConfig(), fakeMillis);
+    pm.plan(0, 60000);
+    pm.setOnline(true);
+    fakeNow += 600;
+    pm.plan(IDLE, 60000);
+    pm.setOnline(false);
+
+    // A heartbeat due now is held back until the window
+    fakeNow += 60000;
+    PowerPlan plan = pm.plan(0, 60000);
+    TEST_ASSERT_EQUAL(POWER_LIGHT_SLEEP, plan.mode);
+    TEST_ASSERT_FALSE(pm.radioWanted());
+    fakeNow += 900000 - 60600;
+    TEST_ASSERT_EQUAL(POWER_MODEM_SLEEP, pm.plan(0, 0).mode);
+    TEST_ASSERT_EQUAL_UINT32(2, pm.stats().windows);
+}
+
+void test_urgent_work_opens_a_window() {
+    PowerManager pm(testConfig(), fakeMillis);
+    pm.plan(0, 60000);
+    pm.setOnline(true);
+    fakeNow += 600;
+    pm.plan(IDLE, 60000);
+    pm.setOnline(false);
+    fakeNow += 5000;
+    pm.requestWindow(); // alarm
+    TEST_ASSERT_EQUAL(POWER_MODEM_SLEEP, pm.plan(0, 55000).mode);
+    TEST_ASSERT_TRUE(pm.radioWanted());
+    TEST_ASSERT_EQUAL_UINT32(2, pm.stats().windows);
+}
+
+void test_short_gaps_keep_the_radio_associated() {
+    PowerConfig c = testConfig();
+    c.profiles[POWER_NORMAL].uplinkIntervalMs = 8000; // below radioOffMinMs
+    PowerManager pm(c, fakeMillis);
+    pm.plan(0, 5000);
+    pm.setOnline(true);
+    fakeNow += 2000;
+    TEST_ASSERT_EQUAL(POWER_MODEM_SLEEP, pm.plan(IDLE, 3000).mode);
+    TEST_ASSERT_TRUE(pm.radioWanted());
+
+    // An uplink interval of 0 means always associated
+    c.profiles[POWER_NORMAL].uplinkIntervalMs = 0;
+    PowerManager always(c, fakeMillis);
+    TEST_ASSERT_EQUAL(POWER_MODEM_SLEEP, always.plan(IDLE, 3000).mode);
+    TEST_ASSERT_TRUE(always.radioWanted());
+    TEST_ASSERT_EQUAL_UINT32(0, always.stats().windows);
+}
+
+void test_offline_window_gives_up() {
+    PowerManager pm(testConfig(), fakeMillis);
+    pm.plan(0, 60000);
+    fakeNow += 19000;
+    TEST_ASSERT_EQUAL(POWER_MODEM_SLEEP, pm.plan(0, 41000).mode);
+    fakeNow += 1000;
+    // The jobs are still due, but the AP is gone; try again next window
+    TEST_ASSERT_EQUAL(POWER_LIGHT_SLEEP, pm.plan(0, 40000).mode);
+    TEST_ASSERT_FALSE(pm.radioWanted());
+}
+
+void test_busy_keeps_everything_awake() {
+    PowerManager pm(testConfig(), fakeMillis);
+    pm.plan(0, 60000);
+    pm.setOnline(true);
+    pm.setBusy(true); // OTA download
+    fakeNow += 30000;
+    TEST_ASSERT_EQUAL(POWER_AWAKE, pm.plan(IDLE, 30000).mode);
+    TEST_ASSERT_TRUE(pm.radioWanted());
+    fakeNow += 30000;
+    pm.setBusy(false);
+    TEST_ASSERT_EQUAL(POWER_LIGHT_SLEEP, pm.plan(IDLE, 60000).mode);
+    TEST_ASSERT_EQUAL_UINT32(1000 + 30000, (uint32_t)pm.stats().modeMs[POWER_AWAKE]);
+}
+
+void test_battery_picks_the_profile_with_hysteresis() {
+    PowerManager pm(testConfig(), fakeMillis);
+    pm.setBattery(-1);
+    TEST_ASSERT_EQUAL(POWER_NORMAL, pm.profile());
+    pm.setBattery(29);
+    TEST_ASSERT_EQUAL(POWER_SAVER, pm.profile());
+    TEST_ASSERT_EQUAL_UINT32(120000, pm.sampleIntervalMs());
+    TEST_ASSERT_EQUAL_UINT32(3600000, pm.uplinkIntervalMs());
+    pm.setBattery(9);
+    TEST_ASSERT_EQUAL(POWER_CRITICAL, pm.profile());
+
+    // Recovering needs the hysteresis on top of the threshold
+    pm.setBattery(12);
+    TEST_ASSERT_EQUAL(POWER_CRITICAL, pm.profile());
+    pm.setBattery(15);
+    TEST_ASSERT_EQUAL(POWER_SAVER, pm.profile());
+    pm.setBattery(33);
+    TEST_ASSERT_EQUAL(POWER_SAVER, pm.profile());
+    pm.setBattery(36);
+    TEST_ASSERT_EQUAL(POWER_NORMAL, pm.profile());
+    // Charging from critical straight past both thresholds
+    pm.setBattery(5);
+    pm.setBattery(80);
+    TEST_ASSERT_EQUAL(POWER_NORMAL, pm.profile());
+    TEST_ASSERT_EQUAL_UINT32(6, pm.stats().profileChanges);
+}
+
+void test_battery_percent_from_voltage() {
+    TEST_ASSERT_EQUAL(0, batteryPercent(3100, 3300, 4150));
+    TEST_ASSERT_EQUAL(50, batteryPercent(3725, 3300, 4150));
+    TEST_ASSERT_EQUAL(100, batteryPercent(4200, 3300, 4150));
+}
+
+void test_backlog_drains_at_the_normal_interval() {
+    PowerManager pm(testConfig(), fakeMillis);
+    pm.setBattery(20);
+    TEST_ASSERT_EQUAL_UINT32(3600000, pm.uplinkIntervalMs());
+    pm.setBacklog(150);
+    TEST_ASSERT_EQUAL_UINT32(900000, pm.uplinkIntervalMs());
+    pm.setBacklog(10);
+    TEST_ASSERT_EQUAL_UINT32(3600000, pm.uplinkIntervalMs());
+
+    // An empty battery does not pay for draining
+    pm.setBattery(5);
+    pm.setBacklog(150);
+    TEST_ASSERT_EQUAL_UINT32(14400000, pm.uplinkIntervalMs());
+}
+
+void test_deep_sleep_only_for_long_gaps_in_its_profile() {
+    PowerManager pm(testConfig(), fakeMillis);
+    pm.setBattery(5);
+    pm.plan(0, 300000);
+    pm.setOnline(true);
+    fakeNow += 600;
+    PowerPlan plan = pm.plan(IDLE, 299400);
+    TEST_ASSERT_EQUAL(POWER_DEEP_SLEEP, plan.mode);
+    TEST_ASSERT_EQUAL_UINT32(299400 - 200, plan.sleepMs);
+    // A sample due soon is waited for in light sleep
+    TEST_ASSERT_EQUAL(POWER_LIGHT_SLEEP, pm.plan(IDLE, 20000).mode);
+
+    pm.setBattery(50);
+    TEST_ASSERT_EQUAL(POWER_LIGHT_SLEEP, pm.plan(IDLE, 60000).mode);
+}
+
+void test_deep_sleep_round_trip_through_rtc_memory() {
+    PowerManager pm(testConfig(), fakeMillis);
+    pm.setBattery(5);
+    pm.plan(0, 300000);
+    pm.setOnline(true);
+    fakeNow += 600;
+    pm.reportSent();
+    PowerPlan plan = pm.plan(IDLE, 299400);
+    TEST_ASSERT_EQUAL(POWER_DEEP_SLEEP, plan.mode);
+
+    static RtcState rtc;
+    memset(&rtc, 0xa5, sizeof(rtc)); // what a power cycle leaves behind
+    TEST_ASSERT_FALSE(rtcStateValid(rtc));
+    rtcStateClear(rtc);
+    TEST_ASSERT_TRUE(rtcStateValid(rtc));
+    rtc.power = pm.save(plan.sleepMs);
+    SensorSample s = makeSample(1700000000, 21.5f, 40.0f, 300.0f);
+    TEST_ASSERT_TRUE(rtcPushSample(rtc, s));
+    rtcStateSeal(rtc);
+    TEST_ASSERT_TRUE(rtcStateValid(rtc));
+
+    // Boot after the sleep: millis() starts over
+    fakeNow = 150;
+    TEST_ASSERT_TRUE(rtcStateValid(rtc));
+    PowerManager woken(testConfig(), fakeMillis);
+    woken.restore(rtc.power);
+    TEST_ASSERT_EQUAL(POWER_CRITICAL, woken.profile());
+    TEST_ASSERT_EQUAL_UINT32(1, woken.stats().windows);
+    TEST_ASSERT_EQUAL_UINT32(1, woken.stats().deepSleeps);
+    TEST_ASSERT_EQUAL_UINT32(1, woken.stats().reports);
+    TEST_ASSERT_EQUAL_UINT32(plan.sleepMs, (uint32_t)woken.stats().modeMs[POWER_DEEP_SLEEP]);
+    TEST_ASSERT_EQUAL_UINT32(14400000 - 600 - plan.sleepMs, woken.msUntilWindow());
+    // Not due yet, so it goes straight back to sleep
+    TEST_ASSERT_EQUAL(POWER_DEEP_SLEEP, woken.plan(0, 300000).mode);
+
+    TEST_ASSERT_EQUAL(1, rtc.sampleCount);
+    TEST_ASSERT_EQUAL_UINT32(1700000000, rtc.samples[0].timestamp);
+    rtc.samples[0].tempC100++;
+    TEST_ASSERT_FALSE(rtcStateValid(rtc));
+}
+
+void test_rtc_sample_buffer_is_bounded() {
+    static RtcState rtc;
+    rtcStateClear(rtc);
+    SensorSample s = makeSample(1, 20.0f, 50.0f, 100.0f);
+    for (int i = 0; i < RTC_SAMPLE_CAPACITY; i++) TEST_ASSERT_TRUE(rtcPushSample(rtc, s));
+    TEST_ASSERT_FALSE(rtcPushSample(rtc, s));
+    rtcStateSeal(rtc);
+    TEST_ASSERT_TRUE(rtcStateValid(rtc));
+}
+
+// A device on the simulated clock: one reading per sample interval, a batch
+// and a heartbeat per window, 300 ms to associate and 200 ms to send.
+struct SimDevice {
+    PowerManager& pm;
+    uint32_t nextSample;
+    uint32_t connectAt;
+    bool online;
+    uint32_t pending;
+
+    explicit SimDevice(PowerManager& p) : pm(p), nextSample(fakeNow), connectAt(NEVER), online(false), pending(0) {}
+
+    void run(uint32_t end) {
+        while ((int32_t)(end - fakeNow) > 0) {
+            if (pm.radioWanted() && !online && connectAt == NEVER) connectAt = fakeNow + 300;
+            if (!pm.radioWanted() && (online || connectAt != NEVER)) {
+                online = false;
+                connectAt = NEVER;
+                pm.setOnline(false);
+            }
+            if (connectAt != NEVER && (int32_t)(fakeNow - connectAt) >= 0) {
+                connectAt = NEVER;
+                online = true;
+                pm.setOnline(true);
+            }
+            if (online && pending) {
+                fakeNow += 200;
+                pending = 0;
+                pm.reportSent(); // sensor batch
+                pm.reportSent(); // heartbeat
+            }
+            if ((int32_t)(fakeNow - nextSample) >= 0) {
+                pending++;
+                nextSample += pm.sampleIntervalMs();
+            }
+            PowerPlan plan = pm.plan(pending ? 0 : IDLE, nextSample - fakeNow);
+            uint32_t step = 100; // polling while the radio is up
+            if (plan.mode == POWER_LIGHT_SLEEP || plan.mode == POWER_DEEP_SLEEP) {
+                step = plan.sleepMs + (plan.mode == POWER_DEEP_SLEEP ? 200 : 0);
+            }
+            if (connectAt != NEVER && connectAt - fakeNow < step) step = connectAt - fakeNow;
+            fakeNow += step ? step : 1;
+        }
+    }
+};
+
+void test_power_budget_for_a_simulated_day() {
+    const uint32_t day = 86400000;
+    PowerManager cycled(testConfig(), fakeMillis);
+    SimDevice device(cycled);
+    device.run(fakeNow + day);
+    const PowerStats& st = cycled.stats();
+    uint32_t perReport = powerRadioMsPerReport(st);
+    uint32_t avg = powerAverageMicroamps(st, esp32Currents);
+    printf("[POWER] duty cycled: %u windows, %u reports, %u ms radio/report, %u uA average\n", (unsigned)st.windows,
+           (unsigned)st.reports, (unsigned)perReport, (unsigned)avg);
+    TEST_ASSERT_EQUAL_UINT32(96, st.windows);
+    TEST_ASSERT_EQUAL_UINT32(192, st.reports);
+    // Association, the send and the command hold, shared by two reports
+    TEST_ASSERT_TRUE(perReport < 600);
+    TEST_ASSERT_TRUE(avg < 1500);
+
+    // The same day with the radio always associated
+    PowerConfig c = testConfig();
+    c.profiles[POWER_NORMAL].uplinkIntervalMs = 0;
+    fakeNow = 1000;
+    PowerManager always(c, fakeMillis);
+    SimDevice flat(always);
+    flat.run(fakeNow + day);
+    uint32_t flatAvg = powerAverageMicroamps(always.stats(), esp32Currents);
+    printf("[POWER] always on: %u ms radio/report, %u uA average\n", (unsigned)powerRadioMsPerReport(always.stats()),
+           (unsigned)flatAvg);
+    TEST_ASSERT_TRUE(flatAvg > 10 * avg);
+
+    // Critical battery: deep sleep between samples
+    fakeNow = 1000;
+    PowerManager low(testConfig(), fakeMillis);
+    low.setBattery(5);
+    SimDevice sleeper(low);
+    sleeper.run(fakeNow + day);
+    uint32_t lowAvg = powerAverageMicroamps(low.stats(), esp32Currents);
+    printf("[POWER] critical: %u windows, %u uA average\n", (unsigned)low.stats().windows, (unsigned)lowAvg);
+    TEST_ASSERT_EQUAL_UINT32(6, low.stats().windows);
+    TEST_ASSERT_TRUE(lowAvg < avg);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_first_window_opens_at_once_and_closes_after_the_hold);
+    RUN_TEST(test_radio_jobs_wait_for_the_next_window);
+    RUN_TEST(test_urgent_work_opens_a_window);
+    RUN_TEST(test_short_gaps_keep_the_radio_associated);
+    RUN_TEST(test_offline_window_gives_up);
+    RUN_TEST(test_busy_keeps_everything_awake);
+    RUN_TEST(test_battery_picks_the_profile_with_hysteresis);
+    RUN_TEST(test_battery_percent_from_voltage);
+    RUN_TEST(test_backlog_drains_at_the_normal_interval);
+    RUN_TEST(test_deep_sleep_only_for_long_gaps_in_its_profile);
+    RUN_TEST(test_deep_sleep_round_trip_through_rtc_memory);
+    RUN_TEST(test_rtc_sample_buffer_is_bounded);
+    RUN_TEST(test_power_budget_for_a_simulated_day);
+    return UNITY_END();
+}
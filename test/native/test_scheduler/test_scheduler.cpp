@@ -0,0 +1,346 @@
+#include <unity.h>
+#include <string>
+#include <vector>
+#include "net_scheduler.h"
+
+static uint32_t fakeNow = 0;
+static uint32_t fakeMillis() { return fakeNow; }
+static uint32_t rngState = 1;
+static uint32_t fakeRandom(uint32_t bound) {
+    rngState = rngState * 1103515245u + 12345u;
+    return (rngState >> 8) % bound;
+}
+
+// Records which job ran when; optionally fails a number of times first.
+struct Probe {
+    Probe(const char* n, std::vector<std::string>* l) : name(n), log(l) {}
+    const char* name;
+    std::vector<std::string>* log;
+    std::vector<uint32_t> times;
+    int failuresLeft = 0;
+    uint32_t busyMs = 0; // simulated time the job takes
+};
+
+static JobResult probeJob(void* ctx) {
+    Probe* p = static_cast<Probe*>(ctx);
+    p->times.push_back(fakeNow);
+    if (p->log) p->log->push_back(p->name);
+    fakeNow += p->busyMs;
+    if (p->failuresLeft > 0) {
+        p->failuresLeft--;
+        return JOB_RETRY;
+    }
+    return JOB_DONE;
+}
+
+static JobSpec spec(Probe& p, uint32_t period, uint8_t priority, bool radio) {
+    JobSpec s = {p.name, probeJob, &p, period, 0, 0, priority, radio, 1000, 8000};
+    return s;
+}
+
+// The network task: sleep until the next deadline, then run what is due.
+static void runUntil(NetScheduler& sched, uint32_t end) {
+    for (;;) {
+        uint32_t sleep = sched.runDue();
+        if ((int32_t)(end - fakeNow) < (int32_t)sleep) break;
+        fakeNow += sleep;
+    }
+    fakeNow = end;
+}
+
+void setUp(void) {
+    fakeNow = 5000;
+    rngState = 1;
+}
+void tearDown(void) {}
+
+void test_periodic_and_triggered_jobs() {
+    NetScheduler sched(fakeMillis, NULL, 0);
+    Probe tick("tick", NULL);
+    Probe flush("flush", NULL);
+    int t = sched.add(spec(tick, 10000, 1, false), 10000);
+    int f = sched.add(spec(flush, 0, 1, true), 0);
+    TEST_ASSERT_TRUE(t >= 0 && f >= 0);
+
+    runUntil(sched, fakeNow + 60000);
+    TEST_ASSERT_EQUAL(6, tick.times.size());
+    TEST_ASSERT_EQUAL(15000, tick.times[0]);
+    TEST_ASSERT_EQUAL(65000, tick.times[5]);
+    TEST_ASSERT_EQUAL(0, flush.times.size());
+
+    sched.trigger(f);
+    TEST_ASSERT_EQUAL(0, sched.msUntilNext());
+    sched.runDue();
+    TEST_ASSERT_EQUAL(1, flush.times.size());
+    runUntil(sched, fakeNow + 60000);
+    TEST_ASSERT_EQUAL(1, flush.times.size());
+}
+
+void test_trigger_in_keeps_the_earlier_deadline() {
+    NetScheduler sched(fakeMillis, NULL, 0);
+    Probe replay("replay", NULL);
+    int id = sched.add(spec(replay, 0, 3, true), 0);
+    sched.triggerIn(id, 5000);
+    TEST_ASSERT_EQUAL(5000, sched.msUntilNext());
+    sched.triggerIn(id, 8000);
+    TEST_ASSERT_EQUAL(5000, sched.msUntilNext());
+    sched.triggerIn(id, 1000);
+    TEST_ASSERT_EQUAL(1000, sched.msUntilNext());
+    runUntil(sched, fakeNow + 10000);
+    TEST_ASSERT_EQUAL(1, replay.times.size());
+}
+
+// A job that re-arms itself from its own run, like the flash replay or the
+// health gate poll, until it has nothing left to do.
+struct SelfRearm {
+    NetScheduler* sched;
+    int id;
+    uint32_t delayMs;
+    int runsLeft;
+    JobResult result;
+    std::vector<uint32_t> times;
+};
+
+static JobResult selfRearmJob(void* ctx) {
+    SelfRearm* r = static_cast<SelfRearm*>(ctx);
+    r->times.push_back(fakeNow);
+    if (--r->runsLeft > 0) r->sched->triggerIn(r->id, r->delayMs);
+    return r->result;
+}
+
+void test_trigger_in_from_the_job_itself() {
+    NetScheduler sched(fakeMillis, NULL, 0);
+    SelfRearm r = {&sched, -1, 2000, 100, JOB_DONE, {}};
+    JobSpec s = {"replay", selfRearmJob, &r, 0, 0, 0, 3, true, 1000, 8000};
+    r.id = sched.add(s, 0);
+    sched.trigger(r.id);
+    runUntil(sched, fakeNow + 20000);
+    TEST_ASSERT_EQUAL(11, r.times.size());
+    for (size_t i = 1; i < r.times.size(); i++) TEST_ASSERT_EQUAL(2000, r.times[i] - r.times[i - 1]);
+
+    // Once it stops re-arming it waits for the next trigger
+    r.runsLeft = 1;
+    runUntil(sched, fakeNow + 20000);
+    TEST_ASSERT_EQUAL(12, r.times.size());
+    runUntil(sched, fakeNow + 60000);
+    TEST_ASSERT_EQUAL(12, r.times.size());
+
+    // A periodic job pulls its next run forward; a failed run backs off instead
+    NetScheduler periodic(fakeMillis, NULL, 0);
+    SelfRearm p = {&periodic, -1, 1000, 3, JOB_DONE, {}};
+    JobSpec ps = {"poll", selfRearmJob, &p, 10000, 0, 0, 3, false, 5000, 8000};
+    p.id = periodic.add(ps, 10000);
+    uint32_t start = fakeNow;
+    runUntil(periodic, start + 25000);
+    TEST_ASSERT_EQUAL(4, p.times.size());
+    TEST_ASSERT_EQUAL(start + 10000, p.times[0]);
+    TEST_ASSERT_EQUAL(start + 11000, p.times[1]);
+    TEST_ASSERT_EQUAL(start + 12000, p.times[2]);
+    TEST_ASSERT_EQUAL(start + 22000, p.times[3]);
+
+    p.runsLeft = 2;
+    p.result = JOB_RETRY;
+    runUntil(periodic, fakeNow + 40000);
+    TEST_ASSERT_TRUE(p.times.size() >= 6);
+    TEST_ASSERT_EQUAL(5000, p.times[5] - p.times[4]);
+}
+
+void test_priority_order_within_a_wake() {
+    NetScheduler sched(fakeMillis, NULL, 0);
+    std::vector<std::string> log;
+    Probe low("ota", &log);
+    Probe mid("heartbeat", &log);
+    Probe high("sensor", &log);
+    sched.add(spec(low, 1000, 1, true), 1000);
+    sched.add(spec(mid, 1000, 5, true), 1000);
+    sched.add(spec(high, 1000, 9, true), 1000);
+    fakeNow += 1000;
+    sched.runDue();
+    TEST_ASSERT_EQUAL(3, log.size());
+    TEST_ASSERT_EQUAL_STRING("sensor", log[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("heartbeat", log[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("ota", log[2].c_str());
+}
+
+void test_coalescing_reduces_radio_wakes() {
+    // Heartbeat every 60 s, OTA check every 300 s, sensor flush every 150 s,
+    // all slightly out of phase as they would be after boot.
+    uint32_t plain = 0, coalesced = 0;
+    for (int pass = 0; pass < 2; pass++) {
+        fakeNow = 5000;
+        NetScheduler sched(fakeMillis, NULL, pass ? 20000 : 0);
+        Probe hb("heartbeat", NULL), ota("ota", NULL), flush("flush", NULL);
+        JobSpec h = spec(hb, 60000, 5, true);
+        JobSpec o = spec(ota, 300000, 1, true);
+        JobSpec f = spec(flush, 150000, 9, true);
+        if (pass) h.slackMs = o.slackMs = 15000;
+        sched.add(h, 60000);
+        sched.add(o, 298000);
+        sched.add(f, 143000);
+        runUntil(sched, fakeNow + 3600000);
+        // Nothing is dropped: every job still runs at least as often as before.
+        TEST_ASSERT_TRUE(hb.times.size() >= 60);
+        TEST_ASSERT_TRUE(ota.times.size() >= 12);
+        TEST_ASSERT_TRUE(flush.times.size() >= 24);
+        (pass ? coalesced : plain) = sched.stats().radioWakes;
+        if (pass) TEST_ASSERT_TRUE(sched.stats().coalesced > 0);
+    }
+    TEST_ASSERT_EQUAL(60 + 12 + 24, plain);
+    TEST_ASSERT_TRUE_MESSAGE(coalesced <= 62, std::to_string(coalesced).c_str());
+}
+
+void test_slack_waits_for_a_shared_wake() {
+    NetScheduler sched(fakeMillis, NULL, 1000);
+    Probe hb("heartbeat", NULL), flush("flush", NULL);
+    JobSpec h = spec(hb, 60000, 5, true);
+    h.slackMs = 10000;
+    sched.add(h, 10000);
+    sched.add(spec(flush, 60000, 9, true), 18000);
+    // The heartbeat is due at +10 s but may wait until the flush at +18 s.
+    TEST_ASSERT_EQUAL(18000, sched.msUntilNext());
+    fakeNow += 18000;
+    sched.runDue();
+    TEST_ASSERT_EQUAL(1, hb.times.size());
+    TEST_ASSERT_EQUAL(1, flush.times.size());
+    TEST_ASSERT_EQUAL(1, sched.stats().radioWakes);
+}
+
+void test_retry_backoff_is_exponential_and_capped() {
+    NetScheduler sched(fakeMillis, NULL, 0);
+    Probe p("mqtt", NULL);
+    p.failuresLeft = 5;
+    int id = sched.add(spec(p, 60000, 1, true), 0);
+    sched.trigger(id);
+    runUntil(sched, fakeNow + 30000);
+    // Attempts at 0, +1 s, +2 s, +4 s, +8 s, +8 s (capped), then success.
+    TEST_ASSERT_EQUAL(6, p.times.size());
+    uint32_t expected[] = {1000, 2000, 4000, 8000, 8000};
+    for (int i = 0; i < 5; i++) TEST_ASSERT_EQUAL(expected[i], p.times[i + 1] - p.times[i]);
+    TEST_ASSERT_EQUAL(5, sched.jobStats(id).retries);
+    TEST_ASSERT_EQUAL(0, sched.jobStats(id).failStreak);
+}
+
+void test_retry_backoff_is_full_jitter() {
+    NetScheduler sched(fakeMillis, fakeRandom, 0);
+    Probe p("http", NULL);
+    p.failuresLeft = 1000;
+    JobSpec s = spec(p, 0, 1, true);
+    s.retryBaseMs = 8000; // ceiling stays 8 s from the first retry
+    int id = sched.add(s, 0);
+    sched.trigger(id);
+    runUntil(sched, fakeNow + 2000000);
+    uint32_t lo = UINT32_MAX, hi = 0;
+    for (size_t i = 1; i < p.times.size(); i++) {
+        uint32_t gap = p.times[i] - p.times[i - 1];
+        TEST_ASSERT_TRUE(gap <= 8000);
+        if (gap < lo) lo = gap;
+        if (gap > hi) hi = gap;
+    }
+    // Anywhere in the window, so a fleet that failed together spreads out
+    TEST_ASSERT_TRUE(lo < 1000);
+    TEST_ASSERT_TRUE(hi > 7000);
+}
+
+void test_hold_off_sets_a_floor_for_one_retry() {
+    NetScheduler sched(fakeMillis, NULL, 0);
+    Probe p("heartbeat", NULL);
+    p.failuresLeft = 2;
+    int id = sched.add(spec(p, 60000, 1, true), 0);
+    sched.trigger(id);
+    sched.holdOff(id, 30000); // e.g. an open circuit
+    sched.holdOff(id, 5000);  // the longest hold wins
+    sched.runDue();
+    TEST_ASSERT_EQUAL_UINT32(30000, sched.msUntilNext());
+    fakeNow += 30000;
+    sched.runDue();
+    // Used once: the next failure is back to the plain backoff
+    TEST_ASSERT_EQUAL_UINT32(2000, sched.msUntilNext());
+}
+
+void test_retry_does_not_block_other_jobs() {
+    NetScheduler sched(fakeMillis, NULL, 0);
+    Probe failing("http", NULL);
+    failing.failuresLeft = 100;
+    Probe sample("sample", NULL);
+    sched.add(spec(failing, 10000, 9, true), 1);
+    sched.add(spec(sample, 1000, 1, false), 1000);
+    runUntil(sched, fakeNow + 20000);
+    TEST_ASSERT_EQUAL(20, sample.times.size());
+    for (size_t i = 1; i < sample.times.size(); i++) TEST_ASSERT_EQUAL(1000, sample.times[i] - sample.times[i - 1]);
+}
+
+void test_radio_jobs_wait_for_network() {
+    NetScheduler sched(fakeMillis, NULL, 5000);
+    Probe hb("heartbeat", NULL), ota("ota", NULL), sample("sample", NULL);
+    sched.add(spec(hb, 60000, 5, true), 60000);
+    sched.add(spec(ota, 300000, 1, true), 300000);
+    sched.add(spec(sample, 5000, 9, false), 5000);
+    TEST_ASSERT_EQUAL_UINT32(60000, sched.msUntilRadio());
+    sched.setRadioAvailable(false);
+    TEST_ASSERT_EQUAL_UINT32(5000, sched.msUntilNext());
+    TEST_ASSERT_EQUAL_UINT32(60000, sched.msUntilRadio()); // still reported while the radio is off
+    runUntil(sched, fakeNow + 400000);
+    TEST_ASSERT_EQUAL_UINT32(0, sched.msUntilRadio());
+    TEST_ASSERT_EQUAL(0, hb.times.size());
+    TEST_ASSERT_EQUAL(0, ota.times.size());
+    TEST_ASSERT_EQUAL(80, sample.times.size());
+
+    // Back online: both overdue jobs share one wake, and cadence restarts from now.
+    sched.setRadioAvailable(true);
+    uint32_t wakes = sched.stats().radioWakes;
+    sched.runDue();
+    TEST_ASSERT_EQUAL(1, hb.times.size());
+    TEST_ASSERT_EQUAL(1, ota.times.size());
+    TEST_ASSERT_EQUAL(wakes + 1, sched.stats().radioWakes);
+    TEST_ASSERT_EQUAL(fakeNow + 60000, sched.dueAt(0));
+}
+
+void test_jitter_spreads_deadlines() {
+    NetScheduler sched(fakeMillis, fakeRandom, 0);
+    Probe a("a", NULL);
+    JobSpec s = spec(a, 60000, 1, true);
+    s.jitterMs = 10000;
+    int id = sched.add(s, 0);
+    uint32_t first = sched.dueAt(id);
+    TEST_ASSERT_TRUE(first >= fakeNow && first < fakeNow + 10000);
+    runUntil(sched, fakeNow + 3600000);
+    bool varied = false;
+    for (size_t i = 1; i < a.times.size(); i++) {
+        uint32_t gap = a.times[i] - a.times[i - 1];
+        TEST_ASSERT_TRUE(gap >= 60000 && gap < 70000);
+        if (gap != a.times[1] - a.times[0]) varied = true;
+    }
+    TEST_ASSERT_TRUE(varied);
+}
+
+void test_clock_wraparound_and_full_table() {
+    fakeNow = 0xFFFFF000u;
+    NetScheduler sched(fakeMillis, NULL, 0);
+    Probe p("wrap", NULL);
+    sched.add(spec(p, 10000, 1, false), 10000);
+    runUntil(sched, fakeNow + 35000);
+    TEST_ASSERT_EQUAL(3, p.times.size());
+    TEST_ASSERT_EQUAL(10000, p.times[1] - p.times[0]);
+
+    Probe filler("x", NULL);
+    while (sched.add(spec(filler, 1000, 1, false), 1000) >= 0) {}
+    TEST_ASSERT_EQUAL(-1, sched.add(spec(filler, 1000, 1, false), 1000));
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_periodic_and_triggered_jobs);
+    RUN_TEST(test_trigger_in_keeps_the_earlier_deadline);
+    RUN_TEST(test_trigger_in_from_the_job_itself);
+    RUN_TEST(test_priority_order_within_a_wake);
+    RUN_TEST(test_coalescing_reduces_radio_wakes);
+    RUN_TEST(test_slack_waits_for_a_shared_wake);
+    RUN_TEST(test_retry_backoff_is_exponential_and_capped);
+    RUN_TEST(test_retry_backoff_is_full_jitter);
+    RUN_TEST(test_hold_off_sets_a_floor_for_one_retry);
+    RUN_TEST(test_retry_does_not_block_other_jobs);
+    RUN_TEST(test_radio_jobs_wait_for_network);
+    RUN_TEST(test_jitter_spreads_deadlines);
+    RUN_TEST(test_clock_wraparound_and_full_table);
+    return UNITY_END();
+}
@@ -0,0 +1,168 @@
+#include <unity.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "sensor_sample.h"
+#include "spsc_ring.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Every field is derived from the sequence number so a torn copy shows up.
+static SensorSample seqSample(uint32_t seq) {
+    SensorSample s;
+    s.timestamp = seq;
+    s.tempC100 = (int16_t)(seq * 7);
+    s.humidityC100 = (uint16_t)(seq * 13);
+    s.lightC10 = ~seq;
+    return s;
+}
+
+static bool consistent(const SensorSample& s) {
+    return s.tempC100 == (int16_t)(s.timestamp * 7) && s.humidityC100 == (uint16_t)(s.timestamp * 13) &&
+           s.lightC10 == ~s.timestamp;
+}
+
+void test_fifo_order_and_overflow() {
+    SensorSample buf[4];
+    SpscRing<SensorSample> ring(buf, 4);
+    TEST_ASSERT_EQUAL(4, ring.capacity());
+    for (uint32_t i = 0; i < 6; i++) ring.push(seqSample(i));
+    // The newest items are dropped, the queued ones are untouched
+    TEST_ASSERT_EQUAL(4, ring.size());
+    TEST_ASSERT_EQUAL_UINT32(2, ring.overflows());
+    TEST_ASSERT_EQUAL_UINT32(4, ring.highWater());
+
+    SensorSample s;
+    for (uint32_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(ring.pop(s));
+        TEST_ASSERT_EQUAL_UINT32(i, s.timestamp);
+    }
+    TEST_ASSERT_FALSE(ring.pop(s));
+
+    // Wraps around the storage
+    for (uint32_t i = 10; i < 13; i++) TEST_ASSERT_TRUE(ring.push(seqSample(i)));
+    SensorSample out[8];
+    TEST_ASSERT_EQUAL(3, ring.drain(out, 8));
+    TEST_ASSERT_EQUAL_UINT32(10, out[0].timestamp);
+    TEST_ASSERT_EQUAL_UINT32(12, out[2].timestamp);
+    TEST_ASSERT_EQUAL(0, ring.size());
+}
+
+void test_drain_respects_max() {
+    uint32_t buf[8];
+    SpscRing<uint32_t> ring(buf, 8);
+    for (uint32_t i = 0; i < 5; i++) ring.push(i);
+    uint32_t out[2];
+    TEST_ASSERT_EQUAL(2, ring.drain(out, 2));
+    TEST_ASSERT_EQUAL_UINT32(1, out[1]);
+    TEST_ASSERT_EQUAL(3, ring.size());
+}
+
+void test_rejects_capacity_that_is_not_a_power_of_two() {
+    uint32_t buf[6];
+    SpscRing<uint32_t> ring(buf, 6);
+    TEST_ASSERT_EQUAL(0, ring.capacity());
+    TEST_ASSERT_FALSE(ring.push(1));
+    uint32_t v;
+    TEST_ASSERT_FALSE(ring.pop(v));
+    TEST_ASSERT_EQUAL_UINT32(1, ring.overflows());
+}
+
+// Real threads: every item arrives once, in order, intact, or is counted
+// as an overflow.
+void test_threaded_producer_consumer() {
+    const uint32_t N = 2000000;
+    static SensorSample buf[64];
+    SpscRing<SensorSample> ring(buf, 64);
+    uint32_t received = 0, outOfOrder = 0, torn = 0;
+    std::atomic<bool> producerDone(false);
+
+    std::thread consumer([&]() {
+        SensorSample s;
+        uint32_t last = 0;
+        for (;;) {
+            // Checked before draining so nothing pushed earlier is missed
+            bool finished = producerDone.load();
+            while (ring.pop(s)) {
+                if (!consistent(s)) torn++;
+                if (received && s.timestamp <= last) outOfOrder++;
+                last = s.timestamp;
+                received++;
+            }
+            if (finished) break;
+        }
+    });
+    for (uint32_t i = 0; i < N; i++) ring.push(seqSample(i));
+    producerDone.store(true);
+    consumer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(N, received + ring.overflows());
+    TEST_ASSERT_TRUE(received > 0);
+}
+
+// One producer fans out to a fast and a slow consumer; the slow one only
+// loses its own items and never holds the producer back.
+void test_fan_out_to_consumers_at_different_paces() {
+    const uint32_t N = 200000;
+    static SensorSample fastBuf[256], slowBuf[256];
+    SpscRing<SensorSample> fast(fastBuf, 256);
+    SpscRing<SensorSample> slow(slowBuf, 256);
+    std::atomic<bool> producerDone(false);
+    uint32_t fastGot = 0, slowGot = 0, outOfOrder = 0, torn = 0;
+
+    std::thread fastConsumer([&]() {
+        SensorSample s;
+        uint32_t last = 0;
+        for (;;) {
+            bool finished = producerDone.load();
+            while (fast.pop(s)) {
+                if (fastGot && s.timestamp <= last) outOfOrder++;
+                last = s.timestamp;
+                fastGot++;
+            }
+            if (finished) break;
+        }
+    });
+    std::thread slowConsumer([&]() {
+        SensorSample batch[32];
+        for (;;) {
+            bool finished = producerDone.load();
+            size_t n;
+            while ((n = slow.drain(batch, 32)) > 0) {
+                for (size_t i = 0; i < n; i++) torn += !consistent(batch[i]);
+                slowGot += n;
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+            if (finished) break;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    });
+    for (uint32_t i = 0; i < N; i++) {
+        fast.push(seqSample(i));
+        slow.push(seqSample(i));
+        if ((i & 1023) == 0) std::this_thread::yield();
+    }
+    producerDone.store(true);
+    fastConsumer.join();
+    slowConsumer.join();
+
+    TEST_ASSERT_EQUAL_UINT32(N, fastGot + fast.overflows());
+    TEST_ASSERT_EQUAL_UINT32(N, slowGot + slow.overflows());
+    TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_TRUE(slow.overflows() > fast.overflows());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo_order_and_overflow);
+    RUN_TEST(test_drain_respects_max);
+    RUN_TEST(test_rejects_capacity_that_is_not_a_power_of_two);
+    RUN_TEST(test_threaded_producer_consumer);
+    RUN_TEST(test_fan_out_to_consumers_at_different_paces);
+    return UNITY_END();
+}
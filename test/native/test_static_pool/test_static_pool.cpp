@@ -0,0 +1,93 @@
+#include <unity.h>
+#include <string>
+#include "http_session_pool.h"
+#include "http_standin.h"
+#include "pooled_transport_factory.h"
+#include "posix_transport.h"
+#include "static_pool.h"
+
+struct Counted {
+    Counted() : id(++built) {}
+    static int built;
+    int id;
+};
+int Counted::built = 0;
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_objects_are_built_once_and_reused() {
+    Counted::built = 0;
+    StaticPool<Counted, 3> pool;
+    TEST_ASSERT_EQUAL(3, Counted::built);
+    Counted* a = pool.acquire();
+    Counted* b = pool.acquire();
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_TRUE(a != b);
+    TEST_ASSERT_TRUE(pool.release(a));
+    TEST_ASSERT_TRUE(pool.acquire() == a); // same slot, not rebuilt
+    TEST_ASSERT_EQUAL(3, Counted::built);
+    TEST_ASSERT_EQUAL(3 * sizeof(Counted), (StaticPool<Counted, 3>::reservedBytes()));
+}
+
+void test_exhaustion_and_high_water() {
+    StaticPool<Counted, 2> pool;
+    Counted* a = pool.acquire();
+    Counted* b = pool.acquire();
+    TEST_ASSERT_NULL(pool.acquire());
+    TEST_ASSERT_EQUAL_UINT32(1, pool.exhausted());
+    TEST_ASSERT_EQUAL(2, pool.inUse());
+    pool.release(a);
+    pool.release(b);
+    TEST_ASSERT_EQUAL(0, pool.inUse());
+    TEST_ASSERT_EQUAL(2, pool.highWater()); // the peak stays
+    pool.acquire();
+    TEST_ASSERT_EQUAL(2, pool.highWater());
+}
+
+void test_release_rejects_foreign_and_double_frees() {
+    StaticPool<Counted, 2> pool;
+    Counted outside;
+    Counted* a = pool.acquire();
+    TEST_ASSERT_FALSE(pool.release(&outside));
+    TEST_ASSERT_TRUE(pool.release(a));
+    TEST_ASSERT_FALSE(pool.release(a));
+    TEST_ASSERT_EQUAL(0, pool.inUse());
+}
+
+// The session pool over pooled transports: one connection per origin, and
+// the high-water mark shows how many were open at once
+void test_session_pool_runs_on_pooled_transports() {
+    HttpStandin first([](const StandinRequest&, StandinResponse& resp) { resp.body = "a"; });
+    HttpStandin second([](const StandinRequest&, StandinResponse& resp) { resp.body = "b"; });
+    TEST_ASSERT_TRUE(first.start());
+    TEST_ASSERT_TRUE(second.start());
+    PooledTransportFactory<PosixTransport, PosixTransport, HTTP_POOL_MAX_SESSIONS> factory;
+    {
+        HttpSessionPool pool(factory, defaultHttpPoolConfig(posixMillis));
+        std::string a = first.url("/x"), b = second.url("/y");
+        for (int i = 0; i < 3; i++) {
+            TEST_ASSERT_EQUAL(200, pool.request("GET", a.c_str(), NULL, NULL, 0));
+            TEST_ASSERT_EQUAL(200, pool.request("GET", b.c_str(), NULL, NULL, 0));
+        }
+        TEST_ASSERT_EQUAL(2, factory.plain().inUse());
+        TEST_ASSERT_EQUAL(0, factory.secure().inUse());
+        pool.closeAll();
+        TEST_ASSERT_EQUAL(0, factory.plain().inUse());
+        TEST_ASSERT_EQUAL(200, pool.request("GET", a.c_str(), NULL, NULL, 0));
+    }
+    // The pool's destructor hands its last transport back
+    TEST_ASSERT_EQUAL(0, factory.plain().inUse());
+    TEST_ASSERT_EQUAL(2, factory.plain().highWater());
+    TEST_ASSERT_EQUAL_UINT32(0, factory.plain().exhausted());
+    TEST_ASSERT_EQUAL(3, first.acceptedConnections() + second.acceptedConnections()); // one after closeAll()
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_objects_are_built_once_and_reused);
+    RUN_TEST(test_exhaustion_and_high_water);
+    RUN_TEST(test_release_rejects_foreign_and_double_frees);
+    RUN_TEST(test_session_pool_runs_on_pooled_transports);
+    return UNITY_END();
+}
@@ -0,0 +1,231 @@
+#include <unity.h>
+#include <unistd.h>
+#include <atomic>
+#include <vector>
+#include "host_tasks.h"
+#include "net_scheduler.h"
+#include "posix_transport.h"
+#include "task_topology.h"
+
+static uint32_t fakeNow = 0;
+static uint32_t fakeMillis() { return fakeNow; }
+
+static const TopologyLimits esp32 = {2, 25, 2048};
+
+// The firmware's layout: sampling and MQTT isolated on core 1, the HTTP
+// worker free to run on either core below them
+static const TaskSpec firmwareTable[] = {{"Sampling", 1,             5, 3072,  true},
+                                         {"MQTT",     1,             4, 6144,  true},
+                                         {"HTTP",     TASK_ANY_CORE, 2, 10240, false},
+                                         {"loop",     1,             1, 0,     false}};
+
+void setUp(void) {
+    fakeNow = 1000;
+}
+void tearDown(void) {}
+
+void test_firmware_table_is_valid() {
+    size_t bad = 99;
+    TEST_ASSERT_EQUAL(TOPOLOGY_OK, checkTopology(firmwareTable, 4, esp32, &bad));
+    TEST_ASSERT_EQUAL(99, bad);
+}
+
+void test_rejects_rows_the_chip_cannot_run() {
+    size_t bad = 99;
+    TaskSpec table[] = {{"a", 0, 3, 4096, false}, {"b", 2, 3, 4096, false}};
+    TEST_ASSERT_EQUAL(TOPOLOGY_ERR_CORE, checkTopology(table, 2, esp32, &bad));
+    TEST_ASSERT_EQUAL(1, bad);
+    table[1].core = -2;
+    TEST_ASSERT_EQUAL(TOPOLOGY_ERR_CORE, checkTopology(table, 2, esp32, NULL));
+    table[1].core = 1;
+    table[1].priority = 25;
+    TEST_ASSERT_EQUAL(TOPOLOGY_ERR_PRIORITY, checkTopology(table, 2, esp32, NULL));
+    table[1].priority = 3;
+    table[0].stackBytes = 1024;
+    TEST_ASSERT_EQUAL(TOPOLOGY_ERR_STACK, checkTopology(table, 2, esp32, &bad));
+    TEST_ASSERT_EQUAL(0, bad);
+    table[0].stackBytes = 0; // created elsewhere
+    TEST_ASSERT_EQUAL(TOPOLOGY_OK, checkTopology(table, 2, esp32, NULL));
+    TEST_ASSERT_EQUAL_STRING("stack too small", topologyErrorName(TOPOLOGY_ERR_STACK));
+}
+
+void test_isolation_needs_a_pinned_core_and_the_top_priority() {
+    size_t bad = 99;
+    TaskSpec table[4];
+    for (int i = 0; i < 4; i++) table[i] = firmwareTable[i];
+
+    // An unpinned isolated task could be pushed around on either core
+    table[1].core = TASK_ANY_CORE;
+    TEST_ASSERT_EQUAL(TOPOLOGY_ERR_ISOLATION, checkTopology(table, 4, esp32, &bad));
+    TEST_ASSERT_EQUAL(1, bad);
+    table[1].core = 1;
+
+    // A worker without affinity at MQTT's priority can land on core 1 and take turns with it
+    table[2].priority = 4;
+    TEST_ASSERT_EQUAL(TOPOLOGY_ERR_ISOLATION, checkTopology(table, 4, esp32, &bad));
+    TEST_ASSERT_EQUAL(2, bad);
+
+    // Pinned to the other core it may outrank them
+    table[2].core = 0;
+    table[2].priority = 20;
+    TEST_ASSERT_EQUAL(TOPOLOGY_OK, checkTopology(table, 4, esp32, NULL));
+
+    // The loop task on the isolated core may not outrank MQTT
+    table[3].priority = 4;
+    TEST_ASSERT_EQUAL(TOPOLOGY_ERR_ISOLATION, checkTopology(table, 4, esp32, &bad));
+    TEST_ASSERT_EQUAL(3, bad);
+}
+
+void test_core_load_is_busy_time_over_the_window() {
+    CoreLoad load(fakeMillis);
+    uint8_t pct[TOPOLOGY_MAX_CORES];
+    load.sample(pct); // window starts at 1000
+    load.add(0, 150000);
+    load.add(0, 100000);
+    load.add(1, 5000000); // more than the window: capped
+    load.add(2, 1000000); // no such core
+    load.add(-1, 1000000);
+    fakeNow += 1000;
+    load.sample(pct);
+    TEST_ASSERT_EQUAL_UINT8(25, pct[0]);
+    TEST_ASSERT_EQUAL_UINT8(100, pct[1]);
+    fakeNow += 2000;
+    load.sample(pct); // a new window, nothing reported in it
+    TEST_ASSERT_EQUAL_UINT8(0, pct[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, pct[1]);
+    load.add(1, 1000);
+    load.sample(pct); // empty window
+    TEST_ASSERT_EQUAL_UINT8(0, pct[1]);
+}
+
+static JobResult countJob(void* ctx) {
+    (*static_cast<int*>(ctx))++;
+    return JOB_DONE;
+}
+
+void test_mailbox_delivers_posts_with_their_delay() {
+    NetScheduler sched(fakeMillis, NULL, 0);
+    JobMailbox mailbox(fakeMillis);
+    int now = 0, later = 0;
+    JobSpec a = {"now", countJob, &now, 0, 0, 0, 1, false, 0, 0};
+    JobSpec b = {"later", countJob, &later, 0, 0, 0, 1, false, 0, 0};
+    int idNow = sched.add(a, 0);
+    int idLater = sched.add(b, 0);
+    TEST_ASSERT_TRUE(mailbox.empty());
+    mailbox.post(idNow);
+    mailbox.post(idLater, 500);
+    mailbox.post(SCHED_MAX_JOBS); // ignored
+    TEST_ASSERT_FALSE(mailbox.empty());
+    fakeNow += 100; // delivered a little late: the delay counts from the post
+    mailbox.deliver(sched);
+    TEST_ASSERT_TRUE(mailbox.empty());
+    TEST_ASSERT_EQUAL_UINT32(400, sched.runDue());
+    TEST_ASSERT_EQUAL(1, now);
+    TEST_ASSERT_EQUAL(0, later);
+    fakeNow += 400;
+    sched.runDue();
+    TEST_ASSERT_EQUAL(1, later);
+}
+
+// Both lanes of the firmware on pthreads: a publish job every 10 ms and an
+// HTTPS call that blocks for 250 ms, like a full TLS handshake on a slow link
+#define PUBLISH_PERIOD_MS 10
+#define BLOCKING_CALL_MS 250
+#define RUN_MS 700
+
+struct PublishLog {
+    std::vector<uint32_t> times;
+};
+
+static JobResult publishJob(void* ctx) {
+    static_cast<PublishLog*>(ctx)->times.push_back(posixMillis());
+    return JOB_DONE;
+}
+
+static JobResult blockingHttpsJob(void*) {
+    usleep(BLOCKING_CALL_MS * 1000);
+    return JOB_DONE;
+}
+
+struct Lane {
+    NetScheduler* sched;
+    CoreLoad* load;
+    std::atomic<bool>* stop;
+};
+
+// The task loop: run what is due, then sleep until the next deadline
+static void* runLane(void* arg) {
+    Lane* lane = static_cast<Lane*>(arg);
+    while (!lane->stop->load()) {
+        uint32_t t0 = posixMillis();
+        uint32_t sleepMs = lane->sched->runDue();
+        lane->load->add(hostTaskCore() % TOPOLOGY_MAX_CORES, (posixMillis() - t0) * 1000);
+        usleep((sleepMs < 2 ? sleepMs : 2) * 1000);
+    }
+    return NULL;
+}
+
+static uint32_t longestGap(const PublishLog& log) {
+    uint32_t gap = 0;
+    for (size_t i = 1; i < log.times.size(); i++) {
+        if (log.times[i] - log.times[i - 1] > gap) gap = log.times[i] - log.times[i - 1];
+    }
+    return gap;
+}
+
+// Runs the publish and HTTPS jobs on one shared task or on one task each
+static void runLanes(bool separateLanes, uint32_t* gapMs, uint8_t* busiestCorePct) {
+    NetScheduler mqttSched(posixMillis, NULL, 0);
+    NetScheduler httpSched(posixMillis, NULL, 0);
+    NetScheduler& httpOwner = separateLanes ? httpSched : mqttSched;
+    PublishLog log;
+    JobSpec publish = {"publish", publishJob, &log, PUBLISH_PERIOD_MS, 0, 0, 7, false, 0, 0};
+    JobSpec https = {"https", blockingHttpsJob, NULL, BLOCKING_CALL_MS + 50, 0, 0, 8, false, 0, 0};
+    mqttSched.add(publish, 0);
+    httpOwner.add(https, 20);
+
+    CoreLoad load(posixMillis);
+    uint8_t pct[TOPOLOGY_MAX_CORES];
+    load.sample(pct);
+    std::atomic<bool> stop(false);
+    Lane mqttLane = {&mqttSched, &load, &stop};
+    Lane httpLane = {&httpSched, &load, &stop};
+    pthread_t mqttThread, httpThread;
+    TEST_ASSERT_TRUE(startHostTask(firmwareTable[1], runLane, &mqttLane, &mqttThread));
+    TEST_ASSERT_TRUE(startHostTask(firmwareTable[2], runLane, &httpLane, &httpThread));
+    usleep(RUN_MS * 1000);
+    stop = true;
+    pthread_join(mqttThread, NULL);
+    pthread_join(httpThread, NULL);
+    load.sample(pct);
+    *busiestCorePct = pct[0] > pct[1] ? pct[0] : pct[1];
+    TEST_ASSERT_TRUE(log.times.size() > 2);
+    *gapMs = longestGap(log);
+}
+
+void test_blocking_https_stalls_a_shared_task() {
+    uint32_t gap = 0;
+    uint8_t busiest = 0;
+    runLanes(false, &gap, &busiest);
+    TEST_ASSERT_TRUE(gap >= BLOCKING_CALL_MS - 10);
+    TEST_ASSERT_TRUE(busiest > 0); // the blocked time counts as busy on that core
+}
+
+void test_separate_lanes_keep_publishing_through_blocking_https() {
+    uint32_t gap = 0;
+    uint8_t busiest = 0;
+    runLanes(true, &gap, &busiest);
+    TEST_ASSERT_TRUE(gap < BLOCKING_CALL_MS / 2);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_firmware_table_is_valid);
+    RUN_TEST(test_rejects_rows_the_chip_cannot_run);
+    RUN_TEST(test_isolation_needs_a_pinned_core_and_the_top_priority);
+    RUN_TEST(test_core_load_is_busy_time_over_the_window);
+    RUN_TEST(test_mailbox_delivers_posts_with_their_delay);
+    RUN_TEST(test_blocking_https_stalls_a_shared_task);
+    RUN_TEST(test_separate_lanes_keep_publishing_through_blocking_https);
+    return UNITY_END();
+}
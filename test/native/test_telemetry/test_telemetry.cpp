@@ -0,0 +1,216 @@
+#include <unity.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "telemetry_frame.h"
+#include "telemetry_publisher.h"
+
+static uint32_t fakeNow = 0;
+static uint32_t fakeMillis() { return fakeNow; }
+
+struct Published {
+    std::string topic;
+    std::vector<uint8_t> payload;
+    uint8_t qos;
+    bool retain;
+};
+
+// Records publishes; can be taken offline or made to refuse them.
+struct FakeMqtt : public MqttClient {
+    bool connected() { return online; }
+    bool connect(const char*) { return online; }
+    bool publish(const char* topic, const uint8_t* payload, size_t len, uint8_t qos, bool retain) {
+        if (refuse) return false;
+        Published p = {topic, std::vector<uint8_t>(payload, payload + len), qos, retain};
+        sent.push_back(p);
+        return true;
+    }
+    bool subscribe(const char*, uint8_t) { return online; }
+    void onMessage(MqttMessageFn, void*) {}
+    bool loop() { return online; }
+    int state() { return 0; }
+
+    bool online = true;
+    bool refuse = false;
+    std::vector<Published> sent;
+};
+
+static SummaryRecord summary(uint32_t ts, int32_t base) {
+    SummaryRecord r;
+    memset(&r, 0, sizeof(r));
+    r.timestamp = ts;
+    r.samples = 12;
+    r.channels = 3;
+    for (int c = 0; c < 3; c++) {
+        r.ch[c].min = base + c * 1000 - 50;
+        r.ch[c].max = base + c * 1000 + 70;
+        r.ch[c].mean = base + c * 1000;
+        r.ch[c].sd = 31;
+        r.ch[c].alarm = (uint8_t)c;
+    }
+    return r;
+}
+
+static const TelemetryStream summaryStream = {"s", 0, false, 5, 300000};
+static const TelemetryStream alarmStream = {"a", 1, true, 4, 0};
+
+void setUp(void) { fakeNow = 1000; }
+void tearDown(void) {}
+
+void test_summary_frame_round_trip() {
+    uint8_t buf[256];
+    TelemetryFrame frame(buf, sizeof(buf));
+    frame.reset(TELEMETRY_SUMMARY);
+    SummaryRecord in[3] = {summary(1700000060, 2512), summary(1700000120, -480), summary(1700000180, 2600)};
+    for (int i = 0; i < 3; i++) TEST_ASSERT_TRUE(frame.add(in[i]));
+    frame.finish(41);
+
+    SummaryRecord out[4];
+    uint32_t seq = 0;
+    TEST_ASSERT_EQUAL(3, decodeSummaryFrame(frame.data(), frame.length(), &seq, out, 4));
+    TEST_ASSERT_EQUAL_UINT32(41, seq);
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_UINT32(in[i].timestamp, out[i].timestamp);
+        TEST_ASSERT_EQUAL_UINT32(12, out[i].samples);
+        TEST_ASSERT_EQUAL(3, out[i].channels);
+        for (int c = 0; c < 3; c++) {
+            TEST_ASSERT_EQUAL_INT32(in[i].ch[c].min, out[i].ch[c].min);
+            TEST_ASSERT_EQUAL_INT32(in[i].ch[c].max, out[i].ch[c].max);
+            TEST_ASSERT_EQUAL_INT32(in[i].ch[c].mean, out[i].ch[c].mean);
+            TEST_ASSERT_EQUAL_UINT32(31, out[i].ch[c].sd);
+            TEST_ASSERT_EQUAL(c, out[i].ch[c].alarm);
+        }
+    }
+    // Three one-minute summaries of three channels in well under 100 bytes
+    TEST_ASSERT_TRUE(frame.length() < 100);
+}
+
+void test_alarm_frame_round_trip() {
+    uint8_t buf[64];
+    TelemetryFrame frame(buf, sizeof(buf));
+    frame.reset(TELEMETRY_ALARM);
+    AlarmRecord in[3] = {{1700000300, 0, 1, true, 3312}, {0, 1, 0, false, 5520}, {1700000100, 2, 2, false, -75}};
+    for (int i = 0; i < 3; i++) TEST_ASSERT_TRUE(frame.add(in[i]));
+    frame.finish(7);
+
+    AlarmRecord out[3];
+    uint32_t seq;
+    TEST_ASSERT_EQUAL(3, decodeAlarmFrame(frame.data(), frame.length(), &seq, out, 3));
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_UINT32(in[i].timestamp, out[i].timestamp);
+        TEST_ASSERT_EQUAL(in[i].channel, out[i].channel);
+        TEST_ASSERT_EQUAL(in[i].state, out[i].state);
+        TEST_ASSERT_EQUAL(in[i].changed, out[i].changed);
+        TEST_ASSERT_EQUAL_INT32(in[i].value, out[i].value);
+    }
+    // Wrong type, truncation and too small an output are rejected
+    SummaryRecord s[3];
+    TEST_ASSERT_EQUAL(-1, decodeSummaryFrame(frame.data(), frame.length(), &seq, s, 3));
+    TEST_ASSERT_EQUAL(-1, decodeAlarmFrame(frame.data(), frame.length() - 1, &seq, out, 3));
+    TEST_ASSERT_EQUAL(-1, decodeAlarmFrame(frame.data(), frame.length(), &seq, out, 2));
+}
+
+void test_frame_refuses_records_that_do_not_fit() {
+    uint8_t buf[TELEMETRY_HEADER_BOUND + 40];
+    TelemetryFrame frame(buf, sizeof(buf));
+    frame.reset(TELEMETRY_SUMMARY);
+    TEST_ASSERT_FALSE(frame.add(summary(1700000060, 2500)));
+    TEST_ASSERT_TRUE(frame.empty());
+    AlarmRecord a = {1, 0, 1, true, 1};
+    TEST_ASSERT_FALSE(frame.add(a)); // wrong type
+}
+
+void test_publisher_packs_records_and_keeps_id_in_topic() {
+    FakeMqtt mqtt;
+    TelemetryPublisher pub(mqtt, TELEMETRY_SUMMARY, summaryStream, fakeMillis);
+    TEST_ASSERT_TRUE(pub.begin("edge", "esp32-01"));
+    TEST_ASSERT_EQUAL_STRING("edge/esp32-01/s", pub.topic());
+
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(pub.add(summary(1700000060 + 60 * i, 2500)));
+        TEST_ASSERT_TRUE(pub.flush());
+        fakeNow += 60000;
+    }
+    TEST_ASSERT_EQUAL(0, (int)mqtt.sent.size());
+    TEST_ASSERT_TRUE(pub.add(summary(1700000300, 2500)));
+    TEST_ASSERT_EQUAL(1, (int)mqtt.sent.size()); // fifth record fills the frame
+    TEST_ASSERT_EQUAL(0, mqtt.sent[0].qos);
+    TEST_ASSERT_FALSE(mqtt.sent[0].retain);
+
+    SummaryRecord out[5];
+    uint32_t seq;
+    TEST_ASSERT_EQUAL(5, decodeSummaryFrame(mqtt.sent[0].payload.data(), mqtt.sent[0].payload.size(), &seq, out, 5));
+    TEST_ASSERT_EQUAL_UINT32(0, seq);
+    TEST_ASSERT_EQUAL_UINT32(1, pub.stats().frames);
+    TEST_ASSERT_EQUAL_UINT32(5, pub.stats().records);
+}
+
+void test_partial_frame_goes_out_at_max_age() {
+    FakeMqtt mqtt;
+    TelemetryPublisher pub(mqtt, TELEMETRY_SUMMARY, summaryStream, fakeMillis);
+    pub.begin("edge", "esp32-01");
+    pub.add(summary(1700000060, 2500));
+    fakeNow += 299999;
+    TEST_ASSERT_EQUAL_UINT32(1, pub.dueInMs());
+    pub.flush();
+    TEST_ASSERT_EQUAL(0, (int)mqtt.sent.size());
+    fakeNow += 1;
+    pub.flush();
+    TEST_ASSERT_EQUAL(1, (int)mqtt.sent.size());
+    TEST_ASSERT_FALSE(pub.pending());
+}
+
+void test_qos0_drops_refused_frames_and_waits_while_offline() {
+    FakeMqtt mqtt;
+    TelemetryStream s = summaryStream;
+    s.maxRecords = 1;
+    TelemetryPublisher pub(mqtt, TELEMETRY_SUMMARY, s, fakeMillis);
+    pub.begin("edge", "esp32-01");
+
+    mqtt.online = false;
+    pub.add(summary(1700000060, 2500));
+    TEST_ASSERT_TRUE(pub.pending()); // offline: kept for the broker
+    mqtt.online = true;
+    mqtt.refuse = true;
+    TEST_ASSERT_FALSE(pub.flush());
+    TEST_ASSERT_FALSE(pub.pending());
+    TEST_ASSERT_EQUAL_UINT32(1, pub.stats().dropped);
+
+    mqtt.refuse = false;
+    pub.add(summary(1700000120, 2500));
+    uint32_t seq;
+    SummaryRecord out[1];
+    TEST_ASSERT_EQUAL(1, decodeSummaryFrame(mqtt.sent[0].payload.data(), mqtt.sent[0].payload.size(), &seq, out, 1));
+    TEST_ASSERT_EQUAL_UINT32(1, seq); // seq 0 was lost
+}
+
+void test_qos1_retained_alarm_state_is_kept_until_published() {
+    FakeMqtt mqtt;
+    TelemetryPublisher pub(mqtt, TELEMETRY_ALARM, alarmStream, fakeMillis);
+    pub.begin("edge", "esp32-01");
+    mqtt.refuse = true;
+    AlarmRecord a = {1700000300, 0, 1, true, 3312};
+    pub.add(a);
+    TEST_ASSERT_FALSE(pub.flush(true));
+    TEST_ASSERT_TRUE(pub.pending());
+    TEST_ASSERT_EQUAL_UINT32(0, pub.stats().dropped);
+
+    mqtt.refuse = false;
+    TEST_ASSERT_TRUE(pub.flush(true));
+    TEST_ASSERT_EQUAL(1, (int)mqtt.sent.size());
+    TEST_ASSERT_EQUAL_STRING("edge/esp32-01/a", mqtt.sent[0].topic.c_str());
+    TEST_ASSERT_EQUAL(1, mqtt.sent[0].qos);
+    TEST_ASSERT_TRUE(mqtt.sent[0].retain);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_summary_frame_round_trip);
+    RUN_TEST(test_alarm_frame_round_trip);
+    RUN_TEST(test_frame_refuses_records_that_do_not_fit);
+    RUN_TEST(test_publisher_packs_records_and_keeps_id_in_topic);
+    RUN_TEST(test_partial_frame_goes_out_at_max_age);
+    RUN_TEST(test_qos0_drops_refused_frames_and_waits_while_offline);
+    RUN_TEST(test_qos1_retained_alarm_state_is_kept_until_published);
+    return UNITY_END();
+}
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Compare two native benchmark runs and flag regressions.
+
+Usage: bench_compare.py baseline.jsonl current.jsonl [threshold_percent]
+
+Both files are written by the native benchmarks when BENCH_JSON is set
+(see lib/standin/bench_report.h):
+
+    BENCH_JSON=bench.jsonl pio test -e native
+
+Units ending in "/s" are better when higher; everything else (ns/op, ms,
+bytes, ...) is better when lower. Exits 1 if any metric got worse by more
+than the threshold (default 15%), so it can gate CI.
+"""
+
+import json
+import sys
+
+
+def load(path):
+    results = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            r = json.loads(line)
+            # Last value wins when a suite ran more than once
+            results[(r["suite"], r["metric"])] = (float(r["value"]), r["unit"])
+    return results
+
+
+def main():
+    if len(sys.argv) not in (3, 4):
+        print(__doc__)
+        return 2
+    base = load(sys.argv[1])
+    cur = load(sys.argv[2])
+    threshold = float(sys.argv[3]) if len(sys.argv) == 4 else 15.0
+
+    regressions = 0
+    for key in sorted(cur):
+        value, unit = cur[key]
+        if key not in base:
+            print(f"  new   {key[0]}/{key[1]}: {value:g} {unit}")
+            continue
+        old, _ = base[key]
+        if old == 0:
+            continue
+        change = (value - old) / old * 100.0
+        worse = -change if unit.endswith("/s") else change
+        mark = "  ok  "
+        if worse > threshold:
+            mark = "  SLOW"
+            regressions += 1
+        print(f"{mark} {key[0]}/{key[1]}: {old:g} -> {value:g} {unit} ({change:+.1f}%)")
+    for key in sorted(set(base) - set(cur)):
+        print(f"  gone  {key[0]}/{key[1]}")
+
+    if regressions:
+        print(f"❌ {regressions} metric(s) regressed by more than {threshold:g}%")
+        return 1
+    print(f"✅ No regression above {threshold:g}%")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Decode binary MQTT telemetry frames (lib/telemetry/telemetry_frame.h).
+
+Reads lines of "<topic> <hex payload>" from stdin, as printed by
+    mosquitto_sub -t 'edge/+/+' -F '%t %x'
+and prints one JSON object per record with the device id taken from the topic.
+"""
+
+import json
+import sys
+
+FRAME_VERSION = 1
+SUMMARY, ALARM = 1, 2
+ALARM_NAMES = ["clear", "high", "low"]
+CHANNELS = ["temp", "humidity", "light", "ch3"]
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def byte(self):
+        b = self.data[self.pos]
+        self.pos += 1
+        return b
+
+    def varint(self):
+        result = shift = 0
+        while True:
+            b = self.byte()
+            result |= (b & 0x7F) << shift
+            shift += 7
+            if not b & 0x80:
+                return result
+
+    def zigzag(self):
+        v = self.varint()
+        return (v >> 1) ^ -(v & 1)
+
+
+def decode(device, data):
+    r = Reader(data)
+    kind = r.byte()
+    if kind >> 4 != FRAME_VERSION:
+        raise ValueError(f"unknown frame version {kind >> 4}")
+    seq = r.varint()
+    ts = t0 = r.varint()
+    records = []
+    for _ in range(r.byte()):
+        if kind & 0x0F == SUMMARY:
+            ts += r.zigzag()
+            rec = {"device_id": device, "seq": seq, "ts": ts, "n": r.varint()}
+            channels = r.byte()
+            for c in range(channels):
+                lo = r.zigzag()
+                hi = lo + r.varint()
+                mean = lo + r.varint()
+                sd = r.varint()
+                rec[CHANNELS[c]] = {"min": lo / 100, "max": hi / 100, "mean": mean / 100, "sd": sd / 100}
+            alarms = r.varint()
+            for c in range(channels):
+                rec[CHANNELS[c]]["alarm"] = ALARM_NAMES[(alarms >> (2 * c)) & 3]
+        elif kind & 0x0F == ALARM:
+            channel = r.byte()
+            state = r.byte()
+            rec = {"device_id": device, "seq": seq, "channel": CHANNELS[channel],
+                   "state": ALARM_NAMES[state & 0x7F], "changed": bool(state & 0x80),
+                   "value": r.zigzag() / 100}
+            rec["ts"] = (t0 + r.zigzag()) & 0xFFFFFFFF
+        else:
+            raise ValueError(f"unknown frame type {kind & 0x0F}")
+        records.append(rec)
+    return records
+
+
+def main():
+    for line in sys.stdin:
+        parts = line.split()
+        if len(parts) != 2:
+            continue
+        topic, payload = parts
+        levels = topic.split("/")
+        device = levels[-2] if len(levels) >= 3 else ""
+        try:
+            for rec in decode(device, bytes.fromhex(payload)):
+                print(json.dumps(rec))
+        except (ValueError, IndexError) as e:
+            print(f"{topic}: bad frame ({e})", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
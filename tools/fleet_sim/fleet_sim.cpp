@@ -0,0 +1,179 @@
+// Fleet load simulator: thousands of virtual ESP32s in one process, running
+// the firmware's own scheduler, payload builders, retry/backoff and OTA flow
+// against the OTA server. Without --server it starts a local stand-in, so
+// it runs offline.
+//
+//   pio run -e fleet_sim
+//   .pio/build/fleet_sim/program --devices 5000 --duration 600
+//       --wave 120:10:60 --wave 300:100:300 --outage 200:30:50
+//
+// Times are seconds of the run. --time-scale N divides every firmware
+// interval by N, e.g. 60 turns the 60 s heartbeat into 1 s.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "api_standin.h"
+#include "bench_report.h"
+#include "fleet_sim.h"
+
+#define SUITE "fleet_sim"
+
+struct ServerEvent {
+    uint32_t atMs;
+    bool down;
+};
+
+static void usage() {
+    fprintf(stderr,
+            "usage: fleet_sim [options]\n"
+            "  --devices N            simulated devices (1000)\n"
+            "  --workers N            event loop threads (one per core)\n"
+            "  --duration S           length of the run (600)\n"
+            "  --boot-spread S        devices power up at random over this long (60)\n"
+            "  --time-scale N         divide firmware intervals by N (1)\n"
+            "  --reconnect-ms MS      WiFi join after boot or an outage (3000)\n"
+            "  --server URL           OTA server; a local stand-in if omitted\n"
+            "  --token T              API bearer token (sim)\n"
+            "  --version V            firmware the fleet starts on (1.0.0)\n"
+            "  --offer V              version rolled out by --wave; the server must offer it (1.1.0)\n"
+            "  --image-kb N           stand-in image size (1024)\n"
+            "  --wave S:PCT[:SPREAD]  at S, offer the update to PCT%% of the fleet (cumulative)\n"
+            "  --outage S:DUR:PCT     at S, PCT%% of the devices lose WiFi for DUR seconds\n"
+            "  --server-outage S:DUR  the stand-in answers 503 for DUR seconds\n"
+            "  --seed N\n");
+}
+
+static bool parseTriple(const char* text, uint32_t* a, uint32_t* b, uint32_t* c) {
+    char* end;
+    *a = strtoul(text, &end, 10);
+    if (*end != ':') return false;
+    *b = strtoul(end + 1, &end, 10);
+    if (*end == '\0') return true;
+    if (*end != ':' || !c) return false;
+    *c = strtoul(end + 1, &end, 10);
+    return *end == '\0';
+}
+
+static void printLatency(const char* name, const FleetLatency& l) {
+    printf("  %-14s %8u %8u %10.1f %10.1f %10.1f\n", name, (unsigned)l.count, (unsigned)l.failures, l.p50Us / 1000.0,
+           l.p99Us / 1000.0, l.maxUs / 1000.0);
+    char metric[48];
+    snprintf(metric, sizeof(metric), "%s_p50", name);
+    benchRecord(SUITE, metric, l.p50Us / 1000.0, "ms");
+    snprintf(metric, sizeof(metric), "%s_p99", name);
+    benchRecord(SUITE, metric, l.p99Us / 1000.0, "ms");
+}
+
+int main(int argc, char** argv) {
+    FleetConfig config = defaultFleetConfig(1000, "");
+    config.durationMs = 600000;
+    const char* offer = "1.1.0";
+    size_t imageKb = 1024;
+    std::vector<ServerEvent> events;
+
+    for (int i = 1; i < argc; i++) {
+        const char* opt = argv[i];
+        if (i + 1 >= argc) {
+            usage();
+            return 2;
+        }
+        const char* val = argv[++i];
+        uint32_t a = 0, b = 0, c = 0;
+        if (!strcmp(opt, "--devices")) config.devices = strtoul(val, NULL, 10);
+        else if (!strcmp(opt, "--workers")) config.workers = strtoul(val, NULL, 10);
+        else if (!strcmp(opt, "--duration")) config.durationMs = strtoul(val, NULL, 10) * 1000;
+        else if (!strcmp(opt, "--boot-spread")) config.bootSpreadMs = strtoul(val, NULL, 10) * 1000;
+        else if (!strcmp(opt, "--time-scale")) config.timeScale = strtoul(val, NULL, 10);
+        else if (!strcmp(opt, "--reconnect-ms")) config.reconnectMs = strtoul(val, NULL, 10);
+        else if (!strcmp(opt, "--server")) config.server = val;
+        else if (!strcmp(opt, "--token")) config.authToken = val;
+        else if (!strcmp(opt, "--version")) config.firmwareVersion = val;
+        else if (!strcmp(opt, "--offer")) offer = val;
+        else if (!strcmp(opt, "--image-kb")) imageKb = strtoul(val, NULL, 10);
+        else if (!strcmp(opt, "--seed")) config.seed = strtoul(val, NULL, 10);
+        else if (!strcmp(opt, "--wave") && parseTriple(val, &a, &b, &c)) {
+            FleetWave wave = {a * 1000, (uint8_t)std::min<uint32_t>(b, 100), c};
+            config.waves.push_back(wave);
+        } else if (!strcmp(opt, "--outage") && parseTriple(val, &a, &b, &c)) {
+            FleetOutage outage = {a * 1000, b * 1000, (uint8_t)std::min<uint32_t>(c, 100)};
+            config.outages.push_back(outage);
+        } else if (!strcmp(opt, "--server-outage") && parseTriple(val, &a, &b, NULL)) {
+            events.push_back(ServerEvent{a * 1000, true});
+            events.push_back(ServerEvent{(a + b) * 1000, false});
+        } else {
+            usage();
+            return 2;
+        }
+    }
+
+    // Every device keeps a connection open; the stand-in holds the other end
+    struct rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+
+    std::unique_ptr<ApiStandin> standin;
+    if (config.server.empty()) {
+        standin.reset(new ApiStandin(config.firmwareVersion, imageKb * 1024));
+        if (!standin->start()) {
+            fprintf(stderr, "could not start the stand-in server\n");
+            return 1;
+        }
+        config.server = standin->baseUrl();
+        // The waves only start the version check, so the offer is out before the first
+        if (!config.waves.empty()) standin->release(offer);
+        printf("stand-in server at %s, %u KB image\n", config.server.c_str(), (unsigned)imageKb);
+    }
+    config.offerVersion = offer;
+
+    printf("%u devices on %u workers for %u s, time scale %u\n", (unsigned)config.devices,
+           (unsigned)config.workers, (unsigned)(config.durationMs / 1000), (unsigned)config.timeScale);
+    FleetSimulator sim(config);
+
+    // Server-side events only apply to the stand-in
+    std::atomic<bool> done(false);
+    std::thread controller;
+    if (standin) {
+        std::sort(events.begin(), events.end(),
+                  [](const ServerEvent& a, const ServerEvent& b) { return a.atMs < b.atMs; });
+        controller = std::thread([&]() {
+            std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < events.size() && !done.load(); i++) {
+                while (!done.load() && std::chrono::steady_clock::now() - t0 < std::chrono::milliseconds(events[i].atMs)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                }
+                standin->setDown(events[i].down);
+            }
+        });
+    }
+    FleetReport r = sim.run();
+    done.store(true);
+    if (controller.joinable()) controller.join();
+
+    double seconds = r.elapsedMs / 1000.0;
+    printf("\n%.1f s, %u HTTP requests (%.1f/s, peak %u/s), %u connects, %u reused\n", seconds,
+           (unsigned)r.httpRequests, r.requestsPerSec(), (unsigned)r.peakPerSec, (unsigned)r.connects,
+           (unsigned)r.reused);
+    printf("  %-14s %8s %8s %10s %10s %10s\n", "request", "count", "failed", "p50 ms", "p99 ms", "max ms");
+    for (int k = 0; k < FLEET_REQUEST_KINDS; k++) printLatency(fleetRequestName((FleetRequestKind)k), r.requests[k]);
+    printLatency("worker_lag", r.lag);
+    printf("MQTT: %u messages (%.1f/s), %.1f KB; %u commands executed\n", (unsigned)r.mqttMessages,
+           seconds > 0 ? r.mqttMessages / seconds : 0, r.mqttBytes / 1024.0, (unsigned)r.commands);
+    printf("OTA: %u devices updated; %u link outages\n", (unsigned)r.updated, (unsigned)r.outages);
+    printf("Circuit breakers: %u requests held back on the devices\n", (unsigned)r.rejected);
+    if (standin) printf("stand-in: %u requests answered 503\n", (unsigned)standin->rejected());
+
+    benchRecord(SUITE, "http_requests_per_sec", r.requestsPerSec(), "req/s");
+    benchRecord(SUITE, "http_peak_per_sec", r.peakPerSec, "req/s");
+    benchRecord(SUITE, "mqtt_messages_per_sec", seconds > 0 ? r.mqttMessages / seconds : 0, "msg/s");
+    return 0;
+}
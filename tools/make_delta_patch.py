@@ -0,0 +1,114 @@
+#!/usr/bin/env python3
+"""Create a delta OTA patch between two firmware images.
+
+Usage: make_delta_patch.py old.bin new.bin out.patch
+
+The format is documented in lib/ota/delta_patch.h; the device applies it
+while streaming and falls back to the full image if anything goes wrong.
+Keep this file in step with lib/ota/delta_encoder.cpp: both must produce
+the same bytes for the same pair of images.
+"""
+
+import hashlib
+import struct
+import sys
+
+BLOCK = 16
+OP_END, OP_COPY, OP_ADD, OP_INSERT = 0, 1, 2, 3
+
+
+def varint(v):
+    out = bytearray()
+    while v >= 0x80:
+        out.append((v & 0x7F) | 0x80)
+        v >>= 7
+    out.append(v)
+    return out
+
+
+def emit_gap(out, src, dst, start, end, src_from):
+    length = end - start
+    if length == 0:
+        return
+    same = 0
+    if src_from + length <= len(src):
+        same = sum(1 for i in range(length) if dst[start + i] == src[src_from + i])
+    if same * 2 < length:
+        out += bytes([OP_INSERT]) + varint(length) + dst[start:end]
+        return
+
+    def eq(k):
+        return dst[start + k] == src[src_from + k]
+
+    out += bytes([OP_ADD]) + varint(length) + varint(src_from)
+    i = 0
+    while i < length:
+        zeros = 0
+        while i + zeros < length and eq(i + zeros):
+            zeros += 1
+        i += zeros
+        # A literal run ends at the first stretch of three equal bytes.
+        lit = 0
+        while i + lit < length:
+            run = 0
+            while run < 3 and i + lit + run < length and eq(i + lit + run):
+                run += 1
+            if run == 3 or i + lit + run == length:
+                if run < 3:
+                    lit += run
+                break
+            lit += run + 1
+        out += varint(zeros) + varint(lit)
+        out += bytes((dst[start + i + k] - src[src_from + i + k]) & 0xFF for k in range(lit))
+        i += lit
+
+
+def make_patch(src, dst):
+    out = bytearray(b"EDP1")
+    out += struct.pack("<II", len(src), len(dst))
+    out += hashlib.sha256(src).digest() + hashlib.sha256(dst).digest()
+
+    index = {}
+    for s in range(0, len(src) - BLOCK + 1, BLOCK):
+        index.setdefault(src[s:s + BLOCK], s)
+
+    t = lit_start = src_next = 0
+    while t + BLOCK <= len(dst):
+        s = index.get(dst[t:t + BLOCK])
+        if s is None:
+            t += 1
+            continue
+        while t > lit_start and s > 0 and dst[t - 1] == src[s - 1]:
+            t -= 1
+            s -= 1
+        n = 0
+        while t + n < len(dst) and s + n < len(src) and dst[t + n] == src[s + n]:
+            n += 1
+        emit_gap(out, src, dst, lit_start, t, src_next)
+        out += bytes([OP_COPY]) + varint(n) + varint(s)
+        t += n
+        lit_start = t
+        src_next = s + n
+    emit_gap(out, src, dst, lit_start, len(dst), src_next)
+    out.append(OP_END)
+    return bytes(out)
+
+
+def main():
+    if len(sys.argv) != 4:
+        print(__doc__)
+        return 2
+    with open(sys.argv[1], "rb") as f:
+        src = f.read()
+    with open(sys.argv[2], "rb") as f:
+        dst = f.read()
+    patch = make_patch(src, dst)
+    with open(sys.argv[3], "wb") as f:
+        f.write(patch)
+    print(f"✅ Patch {sys.argv[3]}: {len(patch)} bytes, {100.0 * len(patch) / max(len(dst), 1):.1f}% of {len(dst)} bytes")
+    print(f"sha256: {hashlib.sha256(patch).hexdigest()}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())